@@ -203,6 +203,7 @@ typedef enum
     VMMDevReq_DebugIsPageShared          = 216,
     VMMDevReq_GetSessionId               = 217, /* since version 3.2.8 */
     VMMDevReq_WriteCoreDump              = 218,
+    VMMDevReq_ReportFreePages            = 219, /* since version 4.2.x */
     VMMDevReq_SizeHack                   = 0x7fffffff
 } VMMDevRequestType;
 
@@ -931,6 +932,52 @@ AssertCompileSize(VMMDevChangeMemBalloon, 24+16);
 /** @} */
 
 
+/**
+ * A range of free guest pages.
+ *
+ * Used by VMMDevReportFreePages.
+ */
+typedef struct
+{
+    /** Physical address of the first page, page aligned. */
+    RTGCPHYS64          GCPhys;
+    /** The number of pages in the range. */
+    uint64_t            cPages;
+} VMMDevFreePageRange;
+AssertCompileSize(VMMDevFreePageRange, 16);
+
+/**
+ * Report ranges of free guest pages the host may reclaim.
+ *
+ * Unlike with the balloon the pages stay with the guest, the host replaces
+ * them by zero pages and populates them again when touched.  The guest must
+ * keep the pages isolated until the report has been completed.  When the
+ * request returns VINF_TRY_AGAIN the report is being processed asynchronously
+ * and the guest has to poll for its completion by resubmitting the request
+ * with cRanges set to 0.
+ *
+ * Used by VMMDevReq_ReportFreePages.
+ */
+typedef struct
+{
+    /** Header. */
+    VMMDevRequestHeader header;
+    /** The number of ranges in the array, 0 to poll for completion. */
+    uint32_t            cRanges;
+    /** Flags, MBZ. */
+    uint32_t            fFlags;
+    /** The number of pages freed by the report (out). */
+    uint64_t            cPagesFreed;
+    /** The ranges, variable size. */
+    VMMDevFreePageRange aRanges[1];
+} VMMDevReportFreePages;
+AssertCompileSize(VMMDevReportFreePages, 24+16+16);
+
+/** The max number of ranges in one VMMDevReportFreePages request. */
+#define VMMDEV_MAX_FREE_PAGE_RANGES \
+    ((VMMDEV_MAX_VMMDEVREQ_SIZE - RT_OFFSETOF(VMMDevReportFreePages, aRanges)) / sizeof(VMMDevFreePageRange))
+
+
 /**
  * Guest statistics interval change request structure.
  *
@@ -1884,6 +1931,8 @@ DECLINLINE(size_t) vmmdevGetRequestSize(VMMDevRequestType requestType)
             return sizeof(VMMDevGetStatisticsChangeRequest);
         case VMMDevReq_ChangeMemBalloon:
             return sizeof(VMMDevChangeMemBalloon);
+        case VMMDevReq_ReportFreePages:
+            return sizeof(VMMDevReportFreePages);
         case VMMDevReq_GetVRDPChangeRequest:
             return sizeof(VMMDevVRDPChangeRequest);
         case VMMDevReq_LogString:
@@ -570,6 +570,8 @@
 #define VERR_PGM_PHYS_NULL_PAGE_PARAM           (-1681)
 /** PCI passthru is not supported by this build. */
 #define VERR_PGM_PCI_PASSTHRU_MISCONFIG         (-1682)
+/** Post-copy teleportation was aborted before the page could be fetched. */
+#define VERR_PGM_POST_COPY_ABORTED              (-1683)
 /** @} */
 
 
@@ -2224,6 +2226,15 @@
 /** @} */
 
 
+/** @name STAM Status Codes
+ * @{
+ */
+/** Samples were registered or deregistered after the binary snapshot was
+ * prepared.  Prepare a new one. */
+#define VERR_STAM_SNAPSHOT_STALE                    (-6100)
+/** @} */
+
+
 /* SED-END */
 
 /** @} */
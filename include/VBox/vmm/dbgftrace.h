@@ -26,6 +26,7 @@
 #ifndef ___VBox_vmm_dbgftrace_h
 #define ___VBox_vmm_dbgftrace_h
 
+#include <iprt/assert.h>
 #include <iprt/trace.h>
 #include <VBox/types.h>
 
@@ -137,6 +138,207 @@ VMMDECL(int) DBGFR3TraceConfig(PVM pVM, const char *pszConfig);
 /** @} */
 
 
+/** @name Binary Tracing
+ *
+ * Fixed size binary records kept in one ring per virtual CPU, plus a shared
+ * ring for all other threads (I/O threads, the timer thread, ...).  Only the
+ * EMT writes to its own ring, so recording is a handful of stores; the shared
+ * ring allocates records with an atomic increment.  Old records are
+ * overwritten when a ring wraps around.
+ *
+ * The trace points are always compiled in.  When binary tracing is not
+ * enabled (DBGF/TraceBin, off by default) they cost a load and a not-taken
+ * branch; devices test the event mask copy in their instance data.
+ *
+ * @{
+ */
+
+/**
+ * Binary trace event types.
+ *
+ * @remarks Used as bit numbers in the event mask, so keep these below 32.
+ *          Do not renumber, the values are stored in trace files.
+ */
+typedef enum DBGFTRACEBINEVT
+{
+    /** Invalid zero entry. */
+    DBGFTRACEBINEVT_INVALID = 0,
+    /** VM-exit: u32Arg=exit reason, u64Arg1=guest RIP. */
+    DBGFTRACEBINEVT_HM_EXIT,
+    /** Resuming guest execution after a VM-exit.  No arguments. */
+    DBGFTRACEBINEVT_HM_RESUME,
+    /** I/O port read: u32Arg=port, u64Arg1=value, u64Arg2=access size. */
+    DBGFTRACEBINEVT_IOPORT_READ,
+    /** I/O port write: u32Arg=port, u64Arg1=value, u64Arg2=access size. */
+    DBGFTRACEBINEVT_IOPORT_WRITE,
+    /** MMIO read: u32Arg=access size, u64Arg1=physical address, u64Arg2=value. */
+    DBGFTRACEBINEVT_MMIO_READ,
+    /** MMIO write: u32Arg=access size, u64Arg1=physical address, u64Arg2=value. */
+    DBGFTRACEBINEVT_MMIO_WRITE,
+    /** Interrupt line change: u32Arg=IRQ, u64Arg1=PDM_IRQ_LEVEL_XXX, u64Arg2=0 for ISA, 1 for I/O APIC. */
+    DBGFTRACEBINEVT_IRQ,
+    /** Timer callback entered: u32Arg=clock, u64Arg1=expire time, u64Arg2=timer ID. */
+    DBGFTRACEBINEVT_TIMER_FIRE,
+    /** Timer callback returned: u32Arg=clock, u64Arg2=timer ID. */
+    DBGFTRACEBINEVT_TIMER_DONE,
+    /** Disk request submitted: u32Arg=bytes, u64Arg1=offset, u64Arg2=request ID. */
+    DBGFTRACEBINEVT_DISK_SUBMIT,
+    /** Disk request completed: u32Arg=bytes, u64Arg1=offset, u64Arg2=request ID. */
+    DBGFTRACEBINEVT_DISK_COMPLETE,
+    /** Network frame transmitted: u32Arg=bytes, u64Arg1=device instance. */
+    DBGFTRACEBINEVT_NET_XMIT,
+    /** Network frame received: u32Arg=bytes, u64Arg1=device instance. */
+    DBGFTRACEBINEVT_NET_RECV,
+    /** End of valid event types. */
+    DBGFTRACEBINEVT_END,
+    /** The usual 32-bit hack. */
+    DBGFTRACEBINEVT_32BIT_HACK = 0x7fffffff
+} DBGFTRACEBINEVT;
+AssertCompile(DBGFTRACEBINEVT_END <= 32);
+
+/** The idCpu value of records made by threads other than an EMT. */
+#define DBGFTRACEBIN_NIL_CPU        UINT16_MAX
+
+/**
+ * Binary trace record.
+ */
+typedef struct DBGFTRACEBINREC
+{
+    /** The TSC when the record was made. */
+    uint64_t            u64Tsc;
+    /** The event type (DBGFTRACEBINEVT). */
+    uint16_t            u16Evt;
+    /** The virtual CPU, DBGFTRACEBIN_NIL_CPU if not made by an EMT. */
+    uint16_t            idCpu;
+    /** Event specific argument. */
+    uint32_t            u32Arg;
+    /** Event specific argument. */
+    uint64_t            u64Arg1;
+    /** Event specific argument. */
+    uint64_t            u64Arg2;
+} DBGFTRACEBINREC;
+AssertCompileSize(DBGFTRACEBINREC, 32);
+/** Pointer to a binary trace record. */
+typedef DBGFTRACEBINREC *PDBGFTRACEBINREC;
+/** Pointer to a const binary trace record. */
+typedef DBGFTRACEBINREC const *PCDBGFTRACEBINREC;
+
+/**
+ * A binary trace ring.
+ */
+typedef struct DBGFTRACEBINRING
+{
+    /** The index of the next record, free running.  The ring has wrapped
+     * around once this exceeds DBGFTRACEBIN::cRecsPerRing.  This is 64-bit
+     * so the record counts stay right however long the VM runs. */
+    uint64_t volatile   iNext;
+    /** Padding the header to a cache line. */
+    uint32_t            au32Padding[14];
+    /** The records (DBGFTRACEBIN::cRecsPerRing). */
+    DBGFTRACEBINREC     aRecs[1];
+} DBGFTRACEBINRING;
+/** Pointer to a binary trace ring. */
+typedef DBGFTRACEBINRING *PDBGFTRACEBINRING;
+
+/**
+ * The binary trace buffer.
+ *
+ * This lives in the hyper heap and is followed by the rings.  It must be
+ * context agnostic.
+ */
+typedef struct DBGFTRACEBIN
+{
+    /** Magic value (DBGFTRACEBIN_MAGIC). */
+    uint32_t            u32Magic;
+    /** The number of rings, the virtual CPU count plus one shared ring. */
+    uint32_t            cRings;
+    /** The number of records in each ring, a power of two. */
+    uint32_t            cRecsPerRing;
+    /** The size of each ring. */
+    uint32_t            cbRing;
+    /** The offset of the first ring relative to this structure. */
+    uint32_t            offRings;
+    /** The events being recorded, RT_BIT_32(DBGFTRACEBINEVT_XXX). */
+    uint32_t volatile   fEvents;
+    /** Padding the header to a cache line. */
+    uint32_t            au32Padding[10];
+} DBGFTRACEBIN;
+AssertCompileSize(DBGFTRACEBIN, 64);
+/** Pointer to the binary trace buffer. */
+typedef DBGFTRACEBIN *PDBGFTRACEBIN;
+/** Pointer to the const binary trace buffer. */
+typedef DBGFTRACEBIN const *PCDBGFTRACEBIN;
+
+/** Magic value for DBGFTRACEBIN::u32Magic (Leslie Lamport). */
+#define DBGFTRACEBIN_MAGIC          UINT32_C(0x19410207)
+
+/** Gets a ring of a binary trace buffer. */
+#define DBGFTRACEBIN_RING(a_pTraceBin, a_iRing) \
+    ( (PDBGFTRACEBINRING)((uint8_t *)(a_pTraceBin) + (a_pTraceBin)->offRings + (a_iRing) * (a_pTraceBin)->cbRing) )
+
+/**
+ * Binary trace file header.
+ *
+ * The header is followed by cRecs DBGFTRACEBINREC records, oldest first for
+ * each ring.  All fields are in host byte order.
+ */
+typedef struct DBGFTRACEBINFILEHDR
+{
+    /** Magic string (DBGFTRACEBINFILEHDR_MAGIC). */
+    char                szMagic[8];
+    /** The file format version (DBGFTRACEBINFILEHDR_VERSION). */
+    uint32_t            uVersion;
+    /** The size of a record. */
+    uint32_t            cbRec;
+    /** The TSC frequency. */
+    uint64_t            u64TscHz;
+    /** The TSC when the file was written. */
+    uint64_t            u64TscDump;
+    /** The RTTimeNanoTS value when the file was written. */
+    uint64_t            u64NanoTSDump;
+    /** The number of virtual CPUs. */
+    uint32_t            cCpus;
+    /** The number of records following the header. */
+    uint32_t            cRecs;
+    /** The number of records that were overwritten before the dump. */
+    uint64_t            cRecsLost;
+} DBGFTRACEBINFILEHDR;
+AssertCompileSize(DBGFTRACEBINFILEHDR, 56);
+/** Pointer to a binary trace file header. */
+typedef DBGFTRACEBINFILEHDR *PDBGFTRACEBINFILEHDR;
+
+/** The DBGFTRACEBINFILEHDR::szMagic value. */
+#define DBGFTRACEBINFILEHDR_MAGIC   "VBoxTrB"
+/** The current DBGFTRACEBINFILEHDR::uVersion value. */
+#define DBGFTRACEBINFILEHDR_VERSION 1
+
+VMMDECL(void) DBGFTraceBinAdd(PVM pVM, DBGFTRACEBINEVT enmEvt, uint32_t u32Arg, uint64_t u64Arg1, uint64_t u64Arg2);
+#ifdef IN_RING3
+VMMR3DECL(int) DBGFR3TraceBinDump(PVM pVM, const char *pszFilename);
+#endif
+
+/**
+ * Records a binary trace event.
+ * @remarks The user of this macro is responsible of including VBox/vmm/vm.h.
+ */
+#define DBGFTRACE_BIN(a_pVM, a_enmEvt, a_u32Arg, a_u64Arg1, a_u64Arg2) \
+    do { \
+        if (RT_UNLIKELY((a_pVM)->CTX_SUFF(pTraceBin) != NULL)) \
+            DBGFTraceBinAdd((a_pVM), (a_enmEvt), (a_u32Arg), (a_u64Arg1), (a_u64Arg2)); \
+    } while (0)
+
+/**
+ * Records a binary trace event from a PDM device.
+ * @param   a_pDevIns   The device instance.
+ */
+#define DBGFTRACE_PDMDEV_BIN(a_pDevIns, a_enmEvt, a_u32Arg, a_u64Arg1, a_u64Arg2) \
+    do { \
+        if (RT_UNLIKELY((a_pDevIns)->fTraceBinEvents & RT_BIT_32(a_enmEvt))) \
+            DBGFTraceBinAdd((a_pDevIns)->CTX_SUFF(pHlp)->pfnGetVM((a_pDevIns)), (a_enmEvt), (a_u32Arg), (a_u64Arg1), (a_u64Arg2)); \
+    } while (0)
+/** @} */
+
+
 /** @} */
 RT_C_DECLS_END
 
@@ -349,6 +349,25 @@ typedef struct GMMVMSTATS
 } GMMVMSTATS;
 
 
+/** The max number of host NUMA nodes GMM keeps track of.  Chunks on nodes
+ * with higher IDs are accounted to no node. */
+#define GMM_MAX_NUMA_NODES              64
+
+/**
+ * The GMM per NUMA node statistics.
+ */
+typedef struct GMMNUMANODESTATS
+{
+    /** The number of allocation chunks on the node. */
+    uint32_t            cChunks;
+    /** Explicit alignment padding. */
+    uint32_t            u32Padding;
+    /** The number of free pages in the chunks on the node. */
+    uint64_t            cFreePages;
+} GMMNUMANODESTATS;
+/** Pointer to the GMM per NUMA node statistics. */
+typedef GMMNUMANODESTATS *PGMMNUMANODESTATS;
+
 /**
  * The GMM statistics.
  */
@@ -382,11 +401,26 @@ typedef struct GMMSTATS
     uint32_t            cFreedChunks;
     /** The number of shareable modules (GMM:cShareableModules). */
     uint64_t            cShareableModules;
-    /** Space reserved for later. */
-    uint64_t            au64Reserved[2];
+    /** The number of pages the page fusion scanner has looked at
+     * (GMM::Fusion.cScannedPages). */
+    uint64_t            cFusionScannedPages;
+    /** The number of private pages the page fusion scanner has turned into
+     * shared ones (GMM::Fusion.cSharedPages). */
+    uint64_t            cFusionSharedPages;
+    /** The number of private pages the page fusion scanner has replaced by an
+     * identical shared page, i.e. freed (GMM::Fusion.cSavedPages). */
+    uint64_t            cFusionSavedPages;
+    /** The number of host NUMA nodes (RTMpGetNumaNodeCount), limited to
+     * GMM_MAX_NUMA_NODES. */
+    uint32_t            cNumaNodes;
+    /** Explicit alignment padding. */
+    uint32_t            u32Padding;
 
     /** Statistics for the specified VM. (Zero filled if not requested.) */
     GMMVMSTATS          VMStats;
+
+    /** Per NUMA node statistics, cNumaNodes entries are valid. */
+    GMMNUMANODESTATS    aNumaNodes[GMM_MAX_NUMA_NODES];
 } GMMSTATS;
 /** Pointer to the GMM statistics. */
 typedef GMMSTATS *PGMMSTATS;
@@ -409,6 +443,7 @@ GMMR0DECL(int)  GMMR0FreeLargePage(PVM pVM, VMCPUID idCpu, uint32_t idPage);
 GMMR0DECL(int)  GMMR0BalloonedPages(PVM pVM, VMCPUID idCpu, GMMBALLOONACTION enmAction, uint32_t cBalloonedPages);
 GMMR0DECL(int)  GMMR0MapUnmapChunk(PVM pVM, uint32_t idChunkMap, uint32_t idChunkUnmap, PRTR3PTR ppvR3);
 GMMR0DECL(int)  GMMR0SeedChunk(PVM pVM, VMCPUID idCpu, RTR3PTR pvR3);
+GMMR0DECL(int)  GMMR0SetNumaPolicy(PVM pVM, VMCPUID idCpu, uint64_t fNodeMask);
 GMMR0DECL(int)  GMMR0RegisterSharedModule(PVM pVM, VMCPUID idCpu, VBOXOSFAMILY enmGuestOS, char *pszModuleName, char *pszVersion,
                                           RTGCPTR GCBaseAddr,  uint32_t cbModule, uint32_t cRegions,
                                           struct VMMDEVSHAREDREGIONDESC const *paRegions);
@@ -418,6 +453,9 @@ GMMR0DECL(int)  GMMR0CheckSharedModules(PVM pVM, PVMCPU pVCpu);
 GMMR0DECL(int)  GMMR0ResetSharedModules(PVM pVM, VMCPUID idCpu);
 GMMR0DECL(int)  GMMR0CheckSharedModulesStart(PVM pVM);
 GMMR0DECL(int)  GMMR0CheckSharedModulesEnd(PVM pVM);
+GMMR0DECL(int)  GMMR0PageFusionScan(PVM pVM, PVMCPU pVCpu, uint32_t cMaxPages);
+GMMR0DECL(int)  GMMR0SetConfig(PSUPDRVSESSION pSession, const char *pszName, uint64_t u64Value);
+GMMR0DECL(int)  GMMR0QueryConfig(PSUPDRVSESSION pSession, const char *pszName, uint64_t *pu64Value);
 GMMR0DECL(int)  GMMR0QueryStatistics(PGMMSTATS pStats, PSUPDRVSESSION pSession);
 GMMR0DECL(int)  GMMR0ResetStatistics(PCGMMSTATS pStats, PSUPDRVSESSION pSession);
 
@@ -678,6 +716,7 @@ typedef GMMSHAREDPAGEDESC *PGMMSHAREDPAGEDESC;
 
 GMMR0DECL(int) GMMR0SharedModuleCheckPage(PGVM pGVM, PGMMSHAREDMODULE pModule, uint32_t idxRegion, uint32_t idxPage,
                                           PGMMSHAREDPAGEDESC pPageDesc);
+GMMR0DECL(int) GMMR0PageFusionCheckPage(PGVM pGVM, PGMMSHAREDPAGEDESC pPageDesc);
 
 /**
  * Request buffer for GMMR0UnregisterSharedModuleReq / VMMR0_DO_GMM_UNREGISTER_SHARED_MODULE.
@@ -786,12 +825,14 @@ GMMR3DECL(int)  GMMR3AllocateLargePage(PVM pVM,  uint32_t cbPage);
 GMMR3DECL(int)  GMMR3FreeLargePage(PVM pVM,  uint32_t idPage);
 GMMR3DECL(int)  GMMR3MapUnmapChunk(PVM pVM, uint32_t idChunkMap, uint32_t idChunkUnmap, PRTR3PTR ppvR3);
 GMMR3DECL(int)  GMMR3SeedChunk(PVM pVM, RTR3PTR pvR3);
+GMMR3DECL(int)  GMMR3SetNumaPolicy(PVM pVM, uint64_t fNodeMask);
 GMMR3DECL(int)  GMMR3QueryHypervisorMemoryStats(PVM pVM, uint64_t *pcTotalAllocPages, uint64_t *pcTotalFreePages, uint64_t *pcTotalBalloonPages, uint64_t *puTotalBalloonSize);
 GMMR3DECL(int)  GMMR3QueryMemoryStats(PVM pVM, uint64_t *pcAllocPages, uint64_t *pcMaxPages, uint64_t *pcBalloonPages);
 GMMR3DECL(int)  GMMR3BalloonedPages(PVM pVM, GMMBALLOONACTION enmAction, uint32_t cBalloonedPages);
 GMMR3DECL(int)  GMMR3RegisterSharedModule(PVM pVM, PGMMREGISTERSHAREDMODULEREQ pReq);
 GMMR3DECL(int)  GMMR3UnregisterSharedModule(PVM pVM, PGMMUNREGISTERSHAREDMODULEREQ pReq);
 GMMR3DECL(int)  GMMR3CheckSharedModules(PVM pVM);
+GMMR3DECL(int)  GMMR3PageFusionScan(PVM pVM, uint32_t cMaxPages);
 GMMR3DECL(int)  GMMR3ResetSharedModules(PVM pVM);
 
 # if defined(VBOX_STRICT) && HC_ARCH_BITS == 64
@@ -29,6 +29,7 @@
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/vmm/pdmqueue.h>
 #include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/pdmcritsectrw.h>
 #include <VBox/vmm/pdmthread.h>
 #include <VBox/vmm/pdmifs.h>
 #include <VBox/vmm/pdmdrv.h>
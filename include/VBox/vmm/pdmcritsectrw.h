@@ -0,0 +1,85 @@
+/** @file
+ * PDM - Pluggable Device Manager, Read/Write Critical Sections.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___VBox_vmm_pdmcritsectrw_h
+#define ___VBox_vmm_pdmcritsectrw_h
+
+#include <VBox/types.h>
+
+
+RT_C_DECLS_BEGIN
+
+/** @defgroup grp_pdm_critsectrw    The PDM Read/Write Critical Section API
+ * @ingroup grp_pdm
+ * @{
+ */
+
+/**
+ * A PDM read/write critical section.
+ *
+ * Any number of threads can own it shared (read), or one thread can own it
+ * exclusively (write).  Like PDMCRITSECT it works in RC and R0 too, where a
+ * busy section makes the enter calls return rcBusy (or go to ring-3 for it).
+ * The exclusive owner may recurse and may also enter it shared.
+ *
+ * Initialize using PDMDEVHLPR3::pfnCritSectRwInit().
+ */
+typedef union PDMCRITSECTRW
+{
+    /** Padding. */
+    uint8_t padding[HC_ARCH_BITS == 32 ? 0xc0 : 0xf0];
+    /** Alignment, the state word is updated using 64-bit atomics. */
+    uint64_t u64Alignment;
+#ifdef PDMCRITSECTRWINT_DECLARED
+    /** The internal structure (not normally visible). */
+    struct PDMCRITSECTRWINT s;
+#endif
+} PDMCRITSECTRW;
+
+VMMR3DECL(int)      PDMR3CritSectRwInit(PVM pVM, PPDMCRITSECTRW pThis, RT_SRC_POS_DECL, const char *pszNameFmt, ...);
+VMMR3DECL(int)      PDMR3CritSectRwDelete(PPDMCRITSECTRW pThis);
+VMMR3DECL(const char *) PDMR3CritSectRwName(PCPDMCRITSECTRW pThis);
+VMMR3DECL(int)      PDMR3CritSectRwEnterSharedEx(PPDMCRITSECTRW pThis, bool fCallRing3);
+VMMR3DECL(int)      PDMR3CritSectRwEnterExclEx(PPDMCRITSECTRW pThis, bool fCallRing3);
+
+VMMDECL(int)        PDMCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy);
+VMMDECL(int)        PDMCritSectRwTryEnterShared(PPDMCRITSECTRW pThis);
+VMMDECL(int)        PDMCritSectRwLeaveShared(PPDMCRITSECTRW pThis);
+VMMDECL(int)        PDMCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy);
+VMMDECL(int)        PDMCritSectRwTryEnterExcl(PPDMCRITSECTRW pThis);
+VMMDECL(int)        PDMCritSectRwLeaveExcl(PPDMCRITSECTRW pThis);
+
+VMMDECL(bool)       PDMCritSectRwIsWriteOwner(PCPDMCRITSECTRW pThis);
+VMMDECL(bool)       PDMCritSectRwIsReadOwner(PCPDMCRITSECTRW pThis);
+VMMDECL(uint32_t)   PDMCritSectRwGetWriteRecursion(PCPDMCRITSECTRW pThis);
+VMMDECL(uint32_t)   PDMCritSectRwGetReadCount(PCPDMCRITSECTRW pThis);
+VMMDECL(bool)       PDMCritSectRwIsInitialized(PCPDMCRITSECTRW pThis);
+
+/** @} */
+
+RT_C_DECLS_END
+
+#endif
+
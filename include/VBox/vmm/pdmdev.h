@@ -28,6 +28,7 @@
 
 #include <VBox/vmm/pdmqueue.h>
 #include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/pdmcritsectrw.h>
 #include <VBox/vmm/pdmthread.h>
 #include <VBox/vmm/pdmifs.h>
 #include <VBox/vmm/pdmins.h>
@@ -3371,8 +3372,45 @@ typedef struct PDMDEVHLPR3
 
     /** Space reserved for future members.
      * @{ */
-    DECLR3CALLBACKMEMBER(void, pfnReserved1,(void));
-    DECLR3CALLBACKMEMBER(void, pfnReserved2,(void));
+    /**
+     * Create a batch queue.
+     *
+     * Unlike pfnQueueCreate, the consumer gets all pending items in one call
+     * and producers on different virtual CPUs don't contend with each other.
+     * The order of items inserted on different CPUs is not preserved.
+     *
+     * @returns VBox status code.
+     * @param   pDevIns             The device instance.
+     * @param   cbItem              The size of a queue item.
+     * @param   cItems              The number of items in the queue.
+     * @param   cMilliesInterval    The number of milliseconds between polling the queue.
+     *                              If 0 then the emulation thread will be notified whenever an item arrives.
+     * @param   pfnCallback         The consumer function.
+     * @param   fRZEnabled          Set if the queue should work in RC and R0.
+     * @param   pszName             The queue base name. The instance number will be
+     *                              appended automatically.
+     * @param   ppQueue             Where to store the queue handle on success.
+     * @thread  The emulation thread.
+     */
+    DECLR3CALLBACKMEMBER(int, pfnQueueCreateBatch,(PPDMDEVINS pDevIns, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
+                                                   PFNPDMQUEUEDEVBATCH pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue));
+
+    /**
+     * Initializes a PDM read/write critical section.
+     *
+     * Use this for device state that is read far more often than it is
+     * modified.  Like PDMCRITSECT it works in RC and R0 as well.
+     *
+     * @returns VBox status code.
+     * @param   pDevIns             The device instance.
+     * @param   pCritSect           Pointer to the read/write critical section.
+     * @param   RT_SRC_POS_DECL     Use RT_SRC_POS.
+     * @param   pszNameFmt          Format string for naming the critical section.
+     *                              For statistics.
+     * @param   va                  Arguments for the format string.
+     */
+    DECLR3CALLBACKMEMBER(int, pfnCritSectRwInit,(PPDMDEVINS pDevIns, PPDMCRITSECTRW pCritSect, RT_SRC_POS_DECL,
+                                                 const char *pszNameFmt, va_list va));
     DECLR3CALLBACKMEMBER(void, pfnReserved3,(void));
     DECLR3CALLBACKMEMBER(void, pfnReserved4,(void));
     DECLR3CALLBACKMEMBER(void, pfnReserved5,(void));
@@ -3536,7 +3574,7 @@ typedef R3PTRTYPE(struct PDMDEVHLPR3 *) PPDMDEVHLPR3;
 typedef R3PTRTYPE(const struct PDMDEVHLPR3 *) PCPDMDEVHLPR3;
 
 /** Current PDMDEVHLPR3 version number. */
-#define PDM_DEVHLPR3_VERSION                    PDM_VERSION_MAKE(0xffe7, 9, 0)
+#define PDM_DEVHLPR3_VERSION                    PDM_VERSION_MAKE(0xffe7, 9, 2)
 
 
 /**
@@ -4021,9 +4059,14 @@ typedef struct PDMDEVINS
     uint32_t                    fTracing;
     /** The tracing ID of this device.  */
     uint32_t                    idTracing;
+    /** The binary trace events being recorded, a copy of DBGFTRACEBIN::fEvents
+     * so DBGFTRACE_PDMDEV_BIN can skip the call when they're not. */
+    uint32_t                    fTraceBinEvents;
+    /** Alignment padding. */
+    uint32_t                    u32Alignment;
 #if HC_ARCH_BITS == 32
     /** Align the internal data more naturally. */
-    uint32_t                    au32Padding[HC_ARCH_BITS == 32 ? 13 : 0];
+    uint32_t                    au32Padding[HC_ARCH_BITS == 32 ? 11 : 0];
 #endif
 
     /** Internal data. */
@@ -4032,7 +4075,7 @@ typedef struct PDMDEVINS
 #ifdef PDMDEVINSINT_DECLARED
         PDMDEVINSINT            s;
 #endif
-        uint8_t                 padding[HC_ARCH_BITS == 32 ? 72 : 112 + 0x28];
+        uint8_t                 padding[HC_ARCH_BITS == 32 ? 72 : 112 + 0x20];
     } Internal;
 
     /** Device instance data. The size of this area is defined
@@ -4041,7 +4084,7 @@ typedef struct PDMDEVINS
 } PDMDEVINS;
 
 /** Current PDMDEVINS version number. */
-#define PDM_DEVINS_VERSION                      PDM_VERSION_MAKE(0xffe4, 3, 0)
+#define PDM_DEVINS_VERSION                      PDM_VERSION_MAKE(0xffe4, 4, 0)
 
 /** Converts a pointer to the PDMDEVINS::IBase to a pointer to PDMDEVINS. */
 #define PDMIBASE_2_PDMDEV(pInterface) ( (PPDMDEVINS)((char *)(pInterface) - RT_OFFSETOF(PDMDEVINS, IBase)) )
@@ -4771,6 +4814,15 @@ DECLINLINE(int) PDMDevHlpQueueCreate(PPDMDEVINS pDevIns, size_t cbItem, uint32_t
     return pDevIns->pHlpR3->pfnQueueCreate(pDevIns, cbItem, cItems, cMilliesInterval, pfnCallback, fRZEnabled, pszName, ppQueue);
 }
 
+/**
+ * @copydoc PDMDEVHLPR3::pfnQueueCreateBatch
+ */
+DECLINLINE(int) PDMDevHlpQueueCreateBatch(PPDMDEVINS pDevIns, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
+                                          PFNPDMQUEUEDEVBATCH pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue)
+{
+    return pDevIns->pHlpR3->pfnQueueCreateBatch(pDevIns, cbItem, cItems, cMilliesInterval, pfnCallback, fRZEnabled, pszName, ppQueue);
+}
+
 /**
  * Initializes a PDM critical section.
  *
@@ -4795,6 +4847,27 @@ DECLINLINE(int) PDMDevHlpCritSectInit(PPDMDEVINS pDevIns, PPDMCRITSECT pCritSect
     return rc;
 }
 
+/**
+ * Initializes a PDM read/write critical section.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns             The device instance.
+ * @param   pCritSect           Pointer to the read/write critical section.
+ * @param   RT_SRC_POS_DECL     Use RT_SRC_POS.
+ * @param   pszNameFmt          Format string for naming the critical section.
+ *                              For statistics.
+ * @param   ...                 Arguments for the format string.
+ */
+DECLINLINE(int) PDMDevHlpCritSectRwInit(PPDMDEVINS pDevIns, PPDMCRITSECTRW pCritSect, RT_SRC_POS_DECL, const char *pszNameFmt, ...)
+{
+    int     rc;
+    va_list va;
+    va_start(va, pszNameFmt);
+    rc = pDevIns->pHlpR3->pfnCritSectRwInit(pDevIns, pCritSect, RT_SRC_POS_ARGS, pszNameFmt, va);
+    va_end(va);
+    return rc;
+}
+
 /**
  * @copydoc PDMDEVHLPR3::pfnCritSectGetNop
  */
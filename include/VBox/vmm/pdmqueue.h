@@ -118,6 +118,36 @@ typedef DECLCALLBACK(bool) FNPDMQUEUEEXT(void *pvUser, PPDMQUEUEITEMCORE pItem);
 /** Pointer to a FNPDMQUEUEEXT(). */
 typedef FNPDMQUEUEEXT *PFNPDMQUEUEEXT;
 
+/**
+ * Batch queue consumer callback for devices.
+ *
+ * A batch queue hands all pending items to the consumer in one call.  The
+ * items are in insertion order for each producing CPU, but the order between
+ * CPUs is not preserved.
+ *
+ * @returns The number of items consumed, counting from the start of the
+ *          array.  These are freed upon return, the rest stay queued and are
+ *          passed first on the next flush.
+ * @param   pDevIns     The device instance.
+ * @param   papItems    The pending items.
+ * @param   cItems      The number of items in the array, at least 1.
+ */
+typedef DECLCALLBACK(uint32_t) FNPDMQUEUEDEVBATCH(PPDMDEVINS pDevIns, PPDMQUEUEITEMCORE *papItems, uint32_t cItems);
+/** Pointer to a FNPDMQUEUEDEVBATCH(). */
+typedef FNPDMQUEUEDEVBATCH *PFNPDMQUEUEDEVBATCH;
+
+/**
+ * Batch queue consumer callback for internal component.
+ *
+ * @returns The number of items consumed, see FNPDMQUEUEDEVBATCH.
+ * @param   pVM         The VM handle.
+ * @param   papItems    The pending items.
+ * @param   cItems      The number of items in the array, at least 1.
+ */
+typedef DECLCALLBACK(uint32_t) FNPDMQUEUEINTBATCH(PVM pVM, PPDMQUEUEITEMCORE *papItems, uint32_t cItems);
+/** Pointer to a FNPDMQUEUEINTBATCH(). */
+typedef FNPDMQUEUEINTBATCH *PFNPDMQUEUEINTBATCH;
+
 #ifdef VBOX_IN_VMM
 VMMR3_INT_DECL(int)  PDMR3QueueCreateDevice(PVM pVM, PPDMDEVINS pDevIns, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
                                             PFNPDMQUEUEDEV pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue);
@@ -127,6 +157,10 @@ VMMR3_INT_DECL(int)  PDMR3QueueCreateInternal(PVM pVM, size_t cbItem, uint32_t c
                                               PFNPDMQUEUEINT pfnCallback, bool fGCEnabled, const char *pszName, PPDMQUEUE *ppQueue);
 VMMR3_INT_DECL(int)  PDMR3QueueCreateExternal(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
                                               PFNPDMQUEUEEXT pfnCallback, void *pvUser, const char *pszName, PPDMQUEUE *ppQueue);
+VMMR3_INT_DECL(int)  PDMR3QueueCreateDeviceBatch(PVM pVM, PPDMDEVINS pDevIns, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
+                                                 PFNPDMQUEUEDEVBATCH pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue);
+VMMR3_INT_DECL(int)  PDMR3QueueCreateInternalBatch(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
+                                                   PFNPDMQUEUEINTBATCH pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue);
 VMMR3_INT_DECL(int)  PDMR3QueueDestroy(PPDMQUEUE pQueue);
 VMMR3_INT_DECL(int)  PDMR3QueueDestroyDevice(PVM pVM, PPDMDEVINS pDevIns);
 VMMR3_INT_DECL(int)  PDMR3QueueDestroyDriver(PVM pVM, PPDMDRVINS pDrvIns);
@@ -154,6 +154,22 @@ typedef DECLCALLBACK(int) FNPGMR3PHYSHANDLER(PVM pVM, RTGCPHYS GCPhys, void *pvP
 /** Pointer to PGM access callback. */
 typedef FNPGMR3PHYSHANDLER *PFNPGMR3PHYSHANDLER;
 
+/**
+ * Requests a page from the source during post-copy teleportation.
+ *
+ * This shall not wait for the page to arrive, PGMR3PostCopyPageArrived takes
+ * care of that.
+ *
+ * @returns VBox status code.  Failure is fatal to the guest.
+ * @param   pVM             Pointer to the VM.
+ * @param   GCPhys          The address of the page.
+ * @param   pvUser          User argument.
+ * @thread  EMT.
+ */
+typedef DECLCALLBACK(int) FNPGMPOSTCOPYREQUEST(PVM pVM, RTGCPHYS GCPhys, void *pvUser);
+/** Pointer to FNPGMPOSTCOPYREQUEST(). */
+typedef FNPGMPOSTCOPYREQUEST *PFNPGMPOSTCOPYREQUEST;
+
 
 /**
  * Virtual access handler type.
@@ -235,6 +251,21 @@ typedef DECLCALLBACK(int) FNPGMENUMDIRTYFTPAGES(PVM pVM, RTGCPHYS GCPhys, uint8_
 /** Pointer to PGMR3PhysEnumDirtyFTPages callback. */
 typedef FNPGMENUMDIRTYFTPAGES *PFNPGMENUMDIRTYFTPAGES;
 
+/**
+ * A range of guest physical pages, used by PGMR3PhysReportFreePages.
+ */
+typedef struct PGMPHYSRANGE
+{
+    /** The guest physical address of the first page (page aligned). */
+    RTGCPHYS    GCPhys;
+    /** The number of pages. */
+    uint64_t    cPages;
+} PGMPHYSRANGE;
+/** Pointer to a guest physical page range. */
+typedef PGMPHYSRANGE *PPGMPHYSRANGE;
+/** Pointer to a const guest physical page range. */
+typedef PGMPHYSRANGE const *PCPGMPHYSRANGE;
+
 /**
  * Paging mode.
  */
@@ -429,6 +460,7 @@ VMMR0_INT_DECL(int) PGMR0PhysFlushHandyPages(PVM pVM, PVMCPU pVCpu);
 VMMR0_INT_DECL(int) PGMR0PhysAllocateLargeHandyPage(PVM pVM, PVMCPU pVCpu);
 VMMR0_INT_DECL(int) PGMR0PhysSetupIommu(PVM pVM);
 VMMR0DECL(int)      PGMR0SharedModuleCheck(PVM pVM, PGVM pGVM, VMCPUID idCpu, PGMMSHAREDMODULE pModule, PCRTGCPTR64 paRegionsGCPtrs);
+VMMR0DECL(int)      PGMR0PageFusionScan(PVM pVM, PGVM pGVM, VMCPUID idCpu, uint32_t cMaxPages, uint64_t u64Deadline);
 VMMR0DECL(int)      PGMR0Trap0eHandlerNestedPaging(PVM pVM, PVMCPU pVCpu, PGMMODE enmShwPagingMode, RTGCUINT uErr, PCPUMCTXCORE pRegFrame, RTGCPHYS pvFault);
 VMMR0DECL(VBOXSTRICTRC) PGMR0Trap0eHandlerNPMisconfig(PVM pVM, PVMCPU pVCpu, PGMMODE enmShwPagingMode, PCPUMCTXCORE pRegFrame, RTGCPHYS GCPhysFault, uint32_t uErr);
 # ifdef VBOX_WITH_2X_4GB_ADDR_SPACE
@@ -463,6 +495,8 @@ VMMR3DECL(int)      PGMR3ChangeMode(PVM pVM, PVMCPU pVCpu, PGMMODE enmGuestMode)
 
 VMMR3DECL(int)      PGMR3PhysRegisterRam(PVM pVM, RTGCPHYS GCPhys, RTGCPHYS cb, const char *pszDesc);
 VMMR3DECL(int)      PGMR3PhysChangeMemBalloon(PVM pVM, bool fInflate, unsigned cPages, RTGCPHYS *paPhysPage);
+VMMR3DECL(int)      PGMR3PhysReportFreePages(PVM pVM, uint32_t cRanges, PCPGMPHYSRANGE paRanges, uint64_t *pcPagesFreed);
+VMMR3DECL(int)      PGMR3PhysQueryFreePagesReport(PVM pVM, uint64_t *pcPagesFreed);
 VMMR3DECL(int)      PGMR3PhysWriteProtectRAM(PVM pVM);
 VMMR3DECL(int)      PGMR3PhysEnumDirtyFTPages(PVM pVM, PFNPGMENUMDIRTYFTPAGES pfnEnum, void *pvUser);
 VMMR3DECL(uint32_t) PGMR3PhysGetRamRangeCount(PVM pVM);
@@ -470,6 +504,8 @@ VMMR3DECL(int)      PGMR3PhysGetRange(PVM pVM, uint32_t iRange, PRTGCPHYS pGCPhy
                                       const char **ppszDesc, bool *pfIsMmio);
 VMMR3DECL(int)      PGMR3QueryMemoryStats(PVM pVM, uint64_t *pcbTotalMem, uint64_t *pcbPrivateMem, uint64_t *pcbSharedMem, uint64_t *pcbZeroMem);
 VMMR3DECL(int)      PGMR3QueryGlobalMemoryStats(PVM pVM, uint64_t *pcbAllocMem, uint64_t *pcbFreeMem, uint64_t *pcbBallonedMem, uint64_t *pcbSharedMem);
+VMMR3DECL(int)      PGMR3QueryWorkingSet(PVM pVM, uint64_t *pcbWorkingSet, uint64_t *pcbWorkingSetAvg);
+VMMR3DECL(int)      PGMR3WorkingSetNextWindow(PVM pVM);
 
 VMMR3DECL(int)      PGMR3PhysMMIORegister(PVM pVM, RTGCPHYS GCPhys, RTGCPHYS cb,
                                           R3PTRTYPE(PFNPGMR3PHYSHANDLER) pfnHandlerR3, RTR3PTR pvUserR3,
@@ -549,6 +585,14 @@ VMMR3DECL(int)      PGMR3PhysChunkMap(PVM pVM, uint32_t idChunk);
 VMMR3DECL(void)     PGMR3PhysChunkInvalidateTLB(PVM pVM);
 VMMR3DECL(int)      PGMR3PhysAllocateHandyPages(PVM pVM);
 VMMR3DECL(int)      PGMR3PhysAllocateLargeHandyPage(PVM pVM, RTGCPHYS GCPhys);
+VMMR3DECL(int)      PGMR3PhysLargePagePromoteNow(PVM pVM);
+
+VMMR3DECL(int)      PGMR3PostCopyEnable(PVM pVM);
+VMMR3DECL(int)      PGMR3PostCopyNextPage(PVM pVM, RTGCPHYS GCPhysWanted, PRTGCPHYS pGCPhys, void *pvPage);
+VMMR3DECL(int)      PGMR3PostCopyStart(PVM pVM, PFNPGMPOSTCOPYREQUEST pfnRequest, void *pvUser);
+VMMR3DECL(int)      PGMR3PostCopyPageArrived(PVM pVM, RTGCPHYS GCPhys, void const *pvPage);
+VMMR3DECL(uint32_t) PGMR3PostCopyGetOutstanding(PVM pVM);
+VMMR3DECL(int)      PGMR3PostCopyTerm(PVM pVM);
 
 VMMR3DECL(int)      PGMR3CheckIntegrity(PVM pVM);
 
@@ -574,6 +618,7 @@ VMMR3DECL(int)     PGMR3SharedModuleUnregister(PVM pVM, char *pszModuleName, cha
                                                RTGCPTR GCBaseAddr, uint32_t cbModule);
 VMMR3DECL(int)     PGMR3SharedModuleCheckAll(PVM pVM);
 VMMR3DECL(int)     PGMR3SharedModuleGetPageState(PVM pVM, RTGCPTR GCPtrPage, bool *pfShared, uint64_t *pfPageFlags);
+VMMR3DECL(int)     PGMR3PageFusionScanNow(PVM pVM);
 /** @} */
 
 /** @} */
@@ -1226,6 +1226,46 @@ VMMR3DECL(int)  STAMR3SnapshotU(PUVM pUVM, const char *pszPat, char **ppszSnapsh
 VMMR3DECL(int)  STAMR3Snapshot(PVM pVM, const char *pszPat, char **ppszSnapshot, size_t *pcchSnapshot, bool fWithDesc);
 VMMR3DECL(int)  STAMR3SnapshotFreeU(PUVM pUVM, char *pszSnapshot);
 VMMR3DECL(int)  STAMR3SnapshotFree(PVM pVM, char *pszSnapshot);
+
+/** Binary statistics snapshot handle, see STAMR3BinSnapshotCreateU. */
+typedef struct STAMBINSNAPSHOT *PSTAMBINSNAPSHOT;
+
+/**
+ * Callback function for STAMR3BinSnapshotEnumLayout().
+ *
+ * @returns non-zero to halt the enumeration.
+ *
+ * @param   idSample        The sample ID.  Unique for the lifetime of the VM,
+ *                          so it can be used for telling whether a sample is
+ *                          the same as in a previous snapshot.
+ * @param   pszName         The name of the sample.
+ * @param   enmType         The type.
+ * @param   enmUnit         The unit.
+ * @param   pszDesc         The description.
+ * @param   iFirstValue     The index of the first value of the sample in the
+ *                          array returned by STAMR3BinSnapshotQueryValuesU().
+ * @param   cValues         The number of values the sample has there:
+ *                              - 4 for profiles: periods, ticks, max and min
+ *                                ticks per period.
+ *                              - 2 for ratios: A and B.
+ *                              - 0 for callback samples.
+ *                              - 1 for everything else.
+ * @param   pvUser          The pvUser argument given to STAMR3BinSnapshotEnumLayout().
+ */
+typedef DECLCALLBACK(int) FNSTAMR3BINLAYOUT(uint32_t idSample, const char *pszName, STAMTYPE enmType, STAMUNIT enmUnit,
+                                            const char *pszDesc, uint32_t iFirstValue, uint32_t cValues, void *pvUser);
+/** Pointer to a FNSTAMR3BINLAYOUT(). */
+typedef FNSTAMR3BINLAYOUT *PFNSTAMR3BINLAYOUT;
+
+VMMR3DECL(int)      STAMR3BinSnapshotCreateU(PUVM pUVM, const char *pszPat, PSTAMBINSNAPSHOT *phSnapshot);
+VMMR3DECL(int)      STAMR3BinSnapshotCreate(PVM pVM, const char *pszPat, PSTAMBINSNAPSHOT *phSnapshot);
+VMMR3DECL(void)     STAMR3BinSnapshotDestroy(PSTAMBINSNAPSHOT hSnapshot);
+VMMR3DECL(uint32_t) STAMR3BinSnapshotGetValueCount(PSTAMBINSNAPSHOT hSnapshot);
+VMMR3DECL(int)      STAMR3BinSnapshotEnumLayoutU(PUVM pUVM, PSTAMBINSNAPSHOT hSnapshot, PFNSTAMR3BINLAYOUT pfnLayout, void *pvUser);
+VMMR3DECL(int)      STAMR3BinSnapshotEnumLayout(PVM pVM, PSTAMBINSNAPSHOT hSnapshot, PFNSTAMR3BINLAYOUT pfnLayout, void *pvUser);
+VMMR3DECL(int)      STAMR3BinSnapshotQueryValuesU(PUVM pUVM, PSTAMBINSNAPSHOT hSnapshot, uint64_t *pau64Values, uint32_t cValues);
+VMMR3DECL(int)      STAMR3BinSnapshotQueryValues(PVM pVM, PSTAMBINSNAPSHOT hSnapshot, uint64_t *pau64Values, uint32_t cValues);
+
 VMMR3DECL(int)  STAMR3DumpU(PUVM pUVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3Dump(PVM pVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3DumpToReleaseLogU(PUVM pUVM, const char *pszPat);
@@ -53,7 +53,7 @@ typedef struct UVMCPU
 #ifdef ___VMInternal_h
         struct VMINTUSERPERVMCPU    s;
 #endif
-        uint8_t                     padding[512];
+        uint8_t                     padding[768];
     } vm;
 } UVMCPU;
 AssertCompileMemberAlignment(UVMCPU, vm, 32);
@@ -123,7 +123,7 @@ typedef struct UVM
 #ifdef ___STAMInternal_h
         struct STAMUSERPERVM    s;
 #endif
-        uint8_t                 padding[6624];
+        uint8_t                 padding[7680];
     } stam;
 
     /** Per virtual CPU data. */
@@ -198,7 +198,7 @@ typedef struct VMCPU
 #ifdef ___PDMInternal_h
         struct PDMCPU       s;
 #endif
-        uint8_t             padding[128];       /* multiple of 64 */
+        uint8_t             padding[256];       /* multiple of 64 */
     } pdm;
 
     /** IOM part. */
@@ -221,7 +221,7 @@ typedef struct VMCPU
     } dbgf;
 
     /** Align the following members on page boundary. */
-    uint8_t                 abAlignment2[1024 - 320 - 128];
+    uint8_t                 abAlignment2[1024 - 320 - 256];
 
     /** PGM part. */
     union
@@ -864,6 +864,14 @@ typedef struct VM
     R3PTRTYPE(RTTRACEBUF)       hTraceBufR3;
     /** Ring-0 Host Context VM Pointer. */
     R0PTRTYPE(RTTRACEBUF)       hTraceBufR0;
+    /** Raw-mode context pointer to the binary trace buffer, NULL if disabled. */
+    RCPTRTYPE(struct DBGFTRACEBIN *) pTraceBinRC;
+    /** Alignment padding.. */
+    uint32_t                    uPadding3;
+    /** Ring-3 context pointer to the binary trace buffer, NULL if disabled. */
+    R3PTRTYPE(struct DBGFTRACEBIN *) pTraceBinR3;
+    /** Ring-0 context pointer to the binary trace buffer, NULL if disabled. */
+    R0PTRTYPE(struct DBGFTRACEBIN *) pTraceBinR0;
     /** @} */
 
 #if HC_ARCH_BITS == 32
@@ -900,7 +908,7 @@ typedef struct VM
 
     /** Padding - the unions must be aligned on a 64 bytes boundary and the unions
      *  must start at the same offset on both 64-bit and 32-bit hosts. */
-    uint8_t                     abAlignment3[(HC_ARCH_BITS == 32 ? 24 : 0) + 40];
+    uint8_t                     abAlignment3[(HC_ARCH_BITS == 32 ? 32 : 0) + 16];
 
     /** CPUM part. */
     union
@@ -1016,7 +1024,7 @@ typedef struct VM
 #ifdef ___TMInternal_h
         struct TM   s;
 #endif
-        uint8_t     padding[2432];      /* multiple of 64 */
+        uint8_t     padding[2496];      /* multiple of 64 */
     } tm;
 
     /** DBGF part. */
@@ -1077,7 +1085,7 @@ typedef struct VM
 
 
     /** Padding for aligning the cpu array on a page boundary. */
-    uint8_t         abAlignment2[542];
+    uint8_t         abAlignment2[478];
 
     /* ---- end small stuff ---- */
 
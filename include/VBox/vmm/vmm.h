@@ -81,6 +81,10 @@ typedef enum VMMCALLRING3
     VMMCALLRING3_PDM_LOCK,
     /** Acquire the critical section specified as argument.  */
     VMMCALLRING3_PDM_CRIT_SECT_ENTER,
+    /** Enter the R/W critical section (in argument) exclusively.  */
+    VMMCALLRING3_PDM_CRIT_SECT_RW_ENTER_EXCL,
+    /** Enter the R/W critical section (in argument) shared.  */
+    VMMCALLRING3_PDM_CRIT_SECT_RW_ENTER_SHARED,
     /** Acquire the PGM lock. */
     VMMCALLRING3_PGM_LOCK,
     /** Grow the PGM shadow page pool. */
@@ -391,6 +395,8 @@ typedef enum VMMR0OPERATION
     VMMR0_DO_GMM_MAP_UNMAP_CHUNK,
     /** Call GMMR0SeedChunk(). */
     VMMR0_DO_GMM_SEED_CHUNK,
+    /** Call GMMR0SetNumaPolicy(). */
+    VMMR0_DO_GMM_SET_NUMA_POLICY,
     /** Call GMMR0RegisterSharedModule. */
     VMMR0_DO_GMM_REGISTER_SHARED_MODULE,
     /** Call GMMR0UnregisterSharedModule. */
@@ -399,6 +405,8 @@ typedef enum VMMR0OPERATION
     VMMR0_DO_GMM_RESET_SHARED_MODULES,
     /** Call GMMR0CheckSharedModules. */
     VMMR0_DO_GMM_CHECK_SHARED_MODULES,
+    /** Call GMMR0PageFusionScan. */
+    VMMR0_DO_GMM_PAGE_FUSION_SCAN,
     /** Call GMMR0FindDuplicatePage. */
     VMMR0_DO_GMM_FIND_DUPLICATE_PAGE,
     /** Call GMMR0QueryStatistics(). */
@@ -447,6 +455,10 @@ typedef enum VMMR0OPERATION
     VMMR0_DO_TESTS,
     /** Test the 32->64 bits switcher. */
     VMMR0_DO_TEST_SWITCHER3264,
+    /** Make u64Arg ring-3 calls, for measuring the ring-0 -> ring-3 round trip. */
+    VMMR0_DO_TEST_CALL_RING3,
+    /** Read one byte from I/O port u64Arg, for measuring I/O port round trips. */
+    VMMR0_DO_TEST_IO_PORT_READ,
 
     /** The usual 32-bit type blow up. */
     VMMR0_DO_32BIT_HACK = 0x7fffffff
@@ -3294,19 +3294,16 @@ DECLINLINE(bool) ASMMemIsZeroPage(void const *pvPage)
    uintptr_t const *puPtr = (uintptr_t const *)pvPage;
    int              cLeft = RT_ASM_PAGE_SIZE / sizeof(uintptr_t) / 8;
    Assert(!((uintptr_t)pvPage & 15));
+   /* Most non-zero pages fail on the first word.  After that we fold a cache
+      line at a time so there is only one branch per line, which also lets the
+      compiler do it in vector registers. */
+   if (puPtr[0])
+       return false;
    for (;;)
    {
-       if (puPtr[0])        return false;
-       if (puPtr[4])        return false;
-
-       if (puPtr[2])        return false;
-       if (puPtr[6])        return false;
-
-       if (puPtr[1])        return false;
-       if (puPtr[5])        return false;
-
-       if (puPtr[3])        return false;
-       if (puPtr[7])        return false;
+       if (  (puPtr[0] | puPtr[1] | puPtr[2] | puPtr[3])
+           | (puPtr[4] | puPtr[5] | puPtr[6] | puPtr[7]))
+           return false;
 
        if (!--cLeft)
            return true;
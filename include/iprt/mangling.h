@@ -826,6 +826,7 @@
 # define RTMemWipeThoroughly                            RT_MANGLER(RTMemWipeThoroughly)
 # define RTMpCpuId                                      RT_MANGLER(RTMpCpuId)
 # define RTMpCpuIdFromSetIndex                          RT_MANGLER(RTMpCpuIdFromSetIndex)
+# define RTMpCpuIdToNumaNode                            RT_MANGLER(RTMpCpuIdToNumaNode)
 # define RTMpCpuIdToSetIndex                            RT_MANGLER(RTMpCpuIdToSetIndex)
 # define RTMpGetArraySize                               RT_MANGLER(RTMpGetArraySize)
 # define RTMpGetCount                                   RT_MANGLER(RTMpGetCount)
@@ -833,6 +834,8 @@
 # define RTMpGetDescription                             RT_MANGLER(RTMpGetDescription)
 # define RTMpGetMaxCpuId                                RT_MANGLER(RTMpGetMaxCpuId)
 # define RTMpGetMaxFrequency                            RT_MANGLER(RTMpGetMaxFrequency)
+# define RTMpGetNumaNodeCount                           RT_MANGLER(RTMpGetNumaNodeCount)
+# define RTMpGetNumaNodeSet                             RT_MANGLER(RTMpGetNumaNodeSet)
 # define RTMpGetOnlineCount                             RT_MANGLER(RTMpGetOnlineCount)
 # define RTMpGetOnlineSet                               RT_MANGLER(RTMpGetOnlineSet)
 # define RTMpGetPresentCount                            RT_MANGLER(RTMpGetPresentCount)
@@ -861,6 +864,7 @@
 # define RTMsgWarning                                   RT_MANGLER(RTMsgWarning)
 # define RTMsgWarningV                                  RT_MANGLER(RTMsgWarningV)
 # define RTNetIPv4AddDataChecksum                       RT_MANGLER(RTNetIPv4AddDataChecksum)
+# define RTNetIPv4AddDataChecksumCopy                   RT_MANGLER(RTNetIPv4AddDataChecksumCopy)
 # define RTNetIPv4AddTCPChecksum                        RT_MANGLER(RTNetIPv4AddTCPChecksum)
 # define RTNetIPv4AddUDPChecksum                        RT_MANGLER(RTNetIPv4AddUDPChecksum)
 # define RTNetIPv4FinalizeChecksum                      RT_MANGLER(RTNetIPv4FinalizeChecksum)
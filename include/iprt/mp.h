@@ -199,6 +199,34 @@ RTDECL(uint32_t) RTMpGetMaxFrequency(RTCPUID idCpu);
  */
 RTDECL(int) RTMpGetDescription(RTCPUID idCpu, char *pszBuf, size_t cbBuf);
 
+/**
+ * Gets the number of NUMA nodes in the system.
+ *
+ * Node IDs are not necessarily contiguous, this is one more than the highest
+ * node ID.  Systems without NUMA support or where the topology is unknown
+ * report a single node, 0, containing all the CPUs.
+ *
+ * @returns The node count, at least 1.
+ */
+RTDECL(uint32_t) RTMpGetNumaNodeCount(void);
+
+/**
+ * Gets the NUMA node a CPU belongs to.
+ *
+ * @returns The node ID.  0 if unknown.
+ * @param   idCpu       The identifier of the CPU.
+ */
+RTDECL(uint32_t) RTMpCpuIdToNumaNode(RTCPUID idCpu);
+
+/**
+ * Gets the set of CPUs belonging to a NUMA node.
+ *
+ * @returns pSet.  Empty if the node doesn't exist.
+ * @param   idNode      The node ID.
+ * @param   pSet        Where to put the set.
+ */
+RTDECL(PRTCPUSET) RTMpGetNumaNodeSet(uint32_t idNode, PRTCPUSET pSet);
+
 
 #ifdef IN_RING0
 
@@ -0,0 +1,411 @@
+/* $Id$ */
+/** @file
+ * VBoxTraceBinConv - Converts DBGF binary trace files to Chrome trace JSON.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <VBox/vmm/dbgftrace.h>
+
+#include <iprt/assert.h>
+#include <iprt/buildconfig.h>
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/getopt.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/message.h>
+#include <iprt/process.h>
+#include <iprt/stream.h>
+#include <iprt/string.h>
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * Per thread conversion state.
+ */
+typedef struct TRACECONVTHREAD
+{
+    /** Set if a HM exit slice is open. */
+    bool                fExitOpen;
+    /** Set if a timer callback slice is open. */
+    bool                fTimerOpen;
+} TRACECONVTHREAD;
+
+/**
+ * The conversion state.
+ */
+typedef struct TRACECONV
+{
+    /** The output stream. */
+    PRTSTREAM           pOut;
+    /** The TSC frequency. */
+    uint64_t            u64TscHz;
+    /** The TSC value corresponding to time zero. */
+    uint64_t            u64TscBase;
+    /** The number of virtual CPUs, the thread ID used for the shared ring. */
+    uint32_t            cCpus;
+    /** The number of events written so far. */
+    uint64_t            cEvents;
+    /** Per thread state, cCpus + 1 entries. */
+    TRACECONVTHREAD    *paThreads;
+} TRACECONV;
+/** Pointer to the conversion state. */
+typedef TRACECONV *PTRACECONV;
+
+
+/**
+ * Starts an event, writing the fields common to all events.
+ *
+ * @param   pThis       The conversion state.
+ * @param   pszPhase    The Chrome trace phase ("B", "E", "i", ...).
+ * @param   pszCat      The category.
+ * @param   pszName     The event name.
+ * @param   idThread    The thread ID.
+ * @param   u64Tsc      The TSC of the event.
+ */
+static void traceConvEvtStart(PTRACECONV pThis, const char *pszPhase, const char *pszCat, const char *pszName,
+                              uint32_t idThread, uint64_t u64Tsc)
+{
+    uint64_t cNs = u64Tsc > pThis->u64TscBase
+                 ? (uint64_t)((double)(u64Tsc - pThis->u64TscBase) * 1000000000.0 / (double)pThis->u64TscHz)
+                 : 0;
+    RTStrmPrintf(pThis->pOut, "%s\n{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%RU64.%03RU64",
+                 pThis->cEvents ? "," : "", pszPhase, pszCat, pszName, idThread, cNs / 1000, cNs % 1000);
+    pThis->cEvents++;
+}
+
+
+/**
+ * Writes a complete event without arguments.
+ *
+ * @param   pThis       The conversion state.
+ * @param   pszPhase    The Chrome trace phase.
+ * @param   pszCat      The category.
+ * @param   pszName     The event name.
+ * @param   idThread    The thread ID.
+ * @param   u64Tsc      The TSC of the event.
+ */
+static void traceConvEvtSimple(PTRACECONV pThis, const char *pszPhase, const char *pszCat, const char *pszName,
+                               uint32_t idThread, uint64_t u64Tsc)
+{
+    traceConvEvtStart(pThis, pszPhase, pszCat, pszName, idThread, u64Tsc);
+    RTStrmPrintf(pThis->pOut, "}");
+}
+
+
+/**
+ * Closes the open slices of a thread.
+ *
+ * @param   pThis       The conversion state.
+ * @param   idThread    The thread ID.
+ * @param   u64Tsc      The TSC to close them at.
+ * @param   fExitToo    Whether to close the HM exit slice as well.
+ */
+static void traceConvCloseSlices(PTRACECONV pThis, uint32_t idThread, uint64_t u64Tsc, bool fExitToo)
+{
+    TRACECONVTHREAD *pThread = &pThis->paThreads[idThread];
+    if (pThread->fTimerOpen)
+    {
+        traceConvEvtSimple(pThis, "E", "timer", "timer", idThread, u64Tsc);
+        pThread->fTimerOpen = false;
+    }
+    if (fExitToo && pThread->fExitOpen)
+    {
+        traceConvEvtSimple(pThis, "E", "hm", "exit", idThread, u64Tsc);
+        pThread->fExitOpen = false;
+    }
+}
+
+
+/**
+ * Converts one record.
+ *
+ * @param   pThis       The conversion state.
+ * @param   pRec        The record.
+ */
+static void traceConvRecord(PTRACECONV pThis, PCDBGFTRACEBINREC pRec)
+{
+    uint32_t const   idThread = pRec->idCpu < pThis->cCpus ? pRec->idCpu : pThis->cCpus;
+    TRACECONVTHREAD *pThread  = &pThis->paThreads[idThread];
+    PRTSTREAM        pOut     = pThis->pOut;
+    char             szName[64];
+
+    switch (pRec->u16Evt)
+    {
+        case DBGFTRACEBINEVT_HM_EXIT:
+            /* Exits that went to ring-3 have no matching resume, close them here. */
+            traceConvCloseSlices(pThis, idThread, pRec->u64Tsc, true /*fExitToo*/);
+            RTStrPrintf(szName, sizeof(szName), "exit %u", pRec->u32Arg);
+            traceConvEvtStart(pThis, "B", "hm", szName, idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"args\":{\"reason\":%u,\"rip\":\"%#RX64\",\"info\":\"%#RX64\"}}",
+                         pRec->u32Arg, pRec->u64Arg1, pRec->u64Arg2);
+            pThread->fExitOpen = true;
+            break;
+
+        case DBGFTRACEBINEVT_HM_RESUME:
+            traceConvCloseSlices(pThis, idThread, pRec->u64Tsc, true /*fExitToo*/);
+            break;
+
+        case DBGFTRACEBINEVT_IOPORT_READ:
+        case DBGFTRACEBINEVT_IOPORT_WRITE:
+            traceConvEvtStart(pThis, "i", "ioport", pRec->u16Evt == DBGFTRACEBINEVT_IOPORT_READ ? "in" : "out",
+                              idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"s\":\"t\",\"args\":{\"port\":\"%#x\",\"value\":\"%#RX64\",\"cb\":%RU64}}",
+                         pRec->u32Arg, pRec->u64Arg1, pRec->u64Arg2);
+            break;
+
+        case DBGFTRACEBINEVT_MMIO_READ:
+        case DBGFTRACEBINEVT_MMIO_WRITE:
+            traceConvEvtStart(pThis, "i", "mmio", pRec->u16Evt == DBGFTRACEBINEVT_MMIO_READ ? "mmio read" : "mmio write",
+                              idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"s\":\"t\",\"args\":{\"addr\":\"%#RX64\",\"value\":\"%#RX64\",\"cb\":%u}}",
+                         pRec->u64Arg1, pRec->u64Arg2, pRec->u32Arg);
+            break;
+
+        case DBGFTRACEBINEVT_IRQ:
+            RTStrPrintf(szName, sizeof(szName), "irq %u", pRec->u32Arg);
+            traceConvEvtStart(pThis, "i", "irq", szName, idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"s\":\"t\",\"args\":{\"level\":%RU64,\"target\":\"%s\"}}",
+                         pRec->u64Arg1, pRec->u64Arg2 ? "ioapic" : "isa");
+            break;
+
+        case DBGFTRACEBINEVT_TIMER_FIRE:
+            traceConvCloseSlices(pThis, idThread, pRec->u64Tsc, false /*fExitToo*/);
+            traceConvEvtStart(pThis, "B", "timer", "timer", idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"args\":{\"clock\":%u,\"expire\":%RU64,\"timer\":\"%#RX64\"}}",
+                         pRec->u32Arg, pRec->u64Arg1, pRec->u64Arg2);
+            pThread->fTimerOpen = true;
+            break;
+
+        case DBGFTRACEBINEVT_TIMER_DONE:
+            traceConvCloseSlices(pThis, idThread, pRec->u64Tsc, false /*fExitToo*/);
+            break;
+
+        case DBGFTRACEBINEVT_DISK_SUBMIT:
+        case DBGFTRACEBINEVT_DISK_COMPLETE:
+            traceConvEvtStart(pThis, pRec->u16Evt == DBGFTRACEBINEVT_DISK_SUBMIT ? "b" : "e", "disk", "disk request",
+                              idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"id\":\"%#RX64\",\"args\":{\"offset\":%RU64,\"cb\":%u}}",
+                         pRec->u64Arg2, pRec->u64Arg1, pRec->u32Arg);
+            break;
+
+        case DBGFTRACEBINEVT_NET_XMIT:
+        case DBGFTRACEBINEVT_NET_RECV:
+            traceConvEvtStart(pThis, "i", "net", pRec->u16Evt == DBGFTRACEBINEVT_NET_XMIT ? "xmit" : "recv",
+                              idThread, pRec->u64Tsc);
+            RTStrmPrintf(pOut, ",\"s\":\"t\",\"args\":{\"instance\":%RU64,\"cb\":%u}}", pRec->u64Arg1, pRec->u32Arg);
+            break;
+
+        default:
+            /* Unknown events from newer writers are silently skipped. */
+            break;
+    }
+}
+
+
+/**
+ * Converts a binary trace file.
+ *
+ * @returns Program exit code.
+ * @param   pszInput        The input file name.
+ * @param   pszOutput       The output file name, NULL for stdout.
+ */
+static RTEXITCODE traceConvFile(const char *pszInput, const char *pszOutput)
+{
+    /*
+     * Read and validate the header.
+     */
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, pszInput, RTFILE_O_READ | RTFILE_O_OPEN | RTFILE_O_DENY_WRITE);
+    if (RT_FAILURE(rc))
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to open '%s': %Rrc", pszInput, rc);
+
+    uint64_t cbFile;
+    rc = RTFileGetSize(hFile, &cbFile);
+    DBGFTRACEBINFILEHDR Hdr;
+    if (RT_SUCCESS(rc))
+        rc = RTFileRead(hFile, &Hdr, sizeof(Hdr), NULL);
+    if (RT_FAILURE(rc))
+    {
+        RTFileClose(hFile);
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to read the header of '%s': %Rrc", pszInput, rc);
+    }
+    if (   memcmp(Hdr.szMagic, DBGFTRACEBINFILEHDR_MAGIC, sizeof(DBGFTRACEBINFILEHDR_MAGIC))
+        || Hdr.uVersion != DBGFTRACEBINFILEHDR_VERSION
+        || Hdr.cbRec != sizeof(DBGFTRACEBINREC)
+        || !Hdr.u64TscHz
+        || !Hdr.cCpus
+        || Hdr.cCpus >= DBGFTRACEBIN_NIL_CPU)
+    {
+        RTFileClose(hFile);
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "'%s' is not a supported binary trace file", pszInput);
+    }
+
+    /* The records must fill the rest of the file exactly, that also keeps
+       the buffer size below from overflowing. */
+    uint64_t const cbRecs = (uint64_t)Hdr.cRecs * sizeof(DBGFTRACEBINREC);
+    if (   cbFile - sizeof(Hdr) != cbRecs
+        || (size_t)cbRecs != cbRecs)
+    {
+        RTFileClose(hFile);
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "'%s' is damaged: %u records in the header, %RU64 bytes of records in the file",
+                              pszInput, Hdr.cRecs, cbFile - sizeof(Hdr));
+    }
+
+    /*
+     * Read the records and find the earliest TSC.
+     */
+    PDBGFTRACEBINREC paRecs = (PDBGFTRACEBINREC)RTMemAlloc(RT_MAX((size_t)cbRecs, sizeof(DBGFTRACEBINREC)));
+    TRACECONVTHREAD *paThreads = (TRACECONVTHREAD *)RTMemAllocZ((Hdr.cCpus + 1) * sizeof(TRACECONVTHREAD));
+    if (!paRecs || !paThreads)
+    {
+        RTMemFree(paRecs);
+        RTMemFree(paThreads);
+        RTFileClose(hFile);
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Out of memory (%u records)", Hdr.cRecs);
+    }
+    rc = RTFileRead(hFile, paRecs, (size_t)cbRecs, NULL);
+    RTFileClose(hFile);
+    if (RT_FAILURE(rc))
+    {
+        RTMemFree(paRecs);
+        RTMemFree(paThreads);
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to read %u records from '%s': %Rrc", Hdr.cRecs, pszInput, rc);
+    }
+
+    TRACECONV This;
+    This.pOut       = g_pStdOut;
+    This.u64TscHz   = Hdr.u64TscHz;
+    This.u64TscBase = Hdr.u64TscDump;
+    This.cCpus      = Hdr.cCpus;
+    This.cEvents    = 0;
+    This.paThreads  = paThreads;
+    for (uint32_t i = 0; i < Hdr.cRecs; i++)
+        if (paRecs[i].u64Tsc < This.u64TscBase)
+            This.u64TscBase = paRecs[i].u64Tsc;
+
+    if (pszOutput)
+    {
+        rc = RTStrmOpen(pszOutput, "w", &This.pOut);
+        if (RT_FAILURE(rc))
+        {
+            RTMemFree(paRecs);
+            RTMemFree(paThreads);
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to create '%s': %Rrc", pszOutput, rc);
+        }
+    }
+
+    /*
+     * Write the JSON.  The records of each ring are in order, which is all
+     * the slice pairing needs; the viewer sorts the rest.
+     */
+    RTStrmPrintf(This.pOut, "{\"traceEvents\":[");
+    for (uint32_t idThread = 0; idThread <= Hdr.cCpus; idThread++)
+    {
+        RTStrmPrintf(This.pOut, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                     This.cEvents ? "," : "", idThread);
+        if (idThread < Hdr.cCpus)
+            RTStrmPrintf(This.pOut, "EMT #%u\"}}", idThread);
+        else
+            RTStrmPrintf(This.pOut, "other\"}}");
+        This.cEvents++;
+    }
+
+    uint64_t u64TscLast = This.u64TscBase;
+    for (uint32_t i = 0; i < Hdr.cRecs; i++)
+    {
+        traceConvRecord(&This, &paRecs[i]);
+        if (paRecs[i].u64Tsc > u64TscLast)
+            u64TscLast = paRecs[i].u64Tsc;
+    }
+    for (uint32_t idThread = 0; idThread <= Hdr.cCpus; idThread++)
+        traceConvCloseSlices(&This, idThread, u64TscLast, true /*fExitToo*/);
+
+    RTStrmPrintf(This.pOut,
+                 "\n],\n\"displayTimeUnit\":\"ns\",\n"
+                 "\"otherData\":{\"tscHz\":%RU64,\"cpus\":%u,\"records\":%u,\"lost\":%RU64}}\n",
+                 Hdr.u64TscHz, Hdr.cCpus, Hdr.cRecs, Hdr.cRecsLost);
+
+    RTEXITCODE rcExit = RTEXITCODE_SUCCESS;
+    if (pszOutput)
+    {
+        rc = RTStrmClose(This.pOut);
+        if (RT_FAILURE(rc))
+            rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "Error writing '%s': %Rrc", pszOutput, rc);
+    }
+    RTMemFree(paRecs);
+    RTMemFree(paThreads);
+    return rcExit;
+}
+
+
+int main(int argc, char **argv)
+{
+    int rc = RTR3InitExe(argc, &argv, 0);
+    if (RT_FAILURE(rc))
+        return RTMsgInitFailure(rc);
+
+    static const RTGETOPTDEF s_aOptions[] =
+    {
+        { "--output",   'o', RTGETOPT_REQ_STRING },
+    };
+
+    const char     *pszInput  = NULL;
+    const char     *pszOutput = NULL;
+    RTGETOPTUNION   ValueUnion;
+    RTGETOPTSTATE   GetState;
+    RTGetOptInit(&GetState, argc, argv, &s_aOptions[0], RT_ELEMENTS(s_aOptions), 1, RTGETOPTINIT_FLAGS_OPTS_FIRST);
+    while ((rc = RTGetOpt(&GetState, &ValueUnion)))
+    {
+        switch (rc)
+        {
+            case 'o':
+                pszOutput = ValueUnion.psz;
+                break;
+
+            case VINF_GETOPT_NOT_OPTION:
+                if (pszInput)
+                    return RTMsgErrorExit(RTEXITCODE_SYNTAX, "Only one input file, please");
+                pszInput = ValueUnion.psz;
+                break;
+
+            case 'h':
+                RTPrintf("usage: %s [--output <file.json>] <trace.bin>\n"
+                         "\n"
+                         "Converts a binary trace written by DBGFR3TraceBinDump (see the DBGF/TraceBinFile\n"
+                         "setting) to Chrome trace event JSON, which can be loaded into chrome://tracing\n"
+                         "or Perfetto.  Writes to stdout by default.\n",
+                         RTProcShortName());
+                return RTEXITCODE_SUCCESS;
+
+            case 'V':
+                RTPrintf("%sr%u\n", RTBldCfgVersion(), RTBldCfgRevision());
+                return RTEXITCODE_SUCCESS;
+
+            default:
+                return RTGetOptPrintError(rc, &ValueUnion);
+        }
+    }
+    if (!pszInput)
+        return RTMsgErrorExit(RTEXITCODE_SYNTAX, "No input file specified");
+
+    return traceConvFile(pszInput, pszOutput);
+}
+
@@ -0,0 +1,279 @@
+/* $Id$ */
+/** @file
+ * VBoxTraceBinConv Testcase - Converting binary trace dumps.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <VBox/vmm/dbgftrace.h>
+
+#include <iprt/env.h>
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/process.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The number of virtual CPUs in the test dumps. */
+#define TST_CPUS            2
+/** The TSC frequency of the test dumps. */
+#define TST_TSC_HZ          UINT64_C(2000000000)
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+/** The converter executable. */
+static char                 g_szConv[RTPATH_MAX];
+/** The dump file. */
+static char                 g_szDump[RTPATH_MAX];
+/** The JSON file. */
+static char                 g_szJson[RTPATH_MAX];
+
+/** The records of the test dump, ring by ring the way DBGFR3TraceBinDump
+ * writes them. */
+static const DBGFTRACEBINREC g_aRecs[] =
+{
+    /* u64Tsc,  u16Evt,                          idCpu,                u32Arg, u64Arg1,              u64Arg2 */
+    { 1000,     DBGFTRACEBINEVT_HM_EXIT,         0,                    30,     UINT64_C(0xfff0),     0 },
+    { 1100,     DBGFTRACEBINEVT_IOPORT_WRITE,    0,                    0x80,   0x42,                 1 },
+    { 1200,     DBGFTRACEBINEVT_HM_RESUME,       0,                    0,      0,                    0 },
+    { 1050,     DBGFTRACEBINEVT_TIMER_FIRE,      1,                    0,      UINT64_C(123456),     7 },
+    { 1150,     DBGFTRACEBINEVT_TIMER_DONE,      1,                    0,      0,                    7 },
+    { 1300,     DBGFTRACEBINEVT_MMIO_WRITE,      1,                    4,      UINT64_C(0xfee00000), 0x1234 },
+    { 1010,     DBGFTRACEBINEVT_DISK_SUBMIT,     DBGFTRACEBIN_NIL_CPU, 4096,   _1M,                  1 },
+    { 1020,     DBGFTRACEBINEVT_NET_XMIT,        DBGFTRACEBIN_NIL_CPU, 1514,   0,                    0 },
+    { 1400,     DBGFTRACEBINEVT_DISK_COMPLETE,   DBGFTRACEBIN_NIL_CPU, 4096,   _1M,                  1 },
+    { 1500,     DBGFTRACEBINEVT_END + 1,         DBGFTRACEBIN_NIL_CPU, 0,      0,                    0 },
+};
+/** The events the converter makes of g_aRecs: the thread names, the exit
+ * and timer slices, the I/O port, MMIO and network instants and the disk
+ * request.  The unknown event is dropped. */
+#define TST_EVENTS          (TST_CPUS + 1 + 2 + 1 + 2 + 1 + 1 + 2)
+
+
+static void tstInitHdr(PDBGFTRACEBINFILEHDR pHdr, uint32_t cRecs)
+{
+    RT_ZERO(*pHdr);
+    memcpy(pHdr->szMagic, DBGFTRACEBINFILEHDR_MAGIC, sizeof(DBGFTRACEBINFILEHDR_MAGIC));
+    pHdr->uVersion      = DBGFTRACEBINFILEHDR_VERSION;
+    pHdr->cbRec         = sizeof(DBGFTRACEBINREC);
+    pHdr->u64TscHz      = TST_TSC_HZ;
+    pHdr->u64TscDump    = 2000;
+    pHdr->u64NanoTSDump = 1000;
+    pHdr->cCpus         = TST_CPUS;
+    pHdr->cRecs         = cRecs;
+    pHdr->cRecsLost     = 5;
+}
+
+
+/**
+ * Writes a dump file with the given header and the first @a cRecs records
+ * of g_aRecs.
+ */
+static int tstWriteDump(DBGFTRACEBINFILEHDR const *pHdr, uint32_t cRecs)
+{
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, g_szDump, RTFILE_O_WRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_WRITE);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTFileWrite(hFile, pHdr, sizeof(*pHdr), NULL);
+        if (RT_SUCCESS(rc) && cRecs)
+            rc = RTFileWrite(hFile, g_aRecs, cRecs * sizeof(g_aRecs[0]), NULL);
+        int rc2 = RTFileClose(hFile);
+        if (RT_SUCCESS(rc))
+            rc = rc2;
+    }
+    return rc;
+}
+
+
+/**
+ * Runs the converter on the dump file.
+ *
+ * @returns The converter exit code, -1 if it didn't exit normally.
+ */
+static int tstRunConv(void)
+{
+    RTFileDelete(g_szJson);
+    const char *papszArgs[] = { g_szConv, "--output", g_szJson, g_szDump, NULL };
+    RTPROCESS hProcess;
+    int rc = RTProcCreate(g_szConv, papszArgs, RTENV_DEFAULT, 0 /*fFlags*/, &hProcess);
+    if (RT_FAILURE(rc))
+    {
+        RTTestFailed(g_hTest, "RTProcCreate(%s) -> %Rrc", g_szConv, rc);
+        return -1;
+    }
+    RTPROCSTATUS ProcStatus;
+    rc = RTProcWait(hProcess, RTPROCWAIT_FLAGS_BLOCK, &ProcStatus);
+    if (RT_FAILURE(rc) || ProcStatus.enmReason != RTPROCEXITREASON_NORMAL)
+        return -1;
+    return ProcStatus.iStatus;
+}
+
+
+static size_t tstCountOccurrences(const char *psz, const char *pszNeedle)
+{
+    size_t cHits = 0;
+    while ((psz = strstr(psz, pszNeedle)) != NULL)
+    {
+        cHits++;
+        psz += strlen(pszNeedle);
+    }
+    return cHits;
+}
+
+
+/**
+ * Converts a dump and checks that every record made it into the JSON.
+ */
+static void tstRoundTrip(void)
+{
+    RTTestSub(g_hTest, "Round trip");
+
+    DBGFTRACEBINFILEHDR Hdr;
+    tstInitHdr(&Hdr, RT_ELEMENTS(g_aRecs));
+    RTTESTI_CHECK_RC_RETV(tstWriteDump(&Hdr, RT_ELEMENTS(g_aRecs)), VINF_SUCCESS);
+    RTTESTI_CHECK_RETV(tstRunConv() == RTEXITCODE_SUCCESS);
+
+    char  *pszJson;
+    size_t cbJson;
+    RTTESTI_CHECK_RC_RETV(RTFileReadAll(g_szJson, (void **)&pszJson, &cbJson), VINF_SUCCESS);
+    char *pszCopy = (char *)RTMemDupEx(pszJson, cbJson, 1);
+    RTFileReadAllFree(pszJson, cbJson);
+    RTTESTI_CHECK_RETV(pszCopy != NULL);
+
+    RTTESTI_CHECK(!strncmp(pszCopy, "{\"traceEvents\":[", sizeof("{\"traceEvents\":[") - 1));
+    size_t cEvents = tstCountOccurrences(pszCopy, "{\"ph\":");
+    RTTESTI_CHECK_MSG(cEvents == TST_EVENTS, ("%zu events, expected %u\n", cEvents, TST_EVENTS));
+    RTTESTI_CHECK(tstCountOccurrences(pszCopy, "\"ph\":\"B\"") == tstCountOccurrences(pszCopy, "\"ph\":\"E\""));
+    RTTESTI_CHECK(tstCountOccurrences(pszCopy, "\"ph\":\"b\"") == 1);
+    RTTESTI_CHECK(tstCountOccurrences(pszCopy, "\"ph\":\"e\"") == 1);
+    RTTESTI_CHECK(strstr(pszCopy, "\"name\":\"exit 30\"") != NULL);
+    RTTESTI_CHECK(strstr(pszCopy, "\"addr\":\"0xfee00000\"") != NULL);
+
+    char szTail[128];
+    RTStrPrintf(szTail, sizeof(szTail), "\"tscHz\":%RU64,\"cpus\":%u,\"records\":%u,\"lost\":5",
+                TST_TSC_HZ, TST_CPUS, (unsigned)RT_ELEMENTS(g_aRecs));
+    RTTESTI_CHECK_MSG(strstr(pszCopy, szTail) != NULL, ("%s\n", pszCopy));
+    RTMemFree(pszCopy);
+
+    /* An empty dump is fine too. */
+    tstInitHdr(&Hdr, 0);
+    RTTESTI_CHECK_RC_RETV(tstWriteDump(&Hdr, 0), VINF_SUCCESS);
+    RTTESTI_CHECK(tstRunConv() == RTEXITCODE_SUCCESS);
+}
+
+
+/**
+ * Damaged dumps must be refused without producing any output.
+ */
+static void tstDamaged(void)
+{
+    RTTestSub(g_hTest, "Damaged");
+
+    static const struct
+    {
+        const char *pszDesc;
+        uint32_t    cRecsHdr;
+        uint32_t    cRecsFile;
+        uint32_t    cbRec;
+        uint32_t    cCpus;
+    } s_aTests[] =
+    {
+        { "truncated",          RT_ELEMENTS(g_aRecs),   RT_ELEMENTS(g_aRecs) - 1,   sizeof(DBGFTRACEBINREC),        TST_CPUS },
+        { "trailing records",   1,                      RT_ELEMENTS(g_aRecs),       sizeof(DBGFTRACEBINREC),        TST_CPUS },
+        { "huge record count",  UINT32_MAX,             RT_ELEMENTS(g_aRecs),       sizeof(DBGFTRACEBINREC),        TST_CPUS },
+        { "record size",        RT_ELEMENTS(g_aRecs),   RT_ELEMENTS(g_aRecs),       sizeof(DBGFTRACEBINREC) * 2,    TST_CPUS },
+        { "no CPUs",            RT_ELEMENTS(g_aRecs),   RT_ELEMENTS(g_aRecs),       sizeof(DBGFTRACEBINREC),        0 },
+        { "too many CPUs",      RT_ELEMENTS(g_aRecs),   RT_ELEMENTS(g_aRecs),       sizeof(DBGFTRACEBINREC),        UINT32_MAX },
+    };
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aTests); i++)
+    {
+        DBGFTRACEBINFILEHDR Hdr;
+        tstInitHdr(&Hdr, s_aTests[i].cRecsHdr);
+        Hdr.cbRec = s_aTests[i].cbRec;
+        Hdr.cCpus = s_aTests[i].cCpus;
+        RTTESTI_CHECK_RC_BREAK(tstWriteDump(&Hdr, s_aTests[i].cRecsFile), VINF_SUCCESS);
+        int iStatus = tstRunConv();
+        RTTESTI_CHECK_MSG(iStatus == RTEXITCODE_FAILURE, ("%s: exit code %d\n", s_aTests[i].pszDesc, iStatus));
+        RTTESTI_CHECK_MSG(!RTFileExists(g_szJson), ("%s\n", s_aTests[i].pszDesc));
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, 0);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstVBoxTraceBinConv", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    /*
+     * The converter is either given on the command line or lives in the
+     * parent of the testcase directory.
+     */
+    int rc = VINF_SUCCESS;
+    if (argc > 1)
+        rc = RTStrCopy(g_szConv, sizeof(g_szConv), argv[1]);
+    else
+    {
+        rc = RTPathExecDir(g_szConv, sizeof(g_szConv));
+        if (RT_SUCCESS(rc))
+#ifdef RT_OS_WINDOWS
+            rc = RTPathAppend(g_szConv, sizeof(g_szConv), "../VBoxTraceBinConv.exe");
+#else
+            rc = RTPathAppend(g_szConv, sizeof(g_szConv), "../VBoxTraceBinConv");
+#endif
+    }
+    if (RT_SUCCESS(rc))
+        rc = RTPathTemp(g_szDump, sizeof(g_szDump));
+    if (RT_SUCCESS(rc))
+    {
+        char szName[64];
+        RTStrPrintf(szName, sizeof(szName), "tstVBoxTraceBinConv-%u.bin", RTProcSelf());
+        rc = RTStrCopy(g_szJson, sizeof(g_szJson), g_szDump);
+        if (RT_SUCCESS(rc))
+            rc = RTPathAppend(g_szDump, sizeof(g_szDump), szName);
+        RTStrPrintf(szName, sizeof(szName), "tstVBoxTraceBinConv-%u.json", RTProcSelf());
+        if (RT_SUCCESS(rc))
+            rc = RTPathAppend(g_szJson, sizeof(g_szJson), szName);
+    }
+    if (RT_FAILURE(rc))
+    {
+        RTTestFailed(g_hTest, "Setting up the paths failed: %Rrc", rc);
+        return RTTestSummaryAndDestroy(g_hTest);
+    }
+    if (!RTFileExists(g_szConv))
+        return RTTestSkipAndDestroy(g_hTest, "%s not found", g_szConv);
+
+    tstRoundTrip();
+    tstDamaged();
+
+    RTFileDelete(g_szDump);
+    RTFileDelete(g_szJson);
+    return RTTestSummaryAndDestroy(g_hTest);
+}
@@ -99,6 +99,13 @@
  * to allocating their buffers (see @bugref{5582}).
  */
 #define E1K_WITH_TXD_CACHE
+/*
+ * E1K_WITH_TXD_WB_BATCH causes E1000 to write back processed TX descriptors
+ * in as few physical memory writes as possible, instead of one write per
+ * descriptor, similar to write-back bursting of real hardware. TXDW interrupt
+ * is raised after the write-back. Requires E1K_WITH_TXD_CACHE.
+ */
+#define E1K_WITH_TXD_WB_BATCH
 /*
  * E1K_WITH_RXD_CACHE causes E1000 to fetch multiple RX descriptors in a
  * single physical memory read (or two if it wraps around the end of RX
@@ -118,6 +125,10 @@
 #define E1K_TXD_CACHE_SIZE 32u
 #endif /* E1K_WITH_TXD_CACHE */
 
+#if defined(E1K_WITH_TXD_WB_BATCH) && !defined(E1K_WITH_TXD_CACHE)
+# error "E1K_WITH_TXD_WB_BATCH requires E1K_WITH_TXD_CACHE"
+#endif
+
 #ifdef E1K_WITH_RXD_CACHE
 /*
  * E1K_RXD_CACHE_SIZE specifies the maximum number of RX descriptors stored
@@ -136,6 +147,7 @@
 #include <iprt/uuid.h>
 #include <VBox/vmm/pdmdev.h>
 #include <VBox/vmm/pdmnetifs.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/pdmnetinline.h>
 #include <VBox/param.h>
 #include "VBoxDD.h"
@@ -1045,7 +1057,7 @@ struct E1kState_st
 #if HC_ARCH_BITS != 32
     uint32_t                Alignment1;
 #endif
-    PDMCRITSECT cs;                  /**< Critical section - what is it protecting? */
+    PDMCRITSECTRW cs;                /**< Critical section - what is it protecting? */
     PDMCRITSECT csRx;                                     /**< RX Critical section. */
 #ifdef E1K_WITH_TX_CS
     PDMCRITSECT csTx;                                     /**< TX Critical section. */
@@ -1127,6 +1139,16 @@ struct E1kState_st
     bool        fGSO;
     /** TX: Number of bytes in next packet. */
     uint32_t    cbTxAlloc;
+#ifdef E1K_WITH_TXD_WB_BATCH
+    /** TX: Index in cache of the first descriptor pending write-back. */
+    uint8_t     iTxDWbFirst;
+    /** TX: Number of descriptors pending write-back, all of them have RS set. */
+    uint8_t     cTxDWb;
+    /** TX: Whether TXDW must be raised once pending descriptors are written. */
+    bool        fTxDWbIntPending;
+    /** TX: Index in the ring of the first descriptor pending write-back. */
+    uint32_t    iTxDWbRing;
+#endif /* E1K_WITH_TXD_WB_BATCH */
 
 #endif /* E1K_WITH_TXD_CACHE */
     /** GSO context. u8Type is set to PDMNETWORKGSOTYPE_INVALID when not
@@ -1207,6 +1229,8 @@ struct E1kState_st
     STAMCOUNTER                         StatTxPathFallback;
     STAMCOUNTER                         StatTxPathGSO;
     STAMCOUNTER                         StatTxPathRegular;
+    STAMCOUNTER                         StatTxDescWb;
+    STAMCOUNTER                         StatTxDescWbBatches;
     STAMCOUNTER                         StatPHYAccesses;
 
 #endif /* VBOX_WITH_STATISTICS */
@@ -1545,8 +1569,10 @@ DECLINLINE(void) e1kCancelTimer(E1KSTATE *pState, PTMTIMER pTimer)
     }
 }
 
-#define e1kCsEnter(ps, rc) PDMCritSectEnter(&ps->cs, rc)
-#define e1kCsLeave(ps) PDMCritSectLeave(&ps->cs)
+#define e1kCsEnter(ps, rc) PDMCritSectRwEnterExcl(&ps->cs, rc)
+#define e1kCsLeave(ps) PDMCritSectRwLeaveExcl(&ps->cs)
+#define e1kCsEnterShared(ps, rc) PDMCritSectRwEnterShared(&ps->cs, rc)
+#define e1kCsLeaveShared(ps) PDMCritSectRwLeaveShared(&ps->cs)
 
 #define e1kCsRxEnter(ps, rc) PDMCritSectEnter(&ps->csRx, rc)
 #define e1kCsRxLeave(ps) PDMCritSectLeave(&ps->csRx)
@@ -1612,6 +1638,10 @@ static void e1kHardReset(E1KSTATE *pState)
         pState->iTxDCurrent  = 0;
         pState->fGSO         = false;
         pState->cbTxAlloc    = 0;
+#ifdef E1K_WITH_TXD_WB_BATCH
+        pState->cTxDWb           = 0;
+        pState->fTxDWbIntPending = false;
+#endif /* E1K_WITH_TXD_WB_BATCH */
         e1kCsTxLeave(pState);
     }
 #endif /* E1K_WITH_TXD_CACHE */
@@ -1643,19 +1673,8 @@ static void e1kHardReset(E1KSTATE *pState)
  */
 static uint16_t e1kCSum16(const void *pvBuf, size_t cb)
 {
-    uint32_t  csum = 0;
-    uint16_t *pu16 = (uint16_t *)pvBuf;
-
-    while (cb > 1)
-    {
-        csum += *pu16++;
-        cb -= 2;
-    }
-    if (cb)
-        csum += *(uint8_t*)pu16;
-    while (csum >> 16)
-        csum = (csum >> 16) + (csum & 0xFFFF);
-    return ~csum;
+    bool fOdd = false;
+    return RTNetIPv4FinalizeChecksum(RTNetIPv4AddDataChecksum(pvBuf, cb, 0, &fOdd));
 }
 
 /**
@@ -1670,18 +1689,18 @@ static uint16_t e1kCSum16(const void *pvBuf, size_t cb)
 DECLINLINE(void) e1kPacketDump(E1KSTATE* pState, const uint8_t *cpPacket, size_t cb, const char *cszText)
 {
 #ifdef DEBUG
-    if (RT_LIKELY(e1kCsEnter(pState, VERR_SEM_BUSY) == VINF_SUCCESS))
+    if (RT_LIKELY(e1kCsEnterShared(pState, VERR_SEM_BUSY) == VINF_SUCCESS))
     {
         E1kLog(("%s --- %s packet #%d: ---\n",
-                INSTANCE(pState), cszText, ++pState->u32PktNo));
+                INSTANCE(pState), cszText, ASMAtomicIncU32(&pState->u32PktNo)));
         E1kLog3(("%.*Rhxd\n", cb, cpPacket));
-        e1kCsLeave(pState);
+        e1kCsLeaveShared(pState);
     }
 #else
-    if (RT_LIKELY(e1kCsEnter(pState, VERR_SEM_BUSY) == VINF_SUCCESS))
+    if (RT_LIKELY(e1kCsEnterShared(pState, VERR_SEM_BUSY) == VINF_SUCCESS))
     {
-        E1kLogRel(("E1000: %s packet #%d, seq=%x ack=%x\n", cszText, pState->u32PktNo++, ntohl(*(uint32_t*)(cpPacket+0x26)), ntohl(*(uint32_t*)(cpPacket+0x2A))));
-        e1kCsLeave(pState);
+        E1kLogRel(("E1000: %s packet #%d, seq=%x ack=%x\n", cszText, ASMAtomicIncU32(&pState->u32PktNo) - 1, ntohl(*(uint32_t*)(cpPacket+0x26)), ntohl(*(uint32_t*)(cpPacket+0x2A))));
+        e1kCsLeaveShared(pState);
     }
 #endif
 }
@@ -1820,12 +1839,34 @@ static void e1kPrintTDesc(E1KSTATE* pState, E1KTXDESC* pDesc, const char* cszDir
  */
 static int e1kRaiseInterrupt(E1KSTATE *pState, int rcBusy, uint32_t u32IntCause = 0)
 {
-    int rc = e1kCsEnter(pState, rcBusy);
+    /*
+     * The RX and TX threads get here for every packet, outside the device
+     * critical section, and most of the time the cause is masked or the
+     * interrupt is already raised.  Settle that with shared access so the
+     * threads don't serialize on it; ICR is only cleared exclusively.
+     */
+    int rc = e1kCsEnterShared(pState, rcBusy);
+    if (RT_UNLIKELY(rc != VINF_SUCCESS))
+        return rc;
+    ASMAtomicOrU32(&ICR, u32IntCause);
+    bool const fMasked = !(ICR & IMS);
+    bool const fRaised = pState->fIntRaised;
+    e1kCsLeaveShared(pState);
+    if (fMasked || fRaised)
+    {
+        E1K_INC_ISTAT_CNT(pState->uStatIntTry);
+        if (fMasked)
+            E1K_INC_ISTAT_CNT(pState->uStatIntMasked);
+        else
+            E1K_INC_ISTAT_CNT(pState->uStatIntSkip);
+        return VINF_SUCCESS;
+    }
+
+    rc = e1kCsEnter(pState, rcBusy);
     if (RT_UNLIKELY(rc != VINF_SUCCESS))
         return rc;
 
     E1K_INC_ISTAT_CNT(pState->uStatIntTry);
-    ICR |= u32IntCause;
     if (ICR & IMS)
     {
 #if 0
@@ -2210,6 +2251,8 @@ static int e1kHandleRxPacket(E1KSTATE* pState, const void *pvBuf, size_t cb, E1K
     if (RT_UNLIKELY(rc != VINF_SUCCESS))
         return rc;
 
+    DBGFTRACE_PDMDEV_BIN(STATE_TO_DEVINS(pState), DBGFTRACEBINEVT_NET_RECV, (uint32_t)cb,
+                         STATE_TO_DEVINS(pState)->iInstance, 0);
     if (cb > 70) /* unqualified guess */
         pState->led.Asserted.s.fReading = pState->led.Actual.s.fReading = 1;
 
@@ -3617,6 +3660,87 @@ DECLINLINE(void) e1kWriteBackDesc(E1KSTATE* pState, E1KTXDESC* pDesc, RTGCPHYS a
     PDMDevHlpPhysWrite(pState->CTX_SUFF(pDevIns), addr, pDesc, sizeof(E1KTXDESC));
 }
 
+#ifdef E1K_WITH_TXD_WB_BATCH
+/**
+ * Write back all descriptors pending write-back and raise TXDW if it was
+ * deferred.
+ *
+ * We need two physical writes in case the pending descriptors wrap around the
+ * end of TX descriptor ring.
+ *
+ * @param   pState      The device state structure.
+ * @thread  E1000_TX
+ */
+static void e1kTxDWbFlush(E1KSTATE* pState)
+{
+    unsigned nDescsTotal = TDLEN / sizeof(E1KTXDESC);
+    if (pState->cTxDWb && RT_LIKELY(pState->iTxDWbRing < nDescsTotal))
+    {
+        E1KTXDESC *pFirstDesc         = &pState->aTxDescriptors[pState->iTxDWbFirst];
+        RTGCPHYS   addrBase           = ((uint64_t)TDBAH << 32) + TDBAL;
+        unsigned   nDescsInSingleWrite = RT_MIN(pState->cTxDWb, nDescsTotal - pState->iTxDWbRing);
+        PDMDevHlpPhysWrite(pState->CTX_SUFF(pDevIns),
+                           addrBase + pState->iTxDWbRing * sizeof(E1KTXDESC),
+                           pFirstDesc, nDescsInSingleWrite * sizeof(E1KTXDESC));
+        if (pState->cTxDWb > nDescsInSingleWrite)
+            PDMDevHlpPhysWrite(pState->CTX_SUFF(pDevIns), addrBase,
+                               pFirstDesc + nDescsInSingleWrite,
+                               (pState->cTxDWb - nDescsInSingleWrite) * sizeof(E1KTXDESC));
+        E1kLog3(("%s Wrote back %u TX descriptors at ring index 0x%x\n",
+                 INSTANCE(pState), pState->cTxDWb, pState->iTxDWbRing));
+        STAM_COUNTER_INC(&pState->StatTxDescWbBatches);
+        STAM_COUNTER_ADD(&pState->StatTxDescWb, pState->cTxDWb);
+    }
+    pState->cTxDWb = 0;
+
+    if (pState->fTxDWbIntPending)
+    {
+        pState->fTxDWbIntPending = false;
+        E1K_INC_ISTAT_CNT(pState->uStatIntTx);
+        e1kRaiseInterrupt(pState, VERR_SEM_BUSY, ICR_TXDW);
+    }
+}
+
+/**
+ * Queue a processed descriptor for write-back.
+ *
+ * Only runs of consecutive descriptors with RS are batched.  A descriptor
+ * without RS is never written back: the guest may reuse it as soon as TDH has
+ * moved past it, so the pending write-backs are flushed before that happens.
+ *
+ * @param   pState      The device state structure.
+ * @param   pDesc       Pointer to the processed descriptor in the cache.
+ * @param   fReport     Whether the descriptor has to be written back.
+ * @thread  E1000_TX
+ */
+static void e1kTxDWbQueue(E1KSTATE* pState, E1KTXDESC* pDesc, bool fReport)
+{
+    unsigned iDesc = (unsigned)(pDesc - &pState->aTxDescriptors[0]);
+    Assert(iDesc < pState->nTxDFetched);
+
+    if (!fReport)
+    {
+        e1kTxDWbFlush(pState);
+        return;
+    }
+
+    if (pState->cTxDWb)
+    {
+        if (iDesc == (unsigned)pState->iTxDWbFirst + pState->cTxDWb)
+        {
+            pState->cTxDWb++;
+            return;
+        }
+        e1kTxDWbFlush(pState);
+    }
+
+    /* The cache is processed in ring order, TDH is the current descriptor. */
+    pState->iTxDWbFirst = iDesc;
+    pState->iTxDWbRing  = TDH;
+    pState->cTxDWb      = 1;
+}
+#endif /* E1K_WITH_TXD_WB_BATCH */
+
 /**
  * Transmit complete frame.
  *
@@ -3715,6 +3839,8 @@ static void e1kTransmitFrame(E1KSTATE* pState, bool fOnWorkerThread)
         {
             /* Release critical section to avoid deadlock in CanReceive */
             //e1kCsLeave(pState);
+            DBGFTRACE_PDMDEV_BIN(STATE_TO_DEVINS(pState), DBGFTRACEBINEVT_NET_XMIT, (uint32_t)cbFrame,
+                                 STATE_TO_DEVINS(pState)->iInstance, 0);
             STAM_PROFILE_START(&pState->CTX_SUFF_Z(StatTransmitSend), a);
             rc = pDrv->pfnSendBuf(pDrv, pSg, fOnWorkerThread);
             STAM_PROFILE_STOP(&pState->CTX_SUFF_Z(StatTransmitSend), a);
@@ -4235,7 +4361,12 @@ static void e1kDescReport(E1KSTATE* pState, E1KTXDESC* pDesc, RTGCPHYS addr)
     if (pDesc->legacy.cmd.fRS || pDesc->legacy.cmd.fRPS)
     {
         pDesc->legacy.dw3.fDD = 1; /* Descriptor Done */
+#ifdef E1K_WITH_TXD_WB_BATCH
+        NOREF(addr);
+        e1kTxDWbQueue(pState, pDesc, true /*fReport*/);
+#else /* !E1K_WITH_TXD_WB_BATCH */
         e1kWriteBackDesc(pState, pDesc, addr);
+#endif /* !E1K_WITH_TXD_WB_BATCH */
         if (pDesc->legacy.cmd.fEOP)
         {
 #ifdef E1K_USE_TX_TIMERS
@@ -4267,8 +4398,13 @@ static void e1kDescReport(E1KSTATE* pState, E1KTXDESC* pDesc, RTGCPHYS addr)
                 e1kCancelTimer(pState, pState->CTX_SUFF(pTADTimer));
 # endif /* E1K_NO_TAD */
 #endif /* E1K_USE_TX_TIMERS */
+#ifdef E1K_WITH_TXD_WB_BATCH
+                /* Raised by e1kTxDWbFlush once the descriptor is in guest memory. */
+                pState->fTxDWbIntPending = true;
+#else /* !E1K_WITH_TXD_WB_BATCH */
                 E1K_INC_ISTAT_CNT(pState->uStatIntTx);
                 e1kRaiseInterrupt(pState, VERR_SEM_BUSY, ICR_TXDW);
+#endif /* !E1K_WITH_TXD_WB_BATCH */
 #ifdef E1K_USE_TX_TIMERS
             }
 #endif /* E1K_USE_TX_TIMERS */
@@ -4277,6 +4413,9 @@ static void e1kDescReport(E1KSTATE* pState, E1KTXDESC* pDesc, RTGCPHYS addr)
     else
     {
         E1K_INC_ISTAT_CNT(pState->uStatTxNoRS);
+#ifdef E1K_WITH_TXD_WB_BATCH
+        e1kTxDWbQueue(pState, pDesc, false /*fReport*/);
+#endif /* E1K_WITH_TXD_WB_BATCH */
     }
 }
 
@@ -4852,6 +4991,10 @@ static int e1kXmitPacket(E1KSTATE *pState, bool fOnWorkerThread)
         {
             E1kLog2(("%s Low on transmit descriptors, raise ICR.TXD_LOW, len=%x thresh=%x\n",
                      INSTANCE(pState), e1kGetTxLen(pState), GET_BITS(TXDCTL, LWTHRESH)*8));
+#ifdef E1K_WITH_TXD_WB_BATCH
+            /* The guest will look for completed descriptors, let it find them. */
+            e1kTxDWbFlush(pState);
+#endif /* E1K_WITH_TXD_WB_BATCH */
             e1kRaiseInterrupt(pState, VERR_SEM_BUSY, ICR_TXD_LOW);
         }
         ++pState->iTxDCurrent;
@@ -5001,6 +5144,10 @@ static int e1kXmitPending(E1KSTATE *pState, bool fOnWorkerThread)
                 if (RT_FAILURE(rc))
                     goto out;
             }
+#ifdef E1K_WITH_TXD_WB_BATCH
+            /* The cache is about to be rearranged, write back what we have. */
+            e1kTxDWbFlush(pState);
+#endif /* E1K_WITH_TXD_WB_BATCH */
             uint8_t u8Remain = pState->nTxDFetched - pState->iTxDCurrent;
             if (RT_UNLIKELY(fIncomplete))
             {
@@ -5056,6 +5203,9 @@ static int e1kXmitPending(E1KSTATE *pState, bool fOnWorkerThread)
             e1kRaiseInterrupt(pState, VERR_SEM_BUSY, ICR_TXD_LOW);
         }
 out:
+#ifdef E1K_WITH_TXD_WB_BATCH
+        e1kTxDWbFlush(pState);
+#endif /* E1K_WITH_TXD_WB_BATCH */
         STAM_PROFILE_ADV_STOP(&pState->CTX_SUFF_Z(StatTransmit), a);
 
         /// @todo: uncomment: pState->uStatIntTXQE++;
@@ -6656,7 +6806,7 @@ static DECLCALLBACK(void) e1kDetach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t
 
     AssertLogRelReturnVoid(iLUN == 0);
 
-    PDMCritSectEnter(&pState->cs, VERR_SEM_BUSY);
+    PDMCritSectRwEnterExcl(&pState->cs, VERR_SEM_BUSY);
 
     /** @todo: r=pritesh still need to check if i missed
      * to clean something in this function
@@ -6670,7 +6820,7 @@ static DECLCALLBACK(void) e1kDetach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t
     pState->pDrvR0 = NIL_RTR0PTR;
     pState->pDrvRC = NIL_RTRCPTR;
 
-    PDMCritSectLeave(&pState->cs);
+    PDMCritSectRwLeaveExcl(&pState->cs);
 }
 
 /**
@@ -6692,7 +6842,7 @@ static DECLCALLBACK(int) e1kAttach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t f
 
     AssertLogRelReturn(iLUN == 0, VERR_PDM_NO_SUCH_LUN);
 
-    PDMCritSectEnter(&pState->cs, VERR_SEM_BUSY);
+    PDMCritSectRwEnterExcl(&pState->cs, VERR_SEM_BUSY);
 
     /*
      * Attach the driver.
@@ -6744,7 +6894,7 @@ static DECLCALLBACK(int) e1kAttach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t f
         e1kBringLinkUpDelayed(pState);
     }
 
-    PDMCritSectLeave(&pState->cs);
+    PDMCritSectRwLeaveExcl(&pState->cs);
     return rc;
 
 }
@@ -6844,7 +6994,7 @@ static DECLCALLBACK(int) e1kDestruct(PPDMDEVINS pDevIns)
 
     e1kDumpState(pState);
     E1kLog(("%s Destroying instance\n", INSTANCE(pState)));
-    if (PDMCritSectIsInitialized(&pState->cs))
+    if (PDMCritSectRwIsInitialized(&pState->cs))
     {
         if (pState->hEventMoreRxDescAvail != NIL_RTSEMEVENT)
         {
@@ -6856,7 +7006,7 @@ static DECLCALLBACK(int) e1kDestruct(PPDMDEVINS pDevIns)
         PDMR3CritSectDelete(&pState->csTx);
 #endif /* E1K_WITH_TX_CS */
         PDMR3CritSectDelete(&pState->csRx);
-        PDMR3CritSectDelete(&pState->cs);
+        PDMR3CritSectRwDelete(&pState->cs);
     }
     return VINF_SUCCESS;
 }
@@ -7358,7 +7508,7 @@ static DECLCALLBACK(int) e1kConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
         return rc;
 
     /* Initialize critical section */
-    rc = PDMDevHlpCritSectInit(pDevIns, &pState->cs, RT_SRC_POS, "%s", pState->szInstance);
+    rc = PDMDevHlpCritSectRwInit(pDevIns, &pState->cs, RT_SRC_POS, "%s", pState->szInstance);
     if (RT_FAILURE(rc))
         return rc;
     rc = PDMDevHlpCritSectInit(pDevIns, &pState->csRx, RT_SRC_POS, "%sRX", pState->szInstance);
@@ -7571,6 +7721,8 @@ static DECLCALLBACK(int) e1kConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
     PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatTxPathFallback,     STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Fallback TSE descriptor path",       "/Devices/E1k%d/TxPath/Fallback", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatTxPathGSO,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "GSO TSE descriptor path",            "/Devices/E1k%d/TxPath/GSO", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatTxPathRegular,      STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Regular descriptor path",            "/Devices/E1k%d/TxPath/Normal", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatTxDescWb,           STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of TX descriptors written back", "/Devices/E1k%d/TxDesc/WriteBack", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatTxDescWbBatches,    STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of TX descriptor write-back batches", "/Devices/E1k%d/TxDesc/WriteBackBatches", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatPHYAccesses,        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of PHY accesses",             "/Devices/E1k%d/PHYAccesses", iInstance);
 #endif /* VBOX_WITH_STATISTICS */
 
@@ -517,11 +517,14 @@ static DECLCALLBACK(void) vnetLinkUpTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, v
 
 /**
  * Handler for the wakeup signaller queue.
+ *
+ * Any number of pending signals (from several VCPUs) takes a single wakeup.
  */
-static DECLCALLBACK(bool) vnetCanRxQueueConsumer(PPDMDEVINS pDevIns, PPDMQUEUEITEMCORE pItem)
+static DECLCALLBACK(uint32_t) vnetCanRxQueueConsumerBatch(PPDMDEVINS pDevIns, PPDMQUEUEITEMCORE *papItems, uint32_t cItems)
 {
+    NOREF(papItems);
     vnetWakeupReceive(pDevIns);
-    return true;
+    return cItems;
 }
 
 #endif /* IN_RING3 */
@@ -1085,19 +1088,8 @@ DECLINLINE(PPDMNETWORKGSO) vnetSetupGsoCtx(PPDMNETWORKGSO pGso, VNETHDR const *p
 
 DECLINLINE(uint16_t) vnetCSum16(const void *pvBuf, size_t cb)
 {
-    uint32_t  csum = 0;
-    uint16_t *pu16 = (uint16_t *)pvBuf;
-
-    while (cb > 1)
-    {
-        csum += *pu16++;
-        cb -= 2;
-    }
-    if (cb)
-        csum += *(uint8_t*)pu16;
-    while (csum >> 16)
-        csum = (csum >> 16) + (csum & 0xFFFF);
-    return ~csum;
+    bool fOdd = false;
+    return RTNetIPv4FinalizeChecksum(RTNetIPv4AddDataChecksum(pvBuf, cb, 0, &fOdd));
 }
 
 DECLINLINE(void) vnetCompleteChecksum(uint8_t *pBuf, unsigned cbSize, uint16_t uStart, uint16_t uOffset)
@@ -2097,8 +2089,8 @@ static DECLCALLBACK(int) vnetConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMN
         return rc;
 
     /* Create the RX notifier signaller. */
-    rc = PDMDevHlpQueueCreate(pDevIns, sizeof(PDMQUEUEITEMCORE), 1, 0,
-                              vnetCanRxQueueConsumer, true, "VNet-Rcv", &pState->pCanRxQueueR3);
+    rc = PDMDevHlpQueueCreateBatch(pDevIns, sizeof(PDMQUEUEITEMCORE), 8, 0,
+                                   vnetCanRxQueueConsumerBatch, true, "VNet-Rcv", &pState->pCanRxQueueR3);
     if (RT_FAILURE(rc))
         return rc;
     pState->pCanRxQueueR0 = PDMQueueR0Ptr(pState->pCanRxQueueR3);
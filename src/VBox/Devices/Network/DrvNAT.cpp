@@ -714,6 +714,8 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
     unsigned int cBreak = 0;
 #else /* RT_OS_WINDOWS */
     unsigned int cPollNegRet = 0;
+    struct pollfd *polls = NULL;
+    int cPollsAlloc = 0;
 #endif /* !RT_OS_WINDOWS */
 
     LogFlow(("drvNATAsyncIoThread: pThis=%p\n", pThis));
@@ -734,10 +736,20 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
          */
 #ifndef RT_OS_WINDOWS
         nFDs = slirp_get_nsock(pThis->pNATState);
-        /* allocation for all sockets + Management pipe */
-        struct pollfd *polls = (struct pollfd *)RTMemAlloc((1 + nFDs) * sizeof(struct pollfd) + sizeof(uint32_t));
-        if (polls == NULL)
-            return VERR_NO_MEMORY;
+        /* allocation for all sockets + Management pipe, only grows (with
+         * VBOX_WITH_NAT_EPOLL slirp needs just one entry) */
+        if (cPollsAlloc < 1 + nFDs)
+        {
+            int cNew = RT_ALIGN_32(1 + nFDs, 64);
+            struct pollfd *pNew = (struct pollfd *)RTMemRealloc(polls, cNew * sizeof(struct pollfd) + sizeof(uint32_t));
+            if (pNew == NULL)
+            {
+                RTMemFree(polls);
+                return VERR_NO_MEMORY;
+            }
+            polls = pNew;
+            cPollsAlloc = cNew;
+        }
 
         /* don't pass the management pipe */
         slirp_select_fill(pThis->pNATState, &nFDs, &polls[1]);
@@ -787,7 +799,6 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
         }
         /* process _all_ outstanding requests but don't wait */
         RTReqQueueProcess(pThis->hSlirpReqQueue, 0);
-        RTMemFree(polls);
 
 #else /* RT_OS_WINDOWS */
         nFDs = -1;
@@ -824,6 +835,9 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
 #endif /* RT_OS_WINDOWS */
     }
 
+#ifndef RT_OS_WINDOWS
+    RTMemFree(polls);
+#endif
     return VINF_SUCCESS;
 }
 
@@ -1178,6 +1192,7 @@ static DECLCALLBACK(int) drvNATConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
                               "\0NextServer\0DNSProxy\0BindIP\0UseHostResolver\0"
                               "SlirpMTU\0AliasMode\0"
                               "SockRcv\0SockSnd\0TcpRcv\0TcpSnd\0"
+                              "SocketHashSize\0"
                               "ICMPCacheLimit\0"
                               "SoMaxConnection\0"
 #ifdef VBOX_WITH_DNSMAPPING_IN_HOSTRESOLVER
@@ -1309,6 +1324,7 @@ static DECLCALLBACK(int) drvNATConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
         SLIRP_SET_TUNING_VALUE("SockSnd", slirp_set_sndbuf);
         SLIRP_SET_TUNING_VALUE("TcpRcv", slirp_set_tcp_rcvspace);
         SLIRP_SET_TUNING_VALUE("TcpSnd", slirp_set_tcp_sndspace);
+        SLIRP_SET_TUNING_VALUE("SocketHashSize", slirp_set_socket_hash_size);
 
         slirp_register_statistics(pThis->pNATState, pDrvIns);
 #ifdef VBOX_WITH_STATISTICS
@@ -49,6 +49,7 @@ __FBSDID("$FreeBSD: src/sys/i386/i386/in_cksum.c,v 1.28.10.1.6.1 2009/04/15 03:1
 #else
 # include "in_cksum.h"
 # include "slirp.h"
+# include <iprt/net.h>
 #endif
 
 /*
@@ -203,6 +204,7 @@ in_pseudo(u_int32_t a, u_int32_t b, u_int32_t c)
 	return (sum);
 }
 
+#ifndef VBOX
 u_short
 in_cksum_skip(struct mbuf *m, int len, int skip)
 {
@@ -243,6 +245,41 @@ skip_start:
 	REDUCE16;
 	return (~sum & 0xffff);
 }
+#else /* VBOX */
+/*
+ * Only the mbuf chain walking is done here, the summing is left to IPRT
+ * which picks the fastest implementation for the host CPU and keeps track
+ * of words split between two mbufs.
+ */
+u_short
+in_cksum_skip(struct mbuf *m, int len, int skip)
+{
+    uint32_t u32Sum = 0;
+    bool fOdd = false;
+
+    len -= skip;
+    for (; skip && m; m = m->m_next)
+    {
+        if (m->m_len > skip)
+            break;
+        skip -= m->m_len;
+    }
+
+    for (; m && len > 0; m = m->m_next)
+    {
+        int mlen = m->m_len - skip;
+        if (mlen > 0)
+        {
+            if (len < mlen)
+                mlen = len;
+            u32Sum = RTNetIPv4AddDataChecksum(mtod(m, uint8_t *) + skip, mlen, u32Sum, &fOdd);
+            len -= mlen;
+        }
+        skip = 0;
+    }
+    return RTNetIPv4FinalizeChecksum(u32Sum);
+}
+#endif /* VBOX */
 
 u_int in_cksum_hdr(const struct ip *ip)
 {
@@ -65,11 +65,17 @@ PROFILE_COUNTER(FastTimer, "Profiling slirp fast timer");
 PROFILE_COUNTER(SlowTimer, "Profiling slirp slow timer");
 PROFILE_COUNTER(IOwrite, "Profiling IO sowrite");
 PROFILE_COUNTER(IOread, "Profiling IO soread");
+PROFILE_COUNTER(SoLookup, "Profiling socket lookups");
 
 COUNTING_COUNTER(TCP, "TCP sockets");
 COUNTING_COUNTER(TCPHot, "TCP sockets active");
 COUNTING_COUNTER(UDP, "UDP sockets");
 COUNTING_COUNTER(UDPHot, "UDP sockets active");
+COUNTING_COUNTER(SoHashMiss, "Socket lookups finding no socket");
+#  ifdef VBOX_WITH_NAT_EPOLL
+COUNTING_COUNTER(EpollCtl, "epoll registration changes");
+COUNTING_COUNTER(EpollReady, "Sockets reported ready by epoll");
+#  endif
 
 COUNTING_COUNTER(IORead_in_1, "SB IORead_in_1");
 COUNTING_COUNTER(IORead_in_1_bytes, "SB IORead_in_1_bytes");
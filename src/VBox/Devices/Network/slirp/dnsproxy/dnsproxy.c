@@ -157,6 +157,7 @@ timeout(PNATState pData, struct socket *so, void *arg)
         so1->so_lport = so->so_lport;
         so1->so_faddr = so->so_faddr;
         so1->so_fport = so->so_fport;
+        soHashUpdate(pData, so1);
         req->dns_server = de;
         so1->so_timeout_arg = req;
         so1->so_timeout = timeout;
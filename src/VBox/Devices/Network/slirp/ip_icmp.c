@@ -95,6 +95,10 @@ icmp_init(PNATState pData, int iIcmpCacheLimit)
 {
     pData->icmp_socket.so_type = IPPROTO_ICMP;
     pData->icmp_socket.so_state = SS_ISFCONNECTED;
+#ifdef VBOX_WITH_NAT_EPOLL
+    pData->icmp_socket.so_epoll_fd = -1;
+    pData->icmp_socket.so_epoll_ready_idx = -1;
+#endif
     if (iIcmpCacheLimit < 0)
     {
         LogRel(("NAT: iIcmpCacheLimit is invalid %d, will be alter to default value 100\n", iIcmpCacheLimit));
@@ -179,6 +183,7 @@ icmp_finit(PNATState pData)
     FreeLibrary(pData->hmIcmpLibrary);
     RTMemFree(pData->pvIcmpBuffer);
 #else
+    SOCKET_POLL_DETACH(pData, &pData->icmp_socket);
     closesocket(pData->icmp_socket.s);
 #endif
 }
@@ -846,6 +846,7 @@ GetSocket(struct libalias *la, u_short port_net, struct alias_link *pLnk, int li
             Assert(!"Shouldn't be here");
             return 0;
         }
+        soHashUpdate(la->pData, so);
         LogFunc(("bind called for socket: %R[natsock]\n", so));
         pLnk->pSo = so;
         so->so_pvLnk = pLnk;
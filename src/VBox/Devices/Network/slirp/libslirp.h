@@ -90,6 +90,7 @@ void slirp_set_rcvbuf(PNATState pData, int kilobytes);
 void slirp_set_sndbuf(PNATState pData, int kilobytes);
 void slirp_set_tcp_rcvspace(PNATState pData, int kilobytes);
 void slirp_set_tcp_sndspace(PNATState pData, int kilobytes);
+void slirp_set_socket_hash_size(PNATState pData, int cBuckets);
 
 int  slirp_set_binding_address(PNATState, char *addr);
 void slirp_set_mtu(PNATState, int);
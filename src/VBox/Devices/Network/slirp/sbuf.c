@@ -278,6 +278,43 @@ sbcopy(struct sbuf *sb, int off, int len, char *to)
             memcpy(to+off, sb->sb_data, len);
     }
 }
+
+/*
+ * Same as sbcopy, but folds the Internet checksum of the data into the
+ * copy, sparing tcp_output the separate cksum() pass over the segment.
+ * Returns the unfolded sum, to be combined with the header's sum
+ * (the copied data must start at an even offset of the checksummed area).
+ */
+uint32_t
+sbcopy_cksum(struct sbuf *sb, int off, int len, char *to)
+{
+    char *from;
+    bool fOdd = false;
+    uint32_t u32Sum;
+
+    from = sb->sb_rptr + off;
+    if (from >= sb->sb_data + sb->sb_datalen)
+        from -= sb->sb_datalen;
+
+    if (from < sb->sb_wptr)
+    {
+        if (len > sb->sb_cc)
+            len = sb->sb_cc;
+        u32Sum = RTNetIPv4AddDataChecksumCopy(to, from, len, 0, &fOdd);
+    }
+    else
+    {
+        /* re-use off */
+        off = (sb->sb_data + sb->sb_datalen) - from;
+        if (off > len)
+            off = len;
+        u32Sum = RTNetIPv4AddDataChecksumCopy(to, from, off, 0, &fOdd);
+        len -= off;
+        if (len)
+            u32Sum = RTNetIPv4AddDataChecksumCopy(to+off, sb->sb_data, len, u32Sum, &fOdd);
+    }
+    return u32Sum;
+}
 #else /* VBOX_WITH_SLIRP_BSD_SBUF */
 void
 sbappend (PNATState pData, struct socket *so, struct mbuf *m)
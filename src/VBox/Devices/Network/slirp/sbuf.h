@@ -51,6 +51,7 @@ void sbreserve (PNATState, struct sbuf *, int);
 void sbappend (PNATState, struct socket *, struct mbuf *);
 void sbappendsb (PNATState, struct sbuf *, struct mbuf *);
 void sbcopy (struct sbuf *, int, int, char *);
+uint32_t sbcopy_cksum (struct sbuf *, int, int, char *);
 #else
 void sbappend (PNATState, struct socket *, struct mbuf *);
 # include "bsd/sys/sbuf.h"
@@ -61,7 +61,27 @@
 #endif
 #include <alias.h>
 
-#ifndef RT_OS_WINDOWS
+#if !defined(RT_OS_WINDOWS) && defined(VBOX_WITH_NAT_EPOLL)
+
+/*
+ * With epoll the sockets stay registered between iterations, so engaging
+ * just accumulates the wanted events, slirpEpollCommit() pushes changes
+ * to the kernel at the end of slirp_select_fill().
+ */
+# define DO_ENGAGE_EVENT1(so, fdset, label)                        \
+   do {                                                            \
+       (so)->so_poll_want |= N_(fdset ## _poll);                   \
+   } while (0)
+
+# define DO_ENGAGE_EVENT2(so, fdset1, fdset2, label)               \
+   do {                                                            \
+       (so)->so_poll_want |= N_(fdset1 ## _poll) | N_(fdset2 ## _poll); \
+   } while (0)
+
+# define DO_CHECK_FD_SET(so, events, fdset)                        \
+      (((so)->so_poll_revents & N_(fdset ## _poll)) != 0)
+
+#elif !defined(RT_OS_WINDOWS)
 
 # define DO_ENGAGE_EVENT1(so, fdset, label)                        \
    do {                                                            \
@@ -97,8 +117,13 @@
        poll_index++;                                               \
    } while (0)
 
+#endif
+
+#ifndef RT_OS_WINDOWS
+
 # define DO_POLL_EVENTS(rc, error, so, events, label) do {} while (0)
 
+# ifndef VBOX_WITH_NAT_EPOLL
 /*
  * DO_CHECK_FD_SET is used in dumping events on socket, including POLLNVAL.
  * gcc warns about attempts to log POLLNVAL so construction in a last to lines
@@ -112,6 +137,7 @@
        && (polls[(so)->so_poll_index].revents & N_(fdset ## _poll)) \
        && (   N_(fdset ## _poll) == POLLNVAL                        \
            || !(polls[(so)->so_poll_index].revents & POLLNVAL)))
+# endif /* !VBOX_WITH_NAT_EPOLL */
 
   /* specific for Windows Winsock API */
 # define DO_WIN_CHECK_FD_SET(so, events, fdset) 0
@@ -325,6 +351,29 @@ int slirp_init(PNATState *ppData, uint32_t u32NetAddr, uint32_t u32Netmask,
     }
     pData->phEvents[VBOX_SOCKET_EVENT_INDEX] = CreateEvent(NULL, FALSE, FALSE, NULL);
 #endif
+#ifdef VBOX_WITH_NAT_EPOLL
+    pData->iEpollFd = epoll_create(128); /* the size is only a hint */
+    if (pData->iEpollFd == -1)
+    {
+        rc = RTErrConvertFromErrno(errno);
+        LogRel(("NAT: epoll_create failed: %Rrc\n", rc));
+        RTMemFree(pData);
+        *ppData = NULL;
+        return rc;
+    }
+    fcntl(pData->iEpollFd, F_SETFD, FD_CLOEXEC);
+#endif
+
+    rc = soHashInit(pData, SO_HASH_SIZE_DEFAULT);
+    if (RT_FAILURE(rc))
+    {
+#ifdef VBOX_WITH_NAT_EPOLL
+        close(pData->iEpollFd);
+#endif
+        RTMemFree(pData);
+        *ppData = NULL;
+        return rc;
+    }
 
     link_up = 1;
 
@@ -332,6 +381,10 @@ int slirp_init(PNATState *ppData, uint32_t u32NetAddr, uint32_t u32Netmask,
     if (RT_FAILURE(rc))
     {
         Log(("NAT: DHCP server initialization failed\n"));
+#ifdef VBOX_WITH_NAT_EPOLL
+        close(pData->iEpollFd);
+#endif
+        soHashTerm(pData);
         RTMemFree(pData);
         *ppData = NULL;
         return rc;
@@ -496,6 +549,12 @@ void slirp_term(PNATState pData)
     icmp_finit(pData);
 
     slirp_link_down(pData);
+#ifdef VBOX_WITH_NAT_EPOLL
+    close(pData->iEpollFd);
+    RTMemFree(pData->paEpollEvents);
+    RTMemFree(pData->papEpollReady);
+#endif
+    soHashTerm(pData);
     slirpReleaseDnsSettings(pData);
     ftp_alias_unload(pData);
     nbt_alias_unload(pData);
@@ -575,6 +634,183 @@ static void updtime(PNATState pData)
 #endif
 }
 
+#ifdef VBOX_WITH_NAT_EPOLL
+/* the poll bits are used as epoll bits as is */
+AssertCompile(EPOLLIN == POLLIN && EPOLLOUT == POLLOUT && EPOLLPRI == POLLPRI);
+AssertCompile(EPOLLERR == POLLERR && EPOLLHUP == POLLHUP);
+
+/**
+ * Removes the socket's descriptor from the epoll set, if registered.
+ */
+static void slirpEpollUnregister(PNATState pData, struct socket *so)
+{
+    if (so->so_epoll_fd != -1)
+    {
+        struct epoll_event Event; /* pre 2.6.9 kernels insist on it */
+        /* if the descriptor was replaced the old one has been closed and
+         * thereby dropped from the set already */
+        if (so->so_epoll_fd == so->s)
+            epoll_ctl(pData->iEpollFd, EPOLL_CTL_DEL, so->s, &Event);
+        pData->cEpollSockets--;
+        so->so_epoll_fd = -1;
+        so->so_epoll_events = 0;
+    }
+}
+
+/**
+ * Brings the epoll registration of the socket in line with the events
+ * slirp_select_fill() engaged on it.
+ *
+ * Sockets without wanted events are removed from the epoll set rather than
+ * registered with an empty mask, otherwise POLLHUP/POLLERR would still be
+ * reported for them and keep the NAT thread spinning (poll() wouldn't see
+ * them at all). Unchanged registrations don't cost a system call, so idle
+ * connections are free.
+ */
+static void slirpEpollCommit(PNATState pData, struct socket *so)
+{
+    struct epoll_event Event;
+    int rc;
+
+#ifdef VBOX_WITH_NAT_UDP_SOCKET_CLONE
+    /* clones share the descriptor of the original, which owns the registration */
+    if (so->so_cloneOf)
+        return;
+#endif
+    if (so->s == -1)
+        so->so_poll_want = 0;
+    if (   so->so_epoll_fd == so->s
+        && so->so_epoll_events == so->so_poll_want)
+        return;
+
+    STAM_COUNTER_INC(&pData->StatEpollCtl);
+    if (!so->so_poll_want)
+    {
+        slirpEpollUnregister(pData, so);
+        return;
+    }
+
+    Event.events = so->so_poll_want;
+    Event.data.ptr = so;
+    if (so->so_epoll_fd == so->s)
+        rc = epoll_ctl(pData->iEpollFd, EPOLL_CTL_MOD, so->s, &Event);
+    else
+    {
+        /* never registered or the descriptor was replaced */
+        slirpEpollUnregister(pData, so);
+        rc = epoll_ctl(pData->iEpollFd, EPOLL_CTL_ADD, so->s, &Event);
+        if (rc == 0)
+            pData->cEpollSockets++;
+    }
+    if (RT_LIKELY(rc == 0))
+    {
+        so->so_epoll_fd = so->s;
+        so->so_epoll_events = so->so_poll_want;
+    }
+    else
+    {
+        static unsigned s_cLogged = 0;
+        if (s_cLogged++ < 32)
+            LogRel(("NAT: epoll_ctl failed for %R[natsock]: %Rrc\n", so, RTErrConvertFromErrno(errno)));
+    }
+}
+
+/**
+ * Queues the socket for slirp_select_poll().
+ */
+static void slirpEpollQueue(PNATState pData, struct socket *so)
+{
+    if (so->so_epoll_ready_idx != -1)
+        return;
+    if (pData->cEpollReady >= pData->cEpollReadyAlloc)
+    {
+        int cNew = RT_MAX(pData->cEpollReadyAlloc * 2, 64);
+        void *pvNew = RTMemRealloc(pData->papEpollReady, cNew * sizeof(struct socket *));
+        if (!pvNew)
+        {
+            /* the socket stays registered and is reported again next time */
+            LogRel(("NAT: out of memory queueing %R[natsock]\n", so));
+            return;
+        }
+        pData->papEpollReady = (struct socket **)pvNew;
+        pData->cEpollReadyAlloc = cNew;
+    }
+    so->so_epoll_ready_idx = pData->cEpollReady;
+    pData->papEpollReady[pData->cEpollReady++] = so;
+}
+
+/**
+ * Takes the socket off the queue for slirp_select_poll().
+ */
+DECLINLINE(void) slirpEpollDequeue(PNATState pData, struct socket *so)
+{
+    if (so->so_epoll_ready_idx != -1)
+    {
+        Assert(pData->papEpollReady[so->so_epoll_ready_idx] == so);
+        pData->papEpollReady[so->so_epoll_ready_idx] = NULL;
+        so->so_epoll_ready_idx = -1;
+    }
+}
+
+/**
+ * Removes the socket from the epoll set and the ready queue.
+ *
+ * Must be called before the descriptor is closed: once closed the number
+ * can be reused by a new socket whose registration must not be touched.
+ * Clones never own a registration, see slirpEpollCommit().
+ */
+void slirpEpollDetach(PNATState pData, struct socket *so)
+{
+#ifdef VBOX_WITH_NAT_UDP_SOCKET_CLONE
+    if (!so->so_cloneOf)
+#endif
+        slirpEpollUnregister(pData, so);
+    slirpEpollDequeue(pData, so);
+    so->so_poll_revents = 0;
+}
+
+/**
+ * Collects the ready sockets after poll() said that the epoll descriptor is
+ * readable, records their events in so_poll_revents and queues them for
+ * slirp_select_poll().
+ */
+static void slirpEpollHarvest(PNATState pData)
+{
+    int cEvents;
+    int i;
+
+    cEvents = epoll_wait(pData->iEpollFd, pData->paEpollEvents, pData->cEpollEventsAlloc, 0);
+    for (i = 0; i < cEvents; i++)
+    {
+        struct socket *so = (struct socket *)pData->paEpollEvents[i].data.ptr;
+        so->so_poll_revents = pData->paEpollEvents[i].events;
+        if (so != &pData->icmp_socket)
+            slirpEpollQueue(pData, so);
+    }
+    if (cEvents > 0)
+        STAM_COUNTER_ADD(&pData->StatEpollReady, cEvents);
+}
+
+/**
+ * Walks the queued sockets of the given protocol, taking each off the queue
+ * before it is looked at.  Opens a block like QSOCKET_FOREACH.
+ */
+# define QSOCKET_FOREACH_READY(so, sonext, proto)                        \
+    for (iReady = 0; iReady < pData->cEpollReady; iReady++)              \
+    {                                                                    \
+        (so) = pData->papEpollReady[iReady];                             \
+        if (!(so) || (so)->so_type != (proto))                           \
+            continue;                                                    \
+        slirpEpollDequeue(pData, (so));                                  \
+        (sonext) = (so)->so_next;                                        \
+        Log2(("%s:%d Processing so:%R[natsock]\n", __FUNCTION__, __LINE__, (so)));
+
+/* pushes the wanted events of a socket to the kernel, see slirpEpollCommit */
+# define SOCKET_POLL_COMMIT(pData, so) slirpEpollCommit((pData), (so))
+#else
+# define SOCKET_POLL_COMMIT(pData, so) do {} while (0)
+#endif /* VBOX_WITH_NAT_EPOLL */
+
 #ifdef RT_OS_WINDOWS
 void slirp_select_fill(PNATState pData, int *pnfds)
 #else /* RT_OS_WINDOWS */
@@ -595,6 +831,14 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
 
     nfds = *pnfds;
 
+#ifdef VBOX_WITH_NAT_EPOLL
+    /* slirp_select_poll() took everything off the queue unless the link is down */
+    for (i = 0; i < pData->cEpollReady; i++)
+        if (pData->papEpollReady[i])
+            pData->papEpollReady[i]->so_epoll_ready_idx = -1;
+    pData->cEpollReady = 0;
+#endif
+
     /*
      * First, TCP sockets
      */
@@ -622,10 +866,15 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
         }
     }
     /* always add the ICMP socket */
-#ifndef RT_OS_WINDOWS
+#if defined(VBOX_WITH_NAT_EPOLL)
+    pData->icmp_socket.so_poll_want = 0;
+    pData->icmp_socket.so_poll_revents = 0;
+#elif !defined(RT_OS_WINDOWS)
     pData->icmp_socket.so_poll_index = -1;
 #endif
     ICMP_ENGAGE_EVENT(&pData->icmp_socket, readfds);
+    if (pData->icmp_socket.s != -1)
+        SOCKET_POLL_COMMIT(pData, &pData->icmp_socket);
 
     STAM_COUNTER_RESET(&pData->StatTCP);
     STAM_COUNTER_RESET(&pData->StatTCPHot);
@@ -633,7 +882,10 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
     QSOCKET_FOREACH(so, so_next, tcp)
     /* { */
         Assert(so->so_type == IPPROTO_TCP);
-#if !defined(RT_OS_WINDOWS)
+#if defined(VBOX_WITH_NAT_EPOLL)
+        so->so_poll_want = 0;
+        so->so_poll_revents = 0;
+#elif !defined(RT_OS_WINDOWS)
         so->so_poll_index = -1;
 #endif
         STAM_COUNTER_INC(&pData->StatTCP);
@@ -656,7 +908,10 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
          * newly socreated() sockets etc. Don't want to select these.
          */
         if (so->so_state & SS_NOFDREF || so->s == -1)
+        {
+            SOCKET_POLL_COMMIT(pData, so);
             CONTINUE(tcp);
+        }
 
         /*
          * Set for reading sockets which are accepting
@@ -665,6 +920,7 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
         {
             STAM_COUNTER_INC(&pData->StatTCPHot);
             TCP_ENGAGE_EVENT1(so, readfds);
+            SOCKET_POLL_COMMIT(pData, so);
             CONTINUE(tcp);
         }
 
@@ -707,6 +963,12 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
             STAM_COUNTER_INC(&pData->StatTCPHot);
             TCP_ENGAGE_EVENT2(so, readfds, xfds);
         }
+        SOCKET_POLL_COMMIT(pData, so);
+#ifdef VBOX_WITH_NAT_EPOLL
+        /* sockets being drained are looked at whether epoll reports them or not */
+        if (so->so_close == 1)
+            slirpEpollQueue(pData, so);
+#endif
         LOOP_LABEL(tcp, so, so_next);
     }
 
@@ -721,7 +983,10 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
 
         Assert(so->so_type == IPPROTO_UDP);
         STAM_COUNTER_INC(&pData->StatUDP);
-#if !defined(RT_OS_WINDOWS)
+#if defined(VBOX_WITH_NAT_EPOLL)
+        so->so_poll_want = 0;
+        so->so_poll_revents = 0;
+#elif !defined(RT_OS_WINDOWS)
         so->so_poll_index = -1;
 #endif
 
@@ -761,8 +1026,34 @@ void slirp_select_fill(PNATState pData, int *pnfds, struct pollfd *polls)
             STAM_COUNTER_INC(&pData->StatUDPHot);
             UDP_ENGAGE_EVENT(so, readfds);
         }
+        SOCKET_POLL_COMMIT(pData, so);
         LOOP_LABEL(udp, so, so_next);
     }
+
+#ifdef VBOX_WITH_NAT_EPOLL
+    /*
+     * The registrations were brought up to date in the loops above, the
+     * caller waits on the epoll descriptor alone.
+     */
+    if (pData->cEpollEventsAlloc < pData->cEpollSockets)
+    {
+        /* room for all registered sockets, so one epoll_wait harvests everything */
+        int cNew = RT_ALIGN_32(pData->cEpollSockets, 64);
+        void *pvNew = RTMemRealloc(pData->paEpollEvents, cNew * sizeof(struct epoll_event));
+        if (pvNew)
+        {
+            pData->paEpollEvents = (struct epoll_event *)pvNew;
+            pData->cEpollEventsAlloc = cNew;
+        }
+    }
+
+    AssertRelease(nfds >= 1);
+    polls[0].fd = pData->iEpollFd;
+    polls[0].events = POLLIN;
+    polls[0].revents = 0;
+    poll_index = 1;
+#endif
+
 done:
 
 #if defined(RT_OS_WINDOWS)
@@ -843,6 +1134,9 @@ void slirp_select_poll(PNATState pData, struct pollfd *polls, int ndfs)
 {
     struct socket *so, *so_next;
     int ret;
+#ifdef VBOX_WITH_NAT_EPOLL
+    int iReady;
+#endif
 #if defined(RT_OS_WINDOWS)
     WSANETWORKEVENTS NetworkEvents;
     int rc;
@@ -885,6 +1179,10 @@ void slirp_select_poll(PNATState pData, struct pollfd *polls, int ndfs)
      */
     if (!link_up)
         goto done;
+#ifdef VBOX_WITH_NAT_EPOLL
+    if (ndfs >= 1 && (polls[0].revents & POLLIN))
+        slirpEpollHarvest(pData);
+#endif
 #if defined(RT_OS_WINDOWS)
     /*XXX: before renaming please make see define
      * fIcmp in slirp_state.h
@@ -897,9 +1195,14 @@ void slirp_select_poll(PNATState pData, struct pollfd *polls, int ndfs)
         sorecvfrom(pData, &pData->icmp_socket);
 #endif
     /*
-     * Check TCP sockets
+     * Check TCP sockets.  With epoll only the ones it reported and the ones
+     * being drained are looked at.
      */
+#ifdef VBOX_WITH_NAT_EPOLL
+    QSOCKET_FOREACH_READY(so, so_next, IPPROTO_TCP)
+#else
     QSOCKET_FOREACH(so, so_next, tcp)
+#endif
     /* { */
         /* TCP socket can't be cloned */
 #ifdef VBOX_WITH_NAT_UDP_SOCKET_CLONE
@@ -918,7 +1221,6 @@ void slirp_select_poll(PNATState pData, struct pollfd *polls, int ndfs)
             so->fUnderPolling = 0;
             CONTINUE(tcp);
         }
-
         POLL_TCP_EVENTS(rc, error, so, &NetworkEvents);
 
         LOG_NAT_SOCK(so, TCP, &NetworkEvents, readfds, writefds, xfds);
@@ -1115,7 +1417,11 @@ void slirp_select_poll(PNATState pData, struct pollfd *polls, int ndfs)
      * Incoming packets are sent straight away, they're not buffered.
      * Incoming UDP data isn't buffered either.
      */
+#ifdef VBOX_WITH_NAT_EPOLL
+     QSOCKET_FOREACH_READY(so, so_next, IPPROTO_UDP)
+#else
      QSOCKET_FOREACH(so, so_next, udp)
+#endif
      /* { */
 #ifdef VBOX_WITH_NAT_UDP_SOCKET_CLONE
         if (so->so_cloneOf)
@@ -1633,7 +1939,13 @@ unsigned int slirp_get_timeout_ms(PNATState pData)
 #ifndef RT_OS_WINDOWS
 int slirp_get_nsock(PNATState pData)
 {
+# ifdef VBOX_WITH_NAT_EPOLL
+    /* slirp_select_fill() only hands out the epoll descriptor */
+    NOREF(pData);
+    return 1;
+# else
     return pData->nsock;
+# endif
 }
 #endif
 
@@ -1749,6 +2061,15 @@ void slirp_set_tcp_sndspace(PNATState pData, int kilobytes)
     tcp_sndspace = kilobytes * _1K;
 }
 
+/* the number of buckets in each of the TCP and UDP socket hash tables */
+void slirp_set_socket_hash_size(PNATState pData, int cBuckets)
+{
+    CHECK_ARG("SOCKET_HASH_SIZE", cBuckets, 16, _64K);
+    if (RT_FAILURE(soHashInit(pData, cBuckets)))
+        LogRel(("NAT: failed to resize the socket hash tables, keeping %d buckets\n",
+                pData->cSoHashBuckets));
+}
+
 /*
  * Looking for Ether by ip in ARP-cache
  * Note: it´s responsible of caller to allocate buffer for result
@@ -237,6 +237,13 @@ int inet_aton (const char *cp, struct in_addr *ia);
 
 #include <sys/stat.h>
 
+#ifdef VBOX_WITH_NAT_EPOLL
+# ifndef RT_OS_LINUX
+#  error "VBOX_WITH_NAT_EPOLL is Linux only"
+# endif
+# include <sys/epoll.h>
+#endif
+
 /* Avoid conflicting with the libc insque() and remque(), which
  * have different prototypes. */
 #define insque slirp_insque
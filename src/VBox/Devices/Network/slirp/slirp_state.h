@@ -177,6 +177,10 @@ typedef struct NATState
     struct udpstat_t udpstat;
     struct socket udb;
     struct socket *udp_last_so;
+    /* socket hash tables for tcb and udb, cSoHashBuckets (power of two) each */
+    struct socket_hash_head *paTcpHash;
+    struct socket_hash_head *paUdpHash;
+    int cSoHashBuckets;
     struct socket icmp_socket;
     struct icmp_storage icmp_msg_head;
 # ifndef RT_OS_WINDOWS
@@ -197,6 +201,21 @@ typedef struct NATState
 #  define NSOCK_INC_EX(ex) do {} while (0)
 #  define NSOCK_DEC_EX(ex) do {} while (0)
 # endif
+#ifdef VBOX_WITH_NAT_EPOLL
+    /* the epoll instance the sockets are persistently registered with,
+     * see slirp_select_fill() */
+    int iEpollFd;
+    /* number of sockets currently registered with iEpollFd */
+    int cEpollSockets;
+    /* buffer for harvesting ready sockets, cEpollEventsAlloc entries */
+    struct epoll_event *paEpollEvents;
+    int cEpollEventsAlloc;
+    /* the sockets slirp_select_poll() looks at: those reported by epoll plus
+     * those being drained, cEpollReady entries. Freed sockets are NULLed. */
+    struct socket **papEpollReady;
+    int cEpollReady;
+    int cEpollReadyAlloc;
+#endif
     int cIcmpCacheSize;
     int iIcmpCacheLimit;
 # ifdef RT_OS_WINDOWS
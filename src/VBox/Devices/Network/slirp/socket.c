@@ -169,6 +169,10 @@ socreate()
         so->s = -1;
 #if !defined(RT_OS_WINDOWS)
         so->so_poll_index = -1;
+#endif
+#ifdef VBOX_WITH_NAT_EPOLL
+        so->so_epoll_fd = -1;
+        so->so_epoll_ready_idx = -1;
 #endif
     }
     return so;
@@ -199,6 +203,9 @@ sofree(PNATState pData, struct socket *so)
         tcp_last_so = &tcb;
     else if (so == udp_last_so)
         udp_last_so = &udb;
+    soHashRemove(pData, so);
+
+    SOCKET_POLL_DETACH(pData, so);
 
     /* libalias notification */
     if (so->so_pvLnk)
@@ -1170,6 +1177,7 @@ no_sockopt:
         so->so_faddr = alias_addr;
     else
         so->so_faddr = addr.sin_addr;
+    soHashUpdate(pData, so);
 
     so->s = s;
     SOCKET_UNLOCK(so);
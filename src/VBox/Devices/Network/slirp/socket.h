@@ -32,6 +32,14 @@
 #define SO_EXPIRE 240000
 #define SO_EXPIREFAST 10000
 
+/*
+ * Default number of buckets in the TCP and UDP socket hash tables,
+ * see sohash.c.
+ */
+#define SO_HASH_SIZE_DEFAULT 1024
+
+LIST_HEAD(socket_hash_head, socket);
+
 /*
  * Our socket structure
  */
@@ -84,6 +92,13 @@ struct socket
 #ifndef RT_OS_WINDOWS
     int so_poll_index;
 #endif /* !RT_OS_WINDOWS */
+#ifdef VBOX_WITH_NAT_EPOLL
+    int      so_epoll_fd;        /* descriptor registered with the epoll instance, -1 if none */
+    uint32_t so_epoll_events;    /* events the descriptor is registered for */
+    uint32_t so_poll_want;       /* events slirp_select_fill() wants to wait for */
+    uint32_t so_poll_revents;    /* events reported ready for this socket */
+    int      so_epoll_ready_idx; /* index into NATState::papEpollReady, -1 if not queued */
+#endif
     /*
      * FD_CLOSE/POLLHUP event has been occurred on socket
      */
@@ -126,11 +141,23 @@ struct socket
      *  alter value ''fShouldBeRemoved'' to 1, else we do removal.
      */
     int fShouldBeRemoved;
+    /* the hash table bucket the socket is linked into (NULL if none) and the
+     * linkage, the bucket reflects the addresses at the time of hashing */
+    struct socket_hash_head *so_hash_head;
+    LIST_ENTRY(socket) so_hash_list;
 };
 
 /* this function inform libalias about socket close */
 void slirpDeleteLinkSocket(void *pvLnk);
 
+#ifdef VBOX_WITH_NAT_EPOLL
+/* removes the socket from the epoll registry, must be done before closing so->s */
+void slirpEpollDetach(PNATState pData, struct socket *so);
+# define SOCKET_POLL_DETACH(pData, so) slirpEpollDetach((pData), (so))
+#else
+# define SOCKET_POLL_DETACH(pData, so) do {} while (0)
+#endif
+
 
 # define SOCKET_LOCK(so) do {} while (0)
 # define SOCKET_UNLOCK(so) do {} while (0)
@@ -166,6 +193,11 @@ struct iovec
 
 void so_init (void);
 struct socket * solookup (struct socket *, struct in_addr, u_int, struct in_addr, u_int);
+struct socket * soLookUpHashed (PNATState, struct socket *, struct in_addr, u_int, struct in_addr, u_int);
+void soHashUpdate (PNATState, struct socket *);
+void soHashRemove (PNATState, struct socket *);
+int soHashInit (PNATState, int);
+void soHashTerm (PNATState);
 struct socket * socreate (void);
 void sofree (PNATState, struct socket *);
 int soread (PNATState, struct socket *);
@@ -0,0 +1,174 @@
+/* $Id$ */
+/** @file
+ * NAT - socket hash tables.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/*
+ * The tables only speed up the lookups, the tcb/udb lists stay the
+ * authoritative collections.  Whoever sets the addresses of a socket calls
+ * soHashUpdate() afterwards, so a lookup is a single bucket walk regardless
+ * of the number of connections and a miss means there is no such socket.
+ *
+ * UDP sockets are looked up by the guest endpoint alone, so for them the
+ * foreign address and port don't take part in hashing and matching.  UDP
+ * clones share the guest endpoint of their original and are never hashed.
+ */
+
+#include <slirp.h>
+
+
+static struct socket_hash_head *
+sohashbucket(PNATState pData, bool fUdp, struct in_addr laddr,
+             u_int lport, struct in_addr faddr, u_int fport)
+{
+    uint32_t u32Hash;
+
+    if (fUdp)
+        u32Hash = laddr.s_addr ^ (lport * UINT32_C(0x9e3779b1));
+    else
+        u32Hash = laddr.s_addr ^ faddr.s_addr ^ ((lport << 16 | fport) * UINT32_C(0x9e3779b1));
+    u32Hash ^= u32Hash >> 16;
+    u32Hash *= UINT32_C(0x85ebca6b);
+    u32Hash ^= u32Hash >> 13;
+    u32Hash &= pData->cSoHashBuckets - 1;
+    return fUdp ? &pData->paUdpHash[u32Hash] : &pData->paTcpHash[u32Hash];
+}
+
+DECLINLINE(bool)
+sohashmatch(bool fUdp, struct socket *so, struct in_addr laddr,
+            u_int lport, struct in_addr faddr, u_int fport)
+{
+    return so->so_lport        == lport
+        && so->so_laddr.s_addr == laddr.s_addr
+        && (   fUdp
+            || (   so->so_faddr.s_addr == faddr.s_addr
+                && so->so_fport        == fport));
+}
+
+/*
+ * Find the socket for the given addresses in head (&tcb or &udb).
+ */
+struct socket *
+soLookUpHashed(PNATState pData, struct socket *head, struct in_addr laddr,
+               u_int lport, struct in_addr faddr, u_int fport)
+{
+    bool fUdp = head == &udb;
+    struct socket *so;
+
+    STAM_PROFILE_START(&pData->StatSoLookup, a);
+    LIST_FOREACH(so, sohashbucket(pData, fUdp, laddr, lport, faddr, fport), so_hash_list)
+    {
+        if (sohashmatch(fUdp, so, laddr, lport, faddr, fport))
+            break;
+    }
+    if (!so)
+        STAM_COUNTER_INC(&pData->StatSoHashMiss);
+    STAM_PROFILE_STOP(&pData->StatSoLookup, a);
+    return so;
+}
+
+/*
+ * (Re)hash the socket after its addresses were set or changed.
+ */
+void
+soHashUpdate(PNATState pData, struct socket *so)
+{
+    struct socket_hash_head *pBucket;
+
+    if (   so->so_type != IPPROTO_TCP
+        && so->so_type != IPPROTO_UDP)
+        return;
+#ifdef VBOX_WITH_NAT_UDP_SOCKET_CLONE
+    if (so->so_cloneOf)
+        return;
+#endif
+    pBucket = sohashbucket(pData, so->so_type == IPPROTO_UDP, so->so_laddr,
+                           so->so_lport, so->so_faddr, so->so_fport);
+    if (so->so_hash_head == pBucket)
+        return;
+    soHashRemove(pData, so);
+    LIST_INSERT_HEAD(pBucket, so, so_hash_list);
+    so->so_hash_head = pBucket;
+}
+
+/*
+ * Take the socket out of the hash tables, sofree() does this.
+ */
+void
+soHashRemove(PNATState pData, struct socket *so)
+{
+    NOREF(pData);
+    if (so->so_hash_head)
+    {
+        LIST_REMOVE(so, so_hash_list);
+        so->so_hash_head = NULL;
+    }
+}
+
+/*
+ * (Re)allocate the hash tables with cBuckets buckets (rounded up to a power
+ * of two) and move the sockets hashed so far over.
+ */
+int
+soHashInit(PNATState pData, int cBuckets)
+{
+    struct socket_hash_head *paTcpHash;
+    struct socket_hash_head *paUdpHash;
+    struct socket *so;
+    int cNew = 16;
+
+    AssertReturn(cBuckets >= 16 && cBuckets <= _64K, VERR_INVALID_PARAMETER);
+    while (cNew < cBuckets)
+        cNew <<= 1;
+
+    paTcpHash = RTMemAllocZ(cNew * sizeof(struct socket_hash_head));
+    paUdpHash = RTMemAllocZ(cNew * sizeof(struct socket_hash_head));
+    if (!paTcpHash || !paUdpHash)
+    {
+        RTMemFree(paTcpHash);
+        RTMemFree(paUdpHash);
+        return VERR_NO_MEMORY;
+    }
+
+    soHashTerm(pData);
+    pData->paTcpHash = paTcpHash;
+    pData->paUdpHash = paUdpHash;
+    pData->cSoHashBuckets = cNew;
+
+    /* The old buckets are gone, so just forget the links before rehashing. */
+    for (so = tcb.so_next; so && so != &tcb; so = so->so_next)
+        if (so->so_hash_head)
+        {
+            so->so_hash_head = NULL;
+            soHashUpdate(pData, so);
+        }
+    for (so = udb.so_next; so && so != &udb; so = so->so_next)
+        if (so->so_hash_head)
+        {
+            so->so_hash_head = NULL;
+            soHashUpdate(pData, so);
+        }
+    return VINF_SUCCESS;
+}
+
+void
+soHashTerm(PNATState pData)
+{
+    RTMemFree(pData->paTcpHash);
+    RTMemFree(pData->paUdpHash);
+    pData->paTcpHash = NULL;
+    pData->paUdpHash = NULL;
+    pData->cSoHashBuckets = 0;
+}
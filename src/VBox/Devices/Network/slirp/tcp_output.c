@@ -100,6 +100,10 @@ tcp_output(PNATState pData, register struct tcpcb *tp)
     unsigned optlen, hdrlen;
     int idle, sendalot;
     int size = 0;
+#ifndef VBOX_WITH_SLIRP_BSD_SBUF
+    uint32_t u32DataSum = 0;  /* sum of the payload, gathered while copying it */
+    bool fOdd;
+#endif
 
     LogFlowFunc(("ENTER: tcp_output: tp = %R[tcpcb793]\n", tp));
 
@@ -376,6 +380,9 @@ send:
      * be transmitted, and initialize the header from
      * the template for sends on this connection.
      */
+#ifndef VBOX_WITH_SLIRP_BSD_SBUF
+    u32DataSum = 0;
+#endif
     if (len)
     {
         if (tp->t_force && len == 1)
@@ -422,7 +429,9 @@ send:
         {
 #endif
 #ifndef VBOX_WITH_SLIRP_BSD_SBUF
-            sbcopy(&so->so_snd, off, (int) len, mtod(m, caddr_t) + hdrlen);
+            /** @todo The payload is still copied out of so_snd here, the
+             *        segment mbufs can't reference the send buffer. */
+            u32DataSum = sbcopy_cksum(&so->so_snd, off, (int) len, mtod(m, caddr_t) + hdrlen);
             m->m_len += len;
 #else
             m_copyback(pData, m, hdrlen, len, sbuf_data(&so->so_snd) + off);
@@ -585,7 +594,14 @@ send:
     if (len + optlen)
         ti->ti_len = RT_H2N_U16((u_int16_t)(sizeof (struct tcphdr)
                                             + optlen + len));
+#ifndef VBOX_WITH_SLIRP_BSD_SBUF
+    /* the payload was summed by sbcopy_cksum(), hdrlen is always even */
+    Assert(!(hdrlen & 1));
+    fOdd = false;
+    ti->ti_sum = RTNetIPv4FinalizeChecksum(RTNetIPv4AddDataChecksum(ti, hdrlen, u32DataSum, &fOdd));
+#else
     ti->ti_sum = cksum(m, (int)(hdrlen + len));
+#endif
 
     /*
      * In transmit state, time the transmission and arrange for
@@ -299,7 +299,10 @@ tcp_close(PNATState pData, register struct tcpcb *tp)
     if (so == tcp_last_so)
         tcp_last_so = &tcb;
     if (so->s != -1)
+    {
+        SOCKET_POLL_DETACH(pData, so);
         closesocket(so->s);
+    }
     /* Avoid double free if the socket is listening and therefore doesn't have
      * any sbufs reserved. */
     if (!(so->so_state & SS_FACCEPTCONN))
@@ -568,10 +571,12 @@ tcp_connect(PNATState pData, struct socket *inso)
     /* Translate connections from localhost to the real hostname */
     if (so->so_faddr.s_addr == 0 || so->so_faddr.s_addr == loopback_addr.s_addr)
         so->so_faddr = alias_addr;
+    soHashUpdate(pData, so);
 
     /* Close the accept() socket, set right state */
     if (inso->so_state & SS_FACCEPTONCE)
     {
+        SOCKET_POLL_DETACH(pData, so);
         closesocket(so->s);        /* If we only accept once, close the accept() socket */
         so->so_state = SS_NOFDREF; /* Don't select it yet, even though we have an FD */
                                    /* if it's not FACCEPTONCE, it's already NOFDREF */
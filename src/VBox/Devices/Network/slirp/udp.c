@@ -215,6 +215,17 @@ udp_input(PNATState pData, register struct mbuf *m, int iphlen)
     if (   so->so_lport != uh->uh_sport
         || so->so_laddr.s_addr != ip->ip_src.s_addr)
     {
+#ifndef VBOX_WITH_NAT_UDP_SOCKET_CLONE
+        struct in_addr NoAddr;
+        NoAddr.s_addr = INADDR_ANY;
+        so = soLookUpHashed(pData, &udb, ip->ip_src, uh->uh_sport, NoAddr, 0);
+        if (so)
+        {
+            udpstat.udpps_pcbcachemiss++;
+            udp_last_so = so;
+        }
+#else
+        /* clones share the guest endpoint, keep finding the most recent one */
         struct socket *tmp;
 
         for (tmp = udb.so_next; tmp != &udb; tmp = tmp->so_next)
@@ -233,6 +244,7 @@ udp_input(PNATState pData, register struct mbuf *m, int iphlen)
             udpstat.udpps_pcbcachemiss++;
             udp_last_so = so;
         }
+#endif
     }
 
     if (so == NULL)
@@ -260,6 +272,7 @@ udp_input(PNATState pData, register struct mbuf *m, int iphlen)
         /* udp_last_so = so; */
         so->so_laddr = ip->ip_src;
         so->so_lport = uh->uh_sport;
+        soHashUpdate(pData, so);
 
         so->so_iptos = ip->ip_tos;
 
@@ -544,6 +557,7 @@ udp_detach(PNATState pData, struct socket *so)
             return;
         }
 #endif
+        SOCKET_POLL_DETACH(pData, so);
         closesocket(so->s);
         sofree(pData, so);
         SOCKET_UNLOCK(so);
@@ -616,6 +630,7 @@ udp_listen(PNATState pData, u_int32_t bind_addr, u_int port, u_int32_t laddr, u_
 
     so->so_lport = lport;
     so->so_laddr.s_addr = laddr;
+    soHashUpdate(pData, so);
     if (flags != SS_FACCEPTONCE)
         so->so_expire = 0;
 
@@ -54,6 +54,14 @@ static uint32_t g_cIpv4Pkts = 0;
 static uint32_t g_cUdpPkts = 0;
 static uint32_t g_cDhcpPkts = 0;
 static uint32_t g_cTcpPkts = 0;
+/** Whether to report the receive rate once a second while sniffing. */
+static bool     g_fRateReport = false;
+/** The timestamp of the last receive rate report. */
+static uint64_t g_RateLastTS = 0;
+/** The number of frames received at the last receive rate report. */
+static uint64_t g_cRateLastFrames = 0;
+/** The number of bytes received at the last receive rate report. */
+static uint64_t g_cbRateLastRecv = 0;
 
 
 /**
@@ -414,6 +422,60 @@ static void doPingTest(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession, PINTNETBUF p
 }
 
 
+/**
+ * Reports the receive rate in frames and megabits per second.
+ *
+ * Used for measuring how many packets per second a guest NIC can push onto
+ * the network, e.g. running a small packet UDP flood in the guest.
+ *
+ * @param   pBuf            The shared interface buffer.
+ * @param   pFileText       The file to write the report to (optional).
+ * @param   fFinal          Whether to report the average over the whole run
+ *                          rather than the rate since the last report.
+ */
+static void tstIntNetReportRate(PINTNETBUF pBuf, PRTSTREAM pFileText, bool fFinal)
+{
+    uint64_t const NanoTS  = RTTimeNanoTS();
+    uint64_t const cFrames = pBuf->Recv.cStatFrames.c;
+    uint64_t const cbRecv  = pBuf->Recv.cbStatWritten.c;
+    if (!g_RateLastTS)
+        g_RateLastTS = g_StartTS;
+
+    uint64_t cNsElapsed;
+    uint64_t cFramesDelta;
+    uint64_t cbDelta;
+    if (fFinal)
+    {
+        cNsElapsed   = NanoTS - g_StartTS;
+        cFramesDelta = cFrames;
+        cbDelta      = cbRecv;
+    }
+    else
+    {
+        cNsElapsed = NanoTS - g_RateLastTS;
+        if (cNsElapsed < RT_NS_1SEC)
+            return;
+        cFramesDelta = cFrames - g_cRateLastFrames;
+        cbDelta      = cbRecv  - g_cbRateLastRecv;
+        g_RateLastTS      = NanoTS;
+        g_cRateLastFrames = cFrames;
+        g_cbRateLastRecv  = cbRecv;
+    }
+    if (!cNsElapsed)
+        return;
+
+    uint64_t const NanoTSRel = NanoTS - g_StartTS;
+    RTStrmPrintf(pFileText ? pFileText : g_pStdOut,
+                 "%3RU64.%09u: %s%RU64 pps %RU64 Mbps (frames=%RU64 lost=%RU64)\n",
+                 NanoTSRel / 1000000000, (uint32_t)(NanoTSRel % 1000000000),
+                 fFinal ? "average " : "",
+                 cFramesDelta * RT_NS_1SEC / cNsElapsed,
+                 cbDelta * 8 * RT_NS_1SEC / cNsElapsed / 1000000,
+                 cFrames,
+                 pBuf->cStatLost.c);
+}
+
+
 /**
  * Does packet sniffing for a given period of time.
  *
@@ -446,7 +508,13 @@ static void doPacketSniffing(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession, PINTNE
         WaitReq.pSession = pSession;
         WaitReq.hIf = hIf;
         WaitReq.cMillies = cMillies - (uint32_t)cElapsedMillies;
+        if (g_fRateReport && WaitReq.cMillies > 1000)
+            WaitReq.cMillies = 1000;
         int rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_IF_WAIT, 0, &WaitReq.Hdr);
+        if (g_fRateReport)
+            tstIntNetReportRate(pBuf, pFileText, false /*fFinal*/);
+        if (rc == VERR_TIMEOUT && g_fRateReport)
+            continue;
         if (rc == VERR_TIMEOUT || rc == VERR_INTERRUPTED)
             break;
         if (RT_FAILURE(rc))
@@ -593,6 +661,8 @@ static void doPacketSniffing(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession, PINTNE
                  "%3RU64.%09u: cOtherPkts=%RU32 cArpPkts=%RU32 cIpv4Pkts=%RU32 cTcpPkts=%RU32 cUdpPkts=%RU32 cDhcpPkts=%RU32\n",
                  NanoTS / 1000000000, (uint32_t)(NanoTS % 1000000000),
                  g_cOtherPkts, g_cArpPkts, g_cIpv4Pkts, g_cTcpPkts, g_cUdpPkts, g_cDhcpPkts);
+    if (g_fRateReport)
+        tstIntNetReportRate(pBuf, pFileText, true /*fFinal*/);
 }
 
 
@@ -617,6 +687,7 @@ int main(int argc, char **argv)
         { "--text-file",    't', RTGETOPT_REQ_STRING },
         { "--xmit-test",    'x', RTGETOPT_REQ_NOTHING },
         { "--ping-test",    'P', RTGETOPT_REQ_NOTHING },
+        { "--rate",         'R', RTGETOPT_REQ_NOTHING },
     };
 
     uint32_t    cMillies = 1000;
@@ -736,6 +807,10 @@ int main(int argc, char **argv)
                 fPingTest = true;
                 break;
 
+            case 'R':
+                g_fRateReport = true;
+                break;
+
             case 'h':
                 RTPrintf("syntax: tstIntNet-1 <options>\n"
                          "\n"
@@ -745,7 +820,8 @@ int main(int argc, char **argv)
                 RTPrintf("\n"
                          "Examples:\n"
                          "    tstIntNet-1 -r 8192 -s 4096 -xS\n"
-                         "    tstIntNet-1 -n VBoxNetDhcp -r 4096 -s 4096 -i \"\" -xS\n");
+                         "    tstIntNet-1 -n VBoxNetDhcp -r 4096 -s 4096 -i \"\" -xS\n"
+                         "    tstIntNet-1 -n intnet -i \"\" -p -S -R -t \"\" -d 60\n");
                 return 1;
 
             case 'V':
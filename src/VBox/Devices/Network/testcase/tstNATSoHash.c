@@ -0,0 +1,209 @@
+/* $Id$ */
+/** @file
+ * NAT - Testcase and benchmark for the socket hash tables.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <slirp.h>
+
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST g_hTest;
+
+
+/**
+ * The list walk soLookUpHashed() replaced, for comparison.
+ */
+static struct socket *tstListLookUp(struct socket *head, struct in_addr laddr, u_int lport,
+                                    struct in_addr faddr, u_int fport)
+{
+    struct socket *so;
+    for (so = head->so_next; so != head; so = so->so_next)
+        if (   so->so_lport        == lport
+            && so->so_laddr.s_addr == laddr.s_addr
+            && so->so_faddr.s_addr == faddr.s_addr
+            && so->so_fport        == fport)
+            return so;
+    return NULL;
+}
+
+/**
+ * Creates a socket with the given addresses, queues and hashes it.
+ */
+static struct socket *tstNewSocket(PNATState pData, struct socket *head, uint32_t uLAddr, uint16_t uLPort,
+                                   uint32_t uFAddr, uint16_t uFPort)
+{
+    struct socket *so = (struct socket *)RTMemAllocZ(sizeof(*so));
+    RTTEST_CHECK_RET(g_hTest, so, NULL);
+    so->so_type = head == &udb ? IPPROTO_UDP : IPPROTO_TCP;
+    so->so_laddr.s_addr = RT_H2N_U32(uLAddr);
+    so->so_lport = RT_H2N_U16(uLPort);
+    so->so_faddr.s_addr = RT_H2N_U32(uFAddr);
+    so->so_fport = RT_H2N_U16(uFPort);
+
+    so->so_next = head->so_next;
+    so->so_prev = head;
+    head->so_next->so_prev = so;
+    head->so_next = so;
+
+    soHashUpdate(pData, so);
+    return so;
+}
+
+static void tstFreeSockets(PNATState pData, struct socket *head)
+{
+    while (head->so_next != head)
+    {
+        struct socket *so = head->so_next;
+        head->so_next = so->so_next;
+        soHashRemove(pData, so);
+        RTMemFree(so);
+    }
+    head->so_prev = head;
+}
+
+static void tstCorrectness(PNATState pData)
+{
+    struct socket *so, *so2;
+    unsigned i;
+
+    RTTestSub(g_hTest, "Lookups");
+
+    RTTESTI_CHECK_RC_RETV(soHashInit(pData, 16), VINF_SUCCESS);
+    for (i = 0; i < 1000; i++)
+        tstNewSocket(pData, &tcb, 0x0a00020f, 1024 + i, 0xc0a80001 + i % 7, 80);
+    for (i = 0; i < 100; i++)
+        tstNewSocket(pData, &udb, 0x0a00020f, 5000 + i, 0x08080808, 53);
+
+    /* Everything is found, and only by its own addresses. */
+    for (so = tcb.so_next; so != &tcb; so = so->so_next)
+    {
+        RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == so);
+        RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport ^ 1) == NULL);
+    }
+    for (so = udb.so_next; so != &udb; so = so->so_next)
+    {
+        struct in_addr OtherAddr;
+        OtherAddr.s_addr = RT_H2N_U32_C(0x01020304);
+        /* UDP matches on the guest endpoint alone */
+        RTTESTI_CHECK(soLookUpHashed(pData, &udb, so->so_laddr, so->so_lport, OtherAddr, 0) == so);
+        RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == NULL);
+    }
+
+    /* Changed addresses are found once the socket has been rehashed. */
+    so = tcb.so_next;
+    so2 = tcb.so_next->so_next;
+    so->so_faddr.s_addr = RT_H2N_U32_C(0x0a000202);
+    so->so_fport = RT_H2N_U16_C(8080);
+    soHashUpdate(pData, so);
+    RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == so);
+    so->so_fport = RT_H2N_U16_C(8081);
+    RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == NULL);
+    soHashUpdate(pData, so);
+
+    /* Resizing keeps everything reachable. */
+    RTTESTI_CHECK_RC_RETV(soHashInit(pData, 1000), VINF_SUCCESS);
+    RTTESTI_CHECK(pData->cSoHashBuckets == 1024);
+    for (so = tcb.so_next; so != &tcb; so = so->so_next)
+        RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == so);
+    for (so = udb.so_next; so != &udb; so = so->so_next)
+        RTTESTI_CHECK(soLookUpHashed(pData, &udb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == so);
+
+    /* Removed sockets are gone, their neighbours stay. */
+    so = tcb.so_next;
+    soHashRemove(pData, so2);
+    RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so2->so_laddr, so2->so_lport, so2->so_faddr, so2->so_fport) == NULL);
+    RTTESTI_CHECK(soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport) == so);
+
+    tstFreeSockets(pData, &tcb);
+    tstFreeSockets(pData, &udb);
+}
+
+static void tstBenchmark(PNATState pData)
+{
+    static unsigned const s_acSockets[] = { 16, 256, 4096 };
+    unsigned iSize;
+
+    RTTestSub(g_hTest, "Benchmark");
+    RTTESTI_CHECK_RC_RETV(soHashInit(pData, SO_HASH_SIZE_DEFAULT), VINF_SUCCESS);
+
+    for (iSize = 0; iSize < RT_ELEMENTS(s_acSockets); iSize++)
+    {
+        unsigned const cSockets = s_acSockets[iSize];
+        uint32_t const cRounds  = _4M / cSockets;
+        uintptr_t      uDummy   = 0;
+        struct socket *so;
+        uint64_t       u64Elapsed;
+        uint32_t       iRound;
+        unsigned       i;
+
+        for (i = 0; i < cSockets; i++)
+            tstNewSocket(pData, &tcb, 0x0a00020f, 1024 + i, 0x5db8d822 + (i & 15), 443);
+
+        u64Elapsed = RTTimeNanoTS();
+        for (iRound = 0; iRound < cRounds; iRound++)
+            for (so = tcb.so_next; so != &tcb; so = so->so_next)
+                uDummy += (uintptr_t)soLookUpHashed(pData, &tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport);
+        u64Elapsed = RTTimeNanoTS() - u64Elapsed;
+        RTTestValueF(g_hTest, u64Elapsed / ((uint64_t)cRounds * cSockets), RTTESTUNIT_NS_PER_CALL,
+                     "hashed, %u sockets", cSockets);
+
+        /* Same lookups through the list, fewer rounds as it gets slow. */
+        u64Elapsed = RTTimeNanoTS();
+        for (iRound = 0; iRound < cRounds / cSockets + 1; iRound++)
+            for (so = tcb.so_next; so != &tcb; so = so->so_next)
+                uDummy += (uintptr_t)tstListLookUp(&tcb, so->so_laddr, so->so_lport, so->so_faddr, so->so_fport);
+        u64Elapsed = RTTimeNanoTS() - u64Elapsed;
+        RTTestValueF(g_hTest, u64Elapsed / ((uint64_t)(cRounds / cSockets + 1) * cSockets), RTTESTUNIT_NS_PER_CALL,
+                     "list walk, %u sockets", cSockets);
+
+        RTTESTI_CHECK(uDummy != 0);
+        tstFreeSockets(pData, &tcb);
+    }
+}
+
+
+int main()
+{
+    PNATState pData;
+    int rc = RTTestInitAndCreate("tstNATSoHash", &g_hTest);
+    if (rc)
+        return rc;
+    RTTestBanner(g_hTest);
+
+    pData = (PNATState)RTMemAllocZ(sizeof(*pData));
+    if (pData)
+    {
+        tcb.so_next = tcb.so_prev = &tcb;
+        udb.so_next = udb.so_prev = &udb;
+
+        tstCorrectness(pData);
+        tstBenchmark(pData);
+
+        soHashTerm(pData);
+        RTMemFree(pData);
+    }
+    else
+        RTTestFailed(g_hTest, "Out of memory");
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
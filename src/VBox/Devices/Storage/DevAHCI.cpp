@@ -41,6 +41,7 @@
 #include <VBox/vmm/pdmqueue.h>
 #include <VBox/vmm/pdmthread.h>
 #include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/scsi.h>
 #include <iprt/assert.h>
 #include <iprt/asm.h>
@@ -659,8 +660,11 @@ typedef struct AHCI
     /** Register structure per port */
     AHCIPort                        ahciPort[AHCI_MAX_NR_PORTS_IMPL];
 
-    /** The critical section. */
-    PDMCRITSECT                     lock;
+    /** The critical section protecting the interrupt state.
+     * The async I/O threads signalling completions are what share it, the MMIO
+     * handlers are serialized by the device critical section anyway and take it
+     * exclusively, as does command completion coalescing. */
+    PDMCRITSECTRW                   lock;
 
     /** Bitmask of ports which asserted an interrupt. */
     volatile uint32_t               u32PortsInterrupted;
@@ -980,13 +984,22 @@ static int ahciHbaSetInterrupt(PAHCI pAhci, uint8_t iPort, int rcBusy)
 {
     Log(("P%u: %s: Setting interrupt\n", iPort, __FUNCTION__));
 
-    int rc = PDMCritSectEnter(&pAhci->lock, rcBusy);
+    /*
+     * Command completion coalescing updates the shared counters and needs the
+     * lock exclusively.  The common case only sets our port bit, so the async
+     * I/O threads of the other ports completing at the same time don't have
+     * to wait on each other.
+     */
+    bool fCcc = (pAhci->regHbaCccCtl & AHCI_HBA_CCC_CTL_EN) && (pAhci->regHbaCccPorts & (1 << iPort));
+    int rc = fCcc
+           ? PDMCritSectRwEnterExcl(&pAhci->lock, rcBusy)
+           : PDMCritSectRwEnterShared(&pAhci->lock, rcBusy);
     if (rc != VINF_SUCCESS)
         return rc;
 
     if (pAhci->regHbaCtrl & AHCI_HBA_CTRL_IE)
     {
-        if ((pAhci->regHbaCccCtl & AHCI_HBA_CCC_CTL_EN) && (pAhci->regHbaCccPorts & (1 << iPort)))
+        if (fCcc)
         {
             pAhci->uCccCurrentNr++;
             if (pAhci->uCccCurrentNr >= pAhci->uCccNr)
@@ -1009,9 +1022,17 @@ static int ahciHbaSetInterrupt(PAHCI pAhci, uint8_t iPort, int rcBusy)
              * because the interrupt status register was already read by the guest
              * and we need to send a new notification.
              * Otherwise an interrupt is still pending.
+             * Other ports may be doing the same thing concurrently, so look at
+             * the value we replaced and not at the current one.
              */
-            ASMAtomicOrU32((volatile uint32_t *)&pAhci->u32PortsInterrupted, (1 << iPort));
-            if (!(pAhci->u32PortsInterrupted & ~(1 << iPort)))
+            uint32_t u32Old;
+            uint32_t u32New;
+            do
+            {
+                u32Old = ASMAtomicReadU32(&pAhci->u32PortsInterrupted);
+                u32New = u32Old | (1 << iPort);
+            } while (!ASMAtomicCmpXchgU32(&pAhci->u32PortsInterrupted, u32New, u32Old));
+            if (!(u32Old & ~(1 << iPort)))
             {
                 Log(("P%u: %s: Fire interrupt\n", iPort, __FUNCTION__));
                 PDMDevHlpPCISetIrq(pAhci->CTX_SUFF(pDevIns), 0, 1);
@@ -1019,7 +1040,10 @@ static int ahciHbaSetInterrupt(PAHCI pAhci, uint8_t iPort, int rcBusy)
         }
     }
 
-    PDMCritSectLeave(&pAhci->lock);
+    if (fCcc)
+        PDMCritSectRwLeaveExcl(&pAhci->lock);
+    else
+        PDMCritSectRwLeaveShared(&pAhci->lock);
     return VINF_SUCCESS;
 }
 
@@ -1610,7 +1634,7 @@ static int HbaInterruptStatus_w(PAHCI ahci, uint32_t iReg, uint32_t u32Value)
     int rc;
     Log(("%s: write u32Value=%#010x\n", __FUNCTION__, u32Value));
 
-    rc = PDMCritSectEnter(&ahci->lock, VINF_IOM_R3_MMIO_WRITE);
+    rc = PDMCritSectRwEnterExcl(&ahci->lock, VINF_IOM_R3_MMIO_WRITE);
     if (rc != VINF_SUCCESS)
         return rc;
 
@@ -1665,7 +1689,7 @@ static int HbaInterruptStatus_w(PAHCI ahci, uint32_t iReg, uint32_t u32Value)
         }
     }
 
-    PDMCritSectLeave(&ahci->lock);
+    PDMCritSectRwLeaveExcl(&ahci->lock);
     return VINF_SUCCESS;
 }
 
@@ -1677,13 +1701,13 @@ static int HbaInterruptStatus_r(PAHCI ahci, uint32_t iReg, uint32_t *pu32Value)
     uint32_t u32PortsInterrupted;
     int rc;
 
-    rc = PDMCritSectEnter(&ahci->lock, VINF_IOM_R3_MMIO_READ);
+    rc = PDMCritSectRwEnterExcl(&ahci->lock, VINF_IOM_R3_MMIO_READ);
     if (rc != VINF_SUCCESS)
         return rc;
 
     u32PortsInterrupted = ASMAtomicXchgU32(&ahci->u32PortsInterrupted, 0);
 
-    PDMCritSectLeave(&ahci->lock);
+    PDMCritSectRwLeaveExcl(&ahci->lock);
     Log(("%s: read regHbaIs=%#010x u32PortsInterrupted=%#010x\n", __FUNCTION__, ahci->regHbaIs, u32PortsInterrupted));
 
     ahci->regHbaIs |= u32PortsInterrupted;
@@ -5619,6 +5643,8 @@ static int ahciTransferComplete(PAHCIPort pAhciPort, PAHCIREQ pAhciReq, int rcRe
 
     if (fXchg)
     {
+        DBGFTRACE_PDMDEV_BIN(pAhciPort->pDevInsR3, DBGFTRACEBINEVT_DISK_COMPLETE, pAhciReq->cbTransfer,
+                             pAhciReq->uOffset, (uintptr_t)pAhciReq);
         if (pAhciReq->enmTxDir == AHCITXDIR_READ)
         {
             ahciIoBufFree(pAhciPort->pDevInsR3, pAhciReq, true /* fCopyToGuest */);
@@ -6283,6 +6309,8 @@ static DECLCALLBACK(bool) ahciNotifyQueueConsumer(PPDMDEVINS pDevIns, PPDMQUEUEI
 
                     if (!(pAhciReq->fFlags & AHCI_REQ_OVERFLOW))
                     {
+                        DBGFTRACE_PDMDEV_BIN(pAhciPort->pDevInsR3, DBGFTRACEBINEVT_DISK_SUBMIT, pAhciReq->cbTransfer,
+                                             pAhciReq->uOffset, (uintptr_t)pAhciReq);
                         if (enmTxDir == AHCITXDIR_FLUSH)
                         {
                             rc = pAhciPort->pDrvBlockAsync->pfnStartFlush(pAhciPort->pDrvBlockAsync,
@@ -7102,7 +7130,7 @@ static DECLCALLBACK(int) ahciR3Destruct(PPDMDEVINS pDevIns)
      * this module again. So, no coordination is needed here and PDM
      * will take care of terminating and cleaning up the thread.
      */
-    if (PDMCritSectIsInitialized(&pAhci->lock))
+    if (PDMCritSectRwIsInitialized(&pAhci->lock))
     {
         TMR3TimerDestroy(pAhci->CTX_SUFF(pHbaCccTimer));
 
@@ -7129,7 +7157,7 @@ static DECLCALLBACK(int) ahciR3Destruct(PPDMDEVINS pDevIns)
             }
         }
 
-        PDMR3CritSectDelete(&pAhci->lock);
+        PDMR3CritSectRwDelete(&pAhci->lock);
     }
 
     return rc;
@@ -7940,7 +7968,7 @@ static DECLCALLBACK(int) ahciR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
         return PDMDEV_SET_ERROR(pDevIns, rc,
                                 N_("AHCI cannot register PCI memory region for registers"));
 
-    rc = PDMDevHlpCritSectInit(pDevIns, &pThis->lock, RT_SRC_POS, "AHCI#%u", iInstance);
+    rc = PDMDevHlpCritSectRwInit(pDevIns, &pThis->lock, RT_SRC_POS, "AHCI#%u", iInstance);
     if (RT_FAILURE(rc))
     {
         Log(("%s: Failed to create critical section.\n", __FUNCTION__));
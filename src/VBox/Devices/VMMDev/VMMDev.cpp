@@ -1988,6 +1988,36 @@ static DECLCALLBACK(int) vmmdevRequestHandler(PPDMDEVINS pDevIns, void *pvUser,
             break;
         }
 
+        case VMMDevReq_ReportFreePages:
+        {
+            VMMDevReportFreePages *pReportFreePages = (VMMDevReportFreePages *)pRequestHeader;
+            AssertCompileMembersSameSizeAndOffset(VMMDevFreePageRange, GCPhys, PGMPHYSRANGE, GCPhys);
+            AssertCompileMembersSameSizeAndOffset(VMMDevFreePageRange, cPages, PGMPHYSRANGE, cPages);
+            AssertCompileSize(VMMDevFreePageRange, sizeof(PGMPHYSRANGE));
+
+            Log(("VMMDevReq_ReportFreePages: cRanges=%u\n", pReportFreePages->cRanges));
+            if (    pRequestHeader->size < sizeof(VMMDevReportFreePages)
+                ||  pReportFreePages->cRanges > VMMDEV_MAX_FREE_PAGE_RANGES
+                ||  pReportFreePages->fFlags != 0
+                ||  (   pReportFreePages->cRanges > 0
+                     && pRequestHeader->size != (uint32_t)RT_OFFSETOF(VMMDevReportFreePages, aRanges[pReportFreePages->cRanges])))
+            {
+                AssertFailed();
+                pRequestHeader->rc = VERR_INVALID_PARAMETER;
+            }
+            else
+            {
+                uint64_t cPagesFreed = 0;
+                if (pReportFreePages->cRanges > 0)
+                    pRequestHeader->rc = PGMR3PhysReportFreePages(PDMDevHlpGetVM(pDevIns), pReportFreePages->cRanges,
+                                                                  (PCPGMPHYSRANGE)&pReportFreePages->aRanges[0], &cPagesFreed);
+                else
+                    pRequestHeader->rc = PGMR3PhysQueryFreePagesReport(PDMDevHlpGetVM(pDevIns), &cPagesFreed);
+                pReportFreePages->cPagesFreed = cPagesFreed;
+            }
+            break;
+        }
+
         case VMMDevReq_GetStatisticsChangeRequest:
         {
             Log(("VMMDevReq_GetStatisticsChangeRequest\n"));
@@ -249,10 +249,13 @@ static SUPFUNC g_aFunctions[] =
     { "RTMemReallocTag",                        (void *)RTMemReallocTag },
     { "RTMpCpuId",                              (void *)RTMpCpuId },
     { "RTMpCpuIdFromSetIndex",                  (void *)RTMpCpuIdFromSetIndex },
+    { "RTMpCpuIdToNumaNode",                    (void *)RTMpCpuIdToNumaNode },
     { "RTMpCpuIdToSetIndex",                    (void *)RTMpCpuIdToSetIndex },
     { "RTMpGetArraySize",                       (void *)RTMpGetArraySize },
     { "RTMpGetCount",                           (void *)RTMpGetCount },
     { "RTMpGetMaxCpuId",                        (void *)RTMpGetMaxCpuId },
+    { "RTMpGetNumaNodeCount",                   (void *)RTMpGetNumaNodeCount },
+    { "RTMpGetNumaNodeSet",                     (void *)RTMpGetNumaNodeSet },
     { "RTMpGetOnlineCount",                     (void *)RTMpGetOnlineCount },
     { "RTMpGetOnlineSet",                       (void *)RTMpGetOnlineSet },
     { "RTMpGetSet",                             (void *)RTMpGetSet },
@@ -21,8 +21,13 @@
 #define ____H_MACHINEDEBUGGER
 
 #include "VirtualBoxBase.h"
+#include <VBox/vmm/stam.h>
 #include <iprt/log.h>
 
+/** The max number of statistics layouts (IMachineDebugger::getStatsLayout)
+ * kept around at any one time. */
+#define MACHINEDEBUGGER_MAX_STATS_LAYOUTS   8
+
 class Console;
 
 class ATL_NO_VTABLE MachineDebugger :
@@ -100,6 +105,10 @@ public:
     STDMETHOD(ResetStats)(IN_BSTR aPattern);
     STDMETHOD(DumpStats)(IN_BSTR aPattern);
     STDMETHOD(GetStats)(IN_BSTR aPattern, BOOL aWithDescriptions, BSTR *aStats);
+    STDMETHOD(GetStatsLayout)(IN_BSTR aPattern, BOOL aWithDescriptions, ULONG *aLayout,
+                              ComSafeArrayOut(ULONG, aIds), ComSafeArrayOut(BSTR, aNames), ComSafeArrayOut(BSTR, aUnits),
+                              ComSafeArrayOut(ULONG, aValueCounts), ComSafeArrayOut(BSTR, aDescriptions));
+    STDMETHOD(GetStatsValues)(ULONG aLayout, ComSafeArrayOut(LONG64, aValues));
 
 
     // "public-private methods"
@@ -128,6 +137,24 @@ private:
     uint32_t mVirtualTimeRateQueued;
     bool mFlushMode;
     /** @}  */
+
+    /** @name The statistics layouts handed out by getStatsLayout, the slot
+     *        being the layout handle modulo MACHINEDEBUGGER_MAX_STATS_LAYOUTS.
+     * @{ */
+    struct StatsLayout
+    {
+        /** The layout handle, 0 if the slot is free. */
+        ULONG               idLayout;
+        /** The VM the snapshot was made for. */
+        PVM                 pVM;
+        /** The binary statistics snapshot. */
+        PSTAMBINSNAPSHOT    hSnapshot;
+    } maStatsLayouts[MACHINEDEBUGGER_MAX_STATS_LAYOUTS];
+    /** The next layout handle. */
+    ULONG midNextStatsLayout;
+    /** @}  */
+
+    void freeStatsLayouts();
 };
 
 #endif /* !____H_MACHINEDEBUGGER */
@@ -1074,7 +1074,8 @@ public:
                                      ULONG aMemBalloon, ULONG aMemShared,
                                      ULONG aMemCache, ULONG aPageTotal,
                                      ULONG aAllocVMM, ULONG aFreeVMM,
-                                     ULONG aBalloonedVMM, ULONG aSharedVMM);
+                                     ULONG aBalloonedVMM, ULONG aSharedVMM,
+                                     ULONG aMemWorkingSet);
 
     // public methods only for internal purposes
 
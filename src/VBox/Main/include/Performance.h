@@ -147,20 +147,21 @@ namespace pm
      */
     typedef enum
     {
-        GUESTSTATMASK_NONE       = 0x00000000,
-        GUESTSTATMASK_CPUUSER    = 0x00000001,
-        GUESTSTATMASK_CPUKERNEL  = 0x00000002,
-        GUESTSTATMASK_CPUIDLE    = 0x00000004,
-        GUESTSTATMASK_MEMTOTAL   = 0x00000008,
-        GUESTSTATMASK_MEMFREE    = 0x00000010,
-        GUESTSTATMASK_MEMBALLOON = 0x00000020,
-        GUESTSTATMASK_MEMSHARED  = 0x00000040,
-        GUESTSTATMASK_MEMCACHE   = 0x00000080,
-        GUESTSTATMASK_PAGETOTAL  = 0x00000100,
-        GUESTSTATMASK_ALLOCVMM   = 0x00000200,
-        GUESTSTATMASK_FREEVMM    = 0x00000400,
-        GUESTSTATMASK_BALOONVMM  = 0x00000800,
-        GUESTSTATMASK_SHAREDVMM  = 0x00001000
+        GUESTSTATMASK_NONE          = 0x00000000,
+        GUESTSTATMASK_CPUUSER       = 0x00000001,
+        GUESTSTATMASK_CPUKERNEL     = 0x00000002,
+        GUESTSTATMASK_CPUIDLE       = 0x00000004,
+        GUESTSTATMASK_MEMTOTAL      = 0x00000008,
+        GUESTSTATMASK_MEMFREE       = 0x00000010,
+        GUESTSTATMASK_MEMBALLOON    = 0x00000020,
+        GUESTSTATMASK_MEMSHARED     = 0x00000040,
+        GUESTSTATMASK_MEMCACHE      = 0x00000080,
+        GUESTSTATMASK_PAGETOTAL     = 0x00000100,
+        GUESTSTATMASK_ALLOCVMM      = 0x00000200,
+        GUESTSTATMASK_FREEVMM       = 0x00000400,
+        GUESTSTATMASK_BALOONVMM     = 0x00000800,
+        GUESTSTATMASK_SHAREDVMM     = 0x00001000,
+        GUESTSTATMASK_MEMWORKINGSET = 0x00002000
     } GUESTSTATMASK;
 
     const ULONG GUESTSTATS_CPULOAD = 
@@ -172,7 +173,9 @@ namespace pm
     const ULONG GUESTSTATS_VMMRAM =
         GUESTSTATMASK_ALLOCVMM|GUESTSTATMASK_FREEVMM|
         GUESTSTATMASK_BALOONVMM|GUESTSTATMASK_SHAREDVMM;
-    const ULONG GUESTSTATS_ALL = GUESTSTATS_CPULOAD|GUESTSTATS_RAMUSAGE|GUESTSTATS_VMMRAM;
+    const ULONG GUESTSTATS_WORKINGSET = GUESTSTATMASK_MEMWORKINGSET;
+    const ULONG GUESTSTATS_ALL = GUESTSTATS_CPULOAD|GUESTSTATS_RAMUSAGE|GUESTSTATS_VMMRAM|
+                                 GUESTSTATS_WORKINGSET;
 
     class CollectorGuest;
 
@@ -259,7 +262,8 @@ namespace pm
                          ULONG aMemBalloon, ULONG aMemShared,
                          ULONG aMemCache, ULONG aPageTotal,
                          ULONG aAllocVMM, ULONG aFreeVMM,
-                         ULONG aBalloonedVMM, ULONG aSharedVMM);
+                         ULONG aBalloonedVMM, ULONG aSharedVMM,
+                         ULONG aMemWorkingSet);
         int enable(ULONG mask);
         int disable(ULONG mask);
 
@@ -283,6 +287,7 @@ namespace pm
         ULONG getFreeVMM()      { return mFreeVMM; };
         ULONG getBalloonedVMM() { return mBalloonedVMM; };
         ULONG getSharedVMM()    { return mSharedVMM; };
+        ULONG getMemWorkingSet() { return mMemWorkingSet; };
 
     private:
         int enableVMMStats(bool mCollectVMMStats);
@@ -310,6 +315,7 @@ namespace pm
         ULONG                mFreeVMM;
         ULONG                mBalloonedVMM;
         ULONG                mSharedVMM;
+        ULONG                mMemWorkingSet;
     };
 
     typedef std::list<CollectorGuest*> CollectorGuestList;
@@ -614,6 +620,26 @@ namespace pm
     private:
         SubMetric *mTotal, *mFree, *mBallooned, *mCache, *mPagedTotal, *mShared;
     };
+
+    class GuestRamWorkingSet : public BaseGuestMetric
+    {
+    public:
+        GuestRamWorkingSet(CollectorGuest *cguest, ComPtr<IUnknown> object, SubMetric *estimate)
+            : BaseGuestMetric(cguest, "Guest/RAM/WorkingSet", object), mEstimate(estimate) {};
+        ~GuestRamWorkingSet() { delete mEstimate; };
+
+        void init(ULONG period, ULONG length);
+        void preCollect(CollectorHints& hints, uint64_t iTick);
+        void collect();
+        int enable();
+        int disable();
+        const char *getUnit() { return "kB"; };
+        ULONG getMinValue() { return 0; };
+        ULONG getMaxValue() { return INT32_MAX; };
+        ULONG getScale() { return 1; }
+    private:
+        SubMetric *mEstimate;
+    };
 #endif /* VBOX_COLLECTOR_TEST_CASE */
 
     /* Aggregate Functions **************************************************/
@@ -0,0 +1,100 @@
+/* $Id$ */
+/** @file
+ * VBox Console COM Class implementation, Teleporter multi-stream transport.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef ____H_TELEPORTERSTREAMS
+#define ____H_TELEPORTERSTREAMS
+
+#include <iprt/types.h>
+
+
+/**
+ * TCP stream header.
+ *
+ * This is an extra layer for fixing the problem with figuring out when the SSM
+ * stream ends.
+ */
+typedef struct TELEPORTERTCPHDR
+{
+    /** Magic value. */
+    uint32_t    u32Magic;
+    /** The size of the data block following this header.
+     * 0 indicates the end of the stream, while UINT32_MAX indicates
+     * cancelation. */
+    uint32_t    cb;
+} TELEPORTERTCPHDR;
+/** Magic value for TELEPORTERTCPHDR::u32Magic. (Egberto Gismonti Amin) */
+#define TELEPORTERTCPHDR_MAGIC       UINT32_C(0x19471205)
+/** The max block size. */
+#define TELEPORTERTCPHDR_MAX_SIZE    UINT32_C(0x00fffff8)
+
+/** The max number of TCP connections a saved state stream can be striped
+ * across (VBoxInternal2/TeleporterStreams). */
+#define TELEPORTER_MAX_STREAMS       16
+
+
+/**
+ * Stripes a saved state stream across several TCP connections.
+ *
+ * Each block handed to write() goes out on the next connection in turn,
+ * framed by a TELEPORTERTCPHDR, and read() on the other end picks them up in
+ * the same order.  Every connection has its own I/O thread, so that the
+ * sending, receiving and the in-kernel checksumming and copying of the blocks
+ * happen in parallel.  The SSM stream is compressed before it gets here.
+ *
+ * When the stream is closed, every connection gets a terminator header, so
+ * that none of the I/O threads reads past the end of the stream and the
+ * first connection can be used for commands again afterwards.
+ *
+ * The object does not own the sockets.
+ */
+class TeleporterStreams
+{
+public:
+    TeleporterStreams(bool fSender);
+    ~TeleporterStreams();
+
+    int         init(uint32_t cStreams, RTSOCKET const *pahSockets);
+    int         write(const void *pvBuf, size_t cbToWrite);
+    int         read(void *pvBuf, size_t cbToRead, size_t *pcbRead, bool volatile *pfStop);
+    int         close(bool fCanceled);
+    uint32_t    count() const { return mcStreams; }
+
+private:
+    struct Stream;
+
+    void        terminate();
+    static int  waitForSend(Stream *pStream);
+    static int  queue(Stream *pStream, const void *pvBuf, uint32_t cb);
+    static int  recvSelect(Stream *pStream);
+    static DECLCALLBACK(int) sendThread(RTTHREAD hThread, void *pvUser);
+    static DECLCALLBACK(int) recvThread(RTTHREAD hThread, void *pvUser);
+
+    bool const      mfSender;
+    /** Set when the I/O threads should quit. */
+    bool volatile   mfStop;
+    /** Set when a terminator has been consumed by read(). */
+    bool            mfEndOfStream;
+    /** The number of streams in mpaStreams. */
+    uint32_t        mcStreams;
+    /** The stream the next block goes to / comes from. */
+    uint32_t        miStream;
+    /** Array of mcStreams streams. */
+    Stream         *mpaStreams;
+};
+
+#endif // ____H_TELEPORTERSTREAMS
+
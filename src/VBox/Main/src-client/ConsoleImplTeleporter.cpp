@@ -26,15 +26,22 @@
 #include "AutoCaller.h"
 #include "Logging.h"
 #include "HashedPw.h"
+#include "TeleporterStreams.h"
 
 #include <iprt/asm.h>
+#include <iprt/critsect.h>
 #include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/param.h>
 #include <iprt/rand.h>
 #include <iprt/socket.h>
+#include <iprt/string.h>
 #include <iprt/tcp.h>
+#include <iprt/thread.h>
 #include <iprt/timer.h>
 
 #include <VBox/vmm/vmapi.h>
+#include <VBox/vmm/pgm.h>
 #include <VBox/vmm/ssm.h>
 #include <VBox/err.h>
 #include <VBox/version.h>
@@ -67,6 +74,13 @@ public:
     bool volatile       mfStopReading;
     bool volatile       mfEndOfStream;
     bool volatile       mfIOError;
+    /** The number of TCP connections the saved state is striped across. */
+    uint32_t            mcStreams;
+    /** The sockets of the streams, the first one being mhSocket. */
+    RTSOCKET            mahStreams[TELEPORTER_MAX_STREAMS];
+    /** The stripe set while the saved state is being transferred, NULL if
+     * not striping. */
+    TeleporterStreams  *mpStreams;
     /** @} */
 
     TeleporterState(Console *pConsole, PUVM pUVM, Progress *pProgress, bool fIsSource)
@@ -80,7 +94,11 @@ public:
         , mfStopReading(false)
         , mfEndOfStream(false)
         , mfIOError(false)
+        , mcStreams(1)
+        , mpStreams(NULL)
     {
+        for (uint32_t i = 0; i < RT_ELEMENTS(mahStreams); i++)
+            mahStreams[i] = NIL_RTSOCKET;
         VMR3RetainUVM(mpUVM);
     }
 
@@ -104,6 +122,8 @@ public:
     MachineState_T      menmOldMachineState;
     bool                mfSuspendedByUs;
     bool                mfUnlockedMedia;
+    /** Whether to transfer the RAM after handing over (VBoxInternal2/TeleporterPostCopy). */
+    bool                mfPostCopy;
 
     TeleporterStateSrc(Console *pConsole, PUVM pUVM, Progress *pProgress, MachineState_T enmOldMachineState)
         : TeleporterState(pConsole, pUVM, pProgress, true /*fIsSource*/)
@@ -112,6 +132,7 @@ public:
         , menmOldMachineState(enmOldMachineState)
         , mfSuspendedByUs(false)
         , mfUnlockedMedia(false)
+        , mfPostCopy(false)
     {
     }
 };
@@ -128,8 +149,12 @@ public:
     PRTTCPSERVER                mhServer;
     PRTTIMERLR                  mphTimerLR;
     bool                        mfLockedMedia;
+    /** Set by the "post-copy" command. */
+    bool                        mfPostCopy;
     int                         mRc;
     Utf8Str                     mErrorText;
+    /** Serializes socket writes during post-copy (EMTs request pages). */
+    RTCRITSECT                  mPostCopyCritSect;
 
     TeleporterStateTrg(Console *pConsole, PUVM pUVM, Progress *pProgress,
                        IMachine *pMachine, IInternalMachineControl *pControl,
@@ -140,32 +165,60 @@ public:
         , mhServer(NULL)
         , mphTimerLR(phTimerLR)
         , mfLockedMedia(false)
+        , mfPostCopy(false)
         , mRc(VINF_SUCCESS)
         , mErrorText()
     {
+        RTCritSectInit(&mPostCopyCritSect);
+    }
+
+    ~TeleporterStateTrg()
+    {
+        RTCritSectDelete(&mPostCopyCritSect);
     }
 };
 
 
 /**
- * TCP stream header.
+ * Post-copy page message header.
  *
- * This is an extra layer for fixing the problem with figuring out when the SSM
- * stream ends.
+ * After handing over a VM in post-copy mode, the source sends the RAM pages
+ * the saved state left out using this, while the target uses it to ask for the
+ * pages the guest is waiting for.
  */
-typedef struct TELEPORTERTCPHDR
+typedef struct TELEPORTERPAGEHDR
 {
-    /** Magic value. */
+    /** Magic value (TELEPORTERPAGEHDR_MAGIC). */
     uint32_t    u32Magic;
-    /** The size of the data block following this header.
-     * 0 indicates the end of the stream, while UINT32_MAX indicates
-     * cancelation. */
-    uint32_t    cb;
-} TELEPORTERTCPHDR;
-/** Magic value for TELEPORTERTCPHDR::u32Magic. (Egberto Gismonti Amin) */
-#define TELEPORTERTCPHDR_MAGIC       UINT32_C(0x19471205)
-/** The max block size. */
-#define TELEPORTERTCPHDR_MAX_SIZE    UINT32_C(0x00fffff8)
+    /** The message type, TELEPORTERPAGEHDR_TYPE_XXX. */
+    uint32_t    u32Type;
+    /** The guest physical address of the page, NIL_RTGCPHYS if not applicable. */
+    RTGCPHYS    GCPhys;
+    /** The status code (TELEPORTERPAGEHDR_TYPE_DONE). */
+    int32_t     i32Status;
+    /** Reserved, MBZ. */
+    uint32_t    u32Reserved;
+} TELEPORTERPAGEHDR;
+AssertCompileSize(TELEPORTERPAGEHDR, 24);
+/** Magic value for TELEPORTERPAGEHDR::u32Magic. (Keith Jarrett) */
+#define TELEPORTERPAGEHDR_MAGIC         UINT32_C(0x19450508)
+/** Source -> target: Page, followed by PAGE_SIZE bytes of content. */
+#define TELEPORTERPAGEHDR_TYPE_PAGE     UINT32_C(1)
+/** Source -> target: No more pages. */
+#define TELEPORTERPAGEHDR_TYPE_END      UINT32_C(2)
+/** Target -> source: Please send this page next. */
+#define TELEPORTERPAGEHDR_TYPE_REQUEST  UINT32_C(3)
+/** Target -> source: All pages are in (or not, see i32Status). */
+#define TELEPORTERPAGEHDR_TYPE_DONE     UINT32_C(4)
+
+/**
+ * Post-copy page message.
+ */
+typedef struct TELEPORTERPAGE
+{
+    TELEPORTERPAGEHDR   Hdr;
+    uint8_t             abPage[PAGE_SIZE];
+} TELEPORTERPAGE;
 
 
 /*******************************************************************************
@@ -224,13 +277,20 @@ static int teleporterTcpReadLine(TeleporterState *pState, char *pszBuf, size_t c
  * @param   pState              The teleporter source state.
  * @param   pszWhich            Which ACK is this this?
  * @param   pszNAckMsg          Optional NACK message.
+ * @param   pfNAcked            Where to indicate a well formed NACK, optional.
+ *                              When given, such a NACK is only logged and
+ *                              setError() isn't called, so the caller can
+ *                              carry on without the refused feature.
  *
  * @remarks the setError laziness forces this to be a Console member.
  */
 HRESULT
 Console::teleporterSrcReadACK(TeleporterStateSrc *pState, const char *pszWhich,
-                              const char *pszNAckMsg /*= NULL*/)
+                              const char *pszNAckMsg /*= NULL*/, bool *pfNAcked /*= NULL*/)
 {
+    if (pfNAcked)
+        *pfNAcked = false;
+
     char szMsg[256];
     int vrc = teleporterTcpReadLine(pState, szMsg, sizeof(szMsg));
     if (RT_FAILURE(vrc))
@@ -252,6 +312,12 @@ Console::teleporterSrcReadACK(TeleporterStateSrc *pState, const char *pszWhich,
             /*
              * Well formed NACK, transform it into an error.
              */
+            if (pfNAcked)
+            {
+                LogRel(("Teleporter: %s: NACK=%Rrc (%d)\n", pszWhich, vrc2, vrc2));
+                *pfNAcked = true;
+                return E_FAIL;
+            }
             if (pszNAckMsg)
             {
                 LogRel(("Teleporter: %s: NACK=%Rrc (%d)\n", pszWhich, vrc2, vrc2));
@@ -289,18 +355,20 @@ Console::teleporterSrcReadACK(TeleporterStateSrc *pState, const char *pszWhich,
  * @param   pState              The teleporter source state.
  * @param   pszCommand          The command.
  * @param   fWaitForAck         Whether to wait for the ACK.
+ * @param   pfNAcked            See teleporterSrcReadACK, optional.
  *
  * @remarks the setError laziness forces this to be a Console member.
  */
 HRESULT
-Console::teleporterSrcSubmitCommand(TeleporterStateSrc *pState, const char *pszCommand, bool fWaitForAck /*= true*/)
+Console::teleporterSrcSubmitCommand(TeleporterStateSrc *pState, const char *pszCommand, bool fWaitForAck /*= true*/,
+                                    bool *pfNAcked /*= NULL*/)
 {
     int vrc = RTTcpSgWriteL(pState->mhSocket, 2, pszCommand, strlen(pszCommand), "\n", sizeof("\n") - 1);
     if (RT_FAILURE(vrc))
         return setError(E_FAIL, tr("Failed writing command '%s': %Rrc"), pszCommand, vrc);
     if (!fWaitForAck)
         return S_OK;
-    return teleporterSrcReadACK(pState, pszCommand);
+    return teleporterSrcReadACK(pState, pszCommand, NULL, pfNAcked);
 }
 
 
@@ -315,6 +383,15 @@ static DECLCALLBACK(int) teleporterTcpOpWrite(void *pvUser, uint64_t offStream,
     AssertReturn(cbToWrite < UINT32_MAX, VERR_OUT_OF_RANGE);
     AssertReturn(pState->mfIsSource, VERR_INVALID_HANDLE);
 
+    if (pState->mpStreams)
+    {
+        int rc = pState->mpStreams->write(pvBuf, cbToWrite);
+        if (RT_FAILURE(rc))
+            return rc;
+        pState->moffStream += cbToWrite;
+        return VINF_SUCCESS;
+    }
+
     for (;;)
     {
         TELEPORTERTCPHDR Hdr;
@@ -392,6 +469,24 @@ static DECLCALLBACK(int) teleporterTcpOpRead(void *pvUser, uint64_t offStream, v
         if (pState->mfIOError)
             return VERR_IO_GEN_FAILURE;
 
+        /*
+         * Striped streams are reassembled by TeleporterStreams.
+         */
+        if (pState->mpStreams)
+        {
+            size_t cbRead = 0;
+            rc = pState->mpStreams->read(pvBuf, cbToRead, pcbRead ? &cbRead : NULL, &pState->mfStopReading);
+            if (RT_SUCCESS(rc))
+            {
+                if (pcbRead)
+                    *pcbRead = cbRead;
+                pState->moffStream += pcbRead ? cbRead : cbToRead;
+            }
+            else if (rc != VERR_EOF && rc != VERR_SSM_CANCELLED)
+                pState->mfIOError = true;
+            return rc;
+        }
+
         /*
          * If there is no more data in the current block, read the next
          * block header.
@@ -531,6 +626,9 @@ static DECLCALLBACK(int) teleporterTcpOpClose(void *pvUser, bool fCanceled)
 
     if (pState->mfIsSource)
     {
+        if (pState->mpStreams)
+            return pState->mpStreams->close(fCanceled);
+
         TELEPORTERTCPHDR EofHdr;
         EofHdr.u32Magic = TELEPORTERTCPHDR_MAGIC;
         EofHdr.cb       = fCanceled ? UINT32_MAX : 0;
@@ -617,6 +715,166 @@ static DECLCALLBACK(void) teleporterDstTimeout(RTTIMERLR hTimerLR, void *pvUser,
 }
 
 
+/**
+ * Stops striping and closes the additional stream connections.
+ *
+ * @param   pState              The teleporter state.
+ */
+static void teleporterCloseStreams(TeleporterState *pState)
+{
+    delete pState->mpStreams;
+    pState->mpStreams = NULL;
+
+    /* The first one is mhSocket. */
+    for (uint32_t i = 1; i < RT_ELEMENTS(pState->mahStreams); i++)
+        if (pState->mahStreams[i] != NIL_RTSOCKET)
+        {
+            if (pState->mfIsSource)
+                RTTcpClientClose(pState->mahStreams[i]);
+            else
+                RTTcpServerDisconnectClient2(pState->mahStreams[i]);
+            pState->mahStreams[i] = NIL_RTSOCKET;
+        }
+    pState->mahStreams[0] = NIL_RTSOCKET;
+}
+
+
+/**
+ * Opens an additional connection to the target for striping the saved state
+ * across.
+ *
+ * It has to go thru the same welcome and password exchange as the first one.
+ *
+ * @returns VBox status code.
+ * @param   pState              The teleporter state.
+ * @param   phSocket            Where to return the socket.
+ */
+static int teleporterSrcConnectStream(TeleporterStateSrc *pState, PRTSOCKET phSocket)
+{
+    RTSOCKET hSocket;
+    int vrc = RTTcpClientConnect(pState->mstrHostname.c_str(), pState->muPort, &hSocket);
+    if (RT_FAILURE(vrc))
+        return vrc;
+    vrc = RTTcpSetSendCoalescing(hSocket, false /*fEnable*/);
+    AssertRC(vrc);
+
+    char szLine[RT_MAX(8, sizeof(g_szWelcome))];
+    RT_ZERO(szLine);
+    vrc = RTTcpRead(hSocket, szLine, sizeof(g_szWelcome) - 1, NULL);
+    if (RT_SUCCESS(vrc) && strcmp(szLine, g_szWelcome))
+        vrc = VERR_INVALID_MAGIC;
+    if (RT_SUCCESS(vrc))
+        vrc = RTTcpWrite(hSocket, pState->mstrPassword.c_str(), pState->mstrPassword.length());
+    if (RT_SUCCESS(vrc))
+    {
+        RT_ZERO(szLine);
+        vrc = RTTcpRead(hSocket, szLine, sizeof("ACK\n") - 1, NULL);
+        if (RT_SUCCESS(vrc) && strcmp(szLine, "ACK\n"))
+            vrc = VERR_AUTHENTICATION_FAILURE;
+    }
+    if (RT_FAILURE(vrc))
+    {
+        RTTcpClientClose(hSocket);
+        return vrc;
+    }
+    *phSocket = hSocket;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Sends the RAM pages left out of the saved state to the target after handing
+ * over the VM in post-copy mode.
+ *
+ * Pages are sent in ascending order, except when the target asks for one
+ * because the guest is waiting for it.
+ *
+ * @returns VBox status code.
+ * @param   pState              The teleporter state.
+ */
+static int teleporterSrcPostCopy(TeleporterStateSrc *pState)
+{
+    PVM             pVM     = VMR3GetVM(pState->mpUVM);
+    uint32_t const  cPages  = PGMR3PostCopyGetOutstanding(pVM);
+    uint64_t const  msStart = RTTimeMilliTS();
+    LogRel(("Teleporter: Post-copy: sending %u pages...\n", cPages));
+
+    TELEPORTERPAGE *pPage = (TELEPORTERPAGE *)RTMemAlloc(sizeof(*pPage));
+    if (!pPage)
+        return VERR_NO_MEMORY;
+
+    int vrc;
+    for (;;)
+    {
+        /*
+         * Any requests from the target?
+         */
+        RTGCPHYS GCPhysWanted = NIL_RTGCPHYS;
+        vrc = RTTcpSelectOne(pState->mhSocket, 0);
+        if (RT_SUCCESS(vrc))
+        {
+            TELEPORTERPAGEHDR Hdr;
+            vrc = RTTcpRead(pState->mhSocket, &Hdr, sizeof(Hdr), NULL);
+            if (RT_FAILURE(vrc))
+                break;
+            if (   Hdr.u32Magic != TELEPORTERPAGEHDR_MAGIC
+                || Hdr.u32Type  != TELEPORTERPAGEHDR_TYPE_REQUEST)
+            {
+                LogRel(("Teleporter: Post-copy: Bad request header: %.*Rhxs\n", sizeof(Hdr), &Hdr));
+                vrc = VERR_INVALID_MAGIC;
+                break;
+            }
+            GCPhysWanted = Hdr.GCPhys;
+        }
+        else if (vrc != VERR_TIMEOUT)
+            break;
+
+        /*
+         * Send the requested page or the next one in line.
+         */
+        pPage->Hdr.u32Magic    = TELEPORTERPAGEHDR_MAGIC;
+        pPage->Hdr.i32Status   = VINF_SUCCESS;
+        pPage->Hdr.u32Reserved = 0;
+        vrc = PGMR3PostCopyNextPage(pVM, GCPhysWanted, &pPage->Hdr.GCPhys, pPage->abPage);
+        if (vrc == VERR_EOF)
+        {
+            pPage->Hdr.u32Type = TELEPORTERPAGEHDR_TYPE_END;
+            pPage->Hdr.GCPhys  = NIL_RTGCPHYS;
+            vrc = RTTcpWrite(pState->mhSocket, &pPage->Hdr, sizeof(pPage->Hdr));
+            break;
+        }
+        if (RT_FAILURE(vrc))
+            break;
+        pPage->Hdr.u32Type = TELEPORTERPAGEHDR_TYPE_PAGE;
+        vrc = RTTcpWrite(pState->mhSocket, pPage, sizeof(*pPage));
+        if (RT_FAILURE(vrc))
+            break;
+    }
+
+    /*
+     * Wait for the target to install the last pages, skipping requests that
+     * crossed the end marker.
+     */
+    while (RT_SUCCESS(vrc))
+    {
+        vrc = RTTcpRead(pState->mhSocket, &pPage->Hdr, sizeof(pPage->Hdr), NULL);
+        if (RT_FAILURE(vrc))
+            break;
+        if (pPage->Hdr.u32Magic != TELEPORTERPAGEHDR_MAGIC)
+            vrc = VERR_INVALID_MAGIC;
+        else if (pPage->Hdr.u32Type == TELEPORTERPAGEHDR_TYPE_DONE)
+        {
+            vrc = pPage->Hdr.i32Status;
+            break;
+        }
+    }
+    RTMemFree(pPage);
+
+    LogRel(("Teleporter: Post-copy: %Rrc after %RU64 ms (%u pages)\n", vrc, RTTimeMilliTS() - msStart, cPages));
+    return vrc;
+}
+
+
 /**
  * Do the teleporter.
  *
@@ -672,6 +930,59 @@ Console::teleporterSrc(TeleporterStateSrc *pState)
     if (FAILED(hrc))
         return hrc;
 
+    /*
+     * Open the additional connections the saved state is striped across.
+     * Should the target refuse, everything goes over the one we've got.
+     */
+    bool fNAcked = false;
+    if (pState->mcStreams > 1)
+    {
+        char szCmd[32];
+        RTStrPrintf(szCmd, sizeof(szCmd), "streams=%u", pState->mcStreams);
+        hrc = teleporterSrcSubmitCommand(pState, szCmd, true /*fWaitForAck*/, &fNAcked);
+        if (FAILED(hrc) && fNAcked)
+        {
+            LogRel(("Teleporter: The target refused %u streams, falling back on a single one.\n", pState->mcStreams));
+            pState->mcStreams = 1;
+        }
+        else if (FAILED(hrc))
+            return hrc;
+    }
+    if (pState->mcStreams > 1)
+    {
+
+        pState->mahStreams[0] = pState->mhSocket;
+        for (uint32_t i = 1; i < pState->mcStreams; i++)
+        {
+            vrc = teleporterSrcConnectStream(pState, &pState->mahStreams[i]);
+            if (RT_FAILURE(vrc))
+                return setError(E_FAIL, tr("Failed to connect stream #%u: %Rrc"), i, vrc);
+        }
+    }
+
+    /*
+     * In post-copy mode the RAM is transferred after handing over the VM, so
+     * tell the target and PGM about it.  Should the target refuse, we do the
+     * normal pre-copy transfer instead.
+     */
+    if (pState->mfPostCopy)
+    {
+        hrc = teleporterSrcSubmitCommand(pState, "post-copy", true /*fWaitForAck*/, &fNAcked);
+        if (FAILED(hrc) && fNAcked)
+        {
+            LogRel(("Teleporter: The target refused post-copy, falling back on pre-copy.\n"));
+            pState->mfPostCopy = false;
+        }
+        else if (FAILED(hrc))
+            return hrc;
+        else
+        {
+            vrc = PGMR3PostCopyEnable(VMR3GetVM(pState->mpUVM));
+            if (RT_FAILURE(vrc))
+                return setError(E_FAIL, tr("PGMR3PostCopyEnable -> %Rrc"), vrc);
+        }
+    }
+
     /*
      * Start loading the state.
      *
@@ -683,6 +994,14 @@ Console::teleporterSrc(TeleporterStateSrc *pState)
     if (FAILED(hrc))
         return hrc;
 
+    if (pState->mcStreams > 1)
+    {
+        pState->mpStreams = new TeleporterStreams(true /*fSender*/);
+        vrc = pState->mpStreams->init(pState->mcStreams, pState->mahStreams);
+        if (RT_FAILURE(vrc))
+            return setError(E_FAIL, tr("Failed to start the stream threads: %Rrc"), vrc);
+    }
+
     RTSocketRetain(pState->mhSocket);
     void *pvUser = static_cast<void *>(static_cast<TeleporterState *>(pState));
     vrc = VMR3Teleport(VMR3GetVM(pState->mpUVM),
@@ -691,6 +1010,8 @@ Console::teleporterSrc(TeleporterStateSrc *pState)
                        teleporterProgressCallback,  pvUser,
                        &pState->mfSuspendedByUs);
     RTSocketRelease(pState->mhSocket);
+    delete pState->mpStreams;
+    pState->mpStreams = NULL;
     if (RT_FAILURE(vrc))
     {
         if (   vrc == VERR_SSM_CANCELLED
@@ -742,6 +1063,16 @@ Console::teleporterSrc(TeleporterStateSrc *pState)
     if (FAILED(hrc))
         return hrc;
 
+    /*
+     * The target is running the VM now, feed it the rest of the memory.
+     */
+    if (pState->mfPostCopy)
+    {
+        vrc = teleporterSrcPostCopy(pState);
+        if (RT_FAILURE(vrc))
+            return setError(E_FAIL, tr("Post-copy memory transfer failed: %Rrc"), vrc);
+    }
+
     /*
      * teleporterSrcThreadWrapper will do the automatic power off because it
      * has to release the AutoVMCaller.
@@ -770,9 +1101,14 @@ Console::teleporterSrcThreadWrapper(RTTHREAD hThread, void *pvUser)
     HRESULT hrc = ptrVM.rc();
 
     if (SUCCEEDED(hrc))
+    {
         hrc = pState->mptrConsole->teleporterSrc(pState);
+        if (pState->mfPostCopy)
+            PGMR3PostCopyTerm(VMR3GetVM(pState->mpUVM));
+    }
 
     /* Close the connection ASAP on so that the other side can complete. */
+    teleporterCloseStreams(pState);
     if (pState->mhSocket != NIL_RTSOCKET)
     {
         RTTcpClientClose(pState->mhSocket);
@@ -984,6 +1320,16 @@ Console::Teleport(IN_BSTR aHostname, ULONG aPort, IN_BSTR aPassword, ULONG aMaxD
     pState->muPort          = aPort;
     pState->mcMsMaxDowntime = aMaxDowntime;
 
+    Bstr bstrPostCopy;
+    if (   SUCCEEDED(mMachine->GetExtraData(Bstr("VBoxInternal2/TeleporterPostCopy").raw(), bstrPostCopy.asOutParam()))
+        && bstrPostCopy == "1")
+        pState->mfPostCopy = true;
+
+    Bstr bstrStreams;
+    if (   SUCCEEDED(mMachine->GetExtraData(Bstr("VBoxInternal2/TeleporterStreams").raw(), bstrStreams.asOutParam()))
+        && !bstrStreams.isEmpty())
+        pState->mcStreams = RT_MIN(RT_MAX(Utf8Str(bstrStreams).toUInt32(), 1U), (uint32_t)TELEPORTER_MAX_STREAMS);
+
     void *pvUser = static_cast<void *>(static_cast<TeleporterState *>(pState));
     ptrProgress->setCancelCallback(teleporterProgressCancelCallback, pvUser);
 
@@ -1115,7 +1461,35 @@ Console::teleporterTrg(PUVM pUVM, IMachine *pMachine, Utf8Str *pErrorMsg, bool f
                 hrc = pProgress->SetNextOperation(Bstr(tr("Waiting for incoming VM")).raw(), 1);
                 if (SUCCEEDED(hrc))
                 {
-                    vrc = RTTcpServerListen(hServer, Console::teleporterTrgServeConnection, &theState);
+                    /* Serve connections till one of them does the job. (We don't use
+                       RTTcpServerListen since the extra streams are accepted while serving.) */
+                    uint32_t cListenErrors = 0;
+                    for (;;)
+                    {
+                        RTSOCKET hSocket;
+                        vrc = RTTcpServerListen2(hServer, &hSocket);
+                        if (RT_FAILURE(vrc))
+                        {
+                            if (   vrc == VERR_TCP_SERVER_SHUTDOWN
+                                || vrc == VERR_TCP_SERVER_DESTROYED
+                                || vrc == VERR_INVALID_HANDLE
+                                || vrc == VERR_INVALID_STATE)
+                                break;
+
+                            /* A client may have gone away before we got to it,
+                               but don't spin on an error that keeps coming back. */
+                            LogRel(("Teleporter: RTTcpServerListen2 -> %Rrc\n", vrc));
+                            if (++cListenErrors >= 16)
+                                break;
+                            RTThreadSleep(cListenErrors * 16);
+                            continue;
+                        }
+                        cListenErrors = 0;
+                        vrc = Console::teleporterTrgServeConnection(hSocket, &theState);
+                        RTTcpServerDisconnectClient2(hSocket);
+                        if (vrc == VERR_TCP_SERVER_STOP)
+                            break;
+                    }
                     pProgress->setCancelCallback(NULL, NULL);
 
                     if (vrc == VERR_TCP_SERVER_STOP)
@@ -1148,12 +1522,12 @@ Console::teleporterTrg(PUVM pUVM, IMachine *pMachine, Utf8Str *pErrorMsg, bool f
                             hrc = setError(E_FAIL, tr("Teleporting canceled"));
                         else
                             hrc = setError(E_FAIL, tr("Teleporter timed out waiting for incoming connection"));
-                        LogRel(("Teleporter: RTTcpServerListen aborted - %Rrc\n", vrc));
+                        LogRel(("Teleporter: RTTcpServerListen2 aborted - %Rrc\n", vrc));
                     }
                     else
                     {
-                        hrc = setError(E_FAIL, tr("Unexpected RTTcpServerListen status code %Rrc"), vrc);
-                        LogRel(("Teleporter: Unexpected RTTcpServerListen rc: %Rrc\n", vrc));
+                        hrc = setError(E_FAIL, tr("Unexpected RTTcpServerListen2 status code %Rrc"), vrc);
+                        LogRel(("Teleporter: Unexpected RTTcpServerListen2 rc: %Rrc\n", vrc));
                     }
                 }
                 else
@@ -1244,6 +1618,186 @@ static int teleporterTcpWriteNACK(TeleporterStateTrg *pState, int32_t rc2, const
 }
 
 
+/**
+ * @callback_method_impl{FNPGMPOSTCOPYREQUEST}
+ */
+static DECLCALLBACK(int) teleporterTrgPostCopyRequest(PVM pVM, RTGCPHYS GCPhys, void *pvUser)
+{
+    TeleporterStateTrg *pState = (TeleporterStateTrg *)pvUser;
+    NOREF(pVM);
+
+    TELEPORTERPAGEHDR Hdr;
+    Hdr.u32Magic    = TELEPORTERPAGEHDR_MAGIC;
+    Hdr.u32Type     = TELEPORTERPAGEHDR_TYPE_REQUEST;
+    Hdr.GCPhys      = GCPhys;
+    Hdr.i32Status   = VINF_SUCCESS;
+    Hdr.u32Reserved = 0;
+
+    RTCritSectEnter(&pState->mPostCopyCritSect);
+    int rc = RTTcpWrite(pState->mhSocket, &Hdr, sizeof(Hdr));
+    RTCritSectLeave(&pState->mPostCopyCritSect);
+    return rc;
+}
+
+
+/**
+ * Receives the RAM pages left out of the saved state after the VM has been
+ * handed over in post-copy mode.
+ *
+ * @returns VBox status code.
+ * @param   pState              The teleporter state.
+ */
+static int teleporterTrgPostCopy(TeleporterStateTrg *pState)
+{
+    PVM             pVM     = VMR3GetVM(pState->mpUVM);
+    uint32_t const  cPages  = PGMR3PostCopyGetOutstanding(pVM);
+    uint64_t const  msStart = RTTimeMilliTS();
+    LogRel(("Teleporter: Post-copy: receiving %u pages...\n", cPages));
+
+    int vrc = VINF_SUCCESS;
+    TELEPORTERPAGE *pPage = (TELEPORTERPAGE *)RTMemAlloc(sizeof(*pPage));
+    if (!pPage)
+        vrc = VERR_NO_MEMORY;
+    while (RT_SUCCESS(vrc))
+    {
+        vrc = RTTcpRead(pState->mhSocket, &pPage->Hdr, sizeof(pPage->Hdr), NULL);
+        if (RT_FAILURE(vrc))
+            break;
+        if (pPage->Hdr.u32Magic != TELEPORTERPAGEHDR_MAGIC)
+        {
+            LogRel(("Teleporter: Post-copy: Bad page header: %.*Rhxs\n", sizeof(pPage->Hdr), &pPage->Hdr));
+            vrc = VERR_INVALID_MAGIC;
+            break;
+        }
+        if (pPage->Hdr.u32Type == TELEPORTERPAGEHDR_TYPE_END)
+            break;
+        if (pPage->Hdr.u32Type != TELEPORTERPAGEHDR_TYPE_PAGE)
+        {
+            vrc = VERR_INVALID_PARAMETER;
+            break;
+        }
+
+        vrc = RTTcpRead(pState->mhSocket, pPage->abPage, sizeof(pPage->abPage), NULL);
+        if (RT_SUCCESS(vrc))
+            vrc = PGMR3PostCopyPageArrived(pVM, pPage->Hdr.GCPhys, pPage->abPage);
+    }
+    RTMemFree(pPage);
+
+    /*
+     * Install the last pages and tell the source how it went.  Any pages
+     * still missing at this point means the guest is toast.
+     */
+    int vrc2 = PGMR3PostCopyTerm(pVM);
+    if (RT_SUCCESS(vrc))
+        vrc = vrc2;
+
+    TELEPORTERPAGEHDR Hdr;
+    Hdr.u32Magic    = TELEPORTERPAGEHDR_MAGIC;
+    Hdr.u32Type     = TELEPORTERPAGEHDR_TYPE_DONE;
+    Hdr.GCPhys      = NIL_RTGCPHYS;
+    Hdr.i32Status   = vrc;
+    Hdr.u32Reserved = 0;
+    vrc2 = RTTcpWrite(pState->mhSocket, &Hdr, sizeof(Hdr));
+    if (RT_SUCCESS(vrc))
+        vrc = vrc2;
+
+    LogRel(("Teleporter: Post-copy: %Rrc after %RU64 ms (%u pages)\n", vrc, RTTimeMilliTS() - msStart, cPages));
+    return vrc;
+}
+
+
+/**
+ * Reads and checks the password on a new connection.
+ *
+ * @returns VBox status code, VERR_AUTHENTICATION_FAILURE on mismatch.
+ * @param   pState              The teleporter state.
+ * @param   hSocket             The connection.
+ */
+static int teleporterTrgReadPassword(TeleporterStateTrg *pState, RTSOCKET hSocket)
+{
+    /* (includes '\n', see teleporterTrg) */
+    const char *pszPassword = pState->mstrPassword.c_str();
+    unsigned    off = 0;
+    while (pszPassword[off])
+    {
+        char ch;
+        int vrc = RTTcpRead(hSocket, &ch, sizeof(ch), NULL);
+        if (RT_FAILURE(vrc))
+        {
+            LogRel(("Teleporter: Password read failure (off=%u): %Rrc\n", off, vrc));
+            return vrc;
+        }
+        if (pszPassword[off] != ch)
+        {
+            LogRel(("Teleporter: Invalid password (off=%u)\n", off));
+            return VERR_AUTHENTICATION_FAILURE;
+        }
+        off++;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Stops the server and cancels the timeout timer.
+ *
+ * @param   pState              The teleporter state.
+ */
+static void teleporterTrgStopServer(TeleporterStateTrg *pState)
+{
+    RTTcpServerShutdown(pState->mhServer);
+    if (*pState->mphTimerLR != NIL_RTTIMERLR)
+    {
+        RTTimerLRDestroy(*pState->mphTimerLR);
+        *pState->mphTimerLR = NIL_RTTIMERLR;
+    }
+}
+
+
+/**
+ * Accepts the additional connections the source stripes the saved state
+ * across ("streams=N" command).
+ *
+ * They are expected in the same order the source connects them, i.e. one
+ * after the other, each going thru the welcome and password exchange.
+ *
+ * @returns VBox status code.
+ * @param   pState              The teleporter state.
+ * @param   cStreams            The total number of streams.
+ */
+static int teleporterTrgAcceptStreams(TeleporterStateTrg *pState, uint32_t cStreams)
+{
+    pState->mahStreams[0] = pState->mhSocket;
+    for (uint32_t i = 1; i < cStreams; i++)
+    {
+        RTSOCKET hSocket;
+        int vrc = RTTcpServerListen2(pState->mhServer, &hSocket);
+        if (RT_FAILURE(vrc))
+        {
+            LogRel(("Teleporter: Failed to accept stream #%u: %Rrc\n", i, vrc));
+            return vrc;
+        }
+        pState->mahStreams[i] = hSocket;
+
+        vrc = RTTcpSetSendCoalescing(hSocket, false /*fEnable*/);
+        AssertRC(vrc);
+        vrc = RTTcpWrite(hSocket, g_szWelcome, sizeof(g_szWelcome) - 1);
+        if (RT_SUCCESS(vrc))
+            vrc = teleporterTrgReadPassword(pState, hSocket);
+        if (RT_SUCCESS(vrc))
+            vrc = RTTcpWrite(hSocket, "ACK\n", sizeof("ACK\n") - 1);
+        if (RT_FAILURE(vrc))
+        {
+            LogRel(("Teleporter: Setting up stream #%u failed: %Rrc\n", i, vrc));
+            return vrc;
+        }
+    }
+    pState->mcStreams = cStreams;
+    LogRel(("Teleporter: Striping the saved state across %u connections\n", cStreams));
+    return VINF_SUCCESS;
+}
+
+
 /**
  * @copydoc FNRTTCPSERVE
  *
@@ -1268,25 +1822,13 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
     }
 
     /*
-     * Password (includes '\n', see teleporterTrg).
+     * Password.
      */
-    const char *pszPassword = pState->mstrPassword.c_str();
-    unsigned    off = 0;
-    while (pszPassword[off])
+    vrc = teleporterTrgReadPassword(pState, Sock);
+    if (RT_FAILURE(vrc))
     {
-        char ch;
-        vrc = RTTcpRead(Sock, &ch, sizeof(ch), NULL);
-        if (    RT_FAILURE(vrc)
-            ||  pszPassword[off] != ch)
-        {
-            if (RT_FAILURE(vrc))
-                LogRel(("Teleporter: Password read failure (off=%u): %Rrc\n", off, vrc));
-            else
-                LogRel(("Teleporter: Invalid password (off=%u)\n", off));
-            teleporterTcpWriteNACK(pState, VERR_AUTHENTICATION_FAILURE);
-            return VINF_SUCCESS;
-        }
-        off++;
+        teleporterTcpWriteNACK(pState, VERR_AUTHENTICATION_FAILURE);
+        return VINF_SUCCESS;
     }
     vrc = teleporterTcpWriteACK(pState);
     if (RT_FAILURE(vrc))
@@ -1310,18 +1852,13 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
     }
     AssertMsg(SUCCEEDED(hrc) || hrc == E_FAIL, ("%Rhrc\n", hrc));
 
-    /*
-     * Stop the server and cancel the timeout timer.
-     *
-     * Note! After this point we must return VERR_TCP_SERVER_STOP, while prior
-     *       to it we must not return that value!
-     */
-    RTTcpServerShutdown(pState->mhServer);
-    RTTimerLRDestroy(*pState->mphTimerLR);
-    *pState->mphTimerLR = NIL_RTTIMERLR;
-
     /*
      * Command processing loop.
+     *
+     * Note! From here on we must return VERR_TCP_SERVER_STOP, while prior
+     *       to it we must not return that value!  The server is stopped and
+     *       the timeout timer canceled when we get the first command, unless
+     *       the source wants to open more streams.
      */
     bool fDone = false;
     for (;;)
@@ -1331,6 +1868,9 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
         if (RT_FAILURE(vrc))
             break;
 
+        if (strncmp(szCmd, "streams=", sizeof("streams=") - 1))
+            teleporterTrgStopServer(pState);
+
         if (!strcmp(szCmd, "load"))
         {
             vrc = teleporterTcpWriteACK(pState);
@@ -1342,10 +1882,17 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
             RTSocketRetain(pState->mhSocket); /* For concurrent access by I/O thread and EMT. */
             pState->moffStream = 0;
 
+            if (pState->mcStreams > 1)
+            {
+                pState->mpStreams = new TeleporterStreams(false /*fSender*/);
+                vrc = pState->mpStreams->init(pState->mcStreams, pState->mahStreams);
+            }
+
             void *pvUser2 = static_cast<void *>(static_cast<TeleporterState *>(pState));
-            vrc = VMR3LoadFromStream(VMR3GetVM(pState->mpUVM),
-                                     &g_teleporterTcpOps, pvUser2,
-                                     teleporterProgressCallback, pvUser2);
+            if (RT_SUCCESS(vrc))
+                vrc = VMR3LoadFromStream(VMR3GetVM(pState->mpUVM),
+                                         &g_teleporterTcpOps, pvUser2,
+                                         teleporterProgressCallback, pvUser2);
 
             RTSocketRelease(pState->mhSocket);
             vrc2 = VMR3AtErrorDeregister(VMR3GetVM(pState->mpUVM), Console::genericVMSetErrorCallback, &pState->mErrorText); AssertRC(vrc2);
@@ -1353,6 +1900,8 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
             if (RT_FAILURE(vrc))
             {
                 LogRel(("Teleporter: VMR3LoadFromStream -> %Rrc\n", vrc));
+                delete pState->mpStreams;
+                pState->mpStreams = NULL;
                 teleporterTcpWriteNACK(pState, vrc, pState->mErrorText.c_str());
                 break;
             }
@@ -1361,6 +1910,15 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
             pState->mfStopReading = false;
             size_t cbRead;
             vrc = teleporterTcpOpRead(pvUser2, pState->moffStream, szCmd, 1, &cbRead);
+            if (vrc == VERR_EOF && pState->mpStreams)
+            {
+                /* Wait for the end on the other streams before using mhSocket for commands again. */
+                vrc = pState->mpStreams->close(false /*fCanceled*/);
+                if (RT_SUCCESS(vrc))
+                    vrc = VERR_EOF;
+            }
+            delete pState->mpStreams;
+            pState->mpStreams = NULL;
             if (vrc != VERR_EOF)
             {
                 LogRel(("Teleporter: Draining teleporterTcpOpRead -> %Rrc\n", vrc));
@@ -1368,6 +1926,44 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
                 break;
             }
 
+            /* Trap accesses to the pages we don't have yet. */
+            if (pState->mfPostCopy)
+            {
+                vrc = PGMR3PostCopyStart(VMR3GetVM(pState->mpUVM), teleporterTrgPostCopyRequest, pState);
+                if (RT_FAILURE(vrc))
+                {
+                    LogRel(("Teleporter: PGMR3PostCopyStart -> %Rrc\n", vrc));
+                    teleporterTcpWriteNACK(pState, vrc);
+                    break;
+                }
+            }
+
+            vrc = teleporterTcpWriteACK(pState);
+        }
+        else if (!strncmp(szCmd, "streams=", sizeof("streams=") - 1))
+        {
+            /* Accept the additional connections after ACKing the command. */
+            uint32_t cStreams;
+            vrc = RTStrToUInt32Full(&szCmd[sizeof("streams=") - 1], 10, &cStreams);
+            if (   vrc != VINF_SUCCESS
+                || cStreams < 2
+                || cStreams > TELEPORTER_MAX_STREAMS
+                || pState->mcStreams > 1)
+            {
+                /* Not fatal, the source carries on with a single stream. */
+                vrc = teleporterTcpWriteNACK(pState, VERR_INVALID_PARAMETER);
+            }
+            else
+            {
+                vrc = teleporterTcpWriteACK(pState);
+                if (RT_SUCCESS(vrc))
+                    vrc = teleporterTrgAcceptStreams(pState, cStreams);
+            }
+        }
+        else if (!strcmp(szCmd, "post-copy"))
+        {
+            /* The RAM will be sent after the hand-over. */
+            pState->mfPostCopy = true;
             vrc = teleporterTcpWriteACK(pState);
         }
         else if (!strcmp(szCmd, "cancel"))
@@ -1414,6 +2010,12 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
                         vrc = VMR3Resume(VMR3GetVM(pState->mpUVM));
                     else
                         pState->mptrConsole->setMachineState(MachineState_Paused);
+                    if (pState->mfPostCopy)
+                    {
+                        int vrc2 = teleporterTrgPostCopy(pState);
+                        if (RT_SUCCESS(vrc))
+                            vrc = vrc2;
+                    }
                     fDone = true;
                     break;
                 }
@@ -1426,9 +2028,9 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
         }
         else
         {
+            /* Keep going, the source may carry on without whatever it asked for. */
             LogRel(("Teleporter: Unknown command '%s' (%.*Rhxs)\n", szCmd, strlen(szCmd), szCmd));
-            vrc = VERR_NOT_IMPLEMENTED;
-            teleporterTcpWriteNACK(pState, vrc);
+            vrc = teleporterTcpWriteNACK(pState, VERR_NOT_IMPLEMENTED);
         }
 
         if (RT_FAILURE(vrc))
@@ -1439,6 +2041,10 @@ Console::teleporterTrgServeConnection(RTSOCKET Sock, void *pvUser)
         vrc = VERR_WRONG_ORDER;
     if (RT_FAILURE(vrc))
         teleporterTrgUnlockMedia(pState);
+    if (pState->mfPostCopy)
+        PGMR3PostCopyTerm(VMR3GetVM(pState->mpUVM)); /* Must be done before we close the socket. */
+    teleporterTrgStopServer(pState);
+    teleporterCloseStreams(pState);
 
     pState->mRc = vrc;
     pState->mhSocket = NIL_RTSOCKET;
@@ -183,6 +183,7 @@ void Guest::updateStats(uint64_t iTick)
 {
     uint64_t uFreeTotal, uAllocTotal, uBalloonedTotal, uSharedTotal;
     uint64_t uTotalMem, uPrivateMem, uSharedMem, uZeroMem;
+    uint64_t cbWorkingSet;
 
     AutoWriteLock alock(this COMMA_LOCKVAL_SRC_POS);
 
@@ -209,6 +210,7 @@ void Guest::updateStats(uint64_t iTick)
     uPrivateMem     = 0;
     uSharedMem      = 0;
     uZeroMem        = 0;
+    cbWorkingSet    = 0;
 
     Console::SafeVMPtr pVM(mParent);
     if (pVM.isOk())
@@ -240,6 +242,10 @@ void Guest::updateStats(uint64_t iTick)
             }
         }
 
+        /* Only available when enabled in the VM config (VBoxInternal/PGM/WorkingSet). */
+        rc = PGMR3QueryWorkingSet(pVM.raw(), NULL, &cbWorkingSet);
+        if (rc == VINF_SUCCESS)
+            validStats |= pm::GUESTSTATMASK_MEMWORKINGSET;
     }
 
     mParent->reportGuestStatistics(validStats,
@@ -256,7 +262,8 @@ void Guest::updateStats(uint64_t iTick)
                                    (ULONG)(uAllocTotal / _1K), /* bytes -> KB */
                                    (ULONG)(uFreeTotal / _1K),
                                    (ULONG)(uBalloonedTotal / _1K),
-                                   (ULONG)(uSharedTotal / _1K));
+                                   (ULONG)(uSharedTotal / _1K),
+                                   (ULONG)(cbWorkingSet / _1K));
 }
 
 // IGuest properties
@@ -94,6 +94,9 @@ HRESULT MachineDebugger::init (Console *aParent)
     mVirtualTimeRateQueued = ~0;
     mFlushMode = false;
 
+    RT_ZERO(maStatsLayouts);
+    midNextStatsLayout = 1;
+
     /* Confirm a successful initialization */
     autoInitSpan.setSucceeded();
 
@@ -113,6 +116,8 @@ void MachineDebugger::uninit()
     if (autoUninitSpan.uninitDone())
         return;
 
+    freeStatsLayouts();
+
     unconst(mParent) = NULL;
     mFlushMode = false;
 }
@@ -1461,6 +1466,170 @@ STDMETHODIMP MachineDebugger::GetStats (IN_BSTR aPattern, BOOL aWithDescriptions
 }
 
 
+/**
+ * Collects the layout of a binary statistics snapshot, for GetStatsLayout.
+ */
+struct MachineDebuggerStatsLayoutArgs
+{
+    std::vector<ULONG>      aIds;
+    std::vector<Utf8Str>    aNames;
+    std::vector<Utf8Str>    aUnits;
+    std::vector<ULONG>      aValueCounts;
+    std::vector<Utf8Str>    aDescriptions;
+    bool                    fWithDescriptions;
+};
+
+/**
+ * @callback_method_impl{FNSTAMR3BINLAYOUT}
+ */
+static DECLCALLBACK(int) machineDebuggerStatsLayoutCallback(uint32_t idSample, const char *pszName, STAMTYPE enmType,
+                                                           STAMUNIT enmUnit, const char *pszDesc, uint32_t iFirstValue,
+                                                           uint32_t cValues, void *pvUser)
+{
+    MachineDebuggerStatsLayoutArgs *pArgs = (MachineDebuggerStatsLayoutArgs *)pvUser;
+    NOREF(enmType); NOREF(iFirstValue);
+    try
+    {
+        pArgs->aIds.push_back(idSample);
+        pArgs->aNames.push_back(pszName);
+        pArgs->aUnits.push_back(STAMR3GetUnit(enmUnit));
+        pArgs->aValueCounts.push_back(cValues);
+        pArgs->aDescriptions.push_back(pArgs->fWithDescriptions && pszDesc ? pszDesc : "");
+    }
+    catch (std::bad_alloc)
+    {
+        return VERR_NO_MEMORY;
+    }
+    return VINF_SUCCESS;
+}
+
+STDMETHODIMP MachineDebugger::GetStatsLayout(IN_BSTR aPattern, BOOL aWithDescriptions, ULONG *aLayout,
+                                             ComSafeArrayOut(ULONG, aIds), ComSafeArrayOut(BSTR, aNames),
+                                             ComSafeArrayOut(BSTR, aUnits), ComSafeArrayOut(ULONG, aValueCounts),
+                                             ComSafeArrayOut(BSTR, aDescriptions))
+{
+    CheckComArgOutPointerValid(aLayout);
+    CheckComArgOutSafeArrayPointerValid(aIds);
+    CheckComArgOutSafeArrayPointerValid(aNames);
+    CheckComArgOutSafeArrayPointerValid(aUnits);
+    CheckComArgOutSafeArrayPointerValid(aValueCounts);
+    CheckComArgOutSafeArrayPointerValid(aDescriptions);
+
+    AutoCaller autoCaller(this);
+    HRESULT hrc = autoCaller.rc();
+    if (FAILED(hrc))
+        return hrc;
+
+    AutoWriteLock alock(this COMMA_LOCKVAL_SRC_POS);
+    Console::SafeVMPtrQuiet pVM (mParent);
+    if (!pVM.isOk())
+        return setError(VBOX_E_INVALID_VM_STATE, "Machine is not running");
+
+    /*
+     * Prepare the snapshot and collect the layout.
+     */
+    PSTAMBINSNAPSHOT hSnapshot;
+    int vrc = STAMR3BinSnapshotCreate(pVM, Utf8Str(aPattern).c_str(), &hSnapshot);
+    if (RT_FAILURE(vrc))
+        return vrc == VERR_NO_MEMORY ? E_OUTOFMEMORY : setError(E_FAIL, tr("STAMR3BinSnapshotCreate failed with %Rrc"), vrc);
+
+    MachineDebuggerStatsLayoutArgs Args;
+    Args.fWithDescriptions = !!aWithDescriptions;
+    vrc = STAMR3BinSnapshotEnumLayout(pVM, hSnapshot, machineDebuggerStatsLayoutCallback, &Args);
+    if (RT_FAILURE(vrc))
+    {
+        STAMR3BinSnapshotDestroy(hSnapshot);
+        if (vrc == VERR_STAM_SNAPSHOT_STALE)
+            return setError(VBOX_E_INVALID_OBJECT_STATE, tr("The statistics changed while making the layout, try again"));
+        return vrc == VERR_NO_MEMORY ? E_OUTOFMEMORY : setError(E_FAIL, tr("STAMR3BinSnapshotEnumLayout failed with %Rrc"), vrc);
+    }
+
+    try
+    {
+        size_t const cStats = Args.aIds.size();
+        com::SafeArray<ULONG> aIdsRet(cStats);
+        com::SafeArray<BSTR>  abstrNames(cStats);
+        com::SafeArray<BSTR>  abstrUnits(cStats);
+        com::SafeArray<ULONG> aValueCountsRet(cStats);
+        com::SafeArray<BSTR>  abstrDescriptions(cStats);
+        for (size_t i = 0; i < cStats; i++)
+        {
+            aIdsRet[i]         = Args.aIds[i];
+            aValueCountsRet[i] = Args.aValueCounts[i];
+            Bstr(Args.aNames[i]).detachTo(&abstrNames[i]);
+            Bstr(Args.aUnits[i]).detachTo(&abstrUnits[i]);
+            Bstr(Args.aDescriptions[i]).detachTo(&abstrDescriptions[i]);
+        }
+        aIdsRet.detachTo(ComSafeArrayOutArg(aIds));
+        abstrNames.detachTo(ComSafeArrayOutArg(aNames));
+        abstrUnits.detachTo(ComSafeArrayOutArg(aUnits));
+        aValueCountsRet.detachTo(ComSafeArrayOutArg(aValueCounts));
+        abstrDescriptions.detachTo(ComSafeArrayOutArg(aDescriptions));
+    }
+    catch (std::bad_alloc)
+    {
+        STAMR3BinSnapshotDestroy(hSnapshot);
+        return E_OUTOFMEMORY;
+    }
+
+    /*
+     * Hand out a new layout handle, recycling the oldest slot.
+     */
+    ULONG idLayout = midNextStatsLayout++;
+    if (!midNextStatsLayout)
+        midNextStatsLayout = 1;
+    StatsLayout *pSlot = &maStatsLayouts[idLayout % RT_ELEMENTS(maStatsLayouts)];
+    STAMR3BinSnapshotDestroy(pSlot->hSnapshot);
+    pSlot->idLayout  = idLayout;
+    pSlot->pVM       = pVM.raw();
+    pSlot->hSnapshot = hSnapshot;
+
+    *aLayout = idLayout;
+    return S_OK;
+}
+
+STDMETHODIMP MachineDebugger::GetStatsValues(ULONG aLayout, ComSafeArrayOut(LONG64, aValues))
+{
+    CheckComArgOutSafeArrayPointerValid(aValues);
+
+    AutoCaller autoCaller(this);
+    HRESULT hrc = autoCaller.rc();
+    if (FAILED(hrc))
+        return hrc;
+
+    /* Querying the values doesn't modify the snapshot, so several callers
+       can do it at the same time. */
+    AutoReadLock alock(this COMMA_LOCKVAL_SRC_POS);
+    Console::SafeVMPtrQuiet pVM (mParent);
+    if (!pVM.isOk())
+        return setError(VBOX_E_INVALID_VM_STATE, "Machine is not running");
+
+    StatsLayout *pSlot = &maStatsLayouts[aLayout % RT_ELEMENTS(maStatsLayouts)];
+    if (   !aLayout
+        || pSlot->idLayout != aLayout
+        || pSlot->pVM != pVM.raw())
+        return setError(VBOX_E_INVALID_OBJECT_STATE, tr("Unknown statistics layout %u"), aLayout);
+
+    try
+    {
+        uint32_t const         cValues = STAMR3BinSnapshotGetValueCount(pSlot->hSnapshot);
+        com::SafeArray<LONG64> aValuesRet(cValues);
+        AssertCompile(sizeof(LONG64) == sizeof(uint64_t));
+        int vrc = STAMR3BinSnapshotQueryValues(pVM, pSlot->hSnapshot, (uint64_t *)aValuesRet.raw(), cValues);
+        if (vrc == VERR_STAM_SNAPSHOT_STALE)
+            return setError(VBOX_E_INVALID_OBJECT_STATE, tr("The statistics have changed, get a new layout"));
+        if (RT_FAILURE(vrc))
+            return setError(E_FAIL, tr("STAMR3BinSnapshotQueryValues failed with %Rrc"), vrc);
+        aValuesRet.detachTo(ComSafeArrayOutArg(aValues));
+    }
+    catch (std::bad_alloc)
+    {
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+
 // public methods only for internal purposes
 /////////////////////////////////////////////////////////////////////////////
 
@@ -1508,6 +1677,22 @@ void MachineDebugger::flushQueuedSettings()
 // private methods
 /////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Frees the statistics layouts handed out by GetStatsLayout.
+ *
+ * This doesn't need the VM, so it can be done when the VM is gone.
+ */
+void MachineDebugger::freeStatsLayouts()
+{
+    for (size_t i = 0; i < RT_ELEMENTS(maStatsLayouts); i++)
+    {
+        STAMR3BinSnapshotDestroy(maStatsLayouts[i].hSnapshot);
+        maStatsLayouts[i].hSnapshot = NULL;
+        maStatsLayouts[i].pVM       = NULL;
+        maStatsLayouts[i].idLayout  = 0;
+    }
+}
+
 bool MachineDebugger::queueSettings() const
 {
     if (!mFlushMode)
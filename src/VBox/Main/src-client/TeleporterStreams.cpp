@@ -0,0 +1,529 @@
+/* $Id$ */
+/** @file
+ * VBox Console COM Class implementation, Teleporter multi-stream transport.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "TeleporterStreams.h"
+#include "Logging.h"
+
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/tcp.h>
+#include <iprt/thread.h>
+
+#include <VBox/err.h>
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * One TCP connection of the stripe set and the block in flight on it.
+ */
+struct TeleporterStreams::Stream
+{
+    /** The owner. */
+    TeleporterStreams  *pParent;
+    /** The socket (not owned). */
+    RTSOCKET            hSocket;
+    /** The I/O thread. */
+    RTTHREAD            hThread;
+    /** Signalled when the I/O thread has work to do. */
+    RTSEMEVENT          hEvtWork;
+    /** Signalled by the I/O thread when it is done with a block or quits. */
+    RTSEMEVENT          hEvtDone;
+    /** Set when pbBuf holds a block: to be sent (sender) or to be consumed
+     *  (receiver). */
+    bool volatile       fFull;
+    /** Set when the I/O thread is about to quit. */
+    bool volatile       fDone;
+    /** The status of the I/O thread. */
+    int32_t volatile    rc;
+    /** The size of the block, 0 and UINT32_MAX being terminators. */
+    uint32_t            cb;
+    /** How much of the block read() has consumed (receiver). */
+    uint32_t            off;
+    /** The size of the pbBuf allocation. */
+    uint32_t            cbAlloc;
+    /** The block buffer. */
+    uint8_t            *pbBuf;
+};
+
+
+/**
+ * Checks if the block size is one of the terminator values.
+ */
+DECLINLINE(bool) teleporterStreamsIsTerminator(uint32_t cb)
+{
+    return cb == 0 || cb == UINT32_MAX;
+}
+
+
+TeleporterStreams::TeleporterStreams(bool fSender)
+    : mfSender(fSender)
+    , mfStop(false)
+    , mfEndOfStream(false)
+    , mcStreams(0)
+    , miStream(0)
+    , mpaStreams(NULL)
+{
+}
+
+
+TeleporterStreams::~TeleporterStreams()
+{
+    terminate();
+}
+
+
+/**
+ * Starts an I/O thread for each of the sockets.
+ *
+ * @returns VBox status code.
+ * @param   cStreams        The number of sockets.
+ * @param   pahSockets      The sockets, in the order the blocks are striped
+ *                          across them.  Both ends must agree on this.
+ */
+int TeleporterStreams::init(uint32_t cStreams, RTSOCKET const *pahSockets)
+{
+    AssertReturn(!mpaStreams, VERR_WRONG_ORDER);
+    AssertReturn(cStreams > 0 && cStreams <= TELEPORTER_MAX_STREAMS, VERR_OUT_OF_RANGE);
+
+    mpaStreams = (Stream *)RTMemAllocZ(sizeof(mpaStreams[0]) * cStreams);
+    if (!mpaStreams)
+        return VERR_NO_MEMORY;
+
+    int rc = VINF_SUCCESS;
+    for (uint32_t i = 0; i < cStreams; i++)
+    {
+        Stream *pStream   = &mpaStreams[i];
+        pStream->pParent  = this;
+        pStream->hSocket  = pahSockets[i];
+        pStream->hThread  = NIL_RTTHREAD;
+        pStream->hEvtWork = NIL_RTSEMEVENT;
+        pStream->hEvtDone = NIL_RTSEMEVENT;
+        mcStreams = i + 1;
+
+        rc = RTSemEventCreate(&pStream->hEvtWork);
+        if (RT_SUCCESS(rc))
+            rc = RTSemEventCreate(&pStream->hEvtDone);
+        if (RT_SUCCESS(rc))
+            rc = RTThreadCreateF(&pStream->hThread, mfSender ? sendThread : recvThread, pStream, 0 /*cbStack*/,
+                                 RTTHREADTYPE_IO, RTTHREADFLAGS_WAITABLE, "Teleport%c%u", mfSender ? 'S' : 'R', i);
+        if (RT_FAILURE(rc))
+        {
+            pStream->hThread = NIL_RTTHREAD;
+            terminate();
+            break;
+        }
+    }
+    return rc;
+}
+
+
+/**
+ * Stops the I/O threads and frees the resources.
+ */
+void TeleporterStreams::terminate()
+{
+    if (!mpaStreams)
+        return;
+
+    ASMAtomicWriteBool(&mfStop, true);
+    for (uint32_t i = 0; i < mcStreams; i++)
+        if (mpaStreams[i].hEvtWork != NIL_RTSEMEVENT)
+            RTSemEventSignal(mpaStreams[i].hEvtWork);
+
+    for (uint32_t i = 0; i < mcStreams; i++)
+    {
+        Stream *pStream = &mpaStreams[i];
+        if (pStream->hThread != NIL_RTTHREAD)
+        {
+            int rc = RTThreadWait(pStream->hThread, RT_INDEFINITE_WAIT, NULL);
+            AssertRC(rc);
+        }
+        RTSemEventDestroy(pStream->hEvtWork);
+        RTSemEventDestroy(pStream->hEvtDone);
+        RTMemFree(pStream->pbBuf);
+    }
+    RTMemFree(mpaStreams);
+    mpaStreams = NULL;
+    mcStreams  = 0;
+}
+
+
+/**
+ * @copydoc FNRTTHREAD
+ *
+ * Sends the blocks queued on a stream until it gets a terminator.
+ */
+/*static*/ DECLCALLBACK(int) TeleporterStreams::sendThread(RTTHREAD hThread, void *pvUser)
+{
+    Stream             *pStream = (Stream *)pvUser;
+    TeleporterStreams  *pThis   = pStream->pParent;
+    int                 rc      = VINF_SUCCESS;
+    NOREF(hThread);
+
+    for (;;)
+    {
+        while (!ASMAtomicReadBool(&pStream->fFull))
+        {
+            if (ASMAtomicReadBool(&pThis->mfStop))
+                break;
+            RTSemEventWait(pStream->hEvtWork, RT_INDEFINITE_WAIT);
+        }
+        if (ASMAtomicReadBool(&pThis->mfStop))
+            break;
+
+        TELEPORTERTCPHDR Hdr;
+        Hdr.u32Magic = TELEPORTERTCPHDR_MAGIC;
+        Hdr.cb       = pStream->cb;
+        bool const fLast = teleporterStreamsIsTerminator(Hdr.cb);
+        if (fLast)
+            rc = RTTcpWrite(pStream->hSocket, &Hdr, sizeof(Hdr));
+        else
+            rc = RTTcpSgWriteL(pStream->hSocket, 2, &Hdr, sizeof(Hdr), pStream->pbBuf, (size_t)Hdr.cb);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("Teleporter/TCP: Stream write error: %Rrc (cb=%#x)\n", rc, Hdr.cb));
+            ASMAtomicWriteS32(&pStream->rc, rc);
+        }
+
+        ASMAtomicWriteBool(&pStream->fFull, false);
+        if (RT_FAILURE(rc) || fLast)
+            break;
+        RTSemEventSignal(pStream->hEvtDone);
+    }
+
+    ASMAtomicWriteBool(&pStream->fDone, true);
+    RTSemEventSignal(pStream->hEvtDone);
+    return rc;
+}
+
+
+/**
+ * Waits for data on a stream socket, polling the stop indicator.
+ *
+ * @returns VBox status code.
+ * @param   pStream         The stream.
+ */
+/*static*/ int TeleporterStreams::recvSelect(Stream *pStream)
+{
+    int rc;
+    do
+    {
+        rc = RTTcpSelectOne(pStream->hSocket, 1000);
+        if (RT_FAILURE(rc) && rc != VERR_TIMEOUT)
+        {
+            LogRel(("Teleporter/TCP: Stream select error: %Rrc\n", rc));
+            break;
+        }
+        if (ASMAtomicReadBool(&pStream->pParent->mfStop))
+        {
+            rc = VERR_EOF;
+            break;
+        }
+    } while (rc == VERR_TIMEOUT);
+    return rc;
+}
+
+
+/**
+ * @copydoc FNRTTHREAD
+ *
+ * Receives blocks on a stream, one at a time, until it gets a terminator.
+ */
+/*static*/ DECLCALLBACK(int) TeleporterStreams::recvThread(RTTHREAD hThread, void *pvUser)
+{
+    Stream             *pStream = (Stream *)pvUser;
+    TeleporterStreams  *pThis   = pStream->pParent;
+    int                 rc      = VINF_SUCCESS;
+    NOREF(hThread);
+
+    for (;;)
+    {
+        /* Wait for read() to consume the previous block. */
+        while (ASMAtomicReadBool(&pStream->fFull))
+        {
+            if (ASMAtomicReadBool(&pThis->mfStop))
+                break;
+            RTSemEventWait(pStream->hEvtWork, RT_INDEFINITE_WAIT);
+        }
+        if (ASMAtomicReadBool(&pThis->mfStop))
+        {
+            rc = VERR_EOF;
+            break;
+        }
+
+        /* The header. */
+        rc = recvSelect(pStream);
+        if (RT_FAILURE(rc))
+            break;
+        TELEPORTERTCPHDR Hdr;
+        rc = RTTcpRead(pStream->hSocket, &Hdr, sizeof(Hdr), NULL);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("Teleporter/TCP: Stream header read error: %Rrc\n", rc));
+            break;
+        }
+        if (RT_UNLIKELY(   Hdr.u32Magic != TELEPORTERTCPHDR_MAGIC
+                        || (   Hdr.cb > TELEPORTERTCPHDR_MAX_SIZE
+                            && Hdr.cb != UINT32_MAX)))
+        {
+            LogRel(("Teleporter/TCP: Invalid stream block: u32Magic=%#x cb=%#x\n", Hdr.u32Magic, Hdr.cb));
+            rc = VERR_IO_GEN_FAILURE;
+            break;
+        }
+
+        /* The data. */
+        if (!teleporterStreamsIsTerminator(Hdr.cb))
+        {
+            if (Hdr.cb > pStream->cbAlloc)
+            {
+                void *pvNew = RTMemRealloc(pStream->pbBuf, Hdr.cb);
+                if (!pvNew)
+                {
+                    rc = VERR_NO_MEMORY;
+                    break;
+                }
+                pStream->pbBuf   = (uint8_t *)pvNew;
+                pStream->cbAlloc = Hdr.cb;
+            }
+            rc = recvSelect(pStream);
+            if (RT_SUCCESS(rc))
+                rc = RTTcpRead(pStream->hSocket, pStream->pbBuf, Hdr.cb, NULL);
+            if (RT_FAILURE(rc))
+            {
+                LogRel(("Teleporter/TCP: Stream data read error: %Rrc (cb=%#x)\n", rc, Hdr.cb));
+                break;
+            }
+        }
+
+        pStream->cb  = Hdr.cb;
+        pStream->off = 0;
+        ASMAtomicWriteBool(&pStream->fFull, true);
+        RTSemEventSignal(pStream->hEvtDone);
+        if (teleporterStreamsIsTerminator(Hdr.cb))
+            break;
+    }
+
+    if (RT_FAILURE(rc))
+        ASMAtomicWriteS32(&pStream->rc, rc);
+    ASMAtomicWriteBool(&pStream->fDone, true);
+    RTSemEventSignal(pStream->hEvtDone);
+    return rc;
+}
+
+
+/**
+ * Waits for the stream to be done with its current block.
+ *
+ * @returns VBox status code, the I/O thread status if it failed.
+ * @param   pStream         The stream.
+ */
+/*static*/ int TeleporterStreams::waitForSend(Stream *pStream)
+{
+    while (   ASMAtomicReadBool(&pStream->fFull)
+           && !ASMAtomicReadBool(&pStream->fDone))
+        RTSemEventWait(pStream->hEvtDone, RT_INDEFINITE_WAIT);
+    if (RT_FAILURE(pStream->rc))
+        return pStream->rc;
+    if (pStream->fDone)
+        return VERR_BROKEN_PIPE;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Queues a block on a stream, waiting for it to finish the previous one.
+ *
+ * @returns VBox status code.
+ * @param   pStream         The stream.
+ * @param   pvBuf           The data, NULL for terminators.
+ * @param   cb              The block size.
+ */
+/*static*/ int TeleporterStreams::queue(Stream *pStream, const void *pvBuf, uint32_t cb)
+{
+    int rc = waitForSend(pStream);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    if (pvBuf)
+    {
+        if (cb > pStream->cbAlloc)
+        {
+            void *pvNew = RTMemRealloc(pStream->pbBuf, cb);
+            if (!pvNew)
+                return VERR_NO_MEMORY;
+            pStream->pbBuf   = (uint8_t *)pvNew;
+            pStream->cbAlloc = cb;
+        }
+        memcpy(pStream->pbBuf, pvBuf, cb);
+    }
+    pStream->cb = cb;
+    ASMAtomicWriteBool(&pStream->fFull, true);
+    RTSemEventSignal(pStream->hEvtWork);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Writes data to the stripe set.
+ *
+ * The data is copied, so the caller can reuse the buffer as soon as this
+ * returns.
+ *
+ * @returns VBox status code.
+ * @param   pvBuf           The data.
+ * @param   cbToWrite       The number of bytes to write.
+ */
+int TeleporterStreams::write(const void *pvBuf, size_t cbToWrite)
+{
+    AssertReturn(mfSender, VERR_INVALID_HANDLE);
+    AssertReturn(mpaStreams, VERR_WRONG_ORDER);
+
+    while (cbToWrite > 0)
+    {
+        uint32_t const cb = (uint32_t)RT_MIN(cbToWrite, TELEPORTERTCPHDR_MAX_SIZE);
+        int rc = queue(&mpaStreams[miStream], pvBuf, cb);
+        if (RT_FAILURE(rc))
+            return rc;
+        miStream = (miStream + 1) % mcStreams;
+
+        cbToWrite -= cb;
+        pvBuf = (uint8_t const *)pvBuf + cb;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Reads data from the stripe set.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_EOF at the end of the stream or if *pfStop is set.
+ * @retval  VERR_SSM_CANCELLED if the sender canceled the stream.
+ *
+ * @param   pvBuf           Where to put the data.
+ * @param   cbToRead        How much to read.
+ * @param   pcbRead         Where to return how much was actually read.  If
+ *                          NULL, all of @a cbToRead is read.
+ * @param   pfStop          Aborts the read when set by another thread.
+ */
+int TeleporterStreams::read(void *pvBuf, size_t cbToRead, size_t *pcbRead, bool volatile *pfStop)
+{
+    AssertReturn(!mfSender, VERR_INVALID_HANDLE);
+    AssertReturn(mpaStreams, VERR_WRONG_ORDER);
+
+    for (;;)
+    {
+        Stream *pStream = &mpaStreams[miStream];
+
+        /*
+         * Wait for the next block to arrive.
+         */
+        if (mfEndOfStream)
+            return VERR_EOF;
+        while (!ASMAtomicReadBool(&pStream->fFull))
+        {
+            if (ASMAtomicReadBool(&pStream->fDone) && !ASMAtomicReadBool(&pStream->fFull))
+                return RT_FAILURE(pStream->rc) ? pStream->rc : VERR_IO_GEN_FAILURE;
+            if (ASMAtomicReadBool(pfStop))
+                return VERR_EOF;
+            RTSemEventWait(pStream->hEvtDone, 1000);
+        }
+        if (teleporterStreamsIsTerminator(pStream->cb))
+        {
+            mfEndOfStream = true;
+            return pStream->cb ? VERR_SSM_CANCELLED : VERR_EOF;
+        }
+
+        /*
+         * Copy out what we can and hand the buffer back to the I/O thread when
+         * we're done with it.
+         */
+        uint32_t const cb = (uint32_t)RT_MIN(pStream->cb - pStream->off, cbToRead);
+        memcpy(pvBuf, &pStream->pbBuf[pStream->off], cb);
+        pStream->off += cb;
+        if (pStream->off >= pStream->cb)
+        {
+            ASMAtomicWriteBool(&pStream->fFull, false);
+            RTSemEventSignal(pStream->hEvtWork);
+            miStream = (miStream + 1) % mcStreams;
+        }
+
+        if (pcbRead)
+        {
+            *pcbRead = cb;
+            return VINF_SUCCESS;
+        }
+        if (cb == cbToRead)
+            return VINF_SUCCESS;
+        cbToRead -= cb;
+        pvBuf = (uint8_t *)pvBuf + cb;
+    }
+}
+
+
+/**
+ * Closes the stripe set.
+ *
+ * On the sending side this sends a terminator on every stream and waits for
+ * them to go out.  On the receiving side this waits for the terminators to
+ * arrive on all streams, so the sockets can be used for other things again.
+ *
+ * @returns VBox status code.
+ * @param   fCanceled       Whether the stream was canceled (sender).
+ */
+int TeleporterStreams::close(bool fCanceled)
+{
+    AssertReturn(mpaStreams, VERR_WRONG_ORDER);
+
+    int rc = VINF_SUCCESS;
+    if (mfSender)
+    {
+        /* Starting with the next in turn so the receiver sees the end in the right place. */
+        uint32_t const cbTerm = fCanceled ? UINT32_MAX : 0;
+        for (uint32_t i = 0; i < mcStreams; i++)
+        {
+            int rc2 = queue(&mpaStreams[(miStream + i) % mcStreams], NULL, cbTerm);
+            if (RT_SUCCESS(rc))
+                rc = rc2;
+        }
+    }
+
+    for (uint32_t i = 0; i < mcStreams; i++)
+    {
+        Stream *pStream = &mpaStreams[i];
+        int rc2 = RTThreadWait(pStream->hThread, mfSender ? RT_INDEFINITE_WAIT : RT_MS_1MIN, NULL);
+        if (RT_SUCCESS(rc2))
+        {
+            pStream->hThread = NIL_RTTHREAD;
+            rc2 = pStream->rc;
+        }
+        if (RT_SUCCESS(rc))
+            rc = rc2;
+    }
+    return rc;
+}
+
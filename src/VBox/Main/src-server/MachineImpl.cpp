@@ -11431,6 +11431,8 @@ void Machine::registerMetrics(PerformanceCollector *aCollector, Machine *aMachin
 
     pm::SubMetric *guestPagedTotal = new pm::SubMetric("Guest/Pagefile/Usage/Total",    "Total amount of space in the page file.");
 
+    pm::SubMetric *guestMemWorkingSet = new pm::SubMetric("Guest/RAM/WorkingSet/Estimate", "Estimated amount of guest RAM written to per working set estimator window.");
+
     /* Create and register base metrics */
     pm::BaseMetric *guestCpuLoad = new pm::GuestCpuLoad(mCollectorGuest, aMachine,
                                                         guestLoadUser, guestLoadKernel, guestLoadIdle);
@@ -11442,6 +11444,9 @@ void Machine::registerMetrics(PerformanceCollector *aCollector, Machine *aMachin
                                                         guestMemCache, guestPagedTotal);
     aCollector->registerBaseMetric(guestCpuMem);
 
+    pm::BaseMetric *guestWorkingSet = new pm::GuestRamWorkingSet(mCollectorGuest, aMachine, guestMemWorkingSet);
+    aCollector->registerBaseMetric(guestWorkingSet);
+
     aCollector->registerMetric(new pm::Metric(guestCpuLoad, guestLoadUser, 0));
     aCollector->registerMetric(new pm::Metric(guestCpuLoad, guestLoadUser, new pm::AggregateAvg()));
     aCollector->registerMetric(new pm::Metric(guestCpuLoad, guestLoadUser, new pm::AggregateMin()));
@@ -11486,6 +11491,11 @@ void Machine::registerMetrics(PerformanceCollector *aCollector, Machine *aMachin
     aCollector->registerMetric(new pm::Metric(guestCpuMem, guestPagedTotal, new pm::AggregateAvg()));
     aCollector->registerMetric(new pm::Metric(guestCpuMem, guestPagedTotal, new pm::AggregateMin()));
     aCollector->registerMetric(new pm::Metric(guestCpuMem, guestPagedTotal, new pm::AggregateMax()));
+
+    aCollector->registerMetric(new pm::Metric(guestWorkingSet, guestMemWorkingSet, 0));
+    aCollector->registerMetric(new pm::Metric(guestWorkingSet, guestMemWorkingSet, new pm::AggregateAvg()));
+    aCollector->registerMetric(new pm::Metric(guestWorkingSet, guestMemWorkingSet, new pm::AggregateMin()));
+    aCollector->registerMetric(new pm::Metric(guestWorkingSet, guestMemWorkingSet, new pm::AggregateMax()));
 }
 
 void Machine::unregisterMetrics(PerformanceCollector *aCollector, Machine *aMachine)
@@ -12019,13 +12029,14 @@ STDMETHODIMP SessionMachine::ReportGuestStatistics(ULONG aValidStats, ULONG aCpu
                                                    ULONG aMemBalloon, ULONG aMemShared,
                                                    ULONG aMemCache, ULONG aPageTotal,
                                                    ULONG aAllocVMM, ULONG aFreeVMM,
-                                                   ULONG aBalloonedVMM, ULONG aSharedVMM)
+                                                   ULONG aBalloonedVMM, ULONG aSharedVMM,
+                                                   ULONG aMemWorkingSet)
 {
     if (mCollectorGuest)
         mCollectorGuest->updateStats(aValidStats, aCpuUser, aCpuKernel, aCpuIdle,
                                      aMemTotal, aMemFree, aMemBalloon, aMemShared,
                                      aMemCache, aPageTotal, aAllocVMM, aFreeVMM,
-                                     aBalloonedVMM, aSharedVMM);
+                                     aBalloonedVMM, aSharedVMM, aMemWorkingSet);
 
     return S_OK;
 }
@@ -202,7 +202,7 @@ CollectorGuest::CollectorGuest(Machine *machine, RTPROCESS process) :
     mUnregistered(false), mEnabled(false), mValid(false), mMachine(machine), mProcess(process),
     mCpuUser(0), mCpuKernel(0), mCpuIdle(0),
     mMemTotal(0), mMemFree(0), mMemBalloon(0), mMemShared(0), mMemCache(0), mPageTotal(0),
-    mAllocVMM(0), mFreeVMM(0), mBalloonedVMM(0), mSharedVMM(0)
+    mAllocVMM(0), mFreeVMM(0), mBalloonedVMM(0), mSharedVMM(0), mMemWorkingSet(0)
 {
     Assert(mMachine);
     /* cannot use ComObjPtr<Machine> in Performance.h, do it manually */
@@ -338,7 +338,8 @@ void CollectorGuest::updateStats(ULONG aValidStats, ULONG aCpuUser,
                                  ULONG aMemBalloon, ULONG aMemShared,
                                  ULONG aMemCache, ULONG aPageTotal,
                                  ULONG aAllocVMM, ULONG aFreeVMM,
-                                 ULONG aBalloonedVMM, ULONG aSharedVMM)
+                                 ULONG aBalloonedVMM, ULONG aSharedVMM,
+                                 ULONG aMemWorkingSet)
 {
     if ((aValidStats & GUESTSTATS_CPULOAD) == GUESTSTATS_CPULOAD)
     {
@@ -362,6 +363,8 @@ void CollectorGuest::updateStats(ULONG aValidStats, ULONG aCpuUser,
         mBalloonedVMM = aBalloonedVMM;
         mSharedVMM    = aSharedVMM;
     }
+    if ((aValidStats & GUESTSTATS_WORKINGSET) == GUESTSTATS_WORKINGSET)
+        mMemWorkingSet = aMemWorkingSet;
     mValid = aValidStats;
 }
 
@@ -899,6 +902,41 @@ void GuestRamUsage::preCollect(CollectorHints& hints,  uint64_t /* iTick */)
 {
     hints.collectGuestStats(mCGuest->getProcess());
 }
+
+void GuestRamWorkingSet::init(ULONG period, ULONG length)
+{
+    mPeriod = period;
+    mLength = length;
+
+    mEstimate->init(mLength);
+}
+
+void GuestRamWorkingSet::collect()
+{
+    if (mCGuest->isValid(GUESTSTATS_WORKINGSET))
+    {
+        mEstimate->put(mCGuest->getMemWorkingSet());
+        mCGuest->invalidate(GUESTSTATS_WORKINGSET);
+    }
+}
+
+int GuestRamWorkingSet::enable()
+{
+    int rc = mCGuest->enable(GUESTSTATS_WORKINGSET);
+    BaseMetric::enable();
+    return rc;
+}
+
+int GuestRamWorkingSet::disable()
+{
+    BaseMetric::disable();
+    return mCGuest->disable(GUESTSTATS_WORKINGSET);
+}
+
+void GuestRamWorkingSet::preCollect(CollectorHints& hints,  uint64_t /* iTick */)
+{
+    hints.collectGuestStats(mCGuest->getProcess());
+}
 #endif /* !VBOX_COLLECTOR_TEST_CASE */
 
 void CircularBuffer::init(ULONG ulLength)
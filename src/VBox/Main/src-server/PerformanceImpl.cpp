@@ -129,6 +129,10 @@ static const char *g_papcszMetricNames[] =
     "Guest/Pagefile/Usage/Total:avg",
     "Guest/Pagefile/Usage/Total:min",
     "Guest/Pagefile/Usage/Total:max",
+    "Guest/RAM/WorkingSet/Estimate",
+    "Guest/RAM/WorkingSet/Estimate:avg",
+    "Guest/RAM/WorkingSet/Estimate:min",
+    "Guest/RAM/WorkingSet/Estimate:max",
 };
 
 ////////////////////////////////////////////////////////////////////////////////
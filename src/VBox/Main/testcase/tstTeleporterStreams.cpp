@@ -0,0 +1,244 @@
+/* $Id$ */
+/** @file
+ * Teleporter multi-stream transport testcase and localhost benchmark.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "../include/TeleporterStreams.h"
+
+#include <iprt/asm.h>
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/tcp.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+#include <VBox/err.h>
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * The receiving end of a test run.
+ */
+typedef struct TSTRECEIVER
+{
+    TeleporterStreams  *pStreams;
+    /** The number of bytes received. */
+    uint64_t            cbReceived;
+    /** When the end of the stream was seen (RTTimeNanoTS). */
+    uint64_t volatile   nsEnd;
+    /** The final status. */
+    int                 rc;
+} TSTRECEIVER;
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/** The test handle. */
+static RTTEST           g_hTest;
+/** The data pattern the SSM stream is made up of (repeated). */
+static uint8_t         *g_pbPattern;
+/** The size of the pattern. */
+static size_t const     g_cbPattern = _1M;
+/** The size of the SSM stream buffers. */
+static size_t const     g_cbChunk = _64K;
+/** Set to make the receiver give up. */
+static bool volatile    g_fStop = false;
+
+
+/**
+ * Receiver thread, reads and checks the stream until the end.
+ */
+static DECLCALLBACK(int) tstReceiverThread(RTTHREAD hThread, void *pvUser)
+{
+    TSTRECEIVER *pRecv = (TSTRECEIVER *)pvUser;
+    uint8_t     *pbBuf = (uint8_t *)RTMemAlloc(g_cbChunk);
+    NOREF(hThread);
+
+    int rc = VERR_NO_MEMORY;
+    while (pbBuf)
+    {
+        rc = pRecv->pStreams->read(pbBuf, g_cbChunk, NULL, &g_fStop);
+        if (RT_FAILURE(rc))
+            break;
+        if (memcmp(pbBuf, &g_pbPattern[pRecv->cbReceived % g_cbPattern], g_cbChunk))
+        {
+            RTTestFailed(g_hTest, "Data mismatch at offset %#RX64\n", pRecv->cbReceived);
+            rc = VERR_INVALID_STATE;
+            break;
+        }
+        pRecv->cbReceived += g_cbChunk;
+    }
+    pRecv->nsEnd = RTTimeNanoTS();
+    if (rc == VERR_EOF)
+        rc = pRecv->pStreams->close(false /*fCanceled*/);
+    pRecv->rc = rc;
+
+    RTMemFree(pbBuf);
+    return rc;
+}
+
+
+/**
+ * Connects @a cStreams localhost connections.
+ */
+static int tstConnect(PRTTCPSERVER hServer, uint32_t uPort, uint32_t cStreams, PRTSOCKET pahClients, PRTSOCKET pahServers)
+{
+    for (uint32_t i = 0; i < cStreams; i++)
+    {
+        int rc = RTTcpClientConnect("localhost", uPort, &pahClients[i]);
+        if (RT_SUCCESS(rc))
+            rc = RTTcpServerListen2(hServer, &pahServers[i]);
+        if (RT_FAILURE(rc))
+            return rc;
+        RTTcpSetSendCoalescing(pahClients[i], false /*fEnable*/);
+        RTTcpSetSendCoalescing(pahServers[i], false /*fEnable*/);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Sends a stream of @a cbTotal bytes across @a cStreams connections, the last
+ * @a cbFinal bytes playing the role of the final pass.
+ *
+ * Reports the throughput and the time it takes from the start of the final
+ * pass till the target has all the data, i.e. the downtime the transport is
+ * responsible for.
+ */
+static void tstRun(PRTTCPSERVER hServer, uint32_t uPort, uint32_t cStreams, uint64_t cbTotal, uint64_t cbFinal)
+{
+    RTSOCKET ahClients[TELEPORTER_MAX_STREAMS];
+    RTSOCKET ahServers[TELEPORTER_MAX_STREAMS];
+    for (uint32_t i = 0; i < RT_ELEMENTS(ahClients); i++)
+        ahClients[i] = ahServers[i] = NIL_RTSOCKET;
+
+    RTTestSubF(g_hTest, "%u stream(s)", cStreams);
+    int rc = tstConnect(hServer, uPort, cStreams, ahClients, ahServers);
+    RTTESTI_CHECK_RC_OK(rc);
+    if (RT_SUCCESS(rc))
+    {
+        TeleporterStreams   Sender(true /*fSender*/);
+        TeleporterStreams   Receiver(false /*fSender*/);
+        RTTESTI_CHECK_RC_OK(rc = Sender.init(cStreams, ahClients));
+        if (RT_SUCCESS(rc))
+            RTTESTI_CHECK_RC_OK(rc = Receiver.init(cStreams, ahServers));
+
+        TSTRECEIVER Recv;
+        Recv.pStreams   = &Receiver;
+        Recv.cbReceived = 0;
+        Recv.nsEnd      = 0;
+        Recv.rc         = VERR_INTERNAL_ERROR;
+        RTTHREAD hThread = NIL_RTTHREAD;
+        if (RT_SUCCESS(rc))
+            RTTESTI_CHECK_RC_OK(rc = RTThreadCreate(&hThread, tstReceiverThread, &Recv, 0, RTTHREADTYPE_IO,
+                                                    RTTHREADFLAGS_WAITABLE, "tstRecv"));
+        if (RT_SUCCESS(rc))
+        {
+            uint64_t const nsStart      = RTTimeNanoTS();
+            uint64_t       nsFinalStart = nsStart;
+            for (uint64_t off = 0; off < cbTotal && RT_SUCCESS(rc); off += g_cbChunk)
+            {
+                if (off == cbTotal - cbFinal)
+                    nsFinalStart = RTTimeNanoTS();
+                rc = Sender.write(&g_pbPattern[off % g_cbPattern], g_cbChunk);
+            }
+            RTTESTI_CHECK_RC_OK(rc);
+            RTTESTI_CHECK_RC_OK(Sender.close(RT_FAILURE(rc)));
+
+            rc = RTThreadWait(hThread, RT_MS_1MIN, NULL);
+            if (RT_FAILURE(rc))
+            {
+                RTTestFailed(g_hTest, "Receiver thread: %Rrc\n", rc);
+                ASMAtomicWriteBool(&g_fStop, true);
+                RTThreadWait(hThread, RT_INDEFINITE_WAIT, NULL);
+                ASMAtomicWriteBool(&g_fStop, false);
+            }
+            RTTESTI_CHECK_RC_OK(Recv.rc);
+            if (Recv.cbReceived != cbTotal)
+                RTTestFailed(g_hTest, "Received %#RX64 bytes, expected %#RX64\n", Recv.cbReceived, cbTotal);
+            else if (RT_SUCCESS(Recv.rc))
+            {
+                uint64_t const cNsElapsed = RT_MAX(Recv.nsEnd - nsStart, 1);
+                RTTestValue(g_hTest, "Throughput", cbTotal * RT_NS_1SEC / cNsElapsed / _1M, RTTESTUNIT_MEGABYTES_PER_SEC);
+                RTTestValue(g_hTest, "Downtime", (Recv.nsEnd - nsFinalStart) / RT_NS_1MS, RTTESTUNIT_MS);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < cStreams; i++)
+    {
+        RTTcpClientClose(ahClients[i]);
+        RTTcpServerDisconnectClient2(ahServers[i]);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    int rc = RTTestInitAndCreate("tstTeleporterStreams", &g_hTest);
+    if (rc)
+        return rc;
+    RTTestBanner(g_hTest);
+
+    /* The amount of data can be given on the command line, in MBs. */
+    uint64_t cbTotal = 256 * _1M;
+    if (argc > 1)
+    {
+        uint32_t cMBs;
+        rc = RTStrToUInt32Full(argv[1], 0, &cMBs);
+        if (rc != VINF_SUCCESS || cMBs < 32)
+            return RTTestSkipAndDestroy(g_hTest, "Usage: %s [MBs (>= 32)]", argv[0]);
+        cbTotal = (uint64_t)cMBs * _1M;
+    }
+
+    g_pbPattern = (uint8_t *)RTMemAlloc(g_cbPattern);
+    if (!g_pbPattern)
+        return RTTestSkipAndDestroy(g_hTest, "out of memory");
+    RTRandBytes(g_pbPattern, g_cbPattern);
+
+    PRTTCPSERVER hServer = NULL;
+    uint32_t     uPort   = 0;
+    for (int cTries = 1024; cTries > 0; cTries--)
+    {
+        uPort = RTRandU32Ex(49152, 65534);
+        rc = RTTcpServerCreateEx("localhost", uPort, &hServer);
+        if (rc != VERR_NET_ADDRESS_IN_USE)
+            break;
+    }
+    if (RT_FAILURE(rc))
+    {
+        RTMemFree(g_pbPattern);
+        return RTTestSkipAndDestroy(g_hTest, "RTTcpServerCreateEx -> %Rrc", rc);
+    }
+
+    static uint32_t const s_acStreams[] = { 1, 2, 4, 8 };
+    for (unsigned i = 0; i < RT_ELEMENTS(s_acStreams); i++)
+        tstRun(hServer, uPort, s_acStreams[i], cbTotal, 16 * _1M);
+
+    RTTcpServerDestroy(hServer);
+    RTMemFree(g_pbPattern);
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
@@ -0,0 +1,232 @@
+/* $Id$ */
+/** @file
+ * IPRT - IPv4 Checksum, 16-bit word summing workers.
+ *
+ * This is included by ipv4.cpp and by tstRTInetCsum, which compares the SSE2
+ * worker against the generic one.  Everything in here must be static.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___common_checksum_ipv4_words_cpp_h
+#define ___common_checksum_ipv4_words_cpp_h
+
+#include <iprt/types.h>
+#include <iprt/cdefs.h>
+#if defined(RT_ARCH_AMD64) || defined(RT_ARCH_X86)
+# include <iprt/asm-amd64-x86.h>
+# include <iprt/x86.h>
+#endif
+
+/* The SSE2 workers are ring-3 only as we cannot touch the FPU state in the
+   other contexts without saving it first.  On 32-bit x86 the compiler must
+   be able to generate SSE2 code, the CPU is checked at runtime. */
+#if defined(IN_RING3) \
+ && (defined(RT_ARCH_AMD64) || (defined(RT_ARCH_X86) && (defined(__SSE2__) || defined(_MSC_VER))))
+# define RTNETIPV4_WITH_SSE2
+# include <emmintrin.h>
+#endif
+
+
+/**
+ * Worker summing up the 16-bit words of a buffer and optionally copying it.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvDst           Where to copy the data to, NULL if no copying
+ *                          should be done.
+ * @param   pvSrc           The data to sum.
+ * @param   cbData          The number of bytes to sum, an odd byte at the end
+ *                          is ignored.
+ */
+typedef uint64_t FNRTNETIPV4SUMWORDS(void *pvDst, void const *pvSrc, size_t cbData);
+/** Pointer to a word summing worker. */
+typedef FNRTNETIPV4SUMWORDS *PFNRTNETIPV4SUMWORDS;
+
+
+/**
+ * Sums up the 16-bit words of a buffer, scalar version.
+ *
+ * On x86 and AMD64 we read 32-bit words into a 64-bit accumulator, which
+ * gives the same one's complement sum as adding 16-bit words since
+ * 2^16 == 1 (mod 2^16 - 1).  Other architectures may not like unaligned
+ * accesses, so they stick with 16-bit reads.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvData          The data to sum.  No alignment requirements.
+ * @param   cbData          The number of bytes to sum, an odd byte at the end
+ *                          is ignored.
+ */
+DECLINLINE(uint64_t) rtNetIPv4SumWordsScalar(void const *pvData, size_t cbData)
+{
+    uint64_t u64Sum = 0;
+#if defined(RT_ARCH_AMD64) || defined(RT_ARCH_X86)
+    uint32_t const *pu32 = (uint32_t const *)pvData;
+    while (cbData >= 32)
+    {
+        u64Sum += (uint64_t)pu32[0] + pu32[1] + pu32[2] + pu32[3]
+                + (uint64_t)pu32[4] + pu32[5] + pu32[6] + pu32[7];
+        pu32   += 8;
+        cbData -= 32;
+    }
+    while (cbData >= 4)
+    {
+        u64Sum += *pu32++;
+        cbData -= 4;
+    }
+    if (cbData >= 2)
+        u64Sum += *(uint16_t const *)pu32;
+#else
+    uint16_t const *pw = (uint16_t const *)pvData;
+    while (cbData > 1)
+    {
+        u64Sum += *pw++;
+        cbData -= 2;
+    }
+#endif
+    return u64Sum;
+}
+
+
+/**
+ * Sums up the 16-bit words of a buffer while copying it, scalar version.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvDst           Where to copy the data to.
+ * @param   pvSrc           The data to copy and sum.
+ * @param   cbData          The number of bytes to copy and sum, an odd byte at
+ *                          the end is neither copied nor summed.
+ */
+DECLINLINE(uint64_t) rtNetIPv4CopyAndSumWordsScalar(void *pvDst, void const *pvSrc, size_t cbData)
+{
+    uint64_t u64Sum = 0;
+#if defined(RT_ARCH_AMD64) || defined(RT_ARCH_X86)
+    uint32_t const *pu32Src = (uint32_t const *)pvSrc;
+    uint32_t       *pu32Dst = (uint32_t *)pvDst;
+    while (cbData >= 4)
+    {
+        uint32_t const u32 = *pu32Src++;
+        *pu32Dst++ = u32;
+        u64Sum += u32;
+        cbData -= 4;
+    }
+    if (cbData >= 2)
+    {
+        uint16_t const u16 = *(uint16_t const *)pu32Src;
+        *(uint16_t *)pu32Dst = u16;
+        u64Sum += u16;
+    }
+#else
+    uint16_t const *pwSrc = (uint16_t const *)pvSrc;
+    uint16_t       *pwDst = (uint16_t *)pvDst;
+    while (cbData > 1)
+    {
+        uint16_t const u16 = *pwSrc++;
+        *pwDst++ = u16;
+        u64Sum += u16;
+        cbData -= 2;
+    }
+#endif
+    return u64Sum;
+}
+
+
+#ifdef RTNETIPV4_WITH_SSE2
+/**
+ * Sums up the 16-bit words of a buffer, SSE2 version.
+ *
+ * The words are zero extended into 32-bit lanes.  Each of the two
+ * accumulators receives four words per lane and block, so flushing them every
+ * 4096 blocks keeps the lanes well clear of overflowing.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvDst           Where to copy the data to, NULL if no copying
+ *                          should be done.
+ * @param   pvSrc           The data to sum.
+ * @param   cbData          The number of bytes to sum.
+ */
+static uint64_t rtNetIPv4SumWordsSse2(void *pvDst, void const *pvSrc, size_t cbData)
+{
+    uint8_t const *pbSrc  = (uint8_t const *)pvSrc;
+    uint8_t       *pbDst  = (uint8_t *)pvDst;
+    __m128i const  Zero   = _mm_setzero_si128();
+    uint64_t       u64Sum = 0;
+
+    while (cbData >= 64)
+    {
+        size_t  cBlocks = RT_MIN(cbData / 64, 4096);
+        __m128i Acc0    = Zero;
+        __m128i Acc1    = Zero;
+        cbData -= cBlocks * 64;
+        do
+        {
+            __m128i const X0 = _mm_loadu_si128((__m128i const *)pbSrc);
+            __m128i const X1 = _mm_loadu_si128((__m128i const *)(pbSrc + 16));
+            __m128i const X2 = _mm_loadu_si128((__m128i const *)(pbSrc + 32));
+            __m128i const X3 = _mm_loadu_si128((__m128i const *)(pbSrc + 48));
+            if (pbDst)
+            {
+                _mm_storeu_si128((__m128i *)pbDst,        X0);
+                _mm_storeu_si128((__m128i *)(pbDst + 16), X1);
+                _mm_storeu_si128((__m128i *)(pbDst + 32), X2);
+                _mm_storeu_si128((__m128i *)(pbDst + 48), X3);
+                pbDst += 64;
+            }
+            Acc0 = _mm_add_epi32(Acc0, _mm_unpacklo_epi16(X0, Zero));
+            Acc1 = _mm_add_epi32(Acc1, _mm_unpackhi_epi16(X0, Zero));
+            Acc0 = _mm_add_epi32(Acc0, _mm_unpacklo_epi16(X1, Zero));
+            Acc1 = _mm_add_epi32(Acc1, _mm_unpackhi_epi16(X1, Zero));
+            Acc0 = _mm_add_epi32(Acc0, _mm_unpacklo_epi16(X2, Zero));
+            Acc1 = _mm_add_epi32(Acc1, _mm_unpackhi_epi16(X2, Zero));
+            Acc0 = _mm_add_epi32(Acc0, _mm_unpacklo_epi16(X3, Zero));
+            Acc1 = _mm_add_epi32(Acc1, _mm_unpackhi_epi16(X3, Zero));
+            pbSrc += 64;
+        } while (--cBlocks);
+
+        uint32_t au32[4];
+        _mm_storeu_si128((__m128i *)&au32[0], _mm_add_epi32(Acc0, Acc1));
+        u64Sum += (uint64_t)au32[0] + au32[1] + au32[2] + au32[3];
+    }
+
+    if (pbDst)
+        return u64Sum + rtNetIPv4CopyAndSumWordsScalar(pbDst, pbSrc, cbData);
+    return u64Sum + rtNetIPv4SumWordsScalar(pbSrc, cbData);
+}
+#endif /* RTNETIPV4_WITH_SSE2 */
+
+
+/**
+ * Generic worker for the function table, wrapping the scalar code.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvDst           Where to copy the data to, NULL if no copying
+ *                          should be done.
+ * @param   pvSrc           The data to sum.
+ * @param   cbData          The number of bytes to sum.
+ */
+static uint64_t rtNetIPv4SumWordsGeneric(void *pvDst, void const *pvSrc, size_t cbData)
+{
+    if (pvDst)
+        return rtNetIPv4CopyAndSumWordsScalar(pvDst, pvSrc, cbData);
+    return rtNetIPv4SumWordsScalar(pvSrc, cbData);
+}
+
+#endif
@@ -34,6 +34,36 @@
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 
+#include "ipv4-words.cpp.h"
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** Buffers smaller than this are summed inline instead of going thru
+ * g_pfnrtNetIPv4SumWords. */
+#define RTNETIPV4_SUM_WORKER_THRESHOLD  128
+
+
+/*******************************************************************************
+*   Internal Functions                                                         *
+*******************************************************************************/
+#ifdef RTNETIPV4_WITH_SSE2
+static FNRTNETIPV4SUMWORDS rtNetIPv4SumWordsResolve;
+#endif
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/** The word summing worker for large buffers.  Starts out pointing at the
+ * resolver in ring-3 on x86 and AMD64. */
+#ifdef RTNETIPV4_WITH_SSE2
+static PFNRTNETIPV4SUMWORDS volatile g_pfnrtNetIPv4SumWords = rtNetIPv4SumWordsResolve;
+#else
+static PFNRTNETIPV4SUMWORDS volatile g_pfnrtNetIPv4SumWords = rtNetIPv4SumWordsGeneric;
+#endif
+
 
 /**
  * Calculates the checksum of the IPv4 header.
@@ -286,56 +316,154 @@ RT_EXPORT_SYMBOL(RTNetIPv4AddTCPChecksum);
 
 
 /**
- * Adds the checksum of the specified data segment to the intermediate checksum value [inlined].
+ * Folds a 64-bit one's complement accumulator down to 16 bits, preserving the
+ * end-around carries.
+ *
+ * @returns The folded sum, never larger than 0xffff.
+ * @param   u64Sum          The 64-bit accumulator.
+ */
+DECLINLINE(uint32_t) rtNetIPv4FoldSum64(uint64_t u64Sum)
+{
+    u64Sum = (u64Sum >> 32) + (u64Sum & UINT32_MAX);
+    u64Sum = (u64Sum >> 16) + (u64Sum & 0xffff);
+    u64Sum = (u64Sum >> 16) + (u64Sum & 0xffff);
+    u64Sum = (u64Sum >> 16) + (u64Sum & 0xffff);
+    return (uint32_t)u64Sum;
+}
+
+
+
+
+#ifdef RTNETIPV4_WITH_SSE2
+/**
+ * Lazy resolver for g_pfnrtNetIPv4SumWords.
+ *
+ * Picks the best implementation for the host CPU, updates the function
+ * pointer and forwards the call.  Racing threads will all pick the same
+ * worker, so there is no need for serialization.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvDst           Where to copy the data to, NULL if no copying
+ *                          should be done.
+ * @param   pvSrc           The data to sum.
+ * @param   cbData          The number of bytes to sum.
+ */
+static uint64_t rtNetIPv4SumWordsResolve(void *pvDst, void const *pvSrc, size_t cbData)
+{
+    PFNRTNETIPV4SUMWORDS pfnWorker = rtNetIPv4SumWordsGeneric;
+# ifdef RT_ARCH_AMD64
+    pfnWorker = rtNetIPv4SumWordsSse2;
+# else
+    if (   ASMHasCpuId()
+        && (ASMCpuId_EDX(1) & X86_CPUID_FEATURE_EDX_SSE2))
+        pfnWorker = rtNetIPv4SumWordsSse2;
+# endif
+    g_pfnrtNetIPv4SumWords = pfnWorker;
+    return pfnWorker(pvDst, pvSrc, cbData);
+}
+#endif /* RTNETIPV4_WITH_SSE2 */
+
+
+/**
+ * Sums up the 16-bit words of a buffer, optionally copying it at the same
+ * time.
+ *
+ * Small buffers (headers, ACKs) are done inline, larger ones are handed to the
+ * best worker for the host CPU.
+ *
+ * @returns 64-bit unfolded sum.
+ * @param   pvDst           Where to copy the data to, NULL if no copying
+ *                          should be done.
+ * @param   pvSrc           The data to sum.
+ * @param   cbData          The number of bytes to sum, an odd byte at the end
+ *                          is ignored.
+ */
+DECLINLINE(uint64_t) rtNetIPv4SumWords(void *pvDst, void const *pvSrc, size_t cbData)
+{
+    if (cbData < RTNETIPV4_SUM_WORKER_THRESHOLD)
+    {
+        if (pvDst)
+            return rtNetIPv4CopyAndSumWordsScalar(pvDst, pvSrc, cbData);
+        return rtNetIPv4SumWordsScalar(pvSrc, cbData);
+    }
+    return g_pfnrtNetIPv4SumWords(pvDst, pvSrc, cbData);
+}
+
+
+/**
+ * Adds the checksum of the specified data segment to the intermediate checksum
+ * value, optionally copying the data at the same time [inlined].
  *
  * @returns 32-bit intermediary checksum value.
- * @param   pvData          Pointer to the data that should be checksummed.
+ * @param   pvDst           Where to copy the data to, NULL if no copying
+ *                          should be done.
+ * @param   pvSrc           Pointer to the data that should be checksummed.
  * @param   cbData          The number of bytes to checksum.
  * @param   u32Sum          The 32-bit intermediate checksum value.
  * @param   pfOdd           This is used to keep track of odd bits, initialize to false
  *                          when starting to checksum the data (aka text) after a TCP
  *                          or UDP header (data never start at an odd offset).
  */
-DECLINLINE(uint32_t) rtNetIPv4AddDataChecksum(void const *pvData, size_t cbData, uint32_t u32Sum, bool *pfOdd)
+DECLINLINE(uint32_t) rtNetIPv4AddDataChecksumEx(void *pvDst, void const *pvSrc, size_t cbData, uint32_t u32Sum, bool *pfOdd)
 {
-    uint16_t const *pw = (uint16_t const *)pvData;
+    uint8_t const *pbSrc = (uint8_t const *)pvSrc;
+    uint8_t       *pbDst = (uint8_t *)pvDst;
+    uint64_t       u64Sum;
+    if (!cbData)
+        return u32Sum;
+
+    u64Sum = u32Sum;
     if (*pfOdd)
     {
 #ifdef RT_BIG_ENDIAN
         /* there was an odd byte in the previous chunk, add the lower byte. */
-        u32Sum += *(uint8_t *)pvData;
+        u64Sum += *pbSrc;
 #else
         /* there was an odd byte in the previous chunk, add the upper byte. */
-        u32Sum += (uint32_t)*(uint8_t *)pvData << 8;
+        u64Sum += (uint32_t)*pbSrc << 8;
 #endif
         /* skip the byte. */
+        if (pbDst)
+            *pbDst++ = *pbSrc;
+        pbSrc++;
         cbData--;
-        if (!cbData)
-            return u32Sum;
-        pvData = (uint8_t const *)pvData + 1;
+        *pfOdd = false;
     }
 
     /* iterate the data. */
-    while (cbData > 1)
-    {
-        u32Sum += *pw;
-        pw++;
-        cbData -= 2;
-    }
+    u64Sum += rtNetIPv4SumWords(pbDst, pbSrc, cbData);
 
     /* handle odd byte. */
-    if (cbData)
+    if (cbData & 1)
     {
+        pbSrc += cbData - 1;
+        if (pbDst)
+            pbDst[cbData - 1] = *pbSrc;
 #ifdef RT_BIG_ENDIAN
-        u32Sum += (uint32_t)*(uint8_t *)pw << 8;
+        u64Sum += (uint32_t)*pbSrc << 8;
 #else
-        u32Sum += *(uint8_t *)pw;
+        u64Sum += *pbSrc;
 #endif
         *pfOdd = true;
     }
-    else
-        *pfOdd = false;
-    return u32Sum;
+    return rtNetIPv4FoldSum64(u64Sum);
+}
+
+
+/**
+ * Adds the checksum of the specified data segment to the intermediate checksum value [inlined].
+ *
+ * @returns 32-bit intermediary checksum value.
+ * @param   pvData          Pointer to the data that should be checksummed.
+ * @param   cbData          The number of bytes to checksum.
+ * @param   u32Sum          The 32-bit intermediate checksum value.
+ * @param   pfOdd           This is used to keep track of odd bits, initialize to false
+ *                          when starting to checksum the data (aka text) after a TCP
+ *                          or UDP header (data never start at an odd offset).
+ */
+DECLINLINE(uint32_t) rtNetIPv4AddDataChecksum(void const *pvData, size_t cbData, uint32_t u32Sum, bool *pfOdd)
+{
+    return rtNetIPv4AddDataChecksumEx(NULL, pvData, cbData, u32Sum, pfOdd);
 }
 
 /**
@@ -356,6 +484,31 @@ RTDECL(uint32_t) RTNetIPv4AddDataChecksum(void const *pvData, size_t cbData, uin
 RT_EXPORT_SYMBOL(RTNetIPv4AddDataChecksum);
 
 
+/**
+ * Copies a data segment and adds its checksum to the intermediate checksum
+ * value.
+ *
+ * This does the copying and the summing in a single pass over the data, which
+ * is cheaper than a memcpy followed by RTNetIPv4AddDataChecksum.
+ *
+ * @returns 32-bit intermediary checksum value.
+ * @param   pvDst           Where to copy the data to.  Must not overlap with
+ *                          @a pvSrc.
+ * @param   pvSrc           The data bits to copy and checksum.
+ * @param   cbData          The number of bytes to copy and checksum.
+ * @param   u32Sum          The 32-bit intermediate checksum value.
+ * @param   pfOdd           This is used to keep track of odd bits, initialize to false
+ *                          when starting to checksum the data (aka text) after a TCP
+ *                          or UDP header (data never start at an odd offset).
+ */
+RTDECL(uint32_t) RTNetIPv4AddDataChecksumCopy(void *pvDst, void const *pvSrc, size_t cbData, uint32_t u32Sum, bool *pfOdd)
+{
+    AssertPtr(pvDst);
+    return rtNetIPv4AddDataChecksumEx(pvDst, pvSrc, cbData, u32Sum, pfOdd);
+}
+RT_EXPORT_SYMBOL(RTNetIPv4AddDataChecksumCopy);
+
+
 /**
  * Finalizes a IPv4 checksum [inlined].
  *
@@ -0,0 +1,59 @@
+/* $Id$ */
+/** @file
+ * IPRT - Multiprocessor, Stubs for the RTMp*Numa* API.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <iprt/mp.h>
+#include "internal/iprt.h"
+
+#include <iprt/cpuset.h>
+
+
+RTDECL(uint32_t) RTMpGetNumaNodeCount(void)
+{
+    return 1;
+}
+RT_EXPORT_SYMBOL(RTMpGetNumaNodeCount);
+
+
+RTDECL(uint32_t) RTMpCpuIdToNumaNode(RTCPUID idCpu)
+{
+    NOREF(idCpu);
+    return 0;
+}
+RT_EXPORT_SYMBOL(RTMpCpuIdToNumaNode);
+
+
+RTDECL(PRTCPUSET) RTMpGetNumaNodeSet(uint32_t idNode, PRTCPUSET pSet)
+{
+    if (idNode == 0)
+        return RTMpGetSet(pSet);
+    return RTCpuSetEmpty(pSet);
+}
+RT_EXPORT_SYMBOL(RTMpGetNumaNodeSet);
+
@@ -177,6 +177,54 @@ RTDECL(RTCPUID) RTMpGetOnlineCount(void)
 RT_EXPORT_SYMBOL(RTMpGetOnlineCount);
 
 
+RTDECL(uint32_t) RTMpGetNumaNodeCount(void)
+{
+#if defined(CONFIG_NUMA) && LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
+    return nr_node_ids;
+#else
+    return 1;
+#endif
+}
+RT_EXPORT_SYMBOL(RTMpGetNumaNodeCount);
+
+
+RTDECL(uint32_t) RTMpCpuIdToNumaNode(RTCPUID idCpu)
+{
+#if defined(CONFIG_NUMA) && LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
+    if (RTMpIsCpuPossible(idCpu))
+    {
+        int iNode = cpu_to_node(idCpu);
+        if (iNode >= 0)
+            return (uint32_t)iNode;
+    }
+#else
+    NOREF(idCpu);
+#endif
+    return 0;
+}
+RT_EXPORT_SYMBOL(RTMpCpuIdToNumaNode);
+
+
+RTDECL(PRTCPUSET) RTMpGetNumaNodeSet(uint32_t idNode, PRTCPUSET pSet)
+{
+    RTCPUID idCpu;
+
+    RTCpuSetEmpty(pSet);
+    if (idNode < RTMpGetNumaNodeCount())
+    {
+        idCpu = RTMpGetMaxCpuId();
+        do
+        {
+            if (    RTMpIsCpuPossible(idCpu)
+                &&  RTMpCpuIdToNumaNode(idCpu) == idNode)
+                RTCpuSetAdd(pSet, idCpu);
+        } while (idCpu-- > 0);
+    }
+    return pSet;
+}
+RT_EXPORT_SYMBOL(RTMpGetNumaNodeSet);
+
+
 RTDECL(bool) RTMpIsCpuWorkPending(void)
 {
     /** @todo (not used on non-Windows platforms yet). */
@@ -35,6 +35,8 @@
 #include <iprt/mp.h>
 #include <iprt/cpuset.h>
 #include <iprt/assert.h>
+#include <iprt/ctype.h>
+#include <iprt/err.h>
 #include <iprt/string.h>
 #include <iprt/linux/sysfs.h>
 
@@ -112,6 +114,71 @@ static uint32_t rtMpLinuxGetFrequency(RTCPUID idCpu)
 }
 
 
+/**
+ * Internal worker that parses a sysfs CPU or node list ("0-3,8,10-11").
+ *
+ * @returns IPRT status code.
+ * @param   pszList     The list.  Trailing white space is ignored.
+ * @param   pSet        Where to return the set.  The numbers are used as set
+ *                      indexes, which is also how the node lists are stored.
+ */
+static int rtMpLinuxParseList(const char *pszList, PRTCPUSET pSet)
+{
+    RTCpuSetEmpty(pSet);
+    pszList = RTStrStripL(pszList);
+    while (*pszList && !RT_C_IS_SPACE(*pszList))
+    {
+        uint32_t uFirst;
+        char    *pszNext;
+        int rc = RTStrToUInt32Ex(pszList, &pszNext, 10, &uFirst);
+        if (RT_FAILURE(rc) || rc == VWRN_NUMBER_TOO_BIG)
+            return VERR_INVALID_PARAMETER;
+        uint32_t uLast = uFirst;
+        if (*pszNext == '-')
+        {
+            rc = RTStrToUInt32Ex(pszNext + 1, &pszNext, 10, &uLast);
+            if (RT_FAILURE(rc) || rc == VWRN_NUMBER_TOO_BIG || uLast < uFirst)
+                return VERR_INVALID_PARAMETER;
+        }
+        if (uLast >= RTCPUSET_MAX_CPUS)
+            return VERR_OUT_OF_RANGE;
+        for (uint32_t i = uFirst; i <= uLast; i++)
+            RTCpuSetAddByIndex(pSet, (int)i);
+
+        if (*pszNext == ',')
+            pszNext++;
+        else if (*pszNext && !RT_C_IS_SPACE(*pszNext))
+            return VERR_INVALID_PARAMETER;
+        pszList = pszNext;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Internal worker that reads a sysfs CPU or node list file.
+ *
+ * @returns IPRT status code.
+ * @param   pSet        Where to return the set.
+ * @param   pszFormat   The file name format, relative to "/sys/".
+ * @param   ...         Format arguments.
+ */
+static int rtMpLinuxReadList(PRTCPUSET pSet, const char *pszFormat, ...)
+{
+    char    szList[1024];
+    va_list va;
+    va_start(va, pszFormat);
+    ssize_t cch = RTLinuxSysFsReadStrFileV(szList, sizeof(szList), pszFormat, va);
+    va_end(va);
+    if (cch < 0)
+    {
+        RTCpuSetEmpty(pSet);
+        return VERR_FILE_NOT_FOUND;
+    }
+    return rtMpLinuxParseList(szList, pSet);
+}
+
+
 /** @todo RTmpCpuId(). */
 
 RTDECL(int) RTMpCpuIdToSetIndex(RTCPUID idCpu)
@@ -230,3 +297,42 @@ RTDECL(uint32_t) RTMpGetMaxFrequency(RTCPUID idCpu)
     }
     return (kHz + 999) / 1000;
 }
+
+
+RTDECL(uint32_t) RTMpGetNumaNodeCount(void)
+{
+    RTCPUSET Nodes;
+    int rc = rtMpLinuxReadList(&Nodes, "devices/system/node/possible");
+    if (RT_SUCCESS(rc))
+    {
+        int iLast = RTCpuLastIndex(&Nodes);
+        if (iLast >= 0)
+            return iLast + 1;
+    }
+    return 1;
+}
+
+
+RTDECL(uint32_t) RTMpCpuIdToNumaNode(RTCPUID idCpu)
+{
+    uint32_t const cNodes = RTMpGetNumaNodeCount();
+    for (uint32_t idNode = 0; idNode < cNodes; idNode++)
+        if (RTLinuxSysFsExists("devices/system/cpu/cpu%u/node%u", idCpu, idNode))
+            return idNode;
+    return 0;
+}
+
+
+RTDECL(PRTCPUSET) RTMpGetNumaNodeSet(uint32_t idNode, PRTCPUSET pSet)
+{
+    int rc = rtMpLinuxReadList(pSet, "devices/system/node/node%u/cpulist", idNode);
+    if (RT_FAILURE(rc))
+    {
+        /* No NUMA support in the kernel: a single node with all the CPUs. */
+        if (idNode == 0 && !RTLinuxSysFsExists("devices/system/node"))
+            return RTMpGetSet(pSet);
+        RTCpuSetEmpty(pSet);
+    }
+    return pSet;
+}
+
@@ -276,6 +276,66 @@ int main()
     }
 
 
+    /*
+     * Each CPU must be in one NUMA node only and map back to it, and all the
+     * online CPUs must be in a node.
+     */
+    uint32_t const cNodes = RTMpGetNumaNodeCount();
+    RTPrintf("tstMp-1: RTMpGetNumaNodeCount -> %u\n", cNodes);
+    if (cNodes >= 1 && cNodes <= RTCPUSET_MAX_CPUS)
+    {
+        RTCPUSET SetAllNodes;
+        RTCpuSetEmpty(&SetAllNodes);
+        for (uint32_t idNode = 0; idNode < cNodes; idNode++)
+        {
+            RTCPUSET SetNode;
+            pSet = RTMpGetNumaNodeSet(idNode, &SetNode);
+            if (pSet != &SetNode)
+            {
+                RTPrintf("tstMp-1: FAILURE: RTMpGetNumaNodeSet -> %p, expected %p\n", pSet, &SetNode);
+                g_cErrors++;
+                break;
+            }
+            RTPrintf("tstMp-1: Node %u: %d CPUs\n", idNode, RTCpuSetCount(&SetNode));
+            for (int iCpu = 0; iCpu < RTCPUSET_MAX_CPUS; iCpu++)
+                if (RTCpuSetIsMemberByIndex(&SetNode, iCpu))
+                {
+                    RTCPUID idCpu = RTMpCpuIdFromSetIndex(iCpu);
+                    if (RTCpuSetIsMemberByIndex(&SetAllNodes, iCpu))
+                    {
+                        RTPrintf("tstMp-1: FAILURE: cpu with index %2d is in more than one node!\n", iCpu);
+                        g_cErrors++;
+                    }
+                    else if (RTMpCpuIdToNumaNode(idCpu) != idNode)
+                    {
+                        RTPrintf("tstMp-1: FAILURE: RTMpCpuIdToNumaNode(%d) -> %u, expected %u\n",
+                                 (int)idCpu, RTMpCpuIdToNumaNode(idCpu), idNode);
+                        g_cErrors++;
+                    }
+                    RTCpuSetAddByIndex(&SetAllNodes, iCpu);
+                }
+        }
+        for (int iCpu = 0; iCpu < RTCPUSET_MAX_CPUS; iCpu++)
+            if (    RTCpuSetIsMemberByIndex(&SetAllNodes, iCpu)
+                &&  !RTCpuSetIsMemberByIndex(&Set, iCpu))
+            {
+                RTPrintf("tstMp-1: FAILURE: node cpu with index %2d is not a member of the possible cpu set!\n", iCpu);
+                g_cErrors++;
+            }
+            else if (   RTMpIsCpuOnline(RTMpCpuIdFromSetIndex(iCpu))
+                     && !RTCpuSetIsMemberByIndex(&SetAllNodes, iCpu))
+            {
+                RTPrintf("tstMp-1: FAILURE: online cpu with index %2d is not in any node!\n", iCpu);
+                g_cErrors++;
+            }
+    }
+    else
+    {
+        RTPrintf("tstMp-1: FAILURE: RTMpGetNumaNodeCount -> %u\n", cNodes);
+        g_cErrors++;
+    }
+
+
     if (!g_cErrors)
         RTPrintf("tstMp-1: SUCCESS\n", g_cErrors);
     else
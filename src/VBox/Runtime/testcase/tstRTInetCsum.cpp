@@ -0,0 +1,272 @@
+/* $Id$ */
+/** @file
+ * IPRT Testcase - Internet checksum.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <iprt/net.h>
+
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+#include "../common/checksum/ipv4-words.cpp.h"
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/** The test handle. */
+static RTTEST g_hTest;
+/** The size of the test buffers. */
+static size_t const g_cbBuf = _256K;
+
+
+/**
+ * Reference implementation, one 16-bit word at a time.
+ */
+static uint16_t tstRefCSum16(uint8_t const *pb, size_t cb)
+{
+    uint64_t u64Sum = 0;
+    while (cb > 1)
+    {
+        u64Sum += *(uint16_t const *)pb;
+        pb += 2;
+        cb -= 2;
+    }
+    if (cb)
+#ifdef RT_BIG_ENDIAN
+        u64Sum += (uint32_t)*pb << 8;
+#else
+        u64Sum += *pb;
+#endif
+    while (u64Sum >> 16)
+        u64Sum = (u64Sum >> 16) + (u64Sum & 0xffff);
+    return (uint16_t)~u64Sum;
+}
+
+
+/**
+ * Folds a 64-bit unfolded sum to 16 bits.
+ */
+static uint16_t tstFold(uint64_t u64Sum)
+{
+    while (u64Sum >> 16)
+        u64Sum = (u64Sum >> 16) + (u64Sum & 0xffff);
+    return (uint16_t)u64Sum;
+}
+
+
+/**
+ * Checks that RTNetIPv4AddDataChecksum and RTNetIPv4AddDataChecksumCopy agree
+ * with the reference for all kinds of sizes, alignments and chunkings.
+ */
+static void tst1(uint8_t *pbSrc, uint8_t *pbDst)
+{
+    RTTestSub(g_hTest, "Correctness");
+
+    for (unsigned i = 0; i < 2048; i++)
+    {
+        size_t const cb   = i < 64 ? RTRandU32Ex(0, g_cbBuf - 16) : RTRandU32Ex(0, 2048);
+        size_t const off  = RTRandU32Ex(0, 7);
+        if (i & 1)
+            RTRandBytes(pbSrc, cb + off);
+        else
+            memset(pbSrc, 0xff, cb + off); /* worst case for carries */
+        uint16_t const u16Ref = tstRefCSum16(pbSrc + off, cb);
+
+        /* One go. */
+        bool fOdd = false;
+        uint16_t u16 = RTNetIPv4FinalizeChecksum(RTNetIPv4AddDataChecksum(pbSrc + off, cb, 0, &fOdd));
+        if (u16 != u16Ref)
+            RTTestFailed(g_hTest, "#%u: cb=%zu off=%zu: %#06x, expected %#06x\n", i, cb, off, u16, u16Ref);
+
+        /* Random chunks, copying. */
+        size_t   offDst = RTRandU32Ex(0, 7);
+        size_t   offChunk = 0;
+        uint32_t u32Sum = 0;
+        fOdd = false;
+        while (offChunk < cb)
+        {
+            size_t cbChunk = RTRandU32Ex(1, (uint32_t)(cb - offChunk));
+            u32Sum = RTNetIPv4AddDataChecksumCopy(pbDst + offDst + offChunk, pbSrc + off + offChunk, cbChunk, u32Sum, &fOdd);
+            offChunk += cbChunk;
+        }
+        u16 = RTNetIPv4FinalizeChecksum(u32Sum);
+        if (u16 != u16Ref)
+            RTTestFailed(g_hTest, "#%u: cb=%zu off=%zu: copy %#06x, expected %#06x\n", i, cb, off, u16, u16Ref);
+        if (memcmp(pbDst + offDst, pbSrc + off, cb))
+            RTTestFailed(g_hTest, "#%u: cb=%zu off=%zu: copy mismatch\n", i, cb, off);
+    }
+}
+
+
+/**
+ * Checks the SSE2 word summing worker against the generic one, both summing
+ * only and copying, for odd lengths and misaligned source and destination
+ * buffers.
+ */
+static void tst3(uint8_t *pbSrc, uint8_t *pbDst)
+{
+    RTTestSub(g_hTest, "SSE2 vs generic");
+#ifdef RTNETIPV4_WITH_SSE2
+# ifdef RT_ARCH_X86
+    if (!ASMHasCpuId() || !(ASMCpuId_EDX(1) & X86_CPUID_FEATURE_EDX_SSE2))
+    {
+        RTTestSkipped(g_hTest, "no SSE2");
+        return;
+    }
+# endif
+    uint8_t *pbDst2 = pbDst + g_cbBuf / 2;
+    for (unsigned i = 0; i < 4096; i++)
+    {
+        /* Every length from 0 to 1024 once (odd ones included), then random ones
+           up to half the buffer, crossing the SSE2 accumulator flush interval. */
+        size_t const cb     = i <= 1024 ? i : RTRandU32Ex(0, g_cbBuf / 2 - 32);
+        size_t const offSrc = i & 15;
+        size_t const offDst = (i >> 4) & 15;
+        if (i & 1)
+            RTRandBytes(pbSrc, cb + offSrc);
+        else
+            memset(pbSrc, 0xff, cb + offSrc);
+
+        uint64_t const u64Generic = rtNetIPv4SumWordsGeneric(NULL, pbSrc + offSrc, cb);
+        uint64_t const u64Sse2    = rtNetIPv4SumWordsSse2(NULL, pbSrc + offSrc, cb);
+        /* The workers may accumulate differently, only the folded sums must match. */
+        if (tstFold(u64Sse2) != tstFold(u64Generic))
+            RTTestFailed(g_hTest, "#%u: cb=%zu offSrc=%zu: sse2 %#RX64, generic %#RX64\n",
+                         i, cb, offSrc, u64Sse2, u64Generic);
+
+        memset(pbDst, 0, cb + 32);
+        memset(pbDst2, 0, cb + 32);
+        uint64_t const u64GenericCopy = rtNetIPv4SumWordsGeneric(pbDst2 + offDst, pbSrc + offSrc, cb);
+        uint64_t const u64Sse2Copy    = rtNetIPv4SumWordsSse2(pbDst + offDst, pbSrc + offSrc, cb);
+        if (tstFold(u64Sse2Copy) != tstFold(u64GenericCopy) || tstFold(u64Sse2Copy) != tstFold(u64Generic))
+            RTTestFailed(g_hTest, "#%u: cb=%zu offSrc=%zu offDst=%zu: copying sse2 %#RX64, generic %#RX64\n",
+                         i, cb, offSrc, offDst, u64Sse2Copy, u64GenericCopy);
+        /* Both copy the even part only and must not touch anything beyond it. */
+        if (memcmp(pbDst, pbDst2, cb + 32))
+            RTTestFailed(g_hTest, "#%u: cb=%zu offSrc=%zu offDst=%zu: copies differ\n", i, cb, offSrc, offDst);
+    }
+#else
+    NOREF(pbSrc); NOREF(pbDst);
+    RTTestSkipped(g_hTest, "no SSE2 worker on this platform");
+#endif
+}
+
+
+/**
+ * Measures the throughput for a couple of typical packet sizes.
+ */
+static void tst2(uint8_t *pbSrc, uint8_t *pbDst)
+{
+    static size_t const s_acb[] = { 20, 64, 576, 1460, 9000, 65535 };
+    char     szName[64];
+    uint32_t u32Sum = 0;
+
+    RTTestSub(g_hTest, "Benchmark");
+    RTRandBytes(pbSrc, g_cbBuf);
+
+    for (unsigned i = 0; i < RT_ELEMENTS(s_acb); i++)
+    {
+        size_t const    cb      = s_acb[i];
+        uint32_t const  cRounds = (uint32_t)(_1G / 16 / cb);
+        bool            fOdd;
+
+        /* Checksum only. */
+        uint64_t u64Elapsed = RTTimeNanoTS();
+        for (uint32_t iRound = 0; iRound < cRounds; iRound++)
+        {
+            fOdd = false;
+            u32Sum += RTNetIPv4AddDataChecksum(pbSrc, cb, 0, &fOdd);
+        }
+        u64Elapsed = RTTimeNanoTS() - u64Elapsed;
+        RTStrPrintf(szName, sizeof(szName), "csum %zu bytes", cb);
+        RTTestValue(g_hTest, szName, u64Elapsed / cRounds, RTTESTUNIT_NS_PER_CALL);
+        RTStrPrintf(szName, sizeof(szName), "csum %zu bytes throughput", cb);
+        RTTestValue(g_hTest, szName, (uint64_t)cb * cRounds * RT_NS_1SEC / RT_MAX(u64Elapsed, 1) / _1M,
+                    RTTESTUNIT_MEGABYTES_PER_SEC);
+
+        /* Copy and checksum vs. memcpy followed by checksum. */
+        u64Elapsed = RTTimeNanoTS();
+        for (uint32_t iRound = 0; iRound < cRounds; iRound++)
+        {
+            fOdd = false;
+            u32Sum += RTNetIPv4AddDataChecksumCopy(pbDst, pbSrc, cb, 0, &fOdd);
+        }
+        u64Elapsed = RTTimeNanoTS() - u64Elapsed;
+        RTStrPrintf(szName, sizeof(szName), "copy+csum %zu bytes", cb);
+        RTTestValue(g_hTest, szName, u64Elapsed / cRounds, RTTESTUNIT_NS_PER_CALL);
+
+        u64Elapsed = RTTimeNanoTS();
+        for (uint32_t iRound = 0; iRound < cRounds; iRound++)
+        {
+            fOdd = false;
+            memcpy(pbDst, pbSrc, cb);
+            u32Sum += RTNetIPv4AddDataChecksum(pbDst, cb, 0, &fOdd);
+        }
+        u64Elapsed = RTTimeNanoTS() - u64Elapsed;
+        RTStrPrintf(szName, sizeof(szName), "memcpy,csum %zu bytes", cb);
+        RTTestValue(g_hTest, szName, u64Elapsed / cRounds, RTTESTUNIT_NS_PER_CALL);
+
+        /* The reference, so we can see what we gain. */
+        u64Elapsed = RTTimeNanoTS();
+        for (uint32_t iRound = 0; iRound < cRounds; iRound++)
+            u32Sum += tstRefCSum16(pbSrc, cb);
+        u64Elapsed = RTTimeNanoTS() - u64Elapsed;
+        RTStrPrintf(szName, sizeof(szName), "reference %zu bytes", cb);
+        RTTestValue(g_hTest, szName, u64Elapsed / cRounds, RTTESTUNIT_NS_PER_CALL);
+    }
+    NOREF(u32Sum);
+}
+
+
+int main()
+{
+    int rc = RTTestInitAndCreate("tstRTInetCsum", &g_hTest);
+    if (rc)
+        return rc;
+    RTTestBanner(g_hTest);
+
+    uint8_t *pbSrc = (uint8_t *)RTMemAlloc(g_cbBuf);
+    uint8_t *pbDst = (uint8_t *)RTMemAlloc(g_cbBuf);
+    if (pbSrc && pbDst)
+    {
+        tst1(pbSrc, pbDst);
+        tst3(pbSrc, pbDst);
+        if (!RTTestErrorCount(g_hTest))
+            tst2(pbSrc, pbDst);
+    }
+    else
+        RTTestFailed(g_hTest, "out of memory");
+    RTMemFree(pbSrc);
+    RTMemFree(pbDst);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
@@ -21,8 +21,12 @@
 *******************************************************************************/
 #define LOG_GROUP LOG_GROUP_DBGF
 #include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/dbgftrace.h>
+#include <VBox/vmm/vmm.h>
 #include "DBGFInternal.h"
 #include <VBox/vmm/vm.h>
+#include <iprt/asm.h>
+#include <iprt/asm-amd64-x86.h>
 #include <iprt/assert.h>
 
 
@@ -125,3 +129,51 @@ VMMDECL(bool) DBGFIsStepping(PVMCPU pVCpu)
     return pVCpu->dbgf.s.fSingleSteppingRaw;
 }
 
+
+/**
+ * Records a binary trace event.
+ *
+ * EMTs record into their own ring, all other threads share the last ring.
+ * Does nothing unless binary tracing is enabled and the event type is
+ * selected, see DBGFTRACE_BIN.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   enmEvt      The event type.
+ * @param   u32Arg      Event specific argument.
+ * @param   u64Arg1     Event specific argument.
+ * @param   u64Arg2     Event specific argument.
+ */
+VMMDECL(void) DBGFTraceBinAdd(PVM pVM, DBGFTRACEBINEVT enmEvt, uint32_t u32Arg, uint64_t u64Arg1, uint64_t u64Arg2)
+{
+    PDBGFTRACEBIN pTraceBin = pVM->CTX_SUFF(pTraceBin);
+    if (   !pTraceBin
+        || !(pTraceBin->fEvents & RT_BIT_32(enmEvt)))
+        return;
+
+    PDBGFTRACEBINRING pRing;
+    uint64_t          iRec;
+    VMCPUID           idCpu = VMMGetCpuId(pVM);
+    if (idCpu < pVM->cCpus)
+    {
+        /* Only the EMT writes to its ring, the index is published below. */
+        pRing = DBGFTRACEBIN_RING(pTraceBin, idCpu);
+        iRec  = pRing->iNext;
+    }
+    else
+    {
+        pRing = DBGFTRACEBIN_RING(pTraceBin, pTraceBin->cRings - 1);
+        iRec  = ASMAtomicIncU64(&pRing->iNext) - 1;
+        idCpu = DBGFTRACEBIN_NIL_CPU;
+    }
+
+    PDBGFTRACEBINREC pRec = &pRing->aRecs[(uint32_t)iRec & (pTraceBin->cRecsPerRing - 1)];
+    pRec->u64Tsc  = ASMReadTSC();
+    pRec->u16Evt  = (uint16_t)enmEvt;
+    pRec->idCpu   = (uint16_t)idCpu;
+    pRec->u32Arg  = u32Arg;
+    pRec->u64Arg1 = u64Arg1;
+    pRec->u64Arg2 = u64Arg2;
+
+    if (idCpu != DBGFTRACEBIN_NIL_CPU)
+        ASMAtomicWriteU64(&pRing->iNext, iRec + 1);
+}
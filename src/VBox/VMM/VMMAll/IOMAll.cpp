@@ -33,6 +33,7 @@
 #include <VBox/vmm/pdmdev.h>
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/cpum.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/err.h>
 #include <VBox/log.h>
 #include <iprt/assert.h>
@@ -320,6 +321,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, RTIOPORT Port, uint32_t *pu32Value,
                     return VERR_IOM_INVALID_IOPORT_SIZE;
             }
         }
+        DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_IOPORT_READ, Port, *pu32Value, cbValue);
         Log3(("IOMIOPortRead: Port=%RTiop *pu32=%08RX32 cb=%d rc=%Rrc\n", Port, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rcStrict)));
         return rcStrict;
     }
@@ -631,6 +633,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, RTIOPORT Port, uint32_t u32Value,
             STAM_COUNTER_INC(&pStats->OutRZToR3);
 # endif
 #endif
+        DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_IOPORT_WRITE, Port, u32Value, cbValue);
         Log3(("IOMIOPortWrite: Port=%RTiop u32=%08RX32 cb=%d rc=%Rrc\n", Port, u32Value, cbValue, VBOXSTRICTRC_VAL(rcStrict)));
         return rcStrict;
     }
@@ -28,6 +28,7 @@
 #include <VBox/vmm/em.h>
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/trpm.h>
+#include <VBox/vmm/dbgftrace.h>
 #if defined(IEM_VERIFICATION_MODE) && defined(IN_RING3)
 # include <VBox/vmm/iem.h>
 #endif
@@ -248,12 +249,33 @@ static VBOXSTRICTRC iomMMIODoComplicatedWrite(PVM pVM, PIOMMMIORANGE pRange, RTG
 
 
 
+/**
+ * Picks up the value of an MMIO access for the binary trace.
+ *
+ * @returns The access value, zero extended; 0 for accesses larger than 8 bytes.
+ * @param   pvValue     The data buffer.
+ * @param   cbValue     The access size.
+ */
+DECLINLINE(uint64_t) iomMMIOTraceValue(const void *pvValue, unsigned cbValue)
+{
+    switch (cbValue)
+    {
+        case 1: return *(uint8_t  const *)pvValue;
+        case 2: return *(uint16_t const *)pvValue;
+        case 4: return *(uint32_t const *)pvValue;
+        case 8: return *(uint64_t const *)pvValue;
+        default: return 0;
+    }
+}
+
+
 /**
  * Wrapper which does the write and updates range statistics when such are enabled.
  * @warning RT_SUCCESS(rc=VINF_IOM_R3_MMIO_WRITE) is TRUE!
  */
 static int iomMMIODoWrite(PVM pVM, PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault, const void *pvData, unsigned cb)
 {
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_MMIO_WRITE, cb, GCPhysFault, iomMMIOTraceValue(pvData, cb));
 #ifdef VBOX_WITH_STATISTICS
     PIOMMMIOSTATS pStats = iomMmioGetStats(pVM, GCPhysFault, pRange);
     Assert(pStats);
@@ -489,6 +511,7 @@ DECLINLINE(int) iomMMIODoRead(PVM pVM, PIOMMMIORANGE pRange, RTGCPHYS GCPhys, vo
     }
     STAM_PROFILE_STOP(&pStats->CTX_SUFF_Z(ProfRead), a);
     STAM_COUNTER_INC(&pStats->Accesses);
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_MMIO_READ, cbValue, GCPhys, iomMMIOTraceValue(pvValue, cbValue));
     return VBOXSTRICTRC_VAL(rc);
 }
 
@@ -1848,6 +1871,7 @@ VMMDECL(VBOXSTRICTRC) IOMMMIORead(PVM pVM, RTGCPHYS GCPhys, uint32_t *pu32Value,
         switch (VBOXSTRICTRC_VAL(rc))
         {
             case VINF_SUCCESS:
+                DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_MMIO_READ, (uint32_t)cbValue, GCPhys, iomMMIOTraceValue(pu32Value, (unsigned)cbValue));
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=VINF_SUCCESS\n", GCPhys, *pu32Value, cbValue));
                 iomMmioReleaseRange(pVM, pRange);
                 PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
@@ -1865,6 +1889,7 @@ VMMDECL(VBOXSTRICTRC) IOMMMIORead(PVM pVM, RTGCPHYS GCPhys, uint32_t *pu32Value,
 
             case VINF_IOM_MMIO_UNUSED_00:
                 iomMMIODoRead00s(pu32Value, cbValue);
+                DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_MMIO_READ, (uint32_t)cbValue, GCPhys, iomMMIOTraceValue(pu32Value, (unsigned)cbValue));
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
                 iomMmioReleaseRange(pVM, pRange);
                 PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
@@ -1872,6 +1897,7 @@ VMMDECL(VBOXSTRICTRC) IOMMMIORead(PVM pVM, RTGCPHYS GCPhys, uint32_t *pu32Value,
 
             case VINF_IOM_MMIO_UNUSED_FF:
                 iomMMIODoReadFFs(pu32Value, cbValue);
+                DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_MMIO_READ, (uint32_t)cbValue, GCPhys, iomMMIOTraceValue(pu32Value, (unsigned)cbValue));
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
                 iomMmioReleaseRange(pVM, pRange);
                 PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
@@ -1979,6 +2005,7 @@ VMMDECL(VBOXSTRICTRC) IOMMMIOWrite(PVM pVM, RTGCPHYS GCPhys, uint32_t u32Value,
             ||  rc == VINF_IOM_R3_MMIO_READ_WRITE)
             STAM_COUNTER_INC(&pStats->CTX_MID_Z(Write,ToR3));
 #endif
+        DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_MMIO_WRITE, (uint32_t)cbValue, GCPhys, u32Value);
         Log4(("IOMMMIOWrite: GCPhys=%RGp u32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, u32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
         iomMmioReleaseRange(pVM, pRange);
         PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
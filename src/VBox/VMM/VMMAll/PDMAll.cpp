@@ -24,6 +24,7 @@
 #include <VBox/vmm/pdm.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/vm.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/err.h>
 
 #include <VBox/log.h>
@@ -106,6 +107,7 @@ VMMDECL(int) PDMGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Interrupt)
  */
 VMMDECL(int) PDMIsaSetIrq(PVM pVM, uint8_t u8Irq, uint8_t u8Level, uint32_t uTagSrc)
 {
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_IRQ, u8Irq, u8Level, 0);
     pdmLock(pVM);
 
     /** @todo put the IRQ13 code elsewhere to avoid this unnecessary bloat. */
@@ -166,6 +168,7 @@ VMM_INT_DECL(int) PDMIoApicSetIrq(PVM pVM, uint8_t u8Irq, uint8_t u8Level, uint3
     if (pVM->pdm.s.IoApic.CTX_SUFF(pDevIns))
     {
         Assert(pVM->pdm.s.IoApic.CTX_SUFF(pfnSetIrq));
+        DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_IRQ, u8Irq, u8Level, 1);
         pdmLock(pVM);
         pVM->pdm.s.IoApic.CTX_SUFF(pfnSetIrq)(pVM->pdm.s.IoApic.CTX_SUFF(pDevIns), u8Irq, u8Level, uTagSrc);
         pdmUnlock(pVM);
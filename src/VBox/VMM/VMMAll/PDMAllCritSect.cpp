@@ -22,6 +22,7 @@
 #define LOG_GROUP LOG_GROUP_PDM//_CRITSECT
 #include "PDMInternal.h"
 #include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/pdmcritsectrw.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/vmm.h>
 #include <VBox/vmm/vm.h>
@@ -44,12 +45,24 @@
 /*******************************************************************************
 *   Defined Constants And Macros                                               *
 *******************************************************************************/
-/** The number loops to spin for in ring-3. */
-#define PDMCRITSECT_SPIN_COUNT_R3       20
-/** The number loops to spin for in ring-0. */
-#define PDMCRITSECT_SPIN_COUNT_R0       256
-/** The number loops to spin for in the raw-mode context. */
-#define PDMCRITSECT_SPIN_COUNT_RC       256
+/** The max number loops to spin for in ring-3. */
+#define PDMCRITSECT_SPIN_COUNT_R3       128
+/** The max number loops to spin for in ring-0.  Giving up here means
+ * returning rcBusy or calling ring-3, so we're more patient. */
+#define PDMCRITSECT_SPIN_COUNT_R0       1024
+/** The max number loops to spin for in the raw-mode context. */
+#define PDMCRITSECT_SPIN_COUNT_RC       1024
+/** The number of loops we always allow on top of twice the estimate. */
+#define PDMCRITSECT_SPIN_COUNT_EXTRA    16
+
+/** The PDMCRITSECT_CTX_XXX value of the current context. */
+#ifdef IN_RING3
+# define PDMCRITSECT_CTX_CUR            PDMCRITSECT_CTX_R3
+#elif defined(IN_RING0)
+# define PDMCRITSECT_CTX_CUR            PDMCRITSECT_CTX_R0
+#else
+# define PDMCRITSECT_CTX_CUR            PDMCRITSECT_CTX_RC
+#endif
 
 
 /* Undefine the automatic VBOX_STRICT API mappings. */
@@ -79,6 +92,107 @@ DECL_FORCE_INLINE(RTNATIVETHREAD) pdmCritSectGetNativeSelf(PCPDMCRITSECT pCritSe
 }
 
 
+/**
+ * Gets the contention profile of a critical section.
+ *
+ * @returns Pointer to the profile, NULL if the section isn't profiled.
+ * @param   pCritSect           The critical section.
+ */
+DECL_FORCE_INLINE(PPDMCRITSECTPROF) pdmCritSectGetProf(PCPDMCRITSECT pCritSect)
+{
+    if (RT_LIKELY(!pCritSect->s.iProf))
+        return NULL;
+    return &pCritSect->s.CTX_SUFF(pVM)->pdm.s.CTX_SUFF(paCritSectProf)[pCritSect->s.iProf - 1];
+}
+
+
+/**
+ * Gets the histogram bucket for a wait or hold time.
+ *
+ * @returns Bucket index, see PDMCRITSECT_HIST_BUCKETS.
+ * @param   cTicks              The time in TSC ticks.
+ */
+DECLINLINE(unsigned) pdmCritSectHistBucket(uint64_t cTicks)
+{
+    uint64_t const cUnits = cTicks >> 8;
+    if (!cUnits)
+        return 0;
+    unsigned const iBucket = (ASMBitLastSetU32((uint32_t)RT_MIN(cUnits, UINT32_MAX)) + 1) / 2;
+    return RT_MIN(iBucket, PDMCRITSECT_HIST_BUCKETS - 1);
+}
+
+
+/**
+ * Records a contended enter from @a uCaller in the call site table.
+ *
+ * @param   pProf               The contention profile.
+ * @param   uCaller             The return address of the enter call.
+ */
+static void pdmCritSectProfCaller(PPDMCRITSECTPROF pProf, RTHCUINTPTR uCaller)
+{
+    unsigned iMin = 0;
+    uint32_t cMin = UINT32_MAX;
+    for (unsigned i = 0; i < RT_ELEMENTS(pProf->aCallers); i++)
+    {
+        if (    pProf->aCallers[i].uCaller == uCaller
+            &&  pProf->aCallers[i].uCtx    == PDMCRITSECT_CTX_CUR)
+        {
+            ASMAtomicIncU32(&pProf->aCallers[i].cHits);
+            return;
+        }
+        uint32_t const cHits = pProf->aCallers[i].cHits;
+        if (cHits < cMin)
+        {
+            cMin = cHits;
+            iMin = i;
+        }
+    }
+
+    /* Not there, take over the entry with the fewest hits. */
+    pProf->aCallers[iMin].uCaller = uCaller;
+    pProf->aCallers[iMin].uCtx    = PDMCRITSECT_CTX_CUR;
+    pProf->aCallers[iMin].cHits   = cMin + 1;
+}
+
+
+/**
+ * Records a contended enter that got the section after waiting.
+ *
+ * @param   pCritSect           The critical section.
+ * @param   u64TscWait          The TSC when the waiting started.
+ * @param   uCaller             The return address of the enter call.
+ * @param   fSpun               Whether we got it while spinning.
+ */
+static void pdmCritSectProfWait(PPDMCRITSECT pCritSect, uint64_t u64TscWait, RTHCUINTPTR uCaller, bool fSpun)
+{
+    PPDMCRITSECTPROF pProf = pdmCritSectGetProf(pCritSect);
+    if (pProf)
+    {
+        STAM_REL_COUNTER_INC(&pProf->aStatWaitHist[pdmCritSectHistBucket(ASMReadTSC() - u64TscWait)]);
+        if (fSpun)
+            STAM_REL_COUNTER_INC(&pProf->StatSpinHits);
+        pdmCritSectProfCaller(pProf, uCaller);
+    }
+}
+
+
+/**
+ * Updates the adaptive spin estimate of a critical section.
+ *
+ * Successful spins pull the estimate towards the number of loops they took,
+ * misses decay it, so we keep spinning only while it pays off.  See
+ * pdmCritSectCalcSpinEst for the details.
+ *
+ * @param   pCritSect           The critical section.
+ * @param   cSpins              The number of loops it took, UINT32_MAX if we
+ *                              gave up.
+ */
+DECLINLINE(void) pdmCritSectSpinUpdate(PPDMCRITSECT pCritSect, uint32_t cSpins)
+{
+    ASMAtomicWriteU16(&pCritSect->s.cSpinEst, pdmCritSectCalcSpinEst(pCritSect->s.cSpinEst, cSpins));
+}
+
+
 /**
  * Tail code called when we've won the battle for the lock.
  *
@@ -96,6 +210,10 @@ DECL_FORCE_INLINE(int) pdmCritSectEnterFirst(PPDMCRITSECT pCritSect, RTNATIVETHR
     Assert(pCritSect->s.Core.cNestings == 1);
     ASMAtomicWriteHandle(&pCritSect->s.Core.NativeThreadOwner, hNativeSelf);
 
+    PPDMCRITSECTPROF pProf = pdmCritSectGetProf(pCritSect);
+    if (pProf)
+        pProf->u64TscEntered = ASMReadTSC();
+
 # ifdef PDMCRITSECT_STRICT
     RTLockValidatorRecExclSetOwner(pCritSect->s.Core.pValidatorRec, NIL_RTTHREAD, pSrcPos, true);
 # else
@@ -114,8 +232,11 @@ DECL_FORCE_INLINE(int) pdmCritSectEnterFirst(PPDMCRITSECT pCritSect, RTNATIVETHR
  * @returns VINF_SUCCESS or VERR_SEM_DESTROYED.
  * @param   pCritSect           The critsect.
  * @param   hNativeSelf         The native thread handle.
+ * @param   u64TscWait          The TSC when the waiting started.
+ * @param   uCaller             The return address of the enter call.
  */
-static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD hNativeSelf, PCRTLOCKVALSRCPOS pSrcPos)
+static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD hNativeSelf, PCRTLOCKVALSRCPOS pSrcPos,
+                                         uint64_t u64TscWait, RTHCUINTPTR uCaller)
 {
     /*
      * Start waiting.
@@ -162,7 +283,10 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
         if (RT_UNLIKELY(pCritSect->s.Core.u32Magic != RTCRITSECT_MAGIC))
             return VERR_SEM_DESTROYED;
         if (rc == VINF_SUCCESS)
+        {
+            pdmCritSectProfWait(pCritSect, u64TscWait, uCaller, false /*fSpun*/);
             return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+        }
         AssertMsg(rc == VERR_INTERRUPTED, ("rc=%Rrc\n", rc));
     }
     /* won't get here */
@@ -180,8 +304,10 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
  * @param   pCritSect           The PDM critical section to enter.
  * @param   rcBusy              The status code to return when we're in GC or R0
  *                              and the section is busy.
+ * @param   uCaller             The return address of the API call, for the
+ *                              contention profile.
  */
-DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRTLOCKVALSRCPOS pSrcPos)
+DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRTLOCKVALSRCPOS pSrcPos, RTHCUINTPTR uCaller)
 {
     Assert(pCritSect->s.Core.cNestings < 8);  /* useful to catch incorrect locking */
     Assert(pCritSect->s.Core.cNestings >= 0);
@@ -215,15 +341,22 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
     }
 
     /*
-     * Spin for a bit without incrementing the counter.
+     * Spin for a bit without incrementing the counter.  How long depends on
+     * how long the recent contended enters had to spin: twice the estimate
+     * and a little extra, capped per context.
      */
-    /** @todo Move this to cfgm variables since it doesn't make sense to spin on UNI
-     *        cpu systems. */
-    int32_t cSpinsLeft = CTX_SUFF(PDMCRITSECT_SPIN_COUNT_);
-    while (cSpinsLeft-- > 0)
+    /** @todo It doesn't make sense to spin on UNI cpu systems. */
+    uint64_t const u64TscWait = pCritSect->s.iProf ? ASMReadTSC() : 0;
+    uint32_t const cSpinsMax  = RT_MIN(((2 * (uint32_t)pCritSect->s.cSpinEst) >> PDMCRITSECT_SPIN_EST_SHIFT) + PDMCRITSECT_SPIN_COUNT_EXTRA,
+                                       CTX_SUFF(PDMCRITSECT_SPIN_COUNT_));
+    for (uint32_t cSpins = 1; cSpins <= cSpinsMax; cSpins++)
     {
         if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
+        {
+            pdmCritSectSpinUpdate(pCritSect, cSpins);
+            pdmCritSectProfWait(pCritSect, u64TscWait, uCaller, true /*fSpun*/);
             return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+        }
         ASMNopPause();
         /** @todo Should use monitor/mwait on e.g. &cLockers here, possibly with a
            cli'ed pendingpreemption check up front using sti w/ instruction fusing
@@ -231,13 +364,17 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
            executing code on another CPU ... which we could keep track of if we
            wanted. */
     }
+    pdmCritSectSpinUpdate(pCritSect, UINT32_MAX);
+    PPDMCRITSECTPROF pProf = pdmCritSectGetProf(pCritSect);
+    if (pProf)
+        STAM_REL_COUNTER_INC(&pProf->StatSpinMisses);
 
 #ifdef IN_RING3
     /*
      * Take the slow path.
      */
     NOREF(rcBusy);
-    return pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos);
+    return pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos, u64TscWait, uCaller);
 
 #else
 # ifdef IN_RING0
@@ -259,7 +396,7 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
         if (RTThreadPreemptIsEnabled(NIL_RTTHREAD))
         {
             STAM_REL_COUNTER_ADD(&pCritSect->s.StatContentionRZLock,    1000000);
-            rc = pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos);
+            rc = pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos, u64TscWait, uCaller);
         }
         else
         {
@@ -269,7 +406,7 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
             HWACCMR0Leave(pVM, pVCpu);
             RTThreadPreemptRestore(NIL_RTTHREAD, ????);
 
-            rc = pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos);
+            rc = pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos, u64TscWait, uCaller);
 
             RTThreadPreemptDisable(NIL_RTTHREAD, ????);
             HWACCMR0Enter(pVM, pVCpu);
@@ -282,11 +419,13 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
      */
     if (   RTThreadPreemptIsEnabled(NIL_RTTHREAD)
         && ASMIntAreEnabled())
-        return pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos);
+        return pdmR3R0CritSectEnterContended(pCritSect, hNativeSelf, pSrcPos, u64TscWait, uCaller);
 #  endif
 #endif /* IN_RING0 */
 
     STAM_REL_COUNTER_INC(&pCritSect->s.StatContentionRZLock);
+    if (pProf)
+        pdmCritSectProfCaller(pProf, uCaller);
 
     /*
      * Call ring-3 to acquire the critical section?
@@ -323,10 +462,10 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
 VMMDECL(int) PDMCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy)
 {
 #ifndef PDMCRITSECT_STRICT
-    return pdmCritSectEnter(pCritSect, rcBusy, NULL);
+    return pdmCritSectEnter(pCritSect, rcBusy, NULL, (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos);
+    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos, (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -355,10 +494,10 @@ VMMDECL(int) PDMCritSectEnterDebug(PPDMCRITSECT pCritSect, int rcBusy, RTHCUINTP
 {
 #ifdef PDMCRITSECT_STRICT
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos);
+    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #else
-    NOREF(uId); RT_SRC_POS_NOREF();
-    return pdmCritSectEnter(pCritSect, rcBusy, NULL);
+    RT_SRC_POS_NOREF();
+    return pdmCritSectEnter(pCritSect, rcBusy, NULL, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -372,8 +511,10 @@ VMMDECL(int) PDMCritSectEnterDebug(PPDMCRITSECT pCritSect, int rcBusy, RTHCUINTP
  * @retval  VERR_SEM_DESTROYED if RTCritSectDelete was called while waiting.
  *
  * @param   pCritSect   The critical section.
+ * @param   uCaller     The return address of the API call, for the
+ *                      contention profile.
  */
-static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos)
+static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos, RTHCUINTPTR uCaller)
 {
     /*
      * If the critical section has already been destroyed, then inform the caller.
@@ -413,6 +554,9 @@ static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos
 #else
     STAM_REL_COUNTER_INC(&pCritSect->s.StatContentionRZLock);
 #endif
+    PPDMCRITSECTPROF pProf = pdmCritSectGetProf(pCritSect);
+    if (pProf)
+        pdmCritSectProfCaller(pProf, uCaller);
     LogFlow(("PDMCritSectTryEnter: locked\n"));
     return VERR_SEM_BUSY;
 }
@@ -431,10 +575,10 @@ static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos
 VMMDECL(int) PDMCritSectTryEnter(PPDMCRITSECT pCritSect)
 {
 #ifndef PDMCRITSECT_STRICT
-    return pdmCritSectTryEnter(pCritSect, NULL);
+    return pdmCritSectTryEnter(pCritSect, NULL, (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectTryEnter(pCritSect, &SrcPos);
+    return pdmCritSectTryEnter(pCritSect, &SrcPos, (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -460,10 +604,10 @@ VMMDECL(int) PDMCritSectTryEnterDebug(PPDMCRITSECT pCritSect, RTHCUINTPTR uId, R
 {
 #ifdef PDMCRITSECT_STRICT
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectTryEnter(pCritSect, &SrcPos);
+    return pdmCritSectTryEnter(pCritSect, &SrcPos, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #else
-    NOREF(uId); RT_SRC_POS_NOREF();
-    return pdmCritSectTryEnter(pCritSect, NULL);
+    RT_SRC_POS_NOREF();
+    return pdmCritSectTryEnter(pCritSect, NULL, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -492,6 +636,19 @@ VMMR3DECL(int) PDMR3CritSectEnterEx(PPDMCRITSECT pCritSect, bool fCallRing3)
 #endif /* IN_RING3 */
 
 
+/**
+ * Records the hold time when the owner is about to leave for real.
+ *
+ * @param   pCritSect           The critical section.
+ */
+DECL_FORCE_INLINE(void) pdmCritSectProfLeave(PPDMCRITSECT pCritSect)
+{
+    PPDMCRITSECTPROF pProf = pdmCritSectGetProf(pCritSect);
+    if (pProf)
+        STAM_REL_COUNTER_INC(&pProf->aStatHoldHist[pdmCritSectHistBucket(ASMReadTSC() - pProf->u64TscEntered)]);
+}
+
+
 /**
  * Leaves a critical section entered with PDMCritSectEnter().
  *
@@ -556,6 +713,7 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
 #  endif
         Assert(!pCritSect->s.Core.pValidatorRec || pCritSect->s.Core.pValidatorRec->hThread == NIL_RTTHREAD);
 # endif
+        pdmCritSectProfLeave(pCritSect);
         ASMAtomicAndU32(&pCritSect->s.Core.fFlags, ~PDMCRITSECT_FLAGS_PENDING_UNLOCK);
         ASMAtomicWriteHandle(&pCritSect->s.Core.NativeThreadOwner, NIL_RTNATIVETHREAD);
         ASMAtomicDecS32(&pCritSect->s.Core.cNestings);
@@ -598,6 +756,7 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
          */
         if (pCritSect->s.Core.cLockers == 0)
         {
+            pdmCritSectProfLeave(pCritSect);
             ASMAtomicWriteS32(&pCritSect->s.Core.cNestings, 0);
             RTNATIVETHREAD hNativeThread = pCritSect->s.Core.NativeThreadOwner;
             ASMAtomicAndU32(&pCritSect->s.Core.fFlags, ~PDMCRITSECT_FLAGS_PENDING_UNLOCK);
@@ -643,9 +802,43 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
  */
 VMMDECL(void) PDMCritSectFF(PVMCPU pVCpu)
 {
-    Assert(pVCpu->pdm.s.cQueuedCritSectLeaves > 0);
+    Assert(   pVCpu->pdm.s.cQueuedCritSectLeaves > 0
+           || pVCpu->pdm.s.cQueuedCritSectRwShrdLeaves > 0
+           || pVCpu->pdm.s.cQueuedCritSectRwExclLeaves > 0);
+
+    /* Shared leaves. */
+    RTUINT c = pVCpu->pdm.s.cQueuedCritSectRwShrdLeaves;
+    for (RTUINT i = 0; i < c; i++)
+    {
+# ifdef IN_RING3
+        PPDMCRITSECTRW pCritSectRw = pVCpu->pdm.s.apQueuedCritSectRwShrdLeaves[i];
+# else
+        PPDMCRITSECTRW pCritSectRw = (PPDMCRITSECTRW)MMHyperR3ToCC(pVCpu->CTX_SUFF(pVM),
+                                                                   pVCpu->pdm.s.apQueuedCritSectRwShrdLeaves[i]);
+# endif
+
+        PDMCritSectRwLeaveShared(pCritSectRw);
+        LogFlow(("PDMR3CritSectFF: %p (R/W)\n", pCritSectRw));
+    }
+    pVCpu->pdm.s.cQueuedCritSectRwShrdLeaves = 0;
+
+    /* Last, exclusive leaves. */
+    c = pVCpu->pdm.s.cQueuedCritSectRwExclLeaves;
+    for (RTUINT i = 0; i < c; i++)
+    {
+# ifdef IN_RING3
+        PPDMCRITSECTRW pCritSectRw = pVCpu->pdm.s.apQueuedCritSectRwExclLeaves[i];
+# else
+        PPDMCRITSECTRW pCritSectRw = (PPDMCRITSECTRW)MMHyperR3ToCC(pVCpu->CTX_SUFF(pVM),
+                                                                   pVCpu->pdm.s.apQueuedCritSectRwExclLeaves[i]);
+# endif
+
+        pdmCritSectRwLeaveExclQueued(pCritSectRw);
+        LogFlow(("PDMR3CritSectFF: %p (R/W)\n", pCritSectRw));
+    }
+    pVCpu->pdm.s.cQueuedCritSectRwExclLeaves = 0;
 
-    const RTUINT c = pVCpu->pdm.s.cQueuedCritSectLeaves;
+    c = pVCpu->pdm.s.cQueuedCritSectLeaves;
     for (RTUINT i = 0; i < c; i++)
     {
 # ifdef IN_RING3
@@ -0,0 +1,929 @@
+/* $Id$ */
+/** @file
+ * PDM - Read/Write Critical Section, All Contexts.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#define LOG_GROUP LOG_GROUP_PDM//_CRITSECT
+#include "PDMInternal.h"
+#include <VBox/vmm/pdmcritsectrw.h>
+#include <VBox/vmm/mm.h>
+#include <VBox/vmm/vmm.h>
+#include <VBox/vmm/vm.h>
+#include <VBox/err.h>
+#include <VBox/sup.h>
+
+#include <VBox/log.h>
+#include <iprt/asm.h>
+#include <iprt/asm-amd64-x86.h>
+#include <iprt/assert.h>
+#if defined(IN_RING3) || defined(IN_RING0)
+# include <iprt/thread.h>
+#endif
+
+
+/**
+ * Gets the ring-3 native thread handle of the calling thread.
+ *
+ * @returns native thread handle (ring-3).
+ * @param   pThis               The read/write critical section.  This is only
+ *                              used in R0 and RC.
+ */
+DECL_FORCE_INLINE(RTNATIVETHREAD) pdmCritSectRwGetNativeSelf(PCPDMCRITSECTRW pThis)
+{
+#ifdef IN_RING3
+    NOREF(pThis);
+    RTNATIVETHREAD  hNativeSelf = RTThreadNativeSelf();
+#else
+    AssertMsgReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, ("%RX32\n", pThis->s.u32Magic),
+                    NIL_RTNATIVETHREAD);
+    PVM             pVM         = pThis->s.CTX_SUFF(pVM);     AssertPtr(pVM);
+    PVMCPU          pVCpu       = VMMGetCpu(pVM);             AssertPtr(pVCpu);
+    RTNATIVETHREAD  hNativeSelf = pVCpu->hNativeThread;       Assert(hNativeSelf != NIL_RTNATIVETHREAD);
+#endif
+    return hNativeSelf;
+}
+
+
+/**
+ * Checks whether the calling thread may block on the semaphores.
+ *
+ * @returns true if it can, false if we have to return rcBusy or call ring-3.
+ */
+DECL_FORCE_INLINE(bool) pdmCritSectRwCanBlock(void)
+{
+#ifdef IN_RING3
+    return true;
+#elif defined(IN_RING0)
+    return RTThreadPreemptIsEnabled(NIL_RTTHREAD)
+        && ASMIntAreEnabled();
+#else
+    return false;
+#endif
+}
+
+
+/**
+ * Checks whether the calling thread may signal the semaphores.
+ *
+ * @returns true if it can, false if the signalling has to be left to ring-3.
+ */
+DECL_FORCE_INLINE(bool) pdmCritSectRwCanSignal(void)
+{
+#ifdef IN_RING3
+    return true;
+#elif defined(IN_RING0)
+    /** @todo Make SUPSemEventSignal interrupt safe, see PDMCritSectLeave. */
+    return ASMIntAreEnabled();
+#else
+    return false;
+#endif
+}
+
+
+#if defined(IN_RING0) || defined(IN_RC)
+/**
+ * Queues a leave for ring-3 because the semaphores cannot be signalled in the
+ * current context.
+ *
+ * @param   pThis               The read/write critical section.
+ * @param   fExcl               Set for the writer release part of an exclusive
+ *                              leave, clear for a shared leave.
+ */
+static void pdmRZCritSectRwQueueLeave(PPDMCRITSECTRW pThis, bool fExcl)
+{
+    PVM     pVM   = pThis->s.CTX_SUFF(pVM);     AssertPtr(pVM);
+    PVMCPU  pVCpu = VMMGetCpu(pVM);             AssertPtr(pVCpu);
+    if (fExcl)
+    {
+        uint32_t i = pVCpu->pdm.s.cQueuedCritSectRwExclLeaves++;
+        LogFlow(("PDMCritSectRwLeaveExcl: [%d]=%p => R3\n", i, pThis));
+        AssertFatal(i < RT_ELEMENTS(pVCpu->pdm.s.apQueuedCritSectRwExclLeaves));
+        pVCpu->pdm.s.apQueuedCritSectRwExclLeaves[i] = MMHyperCCToR3(pVM, pThis);
+        STAM_REL_COUNTER_INC(&pThis->s.StatContentionRZLeaveExcl);
+    }
+    else
+    {
+        uint32_t i = pVCpu->pdm.s.cQueuedCritSectRwShrdLeaves++;
+        LogFlow(("PDMCritSectRwLeaveShared: [%d]=%p => R3\n", i, pThis));
+        AssertFatal(i < RT_ELEMENTS(pVCpu->pdm.s.apQueuedCritSectRwShrdLeaves));
+        pVCpu->pdm.s.apQueuedCritSectRwShrdLeaves[i] = MMHyperCCToR3(pVM, pThis);
+        STAM_REL_COUNTER_INC(&pThis->s.StatContentionRZLeaveShared);
+    }
+    VMCPU_FF_SET(pVCpu, VMCPU_FF_PDM_CRITSECT);
+    VMCPU_FF_SET(pVCpu, VMCPU_FF_TO_R3);
+    STAM_REL_COUNTER_INC(&pVM->pdm.s.StatQueuedCritSectLeaves);
+}
+#endif /* IN_RING0 || IN_RC */
+
+
+/**
+ * Drops one writer from the writer count and wakes up whoever is next, i.e.
+ * the next writer or, if there are no more writers, the waiting readers.
+ *
+ * This is the second half of the final exclusive leave and is also used to
+ * back out of a failed exclusive try-enter.  The caller must not be the owner
+ * any longer.  Where the semaphores cannot be signalled, this is queued for
+ * ring-3 unless there is nobody to wake up.
+ *
+ * @param   pThis               The read/write critical section.
+ */
+static void pdmCritSectRwReleaseWriter(PPDMCRITSECTRW pThis)
+{
+    for (;;)
+    {
+        uint64_t u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+        uint64_t u64OldState = u64State;
+
+        uint64_t c = (u64State & PDMCRITSECTRW_CNT_WR_MASK) >> PDMCRITSECTRW_CNT_WR_SHIFT;
+        Assert(c > 0);
+        c--;
+
+        bool const fSignalWriter = c > 0;
+        bool const fSignalReaders = !fSignalWriter && (u64State & PDMCRITSECTRW_CNT_RD_MASK) != 0;
+#if defined(IN_RING0) || defined(IN_RC)
+        if (   (fSignalWriter || fSignalReaders)
+            && !pdmCritSectRwCanSignal())
+        {
+            pdmRZCritSectRwQueueLeave(pThis, true /*fExcl*/);
+            return;
+        }
+#endif
+
+        if (!fSignalReaders)
+        {
+            /* Don't change the direction, wake up the next writer if any. */
+            u64State &= ~PDMCRITSECTRW_CNT_WR_MASK;
+            u64State |= c << PDMCRITSECTRW_CNT_WR_SHIFT;
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+            {
+#if defined(IN_RING3) || defined(IN_RING0)
+                if (fSignalWriter)
+                {
+                    int rc = SUPSemEventSignal(pThis->s.CTX_SUFF(pVM)->pSession, (SUPSEMEVENT)pThis->s.hEvtWrite);
+                    AssertRC(rc);
+                }
+#endif
+                return;
+            }
+        }
+        else
+        {
+            /* Reverse the direction and signal the reader threads. */
+            u64State &= ~(PDMCRITSECTRW_CNT_WR_MASK | PDMCRITSECTRW_DIR_MASK);
+            u64State |= PDMCRITSECTRW_DIR_READ << PDMCRITSECTRW_DIR_SHIFT;
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+            {
+#if defined(IN_RING3) || defined(IN_RING0)
+                Assert(!pThis->s.fNeedReset);
+                ASMAtomicWriteBool(&pThis->s.fNeedReset, true);
+                int rc = SUPSemEventMultiSignal(pThis->s.CTX_SUFF(pVM)->pSession, (SUPSEMEVENTMULTI)pThis->s.hEvtRead);
+                AssertRC(rc);
+#endif
+                return;
+            }
+        }
+
+        ASMNopPause();
+        if (pThis->s.u32Magic != PDMCRITSECTRW_MAGIC)
+            return;
+    }
+}
+
+
+#if defined(IN_RING3) || defined(IN_RING0)
+/**
+ * Completes an exclusive leave that was queued for ring-3 (or for ring-0 with
+ * interrupts enabled), see PDMCritSectFF.
+ *
+ * @param   pThis               The read/write critical section.
+ */
+void pdmCritSectRwLeaveExclQueued(PPDMCRITSECTRW pThis)
+{
+    AssertReturnVoid(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC);
+    pdmCritSectRwReleaseWriter(pThis);
+}
+
+
+/**
+ * Waits for the direction to change to read after adding ourselves to the
+ * readers and the waiting readers, ring-3 and ring-0.
+ *
+ * @returns VINF_SUCCESS or VERR_SEM_DESTROYED.
+ * @param   pThis               The read/write critical section.
+ */
+static int pdmR3R0CritSectRwEnterSharedContended(PPDMCRITSECTRW pThis)
+{
+    PSUPDRVSESSION  pSession    = pThis->s.CTX_SUFF(pVM)->pSession;
+# ifdef IN_RING3
+    STAM_REL_COUNTER_INC(&pThis->s.StatContentionR3EnterShared);
+    RTTHREAD        hThreadSelf = RTThreadSelf();
+# endif
+
+    uint64_t u64State;
+    for (uint32_t iLoop = 0; ; iLoop++)
+    {
+# ifdef IN_RING3
+        RTThreadBlocking(hThreadSelf, RTTHREADSTATE_RW_READ, true);
+# endif
+        int rc = SUPSemEventMultiWaitNoResume(pSession, (SUPSEMEVENTMULTI)pThis->s.hEvtRead, RT_INDEFINITE_WAIT);
+# ifdef IN_RING3
+        RTThreadUnblocked(hThreadSelf, RTTHREADSTATE_RW_READ);
+# endif
+        if (RT_UNLIKELY(pThis->s.u32Magic != PDMCRITSECTRW_MAGIC))
+            return VERR_SEM_DESTROYED;
+        AssertMsg(rc == VINF_SUCCESS || rc == VERR_INTERRUPTED, ("rc=%Rrc\n", rc));
+
+        u64State = ASMAtomicReadU64(&pThis->s.u64State);
+        if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_READ << PDMCRITSECTRW_DIR_SHIFT))
+            break;
+        AssertMsg(iLoop < 1 || rc == VERR_INTERRUPTED, ("%u\n", iLoop));
+    }
+
+    /*
+     * Decrement the wait count and reset the semaphore if we're the last one.
+     */
+    for (;;)
+    {
+        uint64_t u64OldState = u64State;
+
+        uint64_t cWait = (u64State & PDMCRITSECTRW_WAIT_CNT_RD_MASK) >> PDMCRITSECTRW_WAIT_CNT_RD_SHIFT;
+        Assert(cWait > 0);
+        cWait--;
+        u64State &= ~PDMCRITSECTRW_WAIT_CNT_RD_MASK;
+        u64State |= cWait << PDMCRITSECTRW_WAIT_CNT_RD_SHIFT;
+
+        if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+        {
+            if (   cWait == 0
+                && ASMAtomicXchgBool(&pThis->s.fNeedReset, false))
+            {
+                int rc = SUPSemEventMultiReset(pSession, (SUPSEMEVENTMULTI)pThis->s.hEvtRead);
+                AssertRCReturn(rc, rc);
+            }
+            return VINF_SUCCESS;
+        }
+
+        ASMNopPause();
+        u64State = ASMAtomicReadU64(&pThis->s.u64State);
+    }
+}
+
+
+/**
+ * Waits for our turn as writer after adding ourselves to the writers, ring-3
+ * and ring-0.
+ *
+ * @returns VINF_SUCCESS or VERR_SEM_DESTROYED.
+ * @param   pThis               The read/write critical section.
+ * @param   hNativeSelf         The native handle of the calling thread.
+ */
+static int pdmR3R0CritSectRwEnterExclContended(PPDMCRITSECTRW pThis, RTNATIVETHREAD hNativeSelf)
+{
+    PSUPDRVSESSION  pSession    = pThis->s.CTX_SUFF(pVM)->pSession;
+# ifdef IN_RING3
+    STAM_REL_COUNTER_INC(&pThis->s.StatContentionR3EnterExcl);
+    RTTHREAD        hThreadSelf = RTThreadSelf();
+# endif
+
+    for (;;)
+    {
+# ifdef IN_RING3
+        RTThreadBlocking(hThreadSelf, RTTHREADSTATE_RW_WRITE, true);
+# endif
+        int rc = SUPSemEventWaitNoResume(pSession, (SUPSEMEVENT)pThis->s.hEvtWrite, RT_INDEFINITE_WAIT);
+# ifdef IN_RING3
+        RTThreadUnblocked(hThreadSelf, RTTHREADSTATE_RW_WRITE);
+# endif
+        if (RT_UNLIKELY(pThis->s.u32Magic != PDMCRITSECTRW_MAGIC))
+            return VERR_SEM_DESTROYED;
+        AssertMsg(rc == VINF_SUCCESS || rc == VERR_INTERRUPTED, ("rc=%Rrc\n", rc));
+
+        uint64_t u64State = ASMAtomicReadU64(&pThis->s.u64State);
+        if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT))
+        {
+            bool fDone;
+            ASMAtomicCmpXchgHandle(&pThis->s.hNativeWriter, hNativeSelf, NIL_RTNATIVETHREAD, fDone);
+            if (fDone)
+                return VINF_SUCCESS;
+        }
+    }
+}
+#endif /* IN_RING3 || IN_RING0 */
+
+
+/**
+ * Worker that enters a read/write critical section with shared access.
+ *
+ * @returns VBox status code.
+ * @param   pThis               The read/write critical section.
+ * @param   rcBusy              The status code to return when we're in RC or R0
+ *                              and the section is busy.
+ * @param   fTryOnly            Only try enter it, don't wait.
+ */
+static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnly)
+{
+    /*
+     * Validate input.
+     */
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, VERR_SEM_DESTROYED);
+
+    /*
+     * Get cracking...
+     */
+    uint64_t u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+    uint64_t u64OldState = u64State;
+
+    for (;;)
+    {
+        if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_READ << PDMCRITSECTRW_DIR_SHIFT))
+        {
+            /* It flows in the right direction, try follow it before it changes. */
+            uint64_t c = (u64State & PDMCRITSECTRW_CNT_RD_MASK) >> PDMCRITSECTRW_CNT_RD_SHIFT;
+            c++;
+            Assert(c < PDMCRITSECTRW_CNT_MASK / 2);
+            u64State &= ~PDMCRITSECTRW_CNT_RD_MASK;
+            u64State |= c << PDMCRITSECTRW_CNT_RD_SHIFT;
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                return VINF_SUCCESS;
+        }
+        else if ((u64State & (PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_CNT_WR_MASK)) == 0)
+        {
+            /* Wrong direction, but we're alone here and can simply try switch the direction. */
+            u64State &= ~(PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_CNT_WR_MASK | PDMCRITSECTRW_DIR_MASK);
+            u64State |= (UINT64_C(1) << PDMCRITSECTRW_CNT_RD_SHIFT) | (PDMCRITSECTRW_DIR_READ << PDMCRITSECTRW_DIR_SHIFT);
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+            {
+                Assert(!pThis->s.fNeedReset);
+                return VINF_SUCCESS;
+            }
+        }
+        else
+        {
+            /* Is the writer perhaps doing a read recursion? */
+            RTNATIVETHREAD hNativeSelf = pdmCritSectRwGetNativeSelf(pThis);
+            RTNATIVETHREAD hNativeWriter;
+            ASMAtomicReadHandle(&pThis->s.hNativeWriter, &hNativeWriter);
+            if (hNativeSelf == hNativeWriter)
+            {
+                Assert(pThis->s.cWriterReads < UINT32_MAX / 2);
+                ASMAtomicIncU32(&pThis->s.cWriterReads);
+                return VINF_SUCCESS;
+            }
+
+            /* If we're only trying, return already. */
+            if (fTryOnly)
+                return VERR_SEM_BUSY;
+
+            if (!pdmCritSectRwCanBlock())
+            {
+#if defined(IN_RING0) || defined(IN_RC)
+                /* Call ring-3 to acquire it, or return busy. */
+                STAM_REL_COUNTER_INC(&pThis->s.StatContentionRZEnterShared);
+                if (rcBusy == VINF_SUCCESS)
+                {
+                    PVM     pVM   = pThis->s.CTX_SUFF(pVM); AssertPtr(pVM);
+                    PVMCPU  pVCpu = VMMGetCpu(pVM);         AssertPtr(pVCpu);
+                    return VMMRZCallRing3(pVM, pVCpu, VMMCALLRING3_PDM_CRIT_SECT_RW_ENTER_SHARED, MMHyperCCToR3(pVM, pThis));
+                }
+                LogFlow(("PDMCritSectRwEnterShared: busy => R3 (%Rrc)\n", rcBusy));
+                return rcBusy;
+#endif
+            }
+#if defined(IN_RING3) || defined(IN_RING0)
+            else
+            {
+                /* Add ourselves to the readers and the waiting readers, then wait
+                   for the direction to change. */
+                NOREF(rcBusy);
+                uint64_t c = (u64State & PDMCRITSECTRW_CNT_RD_MASK) >> PDMCRITSECTRW_CNT_RD_SHIFT;
+                c++;
+                Assert(c < PDMCRITSECTRW_CNT_MASK / 2);
+
+                uint64_t cWait = (u64State & PDMCRITSECTRW_WAIT_CNT_RD_MASK) >> PDMCRITSECTRW_WAIT_CNT_RD_SHIFT;
+                cWait++;
+                Assert(cWait <= c);
+                Assert(cWait < PDMCRITSECTRW_CNT_MASK / 2);
+
+                u64State &= ~(PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_WAIT_CNT_RD_MASK);
+                u64State |= (c << PDMCRITSECTRW_CNT_RD_SHIFT) | (cWait << PDMCRITSECTRW_WAIT_CNT_RD_SHIFT);
+                if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                    return pdmR3R0CritSectRwEnterSharedContended(pThis);
+            }
+#endif
+        }
+
+        if (pThis->s.u32Magic != PDMCRITSECTRW_MAGIC)
+            return VERR_SEM_DESTROYED;
+
+        ASMNopPause();
+        u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+        u64OldState = u64State;
+    }
+}
+
+
+/**
+ * Enter a read/write critical section with shared (read) access.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS on success.
+ * @retval  @a rcBusy if in ring-0 or raw-mode context and it is busy.
+ * @retval  VERR_SEM_NESTED if nested enter on a no nesting section. (Asserted.)
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @param   rcBusy      The status code to return when we're in RC or R0 and the
+ *                      section is busy.  Pass VINF_SUCCESS to acquired the
+ *                      critical section thru a ring-3 call if necessary.
+ * @sa      PDMCritSectRwTryEnterShared, PDMCritSectRwLeaveShared,
+ *          RTCritSectRwEnterShared.
+ */
+VMMDECL(int) PDMCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy)
+{
+    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/);
+}
+
+
+/**
+ * Try enter a read/write critical section with shared (read) access.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS on success.
+ * @retval  VERR_SEM_BUSY if the critsect was owned exclusively.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwEnterShared, PDMCritSectRwLeaveShared.
+ */
+VMMDECL(int) PDMCritSectRwTryEnterShared(PPDMCRITSECTRW pThis)
+{
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/);
+}
+
+
+#ifdef IN_RING3
+/**
+ * Enters a PDM read/write critical section with shared (read) access.
+ *
+ * @returns VINF_SUCCESS if entered successfully.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @param   fCallRing3  Whether this is a VMMRZCallRing3() request.  There is
+ *                      no lock validator record to patch up, so it only
+ *                      serves as documentation for now.
+ */
+VMMR3DECL(int) PDMR3CritSectRwEnterSharedEx(PPDMCRITSECTRW pThis, bool fCallRing3)
+{
+    NOREF(fCallRing3);
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, false /*fTryOnly*/);
+}
+#endif
+
+
+/**
+ * Leave a critical section held with shared access.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwEnterShared, PDMCritSectRwTryEnterShared.
+ */
+VMMDECL(int) PDMCritSectRwLeaveShared(PPDMCRITSECTRW pThis)
+{
+    /*
+     * Validate handle.
+     */
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, VERR_SEM_DESTROYED);
+
+    /*
+     * Check the direction and take action accordingly.
+     */
+    uint64_t u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+    uint64_t u64OldState = u64State;
+    if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_READ << PDMCRITSECTRW_DIR_SHIFT))
+    {
+        for (;;)
+        {
+            uint64_t c = (u64State & PDMCRITSECTRW_CNT_RD_MASK) >> PDMCRITSECTRW_CNT_RD_SHIFT;
+            AssertReturn(c > 0, VERR_NOT_OWNER);
+            c--;
+
+            if (   c > 0
+                || (u64State & PDMCRITSECTRW_CNT_WR_MASK) == 0)
+            {
+                /* Don't change the direction. */
+                u64State &= ~PDMCRITSECTRW_CNT_RD_MASK;
+                u64State |= c << PDMCRITSECTRW_CNT_RD_SHIFT;
+                if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                    break;
+            }
+            else
+            {
+#if defined(IN_RING0) || defined(IN_RC)
+                /* Can't signal the writer here, let ring-3 do the whole leave. */
+                if (!pdmCritSectRwCanSignal())
+                {
+                    pdmRZCritSectRwQueueLeave(pThis, false /*fExcl*/);
+                    break;
+                }
+#endif
+                /* Reverse the direction and signal the writer threads. */
+                u64State &= ~(PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_DIR_MASK);
+                u64State |= PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT;
+                if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                {
+#if defined(IN_RING3) || defined(IN_RING0)
+                    int rc = SUPSemEventSignal(pThis->s.CTX_SUFF(pVM)->pSession, (SUPSEMEVENT)pThis->s.hEvtWrite);
+                    AssertRC(rc);
+#endif
+                    break;
+                }
+            }
+
+            ASMNopPause();
+            u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+            u64OldState = u64State;
+        }
+    }
+    else
+    {
+        /* The writer leaving one of its read recursions. */
+        RTNATIVETHREAD hNativeSelf = pdmCritSectRwGetNativeSelf(pThis);
+        RTNATIVETHREAD hNativeWriter;
+        ASMAtomicReadHandle(&pThis->s.hNativeWriter, &hNativeWriter);
+        AssertReturn(hNativeSelf == hNativeWriter, VERR_NOT_OWNER);
+        AssertReturn(pThis->s.cWriterReads > 0, VERR_NOT_OWNER);
+        ASMAtomicDecU32(&pThis->s.cWriterReads);
+    }
+
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Worker that enters a read/write critical section with exclusive access.
+ *
+ * @returns VBox status code.
+ * @param   pThis               The read/write critical section.
+ * @param   rcBusy              The status code to return when we're in RC or R0
+ *                              and the section is busy.
+ * @param   fTryOnly            Only try enter it, don't wait.
+ */
+static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnly)
+{
+    /*
+     * Validate input.
+     */
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, VERR_SEM_DESTROYED);
+
+    /*
+     * Check if we're already the owner and just recursing.
+     */
+    RTNATIVETHREAD hNativeSelf = pdmCritSectRwGetNativeSelf(pThis);
+    RTNATIVETHREAD hNativeWriter;
+    ASMAtomicReadHandle(&pThis->s.hNativeWriter, &hNativeWriter);
+    if (hNativeSelf == hNativeWriter)
+    {
+        Assert((ASMAtomicReadU64(&pThis->s.u64State) & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT));
+        Assert(pThis->s.cWriteRecursions < UINT32_MAX / 2);
+        ASMAtomicIncU32(&pThis->s.cWriteRecursions);
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Get cracking.  When we cannot wait, a section that is being read is
+     * busy and we don't get in the way of the readers by counting ourselves.
+     */
+    bool const fNoWait    = fTryOnly || !pdmCritSectRwCanBlock();
+    uint64_t   u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+    uint64_t   u64OldState = u64State;
+
+    for (;;)
+    {
+        if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT))
+        {
+            /* It flows in the right direction, try follow it before it changes. */
+            uint64_t c = (u64State & PDMCRITSECTRW_CNT_WR_MASK) >> PDMCRITSECTRW_CNT_WR_SHIFT;
+            c++;
+            Assert(c < PDMCRITSECTRW_CNT_MASK / 2);
+            u64State &= ~PDMCRITSECTRW_CNT_WR_MASK;
+            u64State |= c << PDMCRITSECTRW_CNT_WR_SHIFT;
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                break;
+        }
+        else if ((u64State & (PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_CNT_WR_MASK)) == 0)
+        {
+            /* Wrong direction, but we're alone here and can simply try switch the direction. */
+            u64State &= ~(PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_CNT_WR_MASK | PDMCRITSECTRW_DIR_MASK);
+            u64State |= (UINT64_C(1) << PDMCRITSECTRW_CNT_WR_SHIFT) | (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT);
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                break;
+        }
+        else if (fNoWait)
+            break;
+        else
+        {
+            /* Readers own it, add ourselves to the writers and wait for the
+               last reader to hand it over. */
+            uint64_t c = (u64State & PDMCRITSECTRW_CNT_WR_MASK) >> PDMCRITSECTRW_CNT_WR_SHIFT;
+            c++;
+            Assert(c < PDMCRITSECTRW_CNT_MASK / 2);
+            u64State &= ~PDMCRITSECTRW_CNT_WR_MASK;
+            u64State |= c << PDMCRITSECTRW_CNT_WR_SHIFT;
+            if (ASMAtomicCmpXchgU64(&pThis->s.u64State, u64State, u64OldState))
+                break;
+        }
+
+        if (pThis->s.u32Magic != PDMCRITSECTRW_MAGIC)
+            return VERR_SEM_DESTROYED;
+
+        ASMNopPause();
+        u64State    = ASMAtomicReadU64(&pThis->s.u64State);
+        u64OldState = u64State;
+    }
+
+    /*
+     * If we're in write mode now try grab the ownership. Play fair if there
+     * are threads already waiting, unless we cannot wait ourselves.
+     */
+    bool fDone = (u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT)
+              && (   ((u64State & PDMCRITSECTRW_CNT_WR_MASK) >> PDMCRITSECTRW_CNT_WR_SHIFT) == 1
+                  || fNoWait);
+    if (fDone)
+        ASMAtomicCmpXchgHandle(&pThis->s.hNativeWriter, hNativeSelf, NIL_RTNATIVETHREAD, fDone);
+    if (!fDone)
+    {
+        if (fNoWait)
+        {
+            /* Back out of the writer count if we added ourselves to it. */
+            if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT))
+                pdmCritSectRwReleaseWriter(pThis);
+            if (fTryOnly)
+                return VERR_SEM_BUSY;
+
+#if defined(IN_RING0) || defined(IN_RC)
+            /* Call ring-3 to acquire it, or return busy. */
+            STAM_REL_COUNTER_INC(&pThis->s.StatContentionRZEnterExcl);
+            if (rcBusy == VINF_SUCCESS)
+            {
+                PVM     pVM   = pThis->s.CTX_SUFF(pVM); AssertPtr(pVM);
+                PVMCPU  pVCpu = VMMGetCpu(pVM);         AssertPtr(pVCpu);
+                return VMMRZCallRing3(pVM, pVCpu, VMMCALLRING3_PDM_CRIT_SECT_RW_ENTER_EXCL, MMHyperCCToR3(pVM, pThis));
+            }
+            LogFlow(("PDMCritSectRwEnterExcl: busy => R3 (%Rrc)\n", rcBusy));
+            return rcBusy;
+#endif
+        }
+#if defined(IN_RING3) || defined(IN_RING0)
+        NOREF(rcBusy);
+        int rc = pdmR3R0CritSectRwEnterExclContended(pThis, hNativeSelf);
+        if (RT_FAILURE(rc))
+            return rc;
+#endif
+    }
+
+    /*
+     * Got it!
+     */
+    Assert((ASMAtomicReadU64(&pThis->s.u64State) & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT));
+    ASMAtomicWriteU32(&pThis->s.cWriteRecursions, 1);
+    Assert(pThis->s.cWriterReads == 0);
+    STAM_PROFILE_ADV_START(&pThis->s.StatWriteLocked, swl);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Try enter a critical section with exclusive (write) access.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS on success.
+ * @retval  @a rcBusy if in ring-0 or raw-mode context and it is busy.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @param   rcBusy      The status code to return when we're in RC or R0 and the
+ *                      section is busy.  Pass VINF_SUCCESS to acquired the
+ *                      critical section thru a ring-3 call if necessary.
+ * @sa      PDMCritSectRwTryEnterExcl, PDMCritSectRwLeaveExcl,
+ *          RTCritSectRwEnterExcl.
+ */
+VMMDECL(int) PDMCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy)
+{
+    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryOnly*/);
+}
+
+
+/**
+ * Try enter a read/write critical section with exclusive (write) access.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS on success.
+ * @retval  VERR_SEM_BUSY if the critsect was owned.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwEnterExcl, PDMCritSectRwLeaveExcl.
+ */
+VMMDECL(int) PDMCritSectRwTryEnterExcl(PPDMCRITSECTRW pThis)
+{
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryOnly*/);
+}
+
+
+#ifdef IN_RING3
+/**
+ * Enters a PDM read/write critical section with exclusive (write) access.
+ *
+ * @returns VINF_SUCCESS if entered successfully.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @param   fCallRing3  Whether this is a VMMRZCallRing3() request.  There is
+ *                      no lock validator record to patch up, so it only
+ *                      serves as documentation for now.
+ */
+VMMR3DECL(int) PDMR3CritSectRwEnterExclEx(PPDMCRITSECTRW pThis, bool fCallRing3)
+{
+    NOREF(fCallRing3);
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, false /*fTryOnly*/);
+}
+#endif
+
+
+/**
+ * Leave a critical section held exclusively.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ * @retval  VERR_NOT_OWNER if the caller isn't the owner.
+ * @retval  VERR_WRONG_ORDER if read recursions are still outstanding.
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwEnterExcl, PDMCritSectRwTryEnterExcl.
+ */
+VMMDECL(int) PDMCritSectRwLeaveExcl(PPDMCRITSECTRW pThis)
+{
+    /*
+     * Validate handle.
+     */
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, VERR_SEM_DESTROYED);
+
+    RTNATIVETHREAD hNativeSelf = pdmCritSectRwGetNativeSelf(pThis);
+    RTNATIVETHREAD hNativeWriter;
+    ASMAtomicReadHandle(&pThis->s.hNativeWriter, &hNativeWriter);
+    AssertReturn(hNativeSelf == hNativeWriter, VERR_NOT_OWNER);
+
+    /*
+     * Unwind a recursion.
+     */
+    if (pThis->s.cWriteRecursions > 1)
+    {
+        ASMAtomicDecU32(&pThis->s.cWriteRecursions);
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Give up the ownership and update the state.  The latter is queued for
+     * ring-3 in the contexts where we cannot wake up the waiters.
+     */
+    AssertReturn(pThis->s.cWriterReads == 0, VERR_WRONG_ORDER); /* (must release all read recursions before the final write.) */
+    STAM_PROFILE_ADV_STOP(&pThis->s.StatWriteLocked, swl);
+    ASMAtomicWriteU32(&pThis->s.cWriteRecursions, 0);
+    ASMAtomicWriteHandle(&pThis->s.hNativeWriter, NIL_RTNATIVETHREAD);
+    pdmCritSectRwReleaseWriter(pThis);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks the caller is the exclusive (write) owner of the critical section.
+ *
+ * @retval  @c true if owner.
+ * @retval  @c false if not owner.
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwIsReadOwner, PDMCritSectIsOwner,
+ *          RTCritSectRwIsWriteOwner.
+ */
+VMMDECL(bool) PDMCritSectRwIsWriteOwner(PCPDMCRITSECTRW pThis)
+{
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, false);
+
+    RTNATIVETHREAD hNativeWriter;
+    ASMAtomicUoReadHandle(&pThis->s.hNativeWriter, &hNativeWriter);
+    if (hNativeWriter == NIL_RTNATIVETHREAD)
+        return false;
+    return hNativeWriter == pdmCritSectRwGetNativeSelf(pThis);
+}
+
+
+/**
+ * Checks if the caller is one of the read owners of the critical section.
+ *
+ * The readers are not tracked individually, so unless the caller is the
+ * exclusive owner this only tells whether anyone owns the section shared.
+ * Only use it for assertions.
+ *
+ * @retval  @c true if the caller may be a read owner.
+ * @retval  @c false if it definitely isn't.
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwIsWriteOwner, RTCritSectRwIsReadOwner.
+ */
+VMMDECL(bool) PDMCritSectRwIsReadOwner(PCPDMCRITSECTRW pThis)
+{
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, false);
+
+    uint64_t u64State = ASMAtomicReadU64((uint64_t volatile *)&pThis->s.u64State);
+    if ((u64State & PDMCRITSECTRW_DIR_MASK) == (PDMCRITSECTRW_DIR_WRITE << PDMCRITSECTRW_DIR_SHIFT))
+    {
+        /* The writer may be doing a read recursion. */
+        RTNATIVETHREAD hNativeWriter;
+        ASMAtomicUoReadHandle(&pThis->s.hNativeWriter, &hNativeWriter);
+        return hNativeWriter != NIL_RTNATIVETHREAD
+            && hNativeWriter == pdmCritSectRwGetNativeSelf(pThis);
+    }
+    return (u64State & PDMCRITSECTRW_CNT_RD_MASK) != 0;
+}
+
+
+/**
+ * Gets the write recursion count.
+ *
+ * @returns The write recursion count (0 if bad critsect).
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwGetReadCount, RTCritSectRwGetWriteRecursion.
+ */
+VMMDECL(uint32_t) PDMCritSectRwGetWriteRecursion(PCPDMCRITSECTRW pThis)
+{
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, 0);
+    return pThis->s.cWriteRecursions;
+}
+
+
+/**
+ * Gets the current number of reads.
+ *
+ * This includes all read recursions, so it might be higher than the number of
+ * read owners.  It does not include reads done by the current writer.
+ *
+ * @returns The read count (0 if bad critsect).
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectRwGetWriteRecursion, RTCritSectRwGetReadCount.
+ */
+VMMDECL(uint32_t) PDMCritSectRwGetReadCount(PCPDMCRITSECTRW pThis)
+{
+    AssertPtr(pThis);
+    AssertReturn(pThis->s.u32Magic == PDMCRITSECTRW_MAGIC, 0);
+
+    uint64_t u64State = ASMAtomicReadU64((uint64_t volatile *)&pThis->s.u64State);
+    if ((u64State & PDMCRITSECTRW_DIR_MASK) != (PDMCRITSECTRW_DIR_READ << PDMCRITSECTRW_DIR_SHIFT))
+        return 0;
+    return (uint32_t)((u64State & PDMCRITSECTRW_CNT_RD_MASK) >> PDMCRITSECTRW_CNT_RD_SHIFT);
+}
+
+
+/**
+ * Checks if the read/write critical section is initialized or not.
+ *
+ * @retval  @c true if initialized.
+ * @retval  @c false if not initialized.
+ * @param   pThis       Pointer to the read/write critical section.
+ * @sa      PDMCritSectIsInitialized, RTCritSectRwIsInitialized.
+ */
+VMMDECL(bool) PDMCritSectRwIsInitialized(PCPDMCRITSECTRW pThis)
+{
+    AssertPtr(pThis);
+    return pThis->s.u32Magic == PDMCRITSECTRW_MAGIC;
+}
+
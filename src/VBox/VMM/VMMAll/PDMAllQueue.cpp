@@ -35,6 +35,21 @@
 #include <iprt/assert.h>
 
 
+/**
+ * Gets the lane of the calling thread in a batch queue.
+ *
+ * @returns The lane, the last one for threads which aren't EMTs.
+ * @param   pQueue      The queue handle.
+ */
+DECLINLINE(PPDMQUEUELANE) pdmQueueGetLane(PPDMQUEUE pQueue)
+{
+    VMCPUID idCpu = VMMGetCpuId(pQueue->CTX_SUFF(pVM));
+    if (idCpu >= pQueue->cLanes - 1)
+        idCpu = pQueue->cLanes - 1;
+    return PDMQUEUE_LANE(pQueue, idCpu);
+}
+
+
 /**
  * Allocate an item from a queue.
  * The allocated item must be handed on to PDMR3QueueInsert() after the
@@ -48,6 +63,28 @@
 VMMDECL(PPDMQUEUEITEMCORE) PDMQueueAlloc(PPDMQUEUE pQueue)
 {
     Assert(VALID_PTR(pQueue) && pQueue->CTX_SUFF(pVM));
+
+    /*
+     * Batch queues try the free item cache of the CPU's own lane first.
+     * The cache is only refilled by the flushing EMT, so the lane owner
+     * is the only one taking items out of it.
+     */
+    if (pQueue->cLanes)
+    {
+        PPDMQUEUELANE pLane = pdmQueueGetLane(pQueue);
+        if (pLane != PDMQUEUE_LANE(pQueue, pQueue->cLanes - 1))
+        {
+            uint32_t const iTail = pLane->iCacheTail;
+            if (iTail != ASMAtomicReadU32(&pLane->iCacheHead))
+            {
+                uint32_t const iItem = pLane->aiCache[iTail % RT_ELEMENTS(pLane->aiCache)];
+                ASMAtomicWriteU32(&pLane->iCacheTail, iTail + 1);
+                return PDMQUEUE_ITEM(pQueue, iItem);
+            }
+            STAM_REL_COUNTER_INC(&pLane->StatAllocShared);
+        }
+    }
+
     PPDMQUEUEITEMCORE pNew;
     uint32_t iNext;
     uint32_t i;
@@ -80,6 +117,40 @@ VMMDECL(void) PDMQueueInsert(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem)
     Assert(VALID_PTR(pQueue) && pQueue->CTX_SUFF(pVM));
     Assert(VALID_PTR(pItem));
 
+    if (pQueue->cLanes)
+    {
+        /*
+         * Batch queue: push it onto the lane of the CPU and only touch the
+         * force action flag if nobody has raised it yet.  If it is set, the
+         * flushing EMT hasn't cleared it yet and will see the item.
+         */
+        PPDMQUEUELANE     pLane = pdmQueueGetLane(pQueue);
+        PPDMQUEUEITEMCORE pNext;
+        do
+        {
+            pNext = pLane->CTX_SUFF(pPending);
+            pItem->CTX_SUFF(pNext) = pNext;
+        } while (!ASMAtomicCmpXchgPtr(&pLane->CTX_SUFF(pPending), pItem, pNext));
+        STAM_REL_COUNTER_INC(&pLane->StatInsert);
+
+        PVM pVM = pQueue->CTX_SUFF(pVM);
+        if (    !pQueue->pTimer
+            &&  (   !VM_FF_ISSET(pVM, VM_FF_PDM_QUEUES)
+                 || !ASMBitTest(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_PENDING_BIT)))
+        {
+            Log2(("PDMQueueInsert: VM_FF_PDM_QUEUES %d -> 1 (batch)\n", VM_FF_ISSET(pVM, VM_FF_PDM_QUEUES)));
+            VM_FF_SET(pVM, VM_FF_PDM_QUEUES);
+            ASMAtomicBitSet(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_PENDING_BIT);
+#ifdef IN_RING3
+# ifdef VBOX_WITH_REM
+            REMR3NotifyQueuePending(pVM);
+# endif
+            VMR3NotifyGlobalFFU(pVM->pUVM, VMNOTIFYFF_FLAGS_DONE_REM);
+#endif
+        }
+        return;
+    }
+
 #if 0 /* the paranoid android version: */
     void *pvNext;
     do
@@ -847,6 +847,55 @@ int pgmPhysRecheckLargePage(PVM pVM, RTGCPHYS GCPhys, PPGMPAGE pLargePage)
     return VERR_PGM_INVALID_LARGE_PAGE_RANGE;
 }
 
+
+/**
+ * Demotes the large page containing the given address to ordinary 4 KB pages.
+ *
+ * The pages stay where they are, they just lose their large page status and
+ * can then be freed, shared or replaced individually.  The large page
+ * promotion pass in ring-3 may turn the range into a large page again later.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   GCPhys      An address inside the large page.
+ * @param   pfFlushTLBs Set to @a true if the shadow TLBs should be flushed, it
+ *                      is NOT touched if this isn't necessary.
+ *
+ * @remarks Must be called from within the PGM critical section.
+ */
+void pgmPhysDemoteLargePage(PVM pVM, RTGCPHYS GCPhys, bool *pfFlushTLBs)
+{
+    PGM_LOCK_ASSERT_OWNER(pVM);
+    GCPhys &= X86_PDE2M_PAE_PG_MASK;
+
+    PPGMPAGE pLargePage;
+    int rc = pgmPhysGetPageEx(pVM, GCPhys, &pLargePage);
+    AssertRCReturnVoid(rc);
+
+    /* Get rid of the 2 MB shadow PDE first, this disables the large page. */
+    if (PGM_PAGE_GET_PDE_TYPE(pLargePage) == PGM_PAGE_PDE_TYPE_PDE)
+        pgmPoolTrackUpdateGCPhys(pVM, GCPhys, pLargePage, true /* clear the entries */, pfFlushTLBs);
+    if (PGM_PAGE_GET_PDE_TYPE(pLargePage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+    {
+        Assert(pVM->pgm.s.cLargePagesDisabled > 0 && pVM->pgm.s.cLargePages > 0);
+        pVM->pgm.s.cLargePagesDisabled--;
+        pVM->pgm.s.cLargePages--;
+        STAM_REL_COUNTER_INC(&pVM->pgm.s.StatLargePageDemoted);
+        Log(("pgmPhysDemoteLargePage: %RGp\n", GCPhys));
+    }
+
+    /* Turn the whole range into ordinary pages. */
+    for (unsigned i = 0; i < _2M/PAGE_SIZE; i++)
+    {
+        PPGMPAGE pPage;
+        rc = pgmPhysGetPageEx(pVM, GCPhys, &pPage);
+        AssertRCBreak(rc);
+        if (    PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE
+            ||  PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+            PGM_PAGE_SET_PDE_TYPE(pVM, pPage, PGM_PAGE_PDE_TYPE_PT);
+        GCPhys += PAGE_SIZE;
+    }
+}
+
 #endif /* PGM_WITH_LARGE_PAGES */
 
 /**
@@ -124,6 +124,16 @@ VMMDECL(void) TMNotifyEndOfExecution(PVMCPU pVCpu)
     if (pVM->tm.s.fTSCTiedToExecution)
         tmCpuTickPause(pVCpu);
 
+#ifdef IN_RING0
+    /* Deliver tickless thread kicks raw-mode context couldn't. */
+    if (    pVM->tm.s.fTicklessKickPending
+        &&  ASMAtomicXchgBool(&pVM->tm.s.fTicklessKickPending, false))
+    {
+        SUPSemEventSignal(pVM->pSession, pVM->tm.s.hTicklessEvt);
+        STAM_REL_COUNTER_INC(&pVM->tm.s.StatTicklessKicks);
+    }
+#endif
+
 #ifndef VBOX_WITHOUT_NS_ACCOUNTING
     uint64_t const u64NsTs           = RTTimeNanoTS();
     uint64_t const cNsTotalNew       = u64NsTs - pVCpu->tm.s.u64NsTsStartTotal;
@@ -337,6 +347,32 @@ DECLINLINE(bool) tmTimerTryWithLink(PTMTIMER pTimer, TMTIMERSTATE enmStateNew, T
 }
 
 
+/**
+ * Kicks the tickless thread if a queue got a new head expiring before the
+ * thread is due to wake up.
+ *
+ * This only compares against the clock time the thread published for the
+ * queue, the conversion to host time is left to the thread.
+ *
+ * @param   pVM             Pointer to the VM.
+ * @param   enmClock        The clock of the queue.
+ * @param   u64Expire       The expiration time of the new head.
+ */
+DECLINLINE(void) tmTicklessNewHead(PVM pVM, TMCLOCK enmClock, uint64_t u64Expire)
+{
+    if (    pVM->tm.s.fTickless
+        &&  u64Expire < ASMAtomicReadU64(&pVM->tm.s.au64TicklessExpire[enmClock]))
+    {
+#ifdef IN_RC
+        ASMAtomicWriteBool(&pVM->tm.s.fTicklessKickPending, true);
+#else
+        SUPSemEventSignal(pVM->pSession, pVM->tm.s.hTicklessEvt);
+        STAM_REL_COUNTER_INC(&pVM->tm.s.StatTicklessKicks);
+#endif
+    }
+}
+
+
 /**
  * Links a timer into the active list of a timer queue.
  *
@@ -348,45 +384,20 @@ DECLINLINE(bool) tmTimerTryWithLink(PTMTIMER pTimer, TMTIMERSTATE enmStateNew, T
  */
 DECL_FORCE_INLINE(void) tmTimerQueueLinkActive(PTMTIMERQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
 {
-    Assert(!pTimer->offNext);
-    Assert(!pTimer->offPrev);
+    Assert(!pTimer->idxActive);
     Assert(pTimer->enmState == TMTIMERSTATE_ACTIVE || pTimer->enmClock != TMCLOCK_VIRTUAL_SYNC); /* (active is not a stable state) */
-
-    PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue);
-    if (pCur)
+    AssertRelease(pQueue->cActive < pQueue->cHeapAlloc); /* tmR3TimerQueueGrow makes room for every timer. */
+
+    TMTIMERHEAPENTRY Entry;
+    Entry.u64Expire = u64Expire;
+    Entry.uSeq      = pQueue->uSeqNext++;
+    Entry.offTimer  = (intptr_t)pTimer - (intptr_t)pQueue;
+    uint32_t const i = tmTimerHeapSiftUp(pQueue, TMTIMER_GET_HEAP(pQueue), ++pQueue->cActive, &Entry);
+    if (i == 1)
     {
-        for (;; pCur = TMTIMER_GET_NEXT(pCur))
-        {
-            if (pCur->u64Expire > u64Expire)
-            {
-                const PTMTIMER pPrev = TMTIMER_GET_PREV(pCur);
-                TMTIMER_SET_NEXT(pTimer, pCur);
-                TMTIMER_SET_PREV(pTimer, pPrev);
-                if (pPrev)
-                    TMTIMER_SET_NEXT(pPrev, pTimer);
-                else
-                {
-                    TMTIMER_SET_HEAD(pQueue, pTimer);
-                    ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
-                    DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive head", R3STRING(pTimer->pszDesc));
-                }
-                TMTIMER_SET_PREV(pCur, pTimer);
-                return;
-            }
-            if (!pCur->offNext)
-            {
-                TMTIMER_SET_NEXT(pCur, pTimer);
-                TMTIMER_SET_PREV(pTimer, pCur);
-                DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive tail", R3STRING(pTimer->pszDesc));
-                return;
-            }
-        }
-    }
-    else
-    {
-        TMTIMER_SET_HEAD(pQueue, pTimer);
         ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
-        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive empty", R3STRING(pTimer->pszDesc));
+        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive head", R3STRING(pTimer->pszDesc));
+        tmTicklessNewHead(pTimer->CTX_SUFF(pVM), pQueue->enmClock, u64Expire);
     }
 }
 
@@ -426,7 +437,7 @@ DECLINLINE(void) tmTimerQueueScheduleOne(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
              * Schedule timer (insert into the active list).
              */
             case TMTIMERSTATE_PENDING_SCHEDULE:
-                Assert(!pTimer->offNext); Assert(!pTimer->offPrev);
+                Assert(!pTimer->idxActive);
                 if (RT_UNLIKELY(!tmTimerTry(pTimer, TMTIMERSTATE_ACTIVE, TMTIMERSTATE_PENDING_SCHEDULE)))
                     break; /* retry */
                 tmTimerQueueLinkActive(pQueue, pTimer, pTimer->u64Expire);
@@ -445,7 +456,7 @@ DECLINLINE(void) tmTimerQueueScheduleOne(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
              * Stop the timer (not on the active list).
              */
             case TMTIMERSTATE_PENDING_STOP_SCHEDULE:
-                Assert(!pTimer->offNext); Assert(!pTimer->offPrev);
+                Assert(!pTimer->idxActive);
                 if (RT_UNLIKELY(!tmTimerTry(pTimer, TMTIMERSTATE_STOPPED, TMTIMERSTATE_PENDING_STOP_SCHEDULE)))
                     break;
                 return;
@@ -550,11 +561,19 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
                 continue;
             fHaveVirtualSyncLock = true;
         }
-        PTMTIMER pPrev = NULL;
-        for (PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue); pCur; pPrev = pCur, pCur = TMTIMER_GET_NEXT(pCur))
+        AssertMsg(pQueue->cActive <= pQueue->cHeapAlloc, ("%s: %u > %u\n", pszWhere, pQueue->cActive, pQueue->cHeapAlloc));
+        AssertMsg(   pQueue->cActive
+                  ? pQueue->u64Expire == TMTIMER_GET_HEAP(pQueue)[1].u64Expire
+                  : pQueue->u64Expire == INT64_MAX,
+                  ("%s: %'RU64\n", pszWhere, pQueue->u64Expire));
+        for (uint32_t iEntry = 1; iEntry <= pQueue->cActive; iEntry++)
         {
+            PTMTIMERHEAPENTRY pEntry = &TMTIMER_GET_HEAP(pQueue)[iEntry];
+            PTMTIMER          pCur   = TMTIMER_HEAP_ENTRY_TIMER(pQueue, pEntry);
             AssertMsg((int)pCur->enmClock == i, ("%s: %d != %d\n", pszWhere, pCur->enmClock, i));
-            AssertMsg(TMTIMER_GET_PREV(pCur) == pPrev, ("%s: %p != %p\n", pszWhere, TMTIMER_GET_PREV(pCur), pPrev));
+            AssertMsg(pCur->idxActive == iEntry, ("%s: %u != %u\n", pszWhere, pCur->idxActive, iEntry));
+            AssertMsg(iEntry == 1 || !tmTimerHeapEntryIsBefore(pEntry, &TMTIMER_GET_HEAP(pQueue)[iEntry / 2]),
+                      ("%s: heap order broken at %u\n", pszWhere, iEntry));
             TMTIMERSTATE enmState = pCur->enmState;
             switch (enmState)
             {
@@ -594,11 +613,9 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
             case TMTIMERSTATE_PENDING_RESCHEDULE_SET_EXPIRE:
                 if (fHaveVirtualSyncLock || pCur->enmClock != TMCLOCK_VIRTUAL_SYNC)
                 {
-                    PTMTIMERR3 pCurAct = TMTIMER_GET_HEAD(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->enmClock]);
-                    Assert(pCur->offPrev || pCur == pCurAct);
-                    while (pCurAct && pCurAct != pCur)
-                        pCurAct = TMTIMER_GET_NEXT(pCurAct);
-                    Assert(pCurAct == pCur);
+                    PTMTIMERQUEUE pQueue = &pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->enmClock];
+                    Assert(pCur->idxActive >= 1 && pCur->idxActive <= pQueue->cActive);
+                    Assert(TMTIMER_HEAP_ENTRY_TIMER(pQueue, &TMTIMER_GET_HEAP(pQueue)[pCur->idxActive]) == pCur);
                 }
                 break;
 
@@ -607,18 +624,7 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
             case TMTIMERSTATE_STOPPED:
             case TMTIMERSTATE_EXPIRED_DELIVER:
                 if (fHaveVirtualSyncLock || pCur->enmClock != TMCLOCK_VIRTUAL_SYNC)
-                {
-                    Assert(!pCur->offNext);
-                    Assert(!pCur->offPrev);
-                    for (PTMTIMERR3 pCurAct = TMTIMER_GET_HEAD(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->enmClock]);
-                          pCurAct;
-                          pCurAct = TMTIMER_GET_NEXT(pCurAct))
-                    {
-                        Assert(pCurAct != pCur);
-                        Assert(TMTIMER_GET_NEXT(pCurAct) != pCur);
-                        Assert(TMTIMER_GET_PREV(pCurAct) != pCur);
-                    }
-                }
+                    Assert(!pCur->idxActive);
                 break;
 
             /* ignore */
@@ -1095,8 +1101,7 @@ VMMDECL(bool) TMTimerIsLockOwner(PTMTIMER pTimer)
  */
 static int tmTimerSetOptimizedStart(PVM pVM, PTMTIMER pTimer, uint64_t u64Expire)
 {
-    Assert(!pTimer->offPrev);
-    Assert(!pTimer->offNext);
+    Assert(!pTimer->idxActive);
     Assert(pTimer->enmState == TMTIMERSTATE_ACTIVE);
 
     TMCLOCK const enmClock = pTimer->enmClock;
@@ -1277,8 +1282,7 @@ VMMDECL(int) TMTimerSet(PTMTIMER pTimer, uint64_t u64Expire)
             case TMTIMERSTATE_STOPPED:
                 if (tmTimerTryWithLink(pTimer, TMTIMERSTATE_PENDING_SCHEDULE_SET_EXPIRE, enmState))
                 {
-                    Assert(!pTimer->offPrev);
-                    Assert(!pTimer->offNext);
+                    Assert(!pTimer->idxActive);
                     pTimer->u64Expire = u64Expire;
                     TM_SET_STATE(pTimer, TMTIMERSTATE_PENDING_SCHEDULE);
                     tmSchedule(pTimer);
@@ -1399,8 +1403,7 @@ DECL_FORCE_INLINE(uint64_t) tmTimerSetRelativeNowWorker(PVM pVM, TMCLOCK enmCloc
  */
 static int tmTimerSetRelativeOptimizedStart(PVM pVM, PTMTIMER pTimer, uint64_t cTicksToNext, uint64_t *pu64Now)
 {
-    Assert(!pTimer->offPrev);
-    Assert(!pTimer->offNext);
+    Assert(!pTimer->idxActive);
     Assert(pTimer->enmState == TMTIMERSTATE_ACTIVE);
 
     /*
@@ -1598,8 +1601,7 @@ VMMDECL(int) TMTimerSetRelative(PTMTIMER pTimer, uint64_t cTicksToNext, uint64_t
             case TMTIMERSTATE_EXPIRED_DELIVER:
                 if (tmTimerTryWithLink(pTimer, TMTIMERSTATE_PENDING_SCHEDULE_SET_EXPIRE, enmState))
                 {
-                    Assert(!pTimer->offPrev);
-                    Assert(!pTimer->offNext);
+                    Assert(!pTimer->idxActive);
                     pTimer->u64Expire = cTicksToNext + tmTimerSetRelativeNowWorker(pVM, enmClock, pu64Now);
                     Log2(("TMTimerSetRelative: %p:{.enmState=%s, .pszDesc='%s', .u64Expire=%'RU64} cRetries=%d [EXP/STOP]\n",
                           pTimer, tmTimerState(enmState), R3STRING(pTimer->pszDesc), pTimer->u64Expire, cRetries));
@@ -2456,8 +2458,9 @@ static uint32_t tmGetFrequencyHint(PVM pVM)
             for (int i = 0; i < TMCLOCK_MAX; i++)
             {
                 PTMTIMERQUEUE pQueue = &pVM->tm.s.CTX_SUFF(paTimerQueues)[i];
-                for (PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue); pCur; pCur = TMTIMER_GET_NEXT(pCur))
+                for (uint32_t iEntry = 1; iEntry <= pQueue->cActive; iEntry++)
                 {
+                    PTMTIMER pCur = TMTIMER_HEAP_ENTRY_TIMER(pQueue, &TMTIMER_GET_HEAP(pQueue)[iEntry]);
                     uint32_t uHzHint = ASMAtomicUoReadU32(&pCur->uHzHint);
                     if (uHzHint > uMaxHzHint)
                     {
@@ -133,15 +133,55 @@
  *
  *
  *
+ * @section sec_gmm_fusion      Page Fusion Scanner
+ *
+ * Besides the pages in shared modules registered by the guest additions, the
+ * VMs can ask GMM to look for identical pages anywhere in guest RAM
+ * (GMMR0PageFusionScan).  PGM walks a slice of the RAM ranges on an EMT with
+ * the other EMTs parked, and hands each allocated page to
+ * GMMR0PageFusionCheckPage, which works much like KSM on Linux:
+ *      - The CRC-32 of the page is looked up in a tree of shared pages the
+ *        scanner has made earlier (the stable tree).  If an identical one is
+ *        found, the private page is freed and replaced by that.
+ *      - Failing that, it's looked up in a tree of private pages seen by the
+ *        earlier scans (the unstable tree).  If one of those is identical, the
+ *        page is turned into a shared page and moves to the stable tree, so the
+ *        owner of the other page will pick it up on its next scan.
+ *      - Otherwise the page is added to the unstable tree.
+ *
+ * A VM can only ever change its own pages, since PGM has to know about it, and
+ * none of the trees are updated when pages are written to or freed.  So every
+ * hit is verified by comparing the two pages, and the trees are simply thrown
+ * away when they grow too big.  Pages that keep changing rarely match anything
+ * and will quickly be unshared again by the copy-on-write fault if they do.
+ *
+ * The pages are compared through temporary read-only kernel mappings, the
+ * chunks of other VMs are never mapped into the calling process.
+ *
+ * The scanning is rate limited host wide by a CPU budget in nanoseconds per
+ * second (@gcfgm 64-bit GMM/PageFusionBudget).  Only the session owning the
+ * first VM registered with GMM may change it, and it reverts to the default
+ * when the last VM is gone.  Legacy mode is not supported.
+ *
+ *
  * @section sec_gmm_numa        NUMA
  *
- * NUMA considerations will be designed and implemented a bit later.
+ * Each chunk is tagged with the host NUMA node of the CPU that allocated it.
+ * The host allocates the backing memory of a new chunk locally to the
+ * allocating thread, so this is where the memory mostly resides.
+ *
+ * When picking pages from existing chunks outside the chunks already
+ * associated with the VM, only chunks on the allowed nodes are considered.
+ * By default this is the node of the CPU the requesting EMT is running on.
+ * A VM can be restricted to a set of nodes instead (GMMR0SetNumaPolicy, see
+ * MM/NumaNodeMask), in which case chunks on the current node are still
+ * preferred if it is part of the set.  New chunks are always allocated
+ * locally, so a node set is only fully honoured when the EMTs are kept on
+ * the CPUs of those nodes (MM/NumaEmtAffinity).  Only when the host is out
+ * of memory are pages taken from whatever node has some.
  *
- * The preliminary guesses is that we will have to try allocate memory as
- * close as possible to the CPUs the VM is executed on (EMT and additional CPU
- * threads). Which means it's mostly about allocation and sharing policies.
- * Both the scheduler and allocator interface will to supply some NUMA info
- * and we'll need to have a way to calc access costs.
+ * The number of chunks and free pages per node are exposed in the
+ * statistics (/GMM/NumaNodes/).
  *
  */
 
@@ -161,9 +201,7 @@
 #include <VBox/err.h>
 #include <iprt/asm.h>
 #include <iprt/avl.h>
-#ifdef VBOX_STRICT
-# include <iprt/crc.h>
-#endif
+#include <iprt/crc.h>
 #include <iprt/list.h>
 #include <iprt/mem.h>
 #include <iprt/memobj.h>
@@ -414,8 +452,8 @@ typedef struct GMMCHUNK
      * When in bound memory mode this isn't a preference any longer.  (Giant
      * mtx.) */
     uint16_t            hGVM;
-    /** The ID of the NUMA node the memory mostly resides on.  (Reserved for
-     *  future use.)  (Giant mtx.) */
+    /** The ID of the NUMA node the memory mostly resides on.
+     *  GMM_CHUNK_NUMA_ID_UNKNOWN if not known.  (Giant mtx.) */
     uint16_t            idNumaNode;
     /** The number of private pages.  (Giant mtx.) */
     uint16_t            cPrivate;
@@ -500,6 +538,35 @@ typedef struct GMM
     /** The chunk list.  For simplifying the cleanup process. */
     RTLISTANCHOR        ChunkList;
 
+    /** Page fusion scanner state, see @ref sec_gmm_fusion. */
+    struct
+    {
+        /** Shared pages made by the scanner (GMMFUSIONNODE). */
+        PAVLLU32NODECORE    pStableTree;
+        /** Private pages seen by the scanner (GMMFUSIONNODE). */
+        PAVLLU32NODECORE    pUnstableTree;
+        /** The number of nodes in pStableTree. */
+        uint32_t            cStableNodes;
+        /** The number of nodes in pUnstableTree. */
+        uint32_t            cUnstableNodes;
+        /** The CPU time the scanner may use per second, host wide.
+         * @gcfgm   64-bit GMM/PageFusionBudget */
+        uint64_t            cNsBudget;
+        /** The session that may change cNsBudget, i.e. the one owning the first
+         * VM registered with GMM.  NULL if that VM is gone. */
+        PSUPDRVSESSION      pConfigSession;
+        /** The start of the current budget period (RTTimeSystemNanoTS). */
+        uint64_t            u64PeriodStartNS;
+        /** The CPU time spent in the current budget period. */
+        uint64_t            cNsSpent;
+        /** The number of pages scanned. */
+        uint64_t            cScannedPages;
+        /** The number of pages turned into shared ones. */
+        uint64_t            cSharedPages;
+        /** The number of pages replaced by an existing shared page. */
+        uint64_t            cSavedPages;
+    } Fusion;
+
     /** The maximum number of pages we're allowed to allocate.
      * @gcfgm   64-bit GMM/MaxPages Direct.
      * @gcfgm   32-bit GMM/PctPages Relative to the number of host pages. */
@@ -523,6 +590,11 @@ typedef struct GMM
     uint32_t            cChunks;
     /** The number of current ballooned pages. */
     uint64_t            cBalloonedPages;
+    /** The number of host NUMA nodes, limited to GMM_MAX_NUMA_NODES.
+     * This is determined at initialization time. */
+    uint32_t            cNumaNodes;
+    /** Per NUMA node chunk and free page counts. */
+    GMMNUMANODESTATS    aNumaNodes[GMM_MAX_NUMA_NODES];
 
     /** The legacy allocation mode indicator.
      * This is determined at initialization time. */
@@ -592,6 +664,33 @@ typedef GMMR0CHUNKMTXSTATE *PGMMR0CHUNKMTXSTATE;
 /** @} */
 
 
+/** The max number of nodes in GMM::Fusion.pStableTree. */
+#define GMM_FUSION_MAX_STABLE_NODES     _1M
+/** The max number of nodes in GMM::Fusion.pUnstableTree. */
+#define GMM_FUSION_MAX_UNSTABLE_NODES   _256K
+/** The max number of references we let the scanner give a shared page. */
+#define GMM_FUSION_MAX_REFS             UINT16_C(0xfff0)
+/** The max time a single GMMR0PageFusionScan call may take (the other EMTs of
+ * the VM are waiting for it). */
+#define GMM_FUSION_MAX_SLICE_NS         (2 * RT_NS_1MS)
+/** The default page fusion budget, GMM::Fusion.cNsBudget. */
+#define GMM_FUSION_DEFAULT_BUDGET_NS    (20 * RT_NS_1MS)
+
+
+/**
+ * A page fusion tree node, see @ref sec_gmm_fusion.
+ */
+typedef struct GMMFUSIONNODE
+{
+    /** Core, the key is the CRC-32 of the page content. */
+    AVLLU32NODECORE     Core;
+    /** The ID of the page. */
+    uint32_t            idPage;
+} GMMFUSIONNODE;
+/** Pointer to a page fusion tree node. */
+typedef GMMFUSIONNODE *PGMMFUSIONNODE;
+
+
 /** The maximum number of shared modules per-vm. */
 #define GMM_MAX_SHARED_PER_VM_MODULES   2048
 /** The maximum number of shared modules GMM is allowed to track. */
@@ -725,6 +824,7 @@ DECLINLINE(void)            gmmR0FreeSharedPage(PGMM pGMM, PGVM pGVM, uint32_t i
 static int                  gmmR0UnmapChunkLocked(PGMM pGMM, PGVM pGVM, PGMMCHUNK pChunk);
 #ifdef VBOX_WITH_PAGE_SHARING
 static void                 gmmR0SharedModuleCleanup(PGMM pGMM, PGVM pGVM);
+static void                 gmmR0FusionResetTree(PPAVLLU32NODECORE ppTree, uint32_t *pcNodes);
 # ifdef VBOX_STRICT
 static uint32_t             gmmR0StrictPageChecksum(PGMM pGMM, PGVM pGVM, uint32_t idPage);
 # endif
@@ -756,6 +856,7 @@ GMMR0DECL(int) GMMR0Init(void)
         pGMM->ChunkTLB.aEntries[i].idChunk = NIL_GMM_CHUNKID;
     RTListInit(&pGMM->ChunkList);
     ASMBitSet(&pGMM->bmChunkId[0], NIL_GMM_CHUNKID);
+    pGMM->Fusion.cNsBudget = GMM_FUSION_DEFAULT_BUDGET_NS;
 
     int rc = RTSemFastMutexCreate(&pGMM->hMtx);
     if (RT_SUCCESS(rc))
@@ -805,6 +906,11 @@ GMMR0DECL(int) GMMR0Init(void)
              */
             pGMM->cMaxPages = UINT32_MAX; /** @todo IPRT function for query ram size and such. */
 
+            /*
+             * The NUMA topology, see @ref sec_gmm_numa.
+             */
+            pGMM->cNumaNodes = RT_MIN(RTMpGetNumaNodeCount(), GMM_MAX_NUMA_NODES);
+
             g_pGMM = pGMM;
             LogFlow(("GMMInit: pGMM=%p fLegacyAllocationMode=%RTbool fBoundMemoryMode=%RTbool\n", pGMM, pGMM->fLegacyAllocationMode, pGMM->fBoundMemoryMode));
             return VINF_SUCCESS;
@@ -856,6 +962,12 @@ GMMR0DECL(void) GMMR0Term(void)
     /* Free any chunks still hanging around. */
     RTAvlU32Destroy(&pGMM->pChunks, gmmR0TermDestroyChunk, pGMM);
 
+#ifdef VBOX_WITH_PAGE_SHARING
+    /* The page fusion trees. */
+    gmmR0FusionResetTree(&pGMM->Fusion.pStableTree, &pGMM->Fusion.cStableNodes);
+    gmmR0FusionResetTree(&pGMM->Fusion.pUnstableTree, &pGMM->Fusion.cUnstableNodes);
+#endif
+
     /* Destroy the chunk locks. */
     for (unsigned iMtx = 0; iMtx < RT_ELEMENTS(pGMM->aChunkMtx); iMtx++)
     {
@@ -1154,17 +1266,52 @@ static int gmmR0ChunkMutexDropGiant(PGMMR0CHUNKMTXSTATE pMtxState)
 
 
 /**
- * For experimenting with NUMA affinity and such.
+ * Gets the NUMA node of the CPU we're currently running on.
  *
- * @returns The current NUMA Node ID.
+ * The thread may of course be rescheduled onto a different node right after
+ * this call, so it's just a hint.
+ *
+ * @returns The current NUMA Node ID, GMM_CHUNK_NUMA_ID_UNKNOWN if it is too
+ *          high for us to keep track of.
  */
 static uint16_t gmmR0GetCurrentNumaNodeId(void)
 {
-#if 1
-    return GMM_CHUNK_NUMA_ID_UNKNOWN;
-#else
-    return RTMpCpuId() / 16;
-#endif
+    uint32_t const idNode = RTMpCpuIdToNumaNode(RTMpCpuId());
+    return idNode < GMM_MAX_NUMA_NODES ? (uint16_t)idNode : GMM_CHUNK_NUMA_ID_UNKNOWN;
+}
+
+
+/**
+ * Gets the NUMA nodes the VM should allocate pages from.
+ *
+ * @returns Mask of the allowed nodes.  UINT64_MAX if any node will do.
+ * @param   pGVM            Pointer to the global VM structure.
+ * @param   pfPreferred     Where to return the subset of nodes to try first.
+ */
+static uint64_t gmmR0GetNumaNodeMask(PGVM pGVM, uint64_t *pfPreferred)
+{
+    uint16_t const idNode = gmmR0GetCurrentNumaNodeId();
+    uint64_t const fLocal = idNode < GMM_MAX_NUMA_NODES ? RT_BIT_64(idNode) : 0;
+    uint64_t       fNodes = pGVM->gmm.s.fNumaNodeMask;
+    if (!fNodes)
+        fNodes = fLocal ? fLocal : UINT64_MAX;
+    *pfPreferred = fNodes & fLocal ? fLocal : fNodes;
+    return fNodes;
+}
+
+
+/**
+ * Checks if a chunk resides on one of the given NUMA nodes.
+ *
+ * @returns true if it does, false if not.
+ * @param   pChunk          The chunk.
+ * @param   fNodeMask       The node mask, see gmmR0GetNumaNodeMask.
+ */
+DECLINLINE(bool) gmmR0IsChunkOnNodes(PGMMCHUNK pChunk, uint64_t fNodeMask)
+{
+    if (pChunk->idNumaNode < GMM_MAX_NUMA_NODES)
+        return RT_BOOL(fNodeMask & RT_BIT_64(pChunk->idNumaNode));
+    return fNodeMask == UINT64_MAX;
 }
 
 
@@ -1208,6 +1355,10 @@ GMMR0DECL(void) GMMR0CleanupVM(PGVM pGVM)
          */
         Assert(pGMM->cRegisteredVMs);
         pGMM->cRegisteredVMs--;
+        if (pGMM->Fusion.pConfigSession == pGVM->pVM->pSession)
+            pGMM->Fusion.pConfigSession = NULL;
+        if (!pGMM->cRegisteredVMs)
+            pGMM->Fusion.cNsBudget = GMM_FUSION_DEFAULT_BUDGET_NS;
 
         /*
          * Walk the entire pool looking for pages that belong to this VM
@@ -1541,7 +1692,8 @@ GMMR0DECL(int) GMMR0InitialReservation(PVM pVM, VMCPUID idCpu, uint64_t cBasePag
                 pGVM->gmm.s.Stats.fMayAllocate          = true;
 
                 pGMM->cReservedPages += cBasePages + cFixedPages + cShadowPages;
-                pGMM->cRegisteredVMs++;
+                if (!pGMM->cRegisteredVMs++)
+                    pGMM->Fusion.pConfigSession = pVM->pSession;
             }
         }
         else
@@ -1836,6 +1988,8 @@ DECLINLINE(void) gmmR0UnlinkChunk(PGMMCHUNK pChunk)
     {
         pSet->cFreePages -= pChunk->cFree;
         pSet->idGeneration++;
+        if (pChunk->idNumaNode < GMM_MAX_NUMA_NODES)
+            g_pGMM->aNumaNodes[pChunk->idNumaNode].cFreePages -= pChunk->cFree;
 
         PGMMCHUNK pPrev = pChunk->pFreePrev;
         PGMMCHUNK pNext = pChunk->pFreeNext;
@@ -1885,6 +2039,8 @@ DECLINLINE(void) gmmR0LinkChunk(PGMMCHUNK pChunk, PGMMCHUNKFREESET pSet)
 
         pSet->cFreePages += pChunk->cFree;
         pSet->idGeneration++;
+        if (pChunk->idNumaNode < GMM_MAX_NUMA_NODES)
+            g_pGMM->aNumaNodes[pChunk->idNumaNode].cFreePages += pChunk->cFree;
     }
 }
 
@@ -2106,6 +2262,8 @@ static int gmmR0RegisterChunk(PGMM pGMM, PGMMCHUNKFREESET pSet, RTR0MEMOBJ MemOb
                     &&  RTAvlU32Insert(&pGMM->pChunks, &pChunk->Core))
                 {
                     pGMM->cChunks++;
+                    if (pChunk->idNumaNode < GMM_MAX_NUMA_NODES)
+                        pGMM->aNumaNodes[pChunk->idNumaNode].cChunks++;
                     RTListAppend(&pGMM->ChunkList, &pChunk->ListNode);
                     gmmR0LinkChunk(pChunk, pSet);
                     LogFlow(("gmmR0RegisterChunk: pChunk=%p id=%#x cChunks=%d\n", pChunk, pChunk->Core.Key, pGMM->cChunks));
@@ -2211,27 +2369,27 @@ static uint32_t gmmR0AllocatePagesIndiscriminately(PGMMCHUNKFREESET pSet, PGVM p
 
 
 /**
- * Pick pages from empty chunks on the same NUMA node.
+ * Pick pages from empty chunks on the given NUMA nodes.
  *
  * @returns The new page descriptor table index.
  * @param   pSet                The set to pick from.
  * @param   pGVM                Pointer to the global VM structure.
+ * @param   fNodeMask           The NUMA nodes, see gmmR0GetNumaNodeMask.
  * @param   iPage               The current page descriptor table index.
  * @param   cPages              The total number of pages to allocate.
  * @param   paPages             The page descriptor table (input + ouput).
  */
-static uint32_t gmmR0AllocatePagesFromEmptyChunksOnSameNode(PGMMCHUNKFREESET pSet, PGVM pGVM,
-                                                            uint32_t iPage, uint32_t cPages, PGMMPAGEDESC paPages)
+static uint32_t gmmR0AllocatePagesFromEmptyChunksOnNodes(PGMMCHUNKFREESET pSet, PGVM pGVM, uint64_t fNodeMask,
+                                                         uint32_t iPage, uint32_t cPages, PGMMPAGEDESC paPages)
 {
     PGMMCHUNK pChunk = pSet->apLists[GMM_CHUNK_FREE_SET_UNUSED_LIST];
     if (pChunk)
     {
-        uint16_t const idNumaNode = gmmR0GetCurrentNumaNodeId();
         while (pChunk)
         {
             PGMMCHUNK pNext = pChunk->pFreeNext;
 
-            if (pChunk->idNumaNode == idNumaNode)
+            if (gmmR0IsChunkOnNodes(pChunk, fNodeMask))
             {
                 pChunk->hGVM = pGVM->hSelf;
                 iPage = gmmR0AllocatePagesFromChunk(pChunk, pGVM->hSelf, iPage, cPages, paPages);
@@ -2250,21 +2408,21 @@ static uint32_t gmmR0AllocatePagesFromEmptyChunksOnSameNode(PGMMCHUNKFREESET pSe
 
 
 /**
- * Pick pages from non-empty chunks on the same NUMA node.
+ * Pick pages from non-empty chunks on the given NUMA nodes.
  *
  * @returns The new page descriptor table index.
  * @param   pSet                The set to pick from.
  * @param   pGVM                Pointer to the global VM structure.
+ * @param   fNodeMask           The NUMA nodes, see gmmR0GetNumaNodeMask.
  * @param   iPage               The current page descriptor table index.
  * @param   cPages              The total number of pages to allocate.
  * @param   paPages             The page descriptor table (input + ouput).
  */
-static uint32_t gmmR0AllocatePagesFromSameNode(PGMMCHUNKFREESET pSet, PGVM pGVM,
-                                               uint32_t iPage, uint32_t cPages, PGMMPAGEDESC paPages)
+static uint32_t gmmR0AllocatePagesFromNodes(PGMMCHUNKFREESET pSet, PGVM pGVM, uint64_t fNodeMask,
+                                            uint32_t iPage, uint32_t cPages, PGMMPAGEDESC paPages)
 {
     /** @todo start by picking from chunks with about the right size first?  */
-    uint16_t const  idNumaNode = gmmR0GetCurrentNumaNodeId();
-    unsigned        iList      = GMM_CHUNK_FREE_SET_UNUSED_LIST;
+    unsigned iList = GMM_CHUNK_FREE_SET_UNUSED_LIST;
     while (iList-- > 0)
     {
         PGMMCHUNK pChunk = pSet->apLists[iList];
@@ -2272,7 +2430,7 @@ static uint32_t gmmR0AllocatePagesFromSameNode(PGMMCHUNKFREESET pSet, PGVM pGVM,
         {
             PGMMCHUNK pNext = pChunk->pFreeNext;
 
-            if (pChunk->idNumaNode == idNumaNode)
+            if (gmmR0IsChunkOnNodes(pChunk, fNodeMask))
             {
                 iPage = gmmR0AllocatePagesFromChunk(pChunk, pGVM->hSelf, iPage, cPages, paPages);
                 if (iPage >= cPages)
@@ -2526,18 +2684,30 @@ static int gmmR0AllocatePagesNew(PGMM pGMM, PGVM pGVM, uint32_t cPages, PGMMPAGE
         iPage = gmmR0AllocatePagesAssociatedWithVM(pGMM, pGVM, &pGMM->PrivateX, iPage, cPages, paPages);
         if (iPage < cPages)
         {
+            uint64_t       fPreferredNodes;
+            uint64_t const fNodes = gmmR0GetNumaNodeMask(pGVM, &fPreferredNodes);
+
             /* Maybe we should try getting pages from chunks "belonging" to
                other VMs before allocating more chunks? */
             if (gmmR0ShouldAllocatePagesInOtherChunks(pGVM))
-                iPage = gmmR0AllocatePagesFromSameNode(&pGMM->PrivateX, pGVM, iPage, cPages, paPages);
+                iPage = gmmR0AllocatePagesFromNodes(&pGMM->PrivateX, pGVM, fPreferredNodes, iPage, cPages, paPages);
 
             /* Allocate memory from empty chunks. */
             if (iPage < cPages)
-                iPage = gmmR0AllocatePagesFromEmptyChunksOnSameNode(&pGMM->PrivateX, pGVM, iPage, cPages, paPages);
+                iPage = gmmR0AllocatePagesFromEmptyChunksOnNodes(&pGMM->PrivateX, pGVM, fPreferredNodes, iPage, cPages, paPages);
 
             /* Grab empty shared chunks. */
             if (iPage < cPages)
-                iPage = gmmR0AllocatePagesFromEmptyChunksOnSameNode(&pGMM->Shared, pGVM, iPage, cPages, paPages);
+                iPage = gmmR0AllocatePagesFromEmptyChunksOnNodes(&pGMM->Shared, pGVM, fPreferredNodes, iPage, cPages, paPages);
+
+            /* The other nodes the VM may use, before allocating new chunks
+               on the current node. */
+            if (iPage < cPages && fPreferredNodes != fNodes)
+            {
+                iPage = gmmR0AllocatePagesFromEmptyChunksOnNodes(&pGMM->PrivateX, pGVM, fNodes, iPage, cPages, paPages);
+                if (iPage < cPages)
+                    iPage = gmmR0AllocatePagesFromEmptyChunksOnNodes(&pGMM->Shared, pGVM, fNodes, iPage, cPages, paPages);
+            }
 
             /*
              * Ok, try allocate new chunks.
@@ -3181,6 +3351,8 @@ static bool gmmR0FreeChunk(PGMM pGMM, PGVM pGVM, PGMMCHUNK pChunk, bool fRelaxed
 
     Assert(pGMM->cChunks > 0);
     pGMM->cChunks--;
+    if (pChunk->idNumaNode < GMM_MAX_NUMA_NODES)
+        pGMM->aNumaNodes[pChunk->idNumaNode].cChunks--;
 
     /*
      * Free the Chunk ID before dropping the locks and freeing the rest.
@@ -3249,6 +3421,8 @@ static void gmmR0FreePageWorker(PGMM pGMM, PGVM pGVM, PGMMCHUNK pChunk, uint32_t
     {
         pChunk->cFree = cFree + 1;
         pChunk->pSet->cFreePages++;
+        if (pChunk->idNumaNode < GMM_MAX_NUMA_NODES)
+            pGMM->aNumaNodes[pChunk->idNumaNode].cFreePages++;
     }
 
     /*
@@ -4181,6 +4355,46 @@ GMMR0DECL(int) GMMR0SeedChunk(PVM pVM, VMCPUID idCpu, RTR3PTR pvR3)
     return rc;
 }
 
+
+/**
+ * Sets the host NUMA nodes the VM should allocate its memory from.
+ *
+ * See @ref sec_gmm_numa for how this is applied.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   idCpu           The VCPU id.
+ * @param   fNodeMask       Mask of the allowed nodes, bit N for node N.  0
+ *                          means the node of the CPU the allocating EMT is
+ *                          running on (default).
+ */
+GMMR0DECL(int) GMMR0SetNumaPolicy(PVM pVM, VMCPUID idCpu, uint64_t fNodeMask)
+{
+    LogFlow(("GMMR0SetNumaPolicy: pVM=%p fNodeMask=%#RX64\n", pVM, fNodeMask));
+
+    /*
+     * Validate input and get the basics.
+     */
+    PGMM pGMM;
+    GMM_GET_VALID_INSTANCE(pGMM, VERR_GMM_INSTANCE);
+    PGVM pGVM;
+    int rc = GVMMR0ByVMAndEMT(pVM, idCpu, &pGVM);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    uint64_t const fValidNodes = pGMM->cNumaNodes < 64 ? RT_BIT_64(pGMM->cNumaNodes) - 1 : UINT64_MAX;
+    AssertMsgReturn(!(fNodeMask & ~fValidNodes), ("%#RX64 (cNumaNodes=%u)\n", fNodeMask, pGMM->cNumaNodes),
+                    VERR_INVALID_PARAMETER);
+
+    rc = gmmR0MutexAcquire(pGMM);
+    if (RT_SUCCESS(rc))
+    {
+        pGVM->gmm.s.fNumaNodeMask = fNodeMask;
+        gmmR0MutexRelease(pGMM);
+    }
+    return rc;
+}
+
 #ifdef VBOX_WITH_PAGE_SHARING
 
 # ifdef VBOX_STRICT
@@ -5127,6 +5341,347 @@ GMMR0DECL(int) GMMR0CheckSharedModules(PVM pVM, PVMCPU pVCpu)
 #endif
 }
 
+#ifdef VBOX_WITH_PAGE_SHARING
+
+/**
+ * RTAvllU32Destroy callback for gmmR0FusionResetTree.
+ *
+ * @returns 0
+ * @param   pNode       The node to destroy.
+ * @param   pvUser      Ignored.
+ */
+static DECLCALLBACK(int) gmmR0FusionDestroyNode(PAVLLU32NODECORE pNode, void *pvUser)
+{
+    NOREF(pvUser);
+    RTMemFree(pNode);
+    return 0;
+}
+
+
+/**
+ * Empties one of the page fusion trees.
+ *
+ * @param   ppTree      The tree.
+ * @param   pcNodes     The node count of the tree.
+ */
+static void gmmR0FusionResetTree(PPAVLLU32NODECORE ppTree, uint32_t *pcNodes)
+{
+    RTAvllU32Destroy(ppTree, gmmR0FusionDestroyNode, NULL);
+    *pcNodes = 0;
+}
+
+
+/**
+ * Inserts a node into one of the page fusion trees, emptying it first if it
+ * has grown too big.
+ *
+ * @param   ppTree      The tree.
+ * @param   pcNodes     The node count of the tree.
+ * @param   cMaxNodes   The max number of nodes in the tree.
+ * @param   pNode       The node.
+ * @param   uCrc        The CRC-32 of the page content.
+ * @param   idPage      The page ID.
+ */
+static void gmmR0FusionInsertNode(PPAVLLU32NODECORE ppTree, uint32_t *pcNodes, uint32_t cMaxNodes,
+                                  PGMMFUSIONNODE pNode, uint32_t uCrc, uint32_t idPage)
+{
+    if (*pcNodes >= cMaxNodes)
+    {
+        Log(("gmmR0FusionInsertNode: %u nodes, starting over\n", *pcNodes));
+        gmmR0FusionResetTree(ppTree, pcNodes);
+    }
+    pNode->Core.Key = uCrc;
+    pNode->idPage   = idPage;
+    RTAvllU32Insert(ppTree, &pNode->Core);
+    (*pcNodes)++;
+}
+
+
+/**
+ * Maps a page read-only into kernel space for comparing it.
+ *
+ * This doesn't touch the user mappings of the chunk, so it works the same for
+ * the pages of all VMs.
+ *
+ * @returns VBox status code.
+ * @param   pGMM        Pointer to the GMM instance data.
+ * @param   idPage      The page ID.
+ * @param   phMapObj    Where to return the mapping object to pass to
+ *                      gmmR0FusionUnmapPage.  NIL if the chunk has a kernel
+ *                      mapping of its own.
+ * @param   ppbPage     Where to return the address.
+ */
+static int gmmR0FusionMapPage(PGMM pGMM, uint32_t idPage, PRTR0MEMOBJ phMapObj, uint8_t const **ppbPage)
+{
+    *phMapObj = NIL_RTR0MEMOBJ;
+    PGMMCHUNK pChunk = gmmR0GetChunk(pGMM, idPage >> GMM_CHUNKID_SHIFT);
+    AssertMsgReturn(pChunk, ("idPage=%#x\n", idPage), VERR_PGM_PHYS_INVALID_PAGE_ID);
+    size_t const offPage = (size_t)(idPage & GMM_PAGEID_IDX_MASK) << PAGE_SHIFT;
+
+    uint8_t const *pbChunk = (uint8_t const *)RTR0MemObjAddress(pChunk->hMemObj);
+    if (pbChunk)
+    {
+        *ppbPage = pbChunk + offPage;
+        return VINF_SUCCESS;
+    }
+
+    /* The chunks are normally allocated without a kernel mapping. */
+    int rc = RTR0MemObjMapKernelEx(phMapObj, pChunk->hMemObj, (void *)-1, 0 /*uAlignment*/, RTMEM_PROT_READ,
+                                   offPage, PAGE_SIZE);
+    if (RT_FAILURE(rc))
+    {
+        *phMapObj = NIL_RTR0MEMOBJ;
+        return rc;
+    }
+    *ppbPage = (uint8_t const *)RTR0MemObjAddress(*phMapObj);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Undoes gmmR0FusionMapPage.
+ *
+ * @param   hMapObj     The mapping object returned by gmmR0FusionMapPage.
+ */
+static void gmmR0FusionUnmapPage(RTR0MEMOBJ hMapObj)
+{
+    if (hMapObj != NIL_RTR0MEMOBJ)
+    {
+        int rc = RTR0MemObjFree(hMapObj, false /* fFreeMappings (NA) */);
+        AssertRC(rc);
+    }
+}
+
+
+/**
+ * Compares a page with the one we're checking.
+ *
+ * @returns true if identical, false if not or if it can't be mapped.
+ * @param   pGMM        Pointer to the GMM instance data.
+ * @param   idPage      The page ID.
+ * @param   pbPage      The page we're checking (mapped).
+ */
+static bool gmmR0FusionIsSamePage(PGMM pGMM, uint32_t idPage, uint8_t const *pbPage)
+{
+    RTR0MEMOBJ     hMapObj;
+    uint8_t const *pbOther;
+    int rc = gmmR0FusionMapPage(pGMM, idPage, &hMapObj, &pbOther);
+    if (RT_FAILURE(rc))
+        return false;
+    bool const fSame = !memcmp(pbOther, pbPage, PAGE_SIZE);
+    gmmR0FusionUnmapPage(hMapObj);
+    return fSame;
+}
+
+
+/**
+ * Worker for GMMR0PageFusionCheckPage that does the lookups once the page has
+ * been mapped.
+ *
+ * @returns VBox status code.
+ * @param   pGMM        Pointer to the GMM instance data.
+ * @param   pGVM        Pointer to the GVM instance data.
+ * @param   pPageDesc   The page descriptor, see GMMR0PageFusionCheckPage.
+ * @param   idPage      The page ID.
+ * @param   pPage       The page.
+ * @param   pbPage      The page content (mapped).
+ * @param   phMapObj    The mapping of the page.  Unmapped and set to NIL
+ *                      before the page is freed.
+ */
+static int gmmR0FusionCheckMappedPage(PGMM pGMM, PGVM pGVM, PGMMSHAREDPAGEDESC pPageDesc, uint32_t idPage, PGMMPAGE pPage,
+                                      uint8_t const *pbPage, PRTR0MEMOBJ phMapObj)
+{
+    int            rc;
+    uint32_t const uCrc = RTCrc32(pbPage, PAGE_SIZE);
+
+    /*
+     * Is there a shared page with the same content already?
+     */
+    PGMMFUSIONNODE pNode = (PGMMFUSIONNODE)RTAvllU32Get(&pGMM->Fusion.pStableTree, uCrc);
+    while (pNode)
+    {
+        PGMMFUSIONNODE pNext   = (PGMMFUSIONNODE)pNode->Core.pList;
+        PGMMPAGE       pShared = gmmR0GetPage(pGMM, pNode->idPage);
+        if (!pShared || !GMM_PAGE_IS_SHARED(pShared))
+        {
+            /* Freed since, forget it. */
+            RTAvllU32RemoveNode(&pGMM->Fusion.pStableTree, &pNode->Core);
+            pGMM->Fusion.cStableNodes--;
+            RTMemFree(pNode);
+        }
+        else if (   pShared->Shared.cRefs < GMM_FUSION_MAX_REFS
+                 && gmmR0FusionIsSamePage(pGMM, pNode->idPage, pbPage))
+        {
+            Log(("GMMR0PageFusionCheckPage: %RGp: %#x -> shared %#x\n", pPageDesc->GCPhys, idPage, pNode->idPage));
+            gmmR0FusionUnmapPage(*phMapObj); /* The chunk may go away with the page. */
+            *phMapObj = NIL_RTR0MEMOBJ;
+
+            GMMFREEPAGEDESC PageDesc;
+            PageDesc.idPage = idPage;
+            rc = gmmR0FreePages(pGMM, pGVM, 1, &PageDesc, GMMACCOUNT_BASE);
+            AssertRCReturn(rc, rc);
+
+            gmmR0UseSharedPage(pGMM, pGVM, pShared);
+            pGMM->Fusion.cSavedPages++;
+
+            pPageDesc->HCPhys = (RTHCPHYS)pShared->Shared.pfn << PAGE_SHIFT;
+            pPageDesc->idPage = pNode->idPage;
+#ifdef VBOX_STRICT
+            pPageDesc->u32StrictChecksum = uCrc;
+#endif
+            return VINF_SUCCESS;
+        }
+        pNode = pNext;
+    }
+
+    /*
+     * Did an earlier scan come across a private page with the same content?
+     * If so, our page becomes the shared copy for the owner of that one to
+     * pick up on its next scan.
+     */
+    pNode = (PGMMFUSIONNODE)RTAvllU32Get(&pGMM->Fusion.pUnstableTree, uCrc);
+    while (pNode)
+    {
+        PGMMFUSIONNODE pNext = (PGMMFUSIONNODE)pNode->Core.pList;
+        if (pNode->idPage == idPage)
+            return VINF_SUCCESS; /* Unchanged since the last scan, still no match. */
+
+        PGMMPAGE pOther = gmmR0GetPage(pGMM, pNode->idPage);
+        if (!pOther || !GMM_PAGE_IS_PRIVATE(pOther))
+        {
+            RTAvllU32RemoveNode(&pGMM->Fusion.pUnstableTree, &pNode->Core);
+            pGMM->Fusion.cUnstableNodes--;
+            RTMemFree(pNode);
+        }
+        else if (gmmR0FusionIsSamePage(pGMM, pNode->idPage, pbPage))
+        {
+            Log(("GMMR0PageFusionCheckPage: %RGp: %#x -> shared (same as %#x)\n", pPageDesc->GCPhys, idPage, pNode->idPage));
+            RTAvllU32RemoveNode(&pGMM->Fusion.pUnstableTree, &pNode->Core);
+            pGMM->Fusion.cUnstableNodes--;
+
+            gmmR0ConvertToSharedPage(pGMM, pGVM, pPageDesc->HCPhys, idPage, pPage, pPageDesc);
+            gmmR0FusionInsertNode(&pGMM->Fusion.pStableTree, &pGMM->Fusion.cStableNodes, GMM_FUSION_MAX_STABLE_NODES,
+                                  pNode, uCrc, idPage);
+            pGMM->Fusion.cSharedPages++;
+
+            pPageDesc->idPage = idPage;
+            return VINF_SUCCESS;
+        }
+        pNode = pNext;
+    }
+
+    /*
+     * Remember it for later.
+     */
+    pNode = (PGMMFUSIONNODE)RTMemAlloc(sizeof(*pNode));
+    if (pNode)
+        gmmR0FusionInsertNode(&pGMM->Fusion.pUnstableTree, &pGMM->Fusion.cUnstableNodes, GMM_FUSION_MAX_UNSTABLE_NODES,
+                              pNode, uCrc, idPage);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks a private page for identical pages elsewhere, see
+ * @ref sec_gmm_fusion.
+ *
+ * @remarks ASSUMES the caller has acquired the GMM semaphore!!
+ *
+ * @returns VBox status code.
+ * @param   pGVM                Pointer to the GVM instance data.
+ * @param   pPageDesc           The page descriptor.  On return idPage is
+ *                              NIL_GMM_PAGEID if nothing changed.  Otherwise
+ *                              the page has become a shared one and idPage
+ *                              and HCPhys tell which.
+ */
+GMMR0DECL(int) GMMR0PageFusionCheckPage(PGVM pGVM, PGMMSHAREDPAGEDESC pPageDesc)
+{
+    PGMM pGMM;
+    GMM_GET_VALID_INSTANCE(pGMM, VERR_GMM_INSTANCE);
+    uint32_t const idPage = pPageDesc->idPage;
+    pPageDesc->idPage            = NIL_GMM_PAGEID;
+    pPageDesc->u32StrictChecksum = 0;
+
+    PGMMPAGE pPage = gmmR0GetPage(pGMM, idPage);
+    AssertMsgReturn(pPage && GMM_PAGE_IS_PRIVATE(pPage) && pPage->Private.hGVM == pGVM->hSelf,
+                    ("idPage=%#x (GCPhys=%RGp HCPhys=%RHp)\n", idPage, pPageDesc->GCPhys, pPageDesc->HCPhys),
+                    VERR_PGM_PHYS_INVALID_PAGE_ID);
+    pGMM->Fusion.cScannedPages++;
+
+    RTR0MEMOBJ     hMapObj;
+    uint8_t const *pbPage;
+    int rc = gmmR0FusionMapPage(pGMM, idPage, &hMapObj, &pbPage);
+    AssertRCReturn(rc, rc);
+    rc = gmmR0FusionCheckMappedPage(pGMM, pGVM, pPageDesc, idPage, pPage, pbPage, &hMapObj);
+    gmmR0FusionUnmapPage(hMapObj);
+    return rc;
+}
+
+#endif /* VBOX_WITH_PAGE_SHARING */
+
+/**
+ * Scans a slice of the guest RAM of the specified VM for pages identical to
+ * pages in the same or other VMs, see @ref sec_gmm_fusion.
+ *
+ * The scan is cut short when the host wide CPU budget runs out.
+ *
+ * @returns VBox status code.
+ * @param   pVM                 Pointer to the VM.
+ * @param   pVCpu               Pointer to the VMCPU.
+ * @param   cMaxPages           The max number of pages to check.
+ */
+GMMR0DECL(int) GMMR0PageFusionScan(PVM pVM, PVMCPU pVCpu, uint32_t cMaxPages)
+{
+#ifdef VBOX_WITH_PAGE_SHARING
+    /*
+     * Validate input and get the basics.
+     */
+    PGMM pGMM;
+    GMM_GET_VALID_INSTANCE(pGMM, VERR_GMM_INSTANCE);
+    PGVM pGVM;
+    int rc = GVMMR0ByVMAndEMT(pVM, pVCpu->idCpu, &pGVM);
+    if (RT_FAILURE(rc))
+        return rc;
+    if (pGMM->fLegacyAllocationMode)
+        return VERR_NOT_SUPPORTED;
+
+    /*
+     * Take the semaphore and do some more validations.
+     */
+    gmmR0MutexAcquire(pGMM);
+    if (GMM_CHECK_SANITY_UPON_ENTERING(pGMM))
+    {
+        /*
+         * Work out how much of the budget for this second is left.
+         */
+        uint64_t const u64Start = RTTimeSystemNanoTS();
+        if (u64Start - pGMM->Fusion.u64PeriodStartNS >= RT_NS_1SEC)
+        {
+            pGMM->Fusion.u64PeriodStartNS = u64Start;
+            pGMM->Fusion.cNsSpent         = 0;
+        }
+        if (pGMM->Fusion.cNsSpent < pGMM->Fusion.cNsBudget)
+        {
+            uint64_t const cNsSlice = RT_MIN(pGMM->Fusion.cNsBudget - pGMM->Fusion.cNsSpent, GMM_FUSION_MAX_SLICE_NS);
+            rc = PGMR0PageFusionScan(pVM, pGVM, pVCpu->idCpu, cMaxPages, u64Start + cNsSlice);
+            pGMM->Fusion.cNsSpent += RTTimeSystemNanoTS() - u64Start;
+        }
+        else
+            Log(("GMMR0PageFusionScan: out of budget (%RU64 ns)\n", pGMM->Fusion.cNsSpent));
+
+        GMM_CHECK_SANITY_UPON_LEAVING(pGMM);
+    }
+    else
+        rc = VERR_GMM_IS_NOT_SANE;
+
+    gmmR0MutexRelease(pGMM);
+    return rc;
+#else
+    NOREF(pVM); NOREF(pVCpu); NOREF(cMaxPages);
+    return VERR_NOT_IMPLEMENTED;
+#endif
+}
+
 #if defined(VBOX_STRICT) && HC_ARCH_BITS == 64
 
 /**
@@ -5300,7 +5855,13 @@ GMMR0DECL(int) GMMR0QueryStatistics(PGMMSTATS pStats, PSUPDRVSESSION pSession, P
     pStats->cChunks                     = pGMM->cChunks;
     pStats->cFreedChunks                = pGMM->cFreedChunks;
     pStats->cShareableModules           = pGMM->cShareableModules;
-    RT_ZERO(pStats->au64Reserved);
+    pStats->cFusionScannedPages         = pGMM->Fusion.cScannedPages;
+    pStats->cFusionSharedPages          = pGMM->Fusion.cSharedPages;
+    pStats->cFusionSavedPages           = pGMM->Fusion.cSavedPages;
+    pStats->cNumaNodes                  = pGMM->cNumaNodes;
+    pStats->u32Padding                  = 0;
+    AssertCompile(sizeof(pStats->aNumaNodes) == sizeof(pGMM->aNumaNodes));
+    memcpy(pStats->aNumaNodes, pGMM->aNumaNodes, sizeof(pStats->aNumaNodes));
 
     /*
      * Copy out the VM statistics.
@@ -5369,3 +5930,85 @@ GMMR0DECL(int) GMMR0ResetStatisticsReq(PVM pVM, PGMMRESETSTATISTICSSREQ pReq)
     return GMMR0ResetStatistics(&pReq->Stats, pReq->pSession, pVM);
 }
 
+
+/**
+ * A quick hack for setting global config values.
+ *
+ * @returns VBox status code.
+ *
+ * @param   pSession    The session handle. Used for authentication.
+ * @param   pszName     The variable name.
+ * @param   u64Value    The new value.
+ */
+GMMR0DECL(int) GMMR0SetConfig(PSUPDRVSESSION pSession, const char *pszName, uint64_t u64Value)
+{
+    /*
+     * Validate input.
+     */
+    PGMM pGMM;
+    GMM_GET_VALID_INSTANCE(pGMM, VERR_GMM_INSTANCE);
+    AssertPtrReturn(pSession, VERR_INVALID_HANDLE);
+    AssertPtrReturn(pszName, VERR_INVALID_POINTER);
+
+    /*
+     * String switch time!
+     */
+    if (strncmp(pszName, "/GMM/", sizeof("/GMM/") - 1))
+        return VERR_CFGM_VALUE_NOT_FOUND; /* borrow status codes from CFGM... */
+    int rc = VINF_SUCCESS;
+    pszName += sizeof("/GMM/") - 1;
+    if (!strcmp(pszName, "PageFusionBudget"))
+    {
+        /* Host wide, so only the owner of the first VM gets to change it. */
+        if (u64Value <= RT_NS_1SEC)
+        {
+            gmmR0MutexAcquire(pGMM);
+            if (pSession == pGMM->Fusion.pConfigSession)
+                pGMM->Fusion.cNsBudget = u64Value;
+            else
+                rc = VERR_ACCESS_DENIED;
+            gmmR0MutexRelease(pGMM);
+        }
+        else
+            rc = VERR_OUT_OF_RANGE;
+    }
+    else
+        rc = VERR_CFGM_VALUE_NOT_FOUND;
+    return rc;
+}
+
+
+/**
+ * A quick hack for getting global config values.
+ *
+ * @returns VBox status code.
+ *
+ * @param   pSession    The session handle. Used for authentication.
+ * @param   pszName     The variable name.
+ * @param   pu64Value   Where to return the value.
+ */
+GMMR0DECL(int) GMMR0QueryConfig(PSUPDRVSESSION pSession, const char *pszName, uint64_t *pu64Value)
+{
+    /*
+     * Validate input.
+     */
+    PGMM pGMM;
+    GMM_GET_VALID_INSTANCE(pGMM, VERR_GMM_INSTANCE);
+    AssertPtrReturn(pSession, VERR_INVALID_HANDLE);
+    AssertPtrReturn(pszName, VERR_INVALID_POINTER);
+    AssertPtrReturn(pu64Value, VERR_INVALID_POINTER);
+
+    /*
+     * String switch time!
+     */
+    if (strncmp(pszName, "/GMM/", sizeof("/GMM/") - 1))
+        return VERR_CFGM_VALUE_NOT_FOUND; /* borrow status codes from CFGM... */
+    int rc = VINF_SUCCESS;
+    pszName += sizeof("/GMM/") - 1;
+    if (!strcmp(pszName, "PageFusionBudget"))
+        *pu64Value = pGMM->Fusion.cNsBudget;
+    else
+        rc = VERR_CFGM_VALUE_NOT_FOUND;
+    return rc;
+}
+
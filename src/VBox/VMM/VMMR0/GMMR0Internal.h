@@ -81,6 +81,9 @@ typedef struct GMMPERVM
     PAVLGCPTRNODECORE   pSharedModuleTree;
     /** Hints at the last chunk we allocated some memory from. */
     uint32_t            idLastChunkHint;
+    /** The host NUMA nodes to allocate memory from, 0 for the node the
+     * allocating EMT is running on.  See GMMR0SetNumaPolicy. */
+    uint64_t            fNumaNodeMask;
 } GMMPERVM;
 /** Pointer to the per-VM GMM data. */
 typedef GMMPERVM *PGMMPERVM;
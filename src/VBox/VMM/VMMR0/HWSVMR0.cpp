@@ -1201,6 +1201,8 @@ VMMR0DECL(int) SVMR0RunGuestCode(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx)
 ResumeExecution:
     if (!STAM_PROFILE_ADV_IS_RUNNING(&pVCpu->hwaccm.s.StatEntry))
         STAM_PROFILE_ADV_STOP_START(&pVCpu->hwaccm.s.StatExit2, &pVCpu->hwaccm.s.StatEntry, x);
+    hwaccmR0ExitHistStop(&pVCpu->hwaccm.s);
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_HM_RESUME, 0, 0, 0);
     Assert(!HWACCMR0SuspendPending());
 
     /*
@@ -1769,6 +1771,11 @@ ResumeExecution:
     else
         STAM_COUNTER_INC(&pVCpu->hwaccm.s.paStatExitReasonR0[exitCode & MASK_EXITREASON_STAT]);
 #endif
+    /* SVM_EXIT_INVALID masks to the #NPF slot too, so anything else not below it goes untimed. */
+    if (exitCode == SVM_EXIT_NPF)
+        hwaccmR0ExitHistStart(&pVCpu->hwaccm.s, HWACCM_EXIT_HIST_SVM_NPF);
+    else if (exitCode < HWACCM_EXIT_HIST_SVM_NPF)
+        hwaccmR0ExitHistStart(&pVCpu->hwaccm.s, exitCode);
 
     /* Sync back the TPR if it was changed. */
     if (fSyncTPR)
@@ -1802,6 +1809,7 @@ ResumeExecution:
     VBOXVMM_R0_HMSVM_VMEXIT(pVCpu, pCtx, exitCode, pVMCB->ctrl.u64ExitInfo1, pVMCB->ctrl.u64ExitInfo2,
                             pVMCB->ctrl.ExitIntInfo.au64[0], UINT64_MAX);
 #endif
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_HM_EXIT, (uint32_t)exitCode, pCtx->rip, pVMCB->ctrl.u64ExitInfo1);
     STAM_PROFILE_ADV_STOP_START(&pVCpu->hwaccm.s.StatExit1, &pVCpu->hwaccm.s.StatExit2, x);
 
     /* Deal with the reason of the VM-exit. */
@@ -2784,6 +2792,7 @@ end:
     STAM_PROFILE_ADV_STOP(&pVCpu->hwaccm.s.StatExit2, x);
     STAM_PROFILE_ADV_STOP(&pVCpu->hwaccm.s.StatExit1, x);
     STAM_PROFILE_ADV_STOP(&pVCpu->hwaccm.s.StatEntry, x);
+    hwaccmR0ExitHistStop(&pVCpu->hwaccm.s);
     return VBOXSTRICTRC_TODO(rc);
 }
 
@@ -2873,6 +2873,8 @@ VMMR0DECL(int) VMXR0RunGuestCode(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx)
 ResumeExecution:
     if (!STAM_REL_PROFILE_ADV_IS_RUNNING(&pVCpu->hwaccm.s.StatEntry))
         STAM_REL_PROFILE_ADV_STOP_START(&pVCpu->hwaccm.s.StatExit2, &pVCpu->hwaccm.s.StatEntry, x);
+    hwaccmR0ExitHistStop(&pVCpu->hwaccm.s);
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_HM_RESUME, 0, 0, 0);
     AssertMsg(pVCpu->hwaccm.s.idEnteredCpu == RTMpCpuId(),
               ("Expected %d, I'm %d; cResume=%d exitReason=%RGv exitQualification=%RGv\n",
                (int)pVCpu->hwaccm.s.idEnteredCpu, (int)RTMpCpuId(), cResume, exitReason, exitQualification));
@@ -3268,6 +3270,7 @@ ResumeExecution:
     /* Investigate why there was a VM-exit. */
     rc2  = VMXReadCachedVMCS(VMX_VMCS32_RO_EXIT_REASON, &exitReason);
     STAM_COUNTER_INC(&pVCpu->hwaccm.s.paStatExitReasonR0[exitReason & MASK_EXITREASON_STAT]);
+    hwaccmR0ExitHistStart(&pVCpu->hwaccm.s, exitReason);
 
     exitReason &= 0xffff;   /* bit 0-15 contain the exit code. */
     rc2 |= VMXReadCachedVMCS(VMX_VMCS32_RO_VM_INSTR_ERROR, &instrError);
@@ -3291,6 +3294,7 @@ ResumeExecution:
 #if ARCH_BITS == 64 /* for the time being */
     VBOXVMM_R0_HMVMX_VMEXIT(pVCpu, pCtx, exitReason);
 #endif
+    DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_HM_EXIT, (uint32_t)exitReason, pCtx->rip, exitQualification);
 
     /*
      * Check if an injected event was interrupted prematurely.
@@ -4894,6 +4898,7 @@ end:
     STAM_PROFILE_ADV_STOP(&pVCpu->hwaccm.s.StatExit2, x);
     STAM_PROFILE_ADV_STOP(&pVCpu->hwaccm.s.StatExit1, x);
     STAM_PROFILE_ADV_STOP(&pVCpu->hwaccm.s.StatEntry, x);
+    hwaccmR0ExitHistStop(&pVCpu->hwaccm.s);
     Log2(("X"));
     return VBOXSTRICTRC_TODO(rc);
 }
@@ -28,9 +28,68 @@
 #include <VBox/err.h>
 #include <iprt/assert.h>
 #include <iprt/mem.h>
+#include <iprt/time.h>
 
 
 #ifdef VBOX_WITH_PAGE_SHARING
+/**
+ * Updates a page after GMM has either replaced it by an existing shared
+ * version of it or converted it into a read-only shared page.
+ *
+ * The PGM lock shall be taken prior to calling this method.
+ *
+ * @param   pVM                 Pointer to the VM.
+ * @param   pVCpu               Pointer to the VMCPU of the calling EMT.
+ * @param   pPage               The page.
+ * @param   pPageDesc           The page descriptor GMM returned.
+ * @param   pfFlushTLBs         Where to indicate that the TLBs must be flushed.
+ *                              Not touched if not necessary.
+ */
+static void pgmR0SharedPageUpdate(PVM pVM, PVMCPU pVCpu, PPGMPAGE pPage, PGMMSHAREDPAGEDESC pPageDesc, bool *pfFlushTLBs)
+{
+    Assert(PGM_PAGE_GET_STATE(pPage) == PGM_PAGE_STATE_ALLOCATED);
+
+# ifdef PGM_WITH_LARGE_PAGES
+    /* Shared pages cannot be part of a large page. */
+    if (   PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE
+        || PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+        pgmPhysDemoteLargePage(pVM, pPageDesc->GCPhys, pfFlushTLBs);
+# endif
+
+    /* Clear all references to the page. */
+    bool fFlush = false;
+    int rc = pgmPoolTrackUpdateGCPhys(pVM, pPageDesc->GCPhys, pPage, true /* clear the entries */, &fFlush);
+    Assert(   rc == VINF_SUCCESS
+           || (   VMCPU_FF_ISSET(pVCpu, VMCPU_FF_PGM_SYNC_CR3)
+               && (pVCpu->pgm.s.fSyncFlags & PGM_SYNC_CLEAR_PGM_POOL)));
+    if (rc == VINF_SUCCESS && fFlush)
+        *pfFlushTLBs = true;
+    NOREF(pVCpu);
+
+    if (pPageDesc->HCPhys != PGM_PAGE_GET_HCPHYS(pPage))
+    {
+        /* Update the physical address and page id now. */
+        PGM_PAGE_SET_HCPHYS(pVM, pPage, pPageDesc->HCPhys);
+        PGM_PAGE_SET_PAGEID(pVM, pPage, pPageDesc->idPage);
+
+        /* Invalidate page map TLB entry for this page too. */
+        pgmPhysInvalidatePageMapTLBEntry(pVM, pPageDesc->GCPhys);
+        pVM->pgm.s.cReusedSharedPages++;
+    }
+    /* else: nothing changed (== this page is now a shared
+       page), so no need to flush anything. */
+
+    pVM->pgm.s.cSharedPages++;
+    pVM->pgm.s.cPrivatePages--;
+    PGM_PAGE_SET_STATE(pVM, pPage, PGM_PAGE_STATE_SHARED);
+
+# ifdef VBOX_STRICT /* check sum hack */
+    pPage->s.u2Unused0 = pPageDesc->u32StrictChecksum        & 3;
+    pPage->s.u2Unused1 = (pPageDesc->u32StrictChecksum >> 8) & 3;
+# endif
+}
+
+
 /**
  * Check a registered module for shared page changes.
  *
@@ -96,44 +155,10 @@ VMMR0DECL(int) PGMR0SharedModuleCheck(PVM pVM, PGVM pGVM, VMCPUID idCpu, PGMMSHA
                      */
                     if (PageDesc.idPage != NIL_GMM_PAGEID)
                     {
-                        Assert(PGM_PAGE_GET_STATE(pPage) == PGM_PAGE_STATE_ALLOCATED);
-
                         Log(("PGMR0SharedModuleCheck: shared page gst virt=%RGv phys=%RGp host %RHp->%RHp\n",
                              GCPtrPage, PageDesc.GCPhys, PGM_PAGE_GET_HCPHYS(pPage), PageDesc.HCPhys));
-
-                        /* Page was either replaced by an existing shared
-                           version of it or converted into a read-only shared
-                           page, so, clear all references. */
-                        bool fFlush = false;
-                        rc = pgmPoolTrackUpdateGCPhys(pVM, PageDesc.GCPhys, pPage, true /* clear the entries */, &fFlush);
-                        Assert(   rc == VINF_SUCCESS
-                               || (   VMCPU_FF_ISSET(pVCpu, VMCPU_FF_PGM_SYNC_CR3)
-                                   && (pVCpu->pgm.s.fSyncFlags & PGM_SYNC_CLEAR_PGM_POOL)));
-                        if (rc == VINF_SUCCESS)
-                            fFlushTLBs |= fFlush;
+                        pgmR0SharedPageUpdate(pVM, pVCpu, pPage, &PageDesc, &fFlushTLBs);
                         fFlushRemTLBs = true;
-
-                        if (PageDesc.HCPhys != PGM_PAGE_GET_HCPHYS(pPage))
-                        {
-                            /* Update the physical address and page id now. */
-                            PGM_PAGE_SET_HCPHYS(pVM, pPage, PageDesc.HCPhys);
-                            PGM_PAGE_SET_PAGEID(pVM, pPage, PageDesc.idPage);
-
-                            /* Invalidate page map TLB entry for this page too. */
-                            pgmPhysInvalidatePageMapTLBEntry(pVM, PageDesc.GCPhys);
-                            pVM->pgm.s.cReusedSharedPages++;
-                        }
-                        /* else: nothing changed (== this page is now a shared
-                           page), so no need to flush anything. */
-
-                        pVM->pgm.s.cSharedPages++;
-                        pVM->pgm.s.cPrivatePages--;
-                        PGM_PAGE_SET_STATE(pVM, pPage, PGM_PAGE_STATE_SHARED);
-
-# ifdef VBOX_STRICT /* check sum hack */
-                        pPage->s.u2Unused0 = PageDesc.u32StrictChecksum        & 3;
-                        pPage->s.u2Unused1 = (PageDesc.u32StrictChecksum >> 8) & 3;
-# endif
                     }
                 }
             }
@@ -165,5 +190,111 @@ VMMR0DECL(int) PGMR0SharedModuleCheck(PVM pVM, PGVM pGVM, VMCPUID idCpu, PGMMSHA
 
     return rc;
 }
+
+/**
+ * Scans the next slice of guest RAM for pages that can be fused with identical
+ * pages of this or other VMs, see @ref sec_gmm_fusion.
+ *
+ * The PGM lock shall be taken prior to calling this method.  The scan resumes
+ * where the previous one stopped and wraps around at the end of the RAM.
+ *
+ * @returns VBox status code.
+ * @param   pVM                 Pointer to the VM.
+ * @param   pGVM                Pointer to the GVM instance data.
+ * @param   idCpu               The ID of the calling virtual CPU.
+ * @param   cMaxPages           The max number of pages to look at.
+ * @param   u64Deadline         The RTTimeSystemNanoTS timestamp to stop at.
+ */
+VMMR0DECL(int) PGMR0PageFusionScan(PVM pVM, PGVM pGVM, VMCPUID idCpu, uint32_t cMaxPages, uint64_t u64Deadline)
+{
+    PVMCPU              pVCpu         = &pVM->aCpus[idCpu];
+    int                 rc            = VINF_SUCCESS;
+    bool                fFlushTLBs    = false;
+    bool                fFlushRemTLBs = false;
+    bool                fStop         = false;
+    uint32_t            cPages        = 0;
+    RTGCPHYS            GCPhys        = pVM->pgm.s.GCPhysPageFusionCursor;
+    GMMSHAREDPAGEDESC   PageDesc;
+
+    PGM_LOCK_ASSERT_OWNER(pVM);     /* pgmR3PageFusionScanRendezvous grabs it before calling into ring-0. */
+
+    /*
+     * Find the RAM range to continue in.
+     */
+    PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR0;
+    while (pRam && GCPhys > pRam->GCPhysLast)
+        pRam = pRam->pNextR0;
+
+    while (pRam && !fStop)
+    {
+        uint32_t const  cRamPages = (uint32_t)(pRam->cb >> PAGE_SHIFT);
+        uint32_t        iPage     = GCPhys > pRam->GCPhys ? (uint32_t)((GCPhys - pRam->GCPhys) >> PAGE_SHIFT) : 0;
+        if (!PGM_RAM_RANGE_IS_AD_HOC(pRam))
+        {
+            for (; iPage < cRamPages; iPage++)
+            {
+                if (    cPages >= cMaxPages
+                    ||  (   !(cPages & 63)
+                         && RTTimeSystemNanoTS() >= u64Deadline))
+                {
+                    fStop = true;
+                    break;
+                }
+                cPages++;
+
+                /* Only plain RAM pages that nobody else cares about. */
+                PPGMPAGE pPage = &pRam->aPages[iPage];
+                if (    PGM_PAGE_GET_TYPE(pPage) == PGMPAGETYPE_RAM
+                    &&  PGM_PAGE_GET_STATE(pPage) == PGM_PAGE_STATE_ALLOCATED
+                    &&  PGM_PAGE_GET_PDE_TYPE(pPage) != PGM_PAGE_PDE_TYPE_PDE
+                    &&  !PGM_PAGE_HAS_ANY_HANDLERS(pPage)
+                    &&  PGM_PAGE_GET_READ_LOCKS(pPage) == 0
+                    &&  PGM_PAGE_GET_WRITE_LOCKS(pPage) == 0)
+                {
+                    PageDesc.idPage = PGM_PAGE_GET_PAGEID(pPage);
+                    PageDesc.HCPhys = PGM_PAGE_GET_HCPHYS(pPage);
+                    PageDesc.GCPhys = pRam->GCPhys + ((RTGCPHYS)iPage << PAGE_SHIFT);
+
+                    rc = GMMR0PageFusionCheckPage(pGVM, &PageDesc);
+                    if (RT_FAILURE(rc))
+                    {
+                        iPage++;    /* don't get stuck on it */
+                        fStop = true;
+                        break;
+                    }
+
+                    if (PageDesc.idPage != NIL_GMM_PAGEID)
+                    {
+                        Log(("PGMR0PageFusionScan: fused page phys=%RGp host %RHp->%RHp\n",
+                             PageDesc.GCPhys, PGM_PAGE_GET_HCPHYS(pPage), PageDesc.HCPhys));
+                        pgmR0SharedPageUpdate(pVM, pVCpu, pPage, &PageDesc, &fFlushTLBs);
+                        fFlushRemTLBs = true;
+                    }
+                }
+            }
+        }
+
+        if (fStop)
+            GCPhys = pRam->GCPhys + ((RTGCPHYS)iPage << PAGE_SHIFT);
+        else
+        {
+            pRam   = pRam->pNextR0;
+            GCPhys = pRam ? pRam->GCPhys : 0;
+        }
+    }
+    pVM->pgm.s.GCPhysPageFusionCursor = pRam ? GCPhys : 0;
+
+    /*
+     * Do TLB flushing if necessary.
+     */
+    if (fFlushTLBs)
+        PGM_INVL_ALL_VCPU_TLBS(pVM);
+
+    if (fFlushRemTLBs)
+        for (VMCPUID idCurCpu = 0; idCurCpu < pVM->cCpus; idCurCpu++)
+            CPUMSetChangedFlags(&pVM->aCpus[idCurCpu], CPUM_CHANGED_GLOBAL_TLB_FLUSH);
+
+    return rc;
+}
 #endif /* VBOX_WITH_PAGE_SHARING */
 
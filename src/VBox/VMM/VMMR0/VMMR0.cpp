@@ -37,6 +37,7 @@
 #include <VBox/vmm/gmm.h>
 #include <VBox/intnet.h>
 #include <VBox/vmm/hwaccm.h>
+#include <VBox/vmm/iom.h>
 #include <VBox/param.h>
 #include <VBox/err.h>
 #include <VBox/version.h>
@@ -537,6 +538,8 @@ static void vmmR0RecordRC(PVM pVM, PVMCPU pVCpu, int rc)
             switch (pVCpu->vmm.s.enmCallRing3Operation)
             {
                 case VMMCALLRING3_PDM_CRIT_SECT_ENTER:
+                case VMMCALLRING3_PDM_CRIT_SECT_RW_ENTER_EXCL:
+                case VMMCALLRING3_PDM_CRIT_SECT_RW_ENTER_SHARED:
                     STAM_COUNTER_INC(&pVM->vmm.s.StatRZCallPDMCritSectEnter);
                     break;
                 case VMMCALLRING3_PDM_LOCK:
@@ -1072,6 +1075,13 @@ static int vmmR0EntryExWorker(PVM pVM, VMCPUID idCpu, VMMR0OPERATION enmOperatio
                 return VERR_INVALID_PARAMETER;
             return GMMR0SeedChunk(pVM, idCpu, (RTR3PTR)u64Arg);
 
+        case VMMR0_DO_GMM_SET_NUMA_POLICY:
+            if (idCpu == NIL_VMCPUID)
+                return VERR_INVALID_CPU_ID;
+            if (pReqHdr)
+                return VERR_INVALID_PARAMETER;
+            return GMMR0SetNumaPolicy(pVM, idCpu, u64Arg);
+
         case VMMR0_DO_GMM_REGISTER_SHARED_MODULE:
             if (idCpu == NIL_VMCPUID)
                 return VERR_INVALID_CPU_ID;
@@ -1122,6 +1132,19 @@ static int vmmR0EntryExWorker(PVM pVM, VMCPUID idCpu, VMMR0OPERATION enmOperatio
 # endif
             return rc;
         }
+
+        case VMMR0_DO_GMM_PAGE_FUSION_SCAN:
+        {
+            if (idCpu == NIL_VMCPUID)
+                return VERR_INVALID_CPU_ID;
+            if (    u64Arg > UINT32_MAX
+                ||  pReqHdr)
+                return VERR_INVALID_PARAMETER;
+
+            PVMCPU pVCpu = &pVM->aCpus[idCpu];
+            Assert(pVCpu->hNativeThreadR0 == RTThreadNativeSelf());
+            return GMMR0PageFusionScan(pVM, pVCpu, (uint32_t)u64Arg);
+        }
 #endif
 
 #if defined(VBOX_STRICT) && HC_ARCH_BITS == 64
@@ -1153,18 +1176,20 @@ static int vmmR0EntryExWorker(PVM pVM, VMCPUID idCpu, VMMR0OPERATION enmOperatio
             PGCFGMVALUEREQ pReq = (PGCFGMVALUEREQ)pReqHdr;
             if (pReq->Hdr.cbReq != sizeof(*pReq))
                 return VERR_INVALID_PARAMETER;
+            if (!vmmR0IsValidSession(pVM, pReq->pSession, pSession))
+                return VERR_INVALID_PARAMETER; /* GMMR0SetConfig authenticates by session. */
             int rc;
             if (enmOperation == VMMR0_DO_GCFGM_SET_VALUE)
             {
                 rc = GVMMR0SetConfig(pReq->pSession, &pReq->szName[0], pReq->u64Value);
-                //if (rc == VERR_CFGM_VALUE_NOT_FOUND)
-                //    rc = GMMR0SetConfig(pReq->pSession, &pReq->szName[0], pReq->u64Value);
+                if (rc == VERR_CFGM_VALUE_NOT_FOUND)
+                    rc = GMMR0SetConfig(pReq->pSession, &pReq->szName[0], pReq->u64Value);
             }
             else
             {
                 rc = GVMMR0QueryConfig(pReq->pSession, &pReq->szName[0], &pReq->u64Value);
-                //if (rc == VERR_CFGM_VALUE_NOT_FOUND)
-                //    rc = GMMR0QueryConfig(pReq->pSession, &pReq->szName[0], &pReq->u64Value);
+                if (rc == VERR_CFGM_VALUE_NOT_FOUND)
+                    rc = GMMR0QueryConfig(pReq->pSession, &pReq->szName[0], &pReq->u64Value);
             }
             return rc;
         }
@@ -1267,6 +1292,39 @@ static int vmmR0EntryExWorker(PVM pVM, VMCPUID idCpu, VMMR0OPERATION enmOperatio
                 return VERR_INVALID_CPU_ID;
             return HWACCMR0TestSwitcher3264(pVM);
 #endif
+
+        /*
+         * For measuring transition costs, see VMMDoTransitionBenchmark.
+         */
+        case VMMR0_DO_TEST_CALL_RING3:
+        {
+            if (idCpu == NIL_VMCPUID)
+                return VERR_INVALID_CPU_ID;
+            if (pReqHdr)
+                return VERR_INVALID_PARAMETER;
+            PVMCPU pVCpu = &pVM->aCpus[idCpu];
+            if (!pVCpu->vmm.s.CallRing3JmpBufR0.pvSavedStack)
+                return VERR_NOT_SUPPORTED;
+            for (uint64_t i = 0; i < u64Arg; i++)
+            {
+                int rc = VMMRZCallRing3(pVM, pVCpu, VMMCALLRING3_VM_R0_PREEMPT, 0);
+                if (RT_FAILURE(rc))
+                    return rc;
+            }
+            return VINF_SUCCESS;
+        }
+
+        case VMMR0_DO_TEST_IO_PORT_READ:
+        {
+            if (idCpu == NIL_VMCPUID)
+                return VERR_INVALID_CPU_ID;
+            if (pReqHdr || u64Arg > UINT16_MAX)
+                return VERR_INVALID_PARAMETER;
+            uint32_t u32Value;
+            VBOXSTRICTRC rcStrict = IOMIOPortRead(pVM, (RTIOPORT)u64Arg, &u32Value, 1);
+            return VBOXSTRICTRC_TODO(rcStrict);
+        }
+
         default:
             /*
              * We're returning VERR_NOT_SUPPORT here so we've got something else
@@ -1344,6 +1402,8 @@ VMMR0DECL(int) VMMR0EntryEx(PVM pVM, VMCPUID idCpu, VMMR0OPERATION enmOperation,
             /* On the mac we might not have a valid jmp buf, so check these as well. */
             case VMMR0_DO_VMMR0_INIT:
             case VMMR0_DO_VMMR0_TERM:
+            /* Makes ring-3 calls. */
+            case VMMR0_DO_TEST_CALL_RING3:
             {
                 PVMCPU pVCpu = &pVM->aCpus[idCpu];
 
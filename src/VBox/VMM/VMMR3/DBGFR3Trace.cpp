@@ -20,6 +20,7 @@
 *   Header Files                                                               *
 *******************************************************************************/
 #define LOG_GROUP LOG_GROUP_DBGF
+#include <iprt/asm-amd64-x86.h> /* for SUPGetCpuHzFromGIP from sup.h */
 #include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/mm.h>
@@ -31,9 +32,14 @@
 #include <VBox/err.h>
 #include <VBox/log.h>
 #include <VBox/param.h>
+#include <VBox/sup.h>
 
+#include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/ctype.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/time.h>
 #include <iprt/trace.h>
 
 
@@ -41,6 +47,7 @@
 *   Internal Functions                                                         *
 *******************************************************************************/
 static DECLCALLBACK(void) dbgfR3TraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
+static DECLCALLBACK(void) dbgfR3TraceBinInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 
 
 /*******************************************************************************
@@ -64,6 +71,28 @@ static const struct
     {  RT_STR_TUPLE("tm"), VMMTPGROUP_TM },
 };
 
+/**
+ * Binary trace event group translation table.
+ */
+static const struct
+{
+    /** The group name. */
+    const char *pszName;
+    /** The name length. */
+    uint32_t    cchName;
+    /** The event mask, RT_BIT_32(DBGFTRACEBINEVT_XXX). */
+    uint32_t    fMask;
+}   g_aTraceBinEvtGroups[] =
+{
+    {  RT_STR_TUPLE("hm"),      RT_BIT_32(DBGFTRACEBINEVT_HM_EXIT)      | RT_BIT_32(DBGFTRACEBINEVT_HM_RESUME) },
+    {  RT_STR_TUPLE("ioport"),  RT_BIT_32(DBGFTRACEBINEVT_IOPORT_READ)  | RT_BIT_32(DBGFTRACEBINEVT_IOPORT_WRITE) },
+    {  RT_STR_TUPLE("mmio"),    RT_BIT_32(DBGFTRACEBINEVT_MMIO_READ)    | RT_BIT_32(DBGFTRACEBINEVT_MMIO_WRITE) },
+    {  RT_STR_TUPLE("irq"),     RT_BIT_32(DBGFTRACEBINEVT_IRQ) },
+    {  RT_STR_TUPLE("timer"),   RT_BIT_32(DBGFTRACEBINEVT_TIMER_FIRE)   | RT_BIT_32(DBGFTRACEBINEVT_TIMER_DONE) },
+    {  RT_STR_TUPLE("disk"),    RT_BIT_32(DBGFTRACEBINEVT_DISK_SUBMIT)  | RT_BIT_32(DBGFTRACEBINEVT_DISK_COMPLETE) },
+    {  RT_STR_TUPLE("net"),     RT_BIT_32(DBGFTRACEBINEVT_NET_XMIT)     | RT_BIT_32(DBGFTRACEBINEVT_NET_RECV) },
+};
+
 
 /**
  * Initializes the tracing.
@@ -129,6 +158,114 @@ static int dbgfR3TraceEnable(PVM pVM, uint32_t cbEntry, uint32_t cEntries)
 }
 
 
+/**
+ * Parses a binary trace event specification.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_NOT_FOUND if a group name is not known.
+ * @param   pszEvents   Space or comma separated event group names, optionally
+ *                      prefixed by '-' to exclude them.  'all' selects all
+ *                      groups.
+ * @param   pfEvents    Where to return the event mask.
+ */
+static int dbgfR3TraceBinParseEvents(const char *pszEvents, uint32_t *pfEvents)
+{
+    uint32_t fEvents = 0;
+    for (;;)
+    {
+        while (RT_C_IS_SPACE(*pszEvents) || *pszEvents == ',')
+            pszEvents++;
+        if (!*pszEvents)
+            break;
+
+        bool const fNo = *pszEvents == '-';
+        if (fNo)
+            pszEvents++;
+        const char *pszName = pszEvents;
+        while (*pszEvents && !RT_C_IS_SPACE(*pszEvents) && *pszEvents != ',')
+            pszEvents++;
+        size_t const cchName = pszEvents - pszName;
+
+        uint32_t fMask = 0;
+        if (cchName == 3 && !strncmp(pszName, "all", 3))
+            fMask = RT_BIT_32(DBGFTRACEBINEVT_END) - 1 - RT_BIT_32(DBGFTRACEBINEVT_INVALID);
+        else
+            for (uint32_t i = 0; i < RT_ELEMENTS(g_aTraceBinEvtGroups); i++)
+                if (   g_aTraceBinEvtGroups[i].cchName == cchName
+                    && !strncmp(g_aTraceBinEvtGroups[i].pszName, pszName, cchName))
+                {
+                    fMask = g_aTraceBinEvtGroups[i].fMask;
+                    break;
+                }
+        if (!fMask)
+            return VERR_NOT_FOUND;
+
+        if (fNo)
+            fEvents &= ~fMask;
+        else
+            fEvents |= fMask;
+    }
+
+    *pfEvents = fEvents;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Allocates the binary trace buffer and enables binary tracing.
+ *
+ * @returns VBox status code
+ * @param   pVM                 Pointer to the VM.
+ * @param   pDbgfNode           The DBGF config node.
+ */
+static int dbgfR3TraceBinEnable(PVM pVM, PCFGMNODE pDbgfNode)
+{
+    uint32_t cRecsPerRing;
+    int rc = CFGMR3QueryU32Def(pDbgfNode, "TraceBinRecords", &cRecsPerRing, 8192);
+    AssertRCReturn(rc, rc);
+    if (cRecsPerRing < 256 || cRecsPerRing > _1M || !RT_IS_POWER_OF_TWO(cRecsPerRing))
+        return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                          "DBGF/TraceBinRecords=%u must be a power of two between 256 and 1M", cRecsPerRing);
+
+    char *pszEvents;
+    rc = CFGMR3QueryStringAllocDef(pDbgfNode, "TraceBinEvents", &pszEvents, "all");
+    AssertRCReturn(rc, rc);
+    uint32_t fEvents;
+    rc = dbgfR3TraceBinParseEvents(pszEvents, &fEvents);
+    if (RT_FAILURE(rc))
+        rc = VMSetError(pVM, rc, RT_SRC_POS, "TraceBinEvents=\"%s\" -> %Rrc", pszEvents, rc);
+    MMR3HeapFree(pszEvents);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /*
+     * One ring per EMT plus a shared one, each starting on a new page so
+     * the EMTs don't share cache lines.
+     */
+    uint32_t const cRings  = pVM->cCpus + 1;
+    uint32_t const cbRing  = RT_ALIGN_32(RT_OFFSETOF(DBGFTRACEBINRING, aRecs[cRecsPerRing]), PAGE_SIZE);
+    size_t const   cbBlock = PAGE_SIZE + (size_t)cbRing * cRings;
+    void *pvBlock;
+    rc = MMR3HyperAllocOnceNoRel(pVM, cbBlock, PAGE_SIZE, MM_TAG_DBGF, &pvBlock);
+    if (RT_FAILURE(rc))
+        return VMSetError(pVM, rc, RT_SRC_POS, "Failed to allocate %zu bytes for the binary trace buffer", cbBlock);
+
+    PDBGFTRACEBIN pTraceBin = (PDBGFTRACEBIN)pvBlock;
+    pTraceBin->u32Magic     = DBGFTRACEBIN_MAGIC;
+    pTraceBin->cRings       = cRings;
+    pTraceBin->cRecsPerRing = cRecsPerRing;
+    pTraceBin->cbRing       = cbRing;
+    pTraceBin->offRings     = PAGE_SIZE;
+    pTraceBin->fEvents      = fEvents;
+
+    pVM->pTraceBinR3 = pTraceBin;
+    pVM->pTraceBinR0 = MMHyperCCToR0(pVM, pTraceBin);
+    pVM->pTraceBinRC = MMHyperCCToRC(pVM, pTraceBin);
+    LogRel(("DBGF: Binary tracing enabled, %u rings of %u records, events %#x\n", cRings, cRecsPerRing, fEvents));
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Initializes the tracing.
  *
@@ -144,6 +281,9 @@ int dbgfR3TraceInit(PVM pVM)
     pVM->hTraceBufR3 = NIL_RTTRACEBUF;
     pVM->hTraceBufRC = NIL_RTRCPTR;
     pVM->hTraceBufR0 = NIL_RTR0PTR;
+    pVM->pTraceBinR3 = NULL;
+    pVM->pTraceBinR0 = NIL_RTR0PTR;
+    pVM->pTraceBinRC = NIL_RTRCPTR;
 
     /*
      * Check the config and enable tracing if requested.
@@ -191,6 +331,21 @@ int dbgfR3TraceInit(PVM pVM)
     if (RT_SUCCESS(rc))
         rc = DBGFR3InfoRegisterInternal(pVM, "tracebuf", "Display the trace buffer content. No arguments.", dbgfR3TraceInfo);
 
+    /*
+     * Binary tracing is independent of the above and disabled by default.
+     */
+    if (RT_SUCCESS(rc))
+    {
+        bool fTraceBin;
+        rc = CFGMR3QueryBoolDef(pDbgfNode, "TraceBin", &fTraceBin, false);
+        AssertRCReturn(rc, rc);
+        if (fTraceBin)
+            rc = dbgfR3TraceBinEnable(pVM, pDbgfNode);
+        if (RT_SUCCESS(rc))
+            rc = DBGFR3InfoRegisterInternal(pVM, "tracebin", "Display the binary trace buffer state. No arguments.",
+                                            dbgfR3TraceBinInfo);
+    }
+
     return rc;
 }
 
@@ -202,8 +357,21 @@ int dbgfR3TraceInit(PVM pVM)
  */
 void dbgfR3TraceTerm(PVM pVM)
 {
-    /* nothing to do */
-    NOREF(pVM);
+    /*
+     * Write the binary trace to DBGF/TraceBinFile if configured.
+     */
+    if (pVM->pTraceBinR3)
+    {
+        char *pszFilename;
+        int rc = CFGMR3QueryStringAlloc(CFGMR3GetChild(CFGMR3GetRoot(pVM), "DBGF"), "TraceBinFile", &pszFilename);
+        if (RT_SUCCESS(rc))
+        {
+            rc = DBGFR3TraceBinDump(pVM, pszFilename);
+            if (RT_FAILURE(rc))
+                LogRel(("DBGF: Failed to write the binary trace to '%s': %Rrc\n", pszFilename, rc));
+            MMR3HeapFree(pszFilename);
+        }
+    }
 }
 
 
@@ -216,6 +384,8 @@ void dbgfR3TraceRelocate(PVM pVM)
 {
     if (pVM->hTraceBufR3 != NIL_RTTRACEBUF)
         pVM->hTraceBufRC = MMHyperCCToRC(pVM, pVM->hTraceBufR3);
+    if (pVM->pTraceBinR3)
+        pVM->pTraceBinRC = MMHyperCCToRC(pVM, pVM->pTraceBinR3);
 }
 
 
@@ -445,3 +615,115 @@ static DECLCALLBACK(void) dbgfR3TraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const cha
     NOREF(pszArgs);
 }
 
+
+/**
+ * Writes the content of the binary trace buffer to a file.
+ *
+ * The file starts with a DBGFTRACEBINFILEHDR followed by the records of each
+ * ring, oldest first.  Recording continues while the file is written, so
+ * records being made at the same time may be torn or missing; suspend the
+ * VM first for an exact snapshot.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_DBGF_NO_TRACE_BUFFER if binary tracing is disabled.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pszFilename The file to write, replaced if it exists.
+ */
+VMMR3DECL(int) DBGFR3TraceBinDump(PVM pVM, const char *pszFilename)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(pszFilename, VERR_INVALID_POINTER);
+    PDBGFTRACEBIN pTraceBin = pVM->pTraceBinR3;
+    if (!pTraceBin)
+        return VERR_DBGF_NO_TRACE_BUFFER;
+
+    /*
+     * Take a snapshot of the ring positions so the header and the records
+     * agree, and figure out how much there is to write.
+     */
+    uint64_t *paiNext = (uint64_t *)RTMemTmpAlloc(sizeof(uint64_t) * pTraceBin->cRings);
+    if (!paiNext)
+        return VERR_NO_TMP_MEMORY;
+
+    DBGFTRACEBINFILEHDR Hdr;
+    RT_ZERO(Hdr);
+    memcpy(Hdr.szMagic, DBGFTRACEBINFILEHDR_MAGIC, sizeof(DBGFTRACEBINFILEHDR_MAGIC));
+    Hdr.uVersion      = DBGFTRACEBINFILEHDR_VERSION;
+    Hdr.cbRec         = sizeof(DBGFTRACEBINREC);
+    Hdr.u64TscHz      = SUPGetCpuHzFromGIP(g_pSUPGlobalInfoPage);
+    Hdr.u64TscDump    = ASMReadTSC();
+    Hdr.u64NanoTSDump = RTTimeNanoTS();
+    Hdr.cCpus         = pVM->cCpus;
+    for (uint32_t iRing = 0; iRing < pTraceBin->cRings; iRing++)
+    {
+        paiNext[iRing] = ASMAtomicReadU64(&DBGFTRACEBIN_RING(pTraceBin, iRing)->iNext);
+        if (paiNext[iRing] > pTraceBin->cRecsPerRing)
+        {
+            Hdr.cRecs     += pTraceBin->cRecsPerRing;
+            Hdr.cRecsLost += paiNext[iRing] - pTraceBin->cRecsPerRing;
+        }
+        else
+            Hdr.cRecs     += (uint32_t)paiNext[iRing];
+    }
+
+    /*
+     * Write it.
+     */
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, pszFilename, RTFILE_O_WRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_WRITE);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTFileWrite(hFile, &Hdr, sizeof(Hdr), NULL);
+        for (uint32_t iRing = 0; iRing < pTraceBin->cRings && RT_SUCCESS(rc); iRing++)
+        {
+            PDBGFTRACEBINRING pRing = DBGFTRACEBIN_RING(pTraceBin, iRing);
+            uint64_t const    iNext = paiNext[iRing];
+            uint32_t const    cRecs = (uint32_t)RT_MIN(iNext, pTraceBin->cRecsPerRing);
+            uint32_t const    iFirst = (uint32_t)(iNext - cRecs) & (pTraceBin->cRecsPerRing - 1);
+            uint32_t const    cFirst = RT_MIN(cRecs, pTraceBin->cRecsPerRing - iFirst);
+            if (cFirst)
+                rc = RTFileWrite(hFile, &pRing->aRecs[iFirst], cFirst * sizeof(DBGFTRACEBINREC), NULL);
+            if (RT_SUCCESS(rc) && cRecs > cFirst)
+                rc = RTFileWrite(hFile, &pRing->aRecs[0], (cRecs - cFirst) * sizeof(DBGFTRACEBINREC), NULL);
+        }
+
+        int rc2 = RTFileClose(hFile);
+        if (RT_SUCCESS(rc))
+            rc = rc2;
+        if (RT_FAILURE(rc))
+            RTFileDelete(pszFilename);
+    }
+
+    RTMemTmpFree(paiNext);
+    return rc;
+}
+
+
+/**
+ * @callback_method_impl{FNDBGFHANDLERINT, Info handler for displaying the binary trace buffer state.}
+ */
+static DECLCALLBACK(void) dbgfR3TraceBinInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    PCDBGFTRACEBIN pTraceBin = pVM->pTraceBinR3;
+    if (!pTraceBin)
+        pHlp->pfnPrintf(pHlp, "Binary tracing is disabled\n");
+    else
+    {
+        pHlp->pfnPrintf(pHlp, "Binary trace buffer %p - %u rings of %u records, events %#x\n",
+                        pTraceBin, pTraceBin->cRings, pTraceBin->cRecsPerRing, pTraceBin->fEvents);
+        for (uint32_t iRing = 0; iRing < pTraceBin->cRings; iRing++)
+        {
+            uint64_t const iNext = ASMAtomicReadU64(&DBGFTRACEBIN_RING(pTraceBin, iRing)->iNext);
+            if (iRing + 1 < pTraceBin->cRings)
+                pHlp->pfnPrintf(pHlp, "  CPU%-3u %'16RU64 records", iRing, iNext);
+            else
+                pHlp->pfnPrintf(pHlp, "  shared %'16RU64 records", iNext);
+            if (iNext > pTraceBin->cRecsPerRing)
+                pHlp->pfnPrintf(pHlp, " (%'RU64 overwritten)\n", iNext - pTraceBin->cRecsPerRing);
+            else
+                pHlp->pfnPrintf(pHlp, "\n");
+        }
+    }
+    NOREF(pszArgs);
+}
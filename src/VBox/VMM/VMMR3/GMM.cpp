@@ -385,6 +385,15 @@ GMMR3DECL(int)  GMMR3SeedChunk(PVM pVM, RTR3PTR pvR3)
 }
 
 
+/**
+ * @see GMMR0SetNumaPolicy
+ */
+GMMR3DECL(int)  GMMR3SetNumaPolicy(PVM pVM, uint64_t fNodeMask)
+{
+    return VMMR3CallR0(pVM, VMMR0_DO_GMM_SET_NUMA_POLICY, fNodeMask, NULL);
+}
+
+
 /**
  * @see GMMR0RegisterSharedModule
  */
@@ -428,6 +437,15 @@ GMMR3DECL(int)  GMMR3CheckSharedModules(PVM pVM)
 }
 
 
+/**
+ * @see GMMR0PageFusionScan
+ */
+GMMR3DECL(int)  GMMR3PageFusionScan(PVM pVM, uint32_t cMaxPages)
+{
+    return VMMR3CallR0(pVM, VMMR0_DO_GMM_PAGE_FUSION_SCAN, cMaxPages, NULL);
+}
+
+
 #if defined(VBOX_STRICT) && HC_ARCH_BITS == 64
 /**
  * @see GMMR0FindDuplicatePage
@@ -52,9 +52,8 @@
 /*******************************************************************************
 *   Global Variables                                                           *
 *******************************************************************************/
-#ifdef VBOX_WITH_STATISTICS
-# define EXIT_REASON(def, val, str) #def " - " #val " - " str
-# define EXIT_REASON_NIL() NULL
+#define EXIT_REASON(def, val, str) #def " - " #val " - " str
+#define EXIT_REASON_NIL() NULL
 /** Exit reason descriptions for VT-x, used to describe statistics. */
 static const char * const g_apszVTxExitReasons[MAX_EXITREASON_STAT] =
 {
@@ -263,9 +262,12 @@ static const char * const g_apszAmdVExitReasons[MAX_EXITREASON_STAT] =
     EXIT_REASON(SVM_EXIT_NPF                        ,1024, "Nested paging: host-level page fault occurred (EXITINFO1 contains fault errorcode; EXITINFO2 contains the guest physical address causing the fault)."),
     EXIT_REASON_NIL()
 };
-# undef EXIT_REASON
-# undef EXIT_REASON_NIL
-#endif /* VBOX_WITH_STATISTICS */
+#undef EXIT_REASON
+#undef EXIT_REASON_NIL
+
+/** Exit cost histogram bucket names, see HWACCMEXITHIST. */
+static const char * const g_apszHwAccmExitHistBuckets[HWACCM_EXIT_HIST_BUCKETS] =
+{ "0-1K", "1K-2K", "2K-4K", "4K-8K", "8K-16K", "16K-32K", "32K-64K", "64K-128K", "128K-256K", "256K-512K", "512K-1M", "1M-inf" };
 
 /*******************************************************************************
 *   Internal Functions                                                         *
@@ -435,6 +437,7 @@ static int hwaccmR3InitCPU(PVM pVM)
         PVMCPU pVCpu = &pVM->aCpus[i];
 
         pVCpu->hwaccm.s.fActive = false;
+        pVCpu->hwaccm.s.uExitHistReason = HWACCM_EXIT_HIST_NONE;
     }
 
 #ifdef VBOX_WITH_STATISTICS
@@ -629,6 +632,50 @@ static int hwaccmR3InitCPU(PVM pVM)
     }
 #endif /* VBOX_WITH_STATISTICS */
 
+    /*
+     * Exit cost histograms.  These cost a TSC read on each exit and resume
+     * and some hyper heap, so they must be enabled explicitly.
+     */
+    bool fExitHistograms;
+    int rc = CFGMR3QueryBoolDef(CFGMR3GetChild(CFGMR3GetRoot(pVM), "HWVirtExt/"), "ExitHistograms", &fExitHistograms, false);
+    AssertRCReturn(rc, rc);
+    if (fExitHistograms)
+    {
+        bool const          fIntel    = ASMIsIntelCpu();
+        const char * const *papszDesc = fIntel ? &g_apszVTxExitReasons[0] : &g_apszAmdVExitReasons[0];
+        for (VMCPUID i = 0; i < pVM->cCpus; i++)
+        {
+            PVMCPU pVCpu = &pVM->aCpus[i];
+
+            rc = MMHyperAlloc(pVM, MAX_EXITREASON_STAT * sizeof(HWACCMEXITHIST), 8, MM_TAG_HWACCM, (void **)&pVCpu->hwaccm.s.paExitHist);
+            AssertRCReturn(rc, rc);
+            for (unsigned j = 0; j < MAX_EXITREASON_STAT; j++)
+            {
+                char        szName[8];
+                const char *pszDesc = papszDesc[j];
+                if (!fIntel && j == HWACCM_EXIT_HIST_SVM_NPF)
+                {
+                    pszDesc = "Nested page fault";
+                    strcpy(szName, "#NPF");
+                }
+                else if (pszDesc)
+                    RTStrPrintf(szName, sizeof(szName), "%02x", j);
+                else
+                    continue;
+
+                PHWACCMEXITHIST pHist = &pVCpu->hwaccm.s.paExitHist[j];
+                STAMR3RegisterF(pVM, &pHist->cTicks, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_TICKS,
+                                pszDesc, "/HWACCM/CPU%d/Exit/Cost/%s/Ticks", i, szName);
+                for (unsigned iBucket = 0; iBucket < HWACCM_EXIT_HIST_BUCKETS; iBucket++)
+                    STAMR3RegisterF(pVM, &pHist->aBuckets[iBucket], STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                                    "Exits handled within this number of ticks.",
+                                    "/HWACCM/CPU%d/Exit/Cost/%s/%s", i, szName, g_apszHwAccmExitHistBuckets[iBucket]);
+            }
+            pVCpu->hwaccm.s.paExitHistR0 = MMHyperR3ToR0(pVM, pVCpu->hwaccm.s.paExitHist);
+            AssertReturn(pVCpu->hwaccm.s.paExitHistR0 != NIL_RTR0PTR, VERR_INTERNAL_ERROR);
+        }
+    }
+
 #ifdef VBOX_WITH_CRASHDUMP_MAGIC
     /* Magic marker for searching in crash dumps. */
     for (VMCPUID i = 0; i < pVM->cCpus; i++)
@@ -1620,6 +1667,13 @@ static int hwaccmR3TermCPU(PVM pVM)
             pVCpu->hwaccm.s.paStatInjectedIrqsR0 = NIL_RTR0PTR;
         }
 #endif
+        if (pVCpu->hwaccm.s.paExitHist)
+        {
+            MMHyperFree(pVM, pVCpu->hwaccm.s.paExitHist);
+            pVCpu->hwaccm.s.paExitHist      = NULL;
+            pVCpu->hwaccm.s.paExitHistR0    = NIL_RTR0PTR;
+            pVCpu->hwaccm.s.uExitHistReason = HWACCM_EXIT_HIST_NONE;
+        }
 
 #ifdef VBOX_WITH_CRASHDUMP_MAGIC
         memset(pVCpu->hwaccm.s.vmx.VMCSCache.aMagic, 0, sizeof(pVCpu->hwaccm.s.vmx.VMCSCache.aMagic));
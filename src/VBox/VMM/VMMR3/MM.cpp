@@ -158,7 +158,10 @@ Hypervisor Memory Area (HMA) Layout: Base 00000000a0000000, 0x00800000 bytes
 #include <VBox/log.h>
 #include <iprt/alloc.h>
 #include <iprt/assert.h>
+#include <iprt/cpuset.h>
+#include <iprt/mp.h>
 #include <iprt/string.h>
+#include <iprt/thread.h>
 
 
 /*******************************************************************************
@@ -286,6 +289,42 @@ VMMR3DECL(int) MMR3Init(PVM pVM)
 }
 
 
+/**
+ * Binds the calling EMT to one of the given host NUMA nodes.
+ *
+ * The vCPUs are spread evenly across the nodes in @a fNodes.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   idCpu       The ID of the calling EMT.
+ * @param   fNodes      The host NUMA nodes to pick from.
+ */
+static DECLCALLBACK(int) mmR3NumaBindEmt(PVM pVM, VMCPUID idCpu, uint64_t fNodes)
+{
+    VM_ASSERT_EMT(pVM);
+    Assert(fNodes);
+    unsigned cNodes = 0;
+    for (uint32_t i = 0; i < 64; i++)
+        if (fNodes & RT_BIT_64(i))
+            cNodes++;
+
+    unsigned iNode  = idCpu * cNodes / pVM->cCpus;
+    uint32_t idNode = 0;
+    for (;; idNode++)
+        if ((fNodes & RT_BIT_64(idNode)) && iNode-- == 0)
+            break;
+
+    RTCPUSET CpuSet;
+    RTMpGetNumaNodeSet(idNode, &CpuSet);
+    if (!RTCpuSetCount(&CpuSet))
+        return VERR_CPU_NOT_FOUND;
+    int rc = RTThreadSetAffinity(&CpuSet);
+    if (RT_SUCCESS(rc))
+        LogRel(("MM: Bound EMT #%u to host NUMA node %u\n", idCpu, idNode));
+    return rc;
+}
+
+
 /**
  * Initializes the MM parts which depends on PGM being initialized.
  *
@@ -385,6 +424,31 @@ VMMR3DECL(int) MMR3InitPaging(PVM pVM)
     else
         AssertMsgFailedReturn(("Configuration error: Failed to query string \"MM/Priority\", rc=%Rrc.\n", rc), rc);
 
+    /** @cfgm{MM/NumaNodeMask, uint64_t, 0}
+     * Mask of the host NUMA nodes the VM memory should be allocated from, bit N
+     * for node N.  The default, 0, means the node of the host CPU the EMT
+     * allocating the memory is running on.  See GMMR3SetNumaPolicy.
+     */
+    uint64_t fNumaNodeMask;
+    rc = CFGMR3QueryU64Def(pMMCfg, "NumaNodeMask", &fNumaNodeMask, 0);
+    AssertLogRelMsgRCReturn(rc, ("Configuration error: Failed to query integer \"MM/NumaNodeMask\", rc=%Rrc.\n", rc), rc);
+
+    /** @cfgm{MM/NumaEmtAffinity, bool, false}
+     * Whether to bind the EMTs to the host NUMA nodes in MM/NumaNodeMask (all
+     * nodes if 0), spreading the vCPUs evenly across them.  Together with
+     * node local allocation this keeps the memory a vCPU touches first close
+     * to it.
+     */
+    bool fNumaEmtAffinity;
+    rc = CFGMR3QueryBoolDef(pMMCfg, "NumaEmtAffinity", &fNumaEmtAffinity, false);
+    AssertLogRelMsgRCReturn(rc, ("Configuration error: Failed to query boolean \"MM/NumaEmtAffinity\", rc=%Rrc.\n", rc), rc);
+
+    uint32_t const cNumaNodes = RT_MIN(RTMpGetNumaNodeCount(), 64);
+    if (fNumaNodeMask & ~(cNumaNodes < 64 ? RT_BIT_64(cNumaNodes) - 1 : UINT64_MAX))
+        return VMSetError(pVM, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                          N_("\"MM/NumaNodeMask\" value %#RX64 refers to host NUMA nodes that don't exist (%u nodes)"),
+                          fNumaNodeMask, cNumaNodes);
+
     /*
      * Make the initial memory reservation with GMM.
      */
@@ -405,6 +469,24 @@ VMMR3DECL(int) MMR3InitPaging(PVM pVM)
                           cbRam >> PAGE_SHIFT, enmOcPolicy, enmPriority);
     }
 
+    /*
+     * Apply the NUMA placement before any guest memory is allocated.
+     */
+    if (fNumaNodeMask)
+    {
+        rc = GMMR3SetNumaPolicy(pVM, fNumaNodeMask);
+        if (RT_FAILURE(rc))
+            return VMSetError(pVM, rc, RT_SRC_POS, "GMMR3SetNumaPolicy(,%#RX64)", fNumaNodeMask);
+    }
+    if (fNumaEmtAffinity && cNumaNodes > 1)
+    {
+        uint64_t const fNodes = fNumaNodeMask ? fNumaNodeMask : cNumaNodes < 64 ? RT_BIT_64(cNumaNodes) - 1 : UINT64_MAX;
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus && RT_SUCCESS(rc); idCpu++)
+            rc = VMR3ReqCallWait(pVM, idCpu, (PFNRT)mmR3NumaBindEmt, 3, pVM, idCpu, fNodes);
+        if (RT_FAILURE(rc))
+            return VMSetError(pVM, rc, RT_SRC_POS, N_("Failed to bind the EMTs to the host NUMA nodes %#RX64"), fNodes);
+    }
+
     /*
      * If RamSize is 0 we're done now.
      */
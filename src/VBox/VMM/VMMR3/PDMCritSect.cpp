@@ -22,6 +22,9 @@
 #define LOG_GROUP LOG_GROUP_PDM//_CRITSECT
 #include "PDMInternal.h"
 #include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/pdmcritsectrw.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/uvm.h>
@@ -32,14 +35,32 @@
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/lockvalidator.h>
+#include <iprt/mem.h>
 #include <iprt/string.h>
 #include <iprt/thread.h>
 
 
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The initial adaptive spin estimate (PDMCRITSECTINT::cSpinEst), 128 loops. */
+#define PDMCRITSECT_SPIN_EST_INIT       (128 << PDMCRITSECT_SPIN_EST_SHIFT)
+
+
 /*******************************************************************************
 *   Internal Functions                                                         *
 *******************************************************************************/
 static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect, PPDMCRITSECTINT pPrev, bool fFinal);
+static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritSect, PPDMCRITSECTRWINT pPrev, bool fFinal);
+static DECLCALLBACK(void) pdmR3CritSectInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/** The names of the wait and hold time histogram buckets. */
+static const char * const g_apszPdmCritSectHistBuckets[PDMCRITSECT_HIST_BUCKETS] =
+{ "0-256", "256-1K", "1K-4K", "4K-16K", "16K-64K", "64K-256K", "256K-1M", "1M-inf" };
 
 
 
@@ -53,10 +74,102 @@ int pdmR3CritSectInitStats(PVM pVM)
 {
     STAM_REG(pVM, &pVM->pdm.s.StatQueuedCritSectLeaves, STAMTYPE_COUNTER, "/PDM/QueuedCritSectLeaves", STAMUNIT_OCCURENCES,
              "Number of times a critical section leave request needed to be queued for ring-3 execution.");
+    DBGFR3InfoRegisterInternal(pVM, "critsects",
+                               "Displays the PDM critical sections, the most contended first. "
+                               "Optional argument: name pattern.",
+                               pdmR3CritSectInfo);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Sets up contention profiling for a new critical section if enabled.
+ *
+ * The profile table is allocated on the hyper heap the first time around,
+ * with room for PDM/CritSectProfiling sections.  Entries of deleted sections
+ * are reused, sections created while the table is full are not profiled.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pCritSect   The critical section.
+ */
+static void pdmR3CritSectProfInit(PVM pVM, PPDMCRITSECTINT pCritSect)
+{
+    pCritSect->iProf = 0;
+    if (!pVM->pdm.s.fCritSectProfQueried)
+    {
+        pVM->pdm.s.fCritSectProfQueried = true;
+
+        /** @cfgm{/PDM/CritSectProfiling, uint32_t, 0}
+         * The number of critical sections to collect contention profiles for,
+         * 0 to disable.  The profiles are shown by the 'critsects' info
+         * handler and under /PDM/CritSects/<name>/Prof in the statistics.
+         * Max 255. */
+        uint32_t cMax;
+        int rc = CFGMR3QueryU32Def(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PDM"), "CritSectProfiling", &cMax, 0);
+        AssertLogRelRCReturnVoid(rc);
+        cMax = RT_MIN(cMax, UINT8_MAX);
+        if (cMax)
+        {
+            PPDMCRITSECTPROF paProfs;
+            rc = MMHyperAlloc(pVM, sizeof(paProfs[0]) * cMax, 0, MM_TAG_PDM, (void **)&paProfs);
+            AssertLogRelRCReturnVoid(rc);
+            pVM->pdm.s.paCritSectProfR3 = paProfs;
+            pVM->pdm.s.paCritSectProfR0 = MMHyperR3ToR0(pVM, paProfs);
+            pVM->pdm.s.paCritSectProfRC = MMHyperR3ToRC(pVM, paProfs);
+            pVM->pdm.s.cCritSectProfMax = cMax;
+            LogRel(("PDM: Profiling up to %u critical sections\n", cMax));
+        }
+    }
+    uint32_t iProf = 0;
+    while (iProf < pVM->pdm.s.cCritSectProf && pVM->pdm.s.paCritSectProfR3[iProf].fInUse)
+        iProf++;
+    if (iProf >= pVM->pdm.s.cCritSectProfMax)
+        return;
+    if (iProf == pVM->pdm.s.cCritSectProf)
+        pVM->pdm.s.cCritSectProf++;
+
+    PPDMCRITSECTPROF pProf = &pVM->pdm.s.paCritSectProfR3[iProf];
+    RT_ZERO(*pProf);
+    pProf->fInUse = true;
+    STAMR3RegisterF(pVM, &pProf->StatSpinHits,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Contended enters getting the section while spinning.", "/PDM/CritSects/%s/Prof/SpinHits", pCritSect->pszName);
+    STAMR3RegisterF(pVM, &pProf->StatSpinMisses, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Contended enters giving up spinning.",                  "/PDM/CritSects/%s/Prof/SpinMisses", pCritSect->pszName);
+    for (unsigned iBucket = 0; iBucket < PDMCRITSECT_HIST_BUCKETS; iBucket++)
+    {
+        STAMR3RegisterF(pVM, &pProf->aStatWaitHist[iBucket], STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                        "Wait time histogram of contended enters (TSC ticks).",
+                        "/PDM/CritSects/%s/Prof/WaitHist/%s", pCritSect->pszName, g_apszPdmCritSectHistBuckets[iBucket]);
+        STAMR3RegisterF(pVM, &pProf->aStatHoldHist[iBucket], STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                        "Hold time histogram (TSC ticks).",
+                        "/PDM/CritSects/%s/Prof/HoldHist/%s", pCritSect->pszName, g_apszPdmCritSectHistBuckets[iBucket]);
+    }
+    pCritSect->iProf = (uint8_t)(iProf + 1);
+}
+
+
+/**
+ * Deregisters the statistics of a critical section's contention profile.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pCritSect   The critical section.
+ */
+static void pdmR3CritSectProfTerm(PVM pVM, PPDMCRITSECTINT pCritSect)
+{
+    if (pCritSect->iProf)
+    {
+        PPDMCRITSECTPROF pProf = &pVM->pdm.s.paCritSectProfR3[pCritSect->iProf - 1];
+        pCritSect->iProf = 0;
+        STAMR3Deregister(pVM, &pProf->StatSpinHits);
+        STAMR3Deregister(pVM, &pProf->StatSpinMisses);
+        for (unsigned iBucket = 0; iBucket < PDMCRITSECT_HIST_BUCKETS; iBucket++)
+        {
+            STAMR3Deregister(pVM, &pProf->aStatWaitHist[iBucket]);
+            STAMR3Deregister(pVM, &pProf->aStatHoldHist[iBucket]);
+        }
+        pProf->fInUse = false;
+    }
+}
+
+
 /**
  * Relocates all the critical sections.
  *
@@ -71,6 +184,12 @@ void pdmR3CritSectRelocate(PVM pVM)
          pCur;
          pCur = pCur->pNext)
         pCur->pVMRC = pVM->pVMRC;
+    for (PPDMCRITSECTRWINT pCur = pUVM->pdm.s.pRwCritSects;
+         pCur;
+         pCur = pCur->pNext)
+        pCur->pVMRC = pVM->pVMRC;
+    if (pVM->pdm.s.paCritSectProfR3)
+        pVM->pdm.s.paCritSectProfRC = MMHyperR3ToRC(pVM, pVM->pdm.s.paCritSectProfR3);
 
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
 }
@@ -104,6 +223,14 @@ VMMDECL(int) PDMR3CritSectTerm(PVM pVM)
             rc = rc2;
     }
 
+    while (pUVM->pdm.s.pRwCritSects)
+    {
+        int rc2 = pdmR3CritSectRwDeleteOne(pVM, pUVM, pUVM->pdm.s.pRwCritSects, NULL, true /* final */);
+        AssertRC(rc2);
+        if (RT_FAILURE(rc2) && RT_SUCCESS(rc))
+            rc = rc2;
+    }
+
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
     return rc;
 }
@@ -166,6 +293,7 @@ static int pdmR3CritSectInitOne(PVM pVM, PPDMCRITSECTINT pCritSect, void *pvKey,
                 pCritSect->pvKey                     = pvKey;
                 pCritSect->fAutomaticDefaultCritsect = false;
                 pCritSect->fUsedByTimerOrSimilar     = false;
+                pCritSect->cSpinEst                  = PDMCRITSECT_SPIN_EST_INIT;
                 pCritSect->EventToSignal             = NIL_RTSEMEVENT;
                 pCritSect->pNext                     = pVM->pUVM->pdm.s.pCritSects;
                 pCritSect->pszName                   = pszName;
@@ -176,6 +304,9 @@ static int pdmR3CritSectInitOne(PVM pVM, PPDMCRITSECTINT pCritSect, void *pvKey,
 #ifdef VBOX_WITH_STATISTICS
                 STAMR3RegisterF(pVM, &pCritSect->StatLocked,        STAMTYPE_PROFILE_ADV, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_OCCURENCE, NULL, "/PDM/CritSects/%s/Locked", pCritSect->pszName);
 #endif
+                STAMR3RegisterF(pVM, (void *)&pCritSect->cSpinEst,    STAMTYPE_U16,     STAMVISIBILITY_ALWAYS, STAMUNIT_NONE,
+                                "The adaptive spin estimate, in 1/8 loops.", "/PDM/CritSects/%s/SpinEstimate", pCritSect->pszName);
+                pdmR3CritSectProfInit(pVM, pCritSect);
                 return VINF_SUCCESS;
             }
 
@@ -283,6 +414,117 @@ int pdmR3CritSectInitDriver(PVM pVM, PPDMDRVINS pDrvIns, PPDMCRITSECT pCritSect,
 }
 
 
+/**
+ * Initializes a read/write critical section and inserts it into the list.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   pCritSect       The read/write critical section.
+ * @param   pvKey           The owner key.
+ * @param   RT_SRC_POS_DECL The source position.
+ * @param   pszNameFmt      Format string for naming the critical section.  For
+ *                          statistics.
+ * @param   va              Arguments for the format string.
+ */
+static int pdmR3CritSectRwInitOne(PVM pVM, PPDMCRITSECTRWINT pCritSect, void *pvKey, RT_SRC_POS_DECL,
+                                  const char *pszNameFmt, va_list va)
+{
+    VM_ASSERT_EMT(pVM);
+    RT_SRC_POS_NOREF();
+
+    /*
+     * Allocate the semaphores.
+     */
+    int rc = SUPSemEventCreate(pVM->pSession, &pCritSect->hEvtWrite);
+    if (RT_SUCCESS(rc))
+    {
+        rc = SUPSemEventMultiCreate(pVM->pSession, &pCritSect->hEvtRead);
+        if (RT_SUCCESS(rc))
+        {
+            /* Only format the name once. */
+            char *pszName = RTStrAPrintf2V(pszNameFmt, va); /** @todo plug the "leak"... */
+            if (pszName)
+            {
+                /*
+                 * Initialize the structure.
+                 */
+                pCritSect->u32Magic             = PDMCRITSECTRW_MAGIC;
+                pCritSect->fNeedReset           = false;
+                pCritSect->u64State             = 0;
+                pCritSect->hNativeWriter        = NIL_RTNATIVETHREAD;
+                pCritSect->cWriterReads         = 0;
+                pCritSect->cWriteRecursions     = 0;
+                pCritSect->pVMR3                = pVM;
+                pCritSect->pVMR0                = pVM->pVMR0;
+                pCritSect->pVMRC                = pVM->pVMRC;
+                pCritSect->pvKey                = pvKey;
+                pCritSect->pNext                = pVM->pUVM->pdm.s.pRwCritSects;
+                pCritSect->pszName              = pszName;
+                pVM->pUVM->pdm.s.pRwCritSects   = pCritSect;
+                STAMR3RegisterF(pVM, &pCritSect->StatContentionRZEnterShared, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, NULL, "/PDM/CritSectsRw/%s/ContentionRZEnterShared", pCritSect->pszName);
+                STAMR3RegisterF(pVM, &pCritSect->StatContentionRZLeaveShared, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, NULL, "/PDM/CritSectsRw/%s/ContentionRZLeaveShared", pCritSect->pszName);
+                STAMR3RegisterF(pVM, &pCritSect->StatContentionR3EnterShared, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, NULL, "/PDM/CritSectsRw/%s/ContentionR3EnterShared", pCritSect->pszName);
+                STAMR3RegisterF(pVM, &pCritSect->StatContentionRZEnterExcl,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, NULL, "/PDM/CritSectsRw/%s/ContentionRZEnterExcl", pCritSect->pszName);
+                STAMR3RegisterF(pVM, &pCritSect->StatContentionRZLeaveExcl,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, NULL, "/PDM/CritSectsRw/%s/ContentionRZLeaveExcl", pCritSect->pszName);
+                STAMR3RegisterF(pVM, &pCritSect->StatContentionR3EnterExcl,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, NULL, "/PDM/CritSectsRw/%s/ContentionR3EnterExcl", pCritSect->pszName);
+#ifdef VBOX_WITH_STATISTICS
+                STAMR3RegisterF(pVM, &pCritSect->StatWriteLocked, STAMTYPE_PROFILE_ADV, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_OCCURENCE, NULL, "/PDM/CritSectsRw/%s/WriteLocked", pCritSect->pszName);
+#endif
+                return VINF_SUCCESS;
+            }
+
+            rc = VERR_NO_STR_MEMORY;
+            SUPSemEventMultiClose(pVM->pSession, pCritSect->hEvtRead);
+        }
+        SUPSemEventClose(pVM->pSession, pCritSect->hEvtWrite);
+    }
+    return rc;
+}
+
+
+/**
+ * Initializes a PDM read/write critical section for internal use.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   pCritSect       Pointer to the read/write critical section.
+ * @param   RT_SRC_POS_DECL Use RT_SRC_POS.
+ * @param   pszNameFmt      Format string for naming the critical section.  For
+ *                          statistics.
+ * @param   ...             Arguments for the format string.
+ * @thread  EMT(0)
+ */
+VMMR3DECL(int) PDMR3CritSectRwInit(PVM pVM, PPDMCRITSECTRW pCritSect, RT_SRC_POS_DECL, const char *pszNameFmt, ...)
+{
+    AssertCompile(sizeof(pCritSect->padding) >= sizeof(pCritSect->s));
+    Assert(RT_ALIGN_P(pCritSect, sizeof(uint64_t)) == pCritSect);
+    va_list va;
+    va_start(va, pszNameFmt);
+    int rc = pdmR3CritSectRwInitOne(pVM, &pCritSect->s, pCritSect, RT_SRC_POS_ARGS, pszNameFmt, va);
+    va_end(va);
+    return rc;
+}
+
+
+/**
+ * Initializes a PDM read/write critical section for a device.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   pDevIns         Device instance.
+ * @param   pCritSect       Pointer to the read/write critical section.
+ * @param   pszNameFmt      Format string for naming the critical section.  For
+ *                          statistics.
+ * @param   va              Arguments for the format string.
+ */
+int pdmR3CritSectRwInitDevice(PVM pVM, PPDMDEVINS pDevIns, PPDMCRITSECTRW pCritSect, RT_SRC_POS_DECL,
+                              const char *pszNameFmt, va_list va)
+{
+    Assert(RT_ALIGN_P(pCritSect, sizeof(uint64_t)) == pCritSect);
+    return pdmR3CritSectRwInitOne(pVM, &pCritSect->s, pDevIns, RT_SRC_POS_ARGS, pszNameFmt, va);
+}
+
+
 /**
  * Deletes one critical section.
  *
@@ -341,6 +583,81 @@ static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect,
         STAMR3Deregister(pVM, &pCritSect->StatContentionR3);
 #ifdef VBOX_WITH_STATISTICS
         STAMR3Deregister(pVM, &pCritSect->StatLocked);
+#endif
+        STAMR3Deregister(pVM, (void *)&pCritSect->cSpinEst);
+        pdmR3CritSectProfTerm(pVM, pCritSect);
+    }
+    pCritSect->iProf = 0;
+    return rc;
+}
+
+
+/**
+ * Deletes one read/write critical section.
+ *
+ * @returns VBox status code.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pCritSect   The read/write critical section.
+ * @param   pPrev       The previous critical section in the list.
+ * @param   fFinal      Set if this is the final call and statistics shouldn't be deregistered.
+ *
+ * @remarks Caller must have entered the ListCritSect.
+ */
+static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritSect, PPDMCRITSECTRWINT pPrev, bool fFinal)
+{
+    /*
+     * Assert free waiters and so on.
+     */
+    Assert(pCritSect->u32Magic == PDMCRITSECTRW_MAGIC);
+    Assert(   (pCritSect->u64State & (PDMCRITSECTRW_CNT_RD_MASK | PDMCRITSECTRW_CNT_WR_MASK)) == 0);
+    Assert(pCritSect->hNativeWriter == NIL_RTNATIVETHREAD);
+    Assert(RTCritSectIsOwner(&pUVM->pdm.s.ListCritSect));
+
+    /*
+     * Unlink it.
+     */
+    if (pPrev)
+        pPrev->pNext = pCritSect->pNext;
+    else
+        pUVM->pdm.s.pRwCritSects = pCritSect->pNext;
+
+    /*
+     * Delete it.  Wake up anyone still waiting, they will notice the magic
+     * change and fail with VERR_SEM_DESTROYED.
+     */
+    ASMAtomicWriteU32(&pCritSect->u32Magic, ~PDMCRITSECTRW_MAGIC);
+    ASMAtomicWriteU64(&pCritSect->u64State, 0);
+
+    SUPSEMEVENT      hEvtWrite = pCritSect->hEvtWrite;
+    SUPSEMEVENTMULTI hEvtRead  = pCritSect->hEvtRead;
+    pCritSect->hEvtWrite = NIL_SUPSEMEVENT;
+    pCritSect->hEvtRead  = NIL_SUPSEMEVENTMULTI;
+    int rc1 = SUPSemEventMultiSignal(pVM->pSession, hEvtRead);
+    int rc2 = SUPSemEventSignal(pVM->pSession, hEvtWrite);
+    AssertRC(rc1); AssertRC(rc2);
+    rc1 = SUPSemEventMultiClose(pVM->pSession, hEvtRead);
+    rc2 = SUPSemEventClose(pVM->pSession, hEvtWrite);
+    AssertRC(rc1); AssertRC(rc2);
+    int rc = RT_SUCCESS(rc1) ? rc2 : rc1;
+
+    pCritSect->pNext   = NULL;
+    pCritSect->pvKey   = NULL;
+    pCritSect->pVMR3   = NULL;
+    pCritSect->pVMR0   = NIL_RTR0PTR;
+    pCritSect->pVMRC   = NIL_RTRCPTR;
+    RTStrFree((char *)pCritSect->pszName);
+    pCritSect->pszName = NULL;
+    if (!fFinal)
+    {
+        STAMR3Deregister(pVM, &pCritSect->StatContentionRZEnterShared);
+        STAMR3Deregister(pVM, &pCritSect->StatContentionRZLeaveShared);
+        STAMR3Deregister(pVM, &pCritSect->StatContentionR3EnterShared);
+        STAMR3Deregister(pVM, &pCritSect->StatContentionRZEnterExcl);
+        STAMR3Deregister(pVM, &pCritSect->StatContentionRZLeaveExcl);
+        STAMR3Deregister(pVM, &pCritSect->StatContentionR3EnterExcl);
+#ifdef VBOX_WITH_STATISTICS
+        STAMR3Deregister(pVM, &pCritSect->StatWriteLocked);
 #endif
     }
     return rc;
@@ -381,6 +698,23 @@ static int pdmR3CritSectDeleteByKey(PVM pVM, void *pvKey)
         pPrev = pCur;
         pCur = pCur->pNext;
     }
+
+    PPDMCRITSECTRWINT pPrevRw = NULL;
+    PPDMCRITSECTRWINT pCurRw  = pUVM->pdm.s.pRwCritSects;
+    while (pCurRw)
+    {
+        PPDMCRITSECTRWINT pNextRw = pCurRw->pNext;
+        if (pCurRw->pvKey == pvKey)
+        {
+            int rc2 = pdmR3CritSectRwDeleteOne(pVM, pUVM, pCurRw, pPrevRw, false /* not final */);
+            AssertRC(rc2);
+            if (RT_FAILURE(rc2) && RT_SUCCESS(rc))
+                rc = rc2;
+        }
+        else
+            pPrevRw = pCurRw;
+        pCurRw = pNextRw;
+    }
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
     return rc;
 }
@@ -467,6 +801,60 @@ VMMR3DECL(const char *) PDMR3CritSectName(PCPDMCRITSECT pCritSect)
 }
 
 
+/**
+ * Deletes the read/write critical section.
+ *
+ * @returns VBox status code.
+ * @param   pCritSect           The PDM read/write critical section to destroy.
+ */
+VMMR3DECL(int) PDMR3CritSectRwDelete(PPDMCRITSECTRW pCritSect)
+{
+    if (!PDMCritSectRwIsInitialized(pCritSect))
+        return VINF_SUCCESS;
+
+    /*
+     * Find and unlink it.
+     */
+    PVM               pVM   = pCritSect->s.pVMR3;
+    AssertReleaseReturn(pVM, VERR_PDM_CRITSECT_IPE);
+    PUVM              pUVM  = pVM->pUVM;
+    PPDMCRITSECTRWINT pPrev = NULL;
+    RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+    PPDMCRITSECTRWINT pCur  = pUVM->pdm.s.pRwCritSects;
+    while (pCur)
+    {
+        if (pCur == &pCritSect->s)
+        {
+            int rc = pdmR3CritSectRwDeleteOne(pVM, pUVM, pCur, pPrev, false /* not final */);
+            RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+            return rc;
+        }
+
+        /* next */
+        pPrev = pCur;
+        pCur = pCur->pNext;
+    }
+    RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+    AssertReleaseMsgFailed(("pCritSect=%p wasn't found!\n", pCritSect));
+    return VERR_PDM_CRITSECT_NOT_FOUND;
+}
+
+
+/**
+ * Gets the name of the read/write critical section.
+ *
+ * @returns Pointer to the critical section name (read only) on success,
+ *          NULL on failure (invalid critical section).
+ * @param   pCritSect           The read/write critical section.
+ */
+VMMR3DECL(const char *) PDMR3CritSectRwName(PCPDMCRITSECTRW pCritSect)
+{
+    AssertPtrReturn(pCritSect, NULL);
+    AssertReturn(pCritSect->s.u32Magic == PDMCRITSECTRW_MAGIC, NULL);
+    return pCritSect->s.pszName;
+}
+
+
 /**
  * Yield the critical section if someone is waiting on it.
  *
@@ -708,3 +1096,146 @@ VMMR3DECL(RCPTRTYPE(PPDMCRITSECT))  PDMR3CritSectGetNopRC(PVM pVM)
     return MMHyperR3ToRC(pVM, &pVM->pdm.s.NopCritSect);
 }
 
+
+/**
+ * Formats a contended call site for the 'critsects' info handler.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   uCaller     The return address.
+ * @param   uCtx        The context, PDMCRITSECT_CTX_XXX.
+ * @param   pszBuf      The output buffer.
+ * @param   cbBuf       The size of the output buffer.
+ */
+static void pdmR3CritSectInfoFormatCaller(PVM pVM, uint64_t uCaller, uint32_t uCtx, char *pszBuf, size_t cbBuf)
+{
+    char    szMod[64];
+    char    szSym[128];
+    char    szSym2[8];
+    int     rc = VERR_NOT_FOUND;
+    if (uCtx == PDMCRITSECT_CTX_R0)
+    {
+        RTR0PTR uMod, uSym, uSym2;
+        rc = PDMR3LdrQueryR0ModFromPC(pVM, (RTR0PTR)uCaller, szMod, sizeof(szMod), &uMod,
+                                      szSym, sizeof(szSym), &uSym, szSym2, sizeof(szSym2), &uSym2);
+        if (RT_SUCCESS(rc))
+            RTStrPrintf(pszBuf, cbBuf, "R0 %RX64 %s!%s+%#x", uCaller, szMod, szSym, (uint32_t)(uCaller - uSym));
+    }
+    else if (uCtx == PDMCRITSECT_CTX_RC)
+    {
+        RTRCPTR uMod, uSym, uSym2;
+        rc = PDMR3LdrQueryRCModFromPC(pVM, (RTRCPTR)uCaller, szMod, sizeof(szMod), &uMod,
+                                      szSym, sizeof(szSym), &uSym, szSym2, sizeof(szSym2), &uSym2);
+        if (RT_SUCCESS(rc))
+            RTStrPrintf(pszBuf, cbBuf, "RC %RX64 %s!%s+%#x", uCaller, szMod, szSym, (uint32_t)(uCaller - uSym));
+    }
+    if (RT_FAILURE(rc))
+        RTStrPrintf(pszBuf, cbBuf, "%s %RX64", uCtx == PDMCRITSECT_CTX_R3 ? "R3" : uCtx == PDMCRITSECT_CTX_R0 ? "R0" : "RC", uCaller);
+}
+
+
+/**
+ * Gets the number of contended enters of a critical section, for sorting.
+ */
+DECLINLINE(uint64_t) pdmR3CritSectInfoContention(PPDMCRITSECTINT pCritSect)
+{
+    return pCritSect->StatContentionR3.c + pCritSect->StatContentionRZLock.c + pCritSect->StatContentionRZUnlock.c;
+}
+
+
+/**
+ * Info handler for 'critsects'.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pHlp        The output helpers.
+ * @param   pszArgs     Optional name pattern.
+ */
+static DECLCALLBACK(void) pdmR3CritSectInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    PUVM pUVM = pVM->pUVM;
+    if (pszArgs)
+        pszArgs = RTStrStripL(pszArgs);
+    if (pszArgs && !*pszArgs)
+        pszArgs = NULL;
+
+    RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+
+    /*
+     * Collect the matching sections and sort them by contention, most first.
+     */
+    uint32_t cCritSects = 0;
+    for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+        cCritSects++;
+    PPDMCRITSECTINT *papCritSects = (PPDMCRITSECTINT *)RTMemTmpAlloc(sizeof(papCritSects[0]) * RT_MAX(cCritSects, 1));
+    if (!papCritSects)
+    {
+        RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+        pHlp->pfnPrintf(pHlp, "Out of memory\n");
+        return;
+    }
+    uint32_t c = 0;
+    for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+    {
+        if (pszArgs && !RTStrSimplePatternMatch(pszArgs, pCur->pszName))
+            continue;
+        uint64_t const cContention = pdmR3CritSectInfoContention(pCur);
+        uint32_t i = c++;
+        while (i > 0 && pdmR3CritSectInfoContention(papCritSects[i - 1]) < cContention)
+        {
+            papCritSects[i] = papCritSects[i - 1];
+            i--;
+        }
+        papCritSects[i] = pCur;
+    }
+
+    /*
+     * Display them.
+     */
+    if (!pVM->pdm.s.cCritSectProfMax)
+        pHlp->pfnPrintf(pHlp, "Set PDM/CritSectProfiling to get wait and hold time histograms and the contended call sites.\n");
+    for (uint32_t i = 0; i < c; i++)
+    {
+        PPDMCRITSECTINT pCritSect = papCritSects[i];
+        pHlp->pfnPrintf(pHlp,
+                        "%s: cLockers=%d cNestings=%d owner=%RTnthrd spin=%u\n"
+                        "    contention: R3=%RU64 RZLock=%RU64 RZUnlock=%RU64\n",
+                        pCritSect->pszName, pCritSect->Core.cLockers, pCritSect->Core.cNestings,
+                        pCritSect->Core.NativeThreadOwner, pCritSect->cSpinEst >> PDMCRITSECT_SPIN_EST_SHIFT,
+                        pCritSect->StatContentionR3.c, pCritSect->StatContentionRZLock.c, pCritSect->StatContentionRZUnlock.c);
+        if (!pCritSect->iProf)
+            continue;
+
+        PPDMCRITSECTPROF pProf = &pVM->pdm.s.paCritSectProfR3[pCritSect->iProf - 1];
+        pHlp->pfnPrintf(pHlp, "    spinning: hits=%RU64 misses=%RU64\n", pProf->StatSpinHits.c, pProf->StatSpinMisses.c);
+        pHlp->pfnPrintf(pHlp, "    %-9s %12s %12s\n", "ticks", "wait", "hold");
+        for (unsigned iBucket = 0; iBucket < PDMCRITSECT_HIST_BUCKETS; iBucket++)
+            pHlp->pfnPrintf(pHlp, "    %-9s %12RU64 %12RU64\n", g_apszPdmCritSectHistBuckets[iBucket],
+                            pProf->aStatWaitHist[iBucket].c, pProf->aStatHoldHist[iBucket].c);
+
+        /* The call sites, most hits first. */
+        unsigned aiCallers[PDMCRITSECT_MAX_CALLERS];
+        unsigned cCallers = 0;
+        for (unsigned iCaller = 0; iCaller < PDMCRITSECT_MAX_CALLERS; iCaller++)
+        {
+            uint32_t const cHits = pProf->aCallers[iCaller].cHits;
+            if (!cHits)
+                continue;
+            unsigned j = cCallers++;
+            while (j > 0 && pProf->aCallers[aiCallers[j - 1]].cHits < cHits)
+            {
+                aiCallers[j] = aiCallers[j - 1];
+                j--;
+            }
+            aiCallers[j] = iCaller;
+        }
+        for (unsigned j = 0; j < cCallers; j++)
+        {
+            char szCaller[256];
+            pdmR3CritSectInfoFormatCaller(pVM, pProf->aCallers[aiCallers[j]].uCaller, pProf->aCallers[aiCallers[j]].uCtx,
+                                          szCaller, sizeof(szCaller));
+            pHlp->pfnPrintf(pHlp, "    %10u  %s\n", pProf->aCallers[aiCallers[j]].cHits, szCaller);
+        }
+    }
+
+    RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+    RTMemTmpFree(papCritSects);
+}
@@ -30,6 +30,7 @@
 # include <VBox/vmm/rem.h>
 #endif
 #include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/vmm.h>
 
@@ -339,6 +340,7 @@ int pdmR3DevInit(PVM pVM)
         //pDevIns->IBase.pfnQueryInterface        = NULL;
         //pDevIns->fTracing                       = 0;
         pDevIns->idTracing                      = ++pVM->pdm.s.idTracingDev;
+        pDevIns->fTraceBinEvents                = pVM->pTraceBinR3 ? pVM->pTraceBinR3->fEvents : 0;
         pDevIns->pvInstanceDataR3               = &pDevIns->achInstanceData[0];
         pDevIns->pvInstanceDataRC               = pDevIns->pReg->fFlags & PDM_DEVREG_FLAGS_RC
                                                 ? MMHyperR3ToRC(pVM, pDevIns->pvInstanceDataR3) : NIL_RTRCPTR;
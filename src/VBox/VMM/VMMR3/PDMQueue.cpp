@@ -40,7 +40,9 @@
 *   Internal Functions                                                         *
 *******************************************************************************/
 DECLINLINE(void)            pdmR3QueueFree(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem);
+DECLINLINE(void)            pdmR3QueueFreeBatch(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem, uint32_t iLane);
 static bool                 pdmR3QueueFlush(PPDMQUEUE pQueue);
+static bool                 pdmR3QueueFlushBatch(PPDMQUEUE pQueue);
 static DECLCALLBACK(void)   pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUser);
 
 
@@ -55,11 +57,12 @@ static DECLCALLBACK(void)   pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUs
  * @param   cMilliesInterval    Number of milliseconds between polling the queue.
  *                              If 0 then the emulation thread will be notified whenever an item arrives.
  * @param   fRZEnabled          Set if the queue will be used from RC/R0 and need to be allocated from the hyper heap.
+ * @param   fBatch              Set if this is a batch queue with per-CPU lanes.
  * @param   pszName             The queue name. Unique. Not copied.
  * @param   ppQueue             Where to store the queue handle.
  */
 static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval, bool fRZEnabled,
-                            const char *pszName, PPDMQUEUE *ppQueue)
+                            bool fBatch, const char *pszName, PPDMQUEUE *ppQueue)
 {
     PUVM pUVM = pVM->pUVM;
 
@@ -73,15 +76,38 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
      * Align the item size and calculate the structure size.
      */
     cbItem = RT_ALIGN(cbItem, sizeof(RTUINTPTR));
-    size_t cb = cbItem * cItems + RT_ALIGN_Z(RT_OFFSETOF(PDMQUEUE, aFreeItems[cItems + PDMQUEUE_FREE_SLACK]), 16);
+    size_t const offItems = RT_ALIGN_Z(RT_OFFSETOF(PDMQUEUE, aFreeItems[cItems + PDMQUEUE_FREE_SLACK]), 16);
+    size_t       cb       = cbItem * cItems + offItems;
+    size_t const offLanes = RT_ALIGN_Z(cb, 64);
+    uint32_t const cLanes = fBatch ? pVM->cCpus + 1 : 0;
+    AssertCompile(VMM_MAX_CPU_COUNT < UINT8_MAX); /* pabBatchLanesR3 */
+    AssertMsgReturn(!fBatch || cItems <= _64K, ("cItems=%u\n", cItems), VERR_OUT_OF_RANGE); /* PDMQUEUELANE::aiCache */
+    if (fBatch)
+        cb = offLanes + cLanes * PDMQUEUE_LANE_STRIDE;
+    AssertReturn(cb < _1G, VERR_OUT_OF_RANGE);
     PPDMQUEUE pQueue;
     int rc;
     if (fRZEnabled)
-        rc = MMHyperAlloc(pVM, cb, 0, MM_TAG_PDM_QUEUE, (void **)&pQueue );
+        rc = MMHyperAlloc(pVM, cb, fBatch ? 64 : 0, MM_TAG_PDM_QUEUE, (void **)&pQueue );
     else
         rc = MMR3HeapAllocZEx(pVM, MM_TAG_PDM_QUEUE, cb, (void **)&pQueue);
     if (RT_FAILURE(rc))
         return rc;
+    if (fBatch)
+    {
+        pQueue->papBatchItemsR3 = (PPDMQUEUEITEMCORE *)MMR3HeapAllocZ(pVM, MM_TAG_PDM_QUEUE, sizeof(PPDMQUEUEITEMCORE) * cItems);
+        pQueue->pabBatchLanesR3 = (uint8_t *)MMR3HeapAllocZ(pVM, MM_TAG_PDM_QUEUE, sizeof(uint8_t) * cItems);
+        if (!pQueue->papBatchItemsR3 || !pQueue->pabBatchLanesR3)
+        {
+            MMR3HeapFree(pQueue->papBatchItemsR3);
+            MMR3HeapFree(pQueue->pabBatchLanesR3);
+            if (fRZEnabled)
+                MMHyperFree(pVM, pQueue);
+            else
+                MMR3HeapFree(pQueue);
+            return VERR_NO_MEMORY;
+        }
+    }
 
     /*
      * Initialize the data fields.
@@ -99,7 +125,12 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
     //pQueue->pPendingRC = NULL;
     pQueue->iFreeHead = cItems;
     //pQueue->iFreeTail = 0;
-    PPDMQUEUEITEMCORE pItem = (PPDMQUEUEITEMCORE)((char *)pQueue + RT_ALIGN_Z(RT_OFFSETOF(PDMQUEUE, aFreeItems[cItems + PDMQUEUE_FREE_SLACK]), 16));
+    pQueue->cLanes = cLanes;
+    pQueue->offLanes = (uint32_t)offLanes;
+    pQueue->offItems = (uint32_t)offItems;
+    pQueue->cLaneCacheMax = fBatch ? RT_MIN(cItems / cLanes, PDMQUEUE_LANE_CACHE_SIZE) : 0;
+    //pQueue->pBatchLeftoversR3 = NULL;
+    PPDMQUEUEITEMCORE pItem = (PPDMQUEUEITEMCORE)((char *)pQueue + offItems);
     for (unsigned i = 0; i < cItems; i++, pItem = (PPDMQUEUEITEMCORE)((char *)pItem + cbItem))
     {
         pQueue->aFreeItems[i].pItemR3 = pItem;
@@ -129,6 +160,8 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
             AssertMsgFailed(("TMR3TimerCreateInternal failed rc=%Rrc\n", rc));
         if (RT_FAILURE(rc))
         {
+            MMR3HeapFree(pQueue->papBatchItemsR3);
+            MMR3HeapFree(pQueue->pabBatchLanesR3);
             if (fRZEnabled)
                 MMHyperFree(pVM, pQueue);
             else
@@ -178,6 +211,16 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
     STAMR3RegisterF(pVM, &pQueue->StatInsert,           STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Calls to PDMQueueInsert.",         "/PDM/Queue/%s/Insert",         pQueue->pszName);
     STAMR3RegisterF(pVM, &pQueue->StatFlush,            STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Calls to pdmR3QueueFlush.",        "/PDM/Queue/%s/Flush",          pQueue->pszName);
     STAMR3RegisterF(pVM, &pQueue->StatFlushLeftovers,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,   "Left over items after flush.",     "/PDM/Queue/%s/FlushLeftovers", pQueue->pszName);
+    if (fBatch)
+    {
+        STAMR3RegisterF(pVM, &pQueue->StatBatchItems,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,   "Items handed to the batch consumer.", "/PDM/Queue/%s/BatchItems", pQueue->pszName);
+        for (uint32_t iLane = 0; iLane < cLanes; iLane++)
+        {
+            PPDMQUEUELANE pLane = PDMQUEUE_LANE(pQueue, iLane);
+            STAMR3RegisterF(pVM, &pLane->StatInsert,      STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_CALLS,      "Calls to PDMQueueInsert.",         "/PDM/Queue/%s/Lane%u/Insert",      pQueue->pszName, iLane);
+            STAMR3RegisterF(pVM, &pLane->StatAllocShared, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "Allocations missing the lane cache.", "/PDM/Queue/%s/Lane%u/AllocShared", pQueue->pszName, iLane);
+        }
+    }
 #ifdef VBOX_WITH_STATISTICS
     STAMR3RegisterF(pVM, &pQueue->StatFlushPrf,         STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Profiling pdmR3QueueFlush.",       "/PDM/Queue/%s/FlushPrf",       pQueue->pszName);
     STAMR3RegisterF(pVM, (void *)&pQueue->cStatPending, STAMTYPE_U32,     STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,        "Pending items.",                   "/PDM/Queue/%s/Pending",        pQueue->pszName);
@@ -224,7 +267,7 @@ VMMR3_INT_DECL(int) PDMR3QueueCreateDevice(PVM pVM, PPDMDEVINS pDevIns, size_t c
      * Create the queue.
      */
     PPDMQUEUE pQueue;
-    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, fRZEnabled, pszName, &pQueue);
+    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, fRZEnabled, false /*fBatch*/, pszName, &pQueue);
     if (RT_SUCCESS(rc))
     {
         pQueue->enmType = PDMQUEUETYPE_DEV;
@@ -274,7 +317,7 @@ VMMR3_INT_DECL(int) PDMR3QueueCreateDriver(PVM pVM, PPDMDRVINS pDrvIns, size_t c
      * Create the queue.
      */
     PPDMQUEUE pQueue;
-    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, false, pszName, &pQueue);
+    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, false, false /*fBatch*/, pszName, &pQueue);
     if (RT_SUCCESS(rc))
     {
         pQueue->enmType = PDMQUEUETYPE_DRV;
@@ -324,7 +367,7 @@ VMMR3_INT_DECL(int) PDMR3QueueCreateInternal(PVM pVM, size_t cbItem, uint32_t cI
      * Create the queue.
      */
     PPDMQUEUE pQueue;
-    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, fRZEnabled, pszName, &pQueue);
+    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, fRZEnabled, false /*fBatch*/, pszName, &pQueue);
     if (RT_SUCCESS(rc))
     {
         pQueue->enmType = PDMQUEUETYPE_INTERNAL;
@@ -372,7 +415,7 @@ VMMR3_INT_DECL(int) PDMR3QueueCreateExternal(PVM pVM, size_t cbItem, uint32_t cI
      * Create the queue.
      */
     PPDMQUEUE pQueue;
-    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, false, pszName, &pQueue);
+    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, false, false /*fBatch*/, pszName, &pQueue);
     if (RT_SUCCESS(rc))
     {
         pQueue->enmType = PDMQUEUETYPE_EXTERNAL;
@@ -387,6 +430,111 @@ VMMR3_INT_DECL(int) PDMR3QueueCreateExternal(PVM pVM, size_t cbItem, uint32_t cI
 }
 
 
+/**
+ * Create a batch queue with a device owner.
+ *
+ * Batch queues keep the pending and free items in a lane for each virtual
+ * CPU, so producers on different CPUs don't contend with each other, and
+ * hand all pending items to the consumer in one call.
+ *
+ * @returns VBox status code.
+ * @param   pVM                 Pointer to the VM.
+ * @param   pDevIns             Device instance.
+ * @param   cbItem              Size a queue item.
+ * @param   cItems              Number of items in the queue.
+ * @param   cMilliesInterval    Number of milliseconds between polling the queue.
+ *                              If 0 then the emulation thread will be notified whenever an item arrives.
+ * @param   pfnCallback         The consumer function.
+ * @param   fRZEnabled          Set if the queue must be usable from RC/R0.
+ * @param   pszName             The queue name. Unique. Not copied.
+ * @param   ppQueue             Where to store the queue handle on success.
+ * @thread  Emulation thread only.
+ */
+VMMR3_INT_DECL(int) PDMR3QueueCreateDeviceBatch(PVM pVM, PPDMDEVINS pDevIns, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
+                                                PFNPDMQUEUEDEVBATCH pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue)
+{
+    LogFlow(("PDMR3QueueCreateDeviceBatch: pDevIns=%p cbItem=%d cItems=%d cMilliesInterval=%d pfnCallback=%p fRZEnabled=%RTbool pszName=%s\n",
+             pDevIns, cbItem, cItems, cMilliesInterval, pfnCallback, fRZEnabled, pszName));
+
+    /*
+     * Validate input.
+     */
+    VMCPU_ASSERT_EMT(&pVM->aCpus[0]);
+    if (!pfnCallback)
+    {
+        AssertMsgFailed(("No consumer callback!\n"));
+        return VERR_INVALID_PARAMETER;
+    }
+
+    /*
+     * Create the queue.
+     */
+    PPDMQUEUE pQueue;
+    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, fRZEnabled, true /*fBatch*/, pszName, &pQueue);
+    if (RT_SUCCESS(rc))
+    {
+        pQueue->enmType = PDMQUEUETYPE_DEV_BATCH;
+        pQueue->u.DevBatch.pDevIns = pDevIns;
+        pQueue->u.DevBatch.pfnCallback = pfnCallback;
+
+        *ppQueue = pQueue;
+        Log(("PDM: Created device batch queue %p; cbItem=%d cItems=%d cMillies=%d pfnCallback=%p pDevIns=%p\n",
+             pQueue, cbItem, cItems, cMilliesInterval, pfnCallback, pDevIns));
+    }
+    return rc;
+}
+
+
+/**
+ * Create a batch queue with an internal owner.
+ *
+ * @returns VBox status code.
+ * @param   pVM                 Pointer to the VM.
+ * @param   cbItem              Size a queue item.
+ * @param   cItems              Number of items in the queue.
+ * @param   cMilliesInterval    Number of milliseconds between polling the queue.
+ *                              If 0 then the emulation thread will be notified whenever an item arrives.
+ * @param   pfnCallback         The consumer function.
+ * @param   fRZEnabled          Set if the queue must be usable from RC/R0.
+ * @param   pszName             The queue name. Unique. Not copied.
+ * @param   ppQueue             Where to store the queue handle on success.
+ * @thread  Emulation thread only.
+ * @sa      PDMR3QueueCreateDeviceBatch
+ */
+VMMR3_INT_DECL(int) PDMR3QueueCreateInternalBatch(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cMilliesInterval,
+                                                  PFNPDMQUEUEINTBATCH pfnCallback, bool fRZEnabled, const char *pszName, PPDMQUEUE *ppQueue)
+{
+    LogFlow(("PDMR3QueueCreateInternalBatch: cbItem=%d cItems=%d cMilliesInterval=%d pfnCallback=%p fRZEnabled=%RTbool pszName=%s\n",
+             cbItem, cItems, cMilliesInterval, pfnCallback, fRZEnabled, pszName));
+
+    /*
+     * Validate input.
+     */
+    VMCPU_ASSERT_EMT(&pVM->aCpus[0]);
+    if (!pfnCallback)
+    {
+        AssertMsgFailed(("No consumer callback!\n"));
+        return VERR_INVALID_PARAMETER;
+    }
+
+    /*
+     * Create the queue.
+     */
+    PPDMQUEUE pQueue;
+    int rc = pdmR3QueueCreate(pVM, cbItem, cItems, cMilliesInterval, fRZEnabled, true /*fBatch*/, pszName, &pQueue);
+    if (RT_SUCCESS(rc))
+    {
+        pQueue->enmType = PDMQUEUETYPE_INTERNAL_BATCH;
+        pQueue->u.IntBatch.pfnCallback = pfnCallback;
+
+        *ppQueue = pQueue;
+        Log(("PDM: Created internal batch queue %p; cbItem=%d cItems=%d cMillies=%d pfnCallback=%p\n",
+             pQueue, cbItem, cItems, cMilliesInterval, pfnCallback));
+    }
+    return rc;
+}
+
+
 /**
  * Destroy a queue.
  *
@@ -467,6 +615,19 @@ VMMR3_INT_DECL(int) PDMR3QueueDestroy(PPDMQUEUE pQueue)
     STAMR3Deregister(pVM, &pQueue->StatFlushPrf);
     STAMR3Deregister(pVM, (void *)&pQueue->cStatPending);
 #endif
+    if (pQueue->cLanes)
+    {
+        STAMR3Deregister(pVM, &pQueue->StatBatchItems);
+        for (uint32_t iLane = 0; iLane < pQueue->cLanes; iLane++)
+        {
+            STAMR3Deregister(pVM, &PDMQUEUE_LANE(pQueue, iLane)->StatInsert);
+            STAMR3Deregister(pVM, &PDMQUEUE_LANE(pQueue, iLane)->StatAllocShared);
+        }
+        MMR3HeapFree(pQueue->papBatchItemsR3);
+        pQueue->papBatchItemsR3 = NULL;
+        MMR3HeapFree(pQueue->pabBatchLanesR3);
+        pQueue->pabBatchLanesR3 = NULL;
+    }
 
     /*
      * Destroy the timer and free it.
@@ -519,8 +680,10 @@ VMMR3_INT_DECL(int) PDMR3QueueDestroyDevice(PVM pVM, PPDMDEVINS pDevIns)
     {
         while (pQueue)
         {
-            if (    pQueue->enmType == PDMQUEUETYPE_DEV
-                &&  pQueue->u.Dev.pDevIns == pDevIns)
+            if (    (   pQueue->enmType == PDMQUEUETYPE_DEV
+                     && pQueue->u.Dev.pDevIns == pDevIns)
+                ||  (   pQueue->enmType == PDMQUEUETYPE_DEV_BATCH
+                     && pQueue->u.DevBatch.pDevIns == pDevIns))
             {
                 PPDMQUEUE pQueueDestroy = pQueue;
                 pQueue = pQueue->pNext;
@@ -593,6 +756,28 @@ VMMR3_INT_DECL(int) PDMR3QueueDestroyDriver(PVM pVM, PPDMDRVINS pDrvIns)
 }
 
 
+/**
+ * Relocates a list of pending RC items.
+ *
+ * @param   pVM             Pointer to the VM.
+ * @param   ppPendingRC     The list head.
+ * @param   offDelta        The relocation delta.
+ */
+static void pdmR3QueueRelocatePendingRC(PVM pVM, RCPTRTYPE(PPDMQUEUEITEMCORE) volatile *ppPendingRC, RTGCINTPTR offDelta)
+{
+    if (*ppPendingRC)
+    {
+        *ppPendingRC += offDelta;
+        PPDMQUEUEITEMCORE pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, *ppPendingRC);
+        while (pCur->pNextRC)
+        {
+            pCur->pNextRC += offDelta;
+            pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pCur->pNextRC);
+        }
+    }
+}
+
+
 /**
  * Relocate the queues.
  *
@@ -616,16 +801,9 @@ void pdmR3QueueRelocate(PVM pVM, RTGCINTPTR offDelta)
                 pQueue->pVMRC = pVM->pVMRC;
 
                 /* Pending RC items. */
-                if (pQueue->pPendingRC)
-                {
-                    pQueue->pPendingRC += offDelta;
-                    PPDMQUEUEITEMCORE pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pQueue->pPendingRC);
-                    while (pCur->pNextRC)
-                    {
-                        pCur->pNextRC += offDelta;
-                        pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pCur->pNextRC);
-                    }
-                }
+                pdmR3QueueRelocatePendingRC(pVM, &pQueue->pPendingRC, offDelta);
+                for (uint32_t iLane = 0; iLane < pQueue->cLanes; iLane++)
+                    pdmR3QueueRelocatePendingRC(pVM, &PDMQUEUE_LANE(pQueue, iLane)->pPendingRC, offDelta);
 
                 /* The free items. */
                 uint32_t i = pQueue->iFreeTail;
@@ -647,6 +825,31 @@ void pdmR3QueueRelocate(PVM pVM, RTGCINTPTR offDelta)
 }
 
 
+/**
+ * Checks if a queue has pending items.
+ *
+ * @returns true if it has, false if not.
+ * @param   pQueue  The queue.
+ */
+static bool pdmR3QueueIsPending(PPDMQUEUE pQueue)
+{
+    if (    pQueue->pPendingR3
+        ||  pQueue->pPendingR0
+        ||  pQueue->pPendingRC
+        ||  pQueue->pBatchLeftoversR3)
+        return true;
+    for (uint32_t iLane = 0; iLane < pQueue->cLanes; iLane++)
+    {
+        PPDMQUEUELANE pLane = PDMQUEUE_LANE(pQueue, iLane);
+        if (    pLane->pPendingR3
+            ||  pLane->pPendingR0
+            ||  pLane->pPendingRC)
+            return true;
+    }
+    return false;
+}
+
+
 /**
  * Flush pending queues.
  * This is a forced action callback.
@@ -674,10 +877,13 @@ VMMR3_INT_DECL(void) PDMR3QueueFlushAll(PVM pVM)
         ASMAtomicBitClear(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_PENDING_BIT);
 
         for (PPDMQUEUE pCur = pVM->pUVM->pdm.s.pQueuesForced; pCur; pCur = pCur->pNext)
-            if (    pCur->pPendingR3
-                ||  pCur->pPendingR0
-                ||  pCur->pPendingRC)
-                pdmR3QueueFlush(pCur);
+            if (pdmR3QueueIsPending(pCur))
+            {
+                if (pCur->cLanes)
+                    pdmR3QueueFlushBatch(pCur);
+                else
+                    pdmR3QueueFlush(pCur);
+            }
 
         ASMAtomicBitClear(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_ACTIVE_BIT);
 
@@ -691,29 +897,16 @@ VMMR3_INT_DECL(void) PDMR3QueueFlushAll(PVM pVM)
 
 
 /**
- * Process pending items in one queue.
+ * Turns the pending LIFOs of the three contexts into one FIFO.
  *
- * @returns Success indicator.
- *          If false the item the consumer said "enough!".
- * @param   pQueue  The queue.
+ * @returns The FIFO, linked by pNextR3.
+ * @param   pQueue      The queue.
+ * @param   pItems      The pending R3 items.
+ * @param   pItemsRC    The pending RC items.
+ * @param   pItemsR0    The pending R0 items.
  */
-static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
+static PPDMQUEUEITEMCORE pdmR3QueueMergePending(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItems, RTRCPTR pItemsRC, RTR0PTR pItemsR0)
 {
-    STAM_PROFILE_START(&pQueue->StatFlushPrf,p);
-
-    /*
-     * Get the lists.
-     */
-    PPDMQUEUEITEMCORE pItems   = ASMAtomicXchgPtrT(&pQueue->pPendingR3, NULL, PPDMQUEUEITEMCORE);
-    RTRCPTR           pItemsRC = ASMAtomicXchgRCPtr(&pQueue->pPendingRC, NIL_RTRCPTR);
-    RTR0PTR           pItemsR0 = ASMAtomicXchgR0Ptr(&pQueue->pPendingR0, NIL_RTR0PTR);
-
-    AssertMsgReturn(   pItemsR0
-                    || pItemsRC
-                    || pItems,
-                    ("Someone is racing us? This shouldn't happen!\n"),
-                    true);
-
     /*
      * Reverse the list (it's inserted in LIFO order to avoid semaphores, remember).
      */
@@ -751,6 +944,37 @@ static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
         pItems = pInsert;
     }
 
+    return pItems;
+}
+
+
+/**
+ * Process pending items in one queue.
+ *
+ * @returns Success indicator.
+ *          If false the item the consumer said "enough!".
+ * @param   pQueue  The queue.
+ */
+static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
+{
+    STAM_PROFILE_START(&pQueue->StatFlushPrf,p);
+
+    /*
+     * Get the lists.
+     */
+    PPDMQUEUEITEMCORE pItems   = ASMAtomicXchgPtrT(&pQueue->pPendingR3, NULL, PPDMQUEUEITEMCORE);
+    RTRCPTR           pItemsRC = ASMAtomicXchgRCPtr(&pQueue->pPendingRC, NIL_RTRCPTR);
+    RTR0PTR           pItemsR0 = ASMAtomicXchgR0Ptr(&pQueue->pPendingR0, NIL_RTR0PTR);
+
+    AssertMsgReturn(   pItemsR0
+                    || pItemsRC
+                    || pItems,
+                    ("Someone is racing us? This shouldn't happen!\n"),
+                    true);
+
+    pItems = pdmR3QueueMergePending(pQueue, pItems, pItemsRC, pItemsR0);
+    PPDMQUEUEITEMCORE pCur;
+
     /*
      * Feed the items to the consumer function.
      */
@@ -852,6 +1076,139 @@ static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
 }
 
 
+/**
+ * Process pending items in one batch queue.
+ *
+ * Collects the pending items of all the lanes into an array and hands it to
+ * the consumer in one go.
+ *
+ * @returns Success indicator.
+ *          If false the consumer left some items behind.
+ * @param   pQueue  The queue.
+ */
+static bool pdmR3QueueFlushBatch(PPDMQUEUE pQueue)
+{
+    STAM_PROFILE_START(&pQueue->StatFlushPrf,p);
+    STAM_REL_COUNTER_INC(&pQueue->StatFlush);
+
+    PPDMQUEUEITEMCORE  *papItems = pQueue->papBatchItemsR3;
+    uint8_t            *pabLanes = pQueue->pabBatchLanesR3;
+    uint32_t const      iShared  = pQueue->cLanes - 1;
+    uint32_t            cItems   = 0;
+
+    /*
+     * What the consumer left behind last time goes first.
+     */
+    for (PPDMQUEUEITEMCORE pCur = pQueue->pBatchLeftoversR3; pCur; pCur = pCur->pNextR3)
+    {
+        AssertBreak(cItems < pQueue->cItems);
+        papItems[cItems] = pCur;
+        pabLanes[cItems++] = (uint8_t)iShared;
+    }
+    pQueue->pBatchLeftoversR3 = NULL;
+
+    /*
+     * Then the lanes, one at the time.
+     */
+    for (uint32_t iLane = 0; iLane < pQueue->cLanes; iLane++)
+    {
+        PPDMQUEUELANE pLane = PDMQUEUE_LANE(pQueue, iLane);
+        if (    !pLane->pPendingR3
+            &&  !pLane->pPendingR0
+            &&  !pLane->pPendingRC)
+            continue;
+        PPDMQUEUEITEMCORE pCur = pdmR3QueueMergePending(pQueue,
+                                                        ASMAtomicXchgPtrT(&pLane->pPendingR3, NULL, PPDMQUEUEITEMCORE),
+                                                        ASMAtomicXchgRCPtr(&pLane->pPendingRC, NIL_RTRCPTR),
+                                                        ASMAtomicXchgR0Ptr(&pLane->pPendingR0, NIL_RTR0PTR));
+        for (; pCur; pCur = pCur->pNextR3)
+        {
+            AssertBreak(cItems < pQueue->cItems);
+            papItems[cItems] = pCur;
+            pabLanes[cItems++] = (uint8_t)iLane;
+        }
+    }
+
+    /*
+     * Feed them to the consumer.
+     */
+    Log2(("pdmR3QueueFlushBatch: pQueue=%p enmType=%d cItems=%u\n", pQueue, pQueue->enmType, cItems));
+    uint32_t cDone = 0;
+    if (cItems)
+    {
+        switch (pQueue->enmType)
+        {
+            case PDMQUEUETYPE_DEV_BATCH:
+                cDone = pQueue->u.DevBatch.pfnCallback(pQueue->u.DevBatch.pDevIns, papItems, cItems);
+                break;
+            case PDMQUEUETYPE_INTERNAL_BATCH:
+                cDone = pQueue->u.IntBatch.pfnCallback(pQueue->pVMR3, papItems, cItems);
+                break;
+            default:
+                AssertMsgFailed(("Invalid queue type %d\n", pQueue->enmType));
+                break;
+        }
+        AssertMsgStmt(cDone <= cItems, ("cDone=%u cItems=%u\n", cDone, cItems), cDone = cItems);
+        STAM_REL_COUNTER_ADD(&pQueue->StatBatchItems, cDone);
+    }
+
+    for (uint32_t i = 0; i < cDone; i++)
+        pdmR3QueueFreeBatch(pQueue, papItems[i], pabLanes[i]);
+
+    /*
+     * Keep what's left in order for the next round.
+     */
+    if (cDone < cItems)
+    {
+        PPDMQUEUEITEMCORE pLeftovers = NULL;
+        for (uint32_t i = cItems; i-- > cDone;)
+        {
+            papItems[i]->pNextR3 = pLeftovers;
+            pLeftovers = papItems[i];
+        }
+        pQueue->pBatchLeftoversR3 = pLeftovers;
+
+        STAM_REL_COUNTER_INC(&pQueue->StatFlushLeftovers);
+        STAM_PROFILE_STOP(&pQueue->StatFlushPrf,p);
+        return false;
+    }
+
+    STAM_PROFILE_STOP(&pQueue->StatFlushPrf,p);
+    return true;
+}
+
+
+/**
+ * Free an item of a batch queue.
+ *
+ * The item goes back into the free item cache of the lane it was inserted
+ * on, unless that is full or it is the shared lane.  Since the caches are
+ * only refilled here and only the lane owner takes items out of them, the
+ * items cached by a lane are lost to all the others.  PDMQUEUE::cLaneCacheMax
+ * therefore leaves at least cItems / cLanes items in the shared free ring.
+ *
+ * @param   pQueue  The queue.
+ * @param   pItem   The item.
+ * @param   iLane   The lane it was inserted on.
+ */
+DECLINLINE(void) pdmR3QueueFreeBatch(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem, uint32_t iLane)
+{
+    if (iLane < pQueue->cLanes - 1)
+    {
+        PPDMQUEUELANE  pLane = PDMQUEUE_LANE(pQueue, iLane);
+        uint32_t const iHead = pLane->iCacheHead;
+        if (iHead - ASMAtomicReadU32(&pLane->iCacheTail) < pQueue->cLaneCacheMax)
+        {
+            pLane->aiCache[iHead % RT_ELEMENTS(pLane->aiCache)] = (uint16_t)(((uintptr_t)pItem - (uintptr_t)pQueue - pQueue->offItems)
+                                                                             / pQueue->cbItem);
+            ASMAtomicWriteU32(&pLane->iCacheHead, iHead + 1);
+            return;
+        }
+    }
+    pdmR3QueueFree(pQueue, pItem);
+}
+
+
 /**
  * Free an item.
  *
@@ -874,7 +1231,7 @@ DECLINLINE(void) pdmR3QueueFree(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem)
 
     if (!ASMAtomicCmpXchgU32(&pQueue->iFreeHead, iNext, i))
         AssertMsgFailed(("huh? i=%d iNext=%d iFreeHead=%d iFreeTail=%d\n", i, iNext, pQueue->iFreeHead, pQueue->iFreeTail));
-    STAM_STATS({ ASMAtomicDecU32(&pQueue->cStatPending); });
+    STAM_STATS({ if (!pQueue->cLanes) ASMAtomicDecU32(&pQueue->cStatPending); });
 }
 
 
@@ -891,10 +1248,13 @@ static DECLCALLBACK(void) pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUser
     PPDMQUEUE pQueue = (PPDMQUEUE)pvUser;
     Assert(pTimer == pQueue->pTimer); NOREF(pTimer); NOREF(pVM);
 
-    if (   pQueue->pPendingR3
-        || pQueue->pPendingR0
-        || pQueue->pPendingRC)
-        pdmR3QueueFlush(pQueue);
+    if (pdmR3QueueIsPending(pQueue))
+    {
+        if (pQueue->cLanes)
+            pdmR3QueueFlushBatch(pQueue);
+        else
+            pdmR3QueueFlush(pQueue);
+    }
     int rc = TMTimerSetMillies(pQueue->pTimer, pQueue->cMilliesInterval);
     AssertRC(rc);
 }
@@ -1340,6 +1340,14 @@ VMMR3DECL(int) PGMR3Init(PVM pVM)
     AssertMsgRCReturn(rc, ("Configuration error: Failed to query integer \"PciPassThrough\", rc=%Rrc.\n", rc), rc);
     AssertLogRelReturn(!pVM->pgm.s.fPciPassthrough || pVM->pgm.s.fRamPreAlloc, VERR_INVALID_PARAMETER);
 
+    /*
+     * Saved state tuning.
+     */
+    rc = CFGMR3QueryBoolDef(pCfgPGM, "SaveDedup", &pVM->pgm.s.fSaveDedup, true);
+    AssertMsgRCReturn(rc, ("Configuration error: Failed to query boolean \"SaveDedup\", rc=%Rrc.\n", rc), rc);
+    rc = CFGMR3QueryBoolDef(pCfgPGM, "LiveSaveAutoConverge", &pVM->pgm.s.fLiveSaveAutoConverge, false);
+    AssertMsgRCReturn(rc, ("Configuration error: Failed to query boolean \"LiveSaveAutoConverge\", rc=%Rrc.\n", rc), rc);
+
 #ifdef VBOX_WITH_STATISTICS
     /*
      * Allocate memory for the statistics before someone tries to use them.
@@ -1703,8 +1711,15 @@ static int pgmR3InitStats(PVM pVM)
     STAM_REL_REG(pVM, &pPGM->StatLargePageReused,                STAMTYPE_COUNTER, "/PGM/LargePage/Reused",              STAMUNIT_OCCURENCES, "The number of times we've reused a large page.");
     STAM_REL_REG(pVM, &pPGM->StatLargePageRefused,               STAMTYPE_COUNTER, "/PGM/LargePage/Refused",             STAMUNIT_OCCURENCES, "The number of times we couldn't use a large page.");
     STAM_REL_REG(pVM, &pPGM->StatLargePageRecheck,               STAMTYPE_COUNTER, "/PGM/LargePage/Recheck",             STAMUNIT_OCCURENCES, "The number of times we've rechecked a disabled large page.");
+    STAM_REL_REG(pVM, &pPGM->StatLargePagePromoted,              STAMTYPE_COUNTER, "/PGM/LargePage/Promoted",            STAMUNIT_OCCURENCES, "The number of 2 MB ranges promoted to large pages in the background.");
+    STAM_REL_REG(pVM, &pPGM->StatLargePageDemoted,               STAMTYPE_COUNTER, "/PGM/LargePage/Demoted",             STAMUNIT_OCCURENCES, "The number of large pages broken up into 4 KB pages.");
+    STAM_REL_REG(pVM, &pPGM->StatFreePageReportPages,            STAMTYPE_COUNTER, "/PGM/FreePageReport/Pages",          STAMUNIT_PAGES,      "The number of pages freed by guest free page reports.");
+    STAM_REL_REG(pVM, &pPGM->StatSaveDupPages,                   STAMTYPE_COUNTER, "/PGM/SavedState/DupPages",           STAMUNIT_PAGES,      "The number of RAM pages saved as references to identical pages.");
+    STAM_REL_REG(pVM, &pPGM->StatFreePageReport,                 STAMTYPE_PROFILE, "/PGM/FreePageReport/Process",        STAMUNIT_TICKS_PER_CALL, "Profiles the processing of guest free page reports.");
 
     STAM_REL_REG(pVM, &pPGM->StatShModCheck,                     STAMTYPE_PROFILE, "/PGM/ShMod/Check",                   STAMUNIT_TICKS_PER_CALL, "Profiles the shared module checking.");
+    STAM_REL_REG(pVM, &pPGM->StatLargePagePromote,               STAMTYPE_PROFILE, "/PGM/LargePage/Promote",             STAMUNIT_TICKS_PER_CALL, "Profiles the large page promotion passes.");
+    STAM_REL_REG(pVM, &pPGM->StatPageFusionScan,                 STAMTYPE_PROFILE, "/PGM/PageFusion/Scan",               STAMUNIT_TICKS_PER_CALL, "Profiles the page fusion scans.");
 
     /* Live save */
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.fActive,              STAMTYPE_U8,      "/PGM/LiveSave/fActive",              STAMUNIT_COUNT,     "Active or not.");
@@ -1713,6 +1728,10 @@ static int pgmR3InitStats(PVM pVM)
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cDirtyPagesShort,     STAMTYPE_U32,     "/PGM/LiveSave/cDirtyPagesShort",     STAMUNIT_COUNT,     "Short term dirty page average.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cPagesPerSecond,      STAMTYPE_U32,     "/PGM/LiveSave/cPagesPerSecond",      STAMUNIT_COUNT,     "Pages per second.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cSavedPages,          STAMTYPE_U64,     "/PGM/LiveSave/cSavedPages",          STAMUNIT_COUNT,     "The total number of saved pages.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cDirtyPagesPerSecond, STAMTYPE_U32,     "/PGM/LiveSave/cDirtyPagesPerSecond", STAMUNIT_COUNT,     "Pages dirtied per second during the last pass.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cPagesRemaining,      STAMTYPE_U32,     "/PGM/LiveSave/cPagesRemaining",      STAMUNIT_COUNT,     "The number of pages still to be saved.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cMsEstDowntime,       STAMTYPE_U32,     "/PGM/LiveSave/cMsEstDowntime",       STAMUNIT_COUNT,     "The estimated downtime in milliseconds if the live phase ended now.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.uThrottleCap,         STAMTYPE_U32,     "/PGM/LiveSave/uThrottleCap",         STAMUNIT_PCT,       "The CPU execution cap applied by auto-convergence, 0 if not throttling.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.Ram.cReadyPages,      STAMTYPE_U32,     "/PGM/LiveSave/Ram/cReadPages",       STAMUNIT_COUNT,     "RAM: Ready pages.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.Ram.cDirtyPages,      STAMTYPE_U32,     "/PGM/LiveSave/Ram/cDirtyPages",      STAMUNIT_COUNT,     "RAM: Dirty pages.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.Ram.cZeroPages,       STAMTYPE_U32,     "/PGM/LiveSave/Ram/cZeroPages",       STAMUNIT_COUNT,     "RAM: Ready zero pages.");
@@ -2236,8 +2255,14 @@ VMMR3DECL(int) PGMR3InitFinalize(PVM pVM)
  */
 VMMR3_INT_DECL(int) PGMR3InitCompleted(PVM pVM, VMINITCOMPLETED enmWhat)
 {
+    int rc;
     switch (enmWhat)
     {
+#ifdef VBOX_WITH_PAGE_SHARING
+        case VMINITCOMPLETED_RING0:
+            return pgmR3PageFusionInit(pVM);
+#endif
+
         case VMINITCOMPLETED_HWACCM:
 #ifdef VBOX_WITH_PCI_PASSTHROUGH
             if (pVM->pgm.s.fPciPassthrough)
@@ -2251,14 +2276,17 @@ VMMR3_INT_DECL(int) PGMR3InitCompleted(PVM pVM, VMINITCOMPLETED enmWhat)
                  */
                 if (pVM->pgm.s.fPciPassthrough)
                 {
-                    int rc = VMMR3CallR0(pVM, VMMR0_DO_PGM_PHYS_SETUP_IOMMU, 0, NULL);
+                    rc = VMMR3CallR0(pVM, VMMR0_DO_PGM_PHYS_SETUP_IOMMU, 0, NULL);
                     AssertRCReturn(rc, rc);
                 }
             }
 #else
             AssertLogRelReturn(!pVM->pgm.s.fPciPassthrough, VERR_PGM_PCI_PASSTHRU_MISCONFIG);
 #endif
-            break;
+            rc = pgmR3PhysLargePagePromoteInit(pVM);
+            if (RT_SUCCESS(rc))
+                rc = pgmR3WorkingSetInit(pVM);
+            return rc;
 
         default:
             /* shut up gcc */
@@ -2631,6 +2659,7 @@ VMMR3DECL(int) PGMR3Term(PVM pVM)
     pgmR3PhysRomTerm(pVM);
     pgmUnlock(pVM);
 
+    pgmR3PostCopyDestroy(pVM);
     PGMDeregisterStringFormatTypes();
     return PDMR3CritSectDelete(&pVM->pgm.s.CritSectX);
 }
@@ -24,6 +24,8 @@
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/stam.h>
+#include <VBox/vmm/tm.h>
+#include <VBox/vmm/hwaccm.h>
 #ifdef VBOX_WITH_REM
 # include <VBox/vmm/rem.h>
 #endif
@@ -51,6 +53,11 @@
 *******************************************************************************/
 /** The number of pages to free in one batch. */
 #define PGMPHYS_FREE_PAGE_BATCH_SIZE    128
+/** The max number of 2 MB ranges to look at in one large page promotion pass. */
+#define PGM_LARGE_PAGE_PROMOTE_MAX_RANGES   1024
+/** The max shift applied to the large page promotion interval while no large
+ * pages can be had. */
+#define PGM_LARGE_PAGE_PROMOTE_MAX_BACKOFF_SHIFT    6
 
 
 /*******************************************************************************
@@ -1124,6 +1131,240 @@ VMMR3DECL(int) PGMR3PhysChangeMemBalloon(PVM pVM, bool fInflate, unsigned cPages
 }
 
 
+#if HC_ARCH_BITS == 64 && (defined(RT_OS_WINDOWS) || defined(RT_OS_SOLARIS) || defined(RT_OS_LINUX) || defined(RT_OS_FREEBSD))
+/**
+ * Argument package for pgmR3PhysReportFreePagesRendezvous.
+ */
+typedef struct PGMFREEPAGEREPORT
+{
+    /** The number of ranges. */
+    uint32_t            cRanges;
+    /** The ranges. */
+    PCPGMPHYSRANGE      paRanges;
+    /** The number of pages freed (out). */
+    uint64_t            cPagesFreed;
+} PGMFREEPAGEREPORT;
+
+
+/**
+ * Rendezvous callback used by PGMR3PhysReportFreePages that replaces the
+ * reported pages by ZERO pages.
+ *
+ * This is only called on one of the EMTs while the other ones are waiting for
+ * it to complete this function.
+ *
+ * @returns VBox strict status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pVCpu       The VMCPU for the EMT we're being called on.
+ * @param   pvUser      Pointer to the PGMFREEPAGEREPORT.
+ */
+static DECLCALLBACK(VBOXSTRICTRC) pgmR3PhysReportFreePagesRendezvous(PVM pVM, PVMCPU pVCpu, void *pvUser)
+{
+    PGMFREEPAGEREPORT  *pReport       = (PGMFREEPAGEREPORT *)pvUser;
+    uint32_t            cPendingPages = 0;
+    PGMMFREEPAGESREQ    pReq;
+
+    STAM_REL_PROFILE_START(&pVM->pgm.s.StatFreePageReport, a);
+    pgmLock(pVM);
+
+    /* Flush the PGM pool cache as we might have stale references to pages that we free. */
+    pgmR3PoolClearAllRendezvous(pVM, pVCpu, NULL);
+
+    int rc = GMMR3FreePagesPrepare(pVM, &pReq, PGMPHYS_FREE_PAGE_BATCH_SIZE, GMMACCOUNT_BASE);
+    if (RT_SUCCESS(rc))
+    {
+        for (uint32_t iRange = 0; iRange < pReport->cRanges && RT_SUCCESS(rc); iRange++)
+        {
+            RTGCPHYS GCPhys = pReport->paRanges[iRange].GCPhys;
+            for (uint64_t cLeft = pReport->paRanges[iRange].cPages; cLeft > 0; cLeft--, GCPhys += PAGE_SIZE)
+            {
+                /* Only RAM pages that are backed, not mapped by anyone and
+                   without access handlers, as somebody is watching those.  The
+                   pages are not ballooned, the guest gets them back on touch. */
+                PPGMPAGE pPage = pgmPhysGetPage(pVM, GCPhys);
+                if (    !pPage
+                    ||  PGM_PAGE_GET_TYPE(pPage) != PGMPAGETYPE_RAM
+                    ||  PGM_PAGE_IS_ZERO(pPage)
+                    ||  PGM_PAGE_IS_BALLOONED(pPage)
+                    ||  PGM_PAGE_HAS_ANY_HANDLERS(pPage)
+                    ||  PGM_PAGE_GET_READ_LOCKS(pPage) != 0
+                    ||  PGM_PAGE_GET_WRITE_LOCKS(pPage) != 0)
+                    continue;
+
+                /* A free page the guest still has a page table in is unlikely,
+                   but the shadow of it would keep pointing at the host page. */
+                pgmPoolFlushPageByGCPhys(pVM, GCPhys);
+
+                rc = pgmPhysFreePage(pVM, pReq, &cPendingPages, pPage, GCPhys);
+                if (RT_FAILURE(rc))
+                    break;
+                pReport->cPagesFreed++;
+            }
+        }
+
+        if (RT_SUCCESS(rc) && cPendingPages)
+            rc = GMMR3FreePagesPerform(pVM, pReq, cPendingPages);
+        GMMR3FreePagesCleanup(pReq);
+    }
+
+    pgmUnlock(pVM);
+
+    /* Flush the recompiler's TLB as well. */
+    for (VMCPUID i = 0; i < pVM->cCpus; i++)
+        CPUMSetChangedFlags(&pVM->aCpus[i], CPUM_CHANGED_GLOBAL_TLB_FLUSH);
+
+    STAM_REL_COUNTER_ADD(&pVM->pgm.s.StatFreePageReportPages, pReport->cPagesFreed);
+    STAM_REL_PROFILE_STOP(&pVM->pgm.s.StatFreePageReport, a);
+    AssertLogRelRC(rc);
+    return rc;
+}
+
+
+/**
+ * Processes a free page report on the way out; helper for
+ * PGMR3PhysReportFreePages.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   cRanges     The number of ranges.
+ * @param   paRanges    Copy of the ranges, freed here.
+ */
+static DECLCALLBACK(void) pgmR3PhysReportFreePagesHelper(PVM pVM, uint32_t cRanges, PPGMPHYSRANGE paRanges)
+{
+    PGMFREEPAGEREPORT Report;
+    Report.cRanges     = cRanges;
+    Report.paRanges    = paRanges;
+    Report.cPagesFreed = 0;
+    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3PhysReportFreePagesRendezvous, &Report);
+
+    /* Made a copy in PGMR3PhysReportFreePages; free it here. */
+    RTMemFree(paRanges);
+
+    /* PGMR3PhysQueryFreePagesReport picks up the status, the count is
+       only valid on success. */
+    ASMAtomicWriteU64(&pVM->pgm.s.cFreePageReportPages, RT_SUCCESS(rc) ? Report.cPagesFreed : 0);
+    ASMAtomicWriteS32(&pVM->pgm.s.rcFreePageReport, rc);
+    ASMAtomicWriteBool(&pVM->pgm.s.fFreePageReportPending, false);
+}
+#endif /* 64-bit host && (Windows || Solaris || Linux || FreeBSD) */
+
+
+/**
+ * Replaces ranges of guest RAM the guest reported as free by ZERO pages.
+ *
+ * Unlike with ballooning, the guest keeps the pages.  They are simply
+ * populated again when touched.  The guest must not touch the pages before
+ * the report has been completed.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS if the pages have been freed.
+ * @retval  VINF_TRY_AGAIN if the report is processed asynchronously, poll
+ *          PGMR3PhysQueryFreePagesReport for its completion.
+ * @retval  VERR_TRY_AGAIN if the previous report is still being processed.
+ *
+ * @param   pVM             Pointer to the VM.
+ * @param   cRanges         The number of ranges.
+ * @param   paRanges        The page ranges.
+ * @param   pcPagesFreed    Where to return the number of pages freed.  Only
+ *                          set on VINF_SUCCESS.
+ * @thread  EMT
+ */
+VMMR3DECL(int) PGMR3PhysReportFreePages(PVM pVM, uint32_t cRanges, PCPGMPHYSRANGE paRanges, uint64_t *pcPagesFreed)
+{
+    /* This must match GMMR0Init; currently we only support freeing pages on all 64-bit hosts except Mac OS X */
+#if HC_ARCH_BITS == 64 && (defined(RT_OS_WINDOWS) || defined(RT_OS_SOLARIS) || defined(RT_OS_LINUX) || defined(RT_OS_FREEBSD))
+    VM_ASSERT_EMT_RETURN(pVM, VERR_VM_THREAD_NOT_EMT);
+    AssertReturn(cRanges > 0, VERR_INVALID_PARAMETER);
+    AssertPtrReturn(paRanges, VERR_INVALID_POINTER);
+    AssertPtrReturn(pcPagesFreed, VERR_INVALID_POINTER);
+
+    /*
+     * Validate the ranges, the total must not exceed the RAM size.
+     */
+    uint64_t cPagesTotal = 0;
+    for (uint32_t i = 0; i < cRanges; i++)
+    {
+        AssertMsgReturn(   !(paRanges[i].GCPhys & PAGE_OFFSET_MASK)
+                        && paRanges[i].cPages > 0
+                        && paRanges[i].cPages <= pVM->pgm.s.cAllPages
+                        && paRanges[i].GCPhys + (paRanges[i].cPages << PAGE_SHIFT) - 1 > paRanges[i].GCPhys,
+                        ("#%u: %RGp LB %#RX64 pages\n", i, paRanges[i].GCPhys, paRanges[i].cPages),
+                        VERR_INVALID_PARAMETER);
+        cPagesTotal += paRanges[i].cPages;
+    }
+    AssertReturn(cPagesTotal <= pVM->pgm.s.cAllPages, VERR_INVALID_PARAMETER);
+
+    /*
+     * We own the device lock here and could cause a deadlock by waiting for
+     * another VCPU that is blocking on it.  In the SMP case we therefore post
+     * a request packet to postpone the job and let the caller poll for it.
+     */
+    if (pVM->cCpus > 1)
+    {
+        if (!ASMAtomicCmpXchgBool(&pVM->pgm.s.fFreePageReportPending, true, false))
+            return VERR_TRY_AGAIN;
+
+        size_t const  cbRanges     = cRanges * sizeof(paRanges[0]);
+        PPGMPHYSRANGE paRangesCopy = (PPGMPHYSRANGE)RTMemDup(paRanges, cbRanges);
+        int rc = paRangesCopy ? VINF_SUCCESS : VERR_NO_MEMORY;
+        if (RT_SUCCESS(rc))
+            rc = VMR3ReqCallNoWait(pVM, VMCPUID_ANY_QUEUE, (PFNRT)pgmR3PhysReportFreePagesHelper, 3, pVM, cRanges, paRangesCopy);
+        if (RT_FAILURE(rc))
+        {
+            RTMemFree(paRangesCopy);
+            ASMAtomicWriteBool(&pVM->pgm.s.fFreePageReportPending, false);
+            return rc;
+        }
+        return VINF_TRY_AGAIN;
+    }
+
+    PGMFREEPAGEREPORT Report;
+    Report.cRanges     = cRanges;
+    Report.paRanges    = paRanges;
+    Report.cPagesFreed = 0;
+    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3PhysReportFreePagesRendezvous, &Report);
+    if (RT_SUCCESS(rc))
+    {
+        pVM->pgm.s.cFreePageReportPages = Report.cPagesFreed;
+        *pcPagesFreed = Report.cPagesFreed;
+    }
+    else
+        pVM->pgm.s.cFreePageReportPages = 0;
+    pVM->pgm.s.rcFreePageReport = rc;
+    return rc;
+
+#else
+    NOREF(pVM); NOREF(cRanges); NOREF(paRanges); NOREF(pcPagesFreed);
+    return VERR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * Checks whether the last free page report has been completed.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS if it has, *pcPagesFreed is set.
+ * @retval  VINF_TRY_AGAIN if it is still being processed.
+ * @returns The failure status of the last report if it failed.
+ *
+ * @param   pVM             Pointer to the VM.
+ * @param   pcPagesFreed    Where to return the number of pages the report freed.
+ */
+VMMR3DECL(int) PGMR3PhysQueryFreePagesReport(PVM pVM, uint64_t *pcPagesFreed)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(pcPagesFreed, VERR_INVALID_POINTER);
+
+    if (ASMAtomicReadBool(&pVM->pgm.s.fFreePageReportPending))
+        return VINF_TRY_AGAIN;
+    int rc = ASMAtomicReadS32(&pVM->pgm.s.rcFreePageReport);
+    if (RT_FAILURE(rc))
+        return rc;
+    *pcPagesFreed = ASMAtomicReadU64(&pVM->pgm.s.cFreePageReportPages);
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Rendezvous callback used by PGMR3WriteProtectRAM that write protects all
  * physical RAM.
@@ -1145,6 +1386,7 @@ static DECLCALLBACK(VBOXSTRICTRC) pgmR3PhysWriteProtectRAMRendezvous(PVM pVM, PV
 #ifdef PGMPOOL_WITH_OPTIMIZED_DIRTY_PT
     pgmPoolResetDirtyPages(pVM);
 #endif
+    pVM->pgm.s.uWriteMonitorGen++;
 
     /** @todo pointless to write protect the physical page pointed to by RSP. */
 
@@ -4287,8 +4529,9 @@ VMMR3DECL(int) PGMR3PhysAllocateLargeHandyPage(PVM pVM, RTGCPHYS GCPhys)
         if (u64TimeStampDelta > 100)
         {
             STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->StatLargePageOverflow);
-            if (    ++cTimeOut > 10
-                ||  u64TimeStampDelta > 1000 /* more than one second forces an early retirement from allocating large pages. */)
+            /* A single slow attempt may just be the host being busy, so very slow ones only count more. */
+            cTimeOut += u64TimeStampDelta > 1000 ? 5 : 1;
+            if (cTimeOut > 10)
             {
                 /* If repeated attempts to allocate a large page takes more than 100 ms, then we fall back to normal 4k pages.
                  * E.g. Vista 64 tries to move memory around, which takes a huge amount of time.
@@ -4310,6 +4553,383 @@ VMMR3DECL(int) PGMR3PhysAllocateLargeHandyPage(PVM pVM, RTGCPHYS GCPhys)
 }
 
 
+#ifdef PGM_WITH_LARGE_PAGES
+
+/**
+ * Checks if a 2 MB range is fully populated with private RAM pages nobody is
+ * monitoring, i.e. whether it can be promoted to a large page.
+ *
+ * @returns true if it can, false if not.
+ * @param   pRam        The RAM range.
+ * @param   iFirstPage  The index of the first page of the 2 MB range.
+ */
+static bool pgmR3PhysLargePageCanPromote(PPGMRAMRANGE pRam, uint32_t iFirstPage)
+{
+    for (uint32_t iPage = iFirstPage; iPage < iFirstPage + _2M / PAGE_SIZE; iPage++)
+    {
+        PPGMPAGE pPage = &pRam->aPages[iPage];
+        if (    PGM_PAGE_GET_TYPE(pPage) != PGMPAGETYPE_RAM
+            ||  PGM_PAGE_GET_STATE(pPage) != PGM_PAGE_STATE_ALLOCATED
+            ||  PGM_PAGE_HAS_ANY_HANDLERS(pPage)
+            ||  PGM_PAGE_GET_READ_LOCKS(pPage) != 0
+            ||  PGM_PAGE_GET_WRITE_LOCKS(pPage) != 0)
+            return false;
+    }
+    return true;
+}
+
+
+/**
+ * Promotes a 2 MB range of 4 KB pages to a large page.
+ *
+ * If the range still consists of the pages of a disabled large page, it is
+ * simply re-enabled.  Otherwise the pages are copied into a fresh large page
+ * and freed.  The large page is allocated and filled before anything is
+ * freed, so the range is left untouched when no large page can be had.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_PGM_INVALID_LARGE_PAGE_RANGE if no large page could be
+ *          allocated, nothing changed.
+ * @param   pVM         Pointer to the VM.
+ * @param   pRam        The RAM range.
+ * @param   iFirstPage  The index of the first page of the 2 MB range.
+ * @param   pbScratch   2 MB buffer for the page contents.
+ * @param   pfFlushTLBs Set to @a true if the shadow TLBs should be flushed, it
+ *                      is NOT touched if this isn't necessary.
+ */
+static int pgmR3PhysLargePagePromote(PVM pVM, PPGMRAMRANGE pRam, uint32_t iFirstPage, uint8_t *pbScratch, bool *pfFlushTLBs)
+{
+    RTGCPHYS const  GCPhysBase = pRam->GCPhys + ((RTGCPHYS)iFirstPage << PAGE_SHIFT);
+    PPGMPAGE const  pFirstPage = &pRam->aPages[iFirstPage];
+    uint32_t        iPage;
+    int             rc;
+
+    /*
+     * Drop all shadow references to the range, so the next access faults in
+     * a 2 MB PDE.
+     */
+    for (iPage = 0; iPage < _2M / PAGE_SIZE; iPage++)
+        pgmPoolTrackUpdateGCPhys(pVM, GCPhysBase + ((RTGCPHYS)iPage << PAGE_SHIFT), &pFirstPage[iPage],
+                                 true /* clear the entries */, pfFlushTLBs);
+
+    /*
+     * Still the pages of a disabled large page?
+     */
+    if (    PGM_PAGE_GET_PDE_TYPE(pFirstPage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED
+        &&  pgmPhysRecheckLargePage(pVM, GCPhysBase, pFirstPage) == VINF_SUCCESS)
+    {
+        STAM_REL_COUNTER_INC(&pVM->pgm.s.StatLargePagePromoted);
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Save the contents.
+     */
+    for (iPage = 0; iPage < _2M / PAGE_SIZE; iPage++)
+    {
+        void const *pvSrc;
+        rc = pgmPhysPageMapReadOnly(pVM, &pFirstPage[iPage], GCPhysBase + ((RTGCPHYS)iPage << PAGE_SHIFT), &pvSrc);
+        if (RT_FAILURE(rc))
+            return rc;
+        memcpy(&pbScratch[iPage << PAGE_SHIFT], pvSrc, PAGE_SIZE);
+    }
+
+    /*
+     * Get the large page and fill it.
+     */
+    rc = VMMR3CallR0(pVM, VMMR0_DO_PGM_ALLOCATE_LARGE_HANDY_PAGE, 0, NULL);
+    if (RT_FAILURE(rc))
+    {
+        LogFlow(("pgmR3PhysLargePagePromote: %RGp: %Rrc\n", GCPhysBase, rc));
+        return VERR_PGM_INVALID_LARGE_PAGE_RANGE;
+    }
+    Assert(pVM->pgm.s.cLargeHandyPages == 1);
+    uint32_t idPage = pVM->pgm.s.aLargeHandyPage[0].idPage;
+    RTHCPHYS HCPhys = pVM->pgm.s.aLargeHandyPage[0].HCPhysGCPhys;
+    pVM->pgm.s.cLargeHandyPages = 0;
+
+    void *pv;
+    rc = pgmPhysPageMapByPageID(pVM, idPage, HCPhys, &pv);
+    if (RT_FAILURE(rc))
+    {
+        AssertLogRelMsgFailed(("idPage=%#x HCPhys=%RHp rc=%Rrc\n", idPage, HCPhys, rc));
+        int rc2 = GMMR3FreeLargePage(pVM, idPage);
+        AssertLogRelRC(rc2);
+        return VERR_PGM_INVALID_LARGE_PAGE_RANGE;
+    }
+    memcpy(pv, pbScratch, _2M);
+
+    /*
+     * Free the 4 KB pages.  Past this point there is no going back, so any
+     * failure is fatal.
+     */
+    PGMMFREEPAGESREQ pReq;
+    uint32_t         cPendingPages = 0;
+    rc = GMMR3FreePagesPrepare(pVM, &pReq, PGMPHYS_FREE_PAGE_BATCH_SIZE, GMMACCOUNT_BASE);
+    AssertLogRelRCReturn(rc, rc);
+    for (iPage = 0; iPage < _2M / PAGE_SIZE && RT_SUCCESS(rc); iPage++)
+        rc = pgmPhysFreePage(pVM, pReq, &cPendingPages, &pFirstPage[iPage], GCPhysBase + ((RTGCPHYS)iPage << PAGE_SHIFT));
+    if (RT_SUCCESS(rc) && cPendingPages)
+        rc = GMMR3FreePagesPerform(pVM, pReq, cPendingPages);
+    GMMR3FreePagesCleanup(pReq);
+    AssertLogRelMsgRCReturn(rc, ("%RGp: %Rrc\n", GCPhysBase, rc), rc);
+
+    /*
+     * Put the large page in their place, see PGMR3PhysAllocateLargeHandyPage.
+     */
+    for (iPage = 0; iPage < _2M / PAGE_SIZE; iPage++)
+    {
+        PPGMPAGE pPage = &pFirstPage[iPage];
+        Assert(PGM_PAGE_IS_ZERO(pPage));
+        pVM->pgm.s.cZeroPages--;
+        pVM->pgm.s.cPrivatePages++;
+        PGM_PAGE_SET_HCPHYS(pVM, pPage, HCPhys);
+        PGM_PAGE_SET_PAGEID(pVM, pPage, idPage);
+        PGM_PAGE_SET_STATE(pVM, pPage, PGM_PAGE_STATE_ALLOCATED);
+        PGM_PAGE_SET_PDE_TYPE(pVM, pPage, PGM_PAGE_PDE_TYPE_PDE);
+        PGM_PAGE_SET_PTE_INDEX(pVM, pPage, 0);
+        PGM_PAGE_SET_TRACKING(pVM, pPage, 0);
+        idPage++;
+        HCPhys += PAGE_SIZE;
+    }
+    pVM->pgm.s.cLargePages++;
+    pgmPhysInvalidatePageMapTLB(pVM);
+    *pfFlushTLBs = true;
+
+    Log(("pgmR3PhysLargePagePromote: promoted %RGp\n", GCPhysBase));
+    STAM_REL_COUNTER_INC(&pVM->pgm.s.StatLargePagePromoted);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Rendezvous callback doing one large page promotion pass.
+ *
+ * @returns VBox strict status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pVCpu       Pointer to the VMCPU of the calling EMT.
+ * @param   pvUser      The 2 MB scratch buffer.
+ */
+static DECLCALLBACK(VBOXSTRICTRC) pgmR3PhysLargePagePromoteRendezvous(PVM pVM, PVMCPU pVCpu, void *pvUser)
+{
+    uint8_t    *pbScratch  = (uint8_t *)pvUser;
+    uint32_t    cRanges    = 0;
+    uint32_t    cPromoted  = 0;
+    bool        fFlushTLBs = false;
+    bool        fStop      = false;
+    int         rc         = VINF_SUCCESS;
+    NOREF(pVCpu);
+
+    pgmLock(pVM);
+
+    /*
+     * Continue where the last pass stopped, wrapping around at the end.
+     */
+    RTGCPHYS     GCPhys = pVM->pgm.s.GCPhysLargePageCursor;
+    PPGMRAMRANGE pRam   = pVM->pgm.s.pRamRangesXR3;
+    while (pRam && GCPhys > pRam->GCPhysLast)
+        pRam = pRam->pNextR3;
+
+    while (pRam && !fStop)
+    {
+        GCPhys = RT_ALIGN_T(RT_MAX(GCPhys, pRam->GCPhys), _2M, RTGCPHYS);
+        if (!PGM_RAM_RANGE_IS_AD_HOC(pRam))
+        {
+            for (; GCPhys < pRam->GCPhysLast && pRam->GCPhysLast - GCPhys >= _2M - 1; GCPhys += _2M)
+            {
+                if (    cRanges >= PGM_LARGE_PAGE_PROMOTE_MAX_RANGES
+                    ||  cPromoted >= pVM->pgm.s.cLargePagePromoteMax
+                    ||  !PGMIsUsingLargePages(pVM))
+                {
+                    fStop = true;
+                    break;
+                }
+                cRanges++;
+
+                uint32_t const iFirstPage = (uint32_t)((GCPhys - pRam->GCPhys) >> PAGE_SHIFT);
+                if (    PGM_PAGE_GET_PDE_TYPE(&pRam->aPages[iFirstPage]) != PGM_PAGE_PDE_TYPE_PDE
+                    &&  pgmR3PhysLargePageCanPromote(pRam, iFirstPage))
+                {
+                    rc = pgmR3PhysLargePagePromote(pVM, pRam, iFirstPage, pbScratch, &fFlushTLBs);
+                    if (RT_FAILURE(rc))
+                    {
+                        if (rc == VERR_PGM_INVALID_LARGE_PAGE_RANGE)
+                        {
+                            /* No large pages to be had right now, try again later. */
+                            pVM->pgm.s.cLargePagePromoteFailures++;
+                            STAM_REL_COUNTER_INC(&pVM->pgm.s.StatLargePageRefused);
+                            rc = VINF_SUCCESS;
+                        }
+                        fStop = true;
+                        break;
+                    }
+                    pVM->pgm.s.cLargePagePromoteFailures = 0;
+                    cPromoted++;
+                }
+            }
+        }
+        if (!fStop)
+        {
+            pRam   = pRam->pNextR3;
+            GCPhys = pRam ? pRam->GCPhys : 0;
+        }
+    }
+    pVM->pgm.s.GCPhysLargePageCursor = pRam ? GCPhys : 0;
+
+    /*
+     * Do TLB flushing if necessary.
+     */
+    if (fFlushTLBs)
+    {
+        PGM_INVL_ALL_VCPU_TLBS(pVM);
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+            CPUMSetChangedFlags(&pVM->aCpus[idCpu], CPUM_CHANGED_GLOBAL_TLB_FLUSH);
+    }
+
+    pgmUnlock(pVM);
+    return rc;
+}
+
+
+/**
+ * Does one large page promotion pass.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @thread  EMT
+ */
+static DECLCALLBACK(int) pgmR3PhysLargePagePromotePass(PVM pVM)
+{
+    uint8_t *pbScratch = (uint8_t *)RTMemPageAlloc(_2M);
+    if (!pbScratch)
+        return VERR_NO_MEMORY;
+
+    /* We must stall the other VCPUs as they could otherwise modify the pages while we copy them. */
+    STAM_REL_PROFILE_START(&pVM->pgm.s.StatLargePagePromote, a);
+    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3PhysLargePagePromoteRendezvous, pbScratch);
+    STAM_REL_PROFILE_STOP(&pVM->pgm.s.StatLargePagePromote, a);
+    RTMemPageFree(pbScratch, _2M);
+    return rc;
+}
+
+
+/**
+ * Large page promotion helper (called on the way out).
+ *
+ * @param   pVM         Pointer to the VM.
+ */
+static DECLCALLBACK(void) pgmR3PhysLargePagePromoteHelper(PVM pVM)
+{
+    /* Leave the memory alone while it is being saved. */
+    VMSTATE enmState = VMR3GetState(pVM);
+    if (    enmState == VMSTATE_RUNNING
+        &&  !pVM->pgm.s.LiveSave.fActive
+        &&  PGMIsUsingLargePages(pVM))
+    {
+        int rc = pgmR3PhysLargePagePromotePass(pVM);
+        if (RT_FAILURE(rc) && rc != VERR_NO_MEMORY)
+        {
+            LogRel(("PGM: Large page promotion failed with %Rrc, disabled.\n", rc));
+            return;
+        }
+    }
+    else if (   enmState != VMSTATE_RUNNING
+             && enmState != VMSTATE_RUNNING_LS
+             && enmState != VMSTATE_RUNNING_FT
+             && enmState != VMSTATE_SUSPENDED
+             && enmState != VMSTATE_SUSPENDED_LS
+             && enmState != VMSTATE_SUSPENDED_EXT_LS)
+        return; /* the VM is on its way out, let the promotion timer lapse */
+
+    /* Back off while the host has no large pages to spare. */
+    uint32_t const cShift = RT_MIN(pVM->pgm.s.cLargePagePromoteFailures, PGM_LARGE_PAGE_PROMOTE_MAX_BACKOFF_SHIFT);
+    TMTimerSetMillies(pVM->pgm.s.pLargePageTimerR3, pVM->pgm.s.cMsLargePageInterval << cShift);
+}
+
+
+/**
+ * The large page promotion timer callback.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pTimer      The timer handle.
+ * @param   pvUser      Unused.
+ */
+static DECLCALLBACK(void) pgmR3PhysLargePagePromoteTimer(PVM pVM, PTMTIMER pTimer, void *pvUser)
+{
+    NOREF(pTimer); NOREF(pvUser);
+
+    /* Queue the pass as it requires a rendezvous of all the EMTs. */
+    VMR3ReqCallNoWait(pVM, VMCPUID_ANY_QUEUE, (PFNRT)pgmR3PhysLargePagePromoteHelper, 1, pVM);
+}
+
+#endif /* PGM_WITH_LARGE_PAGES */
+
+
+/**
+ * Sets up the background large page promotion pass if large pages are used.
+ *
+ * Ranges that were broken up into 4 KB pages by access handlers, ballooning
+ * or page sharing, or that were populated page by page in the first place,
+ * are remapped onto large host pages once they are fully populated and
+ * nobody is monitoring them any more.  Demotion happens on demand, see
+ * pgmPhysDemoteLargePage.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+int pgmR3PhysLargePagePromoteInit(PVM pVM)
+{
+#ifdef PGM_WITH_LARGE_PAGES
+    PCFGMNODE pCfgPGM = CFGMR3GetChild(CFGMR3GetRoot(pVM), "/PGM");
+    bool fEnabled;
+    int rc = CFGMR3QueryBoolDef(pCfgPGM, "LargePagePromotion", &fEnabled, true);
+    AssertLogRelRCReturn(rc, rc);
+    rc = CFGMR3QueryU32Def(pCfgPGM, "LargePagePromotionInterval", &pVM->pgm.s.cMsLargePageInterval, 1000);
+    AssertLogRelRCReturn(rc, rc);
+    rc = CFGMR3QueryU32Def(pCfgPGM, "LargePagePromotionMax", &pVM->pgm.s.cLargePagePromoteMax, 8);
+    AssertLogRelRCReturn(rc, rc);
+    if (    !fEnabled
+        ||  !pVM->pgm.s.cLargePagePromoteMax
+        ||  pVM->pgm.s.fRamPreAlloc
+        ||  !PGMIsUsingLargePages(pVM)
+        ||  !HWACCMIsNestedPagingActive(pVM))
+        return VINF_SUCCESS;
+    pVM->pgm.s.cMsLargePageInterval = RT_MAX(pVM->pgm.s.cMsLargePageInterval, 10);
+
+    rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL, pgmR3PhysLargePagePromoteTimer, NULL, "PGM Large Page Promotion",
+                                 &pVM->pgm.s.pLargePageTimerR3);
+    AssertLogRelRCReturn(rc, rc);
+    rc = TMTimerSetMillies(pVM->pgm.s.pLargePageTimerR3, pVM->pgm.s.cMsLargePageInterval);
+    AssertLogRelRCReturn(rc, rc);
+
+    LogRel(("PGM: Promoting up to %u large pages every %u ms\n", pVM->pgm.s.cLargePagePromoteMax, pVM->pgm.s.cMsLargePageInterval));
+#else
+    NOREF(pVM);
+#endif
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Does one large page promotion pass right away, regardless of the timer and
+ * the VM state.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+VMMR3DECL(int) PGMR3PhysLargePagePromoteNow(PVM pVM)
+{
+    /* For tstPGMLargePage, which can't wait for the promotion timer and its back-off. */
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+#ifdef PGM_WITH_LARGE_PAGES
+    AssertReturn(PGMIsUsingLargePages(pVM), VERR_INVALID_STATE);
+    return VMR3ReqCallWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PhysLargePagePromotePass, 1, pVM);
+#else
+    return VERR_NOT_IMPLEMENTED;
+#endif
+}
+
+
 /**
  * Response to VM_FF_PGM_NEED_HANDY_PAGES and VMMCALLRING3_PGM_ALLOCATE_HANDY_PAGES.
  *
@@ -4502,7 +5122,17 @@ int pgmPhysFreePage(PVM pVM, PGMMFREEPAGESREQ pReq, uint32_t *pcPendingPages, PP
         return VMSetError(pVM, VERR_PGM_PHYS_NOT_RAM, RT_SRC_POS, "GCPhys=%RGp type=%d", GCPhys, PGM_PAGE_GET_TYPE(pPage));
     }
 
-    /** @todo What about ballooning of large pages??! */
+#ifdef PGM_WITH_LARGE_PAGES
+    /* Break up large pages on demand, e.g. when ballooning. */
+    if (   PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE
+        || PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+    {
+        bool fFlushTLBs = false;
+        pgmPhysDemoteLargePage(pVM, GCPhys, &fFlushTLBs);
+        if (fFlushTLBs)
+            PGM_INVL_ALL_VCPU_TLBS(pVM);
+    }
+#endif
     Assert(   PGM_PAGE_GET_PDE_TYPE(pPage) != PGM_PAGE_PDE_TYPE_PDE
            && PGM_PAGE_GET_PDE_TYPE(pPage) != PGM_PAGE_PDE_TYPE_PDE_DISABLED);
 
@@ -0,0 +1,936 @@
+/* $Id$ */
+/** @file
+ * PGM - Page Manager and Monitor, Post-Copy Teleportation.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/** @page pg_pgm_postcopy  PGM Post-Copy Teleportation
+ *
+ * In post-copy mode the source does not iterate on the guest RAM while the VM
+ * keeps running.  Instead, the final saved state pass replaces every RAM page
+ * with real content by a PGM_STATE_REC_RAM_REMOTE record and remembers the
+ * address (PGMPOSTCOPY::paGCPhys).  The target resumes the VM right after
+ * loading the (now small) state, with all the remote pages covered by
+ * physical access handlers.
+ *
+ * The teleporter keeps the connection open afterwards.  The source pushes the
+ * remote pages in ascending order (PGMR3PostCopyNextPage) and the target hands
+ * them to PGMR3PostCopyPageArrived, which stages them and gets an EMT to
+ * install them.  When the guest touches a page before it has arrived, the
+ * access handler asks the source for it via the callback given to
+ * PGMR3PostCopyStart and blocks the EMT until it shows up.  The source moves
+ * requested pages to the front of the queue.
+ *
+ * Installing a page means writing it into guest memory and switching off the
+ * access handler for it (PGMHandlerPhysicalPageTempOff).  Once all pages are
+ * in, the handlers are deregistered.  Should the connection be lost before
+ * that, the guest cannot continue: the first access to a missing page raises
+ * a fatal runtime error (PGMPostCopyAborted) and the access itself is dropped
+ * (reads return all ones).
+ *
+ * The request callback talks to the network, so it is called without owning
+ * PGMPOSTCOPY::CritSect.  PGMPOSTCOPY::cRequestsBusy counts the EMTs inside it
+ * and PGMR3PostCopyTerm waits for them before returning.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#define LOG_GROUP LOG_GROUP_PGM
+#include <VBox/vmm/pgm.h>
+#include "PGMInternal.h"
+#include <VBox/vmm/vm.h>
+#include "PGMInline.h"
+
+#include <VBox/param.h>
+#include <VBox/err.h>
+#include <VBox/log.h>
+
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/critsect.h>
+#include <iprt/list.h>
+#include <iprt/mem.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The max number of non-remote RAM pages we'll cover by a handler to merge two
+ * runs of remote pages. */
+#define PGM_POST_COPY_MAX_GAP_PAGES     64
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * A range of guest physical memory covered by a post-copy access handler.
+ */
+typedef struct PGMPOSTCOPYRUN
+{
+    /** The first address. */
+    RTGCPHYS                GCPhys;
+    /** The last address (inclusive). */
+    RTGCPHYS                GCPhysLast;
+} PGMPOSTCOPYRUN;
+/** Pointer to a post-copy handler range. */
+typedef PGMPOSTCOPYRUN *PPGMPOSTCOPYRUN;
+
+
+/**
+ * A page received from the source that's waiting for an EMT to install it.
+ */
+typedef struct PGMPOSTCOPYPAGE
+{
+    /** Node in PGMPOSTCOPY::StagedPages. */
+    RTLISTNODE              Node;
+    /** The guest physical address of the page. */
+    RTGCPHYS                GCPhys;
+    /** The page content. */
+    uint8_t                 abPage[PAGE_SIZE];
+} PGMPOSTCOPYPAGE;
+/** Pointer to a staged post-copy page. */
+typedef PGMPOSTCOPYPAGE *PPGMPOSTCOPYPAGE;
+
+
+/**
+ * The post-copy state, PGM::pPostCopyR3.
+ */
+typedef struct PGMPOSTCOPY
+{
+    /** Set on the source, clear on the target. */
+    bool                    fSource;
+    /** Set when the target has given up on the source (connection lost). */
+    bool volatile           fAborted;
+    /** Set while a pgmR3PostCopyDrain request is pending. */
+    bool                    fDrainQueued;
+    /** Set while the access handlers are registered (target). */
+    bool                    fHandlers;
+    /** Set once the abort has been reported as a runtime error (target). */
+    bool volatile           fAbortReported;
+    /** The number of remote pages (entries in paGCPhys). */
+    uint32_t                cPages;
+    /** The number of entries allocated for paGCPhys. */
+    uint32_t                cPagesAlloc;
+    /** The number of bits set in pbmOutstanding. */
+    uint32_t                cOutstanding;
+    /** The push cursor (source). */
+    uint32_t                iNext;
+    /** The number of handler ranges in paRuns. */
+    uint32_t                cRuns;
+    /** The remote page addresses, sorted. */
+    PRTGCPHYS               paGCPhys;
+    /** Bitmap parallel to paGCPhys: not yet sent (source) or not yet installed
+     * (target). */
+    uint32_t               *pbmOutstanding;
+    /** The handler ranges, sorted (target). */
+    PPGMPOSTCOPYRUN         paRuns;
+
+    /** Requests a page from the source (target). */
+    PFNPGMPOSTCOPYREQUEST   pfnRequest;
+    /** User argument for pfnRequest. */
+    void                   *pvUser;
+    /** The number of EMTs calling pfnRequest right now. */
+    uint32_t volatile       cRequestsBusy;
+    /** Protects the target members above and StagedPages. */
+    RTCRITSECT              CritSect;
+    /** Signalled when pages arrive or installing them is aborted (target). */
+    RTSEMEVENTMULTI         hEvtArrived;
+    /** Received pages waiting to be installed (PGMPOSTCOPYPAGE). */
+    RTLISTANCHOR            StagedPages;
+
+    /** Statistics: the number of pages the guest had to wait for. */
+    uint32_t                cDemandFaults;
+    /** Statistics: the number of pages received. */
+    uint32_t                cReceived;
+} PGMPOSTCOPY;
+/** Pointer to the post-copy state. */
+typedef PGMPOSTCOPY *PPGMPOSTCOPY;
+
+
+/*******************************************************************************
+*   Internal Functions                                                         *
+*******************************************************************************/
+static DECLCALLBACK(void) pgmR3PostCopyDrain(PVM pVM);
+static DECLCALLBACK(int) pgmR3PostCopyHandler(PVM pVM, RTGCPHYS GCPhys, void *pvPhys, void *pvBuf, size_t cbBuf,
+                                              PGMACCESSTYPE enmAccessType, void *pvUser);
+
+
+/**
+ * Creates the post-copy state.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   fSource     Whether this is the source or the target.
+ */
+static int pgmR3PostCopyCreate(PVM pVM, bool fSource)
+{
+    PPGMPOSTCOPY pPostCopy = (PPGMPOSTCOPY)RTMemAllocZ(sizeof(*pPostCopy));
+    if (!pPostCopy)
+        return VERR_NO_MEMORY;
+    pPostCopy->fSource     = fSource;
+    pPostCopy->hEvtArrived = NIL_RTSEMEVENTMULTI;
+    RTListInit(&pPostCopy->StagedPages);
+    pVM->pgm.s.pPostCopyR3 = pPostCopy;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Frees the post-copy state, if any.
+ *
+ * The access handlers must be gone and no EMT may be using the state.
+ *
+ * @param   pVM         Pointer to the VM.
+ */
+void pgmR3PostCopyDestroy(PVM pVM)
+{
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    if (!pPostCopy)
+        return;
+    pVM->pgm.s.pPostCopyR3 = NULL;
+
+    PPGMPOSTCOPYPAGE pCur, pNext;
+    RTListForEachSafe(&pPostCopy->StagedPages, pCur, pNext, PGMPOSTCOPYPAGE, Node)
+    {
+        RTListNodeRemove(&pCur->Node);
+        RTMemFree(pCur);
+    }
+    if (RTCritSectIsInitialized(&pPostCopy->CritSect))
+        RTCritSectDelete(&pPostCopy->CritSect);
+    if (pPostCopy->hEvtArrived != NIL_RTSEMEVENTMULTI)
+        RTSemEventMultiDestroy(pPostCopy->hEvtArrived);
+    RTMemFree(pPostCopy->paGCPhys);
+    RTMemFree(pPostCopy->pbmOutstanding);
+    RTMemFree(pPostCopy->paRuns);
+    RTMemFree(pPostCopy);
+}
+
+
+/**
+ * Looks up a remote page.
+ *
+ * @returns Index into PGMPOSTCOPY::paGCPhys, UINT32_MAX if not a remote page.
+ * @param   pPostCopy   The post-copy state.
+ * @param   GCPhys      The page address.
+ */
+static uint32_t pgmR3PostCopyLookupPage(PPGMPOSTCOPY pPostCopy, RTGCPHYS GCPhys)
+{
+    uint32_t iStart = 0;
+    uint32_t iEnd   = pPostCopy->cPages;
+    while (iStart < iEnd)
+    {
+        uint32_t i = iStart + (iEnd - iStart) / 2;
+        RTGCPHYS GCPhysCur = pPostCopy->paGCPhys[i];
+        if (GCPhys < GCPhysCur)
+            iEnd = i;
+        else if (GCPhys > GCPhysCur)
+            iStart = i + 1;
+        else
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+
+/**
+ * Looks up the handler range covering a page.
+ *
+ * @returns Pointer to the range, NULL if not found.
+ * @param   pPostCopy   The post-copy state.
+ * @param   GCPhys      The page address.
+ */
+static PPGMPOSTCOPYRUN pgmR3PostCopyLookupRun(PPGMPOSTCOPY pPostCopy, RTGCPHYS GCPhys)
+{
+    uint32_t iStart = 0;
+    uint32_t iEnd   = pPostCopy->cRuns;
+    while (iStart < iEnd)
+    {
+        uint32_t i = iStart + (iEnd - iStart) / 2;
+        PPGMPOSTCOPYRUN pRun = &pPostCopy->paRuns[i];
+        if (GCPhys < pRun->GCPhys)
+            iEnd = i;
+        else if (GCPhys > pRun->GCPhysLast)
+            iStart = i + 1;
+        else
+            return pRun;
+    }
+    return NULL;
+}
+
+
+/**
+ * Records a RAM page that isn't part of the saved state.
+ *
+ * Called by the saved state code for each PGM_STATE_REC_RAM_REMOTE record it
+ * writes (source) or reads (target).  The pages must come in ascending order.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   fSource     Whether this is the source or the target.
+ * @param   GCPhys      The page address.
+ */
+int pgmR3PostCopyAddPage(PVM pVM, bool fSource, RTGCPHYS GCPhys)
+{
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    if (!pPostCopy)
+    {
+        AssertReturn(!fSource, VERR_INTERNAL_ERROR_2);
+        int rc = pgmR3PostCopyCreate(pVM, false /*fSource*/);
+        if (RT_FAILURE(rc))
+            return rc;
+        pPostCopy = pVM->pgm.s.pPostCopyR3;
+    }
+    AssertReturn(pPostCopy->fSource == fSource, VERR_INTERNAL_ERROR_3);
+    AssertReturn(!pPostCopy->fHandlers, VERR_WRONG_ORDER);
+    AssertLogRelMsgReturn(   !pPostCopy->cPages
+                          || pPostCopy->paGCPhys[pPostCopy->cPages - 1] < GCPhys,
+                          ("%RGp\n", GCPhys), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+
+    if (pPostCopy->cPages >= pPostCopy->cPagesAlloc)
+    {
+        uint32_t cNew = pPostCopy->cPagesAlloc ? pPostCopy->cPagesAlloc * 2 : _16K;
+        void *pvNew = RTMemRealloc(pPostCopy->paGCPhys, cNew * sizeof(RTGCPHYS));
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pPostCopy->paGCPhys = (PRTGCPHYS)pvNew;
+
+        pvNew = RTMemRealloc(pPostCopy->pbmOutstanding, cNew / 8);
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pPostCopy->pbmOutstanding = (uint32_t *)pvNew;
+        pPostCopy->cPagesAlloc = cNew;
+    }
+
+    uint32_t iPage = pPostCopy->cPages++;
+    pPostCopy->paGCPhys[iPage] = GCPhys;
+    ASMBitSet(pPostCopy->pbmOutstanding, iPage);
+    pPostCopy->cOutstanding++;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks if the final saved state pass should leave the RAM pages out.
+ *
+ * @returns true if post-copy saving is enabled, false if not.
+ * @param   pVM         Pointer to the VM.
+ */
+bool pgmR3PostCopyIsSaving(PVM pVM)
+{
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    return pPostCopy
+        && pPostCopy->fSource;
+}
+
+
+/**
+ * Enables post-copy mode for the next live save (teleportation) on the source.
+ *
+ * The live passes will only cover ROM and MMIO2 pages and the final pass will
+ * leave out all RAM pages with content, which must then be transferred using
+ * PGMR3PostCopyNextPage after the save has completed.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @thread  Any, but the VM must not be saving.
+ */
+VMMR3DECL(int) PGMR3PostCopyEnable(PVM pVM)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertReturn(!pVM->pgm.s.LiveSave.fActive, VERR_WRONG_ORDER);
+
+    pgmR3PostCopyDestroy(pVM);
+    return pgmR3PostCopyCreate(pVM, true /*fSource*/);
+}
+
+
+/**
+ * Gets the next page to send to the target (source).
+ *
+ * @returns VBox status code.
+ * @retval  VERR_EOF when all pages have been sent.
+ *
+ * @param   pVM             Pointer to the VM.
+ * @param   GCPhysWanted    The page the target asked for, NIL_RTGCPHYS if
+ *                          none.  If this was already sent, the next page in
+ *                          the queue is returned instead.
+ * @param   pGCPhys         Where to return the address of the page.
+ * @param   pvPage          Where to return the page content (PAGE_SIZE).
+ * @thread  Any but EMTs.  The VM must be suspended.
+ */
+VMMR3DECL(int) PGMR3PostCopyNextPage(PVM pVM, RTGCPHYS GCPhysWanted, PRTGCPHYS pGCPhys, void *pvPage)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    AssertReturn(pPostCopy && pPostCopy->fSource, VERR_WRONG_ORDER);
+    AssertPtrReturn(pGCPhys, VERR_INVALID_POINTER);
+    AssertPtrReturn(pvPage, VERR_INVALID_POINTER);
+
+    uint32_t iPage = UINT32_MAX;
+    if (GCPhysWanted != NIL_RTGCPHYS)
+    {
+        iPage = pgmR3PostCopyLookupPage(pPostCopy, GCPhysWanted & ~(RTGCPHYS)PAGE_OFFSET_MASK);
+        if (   iPage != UINT32_MAX
+            && !ASMBitTest(pPostCopy->pbmOutstanding, iPage))
+            iPage = UINT32_MAX;
+    }
+    if (iPage == UINT32_MAX)
+    {
+        while (   pPostCopy->iNext < pPostCopy->cPages
+               && !ASMBitTest(pPostCopy->pbmOutstanding, pPostCopy->iNext))
+            pPostCopy->iNext++;
+        if (pPostCopy->iNext >= pPostCopy->cPages)
+            return VERR_EOF;
+        iPage = pPostCopy->iNext++;
+    }
+
+    int rc = PGMR3PhysReadExternal(pVM, pPostCopy->paGCPhys[iPage], pvPage, PAGE_SIZE);
+    if (RT_SUCCESS(rc))
+    {
+        ASMBitClear(pPostCopy->pbmOutstanding, iPage);
+        pPostCopy->cOutstanding--;
+        *pGCPhys = pPostCopy->paGCPhys[iPage];
+    }
+    return rc;
+}
+
+
+/**
+ * Installs a page received from the source.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pPostCopy   The post-copy state.
+ * @param   GCPhys      The page address.
+ * @param   pvPage      The page content.
+ * @thread  EMT.
+ */
+static int pgmR3PostCopyInstall(PVM pVM, PPGMPOSTCOPY pPostCopy, RTGCPHYS GCPhys, void const *pvPage)
+{
+    int rc = VINF_SUCCESS;
+    RTCritSectEnter(&pPostCopy->CritSect);
+
+    uint32_t iPage = pgmR3PostCopyLookupPage(pPostCopy, GCPhys);
+    if (   iPage != UINT32_MAX
+        && ASMBitTest(pPostCopy->pbmOutstanding, iPage))
+    {
+        PPGMPOSTCOPYRUN pRun = pgmR3PostCopyLookupRun(pPostCopy, GCPhys);
+        AssertPtr(pRun);
+
+        rc = PGMPhysSimpleWriteGCPhys(pVM, GCPhys, pvPage, PAGE_SIZE);
+        if (RT_SUCCESS(rc) && pRun)
+            rc = PGMHandlerPhysicalPageTempOff(pVM, pRun->GCPhys, GCPhys);
+        AssertLogRelMsgRC(rc, ("GCPhys=%RGp rc=%Rrc\n", GCPhys, rc));
+        if (RT_SUCCESS(rc))
+        {
+            ASMBitClear(pPostCopy->pbmOutstanding, iPage);
+            if (!--pPostCopy->cOutstanding)
+            {
+                /* Can't deregister the handlers here as we might be called
+                   from one of them. */
+                int rc2 = VMR3ReqCallVoidNoWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PostCopyDrain, 1, pVM);
+                AssertRC(rc2);
+            }
+        }
+        RTSemEventMultiSignal(pPostCopy->hEvtArrived);
+    }
+
+    RTCritSectLeave(&pPostCopy->CritSect);
+    return rc;
+}
+
+
+/**
+ * Deregisters the access handlers once all pages are in.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pPostCopy   The post-copy state.
+ * @thread  EMT, owner of PGMPOSTCOPY::CritSect.
+ */
+static void pgmR3PostCopyCompleteLocked(PVM pVM, PPGMPOSTCOPY pPostCopy)
+{
+    Assert(!pPostCopy->cOutstanding);
+    if (!pPostCopy->fHandlers)
+        return;
+
+    for (uint32_t i = 0; i < pPostCopy->cRuns; i++)
+    {
+        int rc = PGMHandlerPhysicalDeregister(pVM, pPostCopy->paRuns[i].GCPhys);
+        AssertLogRelRC(rc);
+    }
+    pPostCopy->fHandlers = false;
+    LogRel(("PGM: Post-copy completed: %u pages, %u demand faults\n", pPostCopy->cPages, pPostCopy->cDemandFaults));
+
+    /* Nothing uses the lookup tables any more. */
+    RTMemFree(pPostCopy->paRuns);
+    pPostCopy->paRuns = NULL;
+    pPostCopy->cRuns = 0;
+    RTMemFree(pPostCopy->paGCPhys);
+    pPostCopy->paGCPhys = NULL;
+    RTMemFree(pPostCopy->pbmOutstanding);
+    pPostCopy->pbmOutstanding = NULL;
+    pPostCopy->cPages = pPostCopy->cPagesAlloc = 0;
+}
+
+
+/**
+ * Installs the staged pages and completes post-copy when they're all in.
+ *
+ * Queued by PGMR3PostCopyPageArrived and pgmR3PostCopyInstall.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @thread  EMT.
+ */
+static DECLCALLBACK(void) pgmR3PostCopyDrain(PVM pVM)
+{
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    if (!pPostCopy || pPostCopy->fSource)
+        return;
+
+    for (;;)
+    {
+        RTCritSectEnter(&pPostCopy->CritSect);
+        PPGMPOSTCOPYPAGE pPage = RTListGetFirst(&pPostCopy->StagedPages, PGMPOSTCOPYPAGE, Node);
+        if (!pPage)
+        {
+            pPostCopy->fDrainQueued = false;
+            if (!pPostCopy->cOutstanding)
+                pgmR3PostCopyCompleteLocked(pVM, pPostCopy);
+            RTCritSectLeave(&pPostCopy->CritSect);
+            break;
+        }
+        RTListNodeRemove(&pPage->Node);
+        RTCritSectLeave(&pPostCopy->CritSect);
+
+        pgmR3PostCopyInstall(pVM, pPostCopy, pPage->GCPhys, pPage->abPage);
+        RTMemFree(pPage);
+    }
+}
+
+
+/**
+ * Waits for a remote page to be installed, requesting it from the source.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_PGM_POST_COPY_ABORTED if the page will never arrive.
+ * @param   pVM         Pointer to the VM.
+ * @param   pPostCopy   The post-copy state.
+ * @param   GCPhys      The page address.
+ * @thread  EMT.
+ */
+static int pgmR3PostCopyWaitForPage(PVM pVM, PPGMPOSTCOPY pPostCopy, RTGCPHYS GCPhys)
+{
+    bool fRequested = false;
+    for (;;)
+    {
+        RTCritSectEnter(&pPostCopy->CritSect);
+        uint32_t iPage = pgmR3PostCopyLookupPage(pPostCopy, GCPhys);
+        if (   iPage == UINT32_MAX
+            || !ASMBitTest(pPostCopy->pbmOutstanding, iPage))
+        {
+            RTCritSectLeave(&pPostCopy->CritSect);
+            return VINF_SUCCESS;
+        }
+
+        /* Install whatever has arrived while we're here anyway. */
+        PPGMPOSTCOPYPAGE pPage = RTListGetFirst(&pPostCopy->StagedPages, PGMPOSTCOPYPAGE, Node);
+        if (pPage)
+        {
+            RTListNodeRemove(&pPage->Node);
+            RTCritSectLeave(&pPostCopy->CritSect);
+            pgmR3PostCopyInstall(pVM, pPostCopy, pPage->GCPhys, pPage->abPage);
+            RTMemFree(pPage);
+            continue;
+        }
+
+        /* Nothing more will arrive once PGMR3PostCopyTerm has been called. */
+        if (pPostCopy->fAborted || !pPostCopy->pfnRequest)
+        {
+            RTCritSectLeave(&pPostCopy->CritSect);
+            return VERR_PGM_POST_COPY_ABORTED;
+        }
+        RTSemEventMultiReset(pPostCopy->hEvtArrived);
+
+        if (!fRequested)
+        {
+            /* Don't own the critsect while talking to the source, the other
+               EMTs and the receiver need it.  cRequestsBusy keeps pfnRequest
+               and pvUser valid until we're done. */
+            PFNPGMPOSTCOPYREQUEST pfnRequest = pPostCopy->pfnRequest;
+            void                 *pvUser     = pPostCopy->pvUser;
+            pPostCopy->cDemandFaults++;
+            ASMAtomicIncU32(&pPostCopy->cRequestsBusy);
+            RTCritSectLeave(&pPostCopy->CritSect);
+
+            int rc = pfnRequest(pVM, GCPhys, pvUser);
+            ASMAtomicDecU32(&pPostCopy->cRequestsBusy);
+            if (RT_FAILURE(rc))
+            {
+                LogRel(("PGM: Post-copy request for %RGp failed: %Rrc\n", GCPhys, rc));
+                return VERR_PGM_POST_COPY_ABORTED;
+            }
+            fRequested = true;
+            continue; /* It may have arrived already. */
+        }
+        RTCritSectLeave(&pPostCopy->CritSect);
+
+        RTSemEventMultiWait(pPostCopy->hEvtArrived, 1000);
+    }
+}
+
+
+/**
+ * Raises the runtime error for a failed post-copy.
+ *
+ * Queued by pgmR3PostCopyHandler as the handler itself can't stop the VM.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @thread  EMT.
+ */
+static DECLCALLBACK(void) pgmR3PostCopyRaiseAbortError(PVM pVM)
+{
+    VMSetRuntimeError(pVM, VMSETRTERR_FLAGS_FATAL, "PGMPostCopyAborted",
+                      N_("The connection to the teleportation source was lost before all of the guest memory was transferred. "
+                         "The VM cannot continue"));
+}
+
+
+/**
+ * \#PF Handler callback for remote pages (target).
+ *
+ * @returns VINF_SUCCESS if the handler has carried out the operation.
+ * @returns VINF_PGM_HANDLER_DO_DEFAULT if the caller should carry out the access operation.
+ * @param   pVM             Pointer to the VM.
+ * @param   GCPhys          The physical address the guest is accessing.
+ * @param   pvPhys          The HC mapping of that address.
+ * @param   pvBuf           What the guest is reading/writing.
+ * @param   cbBuf           How much it's reading/writing.
+ * @param   enmAccessType   The access type.
+ * @param   pvUser          The post-copy state.
+ */
+static DECLCALLBACK(int) pgmR3PostCopyHandler(PVM pVM, RTGCPHYS GCPhys, void *pvPhys, void *pvBuf, size_t cbBuf,
+                                              PGMACCESSTYPE enmAccessType, void *pvUser)
+{
+    PPGMPOSTCOPY pPostCopy = (PPGMPOSTCOPY)pvUser;
+    NOREF(pvPhys);
+
+    int rc = pgmR3PostCopyWaitForPage(pVM, pPostCopy, GCPhys & ~(RTGCPHYS)PAGE_OFFSET_MASK);
+    if (RT_FAILURE(rc))
+    {
+        /* The content is lost for good.  Stop the VM and drop the access, the
+           callers only know how to deal with VINF_SUCCESS and DO_DEFAULT. */
+        if (!ASMAtomicXchgBool(&pPostCopy->fAbortReported, true))
+        {
+            int rc2 = VMR3ReqCallVoidNoWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PostCopyRaiseAbortError, 1, pVM);
+            AssertRC(rc2);
+        }
+        if (enmAccessType == PGMACCESSTYPE_READ)
+            memset(pvBuf, 0xff, cbBuf);
+        return VINF_SUCCESS;
+    }
+
+    /* The read mapping may still point to the zero page, so reread it. */
+    if (enmAccessType == PGMACCESSTYPE_READ)
+        return PGMPhysSimpleReadGCPhys(pVM, pvBuf, GCPhys, cbBuf);
+    return VINF_PGM_HANDLER_DO_DEFAULT;
+}
+
+
+/**
+ * Checks whether a gap between two remote pages can be covered by the same
+ * access handler.
+ *
+ * @returns true if it can, false if not.
+ * @param   pVM             Pointer to the VM.
+ * @param   GCPhysFirst     The first page of the gap.
+ * @param   GCPhysLast      The last page of the gap.
+ */
+static bool pgmR3PostCopyCanBridge(PVM pVM, RTGCPHYS GCPhysFirst, RTGCPHYS GCPhysLast)
+{
+    if ((GCPhysLast - GCPhysFirst) >> PAGE_SHIFT >= PGM_POST_COPY_MAX_GAP_PAGES)
+        return false;
+    PPGMRAMRANGE pRam = pgmPhysGetRange(pVM, GCPhysFirst);
+    if (   !pRam
+        || GCPhysLast + PAGE_SIZE - 1 > pRam->GCPhysLast)
+        return false;
+    for (RTGCPHYS GCPhys = GCPhysFirst; GCPhys <= GCPhysLast; GCPhys += PAGE_SIZE)
+    {
+        PPGMPAGE pPage = &pRam->aPages[(GCPhys - pRam->GCPhys) >> PAGE_SHIFT];
+        if (   PGM_PAGE_GET_TYPE(pPage) != PGMPAGETYPE_RAM
+            || PGM_PAGE_HAS_ANY_HANDLERS(pPage))
+            return false;
+    }
+    return true;
+}
+
+
+/**
+ * EMT worker for PGMR3PostCopyStart.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pPostCopy   The post-copy state.
+ * @thread  EMT.
+ */
+static DECLCALLBACK(int) pgmR3PostCopyStartOnEmt(PVM pVM, PPGMPOSTCOPY pPostCopy)
+{
+    /*
+     * Group the pages into handler ranges, bridging small gaps of ordinary
+     * RAM pages to keep the number of handlers down.
+     */
+    PPGMPOSTCOPYRUN paRuns = (PPGMPOSTCOPYRUN)RTMemAlloc(sizeof(paRuns[0]) * pPostCopy->cPages);
+    if (!paRuns)
+        return VERR_NO_MEMORY;
+    uint32_t cRuns = 0;
+
+    pgmLock(pVM);
+    for (uint32_t iPage = 0; iPage < pPostCopy->cPages; iPage++)
+    {
+        RTGCPHYS GCPhys = pPostCopy->paGCPhys[iPage];
+        if (   cRuns
+            && (   paRuns[cRuns - 1].GCPhysLast + 1 == GCPhys
+                || pgmR3PostCopyCanBridge(pVM, paRuns[cRuns - 1].GCPhysLast + 1, GCPhys - PAGE_SIZE))
+            && pgmPhysGetRange(pVM, paRuns[cRuns - 1].GCPhys) == pgmPhysGetRange(pVM, GCPhys))
+            paRuns[cRuns - 1].GCPhysLast = GCPhys | PAGE_OFFSET_MASK;
+        else
+        {
+            paRuns[cRuns].GCPhys     = GCPhys;
+            paRuns[cRuns].GCPhysLast = GCPhys | PAGE_OFFSET_MASK;
+            cRuns++;
+        }
+    }
+    pgmUnlock(pVM);
+
+    /*
+     * Register them and switch them off for the bridged pages.
+     */
+    int rc = VINF_SUCCESS;
+    uint32_t iPage = 0;
+    uint32_t iRun;
+    for (iRun = 0; iRun < cRuns; iRun++)
+    {
+        rc = PGMR3HandlerPhysicalRegister(pVM, PGMPHYSHANDLERTYPE_PHYSICAL_ALL, paRuns[iRun].GCPhys, paRuns[iRun].GCPhysLast,
+                                          pgmR3PostCopyHandler, pPostCopy,
+                                          NULL, NULL, NIL_RTR0PTR,
+                                          NULL, NULL, NIL_RTRCPTR,
+                                          "Post-copy RAM");
+        if (RT_FAILURE(rc))
+            break;
+        for (RTGCPHYS GCPhys = paRuns[iRun].GCPhys; GCPhys < paRuns[iRun].GCPhysLast; GCPhys += PAGE_SIZE)
+        {
+            if (   iPage < pPostCopy->cPages
+                && pPostCopy->paGCPhys[iPage] == GCPhys)
+                iPage++;
+            else
+            {
+                rc = PGMHandlerPhysicalPageTempOff(pVM, paRuns[iRun].GCPhys, GCPhys);
+                AssertRCBreak(rc);
+            }
+        }
+        if (RT_FAILURE(rc))
+        {
+            iRun++;
+            break;
+        }
+    }
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("PGM: Failed to set up post-copy handler for %RGp-%RGp: %Rrc\n",
+                paRuns[RT_MIN(iRun, cRuns - 1)].GCPhys, paRuns[RT_MIN(iRun, cRuns - 1)].GCPhysLast, rc));
+        while (iRun-- > 0)
+            PGMHandlerPhysicalDeregister(pVM, paRuns[iRun].GCPhys);
+        RTMemFree(paRuns);
+        return rc;
+    }
+
+    RTCritSectEnter(&pPostCopy->CritSect);
+    pPostCopy->paRuns    = paRuns;
+    pPostCopy->cRuns     = cRuns;
+    pPostCopy->fHandlers = true;
+    RTCritSectLeave(&pPostCopy->CritSect);
+
+    LogRel(("PGM: Post-copy: %u remote pages in %u ranges\n", pPostCopy->cPages, cRuns));
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Starts fetching the remote pages after the state has been loaded (target).
+ *
+ * This installs access handlers on the RAM pages missing from the saved state
+ * and must be called before the VM is resumed.  The guest will block in
+ * pfnRequest when it touches a missing page, while all the other pages must
+ * be fed to PGMR3PostCopyPageArrived as they come in.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS if the saved state had no remote pages.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pfnRequest  Callback for requesting a page from the source.  Will
+ *                      be called on an EMT, but never after
+ *                      PGMR3PostCopyTerm has returned.
+ * @param   pvUser      User argument for pfnRequest.
+ * @thread  Any but EMTs.
+ */
+VMMR3DECL(int) PGMR3PostCopyStart(PVM pVM, PFNPGMPOSTCOPYREQUEST pfnRequest, void *pvUser)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(pfnRequest, VERR_INVALID_POINTER);
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    if (!pPostCopy)
+        return VINF_SUCCESS;
+    AssertReturn(!pPostCopy->fSource && !pPostCopy->fHandlers, VERR_WRONG_ORDER);
+
+    pPostCopy->pfnRequest = pfnRequest;
+    pPostCopy->pvUser     = pvUser;
+    int rc = RTCritSectInit(&pPostCopy->CritSect);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTSemEventMultiCreate(&pPostCopy->hEvtArrived);
+        if (RT_SUCCESS(rc))
+        {
+            rc = VMR3ReqCallWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PostCopyStartOnEmt, 2, pVM, pPostCopy);
+            if (RT_SUCCESS(rc))
+                return rc;
+        }
+    }
+    pgmR3PostCopyDestroy(pVM);
+    return rc;
+}
+
+
+/**
+ * Hands a page received from the source to PGM (target).
+ *
+ * The page is installed by an EMT later on.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   GCPhys      The page address.
+ * @param   pvPage      The page content (PAGE_SIZE).
+ * @thread  Any.
+ */
+VMMR3DECL(int) PGMR3PostCopyPageArrived(PVM pVM, RTGCPHYS GCPhys, void const *pvPage)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    AssertReturn(pPostCopy && !pPostCopy->fSource && pPostCopy->fHandlers, VERR_WRONG_ORDER);
+    AssertReturn(!(GCPhys & PAGE_OFFSET_MASK), VERR_INVALID_PARAMETER);
+
+    PPGMPOSTCOPYPAGE pPage = (PPGMPOSTCOPYPAGE)RTMemAlloc(sizeof(*pPage));
+    if (!pPage)
+        return VERR_NO_MEMORY;
+    pPage->GCPhys = GCPhys;
+    memcpy(pPage->abPage, pvPage, PAGE_SIZE);
+
+    RTCritSectEnter(&pPostCopy->CritSect);
+    RTListAppend(&pPostCopy->StagedPages, &pPage->Node);
+    pPostCopy->cReceived++;
+    bool const fQueue = !pPostCopy->fDrainQueued;
+    pPostCopy->fDrainQueued = true;
+    RTSemEventMultiSignal(pPostCopy->hEvtArrived);
+    RTCritSectLeave(&pPostCopy->CritSect);
+
+    if (fQueue)
+        return VMR3ReqCallVoidNoWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PostCopyDrain, 1, pVM);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Gets the number of remote pages not yet sent (source) or installed (target).
+ *
+ * @returns Page count, 0 if not in post-copy mode.
+ * @param   pVM         Pointer to the VM.
+ */
+VMMR3DECL(uint32_t) PGMR3PostCopyGetOutstanding(PVM pVM)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, 0);
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    return pPostCopy ? ASMAtomicReadU32(&pPostCopy->cOutstanding) : 0;
+}
+
+
+/**
+ * EMT worker for PGMR3PostCopyTerm on the target.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @thread  EMT.
+ */
+static DECLCALLBACK(void) pgmR3PostCopyTermOnEmt(PVM pVM)
+{
+    pgmR3PostCopyDrain(pVM);
+
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    RTCritSectEnter(&pPostCopy->CritSect);
+    if (pPostCopy->cOutstanding)
+    {
+        LogRel(("PGM: Post-copy aborted with %u of %u pages missing!\n", pPostCopy->cOutstanding, pPostCopy->cPages));
+        ASMAtomicWriteBool(&pPostCopy->fAborted, true);
+        RTSemEventMultiSignal(pPostCopy->hEvtArrived);
+    }
+    RTCritSectLeave(&pPostCopy->CritSect);
+}
+
+
+/**
+ * Ends post-copy mode.
+ *
+ * On the source this just frees the state.  On the target all received pages
+ * are installed; if some are still missing, accessing them will from now on
+ * stop the VM with a fatal runtime error.  The request callback is not called
+ * any more once this returns.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_PGM_POST_COPY_ABORTED if pages are missing on the target.
+ * @param   pVM         Pointer to the VM.
+ * @thread  Any but EMTs.
+ */
+VMMR3DECL(int) PGMR3PostCopyTerm(PVM pVM)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    PPGMPOSTCOPY pPostCopy = pVM->pgm.s.pPostCopyR3;
+    if (!pPostCopy)
+        return VINF_SUCCESS;
+
+    if (   pPostCopy->fSource
+        || !RTCritSectIsInitialized(&pPostCopy->CritSect))
+    {
+        pgmR3PostCopyDestroy(pVM);
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * No new requests, wake up the EMTs waiting for pages that won't come and
+     * wait for those still talking to the source.
+     */
+    RTCritSectEnter(&pPostCopy->CritSect);
+    pPostCopy->pfnRequest = NULL;
+    pPostCopy->pvUser     = NULL;
+    RTSemEventMultiSignal(pPostCopy->hEvtArrived);
+    RTCritSectLeave(&pPostCopy->CritSect);
+    while (ASMAtomicReadU32(&pPostCopy->cRequestsBusy))
+        RTThreadSleep(1);
+
+    /* The handlers may still be needed, pgmR3PostCopyDestroy is called by PGMR3Term. */
+    int rc = VMR3ReqCallVoidWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PostCopyTermOnEmt, 1, pVM);
+    AssertRCReturn(rc, rc);
+    return pPostCopy->fAborted ? VERR_PGM_POST_COPY_ABORTED : VINF_SUCCESS;
+}
@@ -46,7 +46,9 @@
 *   Defined Constants And Macros                                               *
 *******************************************************************************/
 /** Saved state data unit version.  */
-#define PGM_SAVED_STATE_VERSION                 14
+#define PGM_SAVED_STATE_VERSION                 15
+/** Saved state data unit version before the duplicate RAM page records. */
+#define PGM_SAVED_STATE_VERSION_PRE_DEDUP       14
 /** Saved state data unit version before the PAE PDPE registers. */
 #define PGM_SAVED_STATE_VERSION_PRE_PAE         13
 /** Saved state data unit version after this includes ballooned page flags in
@@ -87,8 +89,14 @@
 #define PGM_STATE_REC_ROM_PROT          UINT8_C(0x07)
 /** Ballooned page. No data. */
 #define PGM_STATE_REC_RAM_BALLOONED     UINT8_C(0x08)
+/** RAM page identical to one saved earlier in the same pass.  Followed by the
+ * RTGCPHYS of that page. */
+#define PGM_STATE_REC_RAM_DUP           UINT8_C(0x09)
+/** RAM page left out for post-copy teleportation. No data.  Only the target
+ * of a teleportation that has agreed to post-copy will see this. */
+#define PGM_STATE_REC_RAM_REMOTE        UINT8_C(0x0a)
 /** The last record type. */
-#define PGM_STATE_REC_LAST              PGM_STATE_REC_RAM_BALLOONED
+#define PGM_STATE_REC_LAST              PGM_STATE_REC_RAM_REMOTE
 /** End marker. */
 #define PGM_STATE_REC_END               UINT8_C(0xff)
 /** Flag indicating that the data is preceded by the page address.
@@ -103,10 +111,27 @@
 /** The CRC-32 for a zero half page. */
 #define PGM_STATE_CRC32_ZERO_HALF_PAGE  UINT32_C(0xf1e8ba9e)
 
+/** The number of entries in the duplicate page table used by the final pass.
+ * Must be a power of two. */
+#define PGM_STATE_DEDUP_ENTRIES         _64K
+
 
 /*******************************************************************************
 *   Structures and Typedefs                                                    *
 *******************************************************************************/
+/**
+ * Duplicate page table entry (pgmR3SaveRamPages).
+ */
+typedef struct PGMSTATEDEDUPENTRY
+{
+    /** The content hash of the page. */
+    uint64_t                    uHash;
+    /** The address of the page, NIL_RTGCPHYS if the entry is free. */
+    RTGCPHYS                    GCPhys;
+} PGMSTATEDEDUPENTRY;
+/** Pointer to a duplicate page table entry. */
+typedef PGMSTATEDEDUPENTRY *PPGMSTATEDEDUPENTRY;
+
 /** For loading old saved states. (pre-smp) */
 typedef struct
 {
@@ -1514,6 +1539,77 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
 }
 
 
+/**
+ * Calculates the content hash of a page for the duplicate page table.
+ *
+ * @returns 64-bit hash.
+ * @param   pbPage              The page.
+ */
+static uint64_t pgmR3StateHashPage(uint8_t const *pbPage)
+{
+    /* Four independent lanes to keep the multiplier busy. */
+    uint64_t const *pu64 = (uint64_t const *)pbPage;
+    uint64_t u0 = UINT64_C(0x9e3779b97f4a7c15);
+    uint64_t u1 = UINT64_C(0xc2b2ae3d27d4eb4f);
+    uint64_t u2 = UINT64_C(0x165667b19e3779f9);
+    uint64_t u3 = UINT64_C(0x27d4eb2f165667c5);
+    for (unsigned i = 0; i < PAGE_SIZE / sizeof(uint64_t); i += 4)
+    {
+        u0 = (u0 ^ pu64[i    ]) * UINT64_C(0x100000001b3);
+        u1 = (u1 ^ pu64[i + 1]) * UINT64_C(0x100000001b3);
+        u2 = (u2 ^ pu64[i + 2]) * UINT64_C(0x100000001b3);
+        u3 = (u3 ^ pu64[i + 3]) * UINT64_C(0x100000001b3);
+    }
+    uint64_t u = u0 ^ ((u1 << 16) | (u1 >> 48)) ^ ((u2 << 32) | (u2 >> 32)) ^ ((u3 << 48) | (u3 >> 16));
+    return u ^ (u >> 29);
+}
+
+
+/**
+ * Looks for a page identical to @a pbPage that was saved earlier in this pass,
+ * entering @a GCPhys into the table if there isn't any.
+ *
+ * This is only valid while the VM is suspended (final pass), as the candidate
+ * is compared with the current guest memory and not with what was saved.
+ *
+ * @returns The address of the identical page, NIL_RTGCPHYS if none.
+ * @param   pVM                 Pointer to the VM.
+ * @param   paDedup             The duplicate page table.
+ * @param   pbPage              Copy of the page being saved (not zero).
+ * @param   GCPhys              The address of the page being saved.
+ */
+static RTGCPHYS pgmR3StateFindDupPage(PVM pVM, PPGMSTATEDEDUPENTRY paDedup, uint8_t const *pbPage, RTGCPHYS GCPhys)
+{
+    PGM_LOCK_ASSERT_OWNER(pVM);
+    uint64_t const      uHash  = pgmR3StateHashPage(pbPage);
+    PPGMSTATEDEDUPENTRY pEntry = &paDedup[uHash & (PGM_STATE_DEDUP_ENTRIES - 1)];
+    if (   pEntry->uHash  == uHash
+        && pEntry->GCPhys != NIL_RTGCPHYS)
+    {
+        PPGMPAGE pPage = pgmPhysGetPage(pVM, pEntry->GCPhys);
+        if (   pPage
+            && PGM_PAGE_GET_TYPE(pPage) == PGMPAGETYPE_RAM
+            && PGM_PAGE_IS_ALLOCATED(pPage))
+        {
+            PGMPAGEMAPLOCK  PgMpLck;
+            void const     *pvPage;
+            int rc = pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pPage, pEntry->GCPhys, &pvPage, &PgMpLck);
+            if (RT_SUCCESS(rc))
+            {
+                bool fSame = !memcmp(pvPage, pbPage, PAGE_SIZE);
+                pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+                if (fSame)
+                    return pEntry->GCPhys;
+            }
+        }
+    }
+
+    pEntry->uHash  = uHash;
+    pEntry->GCPhys = GCPhys;
+    return NIL_RTGCPHYS;
+}
+
+
 /**
  * Save quiescent RAM pages.
  *
@@ -1525,8 +1621,6 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
  */
 static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t uPass)
 {
-    NOREF(fLiveSave);
-
     /*
      * The RAM.
      */
@@ -1535,6 +1629,36 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
     PPGMRAMRANGE pCur;
     bool fFTMDeltaSaveActive = FTMIsDeltaLoadSaveActive(pVM);
 
+    /*
+     * In post-copy mode the final pass only records which pages have content,
+     * the teleporter transfers them after the target has resumed the VM.
+     */
+    bool const fPostCopy = uPass == SSM_PASS_FINAL
+                        && fLiveSave
+                        && !fFTMDeltaSaveActive
+                        && pgmR3PostCopyIsSaving(pVM);
+
+    /*
+     * Nothing changes under our feet in the final pass, so we can replace
+     * pages identical to ones already saved in it by a reference.  The table
+     * is a cache, so failing to allocate it is no big deal.
+     */
+    PPGMSTATEDEDUPENTRY paDedup = NULL;
+    if (   uPass == SSM_PASS_FINAL
+        && pVM->pgm.s.fSaveDedup
+        && !fFTMDeltaSaveActive
+        && !fPostCopy)
+    {
+        paDedup = (PPGMSTATEDEDUPENTRY)RTMemAlloc(sizeof(paDedup[0]) * PGM_STATE_DEDUP_ENTRIES);
+        if (paDedup)
+            for (uint32_t i = 0; i < PGM_STATE_DEDUP_ENTRIES; i++)
+            {
+                paDedup[i].uHash  = 0;
+                paDedup[i].GCPhys = NIL_RTGCPHYS;
+            }
+    }
+    uint32_t cDupPages = 0;
+
     pgmLock(pVM);
     do
     {
@@ -1620,6 +1744,8 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                         uint8_t         abPage[PAGE_SIZE];
                         PGMPAGEMAPLOCK  PgMpLck;
                         void const     *pvPage;
+                        bool            fZeroContent = false;
+                        RTGCPHYS        GCPhysDup    = NIL_RTGCPHYS;
                         rc = pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pCurPage, GCPhys, &pvPage, &PgMpLck);
                         if (RT_SUCCESS(rc))
                         {
@@ -1629,14 +1755,34 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                                 pgmR3StateVerifyCrc32ForPage(abPage, pCur, paLSPages, iPage, "save#3");
 #endif
                             pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+
+                            fZeroContent = ASMMemIsZeroPage(abPage);
+                            if (!fZeroContent && paDedup)
+                                GCPhysDup = pgmR3StateFindDupPage(pVM, paDedup, abPage, GCPhys);
                         }
                         pgmUnlock(pVM);
+                        if (RT_FAILURE(rc))
+                            RTMemFree(paDedup);
                         AssertLogRelMsgRCReturn(rc, ("rc=%Rrc GCPhys=%RGp\n", rc, GCPhys), rc);
 
                         /* Try save some memory when restoring. */
-                        if (!ASMMemIsZeroPage(pvPage))
+                        if (!fZeroContent)
                         {
-                            if (fFTMDeltaSaveActive)
+                            if (fPostCopy)
+                            {
+                                rc = pgmR3PostCopyAddPage(pVM, true /*fSource*/, GCPhys);
+                                if (RT_SUCCESS(rc))
+                                {
+                                    if (GCPhys == GCPhysLast + PAGE_SIZE)
+                                        rc = SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_REMOTE);
+                                    else
+                                    {
+                                        SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_REMOTE | PGM_STATE_REC_FLAG_ADDR);
+                                        rc = SSMR3PutGCPhys(pSSM, GCPhys);
+                                    }
+                                }
+                            }
+                            else if (fFTMDeltaSaveActive)
                             {
                                 if (    PGM_PAGE_IS_WRITTEN_TO(pCurPage)
                                     ||  PGM_PAGE_IS_FT_DIRTY(pCurPage))
@@ -1656,6 +1802,18 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                                 else
                                     fSkipped = true;
                             }
+                            else if (GCPhysDup != NIL_RTGCPHYS)
+                            {
+                                if (GCPhys == GCPhysLast + PAGE_SIZE)
+                                    SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_DUP);
+                                else
+                                {
+                                    SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_DUP | PGM_STATE_REC_FLAG_ADDR);
+                                    SSMR3PutGCPhys(pSSM, GCPhys);
+                                }
+                                rc = SSMR3PutGCPhys(pSSM, GCPhysDup);
+                                cDupPages++;
+                            }
                             else
                             {
                                 if (GCPhys == GCPhysLast + PAGE_SIZE)
@@ -1700,7 +1858,10 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                         }
                     }
                     if (RT_FAILURE(rc))
+                    {
+                        RTMemFree(paDedup);
                         return rc;
+                    }
 
                     pgmLock(pVM);
                     if (!fSkipped)
@@ -1731,6 +1892,12 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
 
     pgmUnlock(pVM);
 
+    if (paDedup)
+    {
+        Log(("pgmR3SaveRamPages: %u duplicate pages\n", cDupPages));
+        STAM_REL_COUNTER_ADD(&pVM->pgm.s.StatSaveDupPages, cDupPages);
+        RTMemFree(paDedup);
+    }
     return VINF_SUCCESS;
 }
 
@@ -1835,8 +2002,9 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
      */
     else if (uPass == 7)
     {
-        pVM->pgm.s.LiveSave.cSavedPages  = 0;
-        pVM->pgm.s.LiveSave.uSaveStartNS = RTTimeNanoTS();
+        pVM->pgm.s.LiveSave.cSavedPages         = 0;
+        pVM->pgm.s.LiveSave.cSavedPagesLastVote = 0;
+        pVM->pgm.s.LiveSave.uSaveStartNS        = RTTimeNanoTS();
     }
 
     /*
@@ -1858,7 +2026,7 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
         rc = pgmR3SaveShadowedRomPages(pVM, pSSM, true /*fLiveSave*/, false /*fFinalPass*/);
     if (RT_SUCCESS(rc))
         rc = pgmR3SaveMmio2Pages(      pVM, pSSM, true /*fLiveSave*/, uPass);
-    if (RT_SUCCESS(rc))
+    if (RT_SUCCESS(rc) && !pgmR3PostCopyIsSaving(pVM))
         rc = pgmR3SaveRamPages(        pVM, pSSM, true /*fLiveSave*/, uPass);
     SSMR3PutU8(pSSM, PGM_STATE_REC_END);    /* (Ignore the rc, SSM takes care of it.) */
 
@@ -1866,6 +2034,54 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
 }
 
 
+/**
+ * Lowers the CPU execution cap by another step for auto-convergence.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   uPass       The data pass (for logging).
+ */
+static void pgmR3LiveThrottle(PVM pVM, uint32_t uPass)
+{
+    uint32_t uCap = pVM->pgm.s.LiveSave.uThrottleCap;
+    if (!uCap)
+    {
+        uCap = pVM->uCpuExecutionCap;
+        pVM->pgm.s.LiveSave.uOrgCpuExecutionCap = uCap;
+    }
+    else if (pVM->uCpuExecutionCap != uCap)
+        return; /* Somebody else changed it, leave it alone. */
+    if (uCap <= PGM_LIVE_THROTTLE_MIN)
+        return;
+    uCap = uCap > PGM_LIVE_THROTTLE_MIN + PGM_LIVE_THROTTLE_STEP ? uCap - PGM_LIVE_THROTTLE_STEP : PGM_LIVE_THROTTLE_MIN;
+
+    int rc = VMR3SetCpuExecutionCap(pVM, uCap);
+    AssertRCReturnVoid(rc);
+    pVM->pgm.s.LiveSave.uThrottleCap = uCap;
+    LogRel(("PGM: Live save not converging (pass %u: %u dirty pages/s vs %u saved pages/s, est. downtime %u ms), throttling the vCPUs to %u%%\n",
+            uPass, pVM->pgm.s.LiveSave.cDirtyPagesPerSecond, pVM->pgm.s.LiveSave.cPagesPerSecond,
+            pVM->pgm.s.LiveSave.cMsEstDowntime, uCap));
+}
+
+
+/**
+ * Restores the CPU execution cap after auto-convergence throttling.
+ *
+ * @param   pVM         Pointer to the VM.
+ */
+static void pgmR3LiveUnthrottle(PVM pVM)
+{
+    uint32_t const uCap = pVM->pgm.s.LiveSave.uThrottleCap;
+    if (!uCap)
+        return;
+    pVM->pgm.s.LiveSave.uThrottleCap = 0;
+    if (pVM->uCpuExecutionCap == uCap)
+    {
+        LogRel(("PGM: Live save done, restoring the CPU execution cap to %u%%\n", pVM->pgm.s.LiveSave.uOrgCpuExecutionCap));
+        VMR3SetCpuExecutionCap(pVM, pVM->pgm.s.LiveSave.uOrgCpuExecutionCap);
+    }
+}
+
+
 /**
  * Votes on whether the live save phase is done or not.
  *
@@ -1877,6 +2093,16 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
  */
 static DECLCALLBACK(int)  pgmR3LiveVote(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
 {
+    /*
+     * With post-copy, the RAM goes after the final pass, so there's no point
+     * in iterating.  The ROM and MMIO2 pages were saved by the first pass.
+     */
+    if (pgmR3PostCopyIsSaving(pVM))
+    {
+        Log(("pgmR3LiveVote: VINF_SUCCESS - post-copy, pass=%d\n", uPass));
+        return VINF_SUCCESS;
+    }
+
     /*
      * Update and calculate parameters used in the decision making.
      */
@@ -1915,11 +2141,29 @@ static DECLCALLBACK(int)  pgmR3LiveVote(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass
     pVM->pgm.s.LiveSave.cDirtyPagesLong = cDirtyPagesLong;
 
     /* estimate the speed */
-    uint64_t cNsElapsed = RTTimeNanoTS() - pVM->pgm.s.LiveSave.uSaveStartNS;
+    uint64_t const uNowNS = RTTimeNanoTS();
+    uint64_t const cNsElapsed = uNowNS - pVM->pgm.s.LiveSave.uSaveStartNS;
     uint32_t cPagesPerSecond = (uint32_t)(   pVM->pgm.s.LiveSave.cSavedPages
                                           / ((long double)cNsElapsed / 1000000000.0) );
     pVM->pgm.s.LiveSave.cPagesPerSecond = cPagesPerSecond;
 
+    /* the dirty rate (pages dirtied since the previous vote) and what's left. */
+    uint32_t const cDirtyPagesPerSecond = pgmR3LiveCalcDirtyRate(pVM->pgm.s.LiveSave.cDirtyPagesLastVote, cDirtyNow,
+                                                                 pVM->pgm.s.LiveSave.cSavedPages
+                                                                 - pVM->pgm.s.LiveSave.cSavedPagesLastVote,
+                                                                 uNowNS - pVM->pgm.s.LiveSave.uLastVoteNS);
+    pVM->pgm.s.LiveSave.uLastVoteNS          = uNowNS;
+    pVM->pgm.s.LiveSave.cSavedPagesLastVote  = pVM->pgm.s.LiveSave.cSavedPages;
+    pVM->pgm.s.LiveSave.cDirtyPagesLastVote  = cDirtyNow;
+    pVM->pgm.s.LiveSave.cDirtyPagesPerSecond = cDirtyPagesPerSecond;
+    pVM->pgm.s.LiveSave.cPagesRemaining      = cDirtyNow;
+    uint32_t const cMsEstDowntime = (uint32_t)RT_MIN(cDirtyNow / (long double)RT_MAX(cPagesPerSecond, 1) * 1000.0, UINT32_MAX);
+    pVM->pgm.s.LiveSave.cMsEstDowntime       = cMsEstDowntime;
+
+    uint32_t cMsMaxDowntime = SSMR3HandleMaxDowntime(pSSM);
+    if (cMsMaxDowntime < 32)
+        cMsMaxDowntime = 32;
+
     /*
      * Try make a decision.
      */
@@ -1933,9 +2177,6 @@ static DECLCALLBACK(int)  pgmR3LiveVote(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass
         {
             uint32_t cMsLeftShort   = (uint32_t)(cDirtyPagesShort / (long double)cPagesPerSecond * 1000.0);
             uint32_t cMsLeftLong    = (uint32_t)(cDirtyPagesLong  / (long double)cPagesPerSecond * 1000.0);
-            uint32_t cMsMaxDowntime = SSMR3HandleMaxDowntime(pSSM);
-            if (cMsMaxDowntime < 32)
-                cMsMaxDowntime = 32;
             if (   (   cMsLeftLong  <= cMsMaxDowntime
                     && cMsLeftShort <  cMsMaxDowntime)
                 || cMsLeftShort < cMsMaxDowntime / 2
@@ -1959,6 +2200,14 @@ static DECLCALLBACK(int)  pgmR3LiveVote(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass
         }
     }
 
+    /*
+     * If the guest is dirtying memory about as fast as we can save it, we'll
+     * never get below the downtime target.  Slow it down.
+     */
+    if (    pVM->pgm.s.fLiveSaveAutoConverge
+        &&  pgmR3LiveShouldThrottle(uPass, cDirtyPagesPerSecond, cPagesPerSecond, cMsEstDowntime, cMsMaxDowntime))
+        pgmR3LiveThrottle(pVM, uPass);
+
     /*
      * Come up with a completion percentage.  Currently this is a simple
      * dirty page (long term) vs. total pages ratio + some pass trickery.
@@ -2000,6 +2249,8 @@ static DECLCALLBACK(int) pgmR3LivePrep(PVM pVM, PSSMHANDLE pSSM)
         AssertLogRelFailedReturn(VERR_PGM_WRITE_MONITOR_ENGAGED);
     }
     pVM->pgm.s.fPhysWriteMonitoringEngaged = true;
+    pVM->pgm.s.uWriteMonitorGen++;
+    pgmR3WorkingSetAbort(pVM);
     pgmUnlock(pVM);
 
     /*
@@ -2019,6 +2270,13 @@ static DECLCALLBACK(int) pgmR3LivePrep(PVM pVM, PSSMHANDLE pSSM)
     pVM->pgm.s.LiveSave.cSavedPages       = 0;
     pVM->pgm.s.LiveSave.uSaveStartNS      = RTTimeNanoTS();
     pVM->pgm.s.LiveSave.cPagesPerSecond   = 8192;
+    pVM->pgm.s.LiveSave.cDirtyPagesPerSecond = 0;
+    pVM->pgm.s.LiveSave.cPagesRemaining   = 0;
+    pVM->pgm.s.LiveSave.cMsEstDowntime    = 0;
+    pVM->pgm.s.LiveSave.uLastVoteNS       = pVM->pgm.s.LiveSave.uSaveStartNS;
+    pVM->pgm.s.LiveSave.cSavedPagesLastVote = 0;
+    pVM->pgm.s.LiveSave.cDirtyPagesLastVote = 0;
+    pVM->pgm.s.LiveSave.uThrottleCap      = 0;
 
     /*
      * Per page type.
@@ -2028,6 +2286,9 @@ static DECLCALLBACK(int) pgmR3LivePrep(PVM pVM, PSSMHANDLE pSSM)
         rc = pgmR3PrepMmio2Pages(pVM);
     if (RT_SUCCESS(rc))
         rc = pgmR3PrepRamPages(pVM);
+    pVM->pgm.s.LiveSave.cDirtyPagesLastVote = pVM->pgm.s.LiveSave.Rom.cDirtyPages
+                                            + pVM->pgm.s.LiveSave.Mmio2.cDirtyPages
+                                            + pVM->pgm.s.LiveSave.Ram.cDirtyPages;
 
     NOREF(pSSM);
     return rc;
@@ -2122,6 +2383,7 @@ static DECLCALLBACK(int) pgmR3SaveDone(PVM pVM, PSSMHANDLE pSSM)
         pgmR3DoneMmio2Pages(pVM);
         pgmR3DoneRamPages(pVM);
     }
+    pgmR3LiveUnthrottle(pVM);
 
     /*
      * Clear the live save indicator and disengage write monitoring.
@@ -2637,6 +2899,8 @@ static int pgmR3LoadMemory(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t
             case PGM_STATE_REC_RAM_ZERO:
             case PGM_STATE_REC_RAM_RAW:
             case PGM_STATE_REC_RAM_BALLOONED:
+            case PGM_STATE_REC_RAM_DUP:
+            case PGM_STATE_REC_RAM_REMOTE:
             {
                 /*
                  * Get the address and resolve it into a page descriptor.
@@ -2742,6 +3006,47 @@ static int pgmR3LoadMemory(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t
                         break;
                     }
 
+                    case PGM_STATE_REC_RAM_DUP:
+                    {
+                        /* Copy the page loaded earlier on in this pass. */
+                        RTGCPHYS GCPhysSrc;
+                        rc = SSMR3GetGCPhys(pSSM, &GCPhysSrc);
+                        if (RT_FAILURE(rc))
+                            return rc;
+                        AssertLogRelMsgReturn(   !(GCPhysSrc & PAGE_OFFSET_MASK)
+                                              && GCPhysSrc != GCPhys,
+                                              ("%RGp %RGp\n", GCPhysSrc, GCPhys), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+                        PPGMPAGE pSrcPage;
+                        rc = pgmPhysGetPageEx(pVM, GCPhysSrc, &pSrcPage);
+                        AssertLogRelMsgRCReturn(rc, ("rc=%Rrc %RGp\n", rc, GCPhysSrc), rc);
+
+                        PGMPAGEMAPLOCK PgMpLckSrc;
+                        void const    *pvSrcPage;
+                        rc = pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pSrcPage, GCPhysSrc, &pvSrcPage, &PgMpLckSrc);
+                        AssertLogRelMsgRCReturn(rc, ("GCPhys=%RGp %R[pgmpage] rc=%Rrc\n", GCPhysSrc, pSrcPage, rc), rc);
+                        PGMPAGEMAPLOCK PgMpLck;
+                        void          *pvDstPage;
+                        rc = pgmPhysGCPhys2CCPtrInternal(pVM, pPage, GCPhys, &pvDstPage, &PgMpLck);
+                        if (RT_SUCCESS(rc))
+                        {
+                            memcpy(pvDstPage, pvSrcPage, PAGE_SIZE);
+                            pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+                        }
+                        pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLckSrc);
+                        AssertLogRelMsgRCReturn(rc, ("GCPhys=%RGp %R[pgmpage] rc=%Rrc\n", GCPhys, pPage, rc), rc);
+                        break;
+                    }
+
+                    case PGM_STATE_REC_RAM_REMOTE:
+                    {
+                        /* Fetched after the VM has been resumed, see PGMR3PostCopyStart. */
+                        AssertLogRelMsgReturn(PGM_PAGE_GET_TYPE(pPage) == PGMPAGETYPE_RAM,
+                                              ("GCPhys=%RGp %R[pgmpage]\n", GCPhys, pPage), VERR_PGM_LOAD_UNEXPECTED_PAGE_TYPE);
+                        rc = pgmR3PostCopyAddPage(pVM, false /*fSource*/, GCPhys);
+                        AssertLogRelMsgRCReturn(rc, ("GCPhys=%RGp rc=%Rrc\n", GCPhys, rc), rc);
+                        break;
+                    }
+
                     default:
                         AssertMsgFailedReturn(("%#x\n", u8), VERR_PGM_SAVED_REC_TYPE);
                 }
@@ -3105,11 +3410,13 @@ static DECLCALLBACK(int) pgmR3Load(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion,
      */
     if (   (   uPass != SSM_PASS_FINAL
             && uVersion != PGM_SAVED_STATE_VERSION
+            && uVersion != PGM_SAVED_STATE_VERSION_PRE_DEDUP
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_PAE
             && uVersion != PGM_SAVED_STATE_VERSION_BALLOON_BROKEN
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_BALLOON
             && uVersion != PGM_SAVED_STATE_VERSION_NO_RAM_CFG)
         || (   uVersion != PGM_SAVED_STATE_VERSION
+            && uVersion != PGM_SAVED_STATE_VERSION_PRE_DEDUP
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_PAE
             && uVersion != PGM_SAVED_STATE_VERSION_BALLOON_BROKEN
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_BALLOON
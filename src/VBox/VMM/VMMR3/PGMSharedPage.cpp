@@ -22,6 +22,7 @@
 #define LOG_GROUP LOG_GROUP_PGM_SHARED
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/stam.h>
+#include <VBox/vmm/tm.h>
 #include "PGMInternal.h"
 #include <VBox/vmm/vm.h>
 #include <VBox/sup.h>
@@ -263,6 +264,175 @@ VMMR3DECL(int) PGMR3SharedModuleCheckAll(PVM pVM)
 }
 
 
+/**
+ * Rendezvous callback doing one page fusion scan slice.
+ *
+ * @returns VBox strict status code.
+ * @param   pVM                 Pointer to the VM.
+ * @param   pVCpu               Pointer to the VMCPU of the calling EMT.
+ * @param   pvUser              Unused.
+ */
+static DECLCALLBACK(VBOXSTRICTRC) pgmR3PageFusionScanRendezvous(PVM pVM, PVMCPU pVCpu, void *pvUser)
+{
+    NOREF(pVCpu); NOREF(pvUser);
+
+    /* Flush all pending handy page operations before changing any shared page assignments. */
+    int rc = PGMR3PhysAllocateHandyPages(pVM);
+    AssertRC(rc);
+
+    /*
+     * Lock it here as we can't deal with busy locks in this ring-0 path.
+     */
+    pgmLock(pVM);
+    rc = GMMR3PageFusionScan(pVM, pVM->pgm.s.cPageFusionPages);
+    pgmUnlock(pVM);
+    return rc;
+}
+
+
+/**
+ * Page fusion scan helper (called on the way out).
+ *
+ * @param   pVM         Pointer to the VM.
+ */
+static DECLCALLBACK(void) pgmR3PageFusionScanHelper(PVM pVM)
+{
+    /* Leave the memory alone while it is being saved, the state may still be
+       running but the pages are tracked by the live save code. */
+    VMSTATE enmState = VMR3GetState(pVM);
+    if (    enmState == VMSTATE_RUNNING
+        &&  !pVM->pgm.s.LiveSave.fActive)
+    {
+        /* We must stall other VCPUs as we'd otherwise have to send IPI flush commands for every single change we make. */
+        STAM_REL_PROFILE_START(&pVM->pgm.s.StatPageFusionScan, a);
+        int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3PageFusionScanRendezvous, NULL);
+        STAM_REL_PROFILE_STOP(&pVM->pgm.s.StatPageFusionScan, a);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("PGM: Page fusion scanning failed with %Rrc, disabled.\n", rc));
+            return;
+        }
+    }
+    else if (   enmState != VMSTATE_RUNNING
+             && enmState != VMSTATE_RUNNING_LS
+             && enmState != VMSTATE_RUNNING_FT
+             && enmState != VMSTATE_SUSPENDED
+             && enmState != VMSTATE_SUSPENDED_LS
+             && enmState != VMSTATE_SUSPENDED_EXT_LS)
+        return; /* on its way out, the GMM frees all the VM's pages shortly anyway */
+
+    TMTimerSetMillies(pVM->pgm.s.pPageFusionTimerR3, pVM->pgm.s.cMsPageFusionInterval);
+}
+
+
+/**
+ * The page fusion scanner timer callback.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pTimer      The timer handle.
+ * @param   pvUser      Unused.
+ */
+static DECLCALLBACK(void) pgmR3PageFusionTimer(PVM pVM, PTMTIMER pTimer, void *pvUser)
+{
+    NOREF(pTimer); NOREF(pvUser);
+
+    /* Queue the scan as it requires a rendezvous of all the EMTs. */
+    VMR3ReqCallNoWait(pVM, VMCPUID_ANY_QUEUE, (PFNRT)pgmR3PageFusionScanHelper, 1, pVM);
+}
+
+
+/**
+ * Sets up the page fusion scanner if configured.
+ *
+ * The scanner walks the guest RAM in slices at a regular interval and hands
+ * the pages to GMM for merging with identical pages of this and other VMs.
+ * GMM limits the host wide CPU time spent on this.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+int pgmR3PageFusionInit(PVM pVM)
+{
+    /*
+     * The scanner follows the page fusion setting by default.
+     */
+    PCFGMNODE pCfgPGM = CFGMR3GetChild(CFGMR3GetRoot(pVM), "/PGM");
+    bool fPageFusion;
+    int rc = CFGMR3QueryBoolDef(CFGMR3GetRoot(pVM), "PageFusion", &fPageFusion, false);
+    AssertLogRelRCReturn(rc, rc);
+    rc = CFGMR3QueryBoolDef(pCfgPGM, "PageFusionScan", &fPageFusion, fPageFusion);
+    AssertLogRelRCReturn(rc, rc);
+    rc = CFGMR3QueryU32Def(pCfgPGM, "PageFusionInterval", &pVM->pgm.s.cMsPageFusionInterval, 100);
+    AssertLogRelRCReturn(rc, rc);
+    rc = CFGMR3QueryU32Def(pCfgPGM, "PageFusionPages", &pVM->pgm.s.cPageFusionPages, 4096);
+    AssertLogRelRCReturn(rc, rc);
+    if (    !fPageFusion
+        ||  pVM->pgm.s.fRamPreAlloc
+        ||  !pVM->pgm.s.cPageFusionPages)
+        return VINF_SUCCESS;
+    pVM->pgm.s.cMsPageFusionInterval = RT_MAX(pVM->pgm.s.cMsPageFusionInterval, 10);
+
+    /*
+     * The CPU budget is host wide, GMM only takes it from the first VM.
+     */
+    uint64_t cNsBudget;
+    rc = CFGMR3QueryU64(pCfgPGM, "PageFusionBudget", &cNsBudget);
+    if (RT_SUCCESS(rc))
+    {
+        GCFGMVALUEREQ Req;
+        RT_ZERO(Req);
+        Req.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+        Req.Hdr.cbReq    = sizeof(Req);
+        Req.pSession     = pVM->pSession;
+        Req.u64Value     = cNsBudget;
+        strcpy(Req.szName, "/GMM/PageFusionBudget");
+        rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_GCFGM_SET_VALUE, 0, &Req.Hdr);
+        if (rc == VERR_ACCESS_DENIED)
+            LogRel(("PGM: Page fusion budget left to the first VM\n"));
+        else if (RT_FAILURE(rc))
+            return VMSetError(pVM, rc, RT_SRC_POS, N_("Configuration error: Invalid PGM/PageFusionBudget %RU64"), cNsBudget);
+    }
+    else if (rc != VERR_CFGM_VALUE_NOT_FOUND && rc != VERR_CFGM_NO_PARENT)
+        AssertLogRelRCReturn(rc, rc);
+
+    rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL, pgmR3PageFusionTimer, NULL, "PGM Page Fusion",
+                                 &pVM->pgm.s.pPageFusionTimerR3);
+    AssertLogRelRCReturn(rc, rc);
+    rc = TMTimerSetMillies(pVM->pgm.s.pPageFusionTimerR3, pVM->pgm.s.cMsPageFusionInterval);
+    AssertLogRelRCReturn(rc, rc);
+
+    LogRel(("PGM: Page fusion scanning %u pages every %u ms\n", pVM->pgm.s.cPageFusionPages, pVM->pgm.s.cMsPageFusionInterval));
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * EMT worker for PGMR3PageFusionScanNow.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+static DECLCALLBACK(int) pgmR3PageFusionScanNowOnEmt(PVM pVM)
+{
+    return VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3PageFusionScanRendezvous, NULL);
+}
+
+
+/**
+ * Does one page fusion scan slice right away, regardless of the timer.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+VMMR3DECL(int) PGMR3PageFusionScanNow(PVM pVM)
+{
+    /* For tstPGMPageFusion, which sets a long PGM/PageFusionInterval and drives the scanner itself. */
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertReturn(pVM->pgm.s.pPageFusionTimerR3, VERR_INVALID_STATE);
+    return VMR3ReqCallWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3PageFusionScanNowOnEmt, 1, pVM);
+}
+
+
 # ifdef DEBUG
 /**
  * Query the state of a page in a shared module
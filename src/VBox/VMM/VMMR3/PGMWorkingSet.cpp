@@ -0,0 +1,730 @@
+/* $Id$ */
+/** @file
+ * PGM - Page Manager and Monitor, Working Set Estimator.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/** @page pg_pgm_workingset  PGM Working Set Estimator
+ *
+ * The estimator tells how much of the guest RAM the guest actually writes to
+ * within a time window, to help sizing VMs.  It uses the same write
+ * monitoring as the live save dirty tracking, but only on a random sample of
+ * the pages so the overhead stays bounded: at most PGM/WorkingSetSamplePages
+ * extra page faults and one EMT rendezvous per PGM/WorkingSetInterval.
+ *
+ * The guest physical address space is split into PGM_WS_REGIONS regions and
+ * the samples are spread evenly across the RAM in them.  At the start of a
+ * window the sampled pages are write monitored (allocated pages), or just
+ * remembered (zero and shared pages, which are replaced by a private page
+ * when written to).  At the end of it, the fraction of sampled pages that got
+ * written to is extrapolated to the RAM in the region.  Regions without any
+ * usable samples get the average fraction of all the others.  The sum over
+ * all regions is the working set estimate, and the per region fractions
+ * smoothed over several windows make up the heat map.
+ *
+ * Reads cannot be caught this way, so this is really the write working set.
+ * Pages mapped by a large page are left alone unless
+ * PGM/WorkingSetSampleLargePages is set, since write monitoring a single page
+ * breaks up the whole 2 MB mapping (the background promotion puts it back
+ * together later on).  The estimator steps aside while the write monitoring
+ * is engaged by live save (pgmR3WorkingSetAbort).  Should all of RAM be write
+ * protected by somebody else during a window (fault tolerance), the monitored
+ * samples are left to them and don't count.
+ *
+ * The results are available through the 'workingset' info handler, the
+ * /PGM/WorkingSet/ statistics and PGMR3QueryWorkingSet, which Main uses for
+ * the Guest/RAM/WorkingSet performance metric.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#define LOG_GROUP LOG_GROUP_PGM
+#include <VBox/vmm/pgm.h>
+#include <VBox/vmm/cpum.h>
+#include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/mm.h>
+#include <VBox/vmm/stam.h>
+#include <VBox/vmm/tm.h>
+#include <VBox/vmm/vmm.h>
+#include "PGMInternal.h"
+#include <VBox/vmm/vm.h>
+#include "PGMInline.h"
+
+#include <VBox/param.h>
+#include <VBox/err.h>
+#include <VBox/log.h>
+
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/time.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The number of heat map regions the guest physical address space is split
+ * into. */
+#define PGM_WS_REGIONS              64
+/** The max number of tries per sample we want in a region. */
+#define PGM_WS_TRIES_PER_SAMPLE     4
+/** PGMWSREGION::uHeat value for regions we know nothing about. */
+#define PGM_WS_HEAT_UNKNOWN         UINT16_MAX
+/** The mask of PGMWORKINGSET::aSamples entries holding the page state. */
+#define PGM_WS_SAMPLE_STATE_MASK    UINT64_C(0xfff)
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * A heat map region.
+ */
+typedef struct PGMWSREGION
+{
+    /** The number of RAM pages in the region. */
+    uint32_t            cRamPages;
+    /** The number of samples taken in the current window. */
+    uint32_t            cSampling;
+    /** The number of usable samples in the last window. */
+    uint32_t            cSampled;
+    /** The number of those that were written to. */
+    uint32_t            cWritten;
+    /** The fraction of the region written to per window in per mille,
+     * smoothed.  PGM_WS_HEAT_UNKNOWN if not known. */
+    uint16_t            uHeat;
+    /** Explicit alignment padding. */
+    uint16_t            au16Padding[3];
+} PGMWSREGION;
+/** Pointer to a heat map region. */
+typedef PGMWSREGION *PPGMWSREGION;
+
+
+/**
+ * The working set estimator state (PGM::pWorkingSetR3).
+ */
+typedef struct PGMWORKINGSET
+{
+    /** The window timer. */
+    PTMTIMERR3          pTimer;
+    /** @cfgm{PGM/WorkingSetInterval, uint32_t, 1000}
+     * The length of a window in milliseconds. */
+    uint32_t            cMsInterval;
+    /** @cfgm{PGM/WorkingSetSamplePages, uint32_t, 1024}
+     * The max number of pages to sample per window. */
+    uint32_t            cMaxSamples;
+    /** @cfgm{PGM/WorkingSetSampleLargePages, bool, false}
+     * Whether to sample pages mapped by large pages as well. */
+    bool                fSampleLargePages;
+    /** Explicit alignment padding. */
+    bool                afPadding[3];
+    /** The number of entries in aSamples. */
+    uint32_t            cSamples;
+    /** The region size, a multiple of 2 MB.  0 before the first window. */
+    uint64_t            cbRegion;
+    /** When the current window started (RTTimeNanoTS). */
+    uint64_t            nsWindowStart;
+    /** The number of completed windows. */
+    uint64_t            cWindows;
+    /** The length of the last window in milliseconds. */
+    uint32_t            cMsLastWindow;
+    /** The number of usable samples in the last window. */
+    uint32_t            cLastSampled;
+    /** The number of those that were written to. */
+    uint32_t            cLastWritten;
+    /** The number of RAM pages covered by the regions. */
+    uint32_t            cRamPages;
+    /** PGM::uWriteMonitorGen when the current window started. */
+    uint32_t            uWriteMonitorGen;
+    /** Explicit alignment padding. */
+    uint32_t            u32Padding;
+    /** The working set estimate of the last window, in bytes. */
+    uint64_t volatile   cbWorkingSet;
+    /** The working set estimate smoothed over several windows, in bytes. */
+    uint64_t volatile   cbWorkingSetAvg;
+    /** Profiling the window switches. */
+    STAMPROFILE         StatWindow;
+    /** The heat map regions. */
+    PGMWSREGION         aRegions[PGM_WS_REGIONS];
+    /** The pages sampled in the current window.  The page address with the
+     * PGM_PAGE_STATE_XXX the page was left in ORed into the low bits. */
+    RTGCPHYS            aSamples[1];
+} PGMWORKINGSET;
+/** Pointer to the working set estimator state. */
+typedef PGMWORKINGSET *PPGMWORKINGSET;
+
+
+/**
+ * Ends the current window, checking which of the sampled pages were written
+ * to and undoing the write monitoring of the others.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pWs         The working set estimator state.
+ * @param   fCount      Whether to count the results (false when aborting).
+ */
+static void pgmR3WorkingSetCollect(PVM pVM, PPGMWORKINGSET pWs, bool fCount)
+{
+    PGM_LOCK_ASSERT_OWNER(pVM);
+    uint32_t   cUnmonitored   = 0;
+    bool const fOwnMonitoring = pWs->uWriteMonitorGen == pVM->pgm.s.uWriteMonitorGen;
+
+    for (uint32_t i = 0; i < pWs->cSamples; i++)
+    {
+        RTGCPHYS const  GCPhys  = pWs->aSamples[i] & ~(RTGCPHYS)PGM_WS_SAMPLE_STATE_MASK;
+        unsigned const  uState  = (unsigned)(pWs->aSamples[i] & PGM_WS_SAMPLE_STATE_MASK);
+        PPGMPAGE        pPage   = pgmPhysGetPage(pVM, GCPhys);
+        if (!pPage || PGM_PAGE_GET_TYPE(pPage) != PGMPAGETYPE_RAM)
+            continue;
+        if (    uState == PGM_PAGE_STATE_WRITE_MONITORED
+            &&  !fOwnMonitoring)
+            continue; /* the protection and the written-to bit belong to somebody else now. */
+
+        bool fWritten;
+        switch (PGM_PAGE_GET_STATE(pPage))
+        {
+            case PGM_PAGE_STATE_WRITE_MONITORED:
+                if (uState == PGM_PAGE_STATE_WRITE_MONITORED)
+                {
+                    PGM_PAGE_SET_STATE(pVM, pPage, PGM_PAGE_STATE_ALLOCATED);
+                    cUnmonitored++;
+                    fWritten = false;
+                }
+                else
+                    fWritten = true; /* zero or shared page replaced and monitored by someone else. */
+                break;
+
+            case PGM_PAGE_STATE_ALLOCATED:
+                if (uState == PGM_PAGE_STATE_WRITE_MONITORED)
+                {
+                    if (!PGM_PAGE_IS_WRITTEN_TO(pPage))
+                        continue; /* reset or similar, don't know. */
+                    PGM_PAGE_CLEAR_WRITTEN_TO(pVM, pPage);
+                    Assert(pVM->pgm.s.cWrittenToPages > 0);
+                    pVM->pgm.s.cWrittenToPages--;
+                }
+                fWritten = true;
+                break;
+
+            case PGM_PAGE_STATE_ZERO:
+            case PGM_PAGE_STATE_SHARED:
+                if (PGM_PAGE_GET_STATE(pPage) != uState)
+                    continue; /* freed by the balloon or page fusion, don't know. */
+                fWritten = false;
+                break;
+
+            default:
+                continue;
+        }
+
+        if (fCount)
+        {
+            unsigned const iRegion = (unsigned)(GCPhys / pWs->cbRegion);
+            if (iRegion < PGM_WS_REGIONS)
+            {
+                pWs->aRegions[iRegion].cSampling++;
+                if (fWritten)
+                    pWs->aRegions[iRegion].cWritten++;
+            }
+        }
+    }
+
+    Assert(pVM->pgm.s.cMonitoredPages >= cUnmonitored);
+    pVM->pgm.s.cMonitoredPages -= RT_MIN(pVM->pgm.s.cMonitoredPages, cUnmonitored);
+    pWs->cSamples = 0;
+    if (!fCount)
+        return;
+
+    /*
+     * Extrapolate.
+     */
+    uint32_t cSampled = 0;
+    uint32_t cWritten = 0;
+    for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+    {
+        cSampled += pWs->aRegions[iRegion].cSampling;
+        cWritten += pWs->aRegions[iRegion].cWritten;
+    }
+    if (!cSampled)
+        return;
+
+    uint64_t cWrittenPages = 0;
+    for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+    {
+        PPGMWSREGION pRegion = &pWs->aRegions[iRegion];
+        pRegion->cSampled = pRegion->cSampling;
+        pRegion->cSampling = 0;
+        if (pRegion->cSampled)
+        {
+            cWrittenPages += (uint64_t)pRegion->cRamPages * pRegion->cWritten / pRegion->cSampled;
+            uint16_t const uHeat = (uint16_t)(pRegion->cWritten * 1000 / pRegion->cSampled);
+            pRegion->uHeat = pRegion->uHeat == PGM_WS_HEAT_UNKNOWN ? uHeat : (uint16_t)((pRegion->uHeat * 3 + uHeat) / 4);
+        }
+        else
+            cWrittenPages += (uint64_t)pRegion->cRamPages * cWritten / cSampled;
+        pRegion->cWritten = 0;
+    }
+
+    uint64_t const cbWorkingSet = cWrittenPages << PAGE_SHIFT;
+    ASMAtomicWriteU64(&pWs->cbWorkingSet, cbWorkingSet);
+    ASMAtomicWriteU64(&pWs->cbWorkingSetAvg, pWs->cWindows ? (pWs->cbWorkingSetAvg * 3 + cbWorkingSet) / 4 : cbWorkingSet);
+    pWs->cLastSampled  = cSampled;
+    pWs->cLastWritten  = cWritten;
+    pWs->cMsLastWindow = (uint32_t)((RTTimeNanoTS() - pWs->nsWindowStart) / RT_NS_1MS);
+    pWs->cWindows++;
+}
+
+
+/**
+ * Looks up the address of a RAM page in a region.
+ *
+ * @returns The page address, NIL_RTGCPHYS if out of range.
+ * @param   pVM         Pointer to the VM.
+ * @param   GCPhysFirst The start of the region.
+ * @param   GCPhysLast  The last address in the region.
+ * @param   iPage       The index of the RAM page within the region.
+ */
+static RTGCPHYS pgmR3WorkingSetGetRamPage(PVM pVM, RTGCPHYS GCPhysFirst, RTGCPHYS GCPhysLast, uint32_t iPage)
+{
+    for (PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR3; pRam && pRam->GCPhys <= GCPhysLast; pRam = pRam->pNextR3)
+    {
+        if (PGM_RAM_RANGE_IS_AD_HOC(pRam) || pRam->GCPhysLast < GCPhysFirst)
+            continue;
+        RTGCPHYS const GCPhysStart = RT_MAX(pRam->GCPhys, GCPhysFirst);
+        uint32_t const cPages = (uint32_t)((RT_MIN(pRam->GCPhysLast, GCPhysLast) - GCPhysStart + 1) >> PAGE_SHIFT);
+        if (iPage < cPages)
+            return GCPhysStart + ((RTGCPHYS)iPage << PAGE_SHIFT);
+        iPage -= cPages;
+    }
+    return NIL_RTGCPHYS;
+}
+
+
+/**
+ * Starts a new window, picking and write monitoring the samples.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pWs         The working set estimator state.
+ * @param   pfFlushTLBs Set to @a true if the shadow TLBs should be flushed, it
+ *                      is NOT touched if this isn't necessary.
+ */
+static void pgmR3WorkingSetStart(PVM pVM, PPGMWORKINGSET pWs, bool *pfFlushTLBs)
+{
+    PGM_LOCK_ASSERT_OWNER(pVM);
+    Assert(!pWs->cSamples);
+
+    /*
+     * Work out the region layout.  It only changes if RAM is added.
+     */
+    RTGCPHYS GCPhysEnd = 0;
+    for (PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR3; pRam; pRam = pRam->pNextR3)
+        if (!PGM_RAM_RANGE_IS_AD_HOC(pRam))
+            GCPhysEnd = RT_MAX(GCPhysEnd, pRam->GCPhysLast + 1);
+    uint64_t const cbRegion = RT_MAX(RT_ALIGN_64(GCPhysEnd / PGM_WS_REGIONS + 1, _2M), _2M);
+    if (cbRegion != pWs->cbRegion)
+    {
+        RT_ZERO(pWs->aRegions);
+        for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+            pWs->aRegions[iRegion].uHeat = PGM_WS_HEAT_UNKNOWN;
+        pWs->cbRegion = cbRegion;
+    }
+
+    unsigned cRegionsWithRam = 0;
+    pWs->cRamPages = 0;
+    for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+    {
+        RTGCPHYS const GCPhysFirst = iRegion * cbRegion;
+        RTGCPHYS const GCPhysLast  = GCPhysFirst + cbRegion - 1;
+        uint32_t       cRamPages   = 0;
+        for (PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR3; pRam && pRam->GCPhys <= GCPhysLast; pRam = pRam->pNextR3)
+            if (!PGM_RAM_RANGE_IS_AD_HOC(pRam) && pRam->GCPhysLast >= GCPhysFirst)
+                cRamPages += (uint32_t)((RT_MIN(pRam->GCPhysLast, GCPhysLast) - RT_MAX(pRam->GCPhys, GCPhysFirst) + 1) >> PAGE_SHIFT);
+        pWs->aRegions[iRegion].cRamPages = cRamPages;
+        pWs->cRamPages += cRamPages;
+        if (cRamPages)
+            cRegionsWithRam++;
+    }
+    if (!cRegionsWithRam)
+        return;
+
+    /*
+     * Pick the samples.
+     */
+    uint32_t const cPerRegion = RT_MAX(pWs->cMaxSamples / cRegionsWithRam, 1);
+    for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+    {
+        PPGMWSREGION    pRegion     = &pWs->aRegions[iRegion];
+        RTGCPHYS const  GCPhysFirst = iRegion * cbRegion;
+        uint32_t        cTaken      = 0;
+        for (uint32_t cTries = 0;
+                pRegion->cRamPages
+             && cTaken < cPerRegion
+             && cTries < cPerRegion * PGM_WS_TRIES_PER_SAMPLE
+             && pWs->cSamples < pWs->cMaxSamples;
+             cTries++)
+        {
+            RTGCPHYS const GCPhys = pgmR3WorkingSetGetRamPage(pVM, GCPhysFirst, GCPhysFirst + cbRegion - 1,
+                                                              RTRandU32Ex(0, pRegion->cRamPages - 1));
+            PPGMPAGE pPage = GCPhys != NIL_RTGCPHYS ? pgmPhysGetPage(pVM, GCPhys) : NULL;
+            if (!pPage || PGM_PAGE_GET_TYPE(pPage) != PGMPAGETYPE_RAM)
+                continue;
+
+            unsigned uState = PGM_PAGE_GET_STATE(pPage);
+            switch (uState)
+            {
+                case PGM_PAGE_STATE_ALLOCATED:
+                    if (    PGM_PAGE_HAS_ANY_HANDLERS(pPage)
+                        ||  PGM_PAGE_GET_WRITE_LOCKS(pPage) != 0 /* writes through the mapping go unnoticed */
+                        ||  PGM_PAGE_IS_WRITTEN_TO(pPage))
+                        continue;
+                    if (    PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE
+                        &&  !pWs->fSampleLargePages)
+                        continue;
+
+                    /* Drop the shadow mappings first, this breaks up any large
+                       page mapping.  The next access syncs the page read-only. */
+                    pgmPoolTrackUpdateGCPhys(pVM, GCPhys, pPage, true /* clear the entries */, pfFlushTLBs);
+                    pgmPhysPageWriteMonitor(pVM, pPage, GCPhys);
+                    uState = PGM_PAGE_STATE_WRITE_MONITORED;
+                    break;
+
+                case PGM_PAGE_STATE_ZERO:
+                case PGM_PAGE_STATE_SHARED:
+                    /* Writing replaces them by a private page, nothing to do. */
+                    break;
+
+                default:
+                    continue;
+            }
+
+            pWs->aSamples[pWs->cSamples++] = GCPhys | uState;
+            cTaken++;
+        }
+    }
+
+    pWs->uWriteMonitorGen = pVM->pgm.s.uWriteMonitorGen;
+    pWs->nsWindowStart    = RTTimeNanoTS();
+}
+
+
+/**
+ * Rendezvous callback switching to the next window.
+ *
+ * @returns VBox strict status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pVCpu       Pointer to the VMCPU of the calling EMT.
+ * @param   pvUser      The working set estimator state.
+ */
+static DECLCALLBACK(VBOXSTRICTRC) pgmR3WorkingSetRendezvous(PVM pVM, PVMCPU pVCpu, void *pvUser)
+{
+    PPGMWORKINGSET  pWs        = (PPGMWORKINGSET)pvUser;
+    bool            fFlushTLBs = false;
+    NOREF(pVCpu);
+
+    pgmLock(pVM);
+    if (!pVM->pgm.s.fPhysWriteMonitoringEngaged)
+    {
+        pgmR3WorkingSetCollect(pVM, pWs, true /*fCount*/);
+        pgmR3WorkingSetStart(pVM, pWs, &fFlushTLBs);
+    }
+
+    if (fFlushTLBs)
+    {
+        PGM_INVL_ALL_VCPU_TLBS(pVM);
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+            CPUMSetChangedFlags(&pVM->aCpus[idCpu], CPUM_CHANGED_GLOBAL_TLB_FLUSH);
+    }
+    pgmUnlock(pVM);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Working set window helper (called on the way out).
+ *
+ * @param   pVM         Pointer to the VM.
+ */
+static DECLCALLBACK(void) pgmR3WorkingSetHelper(PVM pVM)
+{
+    PPGMWORKINGSET pWs = pVM->pgm.s.pWorkingSetR3;
+
+    /* Leave the memory alone while it is being saved. */
+    VMSTATE enmState = VMR3GetState(pVM);
+    if (    enmState == VMSTATE_RUNNING
+        &&  !pVM->pgm.s.LiveSave.fActive)
+    {
+        STAM_REL_PROFILE_START(&pWs->StatWindow, a);
+        int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3WorkingSetRendezvous, pWs);
+        STAM_REL_PROFILE_STOP(&pWs->StatWindow, a);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("PGM: Working set estimation failed with %Rrc, disabled.\n", rc));
+            return;
+        }
+    }
+    else if (   enmState != VMSTATE_RUNNING
+             && enmState != VMSTATE_RUNNING_LS
+             && enmState != VMSTATE_RUNNING_FT
+             && enmState != VMSTATE_SUSPENDED
+             && enmState != VMSTATE_SUSPENDED_LS
+             && enmState != VMSTATE_SUSPENDED_EXT_LS)
+        return; /* a window running into the power off says nothing about the guest, stop sampling */
+
+    TMTimerSetMillies(pWs->pTimer, pWs->cMsInterval);
+}
+
+
+/**
+ * The working set window timer callback.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pTimer      The timer handle.
+ * @param   pvUser      Unused.
+ */
+static DECLCALLBACK(void) pgmR3WorkingSetTimer(PVM pVM, PTMTIMER pTimer, void *pvUser)
+{
+    NOREF(pTimer); NOREF(pvUser);
+
+    /* Queue the window switch as it requires a rendezvous of all the EMTs. */
+    VMR3ReqCallNoWait(pVM, VMCPUID_ANY_QUEUE, (PFNRT)pgmR3WorkingSetHelper, 1, pVM);
+}
+
+
+/**
+ * Formats a byte count as MB for the info handler.
+ */
+DECLINLINE(uint64_t) pgmR3WorkingSetToMB(uint64_t cb)
+{
+    return (cb + _512K) / _1M;
+}
+
+
+/**
+ * Info handler for 'workingset'.
+ *
+ * @param   pVM         Pointer to the VM.
+ * @param   pHlp        The output helpers.
+ * @param   pszArgs     'verbose' for the per region details.
+ */
+static DECLCALLBACK(void) pgmR3WorkingSetInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    PPGMWORKINGSET pWs = pVM->pgm.s.pWorkingSetR3;
+    if (!pWs)
+    {
+        pHlp->pfnPrintf(pHlp, "The working set estimator is disabled (PGM/WorkingSet).\n");
+        return;
+    }
+    bool const fVerbose = pszArgs && strstr(pszArgs, "verbose");
+
+    pgmLock(pVM);
+    pHlp->pfnPrintf(pHlp,
+                    "Working set estimator: %u ms windows, up to %u samples, %u regions of %RU64 MB%s\n",
+                    pWs->cMsInterval, pWs->cMaxSamples, PGM_WS_REGIONS, pgmR3WorkingSetToMB(pWs->cbRegion),
+                    pWs->fSampleLargePages ? ", large pages sampled" : "");
+    if (!pWs->cWindows)
+    {
+        pHlp->pfnPrintf(pHlp, "No window completed yet.\n");
+        pgmUnlock(pVM);
+        return;
+    }
+    pHlp->pfnPrintf(pHlp,
+                    "Last window: %u ms, %u of %u sampled pages written\n"
+                    "Working set: %RU64 MB (smoothed %RU64 MB) of %RU64 MB RAM, %RU64 windows\n",
+                    pWs->cMsLastWindow, pWs->cLastWritten, pWs->cLastSampled,
+                    pgmR3WorkingSetToMB(pWs->cbWorkingSet), pgmR3WorkingSetToMB(pWs->cbWorkingSetAvg),
+                    pgmR3WorkingSetToMB((uint64_t)pWs->cRamPages << PAGE_SHIFT), pWs->cWindows);
+
+    /*
+     * The heat map, one char per region.
+     */
+    static const char s_szHeat[] = ".:-=+*#%@";
+    char szMap[PGM_WS_REGIONS + 1];
+    for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+    {
+        PPGMWSREGION pRegion = &pWs->aRegions[iRegion];
+        if (!pRegion->cRamPages)
+            szMap[iRegion] = ' ';
+        else if (pRegion->uHeat == PGM_WS_HEAT_UNKNOWN)
+            szMap[iRegion] = '?';
+        else
+            szMap[iRegion] = s_szHeat[RT_MIN(pRegion->uHeat * (sizeof(s_szHeat) - 1) / 1000, sizeof(s_szHeat) - 2)];
+    }
+    szMap[PGM_WS_REGIONS] = '\0';
+    pHlp->pfnPrintf(pHlp,
+                    "Heat map (' ' no RAM, '?' no samples, '.' cold ... '@' hot):\n"
+                    "  |%s|\n", szMap);
+
+    if (fVerbose)
+    {
+        pHlp->pfnPrintf(pHlp, "Region                                  RAM pages  Sampled  Written  Heat\n");
+        for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+        {
+            PPGMWSREGION pRegion = &pWs->aRegions[iRegion];
+            if (!pRegion->cRamPages)
+                continue;
+            RTGCPHYS const GCPhysFirst = iRegion * pWs->cbRegion;
+            if (pRegion->uHeat == PGM_WS_HEAT_UNKNOWN)
+                pHlp->pfnPrintf(pHlp, "%RGp-%RGp %9u %8u %8u     ?\n", GCPhysFirst, GCPhysFirst + pWs->cbRegion - 1,
+                                pRegion->cRamPages, pRegion->cSampled, pRegion->cWritten);
+            else
+                pHlp->pfnPrintf(pHlp, "%RGp-%RGp %9u %8u %8u %3u.%u%%\n", GCPhysFirst, GCPhysFirst + pWs->cbRegion - 1,
+                                pRegion->cRamPages, pRegion->cSampled, pRegion->cWritten,
+                                pRegion->uHeat / 10, pRegion->uHeat % 10);
+        }
+    }
+    pgmUnlock(pVM);
+}
+
+
+/**
+ * Sets up the working set estimator if configured.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+int pgmR3WorkingSetInit(PVM pVM)
+{
+    DBGFR3InfoRegisterInternal(pVM, "workingset",
+                               "Shows the guest working set estimate and heat map. Pass 'verbose' for the per region details.",
+                               pgmR3WorkingSetInfo);
+
+    PCFGMNODE pCfgPGM = CFGMR3GetChild(CFGMR3GetRoot(pVM), "/PGM");
+    /** @cfgm{PGM/WorkingSet, bool, false}
+     * Enables the working set estimator, see @ref pg_pgm_workingset. */
+    bool fEnabled;
+    int rc = CFGMR3QueryBoolDef(pCfgPGM, "WorkingSet", &fEnabled, false);
+    AssertLogRelRCReturn(rc, rc);
+    uint32_t cMsInterval;
+    rc = CFGMR3QueryU32Def(pCfgPGM, "WorkingSetInterval", &cMsInterval, 1000);
+    AssertLogRelRCReturn(rc, rc);
+    uint32_t cMaxSamples;
+    rc = CFGMR3QueryU32Def(pCfgPGM, "WorkingSetSamplePages", &cMaxSamples, 1024);
+    AssertLogRelRCReturn(rc, rc);
+    bool fSampleLargePages;
+    rc = CFGMR3QueryBoolDef(pCfgPGM, "WorkingSetSampleLargePages", &fSampleLargePages, false);
+    AssertLogRelRCReturn(rc, rc);
+    if (!fEnabled || !cMaxSamples)
+        return VINF_SUCCESS;
+    cMaxSamples = RT_MIN(RT_MAX(cMaxSamples, PGM_WS_REGIONS), _64K);
+
+    PPGMWORKINGSET pWs = (PPGMWORKINGSET)MMR3HeapAllocZ(pVM, MM_TAG_PGM, RT_OFFSETOF(PGMWORKINGSET, aSamples[cMaxSamples]));
+    AssertLogRelReturn(pWs, VERR_NO_MEMORY);
+    pWs->cMsInterval       = RT_MAX(cMsInterval, 10);
+    pWs->cMaxSamples       = cMaxSamples;
+    pWs->fSampleLargePages = fSampleLargePages;
+
+    rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL, pgmR3WorkingSetTimer, NULL, "PGM Working Set", &pWs->pTimer);
+    AssertLogRelRCReturn(rc, rc);
+
+    STAM_REL_REG(pVM, (void *)&pWs->cbWorkingSet,    STAMTYPE_U64,     "/PGM/WorkingSet/cbWorkingSet",    STAMUNIT_BYTES,          "The working set estimate of the last window.");
+    STAM_REL_REG(pVM, (void *)&pWs->cbWorkingSetAvg, STAMTYPE_U64,     "/PGM/WorkingSet/cbWorkingSetAvg", STAMUNIT_BYTES,          "The working set estimate smoothed over several windows.");
+    STAM_REL_REG(pVM, &pWs->cLastSampled,            STAMTYPE_U32,     "/PGM/WorkingSet/cSampled",        STAMUNIT_PAGES,          "The number of pages sampled in the last window.");
+    STAM_REL_REG(pVM, &pWs->cLastWritten,            STAMTYPE_U32,     "/PGM/WorkingSet/cWritten",        STAMUNIT_PAGES,          "The number of sampled pages written to in the last window.");
+    STAM_REL_REG(pVM, &pWs->StatWindow,              STAMTYPE_PROFILE, "/PGM/WorkingSet/Window",          STAMUNIT_TICKS_PER_CALL, "Profiles the window switches.");
+
+    pVM->pgm.s.pWorkingSetR3 = pWs;
+    rc = TMTimerSetMillies(pWs->pTimer, pWs->cMsInterval);
+    AssertLogRelRCReturn(rc, rc);
+
+    LogRel(("PGM: Estimating the working set from up to %u pages every %u ms\n", pWs->cMaxSamples, pWs->cMsInterval));
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Hands the sampled pages back before somebody else engages the write
+ * monitoring (live save).
+ *
+ * The current window is discarded.
+ *
+ * @param   pVM         Pointer to the VM.
+ */
+void pgmR3WorkingSetAbort(PVM pVM)
+{
+    PPGMWORKINGSET pWs = pVM->pgm.s.pWorkingSetR3;
+    if (pWs)
+    {
+        pgmLock(pVM);
+        pgmR3WorkingSetCollect(pVM, pWs, false /*fCount*/);
+        for (unsigned iRegion = 0; iRegion < PGM_WS_REGIONS; iRegion++)
+        {
+            pWs->aRegions[iRegion].cSampling = 0;
+            pWs->aRegions[iRegion].cWritten  = 0;
+        }
+        pgmUnlock(pVM);
+    }
+}
+
+
+/**
+ * Queries the working set estimate.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_NOT_SUPPORTED if the estimator isn't enabled.
+ * @retval  VERR_TRY_AGAIN if no window has been completed yet.
+ *
+ * @param   pVM                 Pointer to the VM.
+ * @param   pcbWorkingSet       Where to return the estimate of the last
+ *                              window, in bytes.  Optional.
+ * @param   pcbWorkingSetAvg    Where to return the estimate smoothed over
+ *                              several windows, in bytes.  Optional.
+ */
+VMMR3DECL(int) PGMR3QueryWorkingSet(PVM pVM, uint64_t *pcbWorkingSet, uint64_t *pcbWorkingSetAvg)
+{
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+
+    PPGMWORKINGSET pWs = pVM->pgm.s.pWorkingSetR3;
+    if (!pWs)
+        return VERR_NOT_SUPPORTED;
+    if (!ASMAtomicReadU64(&pWs->cWindows))
+        return VERR_TRY_AGAIN;
+
+    if (pcbWorkingSet)
+        *pcbWorkingSet    = ASMAtomicReadU64(&pWs->cbWorkingSet);
+    if (pcbWorkingSetAvg)
+        *pcbWorkingSetAvg = ASMAtomicReadU64(&pWs->cbWorkingSetAvg);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * EMT worker for PGMR3WorkingSetNextWindow.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+static DECLCALLBACK(int) pgmR3WorkingSetNextWindowOnEmt(PVM pVM)
+{
+    return VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3WorkingSetRendezvous, pVM->pgm.s.pWorkingSetR3);
+}
+
+
+/**
+ * Ends the current window and starts the next one right away, regardless of
+ * the timer and the VM state.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_NOT_SUPPORTED if the estimator isn't enabled.
+ * @param   pVM         Pointer to the VM.
+ */
+VMMR3DECL(int) PGMR3WorkingSetNextWindow(PVM pVM)
+{
+    /* For tstPGMWorkingSet, which needs windows that end exactly after its writes. */
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    if (!pVM->pgm.s.pWorkingSetR3)
+        return VERR_NOT_SUPPORTED;
+    return VMR3ReqCallWait(pVM, VMCPUID_ANY, (PFNRT)pgmR3WorkingSetNextWindowOnEmt, 1, pVM);
+}
@@ -128,6 +128,28 @@
  * needed updating after the data was written.)
  *
  *
+ * @section sec_ssm_zip_threads     Parallel Compression
+ *
+ * Compressing the pages of a large VM is what makes saving CPU bound, so the
+ * LZF work can be farmed out to a small pool of threads (SSMZIPPOOL).  The
+ * format is not affected.  While saving, each page is copied into a pipeline
+ * slot and compressed by a thread (or by the EMT itself if it gets there
+ * first).  Any other data written while compressed records are pending is
+ * queued up behind them, and the slots are committed to the stream strictly
+ * in order.  The pipeline is drained before the termination record of a unit
+ * is written, as that needs the stream CRC, which is in turn calculated by the
+ * I/O thread as it writes the buffers.
+ *
+ * When loading, reading an LZF record triggers read-ahead: the following
+ * records are parsed and queued until the pipeline is full or the end of the
+ * unit is reached, and the LZF ones are decompressed by the threads while the
+ * unit is busy consuming the earlier ones.
+ *
+ * The number of threads is given by the SSM/ZipThreads CFGM value, zero
+ * disables the pool.  The default is one less than the number of online CPUs,
+ * but no more than 8.
+ *
+ *
  * @section sec_ssm_future          Future Changes
  *
  * There are plans to extend SSM to make it easier to be both backwards and
@@ -145,6 +167,7 @@
 *******************************************************************************/
 #define LOG_GROUP LOG_GROUP_SSM
 #include <VBox/vmm/ssm.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/mm.h>
 #include "SSMInternal.h"
@@ -158,6 +181,7 @@
 #include <iprt/crc.h>
 #include <iprt/file.h>
 #include <iprt/mem.h>
+#include <iprt/mp.h>
 #include <iprt/param.h>
 #include <iprt/thread.h>
 #include <iprt/semaphore.h>
@@ -228,6 +252,9 @@
  * This can be used with the flags+type byte, no need to mask out the type first. */
 #define SSM_REC_TYPE_IS_VALID(u8Type)           (   ((u8Type) & SSM_REC_TYPE_MASK) >  SSM_REC_TYPE_INVALID \
                                                  && ((u8Type) & SSM_REC_TYPE_MASK) <= SSM_REC_TYPE_NAMED )
+/** Internal: Data that the load read-ahead has already decoded and placed in
+ * the data buffer.  This is never found in a stream. */
+#define SSM_REC_TYPE_INT_DECODED                UINT8_C(0x0f)
 /** @} */
 
 /** The flag mask. */
@@ -282,6 +309,13 @@
 #define SSM_ZIP_BLOCK_SIZE                      _4K
 AssertCompile(SSM_ZIP_BLOCK_SIZE / _1K * _1K == SSM_ZIP_BLOCK_SIZE);
 
+/** The number of slots in the parallel (de)compression pipeline.
+ * Must be a power of two. */
+#define SSM_ZIP_SLOTS                           64
+AssertCompile(!(SSM_ZIP_SLOTS & (SSM_ZIP_SLOTS - 1)));
+/** The max number of (de)compression threads. */
+#define SSM_ZIP_MAX_THREADS                     16
+
 
 /**
  * Asserts that the handle is writable and returns with VERR_SSM_INVALID_STATE
@@ -379,6 +413,9 @@ typedef struct SSMSTRMBUF
     bool                    fEndOfStream;
     /** The nano timestamp set by ssmR3StrmGetFreeBuf. */
     uint64_t                NanoTS;
+    /** Where the writer should start checksumming this buffer, UINT32_MAX if
+     * the producer has taken care of it already (write streams only). */
+    uint32_t                offCRC;
     /** Pointer to the next buffer in the chain. */
     PSSMSTRMBUF volatile    pNext;
 } SSMSTRMBUF;
@@ -439,11 +476,85 @@ typedef struct SSMSTRM
      * This may lag behind off as it's desirable to checksum as large blocks as
      * possible.  */
     uint32_t                offStreamCRC;
+    /** The number of queued buffers the I/O thread has yet to checksum.
+     * u32StreamCRC belongs to the I/O thread while this is non-zero. */
+    uint32_t volatile       cCRCPending;
 } SSMSTRM;
 /** Pointer to a SSM stream. */
 typedef SSMSTRM *PSSMSTRM;
 
 
+/** @name SSMZIPSLOT::enmState values.
+ * @{ */
+/** Not in use. */
+#define SSMZIPSLOT_STATE_FREE                   UINT32_C(0)
+/** Ready for committing to the stream (save) or for consumption (load). */
+#define SSMZIPSLOT_STATE_READY                  UINT32_C(1)
+/** Waiting for a thread to (de)compress it. */
+#define SSMZIPSLOT_STATE_QUEUED                 UINT32_C(2)
+/** Being (de)compressed. */
+#define SSMZIPSLOT_STATE_BUSY                   UINT32_C(3)
+/** @} */
+
+/**
+ * A slot in the parallel (de)compression pipeline.
+ */
+typedef struct SSMZIPSLOT
+{
+    /** The state, SSMZIPSLOT_STATE_XXX. */
+    uint32_t volatile       enmState;
+    /** Load: The record type and flags, SSM_REC_TYPE_INT_DECODED if the data
+     * has been decoded into abDst. */
+    uint8_t                 u8TypeAndFlags;
+    /** Load: The status of reading and decoding the record. */
+    int32_t                 rc;
+    /** The number of bytes in abSrc. */
+    uint32_t                cbSrc;
+    /** Save: The number of record bytes in abDst.
+     * Load: The number of decoded bytes in abDst, or the record size if only the
+     * header has been read. */
+    uint32_t                cbDst;
+    /** The input: a page to compress (save) or LZF data (load). */
+    uint8_t                 abSrc[SSM_ZIP_BLOCK_SIZE + 16];
+    /** The output: records ready for the stream (save) or decoded data (load). */
+    uint8_t                 abDst[1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE + 16];
+} SSMZIPSLOT;
+/** Pointer to a pipeline slot. */
+typedef SSMZIPSLOT *PSSMZIPSLOT;
+
+/**
+ * The parallel (de)compression pool.
+ *
+ * The slots are used in a circular fashion by the thread owning the handle,
+ * the pool threads only ever touch slots in the QUEUED and BUSY states.
+ */
+typedef struct SSMZIPPOOL
+{
+    /** Save (set) or load (clear). */
+    bool                    fWrite;
+    /** Tells the threads to quit. */
+    bool volatile           fTerminate;
+    /** Set by the handle owner while waiting on hEvtDone. */
+    bool volatile           fWaiting;
+    /** The number of threads. */
+    uint32_t                cThreads;
+    /** The oldest slot in use (free running index). */
+    uint32_t                iHead;
+    /** The next slot to use (free running index). */
+    uint32_t                iTail;
+    /** Event the idle threads are waiting on. */
+    RTSEMEVENT              hEvtWork;
+    /** Event signalled when a slot is done and fWaiting is set. */
+    RTSEMEVENT              hEvtDone;
+    /** The thread handles. */
+    RTTHREAD                ahThreads[SSM_ZIP_MAX_THREADS];
+    /** The pipeline. */
+    SSMZIPSLOT              aSlots[SSM_ZIP_SLOTS];
+} SSMZIPPOOL;
+/** Pointer to a (de)compression pool. */
+typedef SSMZIPPOOL *PSSMZIPPOOL;
+
+
 /**
  * Handle structure.
  */
@@ -497,6 +608,8 @@ typedef struct SSMHANDLE
     unsigned                uReportedLivePercent;
     /** The filename, NULL if remote stream. */
     const char             *pszFilename;
+    /** The parallel (de)compression pool, NULL if not used. */
+    PSSMZIPPOOL             pZipPool;
 
     union
     {
@@ -888,8 +1001,10 @@ static int                  ssmR3StrmReadMore(PSSMSTRM pStrm);
 
 #ifndef SSM_STANDALONE
 static int                  ssmR3DataFlushBuffer(PSSMHANDLE pSSM);
+static int                  ssmR3DataFlushAll(PSSMHANDLE pSSM);
 #endif
 static int                  ssmR3DataReadRecHdrV2(PSSMHANDLE pSSM);
+static int                  ssmR3DataReadNextRecV2(PSSMHANDLE pSSM);
 
 
 #ifndef SSM_STANDALONE
@@ -942,6 +1057,18 @@ static int ssmR3LazyInit(PVM pVM)
         STAM_REL_REG_USED(pVM, &pVM->ssm.s.uPass, STAMTYPE_U32, "/SSM/uPass", STAMUNIT_COUNT, "Current pass");
     }
 
+    /*
+     * Get the number of (de)compression threads.  One less than the host CPU
+     * count so the EMT doing the saving or loading has a CPU of its own.
+     */
+    if (RT_SUCCESS(rc))
+    {
+        RTCPUID cCpus = RTMpGetOnlineCount();
+        rc = CFGMR3QueryU32Def(CFGMR3GetChild(CFGMR3GetRoot(pVM), "SSM"), "ZipThreads", &pVM->ssm.s.cZipThreads,
+                               RT_MIN(cCpus > 1 ? cCpus - 1 : 0, 8));
+        AssertLogRelRC(rc);
+    }
+
     pVM->ssm.s.fInitialized = RT_SUCCESS(rc);
     return rc;
 }
@@ -1679,6 +1806,7 @@ static int ssmR3StrmInitInternal(PSSMSTRM pStrm, bool fChecksummed, uint32_t cBu
     pStrm->fChecksummed = fChecksummed;
     pStrm->u32StreamCRC = fChecksummed ? RTCrc32Start() : 0;
     pStrm->offStreamCRC = 0;
+    pStrm->cCRCPending  = 0;
 
     /*
      * Allocate the buffers.  Page align them in case that makes the kernel
@@ -2009,6 +2137,7 @@ static PSSMSTRMBUF ssmR3StrmGetFreeBuf(PSSMSTRM pStrm)
             pMine->pNext        = NULL;
             pMine->fEndOfStream = false;
             pMine->NanoTS       = RTTimeNanoTS();
+            pMine->offCRC       = UINT32_MAX;
             return pMine;
         }
     }
@@ -2125,9 +2254,18 @@ static void ssmR3StrmFlushCurBuf(PSSMSTRM pStrm)
             pBuf->offStream = pStrm->offCurStream;
             if (    pStrm->fChecksummed
                 &&  pStrm->offStreamCRC < cb)
-                pStrm->u32StreamCRC = RTCrc32Process(pStrm->u32StreamCRC,
-                                                     &pBuf->abData[pStrm->offStreamCRC],
-                                                     cb - pStrm->offStreamCRC);
+            {
+                /* Leave the checksumming to the I/O thread if we've got one. */
+                if (pStrm->hIoThread != NIL_RTTHREAD)
+                {
+                    pBuf->offCRC = pStrm->offStreamCRC;
+                    ASMAtomicIncU32(&pStrm->cCRCPending);
+                }
+                else
+                    pStrm->u32StreamCRC = RTCrc32Process(pStrm->u32StreamCRC,
+                                                         &pBuf->abData[pStrm->offStreamCRC],
+                                                         cb - pStrm->offStreamCRC);
+            }
             pStrm->offCurStream += cb;
             pStrm->off           = 0;
             pStrm->offStreamCRC  = 0;
@@ -2186,6 +2324,14 @@ static int ssmR3StrmWriteBuffers(PSSMSTRM pStrm)
         PSSMSTRMBUF pCur = pHead;
         pHead = pCur->pNext;
 
+        /* checksum */
+        if (pCur->offCRC != UINT32_MAX)
+        {
+            pStrm->u32StreamCRC = RTCrc32Process(pStrm->u32StreamCRC, &pCur->abData[pCur->offCRC], pCur->cb - pCur->offCRC);
+            pCur->offCRC = UINT32_MAX;
+            ASMAtomicDecU32(&pStrm->cCRCPending);
+        }
+
         /* flush */
         rc = pStrm->pOps->pfnIsOk(pStrm->pvUser);
         if (RT_SUCCESS(rc))
@@ -2681,6 +2827,12 @@ static uint32_t ssmR3StrmCurCRC(PSSMSTRM pStrm)
 {
     if (!pStrm->fChecksummed)
         return 0;
+
+    /* Wait for the I/O thread to checksum the buffers we've queued. */
+    while (   ASMAtomicReadU32(&pStrm->cCRCPending)
+           && RT_SUCCESS(pStrm->rc))
+        RTSemEventWaitNoResume(pStrm->hEvtFree, 30000);
+
     if (pStrm->offStreamCRC < pStrm->off)
     {
         PSSMSTRMBUF pBuf = pStrm->pCur; Assert(pBuf);
@@ -2956,6 +3108,301 @@ static void ssmR3StrmStartIoThread(PSSMSTRM pStrm)
 
 #endif /* !SSM_STANDALONE */
 
+
+/**
+ * Compresses one block into a complete record, falling back on a raw record
+ * if it doesn't compress.
+ *
+ * @returns The size of the record, header included.
+ * @param   pb          Where to put the record.  Must have room for
+ *                      1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE bytes.
+ * @param   pvBlock     The SSM_ZIP_BLOCK_SIZE bytes to compress.
+ *
+ * @thread  Any.
+ */
+static size_t ssmR3DataCompressBlock(uint8_t *pb, const void *pvBlock)
+{
+    AssertCompile(1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE < 0x00010000);
+    size_t cbRec = SSM_ZIP_BLOCK_SIZE - (SSM_ZIP_BLOCK_SIZE / 16);
+    int rc = RTZipBlockCompress(RTZIPTYPE_LZF, RTZIPLEVEL_FAST, 0 /*fFlags*/,
+                                pvBlock, SSM_ZIP_BLOCK_SIZE,
+                                pb + 1 + 3 + 1, cbRec, &cbRec);
+    if (RT_SUCCESS(rc))
+    {
+        pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_LZF;
+        pb[4] = SSM_ZIP_BLOCK_SIZE / _1K;
+        cbRec += 1;
+    }
+    else
+    {
+        pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW;
+        memcpy(&pb[4], pvBlock, SSM_ZIP_BLOCK_SIZE);
+        cbRec = SSM_ZIP_BLOCK_SIZE;
+    }
+    pb[1] = (uint8_t)(0xe0 | ( cbRec >> 12));
+    pb[2] = (uint8_t)(0x80 | ((cbRec >>  6) & 0x3f));
+    pb[3] = (uint8_t)(0x80 | ( cbRec        & 0x3f));
+    return cbRec + 1 + 3;
+}
+
+
+/**
+ * Does the (de)compression work for a pipeline slot.
+ *
+ * @param   pPool       The pool.
+ * @param   pSlot       The slot, BUSY and owned by the caller.
+ *
+ * @thread  Any.
+ */
+static void ssmR3ZipProcessSlot(PSSMZIPPOOL pPool, PSSMZIPSLOT pSlot)
+{
+    if (pPool->fWrite)
+        pSlot->cbDst = (uint32_t)ssmR3DataCompressBlock(&pSlot->abDst[0], &pSlot->abSrc[0]);
+    else
+    {
+        size_t cbDstActual = 0;
+        int rc = RTZipBlockDecompress(RTZIPTYPE_LZF, 0 /*fFlags*/,
+                                      &pSlot->abSrc[0], pSlot->cbSrc, NULL /*pcbSrcActual*/,
+                                      &pSlot->abDst[0], pSlot->cbDst, &cbDstActual);
+        if (RT_SUCCESS(rc) && cbDstActual != pSlot->cbDst)
+            rc = VERR_SSM_INTEGRITY_DECOMPRESSION;
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("SSM: cbCompr=%#x cbDecompr=%#x cbDstActual=%#zx rc=%Rrc\n", pSlot->cbSrc, pSlot->cbDst, cbDstActual, rc));
+            rc = VERR_SSM_INTEGRITY_DECOMPRESSION;
+        }
+        pSlot->rc = rc;
+    }
+}
+
+
+/**
+ * Marks a slot done and wakes up the handle owner if it's waiting.
+ *
+ * @param   pPool       The pool.
+ * @param   pSlot       The slot.
+ */
+DECLINLINE(void) ssmR3ZipCompleteSlot(PSSMZIPPOOL pPool, PSSMZIPSLOT pSlot)
+{
+    ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_READY);
+    if (ASMAtomicXchgBool(&pPool->fWaiting, false))
+        RTSemEventSignal(pPool->hEvtDone);
+}
+
+
+/**
+ * The (de)compression thread.
+ *
+ * @returns VINF_SUCCESS (ignored).
+ * @param   hSelf       The thread handle.
+ * @param   pvPool      The pool.
+ */
+static DECLCALLBACK(int) ssmR3ZipThread(RTTHREAD hSelf, void *pvPool)
+{
+    PSSMZIPPOOL pPool = (PSSMZIPPOOL)pvPool;
+    NOREF(hSelf);
+
+    while (!ASMAtomicReadBool(&pPool->fTerminate))
+    {
+        /*
+         * Look for a queued slot and claim it.  If there is more work after
+         * it, get another thread going on that.
+         */
+        PSSMZIPSLOT pMine = NULL;
+        for (uint32_t i = 0; i < SSM_ZIP_SLOTS; i++)
+        {
+            PSSMZIPSLOT pSlot = &pPool->aSlots[i];
+            if (ASMAtomicReadU32(&pSlot->enmState) == SSMZIPSLOT_STATE_QUEUED)
+            {
+                if (!pMine)
+                {
+                    if (ASMAtomicCmpXchgU32(&pSlot->enmState, SSMZIPSLOT_STATE_BUSY, SSMZIPSLOT_STATE_QUEUED))
+                        pMine = pSlot;
+                }
+                else
+                {
+                    RTSemEventSignal(pPool->hEvtWork);
+                    break;
+                }
+            }
+        }
+
+        if (pMine)
+        {
+            ssmR3ZipProcessSlot(pPool, pMine);
+            ssmR3ZipCompleteSlot(pPool, pMine);
+        }
+        else
+            RTSemEventWait(pPool->hEvtWork, RT_INDEFINITE_WAIT);
+    }
+
+    /* Pass on the termination signal. */
+    RTSemEventSignal(pPool->hEvtWork);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Waits for a slot to become ready, doing the work ourselves if no thread has
+ * picked it up yet.
+ *
+ * @param   pPool       The pool.
+ * @param   pSlot       The slot.
+ *
+ * @thread  The handle owner.
+ */
+static void ssmR3ZipWaitForSlot(PSSMZIPPOOL pPool, PSSMZIPSLOT pSlot)
+{
+    for (;;)
+    {
+        uint32_t enmState = ASMAtomicReadU32(&pSlot->enmState);
+        if (enmState == SSMZIPSLOT_STATE_READY)
+            return;
+        if (   enmState == SSMZIPSLOT_STATE_QUEUED
+            && ASMAtomicCmpXchgU32(&pSlot->enmState, SSMZIPSLOT_STATE_BUSY, SSMZIPSLOT_STATE_QUEUED))
+        {
+            ssmR3ZipProcessSlot(pPool, pSlot);
+            ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_READY);
+            return;
+        }
+
+        ASMAtomicWriteBool(&pPool->fWaiting, true);
+        if (ASMAtomicReadU32(&pSlot->enmState) == SSMZIPSLOT_STATE_BUSY)
+            RTSemEventWait(pPool->hEvtDone, 1000);
+        ASMAtomicWriteBool(&pPool->fWaiting, false);
+    }
+}
+
+
+/**
+ * Gets the next free pipeline slot.
+ *
+ * The caller must make sure there is one.
+ *
+ * @returns Pointer to the slot.
+ * @param   pPool       The pool.
+ */
+DECLINLINE(PSSMZIPSLOT) ssmR3ZipNewSlot(PSSMZIPPOOL pPool)
+{
+    Assert(pPool->iTail - pPool->iHead < SSM_ZIP_SLOTS);
+    PSSMZIPSLOT pSlot = &pPool->aSlots[pPool->iTail++ % SSM_ZIP_SLOTS];
+    Assert(pSlot->enmState == SSMZIPSLOT_STATE_FREE);
+    pSlot->u8TypeAndFlags = SSM_REC_TYPE_INT_DECODED;
+    pSlot->rc             = VINF_SUCCESS;
+    pSlot->cbSrc          = 0;
+    pSlot->cbDst          = 0;
+    return pSlot;
+}
+
+
+/**
+ * Queues a slot for (de)compression.
+ *
+ * @param   pPool       The pool.
+ * @param   pSlot       The slot.
+ */
+DECLINLINE(void) ssmR3ZipQueueSlot(PSSMZIPPOOL pPool, PSSMZIPSLOT pSlot)
+{
+    ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_QUEUED);
+    RTSemEventSignal(pPool->hEvtWork);
+}
+
+
+/**
+ * Waits for all pending work and empties the pipeline.
+ *
+ * @param   pPool       The pool.
+ */
+static void ssmR3ZipReset(PSSMZIPPOOL pPool)
+{
+    while (pPool->iHead != pPool->iTail)
+    {
+        PSSMZIPSLOT pSlot = &pPool->aSlots[pPool->iHead++ % SSM_ZIP_SLOTS];
+        ssmR3ZipWaitForSlot(pPool, pSlot);
+        ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_FREE);
+    }
+}
+
+
+#ifndef SSM_STANDALONE
+/**
+ * Creates the parallel (de)compression pool for a handle.
+ *
+ * Failure is not fatal, we'll just do the work on the calling thread.
+ *
+ * @param   pSSM        The saved state handle.
+ * @param   cThreads    The number of threads, 0 means no pool.
+ * @param   fWrite      Save (true) or load (false).
+ */
+static void ssmR3ZipCreate(PSSMHANDLE pSSM, uint32_t cThreads, bool fWrite)
+{
+    Assert(!pSSM->pZipPool);
+    if (!cThreads)
+        return;
+    cThreads = RT_MIN(cThreads, SSM_ZIP_MAX_THREADS);
+
+    PSSMZIPPOOL pPool = (PSSMZIPPOOL)RTMemPageAllocZ(sizeof(*pPool));
+    if (!pPool)
+        return;
+    pPool->fWrite = fWrite;
+    int rc = RTSemEventCreate(&pPool->hEvtWork);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTSemEventCreate(&pPool->hEvtDone);
+        if (RT_SUCCESS(rc))
+        {
+            while (pPool->cThreads < cThreads)
+            {
+                rc = RTThreadCreateF(&pPool->ahThreads[pPool->cThreads], ssmR3ZipThread, pPool, 0,
+                                     RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "SSM-Zip%u", pPool->cThreads);
+                if (RT_FAILURE(rc))
+                    break;
+                pPool->cThreads++;
+            }
+            if (pPool->cThreads)
+            {
+                LogRel(("SSM: Using %u %s threads\n", pPool->cThreads, fWrite ? "compression" : "decompression"));
+                pSSM->pZipPool = pPool;
+                return;
+            }
+            RTSemEventDestroy(pPool->hEvtDone);
+        }
+        RTSemEventDestroy(pPool->hEvtWork);
+    }
+    LogRel(("SSM: Failed to create the %u (de)compression threads: %Rrc\n", cThreads, rc));
+    RTMemPageFree(pPool, sizeof(*pPool));
+}
+#endif /* !SSM_STANDALONE */
+
+
+/**
+ * Destroys the (de)compression pool of a handle, if it has one.
+ *
+ * Any pending work is waited for and discarded.
+ *
+ * @param   pSSM        The saved state handle.
+ */
+static void ssmR3ZipDestroy(PSSMHANDLE pSSM)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    if (!pPool)
+        return;
+    pSSM->pZipPool = NULL;
+
+    ssmR3ZipReset(pPool);
+    ASMAtomicWriteBool(&pPool->fTerminate, true);
+    RTSemEventSignal(pPool->hEvtWork);
+    for (uint32_t i = 0; i < pPool->cThreads; i++)
+    {
+        int rc = RTThreadWait(pPool->ahThreads[i], RT_INDEFINITE_WAIT, NULL);
+        AssertLogRelRC(rc);
+    }
+    RTSemEventDestroy(pPool->hEvtWork);
+    RTSemEventDestroy(pPool->hEvtDone);
+    RTMemPageFree(pPool, sizeof(*pPool));
+}
+
+
 /**
  * Works the progress calculation for non-live saves and restores.
  *
@@ -3066,7 +3513,7 @@ DECLINLINE(bool) ssmR3IsHostMsc32(PSSMHANDLE pSSM)
 static int ssmR3DataWriteFinish(PSSMHANDLE pSSM)
 {
     //Log2(("ssmR3DataWriteFinish: %#010llx start\n", ssmR3StrmTell(&pSSM->Strm)));
-    int rc = ssmR3DataFlushBuffer(pSSM);
+    int rc = ssmR3DataFlushAll(pSSM);
     if (RT_SUCCESS(rc))
     {
         pSSM->offUnit     = UINT64_MAX;
@@ -3095,6 +3542,100 @@ static void ssmR3DataWriteBegin(PSSMHANDLE pSSM)
 }
 
 
+/**
+ * Commits ready slots at the head of the compression pipeline to the stream.
+ *
+ * @returns VBox status code. Sets pSSM->rc on failure.
+ * @param   pSSM            The saved state handle.
+ * @param   cMaxPending     The max number of slots to leave in the pipeline,
+ *                          we'll wait for the work to be done until we get
+ *                          there.  Pass 0 to drain it, SSM_ZIP_SLOTS to
+ *                          only commit what's ready.
+ */
+static int ssmR3DataWriteZipCommit(PSSMHANDLE pSSM, uint32_t cMaxPending)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    while (pPool->iHead != pPool->iTail)
+    {
+        PSSMZIPSLOT pSlot = &pPool->aSlots[pPool->iHead % SSM_ZIP_SLOTS];
+        if (ASMAtomicReadU32(&pSlot->enmState) != SSMZIPSLOT_STATE_READY)
+        {
+            if (pPool->iTail - pPool->iHead <= cMaxPending)
+                break;
+            ssmR3ZipWaitForSlot(pPool, pSlot);
+        }
+
+        int rc = pSlot->cbDst ? ssmR3StrmWrite(&pSSM->Strm, &pSlot->abDst[0], pSlot->cbDst) : VINF_SUCCESS;
+        pSSM->offUnit += pSlot->cbDst;
+        ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_FREE);
+        pPool->iHead++;
+        if (RT_FAILURE(rc))
+        {
+            ssmR3ZipReset(pPool);
+            return pSSM->rc = rc;
+        }
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Gets a free slot for the compression pipeline, committing the head slot if
+ * it is full.
+ *
+ * @returns VBox status code. Sets pSSM->rc on failure.
+ * @param   pSSM            The saved state handle.
+ * @param   ppSlot          Where to return the slot.
+ */
+static int ssmR3DataWriteZipNewSlot(PSSMHANDLE pSSM, PSSMZIPSLOT *ppSlot)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    if (pPool->iTail - pPool->iHead >= SSM_ZIP_SLOTS)
+    {
+        int rc = ssmR3DataWriteZipCommit(pSSM, SSM_ZIP_SLOTS - 1);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+    *ppSlot = ssmR3ZipNewSlot(pPool);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Queues raw bytes behind the pending compression work.
+ *
+ * @returns VBox status code. Sets pSSM->rc on failure.
+ * @param   pSSM            The saved state handle.
+ * @param   pvBuf           The bits to write.
+ * @param   cbBuf           The number of bytes to write.
+ */
+static int ssmR3DataWriteZipRaw(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    while (cbBuf > 0)
+    {
+        /* Append to the last slot if it's done and has room, else use a new one. */
+        PSSMZIPSLOT pSlot = &pPool->aSlots[(pPool->iTail - 1) % SSM_ZIP_SLOTS];
+        if (   pPool->iHead == pPool->iTail
+            || ASMAtomicReadU32(&pSlot->enmState) != SSMZIPSLOT_STATE_READY
+            || pSlot->cbDst >= sizeof(pSlot->abDst))
+        {
+            int rc = ssmR3DataWriteZipNewSlot(pSSM, &pSlot);
+            if (RT_FAILURE(rc))
+                return rc;
+            ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_READY);
+        }
+
+        size_t cbCopy = RT_MIN(cbBuf, sizeof(pSlot->abDst) - pSlot->cbDst);
+        memcpy(&pSlot->abDst[pSlot->cbDst], pvBuf, cbCopy);
+        pSlot->cbDst += (uint32_t)cbCopy;
+        cbBuf        -= cbCopy;
+        pvBuf         = (uint8_t const *)pvBuf + cbCopy;
+    }
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Writes a record to the current data item in the saved state file.
  *
@@ -3114,6 +3655,13 @@ static int ssmR3DataWriteRaw(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
     if (RT_FAILURE(pSSM->rc))
         return pSSM->rc;
 
+    /*
+     * Keep it in order with any pending compression work.
+     */
+    if (    pSSM->pZipPool
+        &&  pSSM->pZipPool->iHead != pSSM->pZipPool->iTail)
+        return ssmR3DataWriteZipRaw(pSSM, pvBuf, cbBuf);
+
     /*
      * Write the data item in 1MB chunks for progress indicator reasons.
      */
@@ -3229,6 +3777,23 @@ static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
 }
 
 
+/**
+ * Flushes the buffered data and drains the compression pipeline, so that the
+ * stream position, CRC and pSSM->offUnit are all up to date.
+ *
+ * @returns VBox status code. Will set pSSM->rc on error.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataFlushAll(PSSMHANDLE pSSM)
+{
+    int rc = ssmR3DataFlushBuffer(pSSM);
+    if (    RT_SUCCESS(rc)
+        &&  pSSM->pZipPool)
+        rc = ssmR3DataWriteZipCommit(pSSM, 0);
+    return rc;
+}
+
+
 /**
  * ssmR3DataWrite worker that writes big stuff.
  *
@@ -3256,38 +3821,34 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
                )
             {
                 /*
-                 * Compress it.
+                 * Compress it, either by handing it to the compression
+                 * threads or directly into the stream buffer.
                  */
-                AssertCompile(1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE < 0x00010000);
-                uint8_t *pb;
-                rc = ssmR3StrmReserveWriteBufferSpace(&pSSM->Strm, 1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE, &pb);
-                if (RT_FAILURE(rc))
-                    break;
-                size_t cbRec = SSM_ZIP_BLOCK_SIZE - (SSM_ZIP_BLOCK_SIZE / 16);
-                rc = RTZipBlockCompress(RTZIPTYPE_LZF, RTZIPLEVEL_FAST, 0 /*fFlags*/,
-                                        pvBuf, SSM_ZIP_BLOCK_SIZE,
-                                        pb + 1 + 3 + 1, cbRec, &cbRec);
-                if (RT_SUCCESS(rc))
+                if (pSSM->pZipPool)
                 {
-                    pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_LZF;
-                    pb[4] = SSM_ZIP_BLOCK_SIZE / _1K;
-                    cbRec += 1;
+                    PSSMZIPSLOT pSlot;
+                    rc = ssmR3DataWriteZipNewSlot(pSSM, &pSlot);
+                    if (RT_FAILURE(rc))
+                        break;
+                    memcpy(&pSlot->abSrc[0], pvBuf, SSM_ZIP_BLOCK_SIZE);
+                    pSlot->cbSrc = SSM_ZIP_BLOCK_SIZE;
+                    ssmR3ZipQueueSlot(pSSM->pZipPool, pSlot);
+                    rc = ssmR3DataWriteZipCommit(pSSM, SSM_ZIP_SLOTS);
+                    if (RT_FAILURE(rc))
+                        break;
                 }
                 else
                 {
-                    pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW;
-                    memcpy(&pb[4], pvBuf, SSM_ZIP_BLOCK_SIZE);
-                    cbRec = SSM_ZIP_BLOCK_SIZE;
+                    uint8_t *pb;
+                    rc = ssmR3StrmReserveWriteBufferSpace(&pSSM->Strm, 1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE, &pb);
+                    if (RT_FAILURE(rc))
+                        break;
+                    size_t cbRec = ssmR3DataCompressBlock(pb, pvBuf);
+                    rc = ssmR3StrmCommitWriteBufferSpace(&pSSM->Strm, cbRec);
+                    if (RT_FAILURE(rc))
+                        break;
+                    pSSM->offUnit += cbRec;
                 }
-                pb[1] = (uint8_t)(0xe0 | ( cbRec >> 12));
-                pb[2] = (uint8_t)(0x80 | ((cbRec >>  6) & 0x3f));
-                pb[3] = (uint8_t)(0x80 | ( cbRec        & 0x3f));
-                cbRec += 1 + 3;
-                rc = ssmR3StrmCommitWriteBufferSpace(&pSSM->Strm, cbRec);
-                if (RT_FAILURE(rc))
-                    break;
-
-                pSSM->offUnit += cbRec;
                 ssmR3ProgressByByte(pSSM, SSM_ZIP_BLOCK_SIZE);
 
                 /* advance */
@@ -4190,7 +4751,7 @@ static int ssmR3LiveControlEmit(PSSMHANDLE pSSM, long double lrdPct, uint32_t uP
         AssertMsg(u16PartsPerTenThousand <= 10000, ("%u\n", u16PartsPerTenThousand));
         ssmR3DataWrite(pSSM, &u16PartsPerTenThousand, sizeof(u16PartsPerTenThousand));
 
-        rc = ssmR3DataFlushBuffer(pSSM); /* will return SSMHANDLE::rc if it is set */
+        rc = ssmR3DataFlushAll(pSSM); /* will return SSMHANDLE::rc if it is set */
         if (RT_SUCCESS(rc))
         {
             /*
@@ -4301,6 +4862,7 @@ static int ssmR3SaveDoClose(PVM pVM, PSSMHANDLE pSSM)
      * Make it non-cancellable, close the stream and delete the file on failure.
      */
     ssmR3SetCancellable(pVM, pSSM, false);
+    ssmR3ZipDestroy(pSSM);
     int rc = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     if (RT_SUCCESS(rc))
         rc = pSSM->rc;
@@ -4622,7 +5184,7 @@ static int ssmR3SaveDoExecRun(PVM pVM, PSSMHANDLE pSSM)
         if (RT_FAILURE(rc) && RT_SUCCESS_NP(pSSM->rc))
             pSSM->rc = rc;
         else
-            rc = ssmR3DataFlushBuffer(pSSM); /* will return SSMHANDLE::rc if it is set */
+            rc = ssmR3DataFlushAll(pSSM); /* will return SSMHANDLE::rc if it is set */
         if (RT_FAILURE(rc))
         {
             LogRel(("SSM: Execute save failed with rc=%Rrc for data unit '%s'/#%u.\n", rc, pUnit->szName, pUnit->u32Instance));
@@ -4889,6 +5451,7 @@ static int ssmR3SaveDoCreateFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS
     pSSM->uPercentDone              = 0;
     pSSM->uReportedLivePercent      = 0;
     pSSM->pszFilename               = pszFilename;
+    pSSM->pZipPool                  = NULL;
     pSSM->u.Write.offDataBuffer     = 0;
     pSSM->u.Write.cMsMaxDowntime    = UINT32_MAX;
 
@@ -4903,6 +5466,7 @@ static int ssmR3SaveDoCreateFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS
         RTMemFree(pSSM);
         return rc;
     }
+    ssmR3ZipCreate(pSSM, pVM->ssm.s.cZipThreads, true /*fWrite*/);
 
     *ppSSM = pSSM;
     return VINF_SUCCESS;
@@ -5191,7 +5755,7 @@ static int ssmR3LiveDoExecRun(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
         {
             if (rc == VINF_SSM_DONT_CALL_AGAIN)
                 pUnit->fDoneLive = true;
-            rc = ssmR3DataFlushBuffer(pSSM); /* will return SSMHANDLE::rc if it is set */
+            rc = ssmR3DataFlushAll(pSSM); /* will return SSMHANDLE::rc if it is set */
         }
         if (RT_FAILURE(rc))
         {
@@ -5493,6 +6057,7 @@ VMMR3_INT_DECL(int) SSMR3LiveSave(PVM pVM, uint32_t cMsMaxDowntime,
         return VINF_SUCCESS;
     }
     /* bail out. */
+    ssmR3ZipDestroy(pSSM);
     int rc2 = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     RTMemFree(pSSM);
     rc2 = RTFileDelete(pszFilename);
@@ -5635,6 +6200,8 @@ static void ssmR3DataReadBeginV2(PSSMHANDLE pSSM)
     pSSM->u.Read.offDataBuffer  = 0;
     pSSM->u.Read.fEndOfData     = false;
     pSSM->u.Read.u8TypeAndFlags = 0;
+    if (pSSM->pZipPool)
+        ssmR3ZipReset(pSSM->pZipPool);
 }
 
 
@@ -5664,7 +6231,7 @@ static int ssmR3DataReadFinishV2(PSSMHANDLE pSSM)
         }
         else
         {
-            rc = ssmR3DataReadRecHdrV2(pSSM);
+            rc = ssmR3DataReadNextRecV2(pSSM);
             if (    RT_SUCCESS(rc)
                 &&  !pSSM->u.Read.fEndOfData)
             {
@@ -5985,6 +6552,198 @@ static int ssmR3DataReadRecHdrV2(PSSMHANDLE pSSM)
 }
 
 
+/**
+ * Reads the body of the record which header was just read into a new
+ * pipeline slot, queuing it for decompression if it's compressed.
+ *
+ * Errors are recorded in the slot and reported when it's popped, so the
+ * records before it are delivered first.
+ *
+ * @returns true if the read-ahead can continue past this record, false if not.
+ * @param   pSSM            The saved state handle.
+ * @param   rcHdr           The ssmR3DataReadRecHdrV2 status.
+ */
+static bool ssmR3DataReadAheadRecV2(PSSMHANDLE pSSM, int rcHdr)
+{
+    PSSMZIPPOOL pPool   = pSSM->pZipPool;
+    PSSMZIPSLOT pSlot   = ssmR3ZipNewSlot(pPool);
+    int const   rcSaved = pSSM->rc;
+    bool        fMore   = false;
+    int         rc      = rcHdr;
+    if (RT_SUCCESS(rc))
+    {
+        uint32_t cb;
+        switch (pSSM->u.Read.u8TypeAndFlags & SSM_REC_TYPE_MASK)
+        {
+            case SSM_REC_TYPE_TERM:
+                pSlot->u8TypeAndFlags   = pSSM->u.Read.u8TypeAndFlags;
+                pSSM->u.Read.fEndOfData = false; /* the pop sets it */
+                break;
+
+            case SSM_REC_TYPE_RAW:
+                if (pSSM->u.Read.cbRecLeft > sizeof(pSSM->u.Read.abDataBuffer))
+                {
+                    pSlot->u8TypeAndFlags = pSSM->u.Read.u8TypeAndFlags;
+                    pSlot->cbDst          = pSSM->u.Read.cbRecLeft;
+                    break;
+                }
+                cb = pSSM->u.Read.cbRecLeft;
+                rc = ssmR3DataReadV2Raw(pSSM, &pSlot->abDst[0], cb);
+                if (RT_SUCCESS(rc))
+                {
+                    pSlot->cbDst = cb;
+                    fMore = true;
+                }
+                break;
+
+            case SSM_REC_TYPE_RAW_LZF:
+                rc = ssmR3DataReadV2RawLzfHdr(pSSM, &cb);
+                if (RT_SUCCESS(rc))
+                {
+                    pSlot->cbSrc = pSSM->u.Read.cbRecLeft;
+                    rc = ssmR3DataReadV2Raw(pSSM, &pSlot->abSrc[0], pSlot->cbSrc);
+                }
+                if (RT_SUCCESS(rc))
+                {
+                    pSlot->cbDst = cb;
+                    pSSM->u.Read.cbRecLeft = 0;
+                    ssmR3ZipQueueSlot(pPool, pSlot);
+                    return true;
+                }
+                break;
+
+            case SSM_REC_TYPE_RAW_ZERO:
+                rc = ssmR3DataReadV2RawZeroHdr(pSSM, &cb);
+                if (RT_SUCCESS(rc))
+                {
+                    memset(&pSlot->abDst[0], 0, cb);
+                    pSlot->cbDst = cb;
+                    fMore = true;
+                }
+                break;
+
+            default:
+                /* Leave it to the caller. */
+                pSlot->u8TypeAndFlags = pSSM->u.Read.u8TypeAndFlags;
+                pSlot->cbDst          = pSSM->u.Read.cbRecLeft;
+                break;
+        }
+    }
+    if (RT_FAILURE(rc))
+    {
+        pSlot->rc = rc;
+        pSSM->rc  = rcSaved;
+        fMore     = false;
+    }
+    pSSM->u.Read.cbRecLeft = 0;
+    ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_READY);
+    return fMore;
+}
+
+
+/**
+ * Fills up the decompression pipeline with the records following the current
+ * one.
+ *
+ * @param   pSSM            The saved state handle.
+ */
+static void ssmR3DataReadAheadV2(PSSMHANDLE pSSM)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    while (pPool->iTail - pPool->iHead < SSM_ZIP_SLOTS)
+    {
+        /* Stop at anything that isn't plain data (TERM, errors, big records). */
+        if (pPool->iHead != pPool->iTail)
+        {
+            PSSMZIPSLOT pLast = &pPool->aSlots[(pPool->iTail - 1) % SSM_ZIP_SLOTS];
+            if (   pLast->u8TypeAndFlags != SSM_REC_TYPE_INT_DECODED
+                || pLast->rc != VINF_SUCCESS)
+                break;
+        }
+        if (!ssmR3DataReadAheadRecV2(pSSM, ssmR3DataReadRecHdrV2(pSSM)))
+            break;
+    }
+}
+
+
+/**
+ * Takes the record at the head of the decompression pipeline and makes it the
+ * current one.
+ *
+ * @returns VBox status code. Does not set pSSM->rc.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataReadPopV2(PSSMHANDLE pSSM)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    PSSMZIPSLOT pSlot = &pPool->aSlots[pPool->iHead % SSM_ZIP_SLOTS];
+    ssmR3ZipWaitForSlot(pPool, pSlot);
+
+    int rc = pSlot->rc;
+    if (RT_SUCCESS(rc))
+    {
+        pSSM->u.Read.u8TypeAndFlags = pSlot->u8TypeAndFlags;
+        if (pSlot->u8TypeAndFlags == SSM_REC_TYPE_INT_DECODED)
+        {
+            memcpy(&pSSM->u.Read.abDataBuffer[0], &pSlot->abDst[0], pSlot->cbDst);
+            pSSM->u.Read.cbDataBuffer  = pSlot->cbDst;
+            pSSM->u.Read.offDataBuffer = 0;
+            pSSM->u.Read.cbRecLeft     = 0;
+        }
+        else if ((pSlot->u8TypeAndFlags & SSM_REC_TYPE_MASK) == SSM_REC_TYPE_TERM)
+        {
+            pSSM->u.Read.cbRecLeft  = 0;
+            pSSM->u.Read.fEndOfData = true;
+        }
+        else
+            pSSM->u.Read.cbRecLeft  = pSlot->cbDst;
+    }
+
+    ASMAtomicWriteU32(&pSlot->enmState, SSMZIPSLOT_STATE_FREE);
+    pPool->iHead++;
+    return rc;
+}
+
+
+/**
+ * Gets the next record, from the decompression pipeline when we've got one.
+ *
+ * Same semantics as ssmR3DataReadRecHdrV2, except that the record may have
+ * been decoded already, in which case the type is SSM_REC_TYPE_INT_DECODED
+ * and the data is in the data buffer.
+ *
+ * @returns VBox status code. Does not set pSSM->rc.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataReadNextRecV2(PSSMHANDLE pSSM)
+{
+    PSSMZIPPOOL pPool = pSSM->pZipPool;
+    if (!pPool)
+        return ssmR3DataReadRecHdrV2(pSSM);
+
+    if (pPool->iHead != pPool->iTail)
+    {
+        if (pPool->iTail - pPool->iHead <= SSM_ZIP_SLOTS / 2)
+            ssmR3DataReadAheadV2(pSSM);
+        return ssmR3DataReadPopV2(pSSM);
+    }
+
+    /*
+     * Only start reading ahead when we hit compressed data, the rest is
+     * cheap enough to do on demand.
+     */
+    int rc = ssmR3DataReadRecHdrV2(pSSM);
+    if (    RT_SUCCESS(rc)
+        &&  (pSSM->u.Read.u8TypeAndFlags & SSM_REC_TYPE_MASK) == SSM_REC_TYPE_RAW_LZF)
+    {
+        if (ssmR3DataReadAheadRecV2(pSSM, rc))
+            ssmR3DataReadAheadV2(pSSM);
+        rc = ssmR3DataReadPopV2(pSSM);
+    }
+    return rc;
+}
+
+
 /**
  * Buffer miss, do an unbuffered read.
  *
@@ -6024,7 +6783,7 @@ static int ssmR3DataReadUnbufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
          */
         if (!pSSM->u.Read.cbRecLeft)
         {
-            int rc = ssmR3DataReadRecHdrV2(pSSM);
+            int rc = ssmR3DataReadNextRecV2(pSSM);
             if (RT_FAILURE(rc))
                 return pSSM->rc = rc;
         }
@@ -6088,6 +6847,17 @@ static int ssmR3DataReadUnbufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
                 break;
             }
 
+            case SSM_REC_TYPE_INT_DECODED:
+            {
+                cbToRead = (uint32_t)RT_MIN(cbBuf, pSSM->u.Read.cbDataBuffer);
+                memcpy(pvBuf, &pSSM->u.Read.abDataBuffer[0], cbToRead);
+                if (cbToRead < pSSM->u.Read.cbDataBuffer)
+                    pSSM->u.Read.offDataBuffer = cbToRead;
+                else
+                    pSSM->u.Read.cbDataBuffer  = 0;
+                break;
+            }
+
             default:
                 AssertMsgFailedReturn(("%x\n", pSSM->u.Read.u8TypeAndFlags), VERR_SSM_BAD_REC_TYPE);
         }
@@ -6145,7 +6915,7 @@ static int ssmR3DataReadBufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
          */
         if (!pSSM->u.Read.cbRecLeft)
         {
-            int rc = ssmR3DataReadRecHdrV2(pSSM);
+            int rc = ssmR3DataReadNextRecV2(pSSM);
             if (RT_FAILURE(rc))
                 return pSSM->rc = rc;
         }
@@ -6191,6 +6961,11 @@ static int ssmR3DataReadBufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
                 break;
             }
 
+            case SSM_REC_TYPE_INT_DECODED:
+                /* Already in the data buffer. */
+                cbToRead = pSSM->u.Read.cbDataBuffer;
+                break;
+
             default:
                 AssertMsgFailedReturn(("%x\n", pSSM->u.Read.u8TypeAndFlags), VERR_SSM_BAD_REC_TYPE);
         }
@@ -7207,10 +7982,12 @@ VMMR3DECL(int) SSMR3SkipToEndOfUnit(PSSMHANDLE pSSM)
                 }
 
                 /* read the next header. */
-                int rc = ssmR3DataReadRecHdrV2(pSSM);
+                int rc = ssmR3DataReadNextRecV2(pSSM);
                 if (RT_FAILURE(rc))
                     return pSSM->rc = rc;
             } while (!pSSM->u.Read.fEndOfData);
+            pSSM->u.Read.cbDataBuffer  = 0;
+            pSSM->u.Read.offDataBuffer = 0;
         }
     }
     /* else: Doesn't matter for the version 1 loading. */
@@ -7712,6 +8489,7 @@ static int ssmR3OpenFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
     pSSM->uPercentDone          = 2;
     pSSM->uReportedLivePercent  = 0;
     pSSM->pszFilename           = pszFilename;
+    pSSM->pZipPool              = NULL;
 
     pSSM->u.Read.pZipDecompV1   = NULL;
     pSSM->u.Read.uFmtVerMajor   = UINT32_MAX;
@@ -8301,6 +9079,7 @@ VMMR3DECL(int) SSMR3Load(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
     if (RT_SUCCESS(rc))
     {
         ssmR3StrmStartIoThread(&Handle.Strm);
+        ssmR3ZipCreate(&Handle, pVM->ssm.s.cZipThreads, false /*fWrite*/);
         ssmR3SetCancellable(pVM, &Handle, true);
 
         Handle.enmAfter         = enmAfter;
@@ -8451,6 +9230,7 @@ VMMR3DECL(int) SSMR3Load(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
             pfnProgress(pVM, 99, pvProgressUser);
 
         ssmR3SetCancellable(pVM, &Handle, false);
+        ssmR3ZipDestroy(&Handle);
         ssmR3StrmClose(&Handle.Strm, Handle.rc == VERR_SSM_CANCELLED);
         rc = Handle.rc;
     }
@@ -36,6 +36,15 @@
  * Some types also allows STAM to reset the data, which is very convenient when
  * digging into specific operations and such.
  *
+ * The samples are kept in a list sorted by name, which is what the "all"
+ * enumeration walks, and indexed by a tree with a node per name component
+ * (STAMLOOKUP).  Registration uses the tree to find the sample's place in the
+ * list, so registering N samples doesn't cost O(N^2) string compares any
+ * longer, only a binary search per name component plus work linear in the
+ * number of siblings, and the pattern enumerations only visit the subtrees the
+ * literal prefixes of the patterns lead to.  Deregistration looks up the sample
+ * address in an AVL tree.
+ *
  * PS. The VirtualBox Debugger GUI has a viewer for inspecting the statistics
  * STAM provides.  You will also find statistics in the release and debug logs.
  * And as mentioned in the introduction, the debugger console features a couple
@@ -111,6 +120,59 @@ typedef struct STAMR3SNAPSHOTONE
 } STAMR3SNAPSHOTONE, *PSTAMR3SNAPSHOTONE;
 
 
+/**
+ * A binary statistics snapshot, see STAMR3BinSnapshotCreateU.
+ *
+ * This is the sample selection (the layout) that is done once, so that
+ * subsequent STAMR3BinSnapshotQueryValuesU calls only has to copy the raw
+ * values into the caller's buffer without any pattern matching or formatting.
+ */
+typedef struct STAMBINSNAPSHOT
+{
+    /** Magic value (STAMBINSNAPSHOT_MAGIC). */
+    uint32_t        u32Magic;
+    /** The sample registration generation the layout was made in. */
+    uint32_t        uGeneration;
+    /** The user mode VM structure the snapshot belongs to. */
+    PUVM            pUVM;
+    /** The pattern the snapshot was made with, "*" if none was given.  Used
+     * for refreshing the ring-0 statistics it may include. */
+    char           *pszPat;
+    /** The total number of values. */
+    uint32_t        cValues;
+    /** The number of samples in papDescs. */
+    uint32_t        cDescs;
+    /** The number of entries allocated in papDescs. */
+    uint32_t        cDescsAlloc;
+    /** The samples in the snapshot. */
+    PSTAMDESC      *papDescs;
+} STAMBINSNAPSHOT;
+/** Magic value for STAMBINSNAPSHOT::u32Magic (Cecil Percival Taylor). */
+#define STAMBINSNAPSHOT_MAGIC       UINT32_C(0x19290325)
+
+
+/**
+ * A pattern expression prepared for walking the lookup tree.
+ */
+typedef struct STAMR3ENUMEXPR
+{
+    /** The expression. */
+    const char     *pszPat;
+    /** The length of the literal prefix, i.e. the part before the first
+     * wildcard. */
+    size_t          cchPrefix;
+    /** Whether there is anything after the prefix. */
+    bool            fWildcards;
+    /** The deepest lookup tree node covering all names the expression can
+     * match.  NULL if it cannot match anything. */
+    PSTAMLOOKUP     pStart;
+} STAMR3ENUMEXPR;
+/** Pointer to a prepared pattern expression. */
+typedef STAMR3ENUMEXPR *PSTAMR3ENUMEXPR;
+/** Pointer to a const prepared pattern expression. */
+typedef const STAMR3ENUMEXPR *PCSTAMR3ENUMEXPR;
+
+
 /**
  * Init record for a ring-0 statistic sample.
  */
@@ -134,12 +196,16 @@ typedef struct STAMR0SAMPLE
 *******************************************************************************/
 static int                  stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfnReset, PFNSTAMR3CALLBACKPRINT pfnPrint,
                                             STAMTYPE enmType, STAMVISIBILITY enmVisibility, const char *pszName, STAMUNIT enmUnit, const char *pszDesc);
+static void                 stamR3LookupPrune(PSTAMLOOKUP pLookup);
+static void                 stamR3LookupDestroyTree(PSTAMLOOKUP pLookup);
+static void                 stamR3DestroyDesc(PSTAMDESC pDesc);
 static int                  stamR3ResetOne(PSTAMDESC pDesc, void *pvArg);
 static DECLCALLBACK(void)   stamR3EnumLogPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static DECLCALLBACK(void)   stamR3EnumRelLogPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static DECLCALLBACK(void)   stamR3EnumPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static int                  stamR3SnapshotOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3SnapshotPrintf(PSTAMR3SNAPSHOTONE pThis, const char *pszFormat, ...);
+static int                  stamR3BinSnapshotOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3PrintOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3EnumOne(PSTAMDESC pDesc, void *pvArg);
 static bool                 stamR3MultiMatch(const char * const *papszExpressions, unsigned cExpressions, unsigned *piExpression, const char *pszName);
@@ -229,8 +295,12 @@ static const STAMR0SAMPLE g_aGMMStats[] =
     { RT_UOFFSETOF(GMMSTATS, cDuplicatePages),                  STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/cDuplicatePages",             "The number of pages that are actually shared between VMs." },
     { RT_UOFFSETOF(GMMSTATS, cLeftBehindSharedPages),           STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/cLeftBehindSharedPages",      "The number of pages that are shared that has been left behind by VMs not doing proper cleanups." },
     { RT_UOFFSETOF(GMMSTATS, cBalloonedPages),                  STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/cBalloonedPages",             "The number of current ballooned pages." },
+    { RT_UOFFSETOF(GMMSTATS, cFusionScannedPages),              STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/cFusionScannedPages",         "The number of pages the page fusion scanner has looked at." },
+    { RT_UOFFSETOF(GMMSTATS, cFusionSharedPages),               STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/cFusionSharedPages",          "The number of pages the page fusion scanner has turned into shared pages." },
+    { RT_UOFFSETOF(GMMSTATS, cFusionSavedPages),                STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/cFusionSavedPages",           "The number of pages the page fusion scanner has freed by merging them with a shared page." },
     { RT_UOFFSETOF(GMMSTATS, cChunks),                          STAMTYPE_U32,   STAMUNIT_COUNT, "/GMM/cChunks",                     "The number of allocation chunks." },
     { RT_UOFFSETOF(GMMSTATS, cFreedChunks),                     STAMTYPE_U32,   STAMUNIT_COUNT, "/GMM/cFreedChunks",                "The number of freed chunks ever." },
+    { RT_UOFFSETOF(GMMSTATS, cNumaNodes),                       STAMTYPE_U32,   STAMUNIT_COUNT, "/GMM/cNumaNodes",                  "The number of host NUMA nodes GMM keeps track of." },
     { RT_UOFFSETOF(GMMSTATS, cShareableModules),                STAMTYPE_U32,   STAMUNIT_COUNT, "/GMM/cShareableModules",           "The number of shareable modules." },
     { RT_UOFFSETOF(GMMSTATS, VMStats.Reserved.cBasePages),      STAMTYPE_U64,   STAMUNIT_PAGES, "/GMM/VM/Reserved/cBasePages",      "The amount of base memory (RAM, ROM, ++) reserved by the VM." },
     { RT_UOFFSETOF(GMMSTATS, VMStats.Reserved.cShadowPages),    STAMTYPE_U32,   STAMUNIT_PAGES, "/GMM/VM/Reserved/cShadowPages",    "The amount of memory reserved for shadow/nested page tables." },
@@ -273,6 +343,11 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
     /*
      * Setup any fixed pointers and offsets.
      */
+    RTListInit(&pUVM->stam.s.List);
+    pUVM->stam.s.SampleTree = NULL;
+    pUVM->stam.s.pRoot = (PSTAMLOOKUP)RTMemAllocZ(sizeof(STAMLOOKUP));
+    AssertReturn(pUVM->stam.s.pRoot, VERR_NO_MEMORY);
+
     int rc = RTSemRWCreate(&pUVM->stam.s.RWSem);
     AssertRCReturn(rc, rc);
 
@@ -308,14 +383,16 @@ VMMR3DECL(void) STAMR3TermUVM(PUVM pUVM)
     /*
      * Free used memory and the RWLock.
      */
-    PSTAMDESC pCur = pUVM->stam.s.pHead;
-    while (pCur)
+    PSTAMDESC pCur, pNext;
+    RTListForEachSafe(&pUVM->stam.s.List, pCur, pNext, STAMDESC, ListEntry)
+        RTMemFree(pCur);
+    RTListInit(&pUVM->stam.s.List);
+    pUVM->stam.s.SampleTree = NULL;
+    if (pUVM->stam.s.pRoot)
     {
-        void *pvFree = pCur;
-        pCur = pCur->pNext;
-        RTMemFree(pvFree);
+        stamR3LookupDestroyTree(pUVM->stam.s.pRoot);
+        pUVM->stam.s.pRoot = NULL;
     }
-    pUVM->stam.s.pHead = NULL;
 
     Assert(pUVM->stam.s.RWSem != NIL_RTSEMRW);
     RTSemRWDestroy(pUVM->stam.s.RWSem);
@@ -540,41 +617,268 @@ VMMR3DECL(int)  STAMR3RegisterCallbackV(PVM pVM, void *pvSample, STAMVISIBILITY
 }
 
 
-#ifdef VBOX_STRICT
 /**
- * Divide the strings into sub-strings using '/' as delimiter
- * and then compare them in strcmp fashion.
+ * Compares a name component with the one of a lookup tree node in strcmp
+ * fashion.
  *
  * @returns Difference.
- * @retval  0 if equal.
- * @retval  < 0 if psz1 is less than psz2.
- * @retval  > 0 if psz1 greater than psz2.
+ * @param   pLookup     The lookup tree node.
+ * @param   pchName     The name component (not terminated).
+ * @param   cchName     The length of the name component.
+ */
+static int stamR3LookupCompare(PSTAMLOOKUP pLookup, const char *pchName, size_t cchName)
+{
+    size_t const cchNode = pLookup->cchPath - pLookup->offName;
+    int iDiff = memcmp(&pLookup->szPath[pLookup->offName], pchName, RT_MIN(cchNode, cchName));
+    if (!iDiff && cchNode != cchName)
+        iDiff = cchNode < cchName ? -1 : 1;
+    return iDiff;
+}
+
+
+/**
+ * Looks up a child of a lookup tree node.
+ *
+ * @returns Pointer to the child if found, NULL if not.
+ * @param   pParent     The parent node.
+ * @param   pchName     The name component of the child (not terminated).
+ * @param   cchName     The length of the name component.
+ * @param   piChild     Where to return the index of the child, or where it
+ *                      should be inserted if not found.  Optional.
+ */
+static PSTAMLOOKUP stamR3LookupFindChild(PSTAMLOOKUP pParent, const char *pchName, size_t cchName, uint32_t *piChild)
+{
+    uint32_t iStart = 0;
+    uint32_t iEnd   = pParent->cChildren;
+    while (iStart < iEnd)
+    {
+        uint32_t const i = iStart + (iEnd - iStart) / 2;
+        int iDiff = stamR3LookupCompare(pParent->papChildren[i], pchName, cchName);
+        if (!iDiff)
+        {
+            if (piChild)
+                *piChild = i;
+            return pParent->papChildren[i];
+        }
+        if (iDiff < 0)
+            iStart = i + 1;
+        else
+            iEnd = i;
+    }
+    if (piChild)
+        *piChild = iStart;
+    return NULL;
+}
+
+
+/**
+ * Creates a child of a lookup tree node.
+ *
+ * This is O(fan-out) as the siblings following the new child are moved up one
+ * entry and get their iParent updated.
+ *
+ * @returns Pointer to the new child, NULL if out of memory.
+ * @param   pParent     The parent node.
+ * @param   pchName     The name component of the child (not terminated).
+ * @param   cchName     The length of the name component.
+ * @param   iChild      The index to insert the child at, as returned by
+ *                      stamR3LookupFindChild.
+ */
+static PSTAMLOOKUP stamR3LookupInsertChild(PSTAMLOOKUP pParent, const char *pchName, size_t cchName, uint32_t iChild)
+{
+    size_t const cchPath = pParent->cchPath + 1 + cchName;
+    AssertReturn(cchPath < UINT16_MAX, NULL);
+
+    if (pParent->cChildren >= pParent->cChildrenAlloc)
+    {
+        uint32_t const cNew = pParent->cChildrenAlloc ? pParent->cChildrenAlloc * 2 : 4;
+        void *pvNew = RTMemRealloc(pParent->papChildren, cNew * sizeof(pParent->papChildren[0]));
+        if (!pvNew)
+            return NULL;
+        pParent->papChildren    = (PSTAMLOOKUP *)pvNew;
+        pParent->cChildrenAlloc = cNew;
+    }
+
+    PSTAMLOOKUP pNew = (PSTAMLOOKUP)RTMemAlloc(RT_UOFFSETOF(STAMLOOKUP, szPath) + cchPath + 1);
+    if (!pNew)
+        return NULL;
+    pNew->pParent        = pParent;
+    pNew->papChildren    = NULL;
+    pNew->pDesc          = NULL;
+    pNew->cDescsInTree   = 0;
+    pNew->cChildren      = 0;
+    pNew->cChildrenAlloc = 0;
+    pNew->iParent        = iChild;
+    pNew->offName        = (uint16_t)(pParent->cchPath + 1);
+    pNew->cchPath        = (uint16_t)cchPath;
+    memcpy(pNew->szPath, pParent->szPath, pParent->cchPath);
+    pNew->szPath[pParent->cchPath] = '/';
+    memcpy(&pNew->szPath[pNew->offName], pchName, cchName);
+    pNew->szPath[cchPath] = '\0';
+
+    memmove(&pParent->papChildren[iChild + 1], &pParent->papChildren[iChild],
+            (pParent->cChildren - iChild) * sizeof(pParent->papChildren[0]));
+    pParent->papChildren[iChild] = pNew;
+    pParent->cChildren++;
+    for (uint32_t i = iChild + 1; i < pParent->cChildren; i++)
+        pParent->papChildren[i]->iParent = i;
+    return pNew;
+}
+
+
+/**
+ * Looks up the lookup tree node for a sample name, creating it and any
+ * missing parents.
  *
- * @param   psz1        The first string.
- * @param   psz2        The second string.
+ * @returns Pointer to the node, NULL if out of memory.
+ * @param   pRoot       The root of the lookup tree.
+ * @param   pszName     The sample name, starting with a slash.
  */
-static int stamR3SlashCompare(const char *psz1, const char *psz2)
+static PSTAMLOOKUP stamR3LookupFindOrCreate(PSTAMLOOKUP pRoot, const char *pszName)
 {
+    Assert(*pszName == '/');
+    PSTAMLOOKUP pCur   = pRoot;
+    const char *pszCur = pszName + 1;
     for (;;)
     {
-        unsigned int ch1 = *psz1++;
-        unsigned int ch2 = *psz2++;
-        if (ch1 != ch2)
+        const char  *pszEnd = strchr(pszCur, '/');
+        size_t const cch    = pszEnd ? (size_t)(pszEnd - pszCur) : strlen(pszCur);
+        uint32_t     iChild;
+        PSTAMLOOKUP  pChild = stamR3LookupFindChild(pCur, pszCur, cch, &iChild);
+        if (!pChild)
         {
-            /* slash is end-of-sub-string, so it trumps everything but '\0'. */
-            if (ch1 == '/')
-                return ch2 ? -1 : 1;
-            if (ch2 == '/')
-                return ch1 ? 1 : -1;
-            return ch1 - ch2;
+            pChild = stamR3LookupInsertChild(pCur, pszCur, cch, iChild);
+            if (!pChild)
+            {
+                stamR3LookupPrune(pCur);
+                return NULL;
+            }
         }
+        pCur = pChild;
+        if (!pszEnd)
+            return pCur;
+        pszCur = pszEnd + 1;
+    }
+}
 
-        /* done? */
-        if (ch1 == '\0')
-            return 0;
+
+/**
+ * Gets the first sample in a lookup subtree.
+ *
+ * @returns Pointer to the sample, NULL if the subtree has none.
+ * @param   pLookup     The root of the subtree.
+ */
+static PSTAMDESC stamR3LookupFindFirstDesc(PSTAMLOOKUP pLookup)
+{
+    while (!pLookup->pDesc)
+    {
+        PSTAMLOOKUP pNext = NULL;
+        for (uint32_t i = 0; i < pLookup->cChildren && !pNext; i++)
+            if (pLookup->papChildren[i]->cDescsInTree)
+                pNext = pLookup->papChildren[i];
+        if (!pNext)
+            return NULL;
+        pLookup = pNext;
     }
+    return pLookup->pDesc;
+}
+
+
+/**
+ * Gets the sample following a lookup tree node in the sample list, ignoring
+ * the one of the node itself.
+ *
+ * This scans the children and the following siblings of the node and its
+ * parents, so it's O(depth * fan-out) in the worst case.
+ *
+ * @returns Pointer to the sample, NULL if it would be the last one.
+ * @param   pLookup     The lookup tree node.
+ */
+static PSTAMDESC stamR3LookupFindNextDesc(PSTAMLOOKUP pLookup)
+{
+    for (uint32_t i = 0; i < pLookup->cChildren; i++)
+        if (pLookup->papChildren[i]->cDescsInTree)
+            return stamR3LookupFindFirstDesc(pLookup->papChildren[i]);
+
+    for (; pLookup->pParent; pLookup = pLookup->pParent)
+    {
+        PSTAMLOOKUP pParent = pLookup->pParent;
+        for (uint32_t i = pLookup->iParent + 1; i < pParent->cChildren; i++)
+            if (pParent->papChildren[i]->cDescsInTree)
+                return stamR3LookupFindFirstDesc(pParent->papChildren[i]);
+    }
+    return NULL;
+}
+
+
+/**
+ * Frees a lookup tree node and its parents if they no longer serve any
+ * purpose.
+ *
+ * Like stamR3LookupInsertChild this is O(fan-out) per freed node, the siblings
+ * following it are moved down and renumbered.
+ *
+ * @param   pLookup     The lookup tree node.
+ */
+static void stamR3LookupPrune(PSTAMLOOKUP pLookup)
+{
+    while (    pLookup->pParent
+           &&  !pLookup->pDesc
+           &&  !pLookup->cChildren)
+    {
+        PSTAMLOOKUP    pParent = pLookup->pParent;
+        uint32_t const iChild  = pLookup->iParent;
+        Assert(pParent->papChildren[iChild] == pLookup);
+        pParent->cChildren--;
+        memmove(&pParent->papChildren[iChild], &pParent->papChildren[iChild + 1],
+                (pParent->cChildren - iChild) * sizeof(pParent->papChildren[0]));
+        for (uint32_t i = iChild; i < pParent->cChildren; i++)
+            pParent->papChildren[i]->iParent = i;
+
+        RTMemFree(pLookup->papChildren);
+        RTMemFree(pLookup);
+        pLookup = pParent;
+    }
+}
+
+
+/**
+ * Frees a lookup subtree.
+ *
+ * @param   pLookup     The root of the subtree.
+ */
+static void stamR3LookupDestroyTree(PSTAMLOOKUP pLookup)
+{
+    for (uint32_t i = 0; i < pLookup->cChildren; i++)
+        stamR3LookupDestroyTree(pLookup->papChildren[i]);
+    RTMemFree(pLookup->papChildren);
+    RTMemFree(pLookup);
+}
+
+
+/**
+ * Unlinks a sample from the list and the lookup tree and frees it.
+ *
+ * The caller takes care of the sample address tree.
+ *
+ * @param   pDesc       The sample.
+ */
+static void stamR3DestroyDesc(PSTAMDESC pDesc)
+{
+    RTListNodeRemove(&pDesc->ListEntry);
+
+    PSTAMLOOKUP pLookup = pDesc->pLookup;
+    Assert(pLookup->pDesc == pDesc);
+    pLookup->pDesc = NULL;
+    for (PSTAMLOOKUP pCur = pLookup; pCur; pCur = pCur->pParent)
+    {
+        Assert(pCur->cDescsInTree > 0);
+        pCur->cDescsInTree--;
+    }
+    stamR3LookupPrune(pLookup);
+
+    RTMemFree(pDesc);
 }
-#endif /* VBOX_STRICT */
 
 
 /**
@@ -596,42 +900,40 @@ static int stamR3SlashCompare(const char *psz1, const char *psz2)
 static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfnReset, PFNSTAMR3CALLBACKPRINT pfnPrint,
                            STAMTYPE enmType, STAMVISIBILITY enmVisibility, const char *pszName, STAMUNIT enmUnit, const char *pszDesc)
 {
+    AssertMsgReturn(pszName[0] == '/', ("%s\n", pszName), VERR_INVALID_NAME);
     STAM_LOCK_WR(pUVM);
 
     /*
-     * Check if exists.
+     * Look up the name in the tree and check if exists.
      */
-    PSTAMDESC   pPrev = NULL;
-    PSTAMDESC   pCur = pUVM->stam.s.pHead;
-    while (pCur)
+    PSTAMLOOKUP pLookup = stamR3LookupFindOrCreate(pUVM->stam.s.pRoot, pszName);
+    if (!pLookup)
     {
-        int iDiff = strcmp(pCur->pszName, pszName);
-        /* passed it */
-        if (iDiff > 0)
-            break;
-        /* found it. */
-        if (!iDiff)
-        {
-            STAM_UNLOCK_WR(pUVM);
-            AssertMsgFailed(("Duplicate sample name: %s\n", pszName));
-            return VERR_ALREADY_EXISTS;
-        }
-
-        /* next */
-        pPrev = pCur;
-        pCur = pCur->pNext;
+        STAM_UNLOCK_WR(pUVM);
+        return VERR_NO_MEMORY;
+    }
+    if (pLookup->pDesc)
+    {
+        STAM_UNLOCK_WR(pUVM);
+        AssertMsgFailed(("Duplicate sample name: %s\n", pszName));
+        return VERR_ALREADY_EXISTS;
     }
+    PSTAMDESC pCur = stamR3LookupFindNextDesc(pLookup);
 
     /*
-     * Check that the name doesn't screw up sorting order when taking
-     * slashes into account. The QT4 GUI makes some assumptions.
+     * The list is sorted by name taking slashes into account.  Check that
+     * this matches the plain strcmp order, the QT4 GUI makes some assumptions.
      * Problematic chars are: !"#$%&'()*+,-.
      */
-    Assert(pszName[0] == '/');
+#ifdef VBOX_STRICT
+    PSTAMDESC pPrev = pCur
+                    ? RTListGetPrev(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
+                    : RTListGetLast(&pUVM->stam.s.List, STAMDESC, ListEntry);
     if (pPrev)
-        Assert(stamR3SlashCompare(pPrev->pszName, pszName) < 0);
+        Assert(strcmp(pPrev->pszName, pszName) < 0);
     if (pCur)
-        Assert(stamR3SlashCompare(pCur->pszName, pszName) > 0);
+        Assert(strcmp(pCur->pszName, pszName) > 0);
+#endif
 
 #ifdef VBOX_STRICT
     /*
@@ -709,17 +1011,39 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
         if (pszDesc)
             pNew->pszDesc   = (char *)memcpy((char *)(pNew + 1) + cchName,  pszDesc,  cchDesc);
 
-        pNew->pNext         = pCur;
-        if (pPrev)
-            pPrev->pNext    = pNew;
+        if (pCur)
+            RTListNodeInsertBefore(&pCur->ListEntry, &pNew->ListEntry);
+        else
+            RTListAppend(&pUVM->stam.s.List, &pNew->ListEntry);
+
+        pNew->pLookup = pLookup;
+        pLookup->pDesc = pNew;
+        for (PSTAMLOOKUP pParent = pLookup; pParent; pParent = pParent->pParent)
+            pParent->cDescsInTree++;
+
+        pNew->SampleCore.Key = pvSample;
+        pNew->pNextSameSample = NULL;
+        PAVLPVNODECORE pSameCore = RTAvlPVGet(&pUVM->stam.s.SampleTree, pvSample);
+        if (pSameCore)
+        {
+            PSTAMDESC pSame = RT_FROM_MEMBER(pSameCore, STAMDESC, SampleCore);
+            pNew->pNextSameSample  = pSame->pNextSameSample;
+            pSame->pNextSameSample = pNew;
+        }
         else
-            pUVM->stam.s.pHead = pNew;
+            RTAvlPVInsert(&pUVM->stam.s.SampleTree, &pNew->SampleCore);
+
+        pNew->idSample = pUVM->stam.s.idNextSample++;
+        pUVM->stam.s.uGeneration++;
 
         stamR3ResetOne(pNew, pUVM->pVM);
         rc = VINF_SUCCESS;
     }
     else
+    {
+        stamR3LookupPrune(pLookup);
         rc = VERR_NO_MEMORY;
+    }
 
     STAM_UNLOCK_WR(pUVM);
     return rc;
@@ -741,30 +1065,22 @@ VMMR3DECL(int)  STAMR3DeregisterU(PUVM pUVM, void *pvSample)
     STAM_LOCK_WR(pUVM);
 
     /*
-     * Search for it.
+     * Look it up and free all samples using this address.
      */
-    int         rc = VERR_INVALID_HANDLE;
-    PSTAMDESC   pPrev = NULL;
-    PSTAMDESC   pCur = pUVM->stam.s.pHead;
-    while (pCur)
+    int            rc    = VERR_INVALID_HANDLE;
+    PAVLPVNODECORE pCore = RTAvlPVRemove(&pUVM->stam.s.SampleTree, pvSample);
+    if (pCore)
     {
-        if (pCur->u.pv == pvSample)
+        PSTAMDESC pCur = RT_FROM_MEMBER(pCore, STAMDESC, SampleCore);
+        while (pCur)
         {
-            void *pvFree = pCur;
-            pCur = pCur->pNext;
-            if (pPrev)
-                pPrev->pNext = pCur;
-            else
-                pUVM->stam.s.pHead = pCur;
-
-            RTMemFree(pvFree);
-            rc = VINF_SUCCESS;
-            continue;
+            PSTAMDESC pNext = pCur->pNextSameSample;
+            Assert(pCur->u.pv == pvSample);
+            stamR3DestroyDesc(pCur);
+            pCur = pNext;
         }
-
-        /* next */
-        pPrev = pCur;
-        pCur = pCur->pNext;
+        pUVM->stam.s.uGeneration++;
+        rc = VINF_SUCCESS;
     }
 
     STAM_UNLOCK_WR(pUVM);
@@ -1309,6 +1625,353 @@ VMMR3DECL(int)  STAMR3SnapshotFree(PVM pVM, char *pszSnapshot)
 }
 
 
+/**
+ * Gets the number of values a sample contributes to a binary snapshot.
+ *
+ * @returns Value count.
+ * @param   enmType     The sample type.
+ */
+static uint32_t stamR3BinSnapshotValueCount(STAMTYPE enmType)
+{
+    switch (enmType)
+    {
+        case STAMTYPE_PROFILE:
+        case STAMTYPE_PROFILE_ADV:
+            return 4;
+        case STAMTYPE_RATIO_U32:
+        case STAMTYPE_RATIO_U32_RESET:
+            return 2;
+        case STAMTYPE_CALLBACK:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+
+/**
+ * stamR3EnumU callback employed by STAMR3BinSnapshotCreateU.
+ *
+ * Unlike the XML snapshot, samples with STAMVISIBILITY_USED are included
+ * regardless of their current value so the layout stays the same until
+ * samples are registered or deregistered.  Callback samples have no raw
+ * value and are left out.
+ *
+ * @returns VBox status code.
+ * @param   pDesc       The sample.
+ * @param   pvArg       The snapshot being prepared.
+ */
+static int stamR3BinSnapshotOne(PSTAMDESC pDesc, void *pvArg)
+{
+    PSTAMBINSNAPSHOT pSnap = (PSTAMBINSNAPSHOT)pvArg;
+
+    /* We're called with the lock held, so this is the generation matching
+       the descriptors we collect. */
+    pSnap->uGeneration = pSnap->pUVM->stam.s.uGeneration;
+
+    if (pDesc->enmType == STAMTYPE_CALLBACK)
+        return VINF_SUCCESS;
+    if (pSnap->cDescs >= pSnap->cDescsAlloc)
+    {
+        uint32_t  cNew  = pSnap->cDescsAlloc ? pSnap->cDescsAlloc * 2 : 256;
+        void     *pvNew = RTMemRealloc(pSnap->papDescs, cNew * sizeof(pSnap->papDescs[0]));
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pSnap->papDescs    = (PSTAMDESC *)pvNew;
+        pSnap->cDescsAlloc = cNew;
+    }
+    pSnap->papDescs[pSnap->cDescs++] = pDesc;
+    pSnap->cValues += stamR3BinSnapshotValueCount(pDesc->enmType);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Prepares a binary statistics snapshot.
+ *
+ * This does the expensive part of a snapshot once, that is the pattern
+ * matching and the name and description strings, so that the values of the
+ * selected samples can be scraped frequently and cheaply using
+ * STAMR3BinSnapshotQueryValuesU().  The layout of the values is retrieved
+ * using STAMR3BinSnapshotEnumLayoutU().
+ *
+ * The snapshot becomes stale when samples are registered or deregistered,
+ * which STAMR3BinSnapshotQueryValuesU() reports so the caller can prepare a
+ * new one.
+ *
+ * @returns VBox status code.
+ * @param   pUVM            Pointer to the user mode VM structure.
+ * @param   pszPat          The name matching pattern. See somewhere_where_this_is_described_in_detail.
+ *                          If NULL all samples are included.
+ * @param   phSnapshot      Where to return the snapshot handle.  Free it
+ *                          using STAMR3BinSnapshotDestroy().
+ */
+VMMR3DECL(int) STAMR3BinSnapshotCreateU(PUVM pUVM, const char *pszPat, PSTAMBINSNAPSHOT *phSnapshot)
+{
+    AssertPtrReturn(phSnapshot, VERR_INVALID_POINTER);
+    *phSnapshot = NULL;
+
+    PSTAMBINSNAPSHOT pSnap = (PSTAMBINSNAPSHOT)RTMemAllocZ(sizeof(*pSnap));
+    if (!pSnap)
+        return VERR_NO_MEMORY;
+    pSnap->u32Magic = STAMBINSNAPSHOT_MAGIC;
+    pSnap->pUVM     = pUVM;
+    pSnap->pszPat   = RTStrDup(pszPat && *pszPat ? pszPat : "*");
+    if (!pSnap->pszPat)
+    {
+        RTMemFree(pSnap);
+        return VERR_NO_MEMORY;
+    }
+
+    /* In case nothing matches. */
+    STAM_LOCK_RD(pUVM);
+    pSnap->uGeneration = pUVM->stam.s.uGeneration;
+    STAM_UNLOCK_RD(pUVM);
+
+    int rc = stamR3EnumU(pUVM, pSnap->pszPat, true /* fUpdateRing0 */, stamR3BinSnapshotOne, pSnap);
+    if (RT_SUCCESS(rc))
+    {
+        *phSnapshot = pSnap;
+        return VINF_SUCCESS;
+    }
+    STAMR3BinSnapshotDestroy(pSnap);
+    return rc;
+}
+
+
+/**
+ * Prepares a binary statistics snapshot.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   pszPat          The name matching pattern. See somewhere_where_this_is_described_in_detail.
+ *                          If NULL all samples are included.
+ * @param   phSnapshot      Where to return the snapshot handle.
+ */
+VMMR3DECL(int) STAMR3BinSnapshotCreate(PVM pVM, const char *pszPat, PSTAMBINSNAPSHOT *phSnapshot)
+{
+    return STAMR3BinSnapshotCreateU(pVM->pUVM, pszPat, phSnapshot);
+}
+
+
+/**
+ * Frees a binary statistics snapshot.
+ *
+ * This does not touch the VM, so it can be called after it has been
+ * destroyed.
+ *
+ * @param   hSnapshot       The snapshot handle.  NULL is ignored.
+ */
+VMMR3DECL(void) STAMR3BinSnapshotDestroy(PSTAMBINSNAPSHOT hSnapshot)
+{
+    if (!hSnapshot)
+        return;
+    AssertReturnVoid(hSnapshot->u32Magic == STAMBINSNAPSHOT_MAGIC);
+    hSnapshot->u32Magic = ~STAMBINSNAPSHOT_MAGIC;
+    RTMemFree(hSnapshot->papDescs);
+    RTStrFree(hSnapshot->pszPat);
+    RTMemFree(hSnapshot);
+}
+
+
+/**
+ * Gets the number of values in a binary statistics snapshot.
+ *
+ * @returns The value count, 0 on invalid handle.
+ * @param   hSnapshot       The snapshot handle.
+ */
+VMMR3DECL(uint32_t) STAMR3BinSnapshotGetValueCount(PSTAMBINSNAPSHOT hSnapshot)
+{
+    AssertPtrReturn(hSnapshot, 0);
+    AssertReturn(hSnapshot->u32Magic == STAMBINSNAPSHOT_MAGIC, 0);
+    return hSnapshot->cValues;
+}
+
+
+/**
+ * Enumerates the samples in a binary statistics snapshot, telling where
+ * their values are found.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_STAM_SNAPSHOT_STALE if samples have been registered or
+ *          deregistered since the snapshot was prepared.
+ *
+ * @param   pUVM            Pointer to the user mode VM structure.
+ * @param   hSnapshot       The snapshot handle.
+ * @param   pfnLayout       The callback.  Called with the STAM lock held, so
+ *                          it must not register or deregister samples.
+ * @param   pvUser          User argument to the callback.
+ */
+VMMR3DECL(int) STAMR3BinSnapshotEnumLayoutU(PUVM pUVM, PSTAMBINSNAPSHOT hSnapshot, PFNSTAMR3BINLAYOUT pfnLayout, void *pvUser)
+{
+    AssertPtrReturn(hSnapshot, VERR_INVALID_HANDLE);
+    AssertReturn(hSnapshot->u32Magic == STAMBINSNAPSHOT_MAGIC, VERR_INVALID_HANDLE);
+    AssertReturn(hSnapshot->pUVM == pUVM, VERR_INVALID_HANDLE);
+    AssertPtrReturn(pfnLayout, VERR_INVALID_POINTER);
+
+    int rc = VINF_SUCCESS;
+    STAM_LOCK_RD(pUVM);
+    if (hSnapshot->uGeneration == pUVM->stam.s.uGeneration)
+    {
+        uint32_t iValue = 0;
+        for (uint32_t i = 0; i < hSnapshot->cDescs; i++)
+        {
+            PSTAMDESC pDesc   = hSnapshot->papDescs[i];
+            uint32_t  cValues = stamR3BinSnapshotValueCount(pDesc->enmType);
+            rc = pfnLayout(pDesc->idSample, pDesc->pszName, pDesc->enmType, pDesc->enmUnit, pDesc->pszDesc,
+                           iValue, cValues, pvUser);
+            if (rc)
+                break;
+            iValue += cValues;
+        }
+    }
+    else
+        rc = VERR_STAM_SNAPSHOT_STALE;
+    STAM_UNLOCK_RD(pUVM);
+    return rc;
+}
+
+
+/**
+ * Enumerates the samples in a binary statistics snapshot.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   hSnapshot       The snapshot handle.
+ * @param   pfnLayout       The callback.
+ * @param   pvUser          User argument to the callback.
+ */
+VMMR3DECL(int) STAMR3BinSnapshotEnumLayout(PVM pVM, PSTAMBINSNAPSHOT hSnapshot, PFNSTAMR3BINLAYOUT pfnLayout, void *pvUser)
+{
+    return STAMR3BinSnapshotEnumLayoutU(pVM->pUVM, hSnapshot, pfnLayout, pvUser);
+}
+
+
+/**
+ * Copies the current values of the samples in a binary statistics snapshot
+ * into the caller's buffer.
+ *
+ * The values are not formatted or converted in any way other than being
+ * zero extended to 64 bits, and they are laid out as described by
+ * STAMR3BinSnapshotEnumLayoutU().
+ *
+ * @returns VBox status code.
+ * @retval  VERR_STAM_SNAPSHOT_STALE if samples have been registered or
+ *          deregistered since the snapshot was prepared.
+ * @retval  VERR_BUFFER_OVERFLOW if @a cValues is too small.
+ *
+ * @param   pUVM            Pointer to the user mode VM structure.
+ * @param   hSnapshot       The snapshot handle.
+ * @param   pau64Values     Where to store the values.
+ * @param   cValues         The size of the buffer, in values.  Must be at
+ *                          least STAMR3BinSnapshotGetValueCount().
+ */
+VMMR3DECL(int) STAMR3BinSnapshotQueryValuesU(PUVM pUVM, PSTAMBINSNAPSHOT hSnapshot, uint64_t *pau64Values, uint32_t cValues)
+{
+    AssertPtrReturn(hSnapshot, VERR_INVALID_HANDLE);
+    AssertReturn(hSnapshot->u32Magic == STAMBINSNAPSHOT_MAGIC, VERR_INVALID_HANDLE);
+    AssertReturn(hSnapshot->pUVM == pUVM, VERR_INVALID_HANDLE);
+    if (cValues < hSnapshot->cValues)
+        return VERR_BUFFER_OVERFLOW;
+    AssertPtrReturn(pau64Values, VERR_INVALID_POINTER);
+
+    stamR3Ring0StatsUpdateU(pUVM, hSnapshot->pszPat);
+
+    int rc = VINF_SUCCESS;
+    STAM_LOCK_RD(pUVM);
+    if (hSnapshot->uGeneration == pUVM->stam.s.uGeneration)
+    {
+        uint64_t        *pu64Dst  = pau64Values;
+        PSTAMDESC const *ppDesc   = hSnapshot->papDescs;
+        for (uint32_t cLeft = hSnapshot->cDescs; cLeft > 0; cLeft--, ppDesc++)
+        {
+            PSTAMDESC pDesc = *ppDesc;
+            switch (pDesc->enmType)
+            {
+                case STAMTYPE_COUNTER:
+                    *pu64Dst++ = pDesc->u.pCounter->c;
+                    break;
+
+                case STAMTYPE_PROFILE:
+                case STAMTYPE_PROFILE_ADV:
+                    pu64Dst[0] = pDesc->u.pProfile->cPeriods;
+                    pu64Dst[1] = pDesc->u.pProfile->cTicks;
+                    pu64Dst[2] = pDesc->u.pProfile->cTicksMax;
+                    pu64Dst[3] = pDesc->u.pProfile->cTicksMin;
+                    pu64Dst += 4;
+                    break;
+
+                case STAMTYPE_RATIO_U32:
+                case STAMTYPE_RATIO_U32_RESET:
+                    pu64Dst[0] = pDesc->u.pRatioU32->u32A;
+                    pu64Dst[1] = pDesc->u.pRatioU32->u32B;
+                    pu64Dst += 2;
+                    break;
+
+                case STAMTYPE_U8:
+                case STAMTYPE_U8_RESET:
+                case STAMTYPE_X8:
+                case STAMTYPE_X8_RESET:
+                    *pu64Dst++ = *pDesc->u.pu8;
+                    break;
+
+                case STAMTYPE_U16:
+                case STAMTYPE_U16_RESET:
+                case STAMTYPE_X16:
+                case STAMTYPE_X16_RESET:
+                    *pu64Dst++ = *pDesc->u.pu16;
+                    break;
+
+                case STAMTYPE_U32:
+                case STAMTYPE_U32_RESET:
+                case STAMTYPE_X32:
+                case STAMTYPE_X32_RESET:
+                    *pu64Dst++ = *pDesc->u.pu32;
+                    break;
+
+                case STAMTYPE_U64:
+                case STAMTYPE_U64_RESET:
+                case STAMTYPE_X64:
+                case STAMTYPE_X64_RESET:
+                    *pu64Dst++ = *pDesc->u.pu64;
+                    break;
+
+                case STAMTYPE_BOOL:
+                case STAMTYPE_BOOL_RESET:
+                    *pu64Dst++ = *pDesc->u.pf;
+                    break;
+
+                default:
+                    AssertMsgFailed(("enmType=%d\n", pDesc->enmType));
+                    *pu64Dst++ = 0;
+                    break;
+            }
+        }
+        Assert((uint32_t)(pu64Dst - pau64Values) == hSnapshot->cValues);
+    }
+    else
+        rc = VERR_STAM_SNAPSHOT_STALE;
+    STAM_UNLOCK_RD(pUVM);
+    return rc;
+}
+
+
+/**
+ * Copies the current values of the samples in a binary statistics snapshot
+ * into the caller's buffer.
+ *
+ * @returns VBox status code.
+ * @param   pVM             Pointer to the VM.
+ * @param   hSnapshot       The snapshot handle.
+ * @param   pau64Values     Where to store the values.
+ * @param   cValues         The size of the buffer, in values.
+ */
+VMMR3DECL(int) STAMR3BinSnapshotQueryValues(PVM pVM, PSTAMBINSNAPSHOT hSnapshot, uint64_t *pau64Values, uint32_t cValues)
+{
+    return STAMR3BinSnapshotQueryValuesU(pVM->pUVM, hSnapshot, pau64Values, cValues);
+}
+
+
 /**
  * Dumps the selected statistics to the log.
  *
@@ -1725,6 +2388,116 @@ static char **stamR3SplitPattern(const char *pszPat, unsigned *pcExpressions, ch
 }
 
 
+/**
+ * Prepares a pattern expression for walking the lookup tree.
+ *
+ * @param   pUVM        Pointer to the user mode VM structure.
+ * @param   pExpr       The expression structure to initialize.
+ * @param   pszPat      The pattern expression.
+ */
+static void stamR3EnumExprInit(PUVM pUVM, PSTAMR3ENUMEXPR pExpr, const char *pszPat)
+{
+    pExpr->pszPat     = pszPat;
+    pExpr->cchPrefix  = strcspn(pszPat, "*?");
+    pExpr->fWildcards = pszPat[pExpr->cchPrefix] != '\0';
+    pExpr->pStart     = NULL;
+    if (pszPat[0] != '/')
+    {
+        /* All names start with a slash. */
+        if (!pExpr->cchPrefix)
+            pExpr->pStart = pUVM->stam.s.pRoot;
+        return;
+    }
+
+    /*
+     * Descend as far as the prefix holds complete name components.
+     */
+    PSTAMLOOKUP pCur = pUVM->stam.s.pRoot;
+    size_t      off  = 1;
+    for (;;)
+    {
+        const char *pszEnd = (const char *)memchr(&pszPat[off], '/', pExpr->cchPrefix - off);
+        size_t      cch;
+        if (pszEnd)
+            cch = pszEnd - &pszPat[off];
+        else if (!pExpr->fWildcards)
+            cch = pExpr->cchPrefix - off;
+        else
+            break;
+
+        pCur = stamR3LookupFindChild(pCur, &pszPat[off], cch, NULL);
+        if (!pCur)
+            return;
+        if (!pszEnd)
+            break;
+        off += cch + 1;
+    }
+    pExpr->pStart = pCur;
+}
+
+
+/**
+ * Checks if an expression can match any of the names in a lookup subtree.
+ *
+ * @returns true if it may, false if it cannot.
+ * @param   pExpr       The expression.
+ * @param   pLookup     The root of the subtree.
+ */
+DECLINLINE(bool) stamR3EnumExprIsCompatible(PCSTAMR3ENUMEXPR pExpr, PSTAMLOOKUP pLookup)
+{
+    if (!pExpr->pStart)
+        return false;
+    if (pExpr->cchPrefix <= pLookup->cchPath)
+        return (pExpr->fWildcards || pExpr->cchPrefix == pLookup->cchPath)
+            && !memcmp(pExpr->pszPat, pLookup->szPath, pExpr->cchPrefix);
+    return pExpr->pszPat[pLookup->cchPath] == '/'
+        && !memcmp(pExpr->pszPat, pLookup->szPath, pLookup->cchPath);
+}
+
+
+/**
+ * Walks a lookup subtree calling the callback for the samples matching any
+ * of the expressions, skipping the subtrees none of them can match.
+ *
+ * @returns The rc from the callback.
+ * @param   pLookup         The root of the subtree.
+ * @param   paExprs         The expressions.
+ * @param   cExprs          The number of expressions.
+ * @param   pfnCallback     Callback function which shall be called for matching nodes.
+ * @param   pvArg           User parameter for the callback.
+ */
+static int stamR3EnumTree(PSTAMLOOKUP pLookup, PCSTAMR3ENUMEXPR paExprs, unsigned cExprs,
+                          int (*pfnCallback)(PSTAMDESC pDesc, void *pvArg), void *pvArg)
+{
+    bool fCompatible = false;
+    bool fMatch      = false;
+    for (unsigned i = 0; i < cExprs && !fMatch; i++)
+        if (stamR3EnumExprIsCompatible(&paExprs[i], pLookup))
+        {
+            fCompatible = true;
+            fMatch = pLookup->pDesc
+                  && RTStrSimplePatternMatch(paExprs[i].pszPat, pLookup->pDesc->pszName);
+        }
+    if (!fCompatible)
+        return VINF_SUCCESS;
+
+    if (fMatch)
+    {
+        int rc = pfnCallback(pLookup->pDesc, pvArg);
+        if (rc)
+            return rc;
+    }
+
+    for (uint32_t i = 0; i < pLookup->cChildren; i++)
+    {
+        int rc = stamR3EnumTree(pLookup->papChildren[i], paExprs, cExprs, pfnCallback, pvArg);
+        if (rc)
+            return rc;
+    }
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Enumerates the nodes selected by a pattern or all nodes if no pattern
  * is specified.
@@ -1755,15 +2528,12 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
             stamR3Ring0StatsUpdateU(pUVM, "*");
 
         STAM_LOCK_RD(pUVM);
-        PSTAMDESC pCur = pUVM->stam.s.pHead;
-        while (pCur)
+        PSTAMDESC pCur;
+        RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
         {
             rc = pfnCallback(pCur, pvArg);
             if (rc)
                 break;
-
-            /* next */
-            pCur = pCur->pNext;
         }
         STAM_UNLOCK_RD(pUVM);
     }
@@ -1777,16 +2547,10 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
             stamR3Ring0StatsUpdateU(pUVM, pszPat);
 
         STAM_LOCK_RD(pUVM);
-        /** @todo This needs to be optimized since the GUI is using this path for the VM info dialog.
-         * Note that it's doing exact matching. Organizing the samples in a tree would speed up thing
-         * no end (at least for debug and profile builds). */
-        for (PSTAMDESC pCur = pUVM->stam.s.pHead; pCur; pCur = pCur->pNext)
-            if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
-            {
-                rc = pfnCallback(pCur, pvArg);
-                if (rc)
-                    break;
-            }
+        STAMR3ENUMEXPR Expr;
+        stamR3EnumExprInit(pUVM, &Expr, pszPat);
+        if (Expr.pStart)
+            rc = stamR3EnumTree(Expr.pStart, &Expr, 1, pfnCallback, pvArg);
         STAM_UNLOCK_RD(pUVM);
     }
 
@@ -1803,24 +2567,47 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
         char **papszExpressions = stamR3SplitPattern(pszPat, &cExpressions, &pszCopy);
         if (!papszExpressions)
             return VERR_NO_MEMORY;
+        PSTAMR3ENUMEXPR paExprs = (PSTAMR3ENUMEXPR)RTMemTmpAlloc(cExpressions * sizeof(paExprs[0]));
+        if (!paExprs)
+        {
+            RTMemTmpFree(papszExpressions);
+            RTStrFree(pszCopy);
+            return VERR_NO_MEMORY;
+        }
 
         /*
-         * Perform the enumeration.
+         * Perform the enumeration, starting at the deepest node covering
+         * all the expressions.
          */
         if (fUpdateRing0)
             stamR3Ring0StatsUpdateMultiU(pUVM, papszExpressions, cExpressions);
 
         STAM_LOCK_RD(pUVM);
-        unsigned iExpression = 0;
-        for (PSTAMDESC pCur = pUVM->stam.s.pHead; pCur; pCur = pCur->pNext)
-            if (stamR3MultiMatch(papszExpressions, cExpressions, &iExpression, pCur->pszName))
+        PSTAMLOOKUP pStart = NULL;
+        for (unsigned i = 0; i < cExpressions; i++)
+        {
+            stamR3EnumExprInit(pUVM, &paExprs[i], papszExpressions[i]);
+            if (!paExprs[i].pStart)
+                continue;
+            if (!pStart)
+                pStart = paExprs[i].pStart;
+            else
             {
-                rc = pfnCallback(pCur, pvArg);
-                if (rc)
-                    break;
+                PSTAMLOOKUP pOther = paExprs[i].pStart;
+                while (pStart != pOther)
+                {
+                    if (pStart->cchPath >= pOther->cchPath)
+                        pStart = pStart->pParent;
+                    else
+                        pOther = pOther->pParent;
+                }
             }
+        }
+        if (pStart)
+            rc = stamR3EnumTree(pStart, paExprs, cExpressions, pfnCallback, pvArg);
         STAM_UNLOCK_RD(pUVM);
 
+        RTMemTmpFree(paExprs);
         RTMemTmpFree(papszExpressions);
         RTStrFree(pszCopy);
     }
@@ -1848,6 +2635,7 @@ static void stamR3Ring0StatsRegisterU(PUVM pUVM)
         stamR3RegisterU(pUVM, (uint8_t *)&pUVM->stam.s.GMMStats + g_aGMMStats[i].offVar, NULL, NULL,
                         g_aGMMStats[i].enmType, STAMVISIBILITY_ALWAYS, g_aGMMStats[i].pszName,
                         g_aGMMStats[i].enmUnit, g_aGMMStats[i].pszDesc);
+    pUVM->stam.s.cRegisteredNumaNodes = 0;
 }
 
 
@@ -1952,6 +2740,17 @@ static void stamR3Ring0StatsUpdateMultiU(PUVM pUVM, const char * const *papszExp
             fUpdate = true;
             break;
         }
+    for (uint32_t iNode = 0; !fUpdate && iNode < pUVM->stam.s.cRegisteredNumaNodes; iNode++)
+    {
+        char szName[64];
+        RTStrPrintf(szName, sizeof(szName), "/GMM/NumaNodes/%u/cChunks", iNode);
+        fUpdate = stamR3MultiMatch(papszExpressions, cExpressions, NULL, szName);
+        if (!fUpdate)
+        {
+            RTStrPrintf(szName, sizeof(szName), "/GMM/NumaNodes/%u/cFreePages", iNode);
+            fUpdate = stamR3MultiMatch(papszExpressions, cExpressions, NULL, szName);
+        }
+    }
     if (fUpdate)
     {
         GMMQUERYSTATISTICSSREQ Req;
@@ -1960,7 +2759,32 @@ static void stamR3Ring0StatsUpdateMultiU(PUVM pUVM, const char * const *papszExp
         Req.pSession     = pVM->pSession;
         int rc = SUPR3CallVMMR0Ex(pVM->pVMR0, NIL_VMCPUID, VMMR0_DO_GMM_QUERY_STATISTICS, 0, &Req.Hdr);
         if (RT_SUCCESS(rc))
+        {
             pUVM->stam.s.GMMStats = Req.Stats;
+
+            /*
+             * Register the NUMA node leaves the first time around.
+             */
+            if (RT_UNLIKELY(pUVM->stam.s.GMMStats.cNumaNodes > pUVM->stam.s.cRegisteredNumaNodes))
+            {
+                STAM_LOCK_WR(pUVM);
+                uint32_t const cNodes = RT_MIN(pUVM->stam.s.GMMStats.cNumaNodes, GMM_MAX_NUMA_NODES);
+                for (uint32_t iNode = pUVM->stam.s.cRegisteredNumaNodes; iNode < cNodes; iNode++)
+                {
+                    char   szName[120];
+                    size_t cchBase = RTStrPrintf(szName, sizeof(szName), "/GMM/NumaNodes/%u", iNode);
+                    strcpy(&szName[cchBase], "/cChunks");
+                    stamR3RegisterU(pUVM, &pUVM->stam.s.GMMStats.aNumaNodes[iNode].cChunks, NULL, NULL,
+                                    STAMTYPE_U32, STAMVISIBILITY_ALWAYS, szName, STAMUNIT_COUNT, "The number of chunks on the node.");
+                    strcpy(&szName[cchBase], "/cFreePages");
+                    stamR3RegisterU(pUVM, &pUVM->stam.s.GMMStats.aNumaNodes[iNode].cFreePages, NULL, NULL,
+                                    STAMTYPE_U64, STAMVISIBILITY_ALWAYS, szName, STAMUNIT_PAGES, "The number of free pages in the chunks on the node.");
+                }
+                if (cNodes > pUVM->stam.s.cRegisteredNumaNodes)
+                    pUVM->stam.s.cRegisteredNumaNodes = cNodes;
+                STAM_UNLOCK_WR(pUVM);
+            }
+        }
     }
 }
 
@@ -2019,7 +2843,7 @@ static DECLCALLBACK(int) stamR3CmdStats(PCDBGCCMD pCmd, PDBGCCMDHLP pCmdHlp, PVM
      */
     DBGC_CMDHLP_REQ_VM_RET(pCmdHlp, pCmd, pVM);
     PUVM pUVM = pVM->pUVM;
-    if (!pUVM->stam.s.pHead)
+    if (RTListIsEmpty(&pUVM->stam.s.List))
         return DBGCCmdHlpFail(pCmdHlp, pCmd, "No statistics present");
 
     /*
@@ -2070,7 +2894,7 @@ static DECLCALLBACK(int) stamR3CmdStatsReset(PCDBGCCMD pCmd, PDBGCCMDHLP pCmdHlp
      */
     DBGC_CMDHLP_REQ_VM_RET(pCmdHlp, pCmd, pVM);
     PUVM pUVM = pVM->pUVM;
-    if (!pUVM->stam.s.pHead)
+    if (RTListIsEmpty(&pUVM->stam.s.List))
         return DBGCCmdHlpFail(pCmdHlp, pCmd, "No statistics present");
 
     /*
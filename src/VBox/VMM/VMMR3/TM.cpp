@@ -168,6 +168,8 @@ static uint64_t             tmR3CalibrateTSC(PVM pVM);
 static DECLCALLBACK(int)    tmR3Save(PVM pVM, PSSMHANDLE pSSM);
 static DECLCALLBACK(int)    tmR3Load(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t uPass);
 static DECLCALLBACK(void)   tmR3TimerCallback(PRTTIMER pTimer, void *pvUser, uint64_t iTick);
+static DECLCALLBACK(int)    tmR3TicklessThread(RTTHREAD hThreadSelf, void *pvUser);
+static void                 tmR3TicklessKick(PVM pVM);
 static void                 tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue);
 static void                 tmR3TimerQueueRunVirtualSync(PVM pVM);
 static DECLCALLBACK(int)    tmR3SetWarpDrive(PVM pVM, uint32_t u32Percent);
@@ -209,6 +211,10 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
 
     pVM->tm.s.offVM = RT_OFFSETOF(VM, tm.s);
     pVM->tm.s.idTimerCpu = pVM->cCpus - 1; /* The last CPU. */
+    pVM->tm.s.hTicklessEvt = NIL_SUPSEMEVENT;
+    pVM->tm.s.hTicklessThread = NIL_RTTHREAD;
+    for (unsigned i = 0; i < RT_ELEMENTS(pVM->tm.s.au64TicklessExpire); i++)
+        pVM->tm.s.au64TicklessExpire[i] = UINT64_MAX;
     pVM->tm.s.paTimerQueuesR3[TMCLOCK_VIRTUAL].enmClock        = TMCLOCK_VIRTUAL;
     pVM->tm.s.paTimerQueuesR3[TMCLOCK_VIRTUAL].u64Expire       = INT64_MAX;
     pVM->tm.s.paTimerQueuesR3[TMCLOCK_VIRTUAL_SYNC].enmClock   = TMCLOCK_VIRTUAL_SYNC;
@@ -553,7 +559,8 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
      * Start the timer (guard against REM not yielding).
      */
     /** @cfgm{TM/TimerMillies, uint32_t, ms, 1, 1000, 10}
-     * The watchdog timer interval.  */
+     * The watchdog timer interval.  In tickless mode this is how long the
+     * tickless thread waits for the EMT to deal with expired timers. */
     uint32_t u32Millies;
     rc = CFGMR3QueryU32(pCfgHandle, "TimerMillies", &u32Millies);
     if (rc == VERR_CFGM_VALUE_NOT_FOUND)
@@ -561,14 +568,54 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
     else if (RT_FAILURE(rc))
         return VMSetError(pVM, rc, RT_SRC_POS,
                           N_("Configuration error: Failed to query uint32_t value \"TimerMillies\""));
-    rc = RTTimerCreate(&pVM->tm.s.pTimer, u32Millies, tmR3TimerCallback, pVM);
+    pVM->tm.s.u32TimerMillies = u32Millies;
+
+    /** @cfgm{TM/Tickless, bool, false}
+     * Whether to replace the periodic watchdog timer with a thread which sleeps
+     * until the earliest timer deadline.  An idle VM with a fast guest timer
+     * then only wakes up the host when there actually is something to do. */
+    rc = CFGMR3QueryBoolDef(pCfgHandle, "Tickless", &pVM->tm.s.fTickless, false);
+    if (RT_FAILURE(rc))
+        return VMSetError(pVM, rc, RT_SRC_POS,
+                          N_("Configuration error: Failed to querying bool value \"Tickless\""));
+
+    /** @cfgm{TM/TicklessMaxSleepMs, uint32_t, ms, 1, 60000, 1000}
+     * The longest the tickless thread sleeps without anything to wake up for. */
+    uint32_t cMsTicklessMaxSleep;
+    rc = CFGMR3QueryU32Def(pCfgHandle, "TicklessMaxSleepMs", &cMsTicklessMaxSleep, 1000);
     if (RT_FAILURE(rc))
+        return VMSetError(pVM, rc, RT_SRC_POS,
+                          N_("Configuration error: Failed to querying uint32_t value \"TicklessMaxSleepMs\""));
+    if (cMsTicklessMaxSleep < 1 || cMsTicklessMaxSleep > 60000)
+        return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                          N_("Configuration error: \"TicklessMaxSleepMs\" is out of range (1..60000): %u"), cMsTicklessMaxSleep);
+    pVM->tm.s.cNsTicklessMaxSleep = (uint64_t)cMsTicklessMaxSleep * RT_NS_1MS;
+
+    pVM->tm.s.u64HostWakeupPeriodStart = RTTimeNanoTS();
+    if (pVM->tm.s.fTickless)
     {
-        AssertMsgFailed(("Failed to create timer, u32Millies=%d rc=%Rrc.\n", u32Millies, rc));
-        return rc;
+        rc = SUPSemEventCreate(pVM->pSession, &pVM->tm.s.hTicklessEvt);
+        if (RT_SUCCESS(rc))
+            rc = RTThreadCreate(&pVM->tm.s.hTicklessThread, tmR3TicklessThread, pVM, 0, RTTHREADTYPE_TIMER,
+                                RTTHREADFLAGS_WAITABLE, "TMTickless");
+        if (RT_FAILURE(rc))
+        {
+            AssertMsgFailed(("Failed to create the tickless thread, rc=%Rrc.\n", rc));
+            pVM->tm.s.fTickless = false;
+            return rc;
+        }
+        LogRel(("TM: Tickless mode, max sleep %u ms\n", cMsTicklessMaxSleep));
+    }
+    else
+    {
+        rc = RTTimerCreate(&pVM->tm.s.pTimer, u32Millies, tmR3TimerCallback, pVM);
+        if (RT_FAILURE(rc))
+        {
+            AssertMsgFailed(("Failed to create timer, u32Millies=%d rc=%Rrc.\n", u32Millies, rc));
+            return rc;
+        }
+        Log(("TM: Created timer %p firing every %d milliseconds\n", pVM->tm.s.pTimer, u32Millies));
     }
-    Log(("TM: Created timer %p firing every %d milliseconds\n", pVM->tm.s.pTimer, u32Millies));
-    pVM->tm.s.u32TimerMillies = u32Millies;
 
     /*
      * Register saved state.
@@ -592,6 +639,9 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
     STAM_REL_REG(     pVM,(void*)&pVM->tm.s.offVirtualSync,               STAMTYPE_U64, "/TM/VirtualSync/CurrentOffset",               STAMUNIT_NS, "The current offset. (subtract GivenUp to get the lag)");
     STAM_REL_REG_USED(pVM,(void*)&pVM->tm.s.offVirtualSyncGivenUp,        STAMTYPE_U64, "/TM/VirtualSync/GivenUp",                     STAMUNIT_NS, "Nanoseconds of the 'CurrentOffset' that's been given up and won't ever be attempted caught up with.");
     STAM_REL_REG(     pVM,(void*)&pVM->tm.s.uMaxHzHint,                   STAMTYPE_U32, "/TM/MaxHzHint",                               STAMUNIT_HZ, "Max guest timer frequency hint.");
+    STAM_REL_REG(     pVM,(void*)&pVM->tm.s.StatHostWakeups,              STAMTYPE_COUNTER, "/TM/HostWakeups",                         STAMUNIT_OCCURENCES, "Host wakeups of the timer thread / watchdog timer.");
+    STAM_REL_REG(     pVM,(void*)&pVM->tm.s.cHostWakeupsPerSec,           STAMTYPE_U32, "/TM/HostWakeupsPerSec",                       STAMUNIT_HZ, "Host wakeups per second of the timer thread / watchdog timer, last second.");
+    STAM_REL_REG_USED(pVM,(void*)&pVM->tm.s.StatTicklessKicks,            STAMTYPE_COUNTER, "/TM/Tickless/Kicks",                      STAMUNIT_OCCURENCES, "Tickless thread wakeups for a new earlier deadline.");
 
 #ifdef VBOX_WITH_STATISTICS
     STAM_REG_USED(pVM,(void *)&pVM->tm.s.VirtualGetRawDataR3.cExpired,    STAMTYPE_U32, "/TM/R3/cExpired",                     STAMUNIT_OCCURENCES, "Times the TSC interval expired (overlaps 1ns steps).");
@@ -1043,6 +1093,21 @@ VMM_INT_DECL(int) TMR3Term(PVM pVM)
         pVM->tm.s.pTimer = NULL;
     }
 
+    if (pVM->tm.s.hTicklessThread != NIL_RTTHREAD)
+    {
+        ASMAtomicWriteBool(&pVM->tm.s.fTicklessTerminate, true);
+        SUPSemEventSignal(pVM->pSession, pVM->tm.s.hTicklessEvt);
+        int rc = RTThreadWait(pVM->tm.s.hTicklessThread, 30000, NULL);
+        AssertRC(rc);
+        pVM->tm.s.hTicklessThread = NIL_RTTHREAD;
+    }
+    if (pVM->tm.s.hTicklessEvt != NIL_SUPSEMEVENT)
+    {
+        pVM->tm.s.fTickless = false;
+        SUPSemEventClose(pVM->pSession, pVM->tm.s.hTicklessEvt);
+        pVM->tm.s.hTicklessEvt = NIL_SUPSEMEVENT;
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -1275,6 +1340,54 @@ static DECLCALLBACK(int) tmR3Load(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, u
 }
 
 
+/**
+ * Grows the active timer heap of a queue.
+ *
+ * The heap is only ever grown here, when creating timers, so that linking a
+ * timer into it never has to allocate anything, which is not possible in
+ * ring-0 and raw-mode context.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pQueue      The timer queue (ring-3 pointer).
+ * @param   cMinEntries The minimum number of entries required.
+ */
+static int tmR3TimerQueueGrow(PVM pVM, PTMTIMERQUEUE pQueue, uint32_t cMinEntries)
+{
+    uint32_t cNew = RT_MAX(pQueue->cHeapAlloc * 2, 32);
+    while (cNew < cMinEntries)
+        cNew *= 2;
+
+    /* Entry 0 is not used. */
+    PTMTIMERHEAPENTRY paNew;
+    int rc = MMHyperAlloc(pVM, sizeof(paNew[0]) * (cNew + 1), 0, MM_TAG_TM, (void **)&paNew);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /*
+     * Switch heaps while owning the locks serializing access to the queue.
+     */
+    TM_LOCK_TIMERS(pVM);
+    if (pQueue->enmClock == TMCLOCK_VIRTUAL_SYNC)
+        PDMCritSectEnter(&pVM->tm.s.VirtualSyncLock, VERR_IGNORED);
+
+    PTMTIMERHEAPENTRY paOld = pQueue->offHeap ? TMTIMER_GET_HEAP(pQueue) : NULL;
+    if (paOld)
+        memcpy(paNew, paOld, sizeof(paNew[0]) * (pQueue->cActive + 1));
+    pQueue->offHeap    = (intptr_t)paNew - (intptr_t)pQueue;
+    pQueue->cHeapAlloc = cNew;
+
+    if (pQueue->enmClock == TMCLOCK_VIRTUAL_SYNC)
+        PDMCritSectLeave(&pVM->tm.s.VirtualSyncLock);
+    TM_UNLOCK_TIMERS(pVM);
+
+    if (paOld)
+        MMHyperFree(pVM, paOld);
+    Log(("TM: Grew the heap of queue %d to %u entries\n", pQueue->enmClock, cNew));
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Internal TMR3TimerCreate worker.
  *
@@ -1288,6 +1401,17 @@ static int tmr3TimerCreate(PVM pVM, TMCLOCK enmClock, const char *pszDesc, PPTMT
 {
     VM_ASSERT_EMT(pVM);
 
+    /*
+     * Make sure the active heap of the queue has room for one more.
+     */
+    PTMTIMERQUEUE pQueue = &pVM->tm.s.paTimerQueuesR3[enmClock];
+    if (pQueue->cTimers >= pQueue->cHeapAlloc)
+    {
+        int rc = tmR3TimerQueueGrow(pVM, pQueue, pQueue->cTimers + 1);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
     /*
      * Allocate the timer.
      */
@@ -1317,14 +1441,14 @@ static int tmr3TimerCreate(PVM pVM, TMCLOCK enmClock, const char *pszDesc, PPTMT
     pTimer->pVMRC           = pVM->pVMRC;
     pTimer->enmState        = TMTIMERSTATE_STOPPED;
     pTimer->offScheduleNext = 0;
-    pTimer->offNext         = 0;
-    pTimer->offPrev         = 0;
+    pTimer->idxActive       = 0;
     pTimer->pvUser          = NULL;
     pTimer->pCritSect       = NULL;
     pTimer->pszDesc         = pszDesc;
 
     /* insert into the list of created timers. */
     TM_LOCK_TIMERS(pVM);
+    pQueue->cTimers++;
     pTimer->pBigPrev        = NULL;
     pTimer->pBigNext        = pVM->tm.s.pCreated;
     pVM->tm.s.pCreated      = pTimer;
@@ -1631,21 +1755,7 @@ VMMR3DECL(int) TMR3TimerDestroy(PTMTIMER pTimer)
      * Unlink from the active list.
      */
     if (fActive)
-    {
-        const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
-        const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
-        if (pPrev)
-            TMTIMER_SET_NEXT(pPrev, pNext);
-        else
-        {
-            TMTIMER_SET_HEAD(pQueue, pNext);
-            pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
-        }
-        if (pNext)
-            TMTIMER_SET_PREV(pNext, pPrev);
-        pTimer->offNext = 0;
-        pTimer->offPrev = 0;
-    }
+        tmTimerQueueHeapRemove(pQueue, pTimer);
 
     /*
      * Unlink from the schedule list by running it.
@@ -1661,7 +1771,9 @@ VMMR3DECL(int) TMR3TimerDestroy(PTMTIMER pTimer)
     /*
      * Read to move the timer from the created list and onto the free list.
      */
-    Assert(!pTimer->offNext); Assert(!pTimer->offPrev); Assert(!pTimer->offScheduleNext);
+    Assert(!pTimer->idxActive); Assert(!pTimer->offScheduleNext);
+    Assert(pQueue->cTimers > 0);
+    pQueue->cTimers--;
 
     /* unlink from created list */
     if (pTimer->pBigPrev)
@@ -1856,22 +1968,43 @@ DECLINLINE(bool) tmR3AnyExpiredTimers(PVM pVM)
 
 
 /**
- * Schedule timer callback.
+ * Counts a host wakeup of the timer thread and updates the wakeups per second
+ * statistics once a second.
  *
- * @param   pTimer      Timer handle.
- * @param   pvUser      Pointer to the VM.
+ * @param   pVM         Pointer to the VM.
+ * @param   u64Now      The current RTTimeNanoTS time.
  * @thread  Timer thread.
+ */
+static void tmR3TimerCountWakeup(PVM pVM, uint64_t u64Now)
+{
+    STAM_REL_COUNTER_INC(&pVM->tm.s.StatHostWakeups);
+    pVM->tm.s.cHostWakeupsInPeriod++;
+    uint64_t const cNsPeriod = u64Now - pVM->tm.s.u64HostWakeupPeriodStart;
+    if (cNsPeriod >= RT_NS_1SEC)
+    {
+        pVM->tm.s.cHostWakeupsPerSec = (uint32_t)ASMMultU64ByU32DivByU32(pVM->tm.s.cHostWakeupsInPeriod, RT_NS_1SEC,
+                                                                         (uint32_t)RT_MIN(cNsPeriod, UINT32_MAX));
+        pVM->tm.s.cHostWakeupsInPeriod     = 0;
+        pVM->tm.s.u64HostWakeupPeriodStart = u64Now;
+    }
+}
+
+
+/**
+ * Raises the timer FF on the timer EMT if there are expired timers or pending
+ * schedules.
  *
- * @remark  We cannot do the scheduling and queues running from a timer handler
+ * @param   pVM         Pointer to the VM.
+ * @thread  Timer thread.
+ *
+ * @remark  We cannot do the scheduling and queues running from the timer thread
  *          since it's not executing in EMT, and even if it was it would be async
  *          and we wouldn't know the state of the affairs.
  *          So, we'll just raise the timer FF and force any REM execution to exit.
  */
-static DECLCALLBACK(void) tmR3TimerCallback(PRTTIMER pTimer, void *pvUser, uint64_t /*iTick*/)
+static void tmR3TimerCheck(PVM pVM)
 {
-    PVM     pVM      = (PVM)pvUser;
     PVMCPU  pVCpuDst = &pVM->aCpus[pVM->tm.s.idTimerCpu];
-    NOREF(pTimer);
 
     AssertCompile(TMCLOCK_MAX == 4);
 #ifdef DEBUG_Sander /* very annoying, keep it private. */
@@ -1900,6 +2033,223 @@ static DECLCALLBACK(void) tmR3TimerCallback(PRTTIMER pTimer, void *pvUser, uint6
 }
 
 
+/**
+ * Schedule timer callback.
+ *
+ * @param   pTimer      Timer handle.
+ * @param   pvUser      Pointer to the VM.
+ * @thread  Timer thread.
+ */
+static DECLCALLBACK(void) tmR3TimerCallback(PRTTIMER pTimer, void *pvUser, uint64_t /*iTick*/)
+{
+    PVM pVM = (PVM)pvUser;
+    NOREF(pTimer);
+
+    tmR3TimerCountWakeup(pVM, RTTimeNanoTS());
+    tmR3TimerCheck(pVM);
+}
+
+
+/**
+ * Converts a timer queue expiration time to the RTTimeNanoTS time the
+ * tickless thread sleeps on.
+ *
+ * The result errs on the early side, the thread will just go back to sleep if
+ * it wakes up before anything has expired.
+ *
+ * @returns RTTimeNanoTS deadline, UINT64_MAX if it doesn't need waking up
+ *          for this (the queue is empty or the clock is paused).
+ * @param   pVM             Pointer to the VM.
+ * @param   enmClock        The clock of the queue.
+ * @param   u64Expire       The expiration time, in enmClock units.
+ * @param   u64Now          The current RTTimeNanoTS time.
+ * @param   u64VirtualNow   The current virtual time.
+ * @param   u64TscNow       The current TSC of VCPU 0.
+ * @thread  Tickless thread.
+ */
+static uint64_t tmR3TicklessDeadline(PVM pVM, TMCLOCK enmClock, uint64_t u64Expire,
+                                     uint64_t u64Now, uint64_t u64VirtualNow, uint64_t u64TscNow)
+{
+    if (u64Expire >= (uint64_t)INT64_MAX)
+        return UINT64_MAX;
+
+    switch (enmClock)
+    {
+        case TMCLOCK_VIRTUAL_SYNC:
+            /* A stopped virtual sync clock is treated as ticking, that's early. */
+            u64Expire += pVM->tm.s.offVirtualSync;
+            if (pVM->tm.s.fVirtualSyncCatchUp)
+            {
+                /* Catching up, the clock gets there faster than the virtual one. */
+                if (u64Expire <= u64VirtualNow)
+                    return 0;
+                u64Expire = u64VirtualNow + ASMMultU64ByU32DivByU32(u64Expire - u64VirtualNow, 100,
+                                                                    100 + pVM->tm.s.u32VirtualSyncCatchUpPercentage);
+            }
+            /* fall thru */
+        case TMCLOCK_VIRTUAL:
+            if (!pVM->tm.s.cVirtualTicking)
+                return UINT64_MAX;
+            if (u64Expire <= u64VirtualNow)
+                return 0;
+            if (pVM->tm.s.fVirtualWarpDrive)
+                return u64Now + ASMMultU64ByU32DivByU32(u64Expire - u64VirtualNow, 100,
+                                                        pVM->tm.s.u32VirtualWarpDrivePercentage);
+            return u64Now + (u64Expire - u64VirtualNow);
+
+        case TMCLOCK_REAL:
+            return u64Expire * RT_NS_1MS;
+
+        case TMCLOCK_TSC:
+        {
+            if (u64Expire <= u64TscNow)
+                return 0;
+            uint64_t const cTicksPerUs = TMCpuTicksPerSecond(pVM) / RT_US_1SEC + 1;
+            return u64Now + (u64Expire - u64TscNow) / cTicksPerUs * RT_NS_1US;
+        }
+
+        default:
+            AssertFailedReturn(0);
+    }
+}
+
+
+/**
+ * Converts the RTTimeNanoTS time the tickless thread sleeps till to the time
+ * on the given clock, i.e. the reverse of tmR3TicklessDeadline.
+ *
+ * This is what tmTicklessNewHead compares new queue heads against.  The
+ * result errs on the late side so nothing expiring before the deadline gets
+ * by without a kick; the extra kicks just make the thread go back to sleep.
+ *
+ * @returns The time on enmClock, 0 if the clock is paused.
+ * @param   pVM             Pointer to the VM.
+ * @param   enmClock        The clock.
+ * @param   u64Deadline     The RTTimeNanoTS deadline, after u64Now.
+ * @param   u64Now          The current RTTimeNanoTS time.
+ * @param   u64VirtualNow   The current virtual time.
+ * @param   u64TscNow       The current TSC of VCPU 0.
+ * @thread  Tickless thread.
+ */
+static uint64_t tmR3TicklessExpire(PVM pVM, TMCLOCK enmClock, uint64_t u64Deadline,
+                                   uint64_t u64Now, uint64_t u64VirtualNow, uint64_t u64TscNow)
+{
+    uint64_t const cNsSleep = u64Deadline - u64Now;
+    switch (enmClock)
+    {
+        case TMCLOCK_VIRTUAL:
+        case TMCLOCK_VIRTUAL_SYNC:
+        {
+            if (!pVM->tm.s.cVirtualTicking)
+                return 0;
+            uint64_t cNsVirtual = cNsSleep;
+            if (pVM->tm.s.fVirtualWarpDrive)
+                cNsVirtual = ASMMultU64ByU32DivByU32(cNsSleep, pVM->tm.s.u32VirtualWarpDrivePercentage, 100) + 1;
+            if (enmClock == TMCLOCK_VIRTUAL)
+                return u64VirtualNow + cNsVirtual;
+
+            uint64_t const offVirtualSync = pVM->tm.s.offVirtualSync;
+            if (pVM->tm.s.fVirtualSyncCatchUp)
+                cNsVirtual = ASMMultU64ByU32DivByU32(cNsVirtual, 100 + pVM->tm.s.u32VirtualSyncCatchUpPercentage, 100) + 1;
+            if (u64VirtualNow + cNsVirtual <= offVirtualSync)
+                return 0;
+            return u64VirtualNow + cNsVirtual - offVirtualSync;
+        }
+
+        case TMCLOCK_REAL:
+            return u64Deadline / RT_NS_1MS + 1;
+
+        case TMCLOCK_TSC:
+        {
+            uint64_t const cTicksPerUs = TMCpuTicksPerSecond(pVM) / RT_US_1SEC + 1;
+            return u64TscNow + (cNsSleep / RT_NS_1US + 1) * cTicksPerUs;
+        }
+
+        default:
+            AssertFailedReturn(UINT64_MAX);
+    }
+}
+
+
+/**
+ * Wakes up the tickless thread so it works out the next deadline again.
+ *
+ * Used when the clocks change speed or start ticking again, which makes the
+ * times published in au64TicklessExpire wrong.
+ *
+ * @param   pVM             Pointer to the VM.
+ */
+static void tmR3TicklessKick(PVM pVM)
+{
+    if (pVM->tm.s.fTickless)
+    {
+        SUPSemEventSignal(pVM->pSession, pVM->tm.s.hTicklessEvt);
+        STAM_REL_COUNTER_INC(&pVM->tm.s.StatTicklessKicks);
+    }
+}
+
+
+/**
+ * The tickless timer thread, replaces tmR3TimerCallback in tickless mode.
+ *
+ * Instead of checking the queues at a fixed rate, this sleeps until the
+ * earliest deadline of the timer queues.  The deadline is published as a
+ * time on each clock so that linking a new queue head which expires before
+ * it can kick the thread without any clock reads (see tmTicklessNewHead).
+ *
+ * @returns VINF_SUCCESS.
+ * @param   hThreadSelf The thread handle.
+ * @param   pvUser      Pointer to the VM.
+ * @thread  Timer thread.
+ */
+static DECLCALLBACK(int) tmR3TicklessThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PVM     pVM      = (PVM)pvUser;
+    PVMCPU  pVCpuDst = &pVM->aCpus[pVM->tm.s.idTimerCpu];
+    NOREF(hThreadSelf);
+
+    while (!ASMAtomicReadBool(&pVM->tm.s.fTicklessTerminate))
+    {
+        tmR3TimerCheck(pVM);
+
+        /*
+         * Work out when to wake up next.  The published times are UINT64_MAX
+         * while reading the queue heads so a new head racing us kicks the
+         * thread.
+         */
+        for (unsigned iClock = 0; iClock < TMCLOCK_MAX; iClock++)
+            ASMAtomicWriteU64(&pVM->tm.s.au64TicklessExpire[iClock], UINT64_MAX);
+        uint64_t const u64Now        = RTTimeNanoTS();
+        uint64_t const u64VirtualNow = TMVirtualGetNoCheck(pVM);
+        uint64_t const u64TscNow     = TMCpuTickGetNoCheck(&pVM->aCpus[0]);
+        uint64_t u64Deadline         = u64Now + pVM->tm.s.cNsTicklessMaxSleep;
+        for (unsigned iClock = 0; iClock < TMCLOCK_MAX; iClock++)
+        {
+            uint64_t const u64Expire = tmR3TicklessDeadline(pVM, (TMCLOCK)iClock,
+                                                            ASMAtomicReadU64(&pVM->tm.s.paTimerQueuesR3[iClock].u64Expire),
+                                                            u64Now, u64VirtualNow, u64TscNow);
+            u64Deadline = RT_MIN(u64Deadline, u64Expire);
+        }
+
+        /* Give the EMT time to deal with whatever has already expired. */
+        if (    u64Deadline <= u64Now
+            ||  VMCPU_FF_ISSET(pVCpuDst, VMCPU_FF_TIMER)
+            ||  pVM->tm.s.fRunningQueues)
+            u64Deadline = u64Now + pVM->tm.s.u32TimerMillies * RT_NS_1MS_64;
+        for (unsigned iClock = 0; iClock < TMCLOCK_MAX; iClock++)
+            ASMAtomicWriteU64(&pVM->tm.s.au64TicklessExpire[iClock],
+                              tmR3TicklessExpire(pVM, (TMCLOCK)iClock, u64Deadline, u64Now, u64VirtualNow, u64TscNow));
+
+        int rc = SUPSemEventWaitNsAbsIntr(pVM->pSession, pVM->tm.s.hTicklessEvt, u64Deadline);
+        AssertMsg(RT_SUCCESS(rc) || rc == VERR_TIMEOUT || rc == VERR_INTERRUPTED, ("%Rrc\n", rc));
+        if (RT_FAILURE(rc) && rc != VERR_TIMEOUT && rc != VERR_INTERRUPTED)
+            RTThreadSleep(pVM->tm.s.u32TimerMillies);
+        tmR3TimerCountWakeup(pVM, RTTimeNanoTS());
+    }
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Schedules and runs any pending timers.
  *
@@ -1956,7 +2306,7 @@ VMMR3DECL(void) TMR3TimerQueuesDo(PVM pVM)
     STAM_PROFILE_ADV_STOP(&pVM->tm.s.aStatDoQueues[TMCLOCK_VIRTUAL], s2);
 
     /* TMCLOCK_TSC */
-    Assert(!pVM->tm.s.paTimerQueuesR3[TMCLOCK_TSC].offActive); /* not used */
+    Assert(!pVM->tm.s.paTimerQueuesR3[TMCLOCK_TSC].cActive); /* not used */
 
     /* TMCLOCK_REAL */
     STAM_PROFILE_ADV_START(&pVM->tm.s.aStatDoQueues[TMCLOCK_REAL], s3);
@@ -2006,42 +2356,46 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
      *      However, we only allow EMT to handle EXPIRED_PENDING
      *      timers, thus enabling the timer handler function to
      *      arm the timer again.
+     *
+     * N.B. Timers linked while we're at it (re-armed by the handlers) are
+     *      left for the next run, like they used to be when this was a list
+     *      walk.
+     *
+     * N.B. When the head is in a pending state, the schedule list is
+     *      processed and the run carries on with whatever is due at the head
+     *      after that.  Only if the very same entry is still stuck at the
+     *      head (another thread is in the middle of changing it) are it and
+     *      the rest left to the next run, which the schedule list triggers.
      */
-    PTMTIMER pNext = TMTIMER_GET_HEAD(pQueue);
-    if (!pNext)
+    if (!pQueue->cActive)
         return;
-    const uint64_t u64Now = tmClock(pVM, pQueue->enmClock);
-    while (pNext && pNext->u64Expire <= u64Now)
+    const uint64_t  u64Now     = tmClock(pVM, pQueue->enmClock);
+    uint32_t const  uSeqEnd    = pQueue->uSeqNext;
+    uint32_t        uSeqStuck  = uSeqEnd;       /* no entry being run has this one */
+    while (pQueue->cActive)
     {
-        PTMTIMER        pTimer    = pNext;
-        pNext = TMTIMER_GET_NEXT(pTimer);
+        PTMTIMERHEAPENTRY pHead = &TMTIMER_GET_HEAP(pQueue)[1];
+        if (   pHead->u64Expire > u64Now
+            || (int32_t)(pHead->uSeq - uSeqEnd) >= 0)
+            break;
+        PTMTIMER        pTimer    = TMTIMER_HEAP_ENTRY_TIMER(pQueue, pHead);
         PPDMCRITSECT    pCritSect = pTimer->pCritSect;
         if (pCritSect)
             PDMCritSectEnter(pCritSect, VERR_IGNORED);
         Log2(("tmR3TimerQueueRun: %p:{.enmState=%s, .enmClock=%d, .enmType=%d, u64Expire=%llx (now=%llx) .pszDesc=%s}\n",
               pTimer, tmTimerState(pTimer->enmState), pTimer->enmClock, pTimer->enmType, pTimer->u64Expire, u64Now, pTimer->pszDesc));
-        bool fRc;
-        TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_GET_UNLINK, TMTIMERSTATE_ACTIVE, fRc);
-        if (fRc)
+        bool fUnlinked;
+        TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_GET_UNLINK, TMTIMERSTATE_ACTIVE, fUnlinked);
+        if (fUnlinked)
         {
             Assert(!pTimer->offScheduleNext); /* this can trigger falsely */
 
             /* unlink */
-            const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
-            if (pPrev)
-                TMTIMER_SET_NEXT(pPrev, pNext);
-            else
-            {
-                TMTIMER_SET_HEAD(pQueue, pNext);
-                pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
-            }
-            if (pNext)
-                TMTIMER_SET_PREV(pNext, pPrev);
-            pTimer->offNext = 0;
-            pTimer->offPrev = 0;
+            tmTimerQueueHeapRemove(pQueue, pTimer);
 
             /* fire */
             TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
+            DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_TIMER_FIRE, pTimer->enmClock, pTimer->u64Expire, (uintptr_t)pTimer);
             switch (pTimer->enmType)
             {
                 case TMTIMERTYPE_DEV:       pTimer->u.Dev.pfnTimer(pTimer->u.Dev.pDevIns, pTimer, pTimer->pvUser); break;
@@ -2053,13 +2407,25 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
                     AssertMsgFailed(("Invalid timer type %d (%s)\n", pTimer->enmType, pTimer->pszDesc));
                     break;
             }
+            DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_TIMER_DONE, pTimer->enmClock, 0, (uintptr_t)pTimer);
 
             /* change the state if it wasn't changed already in the handler. */
+            bool fRc;
             TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_STOPPED, TMTIMERSTATE_EXPIRED_DELIVER, fRc);
             Log2(("tmR3TimerQueueRun: new state %s\n", tmTimerState(pTimer->enmState)));
         }
         if (pCritSect)
             PDMCritSectLeave(pCritSect);
+        if (!fUnlinked)
+        {
+            /* Someone is changing the head timer, get the schedule list
+               processed and carry on with the new head.  Give up if it
+               didn't move the head. */
+            if (pHead->uSeq == uSeqStuck)
+                break;
+            uSeqStuck = pHead->uSeq;
+            tmTimerQueueSchedule(pVM, pQueue);
+        }
     } /* run loop */
 }
 
@@ -2086,13 +2452,13 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
     /*
      * Any timers?
      */
-    PTMTIMER pNext = TMTIMER_GET_HEAD(pQueue);
-    if (RT_UNLIKELY(!pNext))
+    if (RT_UNLIKELY(!pQueue->cActive))
     {
         Assert(pVM->tm.s.fVirtualSyncTicking || !pVM->tm.s.cVirtualTicking);
         return;
     }
     STAM_COUNTER_INC(&pVM->tm.s.StatVirtualSyncRun);
+    uint64_t const u64HeadExpire = TMTIMER_GET_HEAP(pQueue)[1].u64Expire;
 
     /*
      * Calculate the time frame for which we will dispatch timers.
@@ -2113,7 +2479,7 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
     {
         STAM_COUNTER_INC(&pVM->tm.s.StatVirtualSyncRunStoppedAlready);
         u64Now = pVM->tm.s.u64VirtualSync;
-        Assert(u64Now <= pNext->u64Expire);
+        Assert(u64Now <= u64HeadExpire);
     }
     else
     {
@@ -2152,11 +2518,10 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
         }
 
         /* Check if stopped by expired timer. */
-        uint64_t const u64Expire = pNext->u64Expire;
-        if (u64Now >= u64Expire)
+        if (u64Now >= u64HeadExpire)
         {
             STAM_COUNTER_INC(&pVM->tm.s.StatVirtualSyncRunStop);
-            u64Now = u64Expire;
+            u64Now = u64HeadExpire;
             ASMAtomicWriteU64(&pVM->tm.s.u64VirtualSync, u64Now);
             ASMAtomicWriteBool(&pVM->tm.s.fVirtualSyncTicking, false);
             Log4(("TM: %'RU64/-%'8RU64: exp tmr [tmR3TimerQueueRunVirtualSync]\n", u64Now, u64VirtualNow - u64Now - offSyncGivenUp));
@@ -2191,15 +2556,23 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
 
     /*
      * Process the expired timers moving the clock along as we progress.
+     * Timers armed by the callbacks are left for the next run.  The head
+     * entry is looked up again each time around as a callback creating a
+     * timer may have caused tmR3TimerQueueGrow to reallocate the heap.
      */
 #ifdef VBOX_STRICT
     uint64_t u64Prev = u64Now; NOREF(u64Prev);
 #endif
-    while (pNext && pNext->u64Expire <= u64Max)
+    uint32_t const uSeqEnd = pQueue->uSeqNext;
+    while (pQueue->cActive)
     {
+        PTMTIMERHEAPENTRY const pHead = &TMTIMER_GET_HEAP(pQueue)[1];
+        if (   pHead->u64Expire > u64Max
+            || (int32_t)(pHead->uSeq - uSeqEnd) >= 0)
+            break;
+
         /* Advance */
-        PTMTIMER pTimer = pNext;
-        pNext = TMTIMER_GET_NEXT(pTimer);
+        PTMTIMER pTimer = TMTIMER_HEAP_ENTRY_TIMER(pQueue, pHead);
 
         /* Take the associated lock. */
         PPDMCRITSECT pCritSect = pTimer->pCritSect;
@@ -2221,6 +2594,7 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
         /* Unlink it, change the state and do the callout. */
         tmTimerQueueUnlinkActive(pQueue, pTimer);
         TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
+        DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_TIMER_FIRE, pTimer->enmClock, pTimer->u64Expire, (uintptr_t)pTimer);
         switch (pTimer->enmType)
         {
             case TMTIMERTYPE_DEV:       pTimer->u.Dev.pfnTimer(pTimer->u.Dev.pDevIns, pTimer, pTimer->pvUser); break;
@@ -2232,6 +2606,7 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
                 AssertMsgFailed(("Invalid timer type %d (%s)\n", pTimer->enmType, pTimer->pszDesc));
                 break;
         }
+        DBGFTRACE_BIN(pVM, DBGFTRACEBINEVT_TIMER_DONE, pTimer->enmClock, 0, (uintptr_t)pTimer);
 
         /* Change the state if it wasn't changed already in the handler.
            Reset the Hz hint too since this is the same as TMTimerStop. */
@@ -2320,6 +2695,7 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
                     STAM_COUNTER_INC(&pVM->tm.s.aStatVirtualSyncCatchupAdjust[i]);
                     ASMAtomicWriteU32(&pVM->tm.s.u32VirtualSyncCatchUpPercentage, pVM->tm.s.aVirtualSyncCatchUpPeriods[i].u32Percentage);
                     Log4(("TM: %'RU64/%'8RU64: adj %u%%\n", u64VirtualNow2 - offNew, offLag, pVM->tm.s.u32VirtualSyncCatchUpPercentage));
+                    tmR3TicklessKick(pVM); /* the virtual sync timers expire sooner now */
                 }
                 pVM->tm.s.u64VirtualSyncCatchUpPrev = u64VirtualNow2;
             }
@@ -2348,6 +2724,7 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
                 ASMAtomicWriteU32(&pVM->tm.s.u32VirtualSyncCatchUpPercentage, pVM->tm.s.aVirtualSyncCatchUpPeriods[i].u32Percentage);
                 ASMAtomicWriteBool(&pVM->tm.s.fVirtualSyncCatchUp, true);
                 Log4(("TM: %'RU64/%'8RU64: catch-up %u%%\n", u64VirtualNow2 - offNew, offLag, pVM->tm.s.u32VirtualSyncCatchUpPercentage));
+                tmR3TicklessKick(pVM); /* the virtual sync clock runs faster now */
             }
             else
             {
@@ -2707,6 +3084,8 @@ VMMR3DECL(int) TMR3NotifyResume(PVM pVM, PVMCPU pVCpu)
     rc = tmVirtualResumeLocked(pVM);
     TM_UNLOCK_TIMERS(pVM);
 
+    /* The tickless thread ignored the paused clocks, have it look again. */
+    tmR3TicklessKick(pVM);
     return rc;
 }
 
@@ -2763,6 +3142,9 @@ static DECLCALLBACK(int) tmR3SetWarpDrive(PVM pVM, uint32_t u32Percent)
     if (fPaused)
         TMR3NotifyResume(pVM, pVCpu);
     TM_UNLOCK_TIMERS(pVM);
+
+    /* The virtual clock deadlines the tickless thread worked out are off now. */
+    tmR3TicklessKick(pVM);
     return VINF_SUCCESS;
 }
 
@@ -2981,11 +3363,10 @@ static DECLCALLBACK(void) tmR3TimerInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char
     NOREF(pszArgs);
     pHlp->pfnPrintf(pHlp,
                     "Timers (pVM=%p)\n"
-                    "%.*s %.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
+                    "%.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
                     pVM,
                     sizeof(RTR3PTR) * 2,        "pTimerR3        ",
-                    sizeof(int32_t) * 2,        "offNext         ",
-                    sizeof(int32_t) * 2,        "offPrev         ",
+                    sizeof(uint32_t) * 2,       "idxActiv        ",
                     sizeof(int32_t) * 2,        "offSched        ",
                                                 "Time",
                                                 "Expire",
@@ -2995,10 +3376,9 @@ static DECLCALLBACK(void) tmR3TimerInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char
     for (PTMTIMERR3 pTimer = pVM->tm.s.pCreated; pTimer; pTimer = pTimer->pBigNext)
     {
         pHlp->pfnPrintf(pHlp,
-                        "%p %08RX32 %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
+                        "%p %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
                         pTimer,
-                        pTimer->offNext,
-                        pTimer->offPrev,
+                        pTimer->idxActive,
                         pTimer->offScheduleNext,
                         tmR3Get5CharClockName(pTimer->enmClock),
                         TMTimerGet(pTimer),
@@ -3023,11 +3403,10 @@ static DECLCALLBACK(void) tmR3TimerInfoActive(PVM pVM, PCDBGFINFOHLP pHlp, const
     NOREF(pszArgs);
     pHlp->pfnPrintf(pHlp,
                     "Active Timers (pVM=%p)\n"
-                    "%.*s %.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
+                    "%.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
                     pVM,
                     sizeof(RTR3PTR) * 2,        "pTimerR3        ",
-                    sizeof(int32_t) * 2,        "offNext         ",
-                    sizeof(int32_t) * 2,        "offPrev         ",
+                    sizeof(uint32_t) * 2,       "idxActiv        ",
                     sizeof(int32_t) * 2,        "offSched        ",
                                                 "Time",
                                                 "Expire",
@@ -3035,16 +3414,17 @@ static DECLCALLBACK(void) tmR3TimerInfoActive(PVM pVM, PCDBGFINFOHLP pHlp, const
                                                 "State");
     for (unsigned iQueue = 0; iQueue < TMCLOCK_MAX; iQueue++)
     {
+        /* Note! Heap order, only the first entry is the next one to expire. */
         TM_LOCK_TIMERS(pVM);
-        for (PTMTIMERR3 pTimer = TMTIMER_GET_HEAD(&pVM->tm.s.paTimerQueuesR3[iQueue]);
-             pTimer;
-             pTimer = TMTIMER_GET_NEXT(pTimer))
+        PTMTIMERQUEUE const     pQueue = &pVM->tm.s.paTimerQueuesR3[iQueue];
+        PTMTIMERHEAPENTRY const paHeap = TMTIMER_GET_HEAP(pQueue);
+        for (uint32_t i = 1; i <= pQueue->cActive; i++)
         {
+            PTMTIMERR3 pTimer = TMTIMER_HEAP_ENTRY_TIMER(pQueue, &paHeap[i]);
             pHlp->pfnPrintf(pHlp,
-                            "%p %08RX32 %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
+                            "%p %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
                             pTimer,
-                            pTimer->offNext,
-                            pTimer->offPrev,
+                            pTimer->idxActive,
                             pTimer->offScheduleNext,
                             tmR3Get5CharClockName(pTimer->enmClock),
                             TMTimerGet(pTimer),
@@ -484,6 +484,7 @@ static int vmR3CreateUVM(uint32_t cCpus, PCVMM2USERMETHODS pVmm2UserMethods, PUV
     pUVM->pVmm2UserMethods  = pVmm2UserMethods;
 
     AssertCompile(sizeof(pUVM->vm.s) <= sizeof(pUVM->vm.padding));
+    AssertCompile(sizeof(pUVM->aCpus[0].vm.s) <= sizeof(pUVM->aCpus[0].vm.padding));
 
     pUVM->vm.s.cUvmRefs      = 1;
     pUVM->vm.s.ppAtStateNext = &pUVM->vm.s.pAtState;
@@ -898,6 +899,27 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
             AssertRC(rc);
             rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltTimers,          STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_NS_PER_CALL, "Profiling halted state timer tasks.", "/PROF/VM/CPU%d/Halt/Timers", idCpu);
             AssertRC(rc);
+            rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPoll,            STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Halts ending while polling.",       "/PROF/VM/CPU%d/Halt/Poll/Polled", idCpu);
+            AssertRC(rc);
+            rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollBlocked,     STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time blocked by halts not ending while polling.", "/PROF/VM/CPU%d/Halt/Poll/Blocked", idCpu);
+            AssertRC(rc);
+            rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollWasted,      STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time polled by halts not ending while polling.", "/PROF/VM/CPU%d/Halt/Poll/Wasted", idCpu);
+            AssertRC(rc);
+            rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollOverBudget,  STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Times polling was skipped because the budget was used up.", "/PROF/VM/CPU%d/Halt/Poll/OverBudget", idCpu);
+            AssertRC(rc);
+            rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.cNsHaltPollWindow,       STAMTYPE_U32,     STAMVISIBILITY_USED,   STAMUNIT_NS,          "The current poll window.",         "/PROF/VM/CPU%d/Halt/Poll/Window", idCpu);
+            AssertRC(rc);
+            static const char * const s_apszHists[VM_HALT_POLL_HIST_END] = { "Polled", "Blocked", "Wasted" };
+            static const char * const s_apszBuckets[VM_HALT_POLL_HIST_BUCKETS] =
+            { "0-1us", "1-4us", "4-16us", "16-64us", "64-256us", "256-1024us", "1024-4096us", "4096us-inf" };
+            for (unsigned iHist = 0; iHist < VM_HALT_POLL_HIST_END; iHist++)
+                for (unsigned iBucket = 0; iBucket < VM_HALT_POLL_HIST_BUCKETS; iBucket++)
+                {
+                    rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.aStatHaltPollHist[iHist][iBucket], STAMTYPE_COUNTER,
+                                         STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "Halt polling histogram.",
+                                         "/PROF/VM/CPU%d/Halt/Poll/Hist%s/%s", idCpu, s_apszHists[iHist], s_apszBuckets[iBucket]);
+                    AssertRC(rc);
+                }
         }
 
         STAM_REG(pVM, &pUVM->vm.s.StatReqAllocNew,   STAMTYPE_COUNTER,     "/VM/Req/AllocNew",       STAMUNIT_OCCURENCES,        "Number of VMR3ReqAlloc returning a new packet.");
@@ -312,6 +312,184 @@ static int vmR3FatalWaitError(PUVMCPU pUVCpu, const char *pszFmt, int rcFmt)
 }
 
 
+/**
+ * Reads the adaptive halt polling configuration.
+ *
+ * @param   pUVM            Pointer to the user mode VM structure.
+ */
+static void vmR3HaltPollReadConfigU(PUVM pUVM)
+{
+    /*
+     * The defaults.  Polling is off unless configured.
+     */
+    pUVM->vm.s.HaltPoll.fEnabled        = false;
+    pUVM->vm.s.HaltPoll.cNsMaxCfg       = 200000;
+    pUVM->vm.s.HaltPoll.cNsStartCfg     = 10000;
+    pUVM->vm.s.HaltPoll.uGrowCfg        = 2;
+    pUVM->vm.s.HaltPoll.uShrinkCfg      = 2;
+    pUVM->vm.s.HaltPoll.uBudgetPctCfg   = 25;
+
+    /*
+     * Query overrides.
+     */
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRoot(pUVM->pVM), "/VMM/HaltPoll");
+    if (pCfg)
+    {
+        uint32_t u32;
+        bool     f;
+        if (RT_SUCCESS(CFGMR3QueryBool(pCfg, "Enabled", &f)))
+            pUVM->vm.s.HaltPoll.fEnabled = f;
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "MaxWindow", &u32)))
+            pUVM->vm.s.HaltPoll.cNsMaxCfg = RT_MIN(u32, RT_NS_1MS * 10);
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "StartWindow", &u32)))
+            pUVM->vm.s.HaltPoll.cNsStartCfg = RT_MAX(u32, 1);
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "Grow", &u32)))
+            pUVM->vm.s.HaltPoll.uGrowCfg = RT_MAX(u32, 1);
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "Shrink", &u32)))
+            pUVM->vm.s.HaltPoll.uShrinkCfg = u32;
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "BudgetPct", &u32)))
+            pUVM->vm.s.HaltPoll.uBudgetPctCfg = RT_MIN(u32, 100);
+    }
+    LogRel(("HaltPoll config: fEnabled=%RTbool cNsMax=%u cNsStart=%u uGrow=%u uShrink=%u uBudgetPct=%u\n",
+            pUVM->vm.s.HaltPoll.fEnabled, pUVM->vm.s.HaltPoll.cNsMaxCfg, pUVM->vm.s.HaltPoll.cNsStartCfg,
+            pUVM->vm.s.HaltPoll.uGrowCfg, pUVM->vm.s.HaltPoll.uShrinkCfg, pUVM->vm.s.HaltPoll.uBudgetPctCfg));
+}
+
+
+/**
+ * Gets the halt polling histogram bucket for the given interval.
+ *
+ * @returns Bucket index.
+ * @param   cNs             The interval.
+ */
+DECLINLINE(unsigned) vmR3HaltPollHistBucket(uint64_t cNs)
+{
+    uint64_t const cUs = cNs / RT_NS_1US;
+    if (!cUs)
+        return 0;
+    unsigned const iBucket = (ASMBitLastSetU32((uint32_t)RT_MIN(cUs, UINT32_MAX)) + 1) / 2;
+    return RT_MIN(iBucket, VM_HALT_POLL_HIST_BUCKETS - 1);
+}
+
+
+/**
+ * Polls the force action flags for a while before the EMT blocks.
+ *
+ * The time spent polling is limited by the window of the VCPU, the time left
+ * till the next timer event and the CPU budget.
+ *
+ * @returns true if something is pending, false if the caller should go ahead
+ *          and block.
+ * @param   pUVCpu          Pointer to the user mode VMCPU structure.
+ * @param   fMask           The VMCPU force action flags to stop at.
+ * @param   cNsLeft         The time left till the next timer event.
+ * @param   pcNsPolled      Where to add the time spent polling.
+ */
+static bool vmR3HaltPoll(PUVMCPU pUVCpu, const uint32_t fMask, uint64_t cNsLeft, uint64_t *pcNsPolled)
+{
+    PUVM    pUVM    = pUVCpu->pUVM;
+    PVM     pVM     = pUVCpu->pVM;
+    PVMCPU  pVCpu   = pUVCpu->pVCpu;
+
+    uint32_t cNsPoll = pUVCpu->vm.s.cNsHaltPollWindow;
+    if (!cNsPoll)
+        return false;
+
+    /*
+     * Stay within the budget, which is accounted per second.
+     */
+    uint64_t const u64Start = RTTimeNanoTS();
+    if (u64Start - pUVCpu->vm.s.u64HaltPollPeriodStartTS >= RT_NS_1SEC)
+    {
+        pUVCpu->vm.s.u64HaltPollPeriodStartTS = u64Start;
+        pUVCpu->vm.s.cNsHaltPolledInPeriod    = 0;
+    }
+    uint32_t const cNsBudget = pUVM->vm.s.HaltPoll.uBudgetPctCfg * (RT_NS_1SEC / 100);
+    if (pUVCpu->vm.s.cNsHaltPolledInPeriod >= cNsBudget)
+    {
+        STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollOverBudget);
+        return false;
+    }
+    cNsPoll = RT_MIN(cNsPoll, cNsBudget - pUVCpu->vm.s.cNsHaltPolledInPeriod);
+    if (cNsLeft < cNsPoll)
+        cNsPoll = (uint32_t)cNsLeft;
+
+    /*
+     * Poll.
+     */
+    bool     fPending;
+    uint64_t u64Now;
+    for (;;)
+    {
+        fPending = VM_FF_ISPENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+                || VMCPU_FF_ISPENDING(pVCpu, fMask);
+        u64Now = RTTimeNanoTS();
+        if (fPending || u64Now - u64Start >= cNsPoll)
+            break;
+        ASMNopPause();
+    }
+
+    uint64_t const cNsPolled = u64Now - u64Start;
+    pUVCpu->vm.s.cNsHaltPolledInPeriod += (uint32_t)RT_MIN(cNsPolled, RT_NS_1SEC);
+    *pcNsPolled += cNsPolled;
+    if (fPending)
+    {
+        STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPoll, cNsPolled);
+        STAM_REL_COUNTER_INC(&pUVCpu->vm.s.aStatHaltPollHist[VM_HALT_POLL_HIST_POLLED][vmR3HaltPollHistBucket(cNsPolled)]);
+    }
+    return fPending;
+}
+
+
+/**
+ * Updates the poll window and statistics at the end of a halt.
+ *
+ * The window is grown when the halt ended after blocking for a period the
+ * max window would have covered, and shrunk when it blocked for longer than
+ * that.  Halts ending while polling leave the window alone.
+ *
+ * @param   pUVCpu          Pointer to the user mode VMCPU structure.
+ * @param   cNsPolled       The time spent polling during the halt.
+ * @param   cNsBlocked      The time spent blocking during the halt.
+ */
+static void vmR3HaltPollUpdate(PUVMCPU pUVCpu, uint64_t cNsPolled, uint64_t cNsBlocked)
+{
+    if (!cNsBlocked)
+        return;
+
+    STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollBlocked, cNsBlocked);
+    STAM_REL_COUNTER_INC(&pUVCpu->vm.s.aStatHaltPollHist[VM_HALT_POLL_HIST_BLOCKED][vmR3HaltPollHistBucket(cNsBlocked)]);
+    if (cNsPolled)
+    {
+        STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollWasted, cNsPolled);
+        STAM_REL_COUNTER_INC(&pUVCpu->vm.s.aStatHaltPollHist[VM_HALT_POLL_HIST_WASTED][vmR3HaltPollHistBucket(cNsPolled)]);
+    }
+
+    PUVM           pUVM      = pUVCpu->pUVM;
+    uint64_t const cNsHalted = cNsPolled + cNsBlocked;
+    uint32_t       cNsWindow = pUVCpu->vm.s.cNsHaltPollWindow;
+    if (cNsHalted <= cNsWindow)
+        return;
+    if (cNsHalted > pUVM->vm.s.HaltPoll.cNsMaxCfg)
+    {
+        if (!cNsWindow)
+            return;
+        cNsWindow = pUVM->vm.s.HaltPoll.uShrinkCfg ? cNsWindow / pUVM->vm.s.HaltPoll.uShrinkCfg : 0;
+        if (cNsWindow < pUVM->vm.s.HaltPoll.cNsStartCfg)
+            cNsWindow = 0;
+    }
+    else
+    {
+        if (!cNsWindow)
+            cNsWindow = pUVM->vm.s.HaltPoll.cNsStartCfg;
+        else
+            cNsWindow = (uint32_t)RT_MIN((uint64_t)cNsWindow * pUVM->vm.s.HaltPoll.uGrowCfg, UINT32_MAX);
+        cNsWindow = RT_MIN(cNsWindow, pUVM->vm.s.HaltPoll.cNsMaxCfg);
+    }
+    pUVCpu->vm.s.cNsHaltPollWindow = cNsWindow;
+}
+
+
 /**
  * The old halt loop.
  */
@@ -465,6 +643,7 @@ static int vmR3HaltMethod12ReadConfigU(PUVM pUVM)
  */
 static DECLCALLBACK(int) vmR3HaltMethod1Init(PUVM pUVM)
 {
+    vmR3HaltPollReadConfigU(pUVM);
     return vmR3HaltMethod12ReadConfigU(pUVM);
 }
 
@@ -525,6 +704,9 @@ static DECLCALLBACK(int) vmR3HaltMethod1Halt(PUVMCPU pUVCpu, const uint32_t fMas
      * Halt loop.
      */
     int rc = VINF_SUCCESS;
+    bool fPoll = pUVM->vm.s.HaltPoll.fEnabled;
+    uint64_t cNsPolled  = 0;
+    uint64_t cNsBlocked = 0;
     ASMAtomicWriteBool(&pUVCpu->vm.s.fWait, true);
     unsigned cLoops = 0;
     for (;; cLoops++)
@@ -560,6 +742,15 @@ static DECLCALLBACK(int) vmR3HaltMethod1Halt(PUVMCPU pUVCpu, const uint32_t fMas
             &&  u64NanoTS >= 250000) /* 0.250 ms */
 #endif
         {
+            /* Poll for a while first (once), the timers are run again afterwards. */
+            if (fPoll)
+            {
+                fPoll = false;
+                if (vmR3HaltPoll(pUVCpu, fMask, u64NanoTS, &cNsPolled))
+                    break;
+                continue;
+            }
+
             const uint64_t Start = pUVCpu->vm.s.Halt.Method12.u64LastBlockTS = RTTimeNanoTS();
             VMMR3YieldStop(pVM);
 
@@ -574,6 +765,7 @@ static DECLCALLBACK(int) vmR3HaltMethod1Halt(PUVMCPU pUVCpu, const uint32_t fMas
             rc = RTSemEventWait(pUVCpu->vm.s.EventSemWait, cMilliSecs);
             uint64_t const cNsElapsedSchedHalt = RTTimeNanoTS() - u64StartSchedHalt;
             STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltBlock, cNsElapsedSchedHalt);
+            cNsBlocked += cNsElapsedSchedHalt;
 
             if (rc == VERR_TIMEOUT)
                 rc = VINF_SUCCESS;
@@ -613,6 +805,8 @@ static DECLCALLBACK(int) vmR3HaltMethod1Halt(PUVMCPU pUVCpu, const uint32_t fMas
     }
     //if (fSpinning) RTLogRelPrintf("spun for %RU64 ns %u loops; lag=%RU64 pct=%d\n", RTTimeNanoTS() - u64Now, cLoops, TMVirtualSyncGetLag(pVM), u32CatchUpPct);
 
+    if (pUVM->vm.s.HaltPoll.fEnabled)
+        vmR3HaltPollUpdate(pUVCpu, cNsPolled, cNsBlocked);
     ASMAtomicUoWriteBool(&pUVCpu->vm.s.fWait, false);
     return rc;
 }
@@ -652,6 +846,8 @@ static DECLCALLBACK(int) vmR3HaltGlobal1Init(PUVM pUVM)
     }
     LogRel(("HaltedGlobal1 config: cNsSpinBlockThresholdCfg=%u\n",
             pUVM->vm.s.Halt.Global1.cNsSpinBlockThresholdCfg));
+
+    vmR3HaltPollReadConfigU(pUVM);
     return VINF_SUCCESS;
 }
 
@@ -674,6 +870,9 @@ static DECLCALLBACK(int) vmR3HaltGlobal1Halt(PUVMCPU pUVCpu, const uint32_t fMas
     //uint64_t u64NowLog, u64Start;
     //u64Start = u64NowLog = RTTimeNanoTS();
     int rc = VINF_SUCCESS;
+    bool fPoll = pUVM->vm.s.HaltPoll.fEnabled;
+    uint64_t cNsPolled  = 0;
+    uint64_t cNsBlocked = 0;
     ASMAtomicWriteBool(&pUVCpu->vm.s.fWait, true);
     unsigned cLoops = 0;
     for (;; cLoops++)
@@ -704,6 +903,15 @@ static DECLCALLBACK(int) vmR3HaltGlobal1Halt(PUVMCPU pUVCpu, const uint32_t fMas
          */
         if (u64Delta >= pUVM->vm.s.Halt.Global1.cNsSpinBlockThresholdCfg)
         {
+            /* Poll for a while first (once), the timers are run again afterwards. */
+            if (fPoll)
+            {
+                fPoll = false;
+                if (vmR3HaltPoll(pUVCpu, fMask, u64Delta, &cNsPolled))
+                    break;
+                continue;
+            }
+
             VMMR3YieldStop(pVM);
             if (    VM_FF_ISPENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
                 ||  VMCPU_FF_ISPENDING(pVCpu, fMask))
@@ -715,6 +923,7 @@ static DECLCALLBACK(int) vmR3HaltGlobal1Halt(PUVMCPU pUVCpu, const uint32_t fMas
             uint64_t const u64EndSchedHalt     = RTTimeNanoTS();
             uint64_t const cNsElapsedSchedHalt = u64EndSchedHalt - u64StartSchedHalt;
             STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltBlock, cNsElapsedSchedHalt);
+            cNsBlocked += cNsElapsedSchedHalt;
 
             if (rc == VERR_INTERRUPTED)
                 rc = VINF_SUCCESS;
@@ -748,6 +957,8 @@ static DECLCALLBACK(int) vmR3HaltGlobal1Halt(PUVMCPU pUVCpu, const uint32_t fMas
     }
     //RTLogPrintf("*** %u loops %'llu;  lag=%RU64\n", cLoops, u64NowLog - u64Start, TMVirtualSyncGetLag(pVM));
 
+    if (pUVM->vm.s.HaltPoll.fEnabled)
+        vmR3HaltPollUpdate(pUVCpu, cNsPolled, cNsBlocked);
     ASMAtomicUoWriteBool(&pUVCpu->vm.s.fWait, false);
     return rc;
 }
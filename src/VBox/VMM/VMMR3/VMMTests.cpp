@@ -24,6 +24,7 @@
 #include <iprt/asm-amd64-x86.h> /* for SUPGetCpuHzFromGIP */
 #include <VBox/vmm/vmm.h>
 #include <VBox/vmm/pdmapi.h>
+#include <VBox/vmm/pdmqueue.h>
 #include <VBox/vmm/cpum.h>
 #include <VBox/dbg.h>
 #include <VBox/vmm/mm.h>
@@ -34,14 +35,52 @@
 #include <VBox/err.h>
 #include <VBox/param.h>
 #include <VBox/vmm/hwaccm.h>
+#include <VBox/vmm/iom.h>
+#include <VBox/sup.h>
 
 #include <iprt/assert.h>
 #include <iprt/asm.h>
+#include <iprt/semaphore.h>
 #include <iprt/time.h>
 #include <iprt/stream.h>
 #include <iprt/string.h>
+#include <iprt/thread.h>
 #include <iprt/x86.h>
 
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * Shared state of the PDM queue contention test.
+ */
+typedef struct VMMTSTPDMQUEUE
+{
+    /** The queue being hammered. */
+    PPDMQUEUE               pQueue;
+    /** The number of items each EMT inserts. */
+    uint32_t                cItemsPerCpu;
+    /** The number of EMTs that are still busy. */
+    uint32_t volatile       cBusy;
+    /** Released when all EMTs should start inserting. */
+    RTSEMEVENTMULTI         hEvtGo;
+    /** Signalled by the last EMT to finish. */
+    RTSEMEVENT              hEvtDone;
+    /** The sum of the time the EMTs spent inserting. */
+    uint64_t volatile       cNsTotal;
+    /** The number of times an allocation failed and we had to flush. */
+    uint32_t volatile       cFlushes;
+    /** The number of items inserted by the small queue test. */
+    uint32_t volatile       cInserted;
+} VMMTSTPDMQUEUE;
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+/** The number of items the PDM queue test consumers have seen. */
+static uint32_t volatile g_cVmmTstPdmQueueConsumed;
+
+
 static void vmmR3TestClearStack(PVMCPU pVCpu)
 {
     /* We leave the first 64 bytes of the stack alone because of strict
@@ -590,3 +629,334 @@ VMMR3DECL(int) VMMDoHwAccmTest(PVM pVM)
     return rc;
 }
 
+
+/** @callback_method_impl{FNPDMQUEUEINT} */
+static DECLCALLBACK(bool) vmmR3TestPdmQueueConsumer(PVM pVM, PPDMQUEUEITEMCORE pItem)
+{
+    NOREF(pVM); NOREF(pItem);
+    ASMAtomicIncU32(&g_cVmmTstPdmQueueConsumed);
+    return true;
+}
+
+
+/** @callback_method_impl{FNPDMQUEUEINTBATCH} */
+static DECLCALLBACK(uint32_t) vmmR3TestPdmQueueConsumerBatch(PVM pVM, PPDMQUEUEITEMCORE *papItems, uint32_t cItems)
+{
+    NOREF(pVM); NOREF(papItems);
+    ASMAtomicAddU32(&g_cVmmTstPdmQueueConsumed, cItems);
+    return cItems;
+}
+
+
+/**
+ * The producer part of the PDM queue test, executed on every EMT.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   pVM         Pointer to the VM.
+ * @param   pState      The shared test state.
+ */
+static DECLCALLBACK(int) vmmR3TestPdmQueueWorker(PVM pVM, VMMTSTPDMQUEUE *pState)
+{
+    RTSemEventMultiWait(pState->hEvtGo, RT_INDEFINITE_WAIT);
+
+    uint32_t cFlushes = 0;
+    uint64_t nsStart  = RTTimeNanoTS();
+    for (uint32_t i = 0; i < pState->cItemsPerCpu; i++)
+    {
+        PPDMQUEUEITEMCORE pItem;
+        while (!(pItem = PDMQueueAlloc(pState->pQueue)))
+        {
+            PDMR3QueueFlushAll(pVM);
+            cFlushes++;
+        }
+        PDMQueueInsert(pState->pQueue, pItem);
+    }
+    ASMAtomicAddU64(&pState->cNsTotal, RTTimeNanoTS() - nsStart);
+    ASMAtomicAddU32(&pState->cFlushes, cFlushes);
+
+    if (ASMAtomicDecU32(&pState->cBusy) == 0)
+        RTSemEventSignal(pState->hEvtDone);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Producer of the small PDM queue test, allocates and inserts as many items as
+ * it can get.
+ *
+ * @returns VINF_SUCCESS if it got at least one item, VERR_NO_MEMORY if not.
+ * @param   pState      The shared test state.
+ */
+static DECLCALLBACK(int) vmmR3TestPdmQueueSmallProducer(VMMTSTPDMQUEUE *pState)
+{
+    uint32_t          cItems = 0;
+    PPDMQUEUEITEMCORE pItem;
+    while (   cItems < pState->cItemsPerCpu
+           && (pItem = PDMQueueAlloc(pState->pQueue)) != NULL)
+    {
+        PDMQueueInsert(pState->pQueue, pItem);
+        cItems++;
+    }
+    ASMAtomicAddU32(&pState->cInserted, cItems);
+    return cItems ? VINF_SUCCESS : VERR_NO_MEMORY;
+}
+
+
+/** @callback_method_impl{FNRTTHREAD, Small PDM queue producer on the shared lane.} */
+static DECLCALLBACK(int) vmmR3TestPdmQueueSmallThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    NOREF(hThreadSelf);
+    return vmmR3TestPdmQueueSmallProducer((VMMTSTPDMQUEUE *)pvUser);
+}
+
+
+/**
+ * Checks that no lane of a small batch queue runs dry while the queue is
+ * empty, because the free items are sitting in the caches of other lanes.
+ *
+ * Every EMT and then a thread using the shared lane take turns allocating and
+ * inserting all they can get, and the queue is flushed after each turn.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pState      The shared test state.
+ * @thread  EMT(0)
+ */
+static int vmmR3TestPdmQueueSmall(PVM pVM, VMMTSTPDMQUEUE *pState)
+{
+    int rc = PDMR3QueueCreateInternalBatch(pVM, sizeof(PDMQUEUEITEMCORE), 8, 0, vmmR3TestPdmQueueConsumerBatch,
+                                           false /*fRZEnabled*/, "TstBatchSmall", &pState->pQueue);
+    AssertRCReturn(rc, rc);
+    ASMAtomicWriteU32(&g_cVmmTstPdmQueueConsumed, 0);
+    pState->cItemsPerCpu = 8;
+    pState->cInserted    = 0;
+
+    for (unsigned iRound = 0; iRound < 64 && RT_SUCCESS(rc); iRound++)
+        for (VMCPUID idCpu = 0; idCpu <= pVM->cCpus && RT_SUCCESS(rc); idCpu++)
+        {
+            if (idCpu == 0)
+                rc = vmmR3TestPdmQueueSmallProducer(pState);
+            else if (idCpu < pVM->cCpus)
+                rc = VMR3ReqCallWait(pVM, idCpu, (PFNRT)vmmR3TestPdmQueueSmallProducer, 1, pState);
+            else
+            {
+                RTTHREAD hThread;
+                rc = RTThreadCreate(&hThread, vmmR3TestPdmQueueSmallThread, pState, 0, RTTHREADTYPE_DEFAULT,
+                                    RTTHREADFLAGS_WAITABLE, "TstQueue");
+                if (RT_SUCCESS(rc))
+                {
+                    int rcThread = VERR_INTERNAL_ERROR;
+                    rc = RTThreadWait(hThread, RT_INDEFINITE_WAIT, &rcThread);
+                    if (RT_SUCCESS(rc))
+                        rc = rcThread;
+                }
+            }
+            if (RT_FAILURE(rc))
+                RTPrintf("VMM: FAILURE - producer %u got no item from the empty queue in round %u: %Rrc\n", idCpu, iRound, rc);
+            PDMR3QueueFlushAll(pVM);
+        }
+
+    if (RT_SUCCESS(rc) && g_cVmmTstPdmQueueConsumed != pState->cInserted)
+    {
+        RTPrintf("VMM: FAILURE - consumed %u items from the small queue, expected %u\n", g_cVmmTstPdmQueueConsumed, pState->cInserted);
+        rc = VERR_INTERNAL_ERROR;
+    }
+    else if (RT_SUCCESS(rc))
+        RTPrintf("VMM: small batch queue: %u items passed through %u lanes\n", pState->cInserted, pVM->cCpus + 1);
+
+    PDMR3QueueDestroy(pState->pQueue);
+    pState->pQueue = NULL;
+    return rc;
+}
+
+
+/**
+ * PDM queue contention test.
+ *
+ * All EMTs insert items into the same queue at the same time, first a
+ * classic queue and then a batch queue, and the cost per insert and the
+ * overall throughput are reported.  Run it with 16 or more virtual CPUs to
+ * see the contention.  A small batch queue is then checked for lanes running
+ * dry, see vmmR3TestPdmQueueSmall.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @thread  EMT(0)
+ */
+VMMR3DECL(int) VMMDoPdmQueueTest(PVM pVM)
+{
+    VMCPU_ASSERT_EMT(&pVM->aCpus[0]);
+    RTPrintf("VMM: PDM queue contention test, %u EMTs\n", pVM->cCpus);
+
+    VMMTSTPDMQUEUE State;
+    RT_ZERO(State);
+    State.cItemsPerCpu = 200000;
+    int rc = RTSemEventMultiCreate(&State.hEvtGo);
+    AssertRCReturn(rc, rc);
+    rc = RTSemEventCreate(&State.hEvtDone);
+    AssertRCReturnStmt(rc, RTSemEventMultiDestroy(State.hEvtGo), rc);
+
+    for (unsigned iTest = 0; iTest < 2 && RT_SUCCESS(rc); iTest++)
+    {
+        bool const fBatch = iTest == 1;
+        if (fBatch)
+            rc = PDMR3QueueCreateInternalBatch(pVM, sizeof(PDMQUEUEITEMCORE), 1024, 0, vmmR3TestPdmQueueConsumerBatch,
+                                               false /*fRZEnabled*/, "TstBatch", &State.pQueue);
+        else
+            rc = PDMR3QueueCreateInternal(pVM, sizeof(PDMQUEUEITEMCORE), 1024, 0, vmmR3TestPdmQueueConsumer,
+                                          false /*fRZEnabled*/, "TstClassic", &State.pQueue);
+        AssertRCBreak(rc);
+
+        ASMAtomicWriteU32(&g_cVmmTstPdmQueueConsumed, 0);
+        State.cBusy    = pVM->cCpus;
+        State.cNsTotal = 0;
+        State.cFlushes = 0;
+        RTSemEventMultiReset(State.hEvtGo);
+
+        for (VMCPUID idCpu = 1; idCpu < pVM->cCpus; idCpu++)
+        {
+            rc = VMR3ReqCallNoWait(pVM, idCpu, (PFNRT)vmmR3TestPdmQueueWorker, 2, pVM, &State);
+            AssertRC(rc);
+        }
+
+        uint64_t const nsStart = RTTimeNanoTS();
+        RTSemEventMultiSignal(State.hEvtGo);
+        vmmR3TestPdmQueueWorker(pVM, &State);
+        RTSemEventWait(State.hEvtDone, RT_INDEFINITE_WAIT);
+        PDMR3QueueFlushAll(pVM);
+        uint64_t const cNsElapsed = RT_MAX(RTTimeNanoTS() - nsStart, 1);
+
+        uint64_t const cItems = (uint64_t)State.cItemsPerCpu * pVM->cCpus;
+        RTPrintf("VMM: %-7s queue: %6llu ns/insert  %10llu inserts/s  %u flushes on empty queue\n",
+                 fBatch ? "batch" : "classic", State.cNsTotal / cItems, cItems * RT_NS_1SEC / cNsElapsed, State.cFlushes);
+        if (g_cVmmTstPdmQueueConsumed != cItems)
+        {
+            RTPrintf("VMM: FAILURE - consumed %u items, expected %llu\n", g_cVmmTstPdmQueueConsumed, cItems);
+            rc = VERR_INTERNAL_ERROR;
+        }
+
+        PDMR3QueueDestroy(State.pQueue);
+        State.pQueue = NULL;
+    }
+    if (RT_SUCCESS(rc))
+        rc = vmmR3TestPdmQueueSmall(pVM, &State);
+
+    RTSemEventDestroy(State.hEvtDone);
+    RTSemEventMultiDestroy(State.hEvtGo);
+    return rc;
+}
+
+
+/**
+ * Times @a cCalls ring-0 requests of one kind, completing I/O port reads
+ * in ring-3 when ring-0 defers them.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ * @param   pVCpu       The calling EMT.
+ * @param   pszWhat     What to call the measurement in the report.
+ * @param   enmOp       VMMR0_DO_NOP, VMMR0_DO_SLOW_NOP or VMMR0_DO_TEST_IO_PORT_READ.
+ * @param   u64Arg      The request argument.
+ * @param   cCalls      The number of requests to make.
+ */
+static int vmmR3TestTransition(PVM pVM, PVMCPU pVCpu, const char *pszWhat, VMMR0OPERATION enmOp, uint64_t u64Arg, uint32_t cCalls)
+{
+    uint32_t cToRing3  = 0;
+    uint64_t cTicksMin = UINT64_MAX;
+    uint64_t tsBegin   = RTTimeNanoTS();
+    uint64_t TickStart = ASMReadTSC();
+    for (uint32_t i = 0; i < cCalls; i++)
+    {
+        uint64_t TickThisStart = ASMReadTSC();
+        int rc;
+        if (enmOp == VMMR0_DO_NOP)
+            rc = SUPR3CallVMMR0Fast(pVM->pVMR0, VMMR0_DO_NOP, pVCpu->idCpu);
+        else
+            rc = SUPR3CallVMMR0Ex(pVM->pVMR0, pVCpu->idCpu, enmOp, u64Arg, NULL);
+        if (rc == VINF_IOM_R3_IOPORT_READ)
+        {
+            uint32_t u32Value;
+            rc = VBOXSTRICTRC_TODO(IOMIOPortRead(pVM, (RTIOPORT)u64Arg, &u32Value, 1));
+            cToRing3++;
+        }
+        uint64_t TickThisElapsed = ASMReadTSC() - TickThisStart;
+        if (rc != VINF_SUCCESS)
+        {
+            RTPrintf("VMM: FAILURE - %s returned %Rrc in iteration %u\n", pszWhat, rc, i);
+            return RT_FAILURE(rc) ? rc : VERR_IPE_UNEXPECTED_INFO_STATUS;
+        }
+        if (TickThisElapsed < cTicksMin)
+            cTicksMin = TickThisElapsed;
+    }
+    uint64_t cTicksElapsed = ASMReadTSC() - TickStart;
+    uint64_t Elapsed       = RTTimeNanoTS() - tsBegin;
+
+    RTPrintf("VMM: %-28s %8u calls  %8llu ns/call (%9llu ticks)  Min %9llu ticks",
+             pszWhat, cCalls, Elapsed / cCalls, cTicksElapsed / cCalls, cTicksMin);
+    if (enmOp == VMMR0_DO_TEST_IO_PORT_READ)
+        RTPrintf("  %u%% in ring-3", (uint32_t)((uint64_t)cToRing3 * 100 / cCalls));
+    RTPrintf("\n");
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Measures the cost of the ring-3 <-> ring-0 transitions.
+ *
+ * This covers the fast and slow ring-0 entry points, a ring-0 to ring-3
+ * call (VMMRZCallRing3) and I/O port reads handled in ring-0 and in ring-3.
+ * The world switch itself is profiled by VMMDoTest (raw-mode) and by the
+ * /PROF/HWACCM/CPU0/SwitchToGC and /HWACCM/CPU0/Exit/Cost statistics.
+ *
+ * @returns VBox status code.
+ * @param   pVM         Pointer to the VM.
+ */
+VMMR3DECL(int) VMMDoTransitionBenchmark(PVM pVM)
+{
+    PVMCPU pVCpu = VMMGetCpu(pVM);
+    AssertReturn(pVCpu, VERR_VM_THREAD_NOT_EMT);
+    RTPrintf("VMM: transition benchmark, TSC %llu Hz\n", SUPGetCpuHzFromGIP(g_pSUPGlobalInfoPage));
+
+    const uint32_t cCalls = 100000;
+    int rc = vmmR3TestTransition(pVM, pVCpu, "fast ioctl (NOP)", VMMR0_DO_NOP, 0, cCalls);
+    if (RT_SUCCESS(rc))
+        rc = vmmR3TestTransition(pVM, pVCpu, "slow ioctl (NOP)", VMMR0_DO_SLOW_NOP, 0, cCalls);
+
+    /*
+     * Ring-0 -> ring-3 -> ring-0.  The calls are made in one batch, so the
+     * cost of entering ring-0 is only paid once.
+     */
+    if (RT_SUCCESS(rc))
+    {
+        uint64_t tsBegin   = RTTimeNanoTS();
+        uint64_t TickStart = ASMReadTSC();
+        rc = VMMR3CallR0(pVM, VMMR0_DO_TEST_CALL_RING3, cCalls, NULL);
+        uint64_t cTicksElapsed = ASMReadTSC() - TickStart;
+        uint64_t Elapsed       = RTTimeNanoTS() - tsBegin;
+        if (RT_SUCCESS(rc))
+            RTPrintf("VMM: %-28s %8u calls  %8llu ns/call (%9llu ticks)\n",
+                     "ring-3 call (VMMRZCallRing3)", cCalls, Elapsed / cCalls, cTicksElapsed / cCalls);
+        else if (rc == VERR_NOT_SUPPORTED)
+        {
+            RTPrintf("VMM: ring-3 call: skipped, no ring-0 jump buffer\n");
+            rc = VINF_SUCCESS;
+        }
+        else
+            RTPrintf("VMM: FAILURE - ring-3 call returned %Rrc\n", rc);
+    }
+
+    /*
+     * I/O port round trips.  Port 0x61 (PIT/speaker) has ring-0 handlers,
+     * port 0x92 (PC arch, A20) is only handled in ring-3.
+     */
+    if (RT_SUCCESS(rc))
+        rc = vmmR3TestTransition(pVM, pVCpu, "I/O port 0x61 read", VMMR0_DO_TEST_IO_PORT_READ, 0x61, cCalls);
+    if (RT_SUCCESS(rc))
+        rc = vmmR3TestTransition(pVM, pVCpu, "I/O port 0x92 read", VMMR0_DO_TEST_IO_PORT_READ, 0x92, cCalls);
+
+    if (RT_SUCCESS(rc))
+        RTPrintf(HWACCMIsEnabled(pVM)
+                 ? "VMM: world switch: see /PROF/HWACCM/CPU0/SwitchToGC and /HWACCM/CPU0/Exit/Cost (HWVirtExt/ExitHistograms)\n"
+                 : "VMM: world switch: see the switcher profile of --test vmm\n");
+    return rc;
+}
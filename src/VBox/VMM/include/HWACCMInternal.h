@@ -31,6 +31,8 @@
 #include <iprt/cpuset.h>
 #include <iprt/mp.h>
 #include <iprt/avl.h>
+#include <iprt/asm.h>
+#include <iprt/asm-amd64-x86.h>
 
 #if HC_ARCH_BITS == 64 || defined(VBOX_WITH_HYBRID_32BIT_KERNEL) || defined (VBOX_WITH_64_BITS_GUESTS)
 /* Enable 64 bits guest support. */
@@ -66,6 +68,15 @@ RT_C_DECLS_BEGIN
 #define MASK_EXITREASON_STAT       0xff
 #define MASK_INJECT_IRQ_STAT       0xff
 
+/** The number of buckets in an exit cost histogram, see HWACCMEXITHIST. */
+#define HWACCM_EXIT_HIST_BUCKETS   12
+/** HWACCMCPU::uExitHistReason value indicating that no exit is being timed. */
+#define HWACCM_EXIT_HIST_NONE      UINT32_MAX
+/** The exit cost histogram slot used for AMD-V nested page faults, as
+ * SVM_EXIT_NPF does not fit within MASK_EXITREASON_STAT.  No other AMD-V exit
+ * is timed in it; SVM_EXIT_INVALID and other codes from here up are dropped. */
+#define HWACCM_EXIT_HIST_SVM_NPF   0xff
+
 /** @name Changed flags
  * These flags are used to keep track of which important registers that
  * have been changed since last they were reset.
@@ -529,6 +540,23 @@ typedef DECLCALLBACK(int) FNHWACCMSVMVMRUN(RTHCPHYS pVMCBHostPhys, RTHCPHYS pVMC
 /** Pointer to a SVM VMRun function. */
 typedef R0PTRTYPE(FNHWACCMSVMVMRUN *) PFNHWACCMSVMVMRUN;
 
+/**
+ * Exit cost histogram for one exit reason.
+ *
+ * The cost of an exit is the number of TSC ticks spent in ring-0 from reading
+ * the exit reason until the guest is resumed or we return to ring-3.
+ */
+typedef struct HWACCMEXITHIST
+{
+    /** The total number of ticks (for the average). */
+    STAMCOUNTER             cTicks;
+    /** Power of two buckets; the first covers 0-1K ticks, the last everything
+     * from 1M ticks and up. */
+    STAMCOUNTER             aBuckets[HWACCM_EXIT_HIST_BUCKETS];
+} HWACCMEXITHIST;
+/** Pointer to an exit cost histogram. */
+typedef HWACCMEXITHIST *PHWACCMEXITHIST;
+
 /**
  * HWACCM VMCPU Instance data.
  */
@@ -860,6 +888,16 @@ typedef struct HWACCMCPU
     R3PTRTYPE(PSTAMCOUNTER) paStatInjectedIrqs;
     R0PTRTYPE(PSTAMCOUNTER) paStatInjectedIrqsR0;
 #endif
+
+    /** Exit cost histograms, MAX_EXITREASON_STAT entries indexed by the masked
+     * exit reason.  NULL unless HWVirtExt/ExitHistograms is enabled. */
+    R3PTRTYPE(PHWACCMEXITHIST) paExitHist;
+    R0PTRTYPE(PHWACCMEXITHIST) paExitHistR0;
+    /** The TSC taken when the exit being timed was read. */
+    uint64_t                u64ExitHistTsc;
+    /** The masked reason of the exit being timed, HWACCM_EXIT_HIST_NONE if none. */
+    uint32_t                uExitHistReason;
+    uint32_t                u32Alignment3;
 } HWACCMCPU;
 /** Pointer to HWACCM VM instance data. */
 typedef HWACCMCPU *PHWACCMCPU;
@@ -879,6 +917,40 @@ VMMR0DECL(void) HWACCMR0DumpDescriptor(PCX86DESCHC pDesc, RTSEL Sel, const char
 # define HWACCMR0DumpDescriptor(a, b, c)    do { } while (0)
 #endif
 
+/**
+ * Starts timing an exit for the exit cost histograms.
+ *
+ * @param   pHwCpu          The HWACCM per-VCPU data.
+ * @param   uExitReason     The exit reason (VMX) or exit code (SVM).
+ */
+DECLINLINE(void) hwaccmR0ExitHistStart(PHWACCMCPU pHwCpu, uint64_t uExitReason)
+{
+    if (pHwCpu->paExitHistR0)
+    {
+        pHwCpu->uExitHistReason = (uint32_t)uExitReason & MASK_EXITREASON_STAT;
+        pHwCpu->u64ExitHistTsc  = ASMReadTSC();
+    }
+}
+
+/**
+ * Stops timing the current exit, if any, and adds it to the histograms.
+ *
+ * @param   pHwCpu          The HWACCM per-VCPU data.
+ */
+DECLINLINE(void) hwaccmR0ExitHistStop(PHWACCMCPU pHwCpu)
+{
+    uint32_t const uReason = pHwCpu->uExitHistReason;
+    if (uReason != HWACCM_EXIT_HIST_NONE)
+    {
+        uint64_t const  cTicks  = ASMReadTSC() - pHwCpu->u64ExitHistTsc;
+        unsigned        iBucket = ASMBitLastSetU32((uint32_t)RT_MIN(cTicks >> 10, UINT32_MAX));
+        PHWACCMEXITHIST pHist   = &pHwCpu->paExitHistR0[uReason];
+        STAM_REL_COUNTER_ADD(&pHist->cTicks, cTicks);
+        STAM_REL_COUNTER_INC(&pHist->aBuckets[RT_MIN(iBucket, HWACCM_EXIT_HIST_BUCKETS - 1)]);
+        pHwCpu->uExitHistReason = HWACCM_EXIT_HIST_NONE;
+    }
+}
+
 # ifdef VBOX_WITH_KERNEL_USING_XMM
 DECLASM(int)   hwaccmR0VMXStartVMWrapXMM(RTHCUINT fResume, PCPUMCTX pCtx, PVMCSCACHE pCache, PVM pVM, PVMCPU pVCpu, PFNHWACCMVMXSTARTVM pfnStartVM);
 DECLASM(int)   hwaccmR0SVMRunWrapXMM(RTHCPHYS pVMCBHostPhys, RTHCPHYS pVMCBPhys, PCPUMCTX pCtx, PVM pVM, PVMCPU pVCpu, PFNHWACCMSVMVMRUN pfnVMRun);
@@ -29,6 +29,7 @@
 #endif /* VBOX_WITH_NETSHAPER */
 #include <VBox/vmm/pdmblkcache.h>
 #include <VBox/vmm/pdmcommon.h>
+#include <VBox/sup.h>
 #include <iprt/assert.h>
 #include <iprt/critsect.h>
 #ifdef IN_RING3
@@ -280,8 +281,15 @@ typedef struct PDMCRITSECTINT
     /** Set if the critical section is used by a timer or similar.
      * See PDMR3DevGetCritSect.  */
     bool                            fUsedByTimerOrSimilar;
-    /** Alignment padding. */
-    bool                            afPadding[2];
+    /** The adaptive spin estimate, in 1/8 loops (PDMCRITSECT_SPIN_EST_SHIFT).
+     * This follows the number of loops recent contended enters spun before
+     * getting the section, see pdmCritSectCalcSpinEst. */
+    uint16_t volatile               cSpinEst;
+    /** Index into PDM::paCritSectProfR3 and friends + 1, 0 if the section
+     * isn't profiled. */
+    uint8_t                         iProf;
+    /** Explicit alignment padding. */
+    uint8_t                         abPadding[3];
     /** Event semaphore that is scheduled to be signaled upon leaving the
      * critical section. This is Ring-3 only of course. */
     RTSEMEVENT                      EventToSignal;
@@ -304,6 +312,173 @@ typedef PDMCRITSECTINT *PPDMCRITSECTINT;
  * PDMCritSectIsOwner and PDMCritSectIsOwned optimizations. */
 #define PDMCRITSECT_FLAGS_PENDING_UNLOCK    RT_BIT_32(17)
 
+/** The fixed point shift of PDMCRITSECTINT::cSpinEst.  This is also the
+ * weight of a new sample, 1/8. */
+#define PDMCRITSECT_SPIN_EST_SHIFT          3
+/** The number of buckets in the wait and hold time histograms.  These are
+ * powers of four starting at 256 TSC ticks: <256, <1K, <4K, ..., <1M and
+ * the rest. */
+#define PDMCRITSECT_HIST_BUCKETS            8
+/** The number of contended call sites tracked for each section. */
+#define PDMCRITSECT_MAX_CALLERS             8
+
+/** @name PDMCRITSECTPROF caller contexts.
+ * @{ */
+#define PDMCRITSECT_CTX_R3                  0
+#define PDMCRITSECT_CTX_R0                  1
+#define PDMCRITSECT_CTX_RC                  2
+/** @} */
+
+/**
+ * Contention profile of a PDM critical section.
+ *
+ * These live in a table on the hyper heap (PDM::paCritSectProfR3 and
+ * friends), which is only allocated when PDM/CritSectProfiling is set.
+ */
+typedef struct PDMCRITSECTPROF
+{
+    /** The TSC when the current owner got the section. */
+    uint64_t volatile               u64TscEntered;
+    /** Set while the entry belongs to a critical section. */
+    bool                            fInUse;
+    /** Explicit alignment padding. */
+    bool                            afPadding[7];
+    /** Contended enters that got the section while spinning. */
+    STAMCOUNTER                     StatSpinHits;
+    /** Contended enters that gave up spinning and blocked or went to ring-3. */
+    STAMCOUNTER                     StatSpinMisses;
+    /** Wait time histogram of the contended enters, TSC ticks. */
+    STAMCOUNTER                     aStatWaitHist[PDMCRITSECT_HIST_BUCKETS];
+    /** Hold time histogram, TSC ticks. */
+    STAMCOUNTER                     aStatHoldHist[PDMCRITSECT_HIST_BUCKETS];
+    /** The most contended call sites.  This is the space saving top-k
+     * algorithm, a new call site replaces the one with the fewest hits and
+     * inherits its count.  Updated without any locking, so it's approximate. */
+    struct
+    {
+        /** The return address of the enter call. */
+        uint64_t volatile           uCaller;
+        /** Contended enters from this call site. */
+        uint32_t volatile           cHits;
+        /** The context of uCaller, PDMCRITSECT_CTX_XXX. */
+        uint32_t volatile           uCtx;
+    }                               aCallers[PDMCRITSECT_MAX_CALLERS];
+} PDMCRITSECTPROF;
+/** Pointer to a critical section contention profile. */
+typedef PDMCRITSECTPROF *PPDMCRITSECTPROF;
+
+
+/**
+ * Calculates the new adaptive spin estimate of a critical section.
+ *
+ * A contended enter that got the section after @a cSpins loops moves the
+ * estimate 1/8 of the way towards that, one that gave up decays it by 1/8 and
+ * one eighth of a loop.  Keeping the estimate in eighths of a loop with the
+ * same 1/8 weight makes the average exact, so it settles on short spins
+ * instead of rounding them away.
+ *
+ * @returns The new estimate, in 1/8 loops.
+ * @param   cSpinEst            The current estimate, in 1/8 loops.
+ * @param   cSpins              The number of loops it took, UINT32_MAX if we
+ *                              gave up.
+ */
+DECLINLINE(uint16_t) pdmCritSectCalcSpinEst(uint16_t cSpinEst, uint32_t cSpins)
+{
+    uint32_t cNew = cSpinEst - (cSpinEst >> PDMCRITSECT_SPIN_EST_SHIFT);
+    if (cSpins != UINT32_MAX)
+        cNew += RT_MIN(cSpins, UINT16_MAX >> PDMCRITSECT_SPIN_EST_SHIFT);
+    else if (cNew > 0)
+        cNew--;
+    return (uint16_t)RT_MIN(cNew, UINT16_MAX);
+}
+
+
+/**
+ * Private read/write critical section data.
+ */
+typedef struct PDMCRITSECTRWINT
+{
+    /** Magic value (PDMCRITSECTRW_MAGIC). */
+    uint32_t volatile               u32Magic;
+    /** Indicates whether hEvtRead needs resetting. */
+    bool volatile                   fNeedReset;
+    /** Explicit alignment padding. */
+    bool                            afPadding[3];
+    /** The state variable, see the PDMCRITSECTRW_XXX_SHIFT and _MASK
+     * definitions below. */
+    uint64_t volatile               u64State;
+    /** The write owner (ring-3 native thread handle). */
+    RTNATIVETHREAD volatile         hNativeWriter;
+    /** The number of reads made by the current writer. */
+    uint32_t volatile               cWriterReads;
+    /** The number of recursions made by the current writer.  (The initial
+     * grabbing of the lock counts as the first one.) */
+    uint32_t volatile               cWriteRecursions;
+    /** What the writer threads are blocking on. */
+    SUPSEMEVENT                     hEvtWrite;
+    /** What the read threads are blocking on when waiting for the writer to
+     * finish. */
+    SUPSEMEVENTMULTI                hEvtRead;
+    /** Pointer to the next read/write critical section.
+     * This chain is used for relocating pVMRC and device cleanup. */
+    R3PTRTYPE(struct PDMCRITSECTRWINT *) pNext;
+    /** Owner identifier.
+     * This is pDevIns if the owner is a device. Similarly for a driver or service.
+     * PDMR3CritSectRwInit() sets this to point to the critsect itself. */
+    RTR3PTR                         pvKey;
+    /** Pointer to the VM - R3Ptr. */
+    PVMR3                           pVMR3;
+    /** Pointer to the VM - R0Ptr. */
+    PVMR0                           pVMR0;
+    /** Pointer to the VM - GCPtr. */
+    PVMRC                           pVMRC;
+    /** Alignment padding. */
+    uint32_t                        u32Padding;
+    /** The lock name. */
+    R3PTRTYPE(const char *)         pszName;
+    /** R0/RC shared enters that had to return rcBusy or call ring-3. */
+    STAMCOUNTER                     StatContentionRZEnterShared;
+    /** R0/RC shared leaves that had to be queued for ring-3. */
+    STAMCOUNTER                     StatContentionRZLeaveShared;
+    /** R3 shared enters that had to wait. */
+    STAMCOUNTER                     StatContentionR3EnterShared;
+    /** R0/RC exclusive enters that had to return rcBusy or call ring-3. */
+    STAMCOUNTER                     StatContentionRZEnterExcl;
+    /** R0/RC exclusive leaves that had to be queued for ring-3. */
+    STAMCOUNTER                     StatContentionRZLeaveExcl;
+    /** R3 exclusive enters that had to wait. */
+    STAMCOUNTER                     StatContentionR3EnterExcl;
+    /** Profiling the time the section is owned exclusively. */
+    STAMPROFILEADV                  StatWriteLocked;
+} PDMCRITSECTRWINT;
+AssertCompileMemberAlignment(PDMCRITSECTRWINT, u64State, 8);
+AssertCompileMemberAlignment(PDMCRITSECTRWINT, StatContentionRZEnterShared, 8);
+/** Pointer to private read/write critical section data. */
+typedef PDMCRITSECTRWINT *PPDMCRITSECTRWINT;
+
+/** PDMCRITSECTRWINT::u32Magic value. (Jan Garbarek) */
+#define PDMCRITSECTRW_MAGIC                 UINT32_C(0x19470304)
+
+/** @name PDMCRITSECTRWINT::u64State layout.
+ * The state is a direction bit, the number of readers and writers, and the
+ * number of readers waiting for the direction to change to read.  Readers
+ * keep coming in while the direction is read, writers are counted as soon
+ * as they show up and take turns owning the section.
+ * @{ */
+#define PDMCRITSECTRW_CNT_BITS              15
+#define PDMCRITSECTRW_CNT_MASK              UINT64_C(0x00007fff)
+#define PDMCRITSECTRW_CNT_RD_SHIFT          0
+#define PDMCRITSECTRW_CNT_RD_MASK           (PDMCRITSECTRW_CNT_MASK << PDMCRITSECTRW_CNT_RD_SHIFT)
+#define PDMCRITSECTRW_CNT_WR_SHIFT          16
+#define PDMCRITSECTRW_CNT_WR_MASK           (PDMCRITSECTRW_CNT_MASK << PDMCRITSECTRW_CNT_WR_SHIFT)
+#define PDMCRITSECTRW_DIR_SHIFT             31
+#define PDMCRITSECTRW_DIR_MASK              RT_BIT_64(PDMCRITSECTRW_DIR_SHIFT)
+#define PDMCRITSECTRW_DIR_READ              UINT64_C(0)
+#define PDMCRITSECTRW_DIR_WRITE             UINT64_C(1)
+#define PDMCRITSECTRW_WAIT_CNT_RD_SHIFT     32
+#define PDMCRITSECTRW_WAIT_CNT_RD_MASK      (PDMCRITSECTRW_CNT_MASK << PDMCRITSECTRW_WAIT_CNT_RD_SHIFT)
+/** @} */
+
 
 /**
  * The usual device/driver/internal/external stuff.
@@ -351,6 +526,7 @@ typedef struct PDMTHREADINT
 #define PDMUSBINSINT_DECLARED
 #define PDMDRVINSINT_DECLARED
 #define PDMCRITSECTINT_DECLARED
+#define PDMCRITSECTRWINT_DECLARED
 #define PDMTHREADINT_DECLARED
 #ifdef ___VBox_pdm_h
 # error "Invalid header PDM order. Include PDMInternal.h before VBox/vmm/pdm.h!"
@@ -711,6 +887,11 @@ typedef PDMMOD *PPDMMOD;
 
 /** Extra space in the free array. */
 #define PDMQUEUE_FREE_SLACK         16
+/** The number of free items each lane of a batch queue caches at most, see
+ * PDMQUEUE::cLaneCacheMax. */
+#define PDMQUEUE_LANE_CACHE_SIZE    32
+/** The space reserved for each PDMQUEUELANE, keeping the lanes apart. */
+#define PDMQUEUE_LANE_STRIDE        128
 
 /**
  * Queue type.
@@ -724,9 +905,46 @@ typedef enum PDMQUEUETYPE
     /** Internal consumer. */
     PDMQUEUETYPE_INTERNAL,
     /** External consumer. */
-    PDMQUEUETYPE_EXTERNAL
+    PDMQUEUETYPE_EXTERNAL,
+    /** Device consumer taking batches. */
+    PDMQUEUETYPE_DEV_BATCH,
+    /** Internal consumer taking batches. */
+    PDMQUEUETYPE_INTERNAL_BATCH
 } PDMQUEUETYPE;
 
+/**
+ * PDM batch queue lane.
+ *
+ * A batch queue has one of these for each virtual CPU and a shared one for
+ * other threads, so producers on different CPUs don't touch the same cache
+ * lines.  They are located PDMQUEUE::offLanes bytes into the queue and
+ * PDMQUEUE_LANE_STRIDE apart, see PDMQUEUE_LANE.
+ */
+typedef struct PDMQUEUELANE
+{
+    /** LIFO of pending items - R3. */
+    R3PTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingR3;
+    /** LIFO of pending items - R0. */
+    R0PTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingR0;
+    /** LIFO of pending items - RC. */
+    RCPTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingRC;
+    /** Free item cache index the flushing EMT puts items back at. */
+    uint32_t volatile               iCacheHead;
+    /** Free item cache index the lane owner allocates from. */
+    uint32_t volatile               iCacheTail;
+    uint32_t                        u32Alignment;
+    /** Stat: PDMQueueInsert calls. */
+    STAMCOUNTER                     StatInsert;
+    /** Stat: PDMQueueAlloc calls that had to use the shared free array. */
+    STAMCOUNTER                     StatAllocShared;
+    /** Free item cache, item indexes.  Single producer (the flushing EMT),
+     * single consumer (the lane owner).  Not used by the shared lane. */
+    uint16_t volatile               aiCache[PDMQUEUE_LANE_CACHE_SIZE];
+} PDMQUEUELANE;
+AssertCompile(sizeof(PDMQUEUELANE) <= PDMQUEUE_LANE_STRIDE);
+/** Pointer to a PDM batch queue lane. */
+typedef PDMQUEUELANE *PPDMQUEUELANE;
+
 /** Pointer to a PDM Queue. */
 typedef struct PDMQUEUE *PPDMQUEUE;
 
@@ -770,6 +988,20 @@ typedef struct PDMQUEUE
             /** Pointer to user argument. */
             R3PTRTYPE(void *)           pvUser;
         } Ext;
+        /** PDMQUEUETYPE_DEV_BATCH */
+        struct
+        {
+            /** Pointer to consumer function. */
+            R3PTRTYPE(PFNPDMQUEUEDEVBATCH) pfnCallback;
+            /** Pointer to the device instance owning the queue. */
+            R3PTRTYPE(PPDMDEVINS)       pDevIns;
+        } DevBatch;
+        /** PDMQUEUETYPE_INTERNAL_BATCH */
+        struct
+        {
+            /** Pointer to consumer function. */
+            R3PTRTYPE(PFNPDMQUEUEINTBATCH) pfnCallback;
+        } IntBatch;
     } u;
     /** Queue type. */
     PDMQUEUETYPE                    enmType;
@@ -808,6 +1040,29 @@ typedef struct PDMQUEUE
 #if HC_ARCH_BITS == 32
     RTR3PTR                         Alignment1;
 #endif
+
+    /** The number of lanes of a batch queue (cCpus + 1), 0 if not a batch
+     * queue.  Batch queues don't use the pPending lists above. */
+    uint32_t                        cLanes;
+    /** Offset of the first lane relative to the queue. */
+    uint32_t                        offLanes;
+    /** Offset of the first item relative to the queue. */
+    uint32_t                        offItems;
+    /** The number of free items each lane may cache, at most
+     * PDMQUEUE_LANE_CACHE_SIZE.  Kept at cItems / cLanes so the caches of the
+     * other lanes can never hold all the free items of a small queue. */
+    uint32_t                        cLaneCacheMax;
+    /** Items the batch consumer didn't take last time, FIFO - R3 only. */
+    R3PTRTYPE(PPDMQUEUEITEMCORE)    pBatchLeftoversR3;
+    /** The batch handed to the consumer (cItems entries) - R3 only. */
+    R3PTRTYPE(PPDMQUEUEITEMCORE *)  papBatchItemsR3;
+    /** The lanes of the items in papBatchItemsR3 - R3 only. */
+    R3PTRTYPE(uint8_t *)            pabBatchLanesR3;
+#if HC_ARCH_BITS == 32
+    RTR3PTR                         Alignment3;
+#endif
+    /** Stat: Items handed to the batch consumer. */
+    STAMCOUNTER                     StatBatchItems;
     /** Stat: Times PDMQueueAlloc fails. */
     STAMCOUNTER                     StatAllocFailures;
     /** Stat: PDMQueueInsert calls. */
@@ -839,6 +1094,13 @@ typedef struct PDMQUEUE
     }                               aFreeItems[1];
 } PDMQUEUE;
 
+/** Gets lane @a iLane of a batch queue. */
+#define PDMQUEUE_LANE(pQueue, iLane) \
+    ((PPDMQUEUELANE)((uint8_t *)(pQueue) + (pQueue)->offLanes + (iLane) * PDMQUEUE_LANE_STRIDE))
+/** Gets item number @a iItem of a queue. */
+#define PDMQUEUE_ITEM(pQueue, iItem) \
+    ((PPDMQUEUEITEMCORE)((uint8_t *)(pQueue) + (pQueue)->offItems + (iItem) * (pQueue)->cbItem))
+
 /** @name PDM::fQueueFlushing
  * @{ */
 /** Used to make sure only one EMT will flush the queues.
@@ -955,6 +1217,20 @@ typedef struct PDMCPU
     /** Critical sections queued in RC/R0 because of contention preventing leave to complete. (R3 Ptrs)
      * We will return to Ring-3 ASAP, so this queue doesn't have to be very long. */
     R3PTRTYPE(PPDMCRITSECT)         apQueuedCritSectsLeaves[8];
+
+    /** The number of entries in the apQueuedCritSectRwShrdLeaves table that's
+     *  currently in use. */
+    uint32_t                        cQueuedCritSectRwShrdLeaves;
+    /** The number of entries in the apQueuedCritSectRwExclLeaves table that's
+     *  currently in use. */
+    uint32_t                        cQueuedCritSectRwExclLeaves;
+    /** Read/write critical sections queued in RC/R0 because the shared leave
+     * had to signal a writer. (R3 Ptrs) */
+    R3PTRTYPE(PPDMCRITSECTRW)       apQueuedCritSectRwShrdLeaves[8];
+    /** Read/write critical sections queued in RC/R0 because the exclusive leave
+     * had to signal waiters.  The section is already released, only the writer
+     * count and the signalling remain. (R3 Ptrs) */
+    R3PTRTYPE(PPDMCRITSECTRW)       apQueuedCritSectRwExclLeaves[8];
 } PDMCPU;
 
 
@@ -1042,6 +1318,24 @@ typedef struct PDM
     RTGCPHYS                        GCPhysVMMDevHeap;
     /** @} */
 
+    /** @name   Critical section profiling, see PDMCRITSECTPROF.
+     * @{ */
+    /** The profile table - R3 Ptr. */
+    R3PTRTYPE(PPDMCRITSECTPROF)     paCritSectProfR3;
+    /** The profile table - R0 Ptr. */
+    R0PTRTYPE(PPDMCRITSECTPROF)     paCritSectProfR0;
+    /** The profile table - RC Ptr. */
+    RCPTRTYPE(PPDMCRITSECTPROF)     paCritSectProfRC;
+    /** The number of table entries handed out so far, some of which may
+     * have been freed again (PDMCRITSECTPROF::fInUse). */
+    uint32_t                        cCritSectProf;
+    /** The size of the table (PDM/CritSectProfiling), 0 if not profiling. */
+    uint32_t                        cCritSectProfMax;
+    /** Set when PDM/CritSectProfiling has been queried. */
+    bool                            fCritSectProfQueried;
+    bool                            afAlignment3[3];
+    /** @} */
+
     /** Number of times a critical section leave request needed to be queued for ring-3 execution. */
     STAMCOUNTER                     StatQueuedCritSectLeaves;
 } PDM;
@@ -1073,6 +1367,8 @@ typedef struct PDMUSERPERVM
     PPDMMOD                         pModules;
     /** List of initialized critical sections. (LIFO) */
     R3PTRTYPE(PPDMCRITSECTINT)      pCritSects;
+    /** List of initialized read/write critical sections. (LIFO) */
+    R3PTRTYPE(PPDMCRITSECTRWINT)    pRwCritSects;
     /** Head of the PDM Thread list. (singly linked) */
     R3PTRTYPE(PPDMTHREAD)           pThreads;
     /** Tail of the PDM Thread list. (singly linked) */
@@ -1162,6 +1458,8 @@ int         pdmR3CritSectInitDeviceAuto(PVM pVM, PPDMDEVINS pDevIns, PPDMCRITSEC
 int         pdmR3CritSectDeleteDevice(PVM pVM, PPDMDEVINS pDevIns);
 int         pdmR3CritSectInitDriver(PVM pVM, PPDMDRVINS pDrvIns, PPDMCRITSECT pCritSect, RT_SRC_POS_DECL, const char *pszNameFmt, ...);
 int         pdmR3CritSectDeleteDriver(PVM pVM, PPDMDRVINS pDrvIns);
+int         pdmR3CritSectRwInitDevice(PVM pVM, PPDMDEVINS pDevIns, PPDMCRITSECTRW pCritSect, RT_SRC_POS_DECL,
+                                      const char *pszNameFmt, va_list va);
 
 int         pdmR3DevInit(PVM pVM);
 PPDMDEV     pdmR3DevLookup(PVM pVM, const char *pszName);
@@ -1223,6 +1521,10 @@ void        pdmLock(PVM pVM);
 int         pdmLockEx(PVM pVM, int rc);
 void        pdmUnlock(PVM pVM);
 
+#if defined(IN_RING3) || defined(IN_RING0)
+void        pdmCritSectRwLeaveExclQueued(PPDMCRITSECTRW pThis);
+#endif
+
 /** @} */
 
 RT_C_DECLS_END
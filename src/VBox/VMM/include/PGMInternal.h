@@ -127,6 +127,17 @@
  */
 #define PGMPOOL_CFG_MAX_GROW            (_256K >> PAGE_SHIFT)
 
+/** @name Live save auto-convergence parameters.
+ * @{ */
+/** The first pass we consider throttling in.  The speed estimate isn't reliable
+ * until a few passes after it's been reset (pass 7). */
+#define PGM_LIVE_THROTTLE_FIRST_PASS    10
+/** How much to lower the CPU execution cap by each time (percentage points). */
+#define PGM_LIVE_THROTTLE_STEP          10
+/** The lowest CPU execution cap we will throttle the vCPUs down to. */
+#define PGM_LIVE_THROTTLE_MIN           10
+/** @} */
+
 /** @def VBOX_STRICT_PGM_HANDLER_VIRTUAL
  * Enables some extra assertions for virtual handlers (mainly phys2virt related).
  */
@@ -3035,8 +3046,15 @@ typedef struct PGM
     bool                            fNoMorePhysWrites;
     /** Set if PCI passthrough is enabled. */
     bool                            fPciPassthrough;
-    /** Alignment padding that makes the next member start on a 8 byte boundary. */
-    bool                            afAlignment1[2];
+    /** @cfgm{SaveDedup, boolean, true}
+     * Whether to save RAM pages identical to ones already saved in the final
+     * pass as references to those. */
+    bool                            fSaveDedup;
+    /** @cfgm{LiveSaveAutoConverge, boolean, false}
+     * Whether to throttle the vCPUs (using the CPU execution cap) when a live
+     * save or teleportation doesn't converge because the guest dirties memory
+     * faster than it can be saved. */
+    bool                            fLiveSaveAutoConverge;
 
     /** Indicates that PGMR3FinalizeMappings has been called and that further
      * PGMR3MapIntermediate calls will be rejected. */
@@ -3330,9 +3348,73 @@ typedef struct PGM
         uint64_t                    uSaveStartNS;
         /** Pages per second (for statistics). */
         uint32_t                    cPagesPerSecond;
-        uint32_t                    cAlignment;
+        /** Pages dirtied per second, measured over the last pass (for statistics
+         * and auto-convergence). */
+        uint32_t                    cDirtyPagesPerSecond;
+        /** The number of pages still to be saved (for statistics). */
+        uint32_t                    cPagesRemaining;
+        /** The estimated downtime in milliseconds if we stopped now (for
+         * statistics and auto-convergence). */
+        uint32_t                    cMsEstDowntime;
+        /** The nanosecond timestamp of the previous vote. */
+        uint64_t                    uLastVoteNS;
+        /** cSavedPages at the previous vote. */
+        uint64_t                    cSavedPagesLastVote;
+        /** The total number of dirty pages at the previous vote. */
+        uint32_t                    cDirtyPagesLastVote;
+        /** The CPU execution cap auto-convergence has applied, 0 if not
+         * throttling. */
+        uint32_t                    uThrottleCap;
+        /** The CPU execution cap to restore when done throttling. */
+        uint32_t                    uOrgCpuExecutionCap;
     } LiveSave;
 
+    /** The post-copy teleportation state, NULL if not active. */
+    R3PTRTYPE(struct PGMPOSTCOPY *) pPostCopyR3;
+    /** The page fusion scanner timer, NULL if not scanning. */
+    PTMTIMERR3                      pPageFusionTimerR3;
+    /** Where the next page fusion scan starts. */
+    RTGCPHYS                        GCPhysPageFusionCursor;
+    /** @cfgm{PGM/PageFusionInterval, uint32_t, 100}
+     * The number of milliseconds between two page fusion scans. */
+    uint32_t                        cMsPageFusionInterval;
+    /** @cfgm{PGM/PageFusionPages, uint32_t, 4096}
+     * The max number of pages to look at per page fusion scan. */
+    uint32_t                        cPageFusionPages;
+    /** The large page promotion timer, NULL if not promoting. */
+    PTMTIMERR3                      pLargePageTimerR3;
+    /** Where the next large page promotion pass starts. */
+    RTGCPHYS                        GCPhysLargePageCursor;
+    /** @cfgm{PGM/LargePagePromotionInterval, uint32_t, 1000}
+     * The number of milliseconds between two large page promotion passes. */
+    uint32_t                        cMsLargePageInterval;
+    /** @cfgm{PGM/LargePagePromotionMax, uint32_t, 8}
+     * The max number of 2 MB ranges to promote per pass.  All EMTs are stopped
+     * while the pages are copied. */
+    uint32_t                        cLargePagePromoteMax;
+    /** The number of promotion passes in a row that couldn't get a large page,
+     * the interval doubles with each up to PGM_LARGE_PAGE_PROMOTE_MAX_BACKOFF_SHIFT. */
+    uint32_t                        cLargePagePromoteFailures;
+    /** Incremented whenever all of RAM gets write monitored for somebody else
+     * than the working set estimator (PGMR3PhysWriteProtectRAM, live save), so
+     * it can tell whether the monitored pages are still its own. */
+    uint32_t                        uWriteMonitorGen;
+    /** The working set estimator state, NULL if disabled.
+     * See @ref pg_pgm_workingset. */
+    R3PTRTYPE(struct PGMWORKINGSET *) pWorkingSetR3;
+
+    /** @name Free page reporting, see PGMR3PhysReportFreePages.
+     * @{ */
+    /** The number of pages freed by the last report. */
+    uint64_t volatile               cFreePageReportPages;
+    /** Set while a report is being processed asynchronously. */
+    bool volatile                   fFreePageReportPending;
+    /** Padding. */
+    bool                            afAlignment6[3];
+    /** The status of the last report processed asynchronously. */
+    int32_t volatile                rcFreePageReport;
+    /** @} */
+
     /** @name   Error injection.
      * @{ */
     /** Inject handy page allocation errors pretending we're completely out of
@@ -3367,8 +3449,15 @@ typedef struct PGM
     STAMCOUNTER                     StatLargePageReused;    /**< The number of large pages we've reused.*/
     STAMCOUNTER                     StatLargePageRefused;   /**< The number of times we couldn't use a large page.*/
     STAMCOUNTER                     StatLargePageRecheck;   /**< The number of times we rechecked a disabled large page.*/
+    STAMCOUNTER                     StatLargePagePromoted;  /**< The number of 2 MB ranges promoted to large pages by the background pass.*/
+    STAMCOUNTER                     StatLargePageDemoted;   /**< The number of large pages demoted to 4 KB pages.*/
+    STAMCOUNTER                     StatFreePageReportPages; /**< The number of pages freed by guest free page reports.*/
+    STAMCOUNTER                     StatSaveDupPages;       /**< The number of RAM pages saved as references to identical pages.*/
 
     STAMPROFILE                     StatShModCheck;         /**< Profiles shared module checks. */
+    STAMPROFILE                     StatPageFusionScan;     /**< Profiles page fusion scans. */
+    STAMPROFILE                     StatLargePagePromote;   /**< Profiles the large page promotion passes. */
+    STAMPROFILE                     StatFreePageReport;     /**< Profiles the processing of guest free page reports. */
     /** @} */
 
 #ifdef VBOX_WITH_STATISTICS
@@ -3921,10 +4010,14 @@ void            pgmHandlerVirtualDumpPhysPages(PVM pVM);
 #endif
 DECLCALLBACK(void) pgmR3InfoHandlers(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 int             pgmR3InitSavedState(PVM pVM, uint64_t cbRam);
+int             pgmR3PostCopyAddPage(PVM pVM, bool fSource, RTGCPHYS GCPhys);
+bool            pgmR3PostCopyIsSaving(PVM pVM);
+void            pgmR3PostCopyDestroy(PVM pVM);
 
 int             pgmPhysAllocPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys);
 int             pgmPhysAllocLargePage(PVM pVM, RTGCPHYS GCPhys);
 int             pgmPhysRecheckLargePage(PVM pVM, RTGCPHYS GCPhys, PPGMPAGE pLargePage);
+void            pgmPhysDemoteLargePage(PVM pVM, RTGCPHYS GCPhys, bool *pfFlushTLBs);
 int             pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys);
 int             pgmPhysPageLoadIntoTlbWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys);
 void            pgmPhysPageMakeWriteMonitoredWritable(PVM pVM, PPGMPAGE pPage);
@@ -3958,8 +4051,12 @@ int             pgmR3PhysRamReset(PVM pVM);
 int             pgmR3PhysRomReset(PVM pVM);
 int             pgmR3PhysChunkMap(PVM pVM, uint32_t idChunk, PPPGMCHUNKR3MAP ppChunk);
 int             pgmR3PhysRamTerm(PVM pVM);
+int             pgmR3PhysLargePagePromoteInit(PVM pVM);
 void            pgmR3PhysRomTerm(PVM pVM);
 void            pgmR3PhysAssertSharedPageChecksums(PVM pVM);
+int             pgmR3PageFusionInit(PVM pVM);
+int             pgmR3WorkingSetInit(PVM pVM);
+void            pgmR3WorkingSetAbort(PVM pVM);
 
 int             pgmR3PoolInit(PVM pVM);
 void            pgmR3PoolRelocate(PVM pVM);
@@ -3969,6 +4066,45 @@ void            pgmR3PoolClearAll(PVM pVM, bool fFlushRemTlb);
 DECLCALLBACK(VBOXSTRICTRC) pgmR3PoolClearAllRendezvous(PVM pVM, PVMCPU pVCpu, void *fpvFlushRemTbl);
 void            pgmR3PoolWriteProtectPages(PVM pVM);
 
+/**
+ * Calculates how fast the guest dirties pages during a live save.
+ *
+ * Saving a page makes it clean, so the number of pages dirtied during the
+ * interval is the growth of the dirty set plus the pages saved meanwhile.
+ *
+ * @returns Pages per second.
+ * @param   cDirtyPrev          The dirty pages at the start of the interval.
+ * @param   cDirtyNow           The dirty pages now.
+ * @param   cSaved              The pages saved during the interval.
+ * @param   cNsElapsed          The length of the interval.
+ */
+DECLINLINE(uint32_t) pgmR3LiveCalcDirtyRate(uint32_t cDirtyPrev, uint32_t cDirtyNow, uint64_t cSaved, uint64_t cNsElapsed)
+{
+    int64_t const cDirtied = (int64_t)cDirtyNow - (int64_t)cDirtyPrev + (int64_t)cSaved;
+    if (cDirtied <= 0 || !cNsElapsed)
+        return 0;
+    return (uint32_t)RT_MIN(cDirtied / ((long double)cNsElapsed / 1000000000.0), UINT32_MAX);
+}
+
+/**
+ * Checks whether a live save isn't converging and the vCPUs should be slowed
+ * down (PGM/LiveSaveAutoConverge).
+ *
+ * @returns true if throttling is called for.
+ * @param   uPass                   The data pass.
+ * @param   cDirtyPagesPerSecond    See pgmR3LiveCalcDirtyRate.
+ * @param   cPagesPerSecond         The save speed.
+ * @param   cMsEstDowntime          The estimated downtime if we stopped now.
+ * @param   cMsMaxDowntime          The downtime target.
+ */
+DECLINLINE(bool) pgmR3LiveShouldThrottle(uint32_t uPass, uint32_t cDirtyPagesPerSecond, uint32_t cPagesPerSecond,
+                                         uint32_t cMsEstDowntime, uint32_t cMsMaxDowntime)
+{
+    return uPass > PGM_LIVE_THROTTLE_FIRST_PASS
+        && cMsEstDowntime > cMsMaxDowntime
+        && cDirtyPagesPerSecond > cPagesPerSecond / 2;
+}
+
 #endif /* IN_RING3 */
 #if defined(VBOX_WITH_2X_4GB_ADDR_SPACE_IN_R0) || defined(IN_RC)
 int             pgmRZDynMapHCPageCommon(PPGMMAPSET pSet, RTHCPHYS HCPhys, void **ppv RTLOG_COMMA_SRC_POS_DECL);
@@ -273,7 +273,9 @@ typedef struct SSM
     bool                    fInitialized;
     /** Current pass (for STAM). */
     uint32_t                uPass;
-    uint32_t                u32Alignment;
+    /** The number of threads to use for compressing and decompressing saved
+     * state pages, 0 to do it on the EMT (CFGM: SSM/ZipThreads). */
+    uint32_t                cZipThreads;
 } SSM;
 /** Pointer to SSM VM instance data. */
 typedef SSM *PSSM;
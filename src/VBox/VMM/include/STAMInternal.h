@@ -23,6 +23,8 @@
 #include <VBox/vmm/stam.h>
 #include <VBox/vmm/gvmm.h>
 #include <VBox/vmm/gmm.h>
+#include <iprt/avl.h>
+#include <iprt/list.h>
 #include <iprt/semaphore.h>
 
 
@@ -40,8 +42,17 @@ RT_C_DECLS_BEGIN
  */
 typedef struct STAMDESC
 {
-    /** Pointer to the next sample. */
-    struct STAMDESC    *pNext;
+    /** Our entry in the list of samples, sorted by name. */
+    RTLISTNODE          ListEntry;
+    /** Our node in the lookup tree. */
+    struct STAMLOOKUP  *pLookup;
+    /** Our node in the sample address tree (STAMUSERPERVM::SampleTree).  Only
+     * the first of the samples sharing an address is actually in the tree. */
+    AVLPVNODECORE       SampleCore;
+    /** The next sample sharing the address, see SampleCore. */
+    struct STAMDESC    *pNextSameSample;
+    /** The sample ID, unique for the lifetime of the VM. */
+    uint32_t            idSample;
     /** Sample name. */
     const char         *pszName;
     /** Sample type. */
@@ -93,14 +104,65 @@ typedef STAMDESC        *PSTAMDESC;
 typedef const STAMDESC  *PCSTAMDESC;
 
 
+/**
+ * Sample lookup tree node.
+ *
+ * The tree has a node for each slash separated component of the sample names.
+ * The children are sorted by name and binary searched, so finding the node of
+ * a sample takes O(depth * log(fan-out)) name compares.  The rest is linear in
+ * the fan-out: adding or removing a node moves the sibling pointers after it
+ * and renumbers their iParent, and finding the list neighbour of a new sample
+ * scans the siblings for a non-empty subtree.  That's pointer work on arrays
+ * of at most a few hundred entries, not string compares against every sample.
+ * Walking the tree in pre-order yields the samples in the same order as the
+ * sample list, which means the samples of a subtree are found in one
+ * consecutive run of it.
+ */
+typedef struct STAMLOOKUP
+{
+    /** The parent node, NULL for the root. */
+    struct STAMLOOKUP  *pParent;
+    /** The children, sorted by name. */
+    struct STAMLOOKUP **papChildren;
+    /** The sample with this name, NULL if only an inner node. */
+    PSTAMDESC           pDesc;
+    /** The number of samples in this subtree, pDesc included. */
+    uint32_t            cDescsInTree;
+    /** The number of children. */
+    uint32_t            cChildren;
+    /** The number of entries allocated for papChildren. */
+    uint32_t            cChildrenAlloc;
+    /** Our index in the pParent->papChildren array. */
+    uint32_t            iParent;
+    /** The offset of our component in szPath. */
+    uint16_t            offName;
+    /** The length of the path. */
+    uint16_t            cchPath;
+    /** The path, i.e. the sample name prefix this node represents.  Variable
+     * length, the root has an empty one. */
+    char                szPath[4];
+} STAMLOOKUP;
+/** Pointer to a sample lookup tree node. */
+typedef STAMLOOKUP *PSTAMLOOKUP;
+
+
 /**
  * STAM data kept in the UVM.
  */
 typedef struct STAMUSERPERVM
 {
-    /** Pointer to the first sample. */
-    R3PTRTYPE(PSTAMDESC)    pHead;
-    /** RW Lock for the list. */
+    /** List of samples, sorted by name. */
+    RTLISTANCHOR            List;
+    /** The root of the sample lookup tree. */
+    R3PTRTYPE(PSTAMLOOKUP)  pRoot;
+    /** The samples indexed by their address, for deregistration. */
+    AVLPVTREE               SampleTree;
+    /** Incremented whenever a sample is registered or deregistered, for
+     * invalidating the binary snapshots. */
+    uint32_t                uGeneration;
+    /** The ID of the next sample to be registered. */
+    uint32_t                idNextSample;
+    /** RW Lock for the list and the trees. */
     RTSEMRW                 RWSem;
 
     /** The copy of the GVMM statistics. */
@@ -108,8 +170,8 @@ typedef struct STAMUSERPERVM
     /** The number of registered host CPU leaves. */
     uint32_t                cRegisteredHostCpus;
 
-    /** Explicit alignment padding. */
-    uint32_t                uAlignment;
+    /** The number of registered host NUMA node leaves (GMM). */
+    uint32_t                cRegisteredNumaNodes;
     /** The copy of the GMM statistics. */
     GMMSTATS                GMMStats;
 } STAMUSERPERVM;
@@ -19,6 +19,117 @@
 #define ___TMInline_h
 
 
+/**
+ * Checks if active timer heap entry @a pLeft expires before @a pRight.
+ *
+ * @returns true if it does, false if not.
+ * @param   pLeft       The left entry.
+ * @param   pRight      The right entry.
+ */
+DECL_FORCE_INLINE(bool) tmTimerHeapEntryIsBefore(TMTIMERHEAPENTRY const *pLeft, TMTIMERHEAPENTRY const *pRight)
+{
+    return pLeft->u64Expire < pRight->u64Expire
+        || (   pLeft->u64Expire == pRight->u64Expire
+            && (int32_t)(pLeft->uSeq - pRight->uSeq) < 0);
+}
+
+
+/**
+ * Stores an entry in the active timer heap, moving it towards the head until
+ * the heap order is restored.
+ *
+ * @returns The index the entry ended up at.
+ * @param   pQueue      The timer queue.
+ * @param   paHeap      The heap of the queue.
+ * @param   i           The index of the hole to start at.
+ * @param   pEntry      The entry to store.
+ */
+DECL_FORCE_INLINE(uint32_t) tmTimerHeapSiftUp(PTMTIMERQUEUE pQueue, PTMTIMERHEAPENTRY paHeap, uint32_t i,
+                                              TMTIMERHEAPENTRY const *pEntry)
+{
+    while (i > 1)
+    {
+        uint32_t const iParent = i / 2;
+        if (!tmTimerHeapEntryIsBefore(pEntry, &paHeap[iParent]))
+            break;
+        paHeap[i] = paHeap[iParent];
+        TMTIMER_HEAP_ENTRY_TIMER(pQueue, &paHeap[i])->idxActive = i;
+        i = iParent;
+    }
+    paHeap[i] = *pEntry;
+    TMTIMER_HEAP_ENTRY_TIMER(pQueue, &paHeap[i])->idxActive = i;
+    return i;
+}
+
+
+/**
+ * Stores an entry in the active timer heap, moving it away from the head
+ * until the heap order is restored.
+ *
+ * @param   pQueue      The timer queue.
+ * @param   paHeap      The heap of the queue.
+ * @param   i           The index of the hole to start at.
+ * @param   pEntry      The entry to store.
+ */
+DECL_FORCE_INLINE(void) tmTimerHeapSiftDown(PTMTIMERQUEUE pQueue, PTMTIMERHEAPENTRY paHeap, uint32_t i,
+                                            TMTIMERHEAPENTRY const *pEntry)
+{
+    uint32_t const cActive = pQueue->cActive;
+    for (;;)
+    {
+        uint32_t iChild = i * 2;
+        if (iChild > cActive)
+            break;
+        if (   iChild < cActive
+            && tmTimerHeapEntryIsBefore(&paHeap[iChild + 1], &paHeap[iChild]))
+            iChild++;
+        if (!tmTimerHeapEntryIsBefore(&paHeap[iChild], pEntry))
+            break;
+        paHeap[i] = paHeap[iChild];
+        TMTIMER_HEAP_ENTRY_TIMER(pQueue, &paHeap[i])->idxActive = i;
+        i = iChild;
+    }
+    paHeap[i] = *pEntry;
+    TMTIMER_HEAP_ENTRY_TIMER(pQueue, &paHeap[i])->idxActive = i;
+}
+
+
+/**
+ * Removes a timer from the active timer heap, no state checks.
+ *
+ * @param   pQueue      The timer queue.
+ * @param   pTimer      The timer.
+ *
+ * @remarks Called while owning the relevant queue lock.
+ */
+DECL_FORCE_INLINE(void) tmTimerQueueHeapRemove(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+    PTMTIMERHEAPENTRY const paHeap  = TMTIMER_GET_HEAP(pQueue);
+    uint32_t const          i       = pTimer->idxActive;
+    uint32_t const          iLast   = pQueue->cActive;
+    Assert(i >= 1 && i <= iLast);
+    Assert(TMTIMER_HEAP_ENTRY_TIMER(pQueue, &paHeap[i]) == pTimer);
+
+    pQueue->cActive = iLast - 1;
+    pTimer->idxActive = 0;
+    if (i != iLast)
+    {
+        /* Fill the hole with the last entry. */
+        TMTIMERHEAPENTRY const Last = paHeap[iLast];
+        if (   i > 1
+            && tmTimerHeapEntryIsBefore(&Last, &paHeap[i / 2]))
+            tmTimerHeapSiftUp(pQueue, paHeap, i, &Last);
+        else
+            tmTimerHeapSiftDown(pQueue, paHeap, i, &Last);
+    }
+    if (i == 1)
+    {
+        ASMAtomicWriteU64(&pQueue->u64Expire, iLast > 1 ? paHeap[1].u64Expire : INT64_MAX);
+        DBGFTRACE_U64_TAG(pTimer->CTX_SUFF(pVM), pQueue->u64Expire, "tmTimerQueueUnlinkActive");
+    }
+}
+
+
 /**
  * Used to unlink a timer from the active list.
  *
@@ -35,21 +146,7 @@ DECL_FORCE_INLINE(void) tmTimerQueueUnlinkActive(PTMTIMERQUEUE pQueue, PTMTIMER
            ? enmState == TMTIMERSTATE_ACTIVE
            : enmState == TMTIMERSTATE_PENDING_SCHEDULE || enmState == TMTIMERSTATE_PENDING_STOP_SCHEDULE);
 #endif
-
-    const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
-    const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
-    if (pPrev)
-        TMTIMER_SET_NEXT(pPrev, pNext);
-    else
-    {
-        TMTIMER_SET_HEAD(pQueue, pNext);
-        pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
-        DBGFTRACE_U64_TAG(pTimer->CTX_SUFF(pVM), pQueue->u64Expire, "tmTimerQueueUnlinkActive");
-    }
-    if (pNext)
-        TMTIMER_SET_PREV(pNext, pPrev);
-    pTimer->offNext = 0;
-    pTimer->offPrev = 0;
+    tmTimerQueueHeapRemove(pQueue, pTimer);
 }
 
 #endif
@@ -20,6 +20,7 @@
 
 #include <VBox/cdefs.h>
 #include <VBox/types.h>
+#include <VBox/sup.h>
 #include <iprt/time.h>
 #include <iprt/timer.h>
 #include <iprt/assert.h>
@@ -174,10 +175,11 @@ typedef struct TMTIMER
     /** Timer relative offset to the next timer in the schedule list. */
     int32_t volatile        offScheduleNext;
 
-    /** Timer relative offset to the next timer in the chain. */
-    int32_t                 offNext;
-    /** Timer relative offset to the previous timer in the chain. */
-    int32_t                 offPrev;
+    /** The index of the timer's entry in the active timer heap of its queue
+     * (TMTIMERQUEUE::offHeap), 0 if not active. */
+    uint32_t                idxActive;
+    /** Explicit alignment padding. */
+    uint32_t                u32Alignment0;
 
     /** Pointer to the VM the timer belongs to - R3 Ptr. */
     PVMR3                   pVMR3;
@@ -235,14 +237,27 @@ AssertCompileMemberSize(TMTIMER, enmState, sizeof(uint32_t));
     } while (0)
 #endif
 
-/** Get the previous timer. */
-#define TMTIMER_GET_PREV(pTimer) ((PTMTIMER)((pTimer)->offPrev ? (intptr_t)(pTimer) + (pTimer)->offPrev : 0))
-/** Get the next timer. */
-#define TMTIMER_GET_NEXT(pTimer) ((PTMTIMER)((pTimer)->offNext ? (intptr_t)(pTimer) + (pTimer)->offNext : 0))
-/** Set the previous timer link. */
-#define TMTIMER_SET_PREV(pTimer, pPrev) ((pTimer)->offPrev = (pPrev) ? (intptr_t)(pPrev) - (intptr_t)(pTimer) : 0)
-/** Set the next timer link. */
-#define TMTIMER_SET_NEXT(pTimer, pNext) ((pTimer)->offNext = (pNext) ? (intptr_t)(pNext) - (intptr_t)(pTimer) : 0)
+
+/**
+ * An entry in the active timer heap of a timer queue.
+ *
+ * The expire time is a copy of the one the timer was linked with, since other
+ * threads may change TMTIMER::u64Expire while the timer is pending
+ * rescheduling and the heap must not be reordered under our feet.
+ */
+typedef struct TMTIMERHEAPENTRY
+{
+    /** The expire time the timer was linked with. */
+    uint64_t                u64Expire;
+    /** The link sequence number (TMTIMERQUEUE::uSeqNext).  Keeps timers with
+     * the same expire time in the order they were linked. */
+    uint32_t                uSeq;
+    /** Offset of the timer relative to the queue structure. */
+    int32_t                 offTimer;
+} TMTIMERHEAPENTRY;
+AssertCompileSize(TMTIMERHEAPENTRY, 16);
+/** Pointer to an active timer heap entry. */
+typedef TMTIMERHEAPENTRY *PTMTIMERHEAPENTRY;
 
 
 /**
@@ -256,14 +271,18 @@ typedef struct TMTIMERQUEUE
      * Updated by EMT when scheduling the queue or modifying the head timer.
      * Assigned UINT64_MAX when there is no head timer. */
     uint64_t                u64Expire;
-    /** Doubly linked list of active timers.
+    /** The active timers.
      *
-     * When no scheduling is pending, this list is will be ordered by expire time (ascending).
-     * Access is serialized by only letting the emulation thread (EMT) do changes.
+     * This is a binary min-heap of cActive entries ordered by expire time
+     * (ascending), entry 1 being the head and entry 0 unused.  Linking and
+     * unlinking is O(log n), instead of walking a sorted list.  Access is
+     * serialized by the relevant queue lock.
      *
-     * The offset is relative to the queue structure.
+     * The offset is relative to the queue structure, 0 if nothing has been
+     * allocated yet.  The heap is grown by tmR3TimerQueueGrow when timers are
+     * created, so it always has room for all the timers using the clock.
      */
-    int32_t                 offActive;
+    int32_t                 offHeap;
     /** List of timers pending scheduling of some kind.
      *
      * Timer stats allowed in the list are TMTIMERSTATE_PENDING_STOPPING,
@@ -275,17 +294,27 @@ typedef struct TMTIMERQUEUE
     int32_t volatile        offSchedule;
     /** The clock for this queue. */
     TMCLOCK                 enmClock;
-    /** Pad the structure up to 32 bytes. */
-    uint32_t                au32Padding[3];
+    /** The number of active timers in the heap. */
+    uint32_t                cActive;
+    /** The number of entries allocated for the heap, not counting entry 0. */
+    uint32_t                cHeapAlloc;
+    /** The sequence number for the next timer linked into the heap. */
+    uint32_t                uSeqNext;
+    /** The number of timers created for this clock.  Ring-3 only. */
+    uint32_t                cTimers;
+    /** Explicit alignment padding. */
+    uint32_t                u32Alignment;
 } TMTIMERQUEUE;
 
 /** Pointer to a timer queue. */
 typedef TMTIMERQUEUE *PTMTIMERQUEUE;
 
-/** Get the head of the active timer list. */
-#define TMTIMER_GET_HEAD(pQueue)        ((PTMTIMER)((pQueue)->offActive ? (intptr_t)(pQueue) + (pQueue)->offActive : 0))
-/** Set the head of the active timer list. */
-#define TMTIMER_SET_HEAD(pQueue, pHead) ((pQueue)->offActive = pHead ? (intptr_t)pHead - (intptr_t)(pQueue) : 0)
+/** Get the active timer heap of a queue. */
+#define TMTIMER_GET_HEAP(pQueue)        ((PTMTIMERHEAPENTRY)((intptr_t)(pQueue) + (pQueue)->offHeap))
+/** Get the timer of an active timer heap entry. */
+#define TMTIMER_HEAP_ENTRY_TIMER(pQueue, pEntry) ((PTMTIMER)((intptr_t)(pQueue) + (pEntry)->offTimer))
+/** Get the head of the active timer heap, i.e. the timer expiring first. */
+#define TMTIMER_GET_HEAD(pQueue)        ((pQueue)->cActive ? TMTIMER_HEAP_ENTRY_TIMER(pQueue, &TMTIMER_GET_HEAP(pQueue)[1]) : (PTMTIMER)0)
 
 
 /**
@@ -497,6 +526,43 @@ typedef struct TM
     /** Interval in milliseconds of the pTimer timer. */
     uint32_t                    u32TimerMillies;
 
+    /** @name Tickless mode (TM/Tickless).
+     * Instead of the periodic pTimer, a thread sleeps until the earliest
+     * deadline of the timer queues and gets kicked when a queue gets a new
+     * head which expires before that.
+     * @{ */
+    /** Set if the tickless mode is used. */
+    bool                        fTickless;
+    /** Set by raw-mode context code when the tickless thread needs a kick,
+     * ring-0 delivers it in TMNotifyEndOfExecution. */
+    bool volatile               fTicklessKickPending;
+    /** Tells the tickless thread to terminate. */
+    bool volatile               fTicklessTerminate;
+    bool                        afAlignment5[1];
+    /** The time on each clock the tickless thread is sleeping till, a new
+     * queue head expiring before it kicks the thread.  UINT64_MAX while the
+     * thread is working out the next wakeup, 0 for stopped clocks. */
+    uint64_t volatile           au64TicklessExpire[TMCLOCK_MAX];
+    /** The max time the tickless thread sleeps (ns), TM/TicklessMaxSleepMs. */
+    uint64_t                    cNsTicklessMaxSleep;
+    /** The event semaphore the tickless thread sleeps on. */
+    SUPSEMEVENT                 hTicklessEvt;
+    /** The tickless thread. */
+    RTTHREAD                    hTicklessThread;
+    /** When the current host wakeup period started (RTTimeNanoTS). */
+    uint64_t                    u64HostWakeupPeriodStart;
+    /** Host wakeups of the timer thread / timer. */
+    STAMCOUNTER                 StatHostWakeups;
+    /** Times the tickless thread was kicked because of a new earlier deadline. */
+    STAMCOUNTER                 StatTicklessKicks;
+    /** The number of host wakeups in the current period. */
+    uint32_t                    cHostWakeupsInPeriod;
+    /** Host wakeups per second of the timer thread / timer, updated every
+     * second. */
+    uint32_t                    cHostWakeupsPerSec;
+    uint32_t                    u32Alignment6;
+    /** @} */
+
     /** Indicates that queues are being run. */
     bool volatile               fRunningQueues;
     /** Indicates that the virtual sync queue is being run. */
@@ -295,6 +295,32 @@ typedef struct VMINTUSERPERVM
         }                           Global1;
     }                               Halt;
 
+    /**
+     * Adaptive halt polling, used by method 1 and global 1.
+     *
+     * Before blocking, the EMT spins for a while waiting for an FF to be
+     * raised.  The window is per VCPU, grows while the halts end shortly
+     * after blocking and shrinks when they don't.  The configuration lives
+     * in the CFGM node '/VMM/HaltPoll'.
+     */
+    struct
+    {
+        /** Whether to poll before blocking at all. */
+        bool                        fEnabled;
+        /** Align the next member. */
+        bool                        afAlignment[3];
+        /** The max poll window (ns). */
+        uint32_t                    cNsMaxCfg;
+        /** The window to start with when growing it from zero (ns). */
+        uint32_t                    cNsStartCfg;
+        /** What the window is multiplied by when growing. */
+        uint32_t                    uGrowCfg;
+        /** What the window is divided by when shrinking, 0 means reset. */
+        uint32_t                    uShrinkCfg;
+        /** The max percentage of the wall time a VCPU may spend polling. */
+        uint32_t                    uBudgetPctCfg;
+    }                               HaltPoll;
+
     /** Pointer to the DBGC instance data. */
     void                           *pvDBGC;
 
@@ -314,6 +340,22 @@ AssertCompileMemberAlignment(VMINTUSERPERVM, StatReqAllocNew, 8);
 typedef VMINTUSERPERVM *PVMINTUSERPERVM;
 
 
+/** @name Halt polling histograms (VMINTUSERPERVMCPU::aStatHaltPollHist).
+ * @{ */
+/** Halts ending while polling, the time spent polling. */
+#define VM_HALT_POLL_HIST_POLLED    0
+/** Halts ending after blocking, the time spent blocking. */
+#define VM_HALT_POLL_HIST_BLOCKED   1
+/** Halts ending after blocking, the time spent polling before it. */
+#define VM_HALT_POLL_HIST_WASTED    2
+/** The number of histograms. */
+#define VM_HALT_POLL_HIST_END       3
+/** The number of buckets in each histogram.  These are powers of four
+ * starting at 1us: <1us, <4us, <16us, ..., <4096us and the rest. */
+#define VM_HALT_POLL_HIST_BUCKETS   8
+/** @} */
+
+
 /**
  * VMCPU internal data kept in the UVM.
  *
@@ -351,6 +393,16 @@ typedef struct VMINTUSERPERVMCPU
     uint64_t                        u64HaltsStartTS;
     /** @} */
 
+    /** @name Adaptive halt polling, see VMINTUSERPERVM::HaltPoll.
+     * @{ */
+    /** The current poll window (ns). */
+    uint32_t                        cNsHaltPollWindow;
+    /** The time spent polling in the current budget period (ns). */
+    uint32_t                        cNsHaltPolledInPeriod;
+    /** When the current budget period started (RTTimeNanoTS). */
+    uint64_t                        u64HaltPollPeriodStartTS;
+    /** @} */
+
     /** Union containing data and config for the different halt algorithms. */
     union
     {
@@ -428,6 +480,11 @@ typedef struct VMINTUSERPERVMCPU
     STAMPROFILE                     StatHaltBlockOnTime;
     STAMPROFILE                     StatHaltTimers;
     STAMPROFILE                     StatHaltPoll;
+    STAMPROFILE                     StatHaltPollBlocked;
+    STAMPROFILE                     StatHaltPollWasted;
+    STAMCOUNTER                     StatHaltPollOverBudget;
+    /** Halt polling histograms, indexed by VM_HALT_POLL_HIST_XXX and bucket. */
+    STAMCOUNTER                     aStatHaltPollHist[VM_HALT_POLL_HIST_END][VM_HALT_POLL_HIST_BUCKETS];
     /** @} */
 } VMINTUSERPERVMCPU;
 AssertCompileMemberAlignment(VMINTUSERPERVMCPU, u64HaltsStartTS, 8);
@@ -0,0 +1,382 @@
+/* $Id$ */
+/** @file
+ * PDM Testcase - Read/write critical section stress test.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "PDMInternal.h" /* queued leaves */
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmm.h>
+#include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/pdmcritsectrw.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/initterm.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The number of stress threads. */
+#define TST_THREADS         6
+/** How long each stress thread runs. */
+#define TST_STRESS_MS       2000
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+/** The section under test. */
+static PDMCRITSECTRW        g_CritSectRw;
+/** Set when the stress threads should stop. */
+static bool volatile        g_fStop;
+/** The number of threads inside the section with shared access. */
+static uint32_t volatile    g_cReaders;
+/** The number of threads inside the section with exclusive access. */
+static uint32_t volatile    g_cWriters;
+/** Incremented non-atomically with exclusive access. */
+static uint64_t             g_cExclusiveUpdates;
+/** Set by the waiter thread once it got in. */
+static bool volatile        g_fWaiterIn;
+
+
+static DECLCALLBACK(int) tstInit(PVM pVM)
+{
+    return PDMR3CritSectRwInit(pVM, &g_CritSectRw, RT_SRC_POS, "tstPDMCritSectRw");
+}
+
+
+static DECLCALLBACK(int) tstDelete(void)
+{
+    return PDMR3CritSectRwDelete(&g_CritSectRw);
+}
+
+
+/**
+ * Checks what a reader must see.
+ */
+static void tstCheckShared(void)
+{
+    ASMAtomicIncU32(&g_cReaders);
+    RTTESTI_CHECK(ASMAtomicReadU32(&g_cWriters) == 0);
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) > 0);
+    RTTESTI_CHECK(!PDMCritSectRwIsWriteOwner(&g_CritSectRw));
+    RTTESTI_CHECK(PDMCritSectRwIsReadOwner(&g_CritSectRw));
+    ASMAtomicDecU32(&g_cReaders);
+}
+
+
+/**
+ * Checks what the writer must see, recursing into the section both ways.
+ */
+static void tstCheckExcl(void)
+{
+    RTTESTI_CHECK(ASMAtomicIncU32(&g_cWriters) == 1);
+    RTTESTI_CHECK(ASMAtomicReadU32(&g_cReaders) == 0);
+    RTTESTI_CHECK(PDMCritSectRwIsWriteOwner(&g_CritSectRw));
+    RTTESTI_CHECK(PDMCritSectRwGetWriteRecursion(&g_CritSectRw) == 1);
+    g_cExclusiveUpdates++;
+
+    RTTESTI_CHECK_RC(PDMCritSectRwEnterExcl(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwGetWriteRecursion(&g_CritSectRw) == 2);
+    RTTESTI_CHECK_RC(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwIsReadOwner(&g_CritSectRw));
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwGetWriteRecursion(&g_CritSectRw) == 1);
+
+    ASMAtomicDecU32(&g_cWriters);
+}
+
+
+/**
+ * Recursion and ordering on a single thread.
+ */
+static void tstRecursion(void)
+{
+    RTTestSub(g_hTest, "Recursion");
+
+    /* Shared recursion. */
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) == 2);
+    RTTESTI_CHECK_RC(PDMCritSectRwTryEnterExcl(&g_CritSectRw), VERR_SEM_BUSY);
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) == 2);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) == 0);
+
+    /* Exclusive recursion with reads in between. */
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterExcl(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwTryEnterExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwEnterExcl(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwGetWriteRecursion(&g_CritSectRw) == 3);
+    RTTESTI_CHECK_RC(PDMCritSectRwTryEnterShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) == 0); /* the writer's reads don't count */
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+
+    /* The final leave must wait for the reads. */
+    bool fSavedQuiet    = RTAssertSetQuiet(true);
+    bool fSavedMayPanic = RTAssertSetMayPanic(false);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VERR_WRONG_ORDER);
+    RTTESTI_CHECK(PDMCritSectRwIsWriteOwner(&g_CritSectRw));
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK(!PDMCritSectRwIsWriteOwner(&g_CritSectRw));
+
+    /* Leaving what we don't own. */
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VERR_NOT_OWNER);
+    RTAssertSetMayPanic(fSavedMayPanic);
+    RTAssertSetQuiet(fSavedQuiet);
+
+    /* Back to the write direction and then the read direction again. */
+    RTTESTI_CHECK_RC(PDMCritSectRwTryEnterExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwTryEnterShared(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+}
+
+
+static DECLCALLBACK(int) tstStressThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    NOREF(hThreadSelf);
+    uintptr_t const iThread = (uintptr_t)pvUser;
+    uint32_t        i       = 0;
+    while (!ASMAtomicReadBool(&g_fStop))
+    {
+        /* Mostly readers, like the device I/O threads, with a writer now and
+           then and some of them trying only. */
+        i++;
+        if ((i + iThread) % 8 == 0)
+        {
+            int rc = (i & 16) ? PDMCritSectRwTryEnterExcl(&g_CritSectRw) : PDMCritSectRwEnterExcl(&g_CritSectRw, VERR_SEM_BUSY);
+            if (rc == VERR_SEM_BUSY && (i & 16))
+                continue;
+            RTTESTI_CHECK_RC_BREAK(rc, VINF_SUCCESS);
+            tstCheckExcl();
+            RTTESTI_CHECK_RC_BREAK(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+        }
+        else
+        {
+            int rc = (i & 32) ? PDMCritSectRwTryEnterShared(&g_CritSectRw) : PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY);
+            if (rc == VERR_SEM_BUSY && (i & 32))
+                continue;
+            RTTESTI_CHECK_RC_BREAK(rc, VINF_SUCCESS);
+            tstCheckShared();
+            if (i & 1)
+            {
+                /* Shared recursion while writers may be waiting. */
+                RTTESTI_CHECK_RC_BREAK(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+                tstCheckShared();
+                RTTESTI_CHECK_RC_BREAK(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+            }
+            RTTESTI_CHECK_RC_BREAK(PDMCritSectRwLeaveShared(&g_CritSectRw), VINF_SUCCESS);
+        }
+        if (i % 64 == 0)
+            RTThreadYield();
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Shared and exclusive access from several threads at once.
+ */
+static void tstStress(void)
+{
+    RTTestSub(g_hTest, "Stress");
+
+    g_fStop = false;
+    g_cExclusiveUpdates = 0;
+    RTTHREAD ahThreads[TST_THREADS];
+    unsigned cThreads = 0;
+    for (unsigned i = 0; i < TST_THREADS; i++, cThreads++)
+    {
+        int rc = RTThreadCreateF(&ahThreads[i], tstStressThread, (void *)(uintptr_t)i, 0,
+                                 RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "tstRw%u", i);
+        RTTESTI_CHECK_RC_BREAK(rc, VINF_SUCCESS);
+    }
+
+    RTThreadSleep(TST_STRESS_MS);
+    ASMAtomicWriteBool(&g_fStop, true);
+    for (unsigned i = 0; i < cThreads; i++)
+        RTTESTI_CHECK_RC_OK(RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, NULL));
+
+    RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "%RU64 exclusive entries\n", g_cExclusiveUpdates);
+    RTTESTI_CHECK(g_cExclusiveUpdates > 0);
+    RTTESTI_CHECK(g_cReaders == 0 && g_cWriters == 0);
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) == 0);
+    RTTESTI_CHECK(!PDMCritSectRwIsWriteOwner(&g_CritSectRw));
+}
+
+
+static DECLCALLBACK(int) tstWaiterThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    NOREF(hThreadSelf);
+    bool const fExcl = pvUser != NULL;
+    int rc = fExcl
+           ? PDMCritSectRwEnterExcl(&g_CritSectRw, VERR_SEM_BUSY)
+           : PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY);
+    if (RT_SUCCESS(rc))
+    {
+        ASMAtomicWriteBool(&g_fWaiterIn, true);
+        rc = fExcl
+           ? PDMCritSectRwLeaveExcl(&g_CritSectRw)
+           : PDMCritSectRwLeaveShared(&g_CritSectRw);
+    }
+    return rc;
+}
+
+
+/**
+ * Does what pdmRZCritSectRwQueueLeave does when a leave in raw-mode or ring-0
+ * cannot signal the waiters.  For the exclusive case the caller has already
+ * given up the ownership like PDMCritSectRwLeaveExcl does.
+ */
+static void tstQueueLeave(PVMCPU pVCpu, bool fExcl)
+{
+    if (fExcl)
+    {
+        uint32_t i = pVCpu->pdm.s.cQueuedCritSectRwExclLeaves++;
+        RTTESTI_CHECK_RETV(i < RT_ELEMENTS(pVCpu->pdm.s.apQueuedCritSectRwExclLeaves));
+        pVCpu->pdm.s.apQueuedCritSectRwExclLeaves[i] = &g_CritSectRw;
+    }
+    else
+    {
+        uint32_t i = pVCpu->pdm.s.cQueuedCritSectRwShrdLeaves++;
+        RTTESTI_CHECK_RETV(i < RT_ELEMENTS(pVCpu->pdm.s.apQueuedCritSectRwShrdLeaves));
+        pVCpu->pdm.s.apQueuedCritSectRwShrdLeaves[i] = &g_CritSectRw;
+    }
+    VMCPU_FF_SET(pVCpu, VMCPU_FF_PDM_CRITSECT);
+}
+
+
+/**
+ * Starts a waiter and makes sure it is blocked.
+ */
+static int tstStartWaiter(PRTTHREAD phThread, bool fExcl)
+{
+    ASMAtomicWriteBool(&g_fWaiterIn, false);
+    int rc = RTThreadCreate(phThread, tstWaiterThread, (void *)(uintptr_t)fExcl, 0,
+                            RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "tstRwWait");
+    if (RT_SUCCESS(rc))
+    {
+        RTThreadSleep(100);
+        RTTESTI_CHECK(!ASMAtomicReadBool(&g_fWaiterIn));
+    }
+    return rc;
+}
+
+
+/**
+ * Queues leaves the way the RZ code does and checks that PDMCritSectFF
+ * completes them and wakes up the waiters.  Runs on the EMT.
+ */
+static DECLCALLBACK(void) tstQueuedLeaves(PVM pVM)
+{
+    PVMCPU   pVCpu = VMMGetCpu(pVM);
+    RTTHREAD hThread;
+    int      rc;
+
+    /* An exclusive leave with a reader waiting. */
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterExcl(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_OK_RETV(tstStartWaiter(&hThread, false /*fExcl*/));
+    ASMAtomicWriteU32(&g_CritSectRw.s.cWriteRecursions, 0);
+    ASMAtomicWriteHandle(&g_CritSectRw.s.hNativeWriter, NIL_RTNATIVETHREAD);
+    tstQueueLeave(pVCpu, true /*fExcl*/);
+    RTThreadSleep(50);
+    RTTESTI_CHECK(!ASMAtomicReadBool(&g_fWaiterIn));
+    PDMCritSectFF(pVCpu);
+    RTTESTI_CHECK(!VMCPU_FF_ISSET(pVCpu, VMCPU_FF_PDM_CRITSECT));
+    RTTESTI_CHECK(pVCpu->pdm.s.cQueuedCritSectRwExclLeaves == 0);
+    RTTESTI_CHECK_RC_OK(RTThreadWait(hThread, 10000, &rc));
+    RTTESTI_CHECK_RC_OK(rc);
+    RTTESTI_CHECK(ASMAtomicReadBool(&g_fWaiterIn));
+
+    /* The last shared leave with a writer waiting. */
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_OK_RETV(tstStartWaiter(&hThread, true /*fExcl*/));
+    tstQueueLeave(pVCpu, false /*fExcl*/);
+    RTThreadSleep(50);
+    RTTESTI_CHECK(!ASMAtomicReadBool(&g_fWaiterIn));
+    PDMCritSectFF(pVCpu);
+    RTTESTI_CHECK(pVCpu->pdm.s.cQueuedCritSectRwShrdLeaves == 0);
+    RTTESTI_CHECK_RC_OK(RTThreadWait(hThread, 10000, &rc));
+    RTTESTI_CHECK_RC_OK(rc);
+    RTTESTI_CHECK(ASMAtomicReadBool(&g_fWaiterIn));
+
+    /* Two shared leaves in one go, only the second one hands it over. */
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_RETV(PDMCritSectRwEnterShared(&g_CritSectRw, VERR_SEM_BUSY), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_OK_RETV(tstStartWaiter(&hThread, true /*fExcl*/));
+    tstQueueLeave(pVCpu, false /*fExcl*/);
+    tstQueueLeave(pVCpu, false /*fExcl*/);
+    PDMCritSectFF(pVCpu);
+    RTTESTI_CHECK_RC_OK(RTThreadWait(hThread, 10000, &rc));
+    RTTESTI_CHECK_RC_OK(rc);
+    RTTESTI_CHECK(ASMAtomicReadBool(&g_fWaiterIn));
+
+    RTTESTI_CHECK(PDMCritSectRwGetReadCount(&g_CritSectRw) == 0);
+    RTTESTI_CHECK(!PDMCritSectRwIsWriteOwner(&g_CritSectRw));
+    RTTESTI_CHECK_RC(PDMCritSectRwTryEnterExcl(&g_CritSectRw), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(PDMCritSectRwLeaveExcl(&g_CritSectRw), VINF_SUCCESS);
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPDMCritSectRw", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    PVM pVM;
+    int rc = VMR3Create(1, NULL, NULL, NULL, NULL, NULL, &pVM);
+    if (RT_SUCCESS(rc))
+    {
+        rc = VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstInit, 1, pVM);
+        if (RT_SUCCESS(rc))
+        {
+            tstRecursion();
+            tstStress();
+            RTTestSub(g_hTest, "Queued leaves");
+            RTTESTI_CHECK_RC_OK(VMR3ReqCallVoidWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstQueuedLeaves, 1, pVM));
+
+            rc = VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstDelete, 0);
+            RTTESTI_CHECK_RC_OK(rc);
+        }
+        else
+            RTTestFailed(g_hTest, "PDMR3CritSectRwInit -> %Rrc", rc);
+
+        rc = VMR3Destroy(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
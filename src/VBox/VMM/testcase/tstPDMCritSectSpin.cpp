@@ -0,0 +1,98 @@
+/* $Id$ */
+/** @file
+ * PDM Testcase - Adaptive critical section spinning.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <VBox/vmm/pdmcritsect.h>
+#include "PDMInternal.h"
+
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+#define EST(cLoops)     ((uint16_t)((cLoops) << PDMCRITSECT_SPIN_EST_SHIFT))
+
+
+static uint16_t tstUpdate(uint16_t cSpinEst, uint32_t cSpins, unsigned cTimes)
+{
+    while (cTimes-- > 0)
+        cSpinEst = pdmCritSectCalcSpinEst(cSpinEst, cSpins);
+    return cSpinEst;
+}
+
+
+static void tstHits(void)
+{
+    RTTestISub("Hits");
+
+    /* Short spins register from nothing.  Rounding to 4 loop units kept the
+       estimate at 0 for anything below 32 loops. */
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(0, 1) == 1);
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(0, 3) == 3);
+    RTTESTI_CHECK(tstUpdate(0, 3, 100) == EST(3));
+    RTTESTI_CHECK(tstUpdate(0, 31, 100) == EST(31));
+
+    /* 1/8 of the way towards the sample. */
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(EST(80), 16) == EST(72));
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(EST(8), 72) == EST(16));
+
+    /* Settles on the sample from either side, to the loop. */
+    RTTESTI_CHECK(tstUpdate(EST(128), 5, 200) >> PDMCRITSECT_SPIN_EST_SHIFT == 5);
+    RTTESTI_CHECK(tstUpdate(EST(5), 1000, 200) == EST(1000));
+    RTTESTI_CHECK(tstUpdate(EST(128), 128, 1) == EST(128));
+
+    /* No overflow with silly samples. */
+    RTTESTI_CHECK(tstUpdate(UINT16_MAX, UINT32_MAX - 1, 10) <= UINT16_MAX);
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(0, UINT32_MAX - 1) == UINT16_MAX >> PDMCRITSECT_SPIN_EST_SHIFT);
+}
+
+
+static void tstMisses(void)
+{
+    RTTestISub("Misses");
+
+    /* Decays by 1/8 and a fraction. */
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(EST(80), UINT32_MAX) == EST(70) - 1);
+
+    /* Goes all the way down and stays there. */
+    RTTESTI_CHECK(tstUpdate(EST(1024), UINT32_MAX, 100) == 0);
+    RTTESTI_CHECK(tstUpdate(UINT16_MAX, UINT32_MAX, 150) == 0);
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(0, UINT32_MAX) == 0);
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(1, UINT32_MAX) == 0);
+
+    /* A hit after a long miss streak registers straight away. */
+    RTTESTI_CHECK(pdmCritSectCalcSpinEst(tstUpdate(EST(64), UINT32_MAX, 100), 2) == 2);
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPDMCritSectSpin", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    tstHits();
+    tstMisses();
+
+    return RTTestSummaryAndDestroy(hTest);
+}
@@ -0,0 +1,106 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Helpers shared by the tstPGM* testcases.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "tstPGMCommon.h"
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/stam.h>
+#include <VBox/err.h>
+#include <iprt/param.h>
+#include <iprt/test.h>
+
+
+/**
+ * Fills a page with a pattern made from its guest physical address, so every
+ * page is different and one ending up in the wrong place shows.
+ *
+ * @param   pbPage      The page buffer.
+ * @param   GCPhys      The guest physical address of the page.
+ */
+void tstPGMFillPattern(uint8_t *pbPage, RTGCPHYS GCPhys)
+{
+    for (uint32_t off = 0; off < PAGE_SIZE; off += sizeof(uint32_t))
+        *(uint32_t *)&pbPage[off] = (uint32_t)GCPhys + off;
+}
+
+
+static DECLCALLBACK(int) tstPGMEnumStat(const char *pszName, STAMTYPE enmType, void *pvSample, STAMUNIT enmUnit,
+                                        STAMVISIBILITY enmVisiblity, const char *pszDesc, void *pvUser)
+{
+    NOREF(pszName); NOREF(enmUnit); NOREF(enmVisiblity); NOREF(pszDesc);
+    switch (enmType)
+    {
+        case STAMTYPE_COUNTER:
+            *(uint64_t *)pvUser = ((PSTAMCOUNTER)pvSample)->c;
+            break;
+        case STAMTYPE_U32:
+        case STAMTYPE_U32_RESET:
+            *(uint64_t *)pvUser = *(uint32_t *)pvSample;
+            break;
+        case STAMTYPE_U64:
+        case STAMTYPE_U64_RESET:
+            *(uint64_t *)pvUser = *(uint64_t *)pvSample;
+            break;
+        default:
+            RTTestIFailed("%s: unexpected type %d\n", pszName, enmType);
+            break;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Gets the value of a counter or integer statistics sample.
+ *
+ * @returns The value, 0 if the sample doesn't exist.
+ * @param   pVM         Pointer to the VM.
+ * @param   pszName     The sample name.
+ */
+uint64_t tstPGMGetStat(PVM pVM, const char *pszName)
+{
+    uint64_t u64 = 0;
+    STAMR3Enum(pVM, pszName, tstPGMEnumStat, &u64);
+    return u64;
+}
+
+
+/**
+ * Constructs the default configuration tree for a VMR3Create constructor
+ * callback and hands back the PGM node for the testcase to add to.
+ *
+ * @returns VBox status code, failures are reported to the test.
+ * @param   pVM         Pointer to the VM.
+ * @param   ppPGM       Where to return the PGM node, created if necessary.
+ */
+int tstPGMConfigConstruct(PVM pVM, PCFGMNODE *ppPGM)
+{
+    int rc = CFGMR3ConstructDefaultTree(pVM);
+    RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3ConstructDefaultTree -> %Rrc\n", rc), rc);
+
+    PCFGMNODE pRoot = CFGMR3GetRoot(pVM);
+    *ppPGM = CFGMR3GetChild(pRoot, "PGM");
+    if (!*ppPGM)
+    {
+        rc = CFGMR3InsertNode(pRoot, "PGM", ppPGM);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertNode(pRoot,\"PGM\",) -> %Rrc\n", rc), rc);
+    }
+    return VINF_SUCCESS;
+}
+
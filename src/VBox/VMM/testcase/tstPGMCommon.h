@@ -0,0 +1,31 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Helpers shared by the tstPGM* testcases.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef ___tstPGMCommon_h
+#define ___tstPGMCommon_h
+
+#include <VBox/types.h>
+#include <VBox/vmm/cfgm.h>
+
+RT_C_DECLS_BEGIN
+void        tstPGMFillPattern(uint8_t *pbPage, RTGCPHYS GCPhys);
+uint64_t    tstPGMGetStat(PVM pVM, const char *pszName);
+int         tstPGMConfigConstruct(PVM pVM, PCFGMNODE *ppPGM);
+RT_C_DECLS_END
+
+#endif
+
@@ -0,0 +1,206 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Bulk free page reporting.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "tstPGMCommon.h"
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/pgm.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/initterm.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** Where the reported pages are. */
+#define TST_GCPHYS_FIRST    UINT32_C(0x04000000)
+/** The number of reported pages. */
+#define TST_PAGES           64
+/** The page in the reported range that gets a write handler. */
+#define TST_HANDLER_PAGE    5
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+
+
+static void tstWritePattern(PVM pVM)
+{
+    uint8_t abPage[PAGE_SIZE];
+    for (uint32_t i = 0; i < TST_PAGES; i++)
+    {
+        RTGCPHYS const GCPhys = TST_GCPHYS_FIRST + i * PAGE_SIZE;
+        tstPGMFillPattern(abPage, GCPhys);
+        RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysWriteExternal(pVM, GCPhys, abPage, PAGE_SIZE, "tstPGMFreePageReport"));
+    }
+}
+
+
+static DECLCALLBACK(int) tstWriteHandler(PVM pVM, RTGCPHYS GCPhys, void *pvPhys, void *pvBuf, size_t cbBuf,
+                                         PGMACCESSTYPE enmAccessType, void *pvUser)
+{
+    NOREF(pVM); NOREF(GCPhys); NOREF(pvPhys); NOREF(pvBuf); NOREF(cbBuf); NOREF(enmAccessType); NOREF(pvUser);
+    return VINF_PGM_HANDLER_DO_DEFAULT;
+}
+
+
+static DECLCALLBACK(int) tstRegisterHandler(PVM pVM)
+{
+    RTGCPHYS const GCPhys = TST_GCPHYS_FIRST + TST_HANDLER_PAGE * PAGE_SIZE;
+    return PGMR3HandlerPhysicalRegister(pVM, PGMPHYSHANDLERTYPE_PHYSICAL_WRITE, GCPhys, GCPhys + PAGE_OFFSET_MASK,
+                                        tstWriteHandler, NULL, NULL, NULL, NIL_RTR0PTR, NULL, NULL, NIL_RTRCPTR,
+                                        "tstPGMFreePageReport");
+}
+
+
+static DECLCALLBACK(int) tstDeregisterHandler(PVM pVM)
+{
+    return PGMHandlerPhysicalDeregister(pVM, TST_GCPHYS_FIRST + TST_HANDLER_PAGE * PAGE_SIZE);
+}
+
+
+static DECLCALLBACK(int) tstReport(PVM pVM, uint32_t cRanges, PCPGMPHYSRANGE paRanges, uint64_t *pcPagesFreed)
+{
+    return PGMR3PhysReportFreePages(pVM, cRanges, paRanges, pcPagesFreed);
+}
+
+
+/**
+ * Reports the range on the EMT the way VMMDev does.
+ */
+static int tstReportRange(PVM pVM, RTGCPHYS GCPhys, uint64_t cPages, uint64_t *pcPagesFreed)
+{
+    PGMPHYSRANGE Range;
+    Range.GCPhys = GCPhys;
+    Range.cPages = cPages;
+    *pcPagesFreed = UINT64_MAX;
+    return VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstReport, 4, pVM, 1, &Range, pcPagesFreed);
+}
+
+
+/**
+ * Reports a range with a write handled page in it, checks that the others
+ * read as zero afterwards and that the handled one is left alone.
+ */
+static void tstReportFree(PVM pVM)
+{
+    RTTestSub(g_hTest, "Report");
+
+    tstWritePattern(pVM);
+    RTTESTI_CHECK_RC_OK_RETV(VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstRegisterHandler, 1, pVM));
+
+    uint64_t cPagesFreed;
+    int rc = tstReportRange(pVM, TST_GCPHYS_FIRST, TST_PAGES, &cPagesFreed);
+    if (rc == VERR_NOT_IMPLEMENTED)
+        RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "Freeing pages isn't supported on this host, skipping\n");
+    else
+    {
+        RTTESTI_CHECK_RC_OK(rc);
+        RTTESTI_CHECK_MSG(cPagesFreed == TST_PAGES - 1, ("%RU64\n", cPagesFreed));
+
+        uint64_t cPagesQueried = 0;
+        RTTESTI_CHECK_RC_OK(PGMR3PhysQueryFreePagesReport(pVM, &cPagesQueried));
+        RTTESTI_CHECK(cPagesQueried == cPagesFreed);
+
+        uint8_t abPage[PAGE_SIZE];
+        uint8_t abExpect[PAGE_SIZE];
+        for (uint32_t i = 0; i < TST_PAGES; i++)
+        {
+            RTGCPHYS const GCPhys = TST_GCPHYS_FIRST + i * PAGE_SIZE;
+            RTTESTI_CHECK_RC_BREAK(PGMR3PhysReadExternal(pVM, GCPhys, abPage, PAGE_SIZE), VINF_SUCCESS);
+            if (i == TST_HANDLER_PAGE)
+            {
+                tstPGMFillPattern(abExpect, GCPhys);
+                RTTESTI_CHECK_MSG(!memcmp(abPage, abExpect, PAGE_SIZE), ("%RGp\n", GCPhys));
+            }
+            else
+                RTTESTI_CHECK_MSG(ASMMemIsAll8(abPage, PAGE_SIZE, 0) == NULL, ("%RGp\n", GCPhys));
+        }
+
+        /* The zero pages aren't freed again. */
+        RTTESTI_CHECK_RC_OK(tstReportRange(pVM, TST_GCPHYS_FIRST, TST_PAGES, &cPagesFreed));
+        RTTESTI_CHECK_MSG(cPagesFreed == 0, ("%RU64\n", cPagesFreed));
+
+        /* The guest gets them back on touch. */
+        tstWritePattern(pVM);
+        for (uint32_t i = 0; i < TST_PAGES; i++)
+        {
+            RTGCPHYS const GCPhys = TST_GCPHYS_FIRST + i * PAGE_SIZE;
+            tstPGMFillPattern(abExpect, GCPhys);
+            RTTESTI_CHECK_RC_BREAK(PGMR3PhysReadExternal(pVM, GCPhys, abPage, PAGE_SIZE), VINF_SUCCESS);
+            RTTESTI_CHECK_MSG(!memcmp(abPage, abExpect, PAGE_SIZE), ("%RGp\n", GCPhys));
+        }
+    }
+
+    RTTESTI_CHECK_RC_OK(VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstDeregisterHandler, 1, pVM));
+}
+
+
+/**
+ * Ranges outside RAM are refused and don't leave a count behind.
+ */
+static void tstReportInvalid(PVM pVM)
+{
+    RTTestSub(g_hTest, "Invalid");
+
+    bool fSavedQuiet    = RTAssertSetQuiet(true);
+    bool fSavedMayPanic = RTAssertSetMayPanic(false);
+    uint64_t cPagesFreed;
+    int rc = tstReportRange(pVM, TST_GCPHYS_FIRST + 1, 1, &cPagesFreed);
+    if (rc != VERR_NOT_IMPLEMENTED)
+    {
+        RTTESTI_CHECK_RC(rc, VERR_INVALID_PARAMETER);
+        RTTESTI_CHECK_RC(tstReportRange(pVM, TST_GCPHYS_FIRST, UINT64_C(1) << 40, &cPagesFreed), VERR_INVALID_PARAMETER);
+        RTTESTI_CHECK(cPagesFreed == UINT64_MAX);
+    }
+    RTAssertSetMayPanic(fSavedMayPanic);
+    RTAssertSetQuiet(fSavedQuiet);
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPGMFreePageReport", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    PVM pVM;
+    int rc = VMR3Create(1, NULL, NULL, NULL, NULL, NULL, &pVM);
+    if (RT_SUCCESS(rc))
+    {
+        tstReportFree(pVM);
+        tstReportInvalid(pVM);
+
+        rc = VMR3Destroy(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
@@ -0,0 +1,130 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Background large page promotion.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "tstPGMCommon.h"
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/pgm.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/initterm.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The 2 MB range populated page by page. */
+#define TST_GCPHYS_FIRST    UINT32_C(0x04000000)
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+
+
+/**
+ * Checks that the pattern is still there.
+ */
+static void tstCheckPattern(PVM pVM)
+{
+    uint8_t abPage[PAGE_SIZE];
+    uint8_t abExpect[PAGE_SIZE];
+    for (RTGCPHYS GCPhys = TST_GCPHYS_FIRST; GCPhys < TST_GCPHYS_FIRST + _2M; GCPhys += PAGE_SIZE)
+    {
+        tstPGMFillPattern(abExpect, GCPhys);
+        RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysReadExternal(pVM, GCPhys, abPage, PAGE_SIZE));
+        RTTESTI_CHECK_MSG_RETV(!memcmp(abPage, abExpect, PAGE_SIZE), ("%RGp\n", GCPhys));
+    }
+}
+
+
+/**
+ * Populates a 2 MB range with 4 KB pages and promotes it.
+ */
+static void tstPromote(PVM pVM)
+{
+    RTTestSub(g_hTest, "Promote");
+
+    uint8_t abPage[PAGE_SIZE];
+    PGMSetLargePageUsage(pVM, false);
+    for (RTGCPHYS GCPhys = TST_GCPHYS_FIRST; GCPhys < TST_GCPHYS_FIRST + _2M; GCPhys += PAGE_SIZE)
+    {
+        tstPGMFillPattern(abPage, GCPhys);
+        RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysWriteExternal(pVM, GCPhys, abPage, PAGE_SIZE, "tstPGMLargePage"));
+    }
+    PGMSetLargePageUsage(pVM, true);
+
+    uint64_t const cPromotedBefore = tstPGMGetStat(pVM, "/PGM/LargePage/Promoted");
+    uint64_t const cRefusedBefore  = tstPGMGetStat(pVM, "/PGM/LargePage/Refused");
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysLargePagePromoteNow(pVM));
+    uint64_t const cPromoted = tstPGMGetStat(pVM, "/PGM/LargePage/Promoted") - cPromotedBefore;
+    uint64_t const cRefused  = tstPGMGetStat(pVM, "/PGM/LargePage/Refused")  - cRefusedBefore;
+    RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "%RU64 ranges promoted, %RU64 refused\n", cPromoted, cRefused);
+
+    /* Either way the content must survive and a refusal mustn't put an end
+       to large pages. */
+    tstCheckPattern(pVM);
+    RTTESTI_CHECK(PGMIsUsingLargePages(pVM));
+    if (!cPromoted)
+    {
+        RTTESTI_CHECK(cRefused > 0);
+        RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "No large pages to be had on this host, skipping the rest\n");
+        return;
+    }
+
+    /* Writing to the large page leaves the rest alone. */
+    memset(abPage, 0x5a, sizeof(abPage));
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysWriteExternal(pVM, TST_GCPHYS_FIRST + _1M, abPage, PAGE_SIZE, "tstPGMLargePage"));
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysReadExternal(pVM, TST_GCPHYS_FIRST + _1M, abPage, PAGE_SIZE));
+    RTTESTI_CHECK(ASMMemIsAll8(abPage, PAGE_SIZE, 0x5a) == NULL);
+    tstPGMFillPattern(abPage, TST_GCPHYS_FIRST + _1M);
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysWriteExternal(pVM, TST_GCPHYS_FIRST + _1M, abPage, PAGE_SIZE, "tstPGMLargePage"));
+
+    /* Already promoted ranges are left alone. */
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysLargePagePromoteNow(pVM));
+    tstCheckPattern(pVM);
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPGMLargePage", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    PVM pVM;
+    int rc = VMR3Create(1, NULL, NULL, NULL, NULL, NULL, &pVM);
+    if (RT_SUCCESS(rc))
+    {
+        tstPromote(pVM);
+
+        rc = VMR3Destroy(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
@@ -0,0 +1,94 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Live save dirty rate and auto-convergence decisions.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <VBox/vmm/pgm.h>
+#include "PGMInternal.h"
+
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+#define NS_PER_SEC  UINT64_C(1000000000)
+
+
+static void tstDirtyRate(void)
+{
+    RTTestISub("Dirty rate");
+
+    /* Nothing saved, the dirty set grew by 1000 in a second. */
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(500, 1500, 0, NS_PER_SEC) == 1000);
+
+    /* A guest dirtying as fast as we save keeps the dirty set constant, the
+       old calculation reported the size of the set instead of the rate. */
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(4000, 4000, 8000, NS_PER_SEC) == 8000);
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(4000, 4000, 8000, 2 * NS_PER_SEC) == 4000);
+
+    /* Converging: we saved more than the guest dirtied. */
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(4000, 1000, 3500, NS_PER_SEC / 2) == 1000);
+
+    /* An idle guest doesn't dirty anything, however large the set. */
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(30000, 20000, 10000, NS_PER_SEC) == 0);
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(30000, 20000, 0, NS_PER_SEC) == 0);
+
+    /* Degenerate intervals and huge rates. */
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(0, 100, 0, 0) == 0);
+    RTTESTI_CHECK(pgmR3LiveCalcDirtyRate(0, UINT32_MAX, UINT64_C(0xffffffff00), 1) == UINT32_MAX);
+}
+
+
+static void tstThrottle(void)
+{
+    RTTestISub("Throttle decision");
+    uint32_t const uPass = PGM_LIVE_THROTTLE_FIRST_PASS + 1;
+
+    /* Guest keeps up with the saving and the downtime target is missed. */
+    RTTESTI_CHECK(pgmR3LiveShouldThrottle(uPass, 8000, 10000, 900, 300));
+
+    /* Too early, estimates are not reliable yet. */
+    RTTESTI_CHECK(!pgmR3LiveShouldThrottle(PGM_LIVE_THROTTLE_FIRST_PASS, 8000, 10000, 900, 300));
+
+    /* Within the downtime target. */
+    RTTESTI_CHECK(!pgmR3LiveShouldThrottle(uPass, 8000, 10000, 300, 300));
+
+    /* A large dirty set that's shrinking is converging on its own.  Taking
+       the size of the set (6000) for the rate would have throttled here. */
+    uint32_t const cDirtyPagesPerSecond = pgmR3LiveCalcDirtyRate(9000, 6000, 7000, NS_PER_SEC);
+    RTTESTI_CHECK(cDirtyPagesPerSecond == 4000);
+    RTTESTI_CHECK(!pgmR3LiveShouldThrottle(uPass, cDirtyPagesPerSecond, 10000, 900, 300));
+    RTTESTI_CHECK(pgmR3LiveShouldThrottle(uPass, 6000, 10000, 900, 300));
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPGMLiveSave", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    tstDirtyRate();
+    tstThrottle();
+
+    return RTTestSummaryAndDestroy(hTest);
+}
@@ -0,0 +1,211 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Page fusion between two VMs.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "tstPGMCommon.h"
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmm.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/pgm.h>
+#include <VBox/sup.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/initterm.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** Where the test pattern goes. */
+#define TST_GCPHYS_FIRST    UINT32_C(0x04000000)
+/** The number of pattern pages. */
+#define TST_PATTERN_PAGES   16
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+
+
+/**
+ * Configures page fusion with a timer that won't get in the way.
+ */
+static DECLCALLBACK(int) tstConfigConstructor(PVM pVM, void *pvUser)
+{
+    NOREF(pvUser);
+    PCFGMNODE pPGM;
+    int rc = tstPGMConfigConstruct(pVM, &pPGM);
+    if (RT_SUCCESS(rc))
+    {
+        PCFGMNODE pRoot = CFGMR3GetRoot(pVM);
+        CFGMR3RemoveValue(pRoot, "PageFusion");
+        rc = CFGMR3InsertInteger(pRoot, "PageFusion", true);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertInteger(pRoot,\"PageFusion\",) -> %Rrc\n", rc), rc);
+        rc = CFGMR3InsertInteger(pPGM, "PageFusionInterval", 3600 * 1000);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertInteger(pPGM,\"PageFusionInterval\",) -> %Rrc\n", rc), rc);
+        rc = CFGMR3InsertInteger(pPGM, "PageFusionPages", _1M);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertInteger(pPGM,\"PageFusionPages\",) -> %Rrc\n", rc), rc);
+    }
+    return rc;
+}
+
+
+static uint32_t tstGetSharedPages(PVM pVM)
+{
+    return (uint32_t)tstPGMGetStat(pVM, "/PGM/Page/cSharedPages");
+}
+
+
+/**
+ * Scans the VM until it has shared pages, waiting for the host wide budget
+ * when it runs out.
+ */
+static int tstScan(PVM pVM)
+{
+    int rc = VINF_SUCCESS;
+    for (uint32_t i = 0; i < 200 && !tstGetSharedPages(pVM); i++)
+    {
+        rc = PGMR3PageFusionScanNow(pVM);
+        if (RT_FAILURE(rc))
+            break;
+        RTThreadSleep(50);
+    }
+    return rc;
+}
+
+
+/**
+ * Writes the same pages to both VMs and checks that they get shared, that the
+ * content stays intact and that writing unshares them again.
+ */
+static void tstFusion(PVM pVM1, PVM pVM2)
+{
+    RTTestSub(g_hTest, "Fusion");
+
+    uint8_t abPage[PAGE_SIZE];
+    uint8_t abExpect[PAGE_SIZE];
+    for (uint32_t i = 0; i < TST_PATTERN_PAGES; i++)
+    {
+        tstPGMFillPattern(abPage, TST_GCPHYS_FIRST + i * PAGE_SIZE);
+        RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysWriteExternal(pVM1, TST_GCPHYS_FIRST + i * PAGE_SIZE, abPage, PAGE_SIZE, "tstPGMPageFusion"));
+        RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysWriteExternal(pVM2, TST_GCPHYS_FIRST + i * PAGE_SIZE, abPage, PAGE_SIZE, "tstPGMPageFusion"));
+    }
+
+    int rc = tstScan(pVM1);
+    if (rc == VERR_NOT_SUPPORTED)
+    {
+        RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "Page fusion isn't supported in this GMM mode, skipping\n");
+        return;
+    }
+    RTTESTI_CHECK_RC_OK_RETV(rc);
+    RTTESTI_CHECK_RC_OK_RETV(tstScan(pVM2));
+    /* The first VM picks up the pages the second one turned into shared ones. */
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PageFusionScanNow(pVM1));
+    RTTESTI_CHECK(tstGetSharedPages(pVM1) > 0);
+    RTTESTI_CHECK(tstGetSharedPages(pVM2) > 0);
+    RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "%u + %u shared pages\n", tstGetSharedPages(pVM1), tstGetSharedPages(pVM2));
+
+    for (uint32_t i = 0; i < TST_PATTERN_PAGES; i++)
+    {
+        tstPGMFillPattern(abExpect, TST_GCPHYS_FIRST + i * PAGE_SIZE);
+        RTTESTI_CHECK_RC_OK(PGMR3PhysReadExternal(pVM1, TST_GCPHYS_FIRST + i * PAGE_SIZE, abPage, PAGE_SIZE));
+        RTTESTI_CHECK(!memcmp(abPage, abExpect, PAGE_SIZE));
+        RTTESTI_CHECK_RC_OK(PGMR3PhysReadExternal(pVM2, TST_GCPHYS_FIRST + i * PAGE_SIZE, abPage, PAGE_SIZE));
+        RTTESTI_CHECK(!memcmp(abPage, abExpect, PAGE_SIZE));
+    }
+
+    /* Copy on write. */
+    memset(abPage, 0x5a, sizeof(abPage));
+    RTTESTI_CHECK_RC_OK(PGMR3PhysWriteExternal(pVM1, TST_GCPHYS_FIRST, abPage, PAGE_SIZE, "tstPGMPageFusion"));
+    RTTESTI_CHECK_RC_OK(PGMR3PhysReadExternal(pVM1, TST_GCPHYS_FIRST, abPage, PAGE_SIZE));
+    RTTESTI_CHECK(ASMMemIsAll8(abPage, PAGE_SIZE, 0x5a) == NULL);
+    tstPGMFillPattern(abExpect, TST_GCPHYS_FIRST);
+    RTTESTI_CHECK_RC_OK(PGMR3PhysReadExternal(pVM2, TST_GCPHYS_FIRST, abPage, PAGE_SIZE));
+    RTTESTI_CHECK(!memcmp(abPage, abExpect, PAGE_SIZE));
+}
+
+
+static int tstSetBudget(PSUPDRVSESSION pSession, uint64_t cNsBudget)
+{
+    GCFGMVALUEREQ Req;
+    RT_ZERO(Req);
+    Req.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+    Req.Hdr.cbReq    = sizeof(Req);
+    Req.pSession     = pSession;
+    Req.u64Value     = cNsBudget;
+    strcpy(Req.szName, "/GMM/PageFusionBudget");
+    return SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_GCFGM_SET_VALUE, 0, &Req.Hdr);
+}
+
+
+/**
+ * The host wide budget can only be changed by the owner of the first VM.
+ */
+static void tstBudget(PVM pVM)
+{
+    RTTestSub(g_hTest, "Budget");
+
+    RTTESTI_CHECK_RC(tstSetBudget(pVM->pSession, 2 * RT_NS_1SEC), VERR_OUT_OF_RANGE);
+    RTTESTI_CHECK_RC(tstSetBudget((PSUPDRVSESSION)((uintptr_t)pVM->pSession + 8), 1000000), VERR_INVALID_PARAMETER);
+
+    /* Another VM process on the host may have been first. */
+    int rc = tstSetBudget(pVM->pSession, 1000000);
+    if (rc != VERR_ACCESS_DENIED)
+        RTTESTI_CHECK_RC_OK(rc);
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPGMPageFusion", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    PVM pVM1;
+    int rc = VMR3Create(1, NULL, NULL, NULL, tstConfigConstructor, NULL, &pVM1);
+    if (RT_SUCCESS(rc))
+    {
+        PVM pVM2;
+        rc = VMR3Create(1, NULL, NULL, NULL, tstConfigConstructor, NULL, &pVM2);
+        if (RT_SUCCESS(rc))
+        {
+            tstFusion(pVM1, pVM2);
+            tstBudget(pVM2);
+
+            rc = VMR3Destroy(pVM2);
+            RTTESTI_CHECK_RC_OK(rc);
+        }
+        else
+            RTTestFailed(g_hTest, "VMR3Create(2) -> %Rrc", rc);
+
+        rc = VMR3Destroy(pVM1);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create(1) -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
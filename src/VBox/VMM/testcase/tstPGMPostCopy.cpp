@@ -0,0 +1,287 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Post-copy teleportation within one VM.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "tstPGMCommon.h"
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/pgm.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/file.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** Where the test pattern goes. */
+#define TST_GCPHYS_FIRST    UINT32_C(0x04000000)
+/** The number of pattern pages. */
+#define TST_PATTERN_PAGES   16
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/** A page the "source" has sent. */
+typedef struct TSTPAGE
+{
+    RTGCPHYS    GCPhys;
+    bool        fSent;
+    uint8_t     abPage[PAGE_SIZE];
+} TSTPAGE;
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+/** The pages saved by PGMR3PostCopyNextPage. */
+static TSTPAGE             *g_paPages;
+static uint32_t             g_cPages;
+/** The number of requests seen by tstRequest. */
+static uint32_t volatile    g_cRequests;
+/** Set when the post-copy runtime error has been raised. */
+static bool volatile        g_fAbortError;
+
+
+static TSTPAGE *tstFindPage(RTGCPHYS GCPhys)
+{
+    for (uint32_t i = 0; i < g_cPages; i++)
+        if (g_paPages[i].GCPhys == GCPhys)
+            return &g_paPages[i];
+    return NULL;
+}
+
+
+/**
+ * Plays the source, handing over the requested page right away.
+ */
+static DECLCALLBACK(int) tstRequest(PVM pVM, RTGCPHYS GCPhys, void *pvUser)
+{
+    NOREF(pvUser);
+    ASMAtomicIncU32(&g_cRequests);
+    TSTPAGE *pPage = tstFindPage(GCPhys);
+    RTTEST_CHECK_RET(g_hTest, pPage, VERR_NOT_FOUND);
+    pPage->fSent = true;
+    return PGMR3PostCopyPageArrived(pVM, pPage->GCPhys, pPage->abPage);
+}
+
+
+/**
+ * Plays a source that has gone away.
+ */
+static DECLCALLBACK(int) tstRequestBroken(PVM pVM, RTGCPHYS GCPhys, void *pvUser)
+{
+    NOREF(pVM); NOREF(GCPhys); NOREF(pvUser);
+    ASMAtomicIncU32(&g_cRequests);
+    return VERR_NET_CONNECTION_RESET_BY_PEER;
+}
+
+
+static DECLCALLBACK(void) tstAtRuntimeError(PVM pVM, void *pvUser, uint32_t fFlags, const char *pszErrorId,
+                                            const char *pszFormat, va_list va)
+{
+    NOREF(pVM); NOREF(pvUser); NOREF(pszFormat); NOREF(va);
+    if (!strcmp(pszErrorId, "PGMPostCopyAborted"))
+    {
+        RTTEST_CHECK(g_hTest, fFlags & VMSETRTERR_FLAGS_FATAL);
+        ASMAtomicWriteBool(&g_fAbortError, true);
+    }
+}
+
+
+/**
+ * Saves the VM in post-copy mode and collects the remote pages like the
+ * teleporter source would, then trashes the pattern.
+ */
+static int tstSave(PVM pVM, const char *pszFilename)
+{
+    uint8_t abPage[PAGE_SIZE];
+    for (uint32_t i = 0; i < TST_PATTERN_PAGES; i++)
+    {
+        RTGCPHYS GCPhys = TST_GCPHYS_FIRST + i * PAGE_SIZE;
+        tstPGMFillPattern(abPage, GCPhys);
+        RTTEST_CHECK_RC_OK_RET(g_hTest, PGMR3PhysWriteExternal(pVM, GCPhys, abPage, PAGE_SIZE, "tstPGMPostCopy"), VERR_GENERAL_FAILURE);
+    }
+
+    RTTEST_CHECK_RC_OK_RET(g_hTest, PGMR3PostCopyEnable(pVM), VERR_GENERAL_FAILURE);
+    bool fSuspended = false;
+    RTTEST_CHECK_RC_OK_RET(g_hTest, VMR3Save(pVM, pszFilename, false /*fContinueAfterwards*/, NULL, NULL, &fSuspended),
+                           VERR_GENERAL_FAILURE);
+
+    RTMemFree(g_paPages);
+    g_paPages = NULL;
+    g_cPages  = 0;
+    uint32_t cAlloc = 0;
+    int rc;
+    for (;;)
+    {
+        if (g_cPages >= cAlloc)
+        {
+            cAlloc += 256;
+            g_paPages = (TSTPAGE *)RTMemRealloc(g_paPages, cAlloc * sizeof(g_paPages[0]));
+            RTTEST_CHECK_RET(g_hTest, g_paPages, VERR_NO_MEMORY);
+        }
+        g_paPages[g_cPages].fSent = false;
+        rc = PGMR3PostCopyNextPage(pVM, NIL_RTGCPHYS, &g_paPages[g_cPages].GCPhys, g_paPages[g_cPages].abPage);
+        if (RT_FAILURE(rc))
+            break;
+        g_cPages++;
+    }
+    RTTEST_CHECK_RC_RET(g_hTest, rc, VERR_EOF, rc);
+    RTTEST_CHECK_RC_OK_RET(g_hTest, PGMR3PostCopyTerm(pVM), VERR_GENERAL_FAILURE);
+    RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "%u remote pages\n", g_cPages);
+    for (uint32_t i = 0; i < TST_PATTERN_PAGES; i++)
+        RTTEST_CHECK_RET(g_hTest, tstFindPage(TST_GCPHYS_FIRST + i * PAGE_SIZE), VERR_NOT_FOUND);
+
+    memset(abPage, 0x5a, sizeof(abPage));
+    for (uint32_t i = 0; i < TST_PATTERN_PAGES; i++)
+        PGMR3PhysWriteExternal(pVM, TST_GCPHYS_FIRST + i * PAGE_SIZE, abPage, PAGE_SIZE, "tstPGMPostCopy");
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Loads the state with some pages on demand, the rest pushed.
+ */
+static void tstTransfer(PVM pVM, const char *pszFilename)
+{
+    RTTestSub(g_hTest, "Transfer");
+    if (RT_FAILURE(tstSave(pVM, pszFilename)))
+        return;
+
+    RTTESTI_CHECK_RC_OK_RETV(VMR3LoadFromFile(pVM, pszFilename, NULL, NULL));
+    g_cRequests = 0;
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PostCopyStart(pVM, tstRequest, NULL));
+    RTTESTI_CHECK(PGMR3PostCopyGetOutstanding(pVM) == g_cPages);
+
+    /* Every other pattern page on demand. */
+    uint8_t abPage[PAGE_SIZE];
+    uint8_t abExpect[PAGE_SIZE];
+    for (uint32_t i = 0; i < TST_PATTERN_PAGES; i += 2)
+    {
+        RTGCPHYS GCPhys = TST_GCPHYS_FIRST + i * PAGE_SIZE;
+        tstPGMFillPattern(abExpect, GCPhys);
+        RTTESTI_CHECK_RC_OK(PGMR3PhysReadExternal(pVM, GCPhys, abPage, PAGE_SIZE));
+        RTTESTI_CHECK(!memcmp(abPage, abExpect, PAGE_SIZE));
+    }
+    RTTESTI_CHECK(g_cRequests == TST_PATTERN_PAGES / 2);
+
+    /* Push the rest, the handlers go away with the last one. */
+    for (uint32_t i = 0; i < g_cPages; i++)
+        if (!g_paPages[i].fSent)
+            RTTESTI_CHECK_RC_OK(PGMR3PostCopyPageArrived(pVM, g_paPages[i].GCPhys, g_paPages[i].abPage));
+    for (uint32_t cMsWait = 0; PGMR3PostCopyGetOutstanding(pVM) && cMsWait < 10000; cMsWait += 10)
+        RTThreadSleep(10);
+    RTTESTI_CHECK(PGMR3PostCopyGetOutstanding(pVM) == 0);
+
+    for (uint32_t i = 1; i < TST_PATTERN_PAGES; i += 2)
+    {
+        RTGCPHYS GCPhys = TST_GCPHYS_FIRST + i * PAGE_SIZE;
+        tstPGMFillPattern(abExpect, GCPhys);
+        RTTESTI_CHECK_RC_OK(PGMR3PhysReadExternal(pVM, GCPhys, abPage, PAGE_SIZE));
+        RTTESTI_CHECK(!memcmp(abPage, abExpect, PAGE_SIZE));
+    }
+    RTTESTI_CHECK(g_cRequests == TST_PATTERN_PAGES / 2);
+    RTTESTI_CHECK(!g_fAbortError);
+    RTTESTI_CHECK_RC(PGMR3PostCopyTerm(pVM), VINF_SUCCESS);
+}
+
+
+/**
+ * Loses the source, the accesses must not fail but stop the VM.
+ */
+static void tstAbort(PVM pVM, const char *pszFilename)
+{
+    RTTestSub(g_hTest, "Abort");
+    if (RT_FAILURE(tstSave(pVM, pszFilename)))
+        return;
+
+    RTTESTI_CHECK_RC_OK_RETV(VMR3LoadFromFile(pVM, pszFilename, NULL, NULL));
+    g_cRequests = 0;
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PostCopyStart(pVM, tstRequestBroken, NULL));
+
+    uint8_t abPage[PAGE_SIZE];
+    RTTESTI_CHECK_RC(PGMR3PhysReadExternal(pVM, TST_GCPHYS_FIRST, abPage, PAGE_SIZE), VINF_SUCCESS);
+    RTTESTI_CHECK(ASMMemIsAll8(abPage, PAGE_SIZE, 0xff) == NULL);
+    RTTESTI_CHECK(g_cRequests == 1);
+
+    /* After PGMR3PostCopyTerm nobody is asked any more. */
+    RTTESTI_CHECK_RC(PGMR3PostCopyTerm(pVM), VERR_PGM_POST_COPY_ABORTED);
+    RTTESTI_CHECK_RC(PGMR3PhysReadExternal(pVM, TST_GCPHYS_FIRST + PAGE_SIZE, abPage, PAGE_SIZE), VINF_SUCCESS);
+    RTTESTI_CHECK(ASMMemIsAll8(abPage, PAGE_SIZE, 0xff) == NULL);
+    RTTESTI_CHECK(g_cRequests == 1);
+
+    for (uint32_t cMsWait = 0; !g_fAbortError && cMsWait < 10000; cMsWait += 10)
+        RTThreadSleep(10);
+    RTTESTI_CHECK(g_fAbortError);
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPGMPostCopy", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    char szFilename[RTPATH_MAX];
+    RTTESTI_CHECK_RC_OK_RET(RTPathTemp(szFilename, sizeof(szFilename)), RTTestSummaryAndDestroy(g_hTest));
+    RTTESTI_CHECK_RC_OK_RET(RTPathAppend(szFilename, sizeof(szFilename), "tstPGMPostCopy.sav"),
+                            RTTestSummaryAndDestroy(g_hTest));
+
+    PVM pVM;
+    int rc = VMR3Create(1, NULL, NULL, NULL, NULL, NULL, &pVM);
+    if (RT_SUCCESS(rc))
+    {
+        RTTESTI_CHECK_RC_OK(VMR3AtRuntimeErrorRegister(pVM, tstAtRuntimeError, NULL));
+
+        /* Saving requires a running or suspended VM, stop it before the guest
+           gets anywhere near the pattern. */
+        rc = VMR3PowerOn(pVM);
+        if (RT_SUCCESS(rc))
+            rc = VMR3Suspend(pVM);
+        if (RT_SUCCESS(rc))
+        {
+            tstTransfer(pVM, szFilename);
+            tstAbort(pVM, szFilename);
+        }
+        else
+            RTTestFailed(g_hTest, "Failed to power on and suspend the VM: %Rrc", rc);
+
+        rc = VMR3PowerOff(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+        rc = VMR3Destroy(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create -> %Rrc", rc);
+
+    RTFileDelete(szFilename);
+    RTMemFree(g_paPages);
+    return RTTestSummaryAndDestroy(g_hTest);
+}
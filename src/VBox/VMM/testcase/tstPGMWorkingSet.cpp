@@ -0,0 +1,182 @@
+/* $Id$ */
+/** @file
+ * PGM Testcase - Working set estimator.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include "tstPGMCommon.h"
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmapi.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/pgm.h>
+#include <VBox/err.h>
+#include <iprt/initterm.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The RAM written to before the first window. */
+#define TST_GCPHYS_RAM_FIRST    UINT32_C(0x00100000)
+#define TST_GCPHYS_RAM_END      UINT32_C(0x08000000)
+/** The range written to during the estimate window. */
+#define TST_GCPHYS_HOT_FIRST    UINT32_C(0x02000000)
+#define TST_GCPHYS_HOT_END      UINT32_C(0x04000000)
+/** The range written to while fault tolerance is write monitoring. */
+#define TST_GCPHYS_FT_FIRST     UINT32_C(0x05000000)
+#define TST_GCPHYS_FT_END       UINT32_C(0x06000000)
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+
+
+/**
+ * Enables the estimator with plenty of samples and a timer that won't get in
+ * the way.
+ */
+static DECLCALLBACK(int) tstConfigConstructor(PVM pVM, void *pvUser)
+{
+    NOREF(pvUser);
+    PCFGMNODE pPGM;
+    int rc = tstPGMConfigConstruct(pVM, &pPGM);
+    if (RT_SUCCESS(rc))
+    {
+        rc = CFGMR3InsertInteger(pPGM, "WorkingSet", true);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertInteger(pPGM,\"WorkingSet\",) -> %Rrc\n", rc), rc);
+        rc = CFGMR3InsertInteger(pPGM, "WorkingSetSamplePages", _64K);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertInteger(pPGM,\"WorkingSetSamplePages\",) -> %Rrc\n", rc), rc);
+        rc = CFGMR3InsertInteger(pPGM, "WorkingSetInterval", 3600 * 1000);
+        RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc), ("CFGMR3InsertInteger(pPGM,\"WorkingSetInterval\",) -> %Rrc\n", rc), rc);
+    }
+    return rc;
+}
+
+
+static int tstWrite(PVM pVM, RTGCPHYS GCPhysFirst, RTGCPHYS GCPhysEnd, uint8_t bFill)
+{
+    uint8_t abPage[PAGE_SIZE];
+    memset(abPage, bFill, sizeof(abPage));
+    for (RTGCPHYS GCPhys = GCPhysFirst; GCPhys < GCPhysEnd; GCPhys += PAGE_SIZE)
+    {
+        int rc = PGMR3PhysWriteExternal(pVM, GCPhys, abPage, PAGE_SIZE, "tstPGMWorkingSet");
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Writes to a known part of RAM and checks that the estimate is about that
+ * size, and that it drops to nothing once the writing stops.
+ */
+static void tstEstimate(PVM pVM)
+{
+    RTTestSub(g_hTest, "Estimate");
+
+    /* Allocate everything so all the samples are write monitored ones. */
+    RTTESTI_CHECK_RC_OK_RETV(tstWrite(pVM, TST_GCPHYS_RAM_FIRST, TST_GCPHYS_RAM_END, 0x11));
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3WorkingSetNextWindow(pVM));
+
+    RTTESTI_CHECK_RC_OK_RETV(tstWrite(pVM, TST_GCPHYS_HOT_FIRST, TST_GCPHYS_HOT_END, 0x22));
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3WorkingSetNextWindow(pVM));
+    uint64_t cbWorkingSet = 0;
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3QueryWorkingSet(pVM, &cbWorkingSet, NULL));
+    RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "Estimate %RU64 bytes for %u bytes written\n",
+                 cbWorkingSet, TST_GCPHYS_HOT_END - TST_GCPHYS_HOT_FIRST);
+    RTTESTI_CHECK_MSG(   cbWorkingSet >= 30 * _1M
+                      && cbWorkingSet <= 34 * _1M, ("%RU64\n", cbWorkingSet));
+
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3WorkingSetNextWindow(pVM));
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3QueryWorkingSet(pVM, &cbWorkingSet, NULL));
+    RTTESTI_CHECK_MSG(cbWorkingSet <= _1M, ("%RU64\n", cbWorkingSet));
+}
+
+
+static DECLCALLBACK(int) tstWriteProtectRAM(PVM pVM)
+{
+    return PGMR3PhysWriteProtectRAM(pVM);
+}
+
+
+static DECLCALLBACK(int) tstEnumDirtyFTPage(PVM pVM, RTGCPHYS GCPhys, uint8_t *pRange, unsigned cbRange, void *pvUser)
+{
+    NOREF(pVM); NOREF(pRange);
+    RTGCPHYS const GCPhysFirst = RT_MAX(GCPhys, TST_GCPHYS_FT_FIRST);
+    RTGCPHYS const GCPhysEnd   = RT_MIN(GCPhys + cbRange, TST_GCPHYS_FT_END);
+    if (GCPhysFirst < GCPhysEnd)
+        *(uint64_t *)pvUser += GCPhysEnd - GCPhysFirst;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Ending a window while all of RAM is write monitored for fault tolerance
+ * mustn't take the protection of the sampled pages away from it, or it would
+ * miss the writes to them.
+ */
+static void tstFaultTolerance(PVM pVM)
+{
+    RTTestSub(g_hTest, "Fault tolerance");
+
+    /* A window with monitored samples, then FT protects the rest of RAM. */
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3WorkingSetNextWindow(pVM));
+    RTTESTI_CHECK_RC_OK_RETV(VMR3ReqCallWait(pVM, VMCPUID_ANY, (PFNRT)tstWriteProtectRAM, 1, pVM));
+    uint64_t cbDirty = 0;
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysEnumDirtyFTPages(pVM, tstEnumDirtyFTPage, &cbDirty));
+
+    /* The window ends in the middle of FT's. */
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3WorkingSetNextWindow(pVM));
+
+    /* Every page written to must be dirty at the next FT sync. */
+    RTTESTI_CHECK_RC_OK_RETV(tstWrite(pVM, TST_GCPHYS_FT_FIRST, TST_GCPHYS_FT_END, 0x33));
+    RTTESTI_CHECK_RC_OK_RETV(VMR3ReqCallWait(pVM, VMCPUID_ANY, (PFNRT)tstWriteProtectRAM, 1, pVM));
+    cbDirty = 0;
+    RTTESTI_CHECK_RC_OK_RETV(PGMR3PhysEnumDirtyFTPages(pVM, tstEnumDirtyFTPage, &cbDirty));
+    RTTESTI_CHECK_MSG(cbDirty == TST_GCPHYS_FT_END - TST_GCPHYS_FT_FIRST, ("%RU64\n", cbDirty));
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstPGMWorkingSet", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    PVM pVM;
+    int rc = VMR3Create(1, NULL, NULL, NULL, tstConfigConstructor, NULL, &pVM);
+    if (RT_SUCCESS(rc))
+    {
+        tstEstimate(pVM);
+        tstFaultTolerance(pVM);
+
+        rc = VMR3Destroy(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
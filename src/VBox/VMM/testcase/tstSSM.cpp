@@ -20,6 +20,7 @@
 *   Header Files                                                               *
 *******************************************************************************/
 #include <VBox/vmm/ssm.h>
+#include "SSMInternal.h" /* cZipThreads */
 #include "VMInternal.h" /* createFakeVM */
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/uvm.h>
@@ -750,40 +751,51 @@ int main(int argc, char **argv)
     }
 
     /*
-     * Attempt a save.
+     * Attempt a save and a load, first doing the compression on the EMT and
+     * then with the thread pool to see what we gain.  The file from the last
+     * round is used by the tests further down.
      */
-    uint64_t u64Start = RTTimeNanoTS();
-    rc = SSMR3Save(pVM, pszFilename, NULL, NULL, SSMAFTER_DESTROY, NULL, NULL);
-    if (RT_FAILURE(rc))
+    uint64_t const cbData = TSTSSM_ITEM_SIZE + 512*_1M + sizeof(gabBigMem);
+    uint32_t const cZipThreadsDef = RT_MAX(pVM->ssm.s.cZipThreads, 1);
+    uint64_t u64Start;
+    uint64_t u64Elapsed;
+    for (unsigned iRound = 0; iRound < 2; iRound++)
     {
-        RTPrintf("SSMR3Save #1 -> %Rrc\n", rc);
-        return 1;
-    }
-    uint64_t u64Elapsed = RTTimeNanoTS() - u64Start;
-    RTPrintf("tstSSM: Saved in %'RI64 ns\n", u64Elapsed);
+        pVM->ssm.s.cZipThreads = iRound == 0 ? 0 : cZipThreadsDef;
+        RTPrintf("tstSSM: Round #%u, %u (de)compression threads\n", iRound + 1, pVM->ssm.s.cZipThreads);
 
-    RTFSOBJINFO Info;
-    rc = RTPathQueryInfo(pszFilename, &Info, RTFSOBJATTRADD_NOTHING);
-    if (RT_FAILURE(rc))
-    {
-        RTPrintf("tstSSM: failed to query file size: %Rrc\n", rc);
-        return 1;
-    }
-    RTPrintf("tstSSM: file size %'RI64 bytes\n", Info.cbObject);
+        u64Start = RTTimeNanoTS();
+        rc = SSMR3Save(pVM, pszFilename, NULL, NULL, SSMAFTER_DESTROY, NULL, NULL);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("SSMR3Save #1 -> %Rrc\n", rc);
+            return 1;
+        }
+        u64Elapsed = RTTimeNanoTS() - u64Start;
+        RTPrintf("tstSSM: Saved in %'RI64 ns (%'RU64 MB/s)\n", u64Elapsed,
+                 cbData * RT_NS_1SEC / RT_MAX(u64Elapsed, 1) / _1M);
 
-    /*
-     * Attempt a load.
-     */
-    u64Start = RTTimeNanoTS();
-    rc = SSMR3Load(pVM, pszFilename, NULL /*pStreamOps*/, NULL /*pStreamOpsUser*/,
-                   SSMAFTER_RESUME, NULL /*pfnProgress*/, NULL /*pvProgressUser*/);
-    if (RT_FAILURE(rc))
-    {
-        RTPrintf("SSMR3Load #1 -> %Rrc\n", rc);
-        return 1;
+        RTFSOBJINFO Info;
+        rc = RTPathQueryInfo(pszFilename, &Info, RTFSOBJATTRADD_NOTHING);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("tstSSM: failed to query file size: %Rrc\n", rc);
+            return 1;
+        }
+        RTPrintf("tstSSM: file size %'RI64 bytes\n", Info.cbObject);
+
+        u64Start = RTTimeNanoTS();
+        rc = SSMR3Load(pVM, pszFilename, NULL /*pStreamOps*/, NULL /*pStreamOpsUser*/,
+                       SSMAFTER_RESUME, NULL /*pfnProgress*/, NULL /*pvProgressUser*/);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("SSMR3Load #1 -> %Rrc\n", rc);
+            return 1;
+        }
+        u64Elapsed = RTTimeNanoTS() - u64Start;
+        RTPrintf("tstSSM: Loaded in %'RI64 ns (%'RU64 MB/s)\n", u64Elapsed,
+                 cbData * RT_NS_1SEC / RT_MAX(u64Elapsed, 1) / _1M);
     }
-    u64Elapsed = RTTimeNanoTS() - u64Start;
-    RTPrintf("tstSSM: Loaded in %'RI64 ns\n", u64Elapsed);
 
     /*
      * Validate it.
@@ -0,0 +1,354 @@
+/* $Id$ */
+/** @file
+ * STAM Testcase - Sample registration, lookup, enumeration and binary
+ *                 snapshots.
+ */
+
+/*
+ * Copyright (C) 2012 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*******************************************************************************
+*   Header Files                                                               *
+*******************************************************************************/
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/stam.h>
+#include <VBox/err.h>
+#include <iprt/initterm.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*******************************************************************************
+*   Defined Constants And Macros                                               *
+*******************************************************************************/
+/** The number of /tstSTAM/DevN/PortN/StatN samples, 8 x 16 x 16. */
+#define TST_DEV_SAMPLES     2048
+/** The number of /tstSTAM/Wide/ItemN samples, all siblings. */
+#define TST_WIDE_SAMPLES    1024
+
+
+/*******************************************************************************
+*   Structures and Typedefs                                                    *
+*******************************************************************************/
+/**
+ * tstEnumCallback state.
+ */
+typedef struct TSTENUMSTATE
+{
+    /** The number of samples enumerated. */
+    uint32_t    cSamples;
+    /** Whether they came in sorted order. */
+    bool        fInOrder;
+    /** The sample pointer of the last one. */
+    void       *pvLast;
+    /** The name of the last one. */
+    char        szPrev[128];
+} TSTENUMSTATE;
+
+
+/**
+ * tstBinLayoutCallback state.
+ */
+typedef struct TSTBINLAYOUT
+{
+    /** The number of samples enumerated. */
+    uint32_t    cSamples;
+    /** The sample IDs. */
+    uint32_t    aidSamples[8];
+    /** Where their values start. */
+    uint32_t    aiFirstValues[8];
+    /** The number of values they have. */
+    uint32_t    acValues[8];
+} TSTBINLAYOUT;
+
+
+/*******************************************************************************
+*   Global Variables                                                           *
+*******************************************************************************/
+static RTTEST               g_hTest;
+static uint32_t             g_au32DevSamples[TST_DEV_SAMPLES];
+static uint32_t             g_au32WideSamples[TST_WIDE_SAMPLES];
+static STAMCOUNTER          g_BinCounter;
+static STAMPROFILE          g_BinProfile;
+static STAMRATIOU32         g_BinRatio;
+static uint32_t             g_u32Bin;
+static uint32_t             g_u32BinCallback;
+static uint32_t             g_u32BinOther;
+
+
+static int tstRegisterDev(PVM pVM, uint32_t i)
+{
+    return STAMR3RegisterF(pVM, &g_au32DevSamples[i], STAMTYPE_U32, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT, NULL,
+                           "/tstSTAM/Dev%u/Port%u/Stat%u", i % 8, (i / 8) % 16, i / 128);
+}
+
+
+static int tstRegisterWide(PVM pVM, uint32_t i)
+{
+    return STAMR3RegisterF(pVM, &g_au32WideSamples[i], STAMTYPE_U32, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT, NULL,
+                           "/tstSTAM/Wide/Item%u", i);
+}
+
+
+static DECLCALLBACK(int) tstEnumCallback(const char *pszName, STAMTYPE enmType, void *pvSample, STAMUNIT enmUnit,
+                                         STAMVISIBILITY enmVisiblity, const char *pszDesc, void *pvUser)
+{
+    NOREF(enmType); NOREF(enmUnit); NOREF(enmVisiblity); NOREF(pszDesc);
+    TSTENUMSTATE *pState = (TSTENUMSTATE *)pvUser;
+    /* The names only have alphanumeric components, so strcmp order is the
+       per component order STAM sorts by. */
+    if (pState->cSamples && strcmp(pState->szPrev, pszName) >= 0)
+        pState->fInOrder = false;
+    RTStrCopy(pState->szPrev, sizeof(pState->szPrev), pszName);
+    pState->pvLast = pvSample;
+    pState->cSamples++;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Enumerates the samples matching a pattern, checking their order.
+ *
+ * @returns The number of samples.
+ */
+static uint32_t tstEnum(PVM pVM, const char *pszPat, void **ppvLast)
+{
+    TSTENUMSTATE State;
+    RT_ZERO(State);
+    State.fInOrder = true;
+    RTTESTI_CHECK_RC_OK(STAMR3Enum(pVM, pszPat, tstEnumCallback, &State));
+    RTTESTI_CHECK_MSG(State.fInOrder, ("%s\n", pszPat));
+    if (ppvLast)
+        *ppvLast = State.pvLast;
+    return State.cSamples;
+}
+
+
+/**
+ * Registers the samples in an order that exercises inserting at either end
+ * and in the middle of the lookup tree nodes, and checks the enumerations.
+ */
+static void tstRegister(PVM pVM)
+{
+    RTTestSub(g_hTest, "Register");
+
+    /* 7919 is prime, so this visits every index once in a scattered order. */
+    for (uint32_t i = 0; i < TST_DEV_SAMPLES; i++)
+        RTTESTI_CHECK_RC_OK_RETV(tstRegisterDev(pVM, (i * 7919) % TST_DEV_SAMPLES));
+    /* Back to front, each one shifts and renumbers all its siblings. */
+    for (uint32_t i = TST_WIDE_SAMPLES; i-- > 0;)
+        RTTESTI_CHECK_RC_OK_RETV(tstRegisterWide(pVM, i));
+
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/*", NULL) == TST_DEV_SAMPLES + TST_WIDE_SAMPLES);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Dev3/*", NULL) == TST_DEV_SAMPLES / 8);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Dev*/Port1/*", NULL) == 8 * 16);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/*", NULL) == TST_WIDE_SAMPLES);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Dev3/*|/tstSTAM/Wide/*", NULL) == TST_DEV_SAMPLES / 8 + TST_WIDE_SAMPLES);
+
+    /* Exact names find their own sample. */
+    void *pvSample = NULL;
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/Item0", &pvSample) == 1);
+    RTTESTI_CHECK(pvSample == &g_au32WideSamples[0]);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/Item1000", &pvSample) == 1);
+    RTTESTI_CHECK(pvSample == &g_au32WideSamples[1000]);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Dev5/Port2/Stat9", &pvSample) == 1);
+    RTTESTI_CHECK(pvSample == &g_au32DevSamples[9 * 128 + 2 * 8 + 5]);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Dev5/Port2", NULL) == 0);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/Item10000", NULL) == 0);
+}
+
+
+/**
+ * Deregisters a subtree and every other sibling, checks that what's left is
+ * intact and that it all registers again.
+ */
+static void tstDeregister(PVM pVM)
+{
+    RTTestSub(g_hTest, "Deregister");
+
+    for (uint32_t i = 3; i < TST_DEV_SAMPLES; i += 8)
+        RTTESTI_CHECK_RC_OK_RETV(STAMR3Deregister(pVM, &g_au32DevSamples[i]));
+    for (uint32_t i = 1; i < TST_WIDE_SAMPLES; i += 2)
+        RTTESTI_CHECK_RC_OK_RETV(STAMR3Deregister(pVM, &g_au32WideSamples[i]));
+
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/*", NULL) == TST_DEV_SAMPLES - TST_DEV_SAMPLES / 8 + TST_WIDE_SAMPLES / 2);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Dev3/*", NULL) == 0);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/*", NULL) == TST_WIDE_SAMPLES / 2);
+    void *pvSample = NULL;
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/Item1000", &pvSample) == 1);
+    RTTESTI_CHECK(pvSample == &g_au32WideSamples[1000]);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/Item999", NULL) == 0);
+
+    for (uint32_t i = 3; i < TST_DEV_SAMPLES; i += 8)
+        RTTESTI_CHECK_RC_OK_RETV(tstRegisterDev(pVM, i));
+    for (uint32_t i = 1; i < TST_WIDE_SAMPLES; i += 2)
+        RTTESTI_CHECK_RC_OK_RETV(tstRegisterWide(pVM, i));
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/*", NULL) == TST_DEV_SAMPLES + TST_WIDE_SAMPLES);
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/Wide/Item999", &pvSample) == 1);
+    RTTESTI_CHECK(pvSample == &g_au32WideSamples[999]);
+
+    for (uint32_t i = 0; i < TST_DEV_SAMPLES; i++)
+        RTTESTI_CHECK_RC_OK_RETV(STAMR3Deregister(pVM, &g_au32DevSamples[i]));
+    for (uint32_t i = 0; i < TST_WIDE_SAMPLES; i++)
+        RTTESTI_CHECK_RC_OK_RETV(STAMR3Deregister(pVM, &g_au32WideSamples[i]));
+    RTTESTI_CHECK(tstEnum(pVM, "/tstSTAM/*", NULL) == 0);
+}
+
+
+static DECLCALLBACK(void) tstBinPrintCallback(PVM pVM, void *pvSample, char *pszBuf, size_t cchBuf)
+{
+    NOREF(pVM);
+    RTStrPrintf(pszBuf, cchBuf, "%u", *(uint32_t *)pvSample);
+}
+
+
+static DECLCALLBACK(int) tstBinLayoutCallback(uint32_t idSample, const char *pszName, STAMTYPE enmType, STAMUNIT enmUnit,
+                                              const char *pszDesc, uint32_t iFirstValue, uint32_t cValues, void *pvUser)
+{
+    NOREF(pszName); NOREF(enmType); NOREF(enmUnit); NOREF(pszDesc);
+    TSTBINLAYOUT *pLayout = (TSTBINLAYOUT *)pvUser;
+    if (pLayout->cSamples >= RT_ELEMENTS(pLayout->aidSamples))
+        return VERR_BUFFER_OVERFLOW;
+    pLayout->aidSamples[pLayout->cSamples]    = idSample;
+    pLayout->aiFirstValues[pLayout->cSamples] = iFirstValue;
+    pLayout->acValues[pLayout->cSamples]      = cValues;
+    pLayout->cSamples++;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks the layout and values of a binary snapshot of one sample of each
+ * kind, and that it goes stale when samples come and go.
+ */
+static void tstBinSnapshot(PVM pVM)
+{
+    RTTestSub(g_hTest, "Binary snapshot");
+    PUVM pUVM = pVM->pUVM;
+
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3Register(pVM, &g_BinCounter, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                            "/tstSTAM/Bin/Counter", STAMUNIT_OCCURENCES, NULL));
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3RegisterCallback(pVM, &g_u32BinCallback, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,
+                                                    NULL, tstBinPrintCallback, NULL, "/tstSTAM/Bin/Print"));
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3Register(pVM, &g_BinProfile, STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS,
+                                            "/tstSTAM/Bin/Profile", STAMUNIT_TICKS_PER_CALL, NULL));
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3Register(pVM, &g_BinRatio, STAMTYPE_RATIO_U32, STAMVISIBILITY_ALWAYS,
+                                            "/tstSTAM/Bin/Ratio", STAMUNIT_PCT, NULL));
+    /* Unused samples are included too, so the layout doesn't change with the values. */
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3Register(pVM, &g_u32Bin, STAMTYPE_U32, STAMVISIBILITY_USED,
+                                            "/tstSTAM/Bin/U32", STAMUNIT_COUNT, NULL));
+
+    PSTAMBINSNAPSHOT hSnapshot;
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3BinSnapshotCreateU(pUVM, "/tstSTAM/Bin/*", &hSnapshot));
+    RTTESTI_CHECK(STAMR3BinSnapshotGetValueCount(hSnapshot) == 1 + 4 + 2 + 1);
+
+    /* Sorted by name, the callback sample has no values. */
+    TSTBINLAYOUT Layout;
+    RT_ZERO(Layout);
+    RTTESTI_CHECK_RC_OK(STAMR3BinSnapshotEnumLayoutU(pUVM, hSnapshot, tstBinLayoutCallback, &Layout));
+    RTTESTI_CHECK(Layout.cSamples == 5);
+    static uint32_t const s_aiFirstValues[5] = { 0, 1, 1, 5, 7 };
+    static uint32_t const s_acValues[5]      = { 1, 0, 4, 2, 1 };
+    for (uint32_t i = 0; i < RT_MIN(Layout.cSamples, 5); i++)
+    {
+        RTTESTI_CHECK_MSG(Layout.aiFirstValues[i] == s_aiFirstValues[i], ("#%u: %u\n", i, Layout.aiFirstValues[i]));
+        RTTESTI_CHECK_MSG(Layout.acValues[i] == s_acValues[i], ("#%u: %u\n", i, Layout.acValues[i]));
+    }
+
+    g_BinCounter.c          = UINT64_C(0x123456789a);
+    g_BinProfile.cPeriods   = 10;
+    g_BinProfile.cTicks     = 1000;
+    g_BinProfile.cTicksMax  = 400;
+    g_BinProfile.cTicksMin  = 20;
+    g_BinRatio.u32A         = 3;
+    g_BinRatio.u32B         = 4;
+    g_u32Bin                = UINT32_MAX;
+    uint64_t au64Values[8 + 1];
+    au64Values[8] = UINT64_C(0xdeadbeefdeadbeef);
+    RTTESTI_CHECK_RC_OK(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, RT_ELEMENTS(au64Values)));
+    RTTESTI_CHECK(au64Values[0] == UINT64_C(0x123456789a));
+    RTTESTI_CHECK(au64Values[1] == 10);
+    RTTESTI_CHECK(au64Values[2] == 1000);
+    RTTESTI_CHECK(au64Values[3] == 400);
+    RTTESTI_CHECK(au64Values[4] == 20);
+    RTTESTI_CHECK(au64Values[5] == 3);
+    RTTESTI_CHECK(au64Values[6] == 4);
+    RTTESTI_CHECK(au64Values[7] == UINT32_MAX);
+    RTTESTI_CHECK(au64Values[8] == UINT64_C(0xdeadbeefdeadbeef));
+
+    /* Later values are picked up, short buffers refused. */
+    g_BinCounter.c++;
+    RTTESTI_CHECK_RC_OK(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, 8));
+    RTTESTI_CHECK(au64Values[0] == UINT64_C(0x123456789b));
+    RTTESTI_CHECK_RC(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, 7), VERR_BUFFER_OVERFLOW);
+
+    /* Registering anything, even outside the pattern, makes it stale. */
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3Register(pVM, &g_u32BinOther, STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                            "/tstSTAM/Other", STAMUNIT_COUNT, NULL));
+    RTTESTI_CHECK_RC(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, 8), VERR_STAM_SNAPSHOT_STALE);
+    RTTESTI_CHECK_RC(STAMR3BinSnapshotEnumLayoutU(pUVM, hSnapshot, tstBinLayoutCallback, &Layout), VERR_STAM_SNAPSHOT_STALE);
+    STAMR3BinSnapshotDestroy(hSnapshot);
+
+    /* A new one works again and the samples keep their IDs. */
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3BinSnapshotCreateU(pUVM, "/tstSTAM/Bin/*", &hSnapshot));
+    TSTBINLAYOUT Layout2;
+    RT_ZERO(Layout2);
+    RTTESTI_CHECK_RC_OK(STAMR3BinSnapshotEnumLayoutU(pUVM, hSnapshot, tstBinLayoutCallback, &Layout2));
+    RTTESTI_CHECK(Layout2.cSamples == Layout.cSamples);
+    RTTESTI_CHECK(!memcmp(Layout2.aidSamples, Layout.aidSamples, sizeof(Layout.aidSamples)));
+    RTTESTI_CHECK_RC_OK(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, 8));
+
+    /* And so does deregistering. */
+    RTTESTI_CHECK_RC_OK(STAMR3Deregister(pVM, &g_u32BinOther));
+    RTTESTI_CHECK_RC(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, 8), VERR_STAM_SNAPSHOT_STALE);
+    STAMR3BinSnapshotDestroy(hSnapshot);
+
+    /* Nothing matching is fine too. */
+    RTTESTI_CHECK_RC_OK_RETV(STAMR3BinSnapshotCreateU(pUVM, "/tstSTAM/NoSuchSample", &hSnapshot));
+    RTTESTI_CHECK(STAMR3BinSnapshotGetValueCount(hSnapshot) == 0);
+    RTTESTI_CHECK_RC_OK(STAMR3BinSnapshotQueryValuesU(pUVM, hSnapshot, au64Values, 0));
+    STAMR3BinSnapshotDestroy(hSnapshot);
+    STAMR3BinSnapshotDestroy(NULL);
+
+    RTTESTI_CHECK_RC_OK(STAMR3Deregister(pVM, &g_BinCounter));
+    RTTESTI_CHECK_RC_OK(STAMR3Deregister(pVM, &g_u32BinCallback));
+    RTTESTI_CHECK_RC_OK(STAMR3Deregister(pVM, &g_BinProfile));
+    RTTESTI_CHECK_RC_OK(STAMR3Deregister(pVM, &g_BinRatio));
+    RTTESTI_CHECK_RC_OK(STAMR3Deregister(pVM, &g_u32Bin));
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstSTAM", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    PVM pVM;
+    int rc = VMR3Create(1, NULL, NULL, NULL, NULL, NULL, &pVM);
+    if (RT_SUCCESS(rc))
+    {
+        tstRegister(pVM);
+        tstDeregister(pVM);
+        tstBinSnapshot(pVM);
+
+        rc = VMR3Destroy(pVM);
+        RTTESTI_CHECK_RC_OK(rc);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
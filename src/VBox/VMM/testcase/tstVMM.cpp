@@ -30,12 +30,15 @@
 #include <iprt/ctype.h>
 #include <iprt/getopt.h>
 #include <iprt/initterm.h>
+#include <iprt/mem.h>
 #include <iprt/message.h>
+#include <iprt/rand.h>
 #include <iprt/semaphore.h>
 #include <iprt/stream.h>
 #include <iprt/string.h>
 #include <iprt/test.h>
 #include <iprt/thread.h>
+#include <iprt/time.h>
 
 
 /*******************************************************************************
@@ -55,6 +58,8 @@ static uint32_t g_cCpus = 1;
 *   Internal Functions                                                         *
 *******************************************************************************/
 VMMR3DECL(int) VMMDoTest(PVM pVM); /* Linked into VMM, see ../VMMTests.cpp. */
+VMMR3DECL(int) VMMDoPdmQueueTest(PVM pVM); /* Linked into VMM, see ../VMMTests.cpp. */
+VMMR3DECL(int) VMMDoTransitionBenchmark(PVM pVM); /* Linked into VMM, see ../VMMTests.cpp. */
 
 
 /** Dummy timer callback. */
@@ -137,6 +142,80 @@ DECLCALLBACK(int) tstTMWorker(PVM pVM, RTTEST hTest)
 }
 
 
+/**
+ * Timer churn benchmark, run on EMT(0).
+ *
+ * Creates a fair number of timers on the virtual clock and keeps re-arming
+ * and stopping them at random deadlines, the way device timers are used,
+ * reporting the average cost of each operation.
+ *
+ * @returns VINF_SUCCESS, test failure is reported via RTTEST.
+ * @param   pVM         Pointer to the VM.
+ * @param   hTest       The test handle.
+ */
+DECLCALLBACK(int) tstTMChurnWorker(PVM pVM, RTTEST hTest)
+{
+    static uint32_t const s_acTimers[] = { 16, 256, 4096 };
+    uint32_t const        cOps = 1000000;
+    int                   rc   = VINF_SUCCESS;
+
+    for (unsigned iTest = 0; iTest < RT_ELEMENTS(s_acTimers); iTest++)
+    {
+        uint32_t const cTimers  = s_acTimers[iTest];
+        PTMTIMER      *papTimers = (PTMTIMER *)RTMemAllocZ(sizeof(papTimers[0]) * cTimers);
+        RTTEST_CHECK_RET(hTest, papTimers != NULL, VERR_NO_MEMORY);
+
+        uint32_t cCreated;
+        for (cCreated = 0; cCreated < cTimers; cCreated++)
+        {
+            rc = TMR3TimerCreateInternal(pVM, TMCLOCK_VIRTUAL, tstTMDummyCallback, NULL, "churn timer", &papTimers[cCreated]);
+            if (RT_FAILURE(rc))
+            {
+                RTTestFailed(hTest, "TMR3TimerCreateInternal: %Rrc\n", rc);
+                break;
+            }
+        }
+
+        if (RT_SUCCESS(rc))
+        {
+            /* Arm them all far enough out that nothing expires while we're busy. */
+            for (uint32_t i = 0; i < cTimers; i++)
+                TMTimerSetMillies(papTimers[i], 60000 + RTRandU32Ex(0, 60000));
+
+            uint64_t cNsSet  = 0;
+            uint64_t cNsStop = 0;
+            uint32_t cSets   = 0;
+            uint32_t cStops  = 0;
+            for (uint32_t iOp = 0; iOp < cOps; iOp++)
+            {
+                PTMTIMER pTimer = papTimers[RTRandU32Ex(0, cTimers - 1)];
+                uint64_t nsStart = RTTimeNanoTS();
+                if ((iOp & 3) == 3 && TMTimerIsActive(pTimer))
+                {
+                    TMTimerStop(pTimer);
+                    cNsStop += RTTimeNanoTS() - nsStart;
+                    cStops++;
+                }
+                else
+                {
+                    TMTimerSetMillies(pTimer, 60000 + RTRandU32Ex(0, 60000));
+                    cNsSet += RTTimeNanoTS() - nsStart;
+                    cSets++;
+                }
+            }
+
+            RTTestValueF(hTest, cNsSet / RT_MAX(cSets, 1), RTTESTUNIT_NS_PER_CALL, "TMTimerSet, %u timers", cTimers);
+            RTTestValueF(hTest, cNsStop / RT_MAX(cStops, 1), RTTESTUNIT_NS_PER_CALL, "TMTimerStop, %u timers", cTimers);
+        }
+
+        for (uint32_t i = 0; i < cCreated; i++)
+            TMR3TimerDestroy(papTimers[i]);
+        RTMemFree(papTimers);
+    }
+    return rc;
+}
+
+
 /** PDMR3LdrEnumModules callback, see FNPDMR3ENUM. */
 static DECLCALLBACK(int)
 tstVMMLdrEnum(PVM pVM, const char *pszFilename, const char *pszName, RTUINTPTR ImageBase, size_t cbImage, bool fGC, void *pvUser)
@@ -202,7 +281,7 @@ int main(int argc, char **argv)
     };
     enum
     {
-        kTstVMMTest_VMM,  kTstVMMTest_TM
+        kTstVMMTest_VMM,  kTstVMMTest_TM, kTstVMMTest_TMChurn, kTstVMMTest_PDMQueue, kTstVMMTest_Transitions
     } enmTestOpt = kTstVMMTest_VMM;
 
     int ch;
@@ -222,6 +301,12 @@ int main(int argc, char **argv)
                     enmTestOpt = kTstVMMTest_VMM;
                 else if (!strcmp("tm", ValueUnion.psz))
                     enmTestOpt = kTstVMMTest_TM;
+                else if (!strcmp("tm-churn", ValueUnion.psz))
+                    enmTestOpt = kTstVMMTest_TMChurn;
+                else if (!strcmp("pdm-queue", ValueUnion.psz))
+                    enmTestOpt = kTstVMMTest_PDMQueue;
+                else if (!strcmp("transitions", ValueUnion.psz))
+                    enmTestOpt = kTstVMMTest_Transitions;
                 else
                 {
                     RTPrintf("tstVMM: unknown test: '%s'\n", ValueUnion.psz);
@@ -230,7 +315,7 @@ int main(int argc, char **argv)
                 break;
 
             case 'h':
-                RTPrintf("usage: tstVMM [--cpus|-c cpus] [--test <vmm|tm>]\n");
+                RTPrintf("usage: tstVMM [--cpus|-c cpus] [--test <vmm|tm|tm-churn|pdm-queue|transitions>]\n");
                 return 1;
 
             case 'V':
@@ -283,6 +368,33 @@ int main(int argc, char **argv)
                     RTTestFailed(hTest, "VMMDoTest failed: rc=%Rrc\n", rc);
                 break;
             }
+
+            case kTstVMMTest_TMChurn:
+            {
+                RTTestSub(hTest, "TM churn");
+                rc = VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)tstTMChurnWorker, 2, pVM, hTest);
+                if (RT_FAILURE(rc))
+                    RTTestFailed(hTest, "tstTMChurnWorker failed: rc=%Rrc\n", rc);
+                break;
+            }
+
+            case kTstVMMTest_PDMQueue:
+            {
+                RTTestSub(hTest, "PDM queue");
+                rc = VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)VMMDoPdmQueueTest, 1, pVM);
+                if (RT_FAILURE(rc))
+                    RTTestFailed(hTest, "VMMDoPdmQueueTest failed: rc=%Rrc\n", rc);
+                break;
+            }
+
+            case kTstVMMTest_Transitions:
+            {
+                RTTestSub(hTest, "Transitions");
+                rc = VMR3ReqCallWait(pVM, 0 /*idDstCpu*/, (PFNRT)VMMDoTransitionBenchmark, 1, pVM);
+                if (RT_FAILURE(rc))
+                    RTTestFailed(hTest, "VMMDoTransitionBenchmark failed: rc=%Rrc\n", rc);
+                break;
+            }
         }
 
         STAMR3Dump(pVM, "*");
@@ -464,8 +464,16 @@
     GEN_CHECK_OFF(PDM, pDevHlpQueueRC);
     GEN_CHECK_OFF(PDMCPU, cQueuedCritSectLeaves);
     GEN_CHECK_OFF(PDMCPU, apQueuedCritSectsLeaves);
+    GEN_CHECK_OFF(PDMCPU, cQueuedCritSectRwShrdLeaves);
+    GEN_CHECK_OFF(PDMCPU, cQueuedCritSectRwExclLeaves);
+    GEN_CHECK_OFF(PDMCPU, apQueuedCritSectRwShrdLeaves);
+    GEN_CHECK_OFF(PDMCPU, apQueuedCritSectRwExclLeaves);
     GEN_CHECK_OFF(PDM, pQueueFlushR0);
     GEN_CHECK_OFF(PDM, pQueueFlushRC);
+    GEN_CHECK_OFF(PDM, paCritSectProfR3);
+    GEN_CHECK_OFF(PDM, paCritSectProfR0);
+    GEN_CHECK_OFF(PDM, paCritSectProfRC);
+    GEN_CHECK_OFF(PDM, cCritSectProf);
     GEN_CHECK_OFF(PDM, StatQueuedCritSectLeaves);
 
     GEN_CHECK_SIZE(PDMDEVINSINT);
@@ -533,10 +541,35 @@
     GEN_CHECK_OFF(PDMCRITSECTINT, pVMR3);
     GEN_CHECK_OFF(PDMCRITSECTINT, pVMR0);
     GEN_CHECK_OFF(PDMCRITSECTINT, pVMRC);
+    GEN_CHECK_OFF(PDMCRITSECTINT, iProf);
+    GEN_CHECK_OFF(PDMCRITSECTINT, cSpinEst);
     GEN_CHECK_OFF(PDMCRITSECTINT, StatContentionRZLock);
     GEN_CHECK_OFF(PDMCRITSECTINT, StatContentionRZUnlock);
     GEN_CHECK_OFF(PDMCRITSECTINT, StatContentionR3);
     GEN_CHECK_OFF(PDMCRITSECTINT, StatLocked);
+    GEN_CHECK_SIZE(PDMCRITSECTPROF);
+    GEN_CHECK_OFF(PDMCRITSECTPROF, u64TscEntered);
+    GEN_CHECK_OFF(PDMCRITSECTPROF, aStatWaitHist);
+    GEN_CHECK_OFF(PDMCRITSECTPROF, aStatHoldHist);
+    GEN_CHECK_OFF(PDMCRITSECTPROF, aCallers);
+    GEN_CHECK_SIZE(PDMCRITSECTRWINT);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, u32Magic);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, fNeedReset);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, u64State);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, hNativeWriter);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, cWriterReads);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, cWriteRecursions);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, hEvtWrite);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, hEvtRead);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pNext);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pvKey);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pVMR3);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pVMR0);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pVMRC);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pszName);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, StatContentionRZEnterShared);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, StatContentionR3EnterExcl);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, StatWriteLocked);
     GEN_CHECK_SIZE(PDMQUEUE);
     GEN_CHECK_OFF(PDMQUEUE, pNext);
     GEN_CHECK_OFF(PDMQUEUE, enmType);
@@ -561,6 +594,10 @@
     GEN_CHECK_OFF(PDMQUEUE, iFreeHead);
     GEN_CHECK_OFF(PDMQUEUE, iFreeTail);
     GEN_CHECK_OFF(PDMQUEUE, pszName);
+    GEN_CHECK_OFF(PDMQUEUE, cLanes);
+    GEN_CHECK_OFF(PDMQUEUE, offLanes);
+    GEN_CHECK_OFF(PDMQUEUE, offItems);
+    GEN_CHECK_OFF(PDMQUEUE, cLaneCacheMax);
     GEN_CHECK_OFF(PDMQUEUE, StatAllocFailures);
     GEN_CHECK_OFF(PDMQUEUE, StatInsert);
     GEN_CHECK_OFF(PDMQUEUE, StatFlush);
@@ -570,6 +607,13 @@
     GEN_CHECK_OFF_DOT(PDMQUEUE, aFreeItems[0].pItemR3);
     GEN_CHECK_OFF_DOT(PDMQUEUE, aFreeItems[0].pItemR0);
     GEN_CHECK_OFF_DOT(PDMQUEUE, aFreeItems[1].pItemRC);
+    GEN_CHECK_SIZE(PDMQUEUELANE);
+    GEN_CHECK_OFF(PDMQUEUELANE, pPendingR3);
+    GEN_CHECK_OFF(PDMQUEUELANE, pPendingR0);
+    GEN_CHECK_OFF(PDMQUEUELANE, pPendingRC);
+    GEN_CHECK_OFF(PDMQUEUELANE, iCacheHead);
+    GEN_CHECK_OFF(PDMQUEUELANE, iCacheTail);
+    GEN_CHECK_OFF(PDMQUEUELANE, aiCache);
     GEN_CHECK_SIZE(PDMDEVHLPTASK);
     GEN_CHECK_OFF(PDMDEVHLPTASK, Core);
     GEN_CHECK_OFF(PDMDEVHLPTASK, pDevInsR3);
@@ -1058,6 +1102,15 @@
     GEN_CHECK_OFF_DOT(TM, aVirtualSyncCatchUpPeriods[1].u32Percentage);
     GEN_CHECK_OFF(TM, pTimer);
     GEN_CHECK_OFF(TM, u32TimerMillies);
+    GEN_CHECK_OFF(TM, fTickless);
+    GEN_CHECK_OFF(TM, fTicklessKickPending);
+    GEN_CHECK_OFF(TM, au64TicklessExpire);
+    GEN_CHECK_OFF(TM, cNsTicklessMaxSleep);
+    GEN_CHECK_OFF(TM, hTicklessEvt);
+    GEN_CHECK_OFF(TM, hTicklessThread);
+    GEN_CHECK_OFF(TM, u64HostWakeupPeriodStart);
+    GEN_CHECK_OFF(TM, StatHostWakeups);
+    GEN_CHECK_OFF(TM, cHostWakeupsPerSec);
     GEN_CHECK_OFF(TM, pFree);
     GEN_CHECK_OFF(TM, pCreated);
     GEN_CHECK_OFF(TM, paTimerQueuesR3);
@@ -1079,8 +1132,7 @@
     GEN_CHECK_OFF_DOT(TMTIMER, u.External.pfnTimer);
     GEN_CHECK_OFF(TMTIMER, enmState);
     GEN_CHECK_OFF(TMTIMER, offScheduleNext);
-    GEN_CHECK_OFF(TMTIMER, offNext);
-    GEN_CHECK_OFF(TMTIMER, offPrev);
+    GEN_CHECK_OFF(TMTIMER, idxActive);
     GEN_CHECK_OFF(TMTIMER, pVMR0);
     GEN_CHECK_OFF(TMTIMER, pVMR3);
     GEN_CHECK_OFF(TMTIMER, pVMRC);
@@ -1091,9 +1143,13 @@
     GEN_CHECK_OFF(TMTIMER, pBigPrev);
     GEN_CHECK_OFF(TMTIMER, pszDesc);
     GEN_CHECK_SIZE(TMTIMERQUEUE);
-    GEN_CHECK_OFF(TMTIMERQUEUE, offActive);
+    GEN_CHECK_OFF(TMTIMERQUEUE, offHeap);
     GEN_CHECK_OFF(TMTIMERQUEUE, offSchedule);
     GEN_CHECK_OFF(TMTIMERQUEUE, enmClock);
+    GEN_CHECK_OFF(TMTIMERQUEUE, cActive);
+    GEN_CHECK_OFF(TMTIMERQUEUE, cHeapAlloc);
+    GEN_CHECK_OFF(TMTIMERQUEUE, uSeqNext);
+    GEN_CHECK_OFF(TMTIMERQUEUE, cTimers);
 
     GEN_CHECK_SIZE(TRPM); // has .mac
     GEN_CHECK_SIZE(TRPMCPU); // has .mac
@@ -1335,6 +1391,9 @@
     GEN_CHECK_OFF(VM, hTraceBufRC);
     GEN_CHECK_OFF(VM, hTraceBufR3);
     GEN_CHECK_OFF(VM, hTraceBufR0);
+    GEN_CHECK_OFF(VM, pTraceBinRC);
+    GEN_CHECK_OFF(VM, pTraceBinR3);
+    GEN_CHECK_OFF(VM, pTraceBinR0);
     GEN_CHECK_OFF(VM, StatTotalQemuToGC);
     GEN_CHECK_OFF(VM, StatTotalGCToQemu);
     GEN_CHECK_OFF(VM, StatTotalInGC);